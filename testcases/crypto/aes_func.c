@@ -2578,6 +2578,394 @@ testcase_cleanup:
     return rc;
 }
 
+/**
+ * Message based AES-GCM (C_MessageEncryptInit/C_MessageDecryptInit):
+ * each published vector is encrypted as a single message and decrypted
+ * in two parts, using one message context per key.
+ */
+CK_RV do_MessageEncryptDecryptAES(struct published_test_suite_info *tsuite)
+{
+    unsigned int i;
+    CK_BYTE output[BIG_REQUEST];
+    CK_BYTE iv[MAX_IV_SIZE];
+    CK_BYTE tag[AES_BLOCK_SIZE];
+    CK_ULONG output_len, part_len, first_len, tag_len;
+    CK_ULONG user_pin_len;
+    CK_BYTE user_pin[PKCS11_MAX_PIN_LEN];
+    CK_SESSION_HANDLE session;
+    CK_MECHANISM mech = { CKM_AES_GCM, NULL, 0 };
+    CK_GCM_MESSAGE_PARAMS msg_param;
+    CK_OBJECT_HANDLE h_key = CK_INVALID_HANDLE;
+    CK_RV rc = CKR_OK;
+    CK_FLAGS flags;
+    CK_SLOT_ID slot_id = SLOT_ID;
+
+    testsuite_begin("%s Message Encryption/Decryption.", tsuite->name);
+    testcase_rw_session();
+    testcase_user_login();
+
+    if (funcs3 == NULL) {
+        testsuite_skip(tsuite->tvcount,
+                       "Interface doesn't provide the v3.0 function list");
+        goto testcase_cleanup;
+    }
+
+    /** skip test if the slot doesn't support message based encryption **/
+    if (!mech_supported_flags(slot_id, tsuite->mech.mechanism,
+                              CKF_MESSAGE_ENCRYPT | CKF_MESSAGE_DECRYPT)) {
+        testsuite_skip(tsuite->tvcount,
+                       "Slot %u doesn't support message based %s (0x%x)",
+                       (unsigned int) slot_id,
+                       mech_to_str(tsuite->mech.mechanism),
+                       (unsigned int) tsuite->mech.mechanism);
+        goto testcase_cleanup;
+    }
+
+    for (i = 0; i < tsuite->tvcount; i++) {
+
+        testcase_begin("%s Message Encryption/Decryption with published "
+                       "test vector %d.", tsuite->name, i);
+
+        rc = create_AESKey(session, TRUE,
+                           tsuite->tv[i].key, tsuite->tv[i].klen, &h_key);
+        if (rc != CKR_OK) {
+            if (rc == CKR_POLICY_VIOLATION) {
+                testcase_skip("AES key import is not allowed by policy");
+                continue;
+            }
+
+            testcase_error("C_CreateObject rc=%s", p11_get_ckr(rc));
+            goto error;
+        }
+
+        tag_len = tsuite->tv[i].clen - tsuite->tv[i].plen;
+        memcpy(iv, tsuite->tv[i].iv, tsuite->tv[i].ivlen);
+        msg_param.pIv = iv;
+        msg_param.ulIvLen = tsuite->tv[i].ivlen;
+        msg_param.ulIvFixedBits = 0;
+        msg_param.ivGenerator = CKG_NO_GENERATE;
+        msg_param.pTag = tag;
+        msg_param.ulTagBits = tsuite->tv[i].taglen;
+
+        /** single message encryption **/
+        rc = funcs3->C_MessageEncryptInit(session, &mech, h_key);
+        if (rc != CKR_OK) {
+            testcase_error("C_MessageEncryptInit rc=%s", p11_get_ckr(rc));
+            goto error;
+        }
+
+        output_len = sizeof(output);
+        rc = funcs3->C_EncryptMessage(session, &msg_param, sizeof(msg_param),
+                                      tsuite->tv[i].aad, tsuite->tv[i].aadlen,
+                                      tsuite->tv[i].plaintext,
+                                      tsuite->tv[i].plen,
+                                      output, &output_len);
+        if (rc != CKR_OK) {
+            testcase_error("C_EncryptMessage rc=%s", p11_get_ckr(rc));
+            goto error;
+        }
+
+        rc = funcs3->C_MessageEncryptFinal(session);
+        if (rc != CKR_OK) {
+            testcase_error("C_MessageEncryptFinal rc=%s", p11_get_ckr(rc));
+            goto error;
+        }
+
+        testcase_new_assertion();
+
+        if (output_len != tsuite->tv[i].plen ||
+            memcmp(output, tsuite->tv[i].ciphertext, output_len) != 0 ||
+            memcmp(tag, tsuite->tv[i].ciphertext + output_len,
+                   tag_len) != 0) {
+            testcase_fail("encrypted message does not match test vector %d",
+                          i);
+            goto destroy;
+        }
+
+        /** two part message decryption **/
+        rc = funcs3->C_MessageDecryptInit(session, &mech, h_key);
+        if (rc != CKR_OK) {
+            testcase_error("C_MessageDecryptInit rc=%s", p11_get_ckr(rc));
+            goto error;
+        }
+
+        rc = funcs3->C_DecryptMessageBegin(session, &msg_param,
+                                           sizeof(msg_param),
+                                           tsuite->tv[i].aad,
+                                           tsuite->tv[i].aadlen);
+        if (rc != CKR_OK) {
+            testcase_error("C_DecryptMessageBegin rc=%s", p11_get_ckr(rc));
+            goto error;
+        }
+
+        first_len = tsuite->tv[i].plen / 2;
+        part_len = sizeof(output);
+        rc = funcs3->C_DecryptMessageNext(session, &msg_param,
+                                          sizeof(msg_param),
+                                          tsuite->tv[i].ciphertext, first_len,
+                                          output, &part_len, 0);
+        if (rc != CKR_OK) {
+            testcase_error("C_DecryptMessageNext rc=%s", p11_get_ckr(rc));
+            goto error;
+        }
+        output_len = part_len;
+
+        part_len = sizeof(output) - output_len;
+        rc = funcs3->C_DecryptMessageNext(session, &msg_param,
+                                          sizeof(msg_param),
+                                          tsuite->tv[i].ciphertext + first_len,
+                                          tsuite->tv[i].plen - first_len,
+                                          output + output_len, &part_len,
+                                          CKF_END_OF_MESSAGE);
+        if (rc != CKR_OK) {
+            testcase_error("C_DecryptMessageNext rc=%s", p11_get_ckr(rc));
+            goto error;
+        }
+        output_len += part_len;
+
+        rc = funcs3->C_MessageDecryptFinal(session);
+        if (rc != CKR_OK) {
+            testcase_error("C_MessageDecryptFinal rc=%s", p11_get_ckr(rc));
+            goto error;
+        }
+
+        if (output_len != tsuite->tv[i].plen ||
+            memcmp(output, tsuite->tv[i].plaintext, output_len) != 0) {
+            testcase_fail("decrypted message does not match test vector %d",
+                          i);
+        } else {
+            testcase_pass("%s Message Encryption/Decryption with test "
+                          "vector %d passed.", tsuite->name, i);
+        }
+
+destroy:
+        rc = funcs->C_DestroyObject(session, h_key);
+        if (rc != CKR_OK) {
+            testcase_error("C_DestroyObject rc=%s", p11_get_ckr(rc));
+            goto testcase_cleanup;
+        }
+        h_key = CK_INVALID_HANDLE;
+    }
+    goto testcase_cleanup;
+
+error:
+    if (h_key != CK_INVALID_HANDLE) {
+        rc = funcs->C_DestroyObject(session, h_key);
+        if (rc != CKR_OK)
+            testcase_error("C_DestroyObject rc=%s", p11_get_ckr(rc));
+    }
+
+testcase_cleanup:
+    testcase_user_logout();
+    rc = funcs->C_CloseAllSessions(slot_id);
+    if (rc != CKR_OK)
+        testcase_error("C_CloseAllSessions rc=%s", p11_get_ckr(rc));
+
+    return rc;
+}
+
+#define IVGEN_MESSAGES      8
+#define IVGEN_IV_LEN        12
+#define IVGEN_FIXED_BITS    36
+#define IVGEN_GENERATORS    3
+
+/**
+ * Message based AES-GCM with IV generation: the same CK_GCM_MESSAGE_PARAMS
+ * are reused for several messages, as an application would do. The fixed
+ * IV bits must be kept, the IVs of the messages must all differ, and every
+ * message must decrypt with the IV that was returned for it.
+ */
+CK_RV do_MessageIvGeneratorAES(void)
+{
+    static const struct {
+        CK_GENERATOR_FUNCTION generator;
+        const char *name;
+    } generators[IVGEN_GENERATORS] = {
+        { CKG_GENERATE_RANDOM, "CKG_GENERATE_RANDOM" },
+        { CKG_GENERATE_COUNTER, "CKG_GENERATE_COUNTER" },
+        { CKG_GENERATE_COUNTER_XOR, "CKG_GENERATE_COUNTER_XOR" },
+    };
+    CK_BYTE key[32];
+    CK_BYTE base[IVGEN_IV_LEN], iv[IVGEN_IV_LEN];
+    CK_BYTE ivs[IVGEN_MESSAGES][IVGEN_IV_LEN];
+    CK_BYTE tags[IVGEN_MESSAGES][AES_BLOCK_SIZE];
+    CK_BYTE clear[32], cipher[IVGEN_MESSAGES][32], output[32];
+    CK_ULONG output_len, fixed_bytes, n;
+    CK_ULONG user_pin_len;
+    CK_BYTE user_pin[PKCS11_MAX_PIN_LEN];
+    CK_SESSION_HANDLE session;
+    CK_MECHANISM mech = { CKM_AES_GCM, NULL, 0 };
+    CK_GCM_MESSAGE_PARAMS msg_param;
+    CK_OBJECT_HANDLE h_key = CK_INVALID_HANDLE;
+    CK_RV rc = CKR_OK;
+    CK_FLAGS flags;
+    CK_SLOT_ID slot_id = SLOT_ID;
+    unsigned int g, i, j;
+    CK_BBOOL ok;
+
+    testsuite_begin("AES-GCM Message Encryption IV generation.");
+    testcase_rw_session();
+    testcase_user_login();
+
+    if (funcs3 == NULL) {
+        testsuite_skip(IVGEN_GENERATORS,
+                       "Interface doesn't provide the v3.0 function list");
+        goto testcase_cleanup;
+    }
+
+    if (!mech_supported_flags(slot_id, CKM_AES_GCM, CKF_MESSAGE_ENCRYPT)) {
+        testsuite_skip(IVGEN_GENERATORS,
+                       "Slot %u doesn't support message based %s (0x%x)",
+                       (unsigned int) slot_id, mech_to_str(CKM_AES_GCM),
+                       (unsigned int) CKM_AES_GCM);
+        goto testcase_cleanup;
+    }
+
+    for (i = 0; i < sizeof(key); i++)
+        key[i] = i;
+    for (i = 0; i < sizeof(base); i++)
+        base[i] = 0xa0 + i;
+    memset(clear, 0x5a, sizeof(clear));
+
+    rc = create_AESKey(session, TRUE, key, sizeof(key), &h_key);
+    if (rc != CKR_OK) {
+        if (rc == CKR_POLICY_VIOLATION) {
+            testsuite_skip(IVGEN_GENERATORS,
+                           "AES key import is not allowed by policy");
+            rc = CKR_OK;
+            goto testcase_cleanup;
+        }
+
+        testcase_error("C_CreateObject rc=%s", p11_get_ckr(rc));
+        goto testcase_cleanup;
+    }
+
+    fixed_bytes = IVGEN_FIXED_BITS / 8;
+
+    for (g = 0; g < IVGEN_GENERATORS; g++) {
+        testcase_begin("AES-GCM Message Encryption with %s.",
+                       generators[g].name);
+
+        rc = funcs3->C_MessageEncryptInit(session, &mech, h_key);
+        if (rc != CKR_OK) {
+            testcase_error("C_MessageEncryptInit rc=%s", p11_get_ckr(rc));
+            goto error;
+        }
+
+        memcpy(iv, base, sizeof(iv));
+        msg_param.pIv = iv;
+        msg_param.ulIvLen = sizeof(iv);
+        msg_param.ulIvFixedBits = IVGEN_FIXED_BITS;
+        msg_param.ivGenerator = generators[g].generator;
+        msg_param.ulTagBits = AES_BLOCK_SIZE * 8;
+
+        for (i = 0; i < IVGEN_MESSAGES; i++) {
+            msg_param.pTag = tags[i];
+            output_len = sizeof(cipher[i]);
+            rc = funcs3->C_EncryptMessage(session, &msg_param,
+                                          sizeof(msg_param), NULL, 0,
+                                          clear, sizeof(clear),
+                                          cipher[i], &output_len);
+            if (rc != CKR_OK) {
+                testcase_error("C_EncryptMessage rc=%s", p11_get_ckr(rc));
+                funcs3->C_MessageEncryptFinal(session);
+                goto error;
+            }
+            memcpy(ivs[i], iv, sizeof(iv));
+        }
+
+        rc = funcs3->C_MessageEncryptFinal(session);
+        if (rc != CKR_OK) {
+            testcase_error("C_MessageEncryptFinal rc=%s", p11_get_ckr(rc));
+            goto error;
+        }
+
+        testcase_new_assertion();
+
+        ok = TRUE;
+        for (i = 0; i < IVGEN_MESSAGES && ok; i++) {
+            if (memcmp(ivs[i], base, fixed_bytes) != 0 ||
+                (ivs[i][fixed_bytes] & 0xf0) != (base[fixed_bytes] & 0xf0)) {
+                testcase_fail("IV of message %u changed the fixed bits", i);
+                ok = FALSE;
+                break;
+            }
+
+            for (j = 0; j < i; j++) {
+                if (memcmp(ivs[i], ivs[j], sizeof(iv)) == 0) {
+                    testcase_fail("message %u reuses the IV of message %u",
+                                  i, j);
+                    ok = FALSE;
+                    break;
+                }
+            }
+
+            if (ok && generators[g].generator == CKG_GENERATE_COUNTER_XOR) {
+                /* IV(n) = IV(0) ^ n, not IV(n - 1) ^ n */
+                for (j = 0, n = i; j < sizeof(iv); j++, n >>= 8) {
+                    if (ivs[i][sizeof(iv) - 1 - j] !=
+                        (base[sizeof(iv) - 1 - j] ^ (CK_BYTE)n)) {
+                        testcase_fail("IV of message %u is not the base IV "
+                                      "XORed with the counter", i);
+                        ok = FALSE;
+                        break;
+                    }
+                }
+            }
+        }
+        if (!ok)
+            continue;
+
+        /* Every message decrypts with the IV that was returned for it */
+        rc = funcs3->C_MessageDecryptInit(session, &mech, h_key);
+        if (rc != CKR_OK) {
+            testcase_error("C_MessageDecryptInit rc=%s", p11_get_ckr(rc));
+            goto error;
+        }
+
+        msg_param.ivGenerator = CKG_NO_GENERATE;
+        msg_param.ulIvFixedBits = 0;
+        for (i = 0; i < IVGEN_MESSAGES; i++) {
+            memcpy(iv, ivs[i], sizeof(iv));
+            msg_param.pTag = tags[i];
+            output_len = sizeof(output);
+            rc = funcs3->C_DecryptMessage(session, &msg_param,
+                                          sizeof(msg_param), NULL, 0,
+                                          cipher[i], sizeof(cipher[i]),
+                                          output, &output_len);
+            if (rc != CKR_OK || output_len != sizeof(clear) ||
+                memcmp(output, clear, sizeof(clear)) != 0)
+                break;
+        }
+
+        if (funcs3->C_MessageDecryptFinal(session) != CKR_OK)
+            testcase_error("C_MessageDecryptFinal failed");
+
+        if (i < IVGEN_MESSAGES) {
+            testcase_fail("message %u does not decrypt with its IV, rc=%s",
+                          i, p11_get_ckr(rc));
+            rc = CKR_OK;
+            continue;
+        }
+
+        testcase_pass("AES-GCM Message Encryption with %s passed.",
+                      generators[g].name);
+    }
+
+error:
+    if (h_key != CK_INVALID_HANDLE) {
+        if (funcs->C_DestroyObject(session, h_key) != CKR_OK)
+            testcase_error("C_DestroyObject failed");
+    }
+
+testcase_cleanup:
+    testcase_user_logout();
+    if (funcs->C_CloseAllSessions(slot_id) != CKR_OK)
+        testcase_error("C_CloseAllSessions failed");
+
+    return rc;
+}
+
 /**
  * Special tests for protected key support.
  */
@@ -2614,8 +3002,17 @@ CK_RV aes_funcs()
         if (rv != CKR_OK && (!no_stop))
             break;
 
+        if (published_test_suites[i].mech.mechanism == CKM_AES_GCM) {
+            rv = do_MessageEncryptDecryptAES(&published_test_suites[i]);
+            if (rv != CKR_OK && (!no_stop))
+                break;
+        }
+
     }
 
+    if (rv == CKR_OK || no_stop)
+        rv = do_MessageIvGeneratorAES();
+
     for (i = 0; i < NUM_OF_GENERATED_TESTSUITES; i++) {
         rv = do_EncryptDecryptAES(&generated_test_suites[i]);
         if (rv != CKR_OK && (!no_stop))
@@ -0,0 +1,381 @@
+/*
+ * COPYRIGHT (c) International Business Machines Corp. 2024
+ *
+ * This program is provided under the terms of the Common Public License,
+ * version 1.0 (CPL-1.0). Any use, reproduction or distribution for this
+ * software constitutes recipient's acceptance of CPL-1.0 terms which can be
+ * found in the file LICENSE file or at
+ * https://opensource.org/licenses/cpl1.0.php
+ */
+
+/* File: lazy_load.c
+ *
+ * Test driver for loading token objects on first use (objload = lazy).
+ *
+ * The parent process creates public and private token objects. A child
+ * process then initializes the library. With objload = lazy configured for
+ * the slot, the child only registers placeholders for these objects, since
+ * they are already known to the parent. The child checks that each of them
+ * is found by C_FindObjects exactly once, with the attribute values the
+ * parent stored, and that an object the parent creates while the child is
+ * running is found as well. With objload = eager, the same checks apply.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <memory.h>
+#include <unistd.h>
+
+#include <dlfcn.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+#include "pkcs11types.h"
+#include "regress.h"
+
+#define NUM_OBJS        16
+#define LABEL_FMT       "LAZY-LOAD-%02lu"
+#define VALUE_FMT       "lazy load value %02lu"
+#define LABEL_NEW       "LAZY-LOAD-NEW"
+#define LABEL_NONE      "LAZY-LOAD-NONE"
+#define APPLICATION     "lazy_load"
+
+CK_BYTE user_pin[128];
+CK_ULONG user_pin_len;
+CK_SLOT_ID slot_id = 1;
+
+CK_RV create_data_object(CK_SESSION_HANDLE session, const char *label,
+                         const char *value, CK_BBOOL priv,
+                         CK_OBJECT_HANDLE *handle)
+{
+    CK_OBJECT_CLASS class = CKO_DATA;
+    CK_BBOOL true = TRUE;
+    CK_ATTRIBUTE tmpl[] = {
+        {CKA_CLASS, &class, sizeof(class)},
+        {CKA_TOKEN, &true, sizeof(true)},
+        {CKA_PRIVATE, &priv, sizeof(priv)},
+        {CKA_LABEL, (CK_VOID_PTR)label, (CK_ULONG)strlen(label)},
+        {CKA_APPLICATION, APPLICATION, strlen(APPLICATION)},
+        {CKA_VALUE, (CK_VOID_PTR)value, (CK_ULONG)strlen(value)},
+    };
+
+    return funcs->C_CreateObject(session, tmpl, sizeof(tmpl) / sizeof(tmpl[0]),
+                                 handle);
+}
+
+CK_RV find_objects(CK_SESSION_HANDLE session, CK_ATTRIBUTE *tmpl,
+                   CK_ULONG tmpl_len, CK_OBJECT_HANDLE *handles,
+                   CK_ULONG max, CK_ULONG *count)
+{
+    CK_RV rv, rv2;
+
+    *count = 0;
+    rv = funcs->C_FindObjectsInit(session, tmpl, tmpl_len);
+    if (rv != CKR_OK)
+        return rv;
+
+    rv = funcs->C_FindObjects(session, handles, max, count);
+
+    rv2 = funcs->C_FindObjectsFinal(session);
+    return rv != CKR_OK ? rv : rv2;
+}
+
+/*
+ * Finds the object with the label, and checks its value. Returns the number
+ * of objects found in count.
+ */
+CK_RV find_label(CK_SESSION_HANDLE session, const char *label,
+                 const char *value, CK_ULONG *count)
+{
+    CK_ATTRIBUTE tmpl[] = {
+        {CKA_LABEL, (CK_VOID_PTR)label, (CK_ULONG)strlen(label)},
+    };
+    CK_OBJECT_HANDLE handles[2];
+    CK_BYTE buf[64];
+    CK_ATTRIBUTE attr = {CKA_VALUE, buf, sizeof(buf)};
+    CK_RV rv;
+
+    rv = find_objects(session, tmpl, 1, handles, 2, count);
+    if (rv != CKR_OK || *count != 1)
+        return rv;
+
+    rv = funcs->C_GetAttributeValue(session, handles[0], &attr, 1);
+    if (rv != CKR_OK)
+        return rv;
+
+    if (attr.ulValueLen != strlen(value) ||
+        memcmp(buf, value, attr.ulValueLen) != 0)
+        return CKR_ATTRIBUTE_VALUE_INVALID;
+
+    return CKR_OK;
+}
+
+int do_child(int to_parent, int to_child)
+{
+    CK_C_INITIALIZE_ARGS cinit_args;
+    CK_SESSION_HANDLE session;
+    CK_FLAGS flags;
+    CK_OBJECT_CLASS class = CKO_DATA;
+    CK_ATTRIBUTE app_tmpl[] = {
+        {CKA_CLASS, &class, sizeof(class)},
+        {CKA_APPLICATION, APPLICATION, strlen(APPLICATION)},
+    };
+    CK_OBJECT_HANDLE handles[NUM_OBJS + 2];
+    char label[32], value[32];
+    CK_ULONG i, count, errors;
+    char c = 0;
+    CK_RV rv;
+
+    testcase_setup();
+    t_ran = 0;
+    t_passed = 0;
+    t_skipped = 0;
+    t_failed = 0;
+    testcase_begin(".. in client process: %u", getpid());
+
+    memset(&cinit_args, 0x0, sizeof(cinit_args));
+    cinit_args.flags = CKF_OS_LOCKING_OK;
+    if ((rv = funcs->C_Initialize(&cinit_args))) {
+        testcase_fail("C_Initialize (client) rc = %s", p11_get_ckr(rv));
+        goto out;
+    }
+
+    flags = CKF_SERIAL_SESSION | CKF_RW_SESSION;
+    rv = funcs->C_OpenSession(slot_id, flags, NULL, NULL, &session);
+    if (rv != CKR_OK) {
+        testcase_fail("C_OpenSession (client) rc = %s", p11_get_ckr(rv));
+        goto finalize;
+    }
+
+    // The public objects are found in a public session, the private ones not
+    testcase_new_assertion();
+    for (i = 0, errors = 0; i < NUM_OBJS; i++) {
+        snprintf(label, sizeof(label), LABEL_FMT, i);
+        snprintf(value, sizeof(value), VALUE_FMT, i);
+        rv = find_label(session, label, value, &count);
+        if (rv != CKR_OK || count != (i % 2 ? 0 : 1)) {
+            testcase_fail("find %s (client, public) rc = %s, count = %lu",
+                          label, p11_get_ckr(rv), count);
+            errors++;
+        }
+    }
+    if (errors > 0)
+        goto close_session;
+    testcase_pass("Public objects found in a public session (client)");
+
+    rv = funcs->C_Login(session, CKU_USER, user_pin, user_pin_len);
+    if (rv != CKR_OK) {
+        testcase_fail("C_Login (client) rc = %s", p11_get_ckr(rv));
+        goto close_session;
+    }
+
+    testcase_new_assertion();
+    for (i = 0, errors = 0; i < NUM_OBJS; i++) {
+        snprintf(label, sizeof(label), LABEL_FMT, i);
+        snprintf(value, sizeof(value), VALUE_FMT, i);
+        rv = find_label(session, label, value, &count);
+        if (rv != CKR_OK || count != 1) {
+            testcase_fail("find %s (client, user) rc = %s, count = %lu",
+                          label, p11_get_ckr(rv), count);
+            errors++;
+        }
+    }
+    if (errors > 0)
+        goto close_session;
+    testcase_pass("All objects found with their values (client)");
+
+    // Placeholders are candidates of every search, but must not match it
+    testcase_new_assertion();
+    rv = find_label(session, LABEL_NONE, "", &count);
+    if (rv != CKR_OK || count != 0) {
+        testcase_fail("find %s (client) rc = %s, count = %lu",
+                      LABEL_NONE, p11_get_ckr(rv), count);
+        goto close_session;
+    }
+    rv = find_objects(session, app_tmpl, 2, handles, NUM_OBJS + 2, &count);
+    if (rv != CKR_OK || count != NUM_OBJS) {
+        testcase_fail("find by application (client) rc = %s, count = %lu",
+                      p11_get_ckr(rv), count);
+        goto close_session;
+    }
+    testcase_pass("Searches match each object once (client)");
+
+    // Let the parent create an object now, and wait for it
+    if (write(to_parent, &c, 1) != 1 || read(to_child, &c, 1) != 1) {
+        testcase_fail("Synchronization with the parent failed");
+        goto close_session;
+    }
+
+    testcase_new_assertion();
+    rv = find_label(session, LABEL_NEW, LABEL_NEW, &count);
+    if (rv != CKR_OK || count != 1) {
+        testcase_fail("find %s (client) rc = %s, count = %lu",
+                      LABEL_NEW, p11_get_ckr(rv), count);
+        goto close_session;
+    }
+    testcase_pass("Object created by another process found (client)");
+
+close_session:
+    rv = funcs->C_CloseSession(session);
+    if (rv != CKR_OK)
+        testcase_fail("C_CloseSession (client) rc = %s", p11_get_ckr(rv));
+finalize:
+    rv = funcs->C_Finalize(NULL);
+    if (rv != CKR_OK)
+        testcase_fail("C_Finalize (client) rc = %s", p11_get_ckr(rv));
+out:
+    testcase_print_result();
+    return testcase_return(0);
+}
+
+int main(int argc, char **argv)
+{
+    CK_C_INITIALIZE_ARGS cinit_args;
+    int i, ret = 1, status = 1;
+    int to_parent[2], to_child[2];
+    CK_RV rv;
+    CK_SESSION_HANDLE session;
+    CK_FLAGS flags;
+    CK_OBJECT_HANDLE handles[NUM_OBJS + 1];
+    CK_ULONG num_handles = 0, j;
+    char label[32], value[32];
+    pid_t child_pid;
+    char c = 0;
+
+    for (i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-slot") == 0) {
+            ++i;
+            if (i >= argc) {
+                printf("Slot number missing\n");
+                return -1;
+            }
+            slot_id = atoi(argv[i]);
+        }
+
+        if (strcmp(argv[i], "-h") == 0) {
+            printf("usage:  %s [-slot <num>] [-h]\n\n", argv[0]);
+            printf("By default, Slot #1 is used\n\n");
+            printf("Configure the slot with 'objload = lazy' to test the "
+                   "loading of token objects on first use\n\n");
+            return -1;
+        }
+    }
+
+    if (get_user_pin(user_pin))
+        return CKR_FUNCTION_FAILED;
+    user_pin_len = (CK_ULONG) strlen((char *) user_pin);
+
+    printf("Using slot #%lu...\n\n", slot_id);
+
+    rv = do_GetFunctionList();
+    if (rv != TRUE) {
+        testcase_fail("do_GetFunctionList() rc = %s", p11_get_ckr(rv));
+        goto out;
+    }
+
+    testcase_setup();
+    testcase_begin("Starting...  Parent process: %u", getpid());
+
+    memset(&cinit_args, 0x0, sizeof(cinit_args));
+    cinit_args.flags = CKF_OS_LOCKING_OK;
+
+    if ((rv = funcs->C_Initialize(&cinit_args))) {
+        testcase_fail("C_Initialize (parent) rc = %s", p11_get_ckr(rv));
+        goto out;
+    }
+
+    flags = CKF_SERIAL_SESSION | CKF_RW_SESSION;
+    rv = funcs->C_OpenSession(slot_id, flags, NULL, NULL, &session);
+    if (rv != CKR_OK) {
+        testcase_fail("C_OpenSession (parent) rc = %s", p11_get_ckr(rv));
+        goto finalize;
+    }
+
+    rv = funcs->C_Login(session, CKU_USER, user_pin, user_pin_len);
+    if (rv != CKR_OK) {
+        testcase_fail("C_Login (parent) rc = %s", p11_get_ckr(rv));
+        goto close_session;
+    }
+
+    // Every other object is private
+    for (j = 0; j < NUM_OBJS; j++) {
+        snprintf(label, sizeof(label), LABEL_FMT, j);
+        snprintf(value, sizeof(value), VALUE_FMT, j);
+        rv = create_data_object(session, label, value, j % 2 ? TRUE : FALSE,
+                                &handles[num_handles]);
+        if (rv != CKR_OK) {
+            testcase_fail("C_CreateObject (parent) rc = %s", p11_get_ckr(rv));
+            goto destroy;
+        }
+        num_handles++;
+    }
+
+    if (pipe(to_parent) != 0 || pipe(to_child) != 0) {
+        testcase_error("pipe failed");
+        goto destroy;
+    }
+
+    testcase_new_assertion();
+    child_pid = fork();
+    if (child_pid == 0) {
+        close(to_parent[0]);
+        close(to_child[1]);
+        exit(do_child(to_parent[1], to_child[0]));
+    }
+    close(to_parent[1]);
+    close(to_child[0]);
+    if (child_pid < 0) {
+        testcase_error("fork failed");
+        close(to_parent[0]);
+        close(to_child[1]);
+        goto destroy;
+    }
+
+    // The child signals when it is done with the existing objects
+    if (read(to_parent[0], &c, 1) == 1) {
+        rv = create_data_object(session, LABEL_NEW, LABEL_NEW, TRUE,
+                                &handles[num_handles]);
+        if (rv != CKR_OK)
+            testcase_fail("C_CreateObject (parent) rc = %s", p11_get_ckr(rv));
+        else
+            num_handles++;
+        if (write(to_child[1], &c, 1) != 1)
+            testcase_error("write failed");
+    }
+    close(to_parent[0]);
+    close(to_child[1]);
+
+    waitpid(child_pid, &status, 0);
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+        testcase_fail("Client process failed");
+        goto destroy;
+    }
+    testcase_pass("Client process found all token objects");
+
+    ret = 0;
+
+destroy:
+    for (j = 0; j < num_handles; j++) {
+        rv = funcs->C_DestroyObject(session, handles[j]);
+        if (rv != CKR_OK) {
+            testcase_fail("C_DestroyObject (parent) rc = %s", p11_get_ckr(rv));
+            ret = 1;
+        }
+    }
+close_session:
+    rv = funcs->C_CloseSession(session);
+    if (rv != CKR_OK) {
+        testcase_fail("C_CloseSession (parent) rc = %s", p11_get_ckr(rv));
+        ret = 1;
+    }
+finalize:
+    rv = funcs->C_Finalize(NULL);
+    if (rv != CKR_OK) {
+        testcase_fail("C_Finalize (parent) rc = %s", p11_get_ckr(rv));
+        ret = 1;
+    }
+out:
+    testcase_print_result();
+    return testcase_return(ret);
+}
@@ -0,0 +1,567 @@
+/*
+ * COPYRIGHT (c) International Business Machines Corp. 2024
+ *
+ * This program is provided under the terms of the Common Public License,
+ * version 1.0 (CPL-1.0). Any use, reproduction or distribution for this
+ * software constitutes recipient's acceptance of CPL-1.0 terms which can be
+ * found in the file LICENSE file or at
+ * https://opensource.org/licenses/cpl1.0.php
+ */
+
+/* File: loadsave.c
+ *
+ * Performance tests for the token object store
+ *
+ *    create private token objects with C_CreateObject
+ *    update them with C_SetAttributeValue
+ *    destroy them with C_DestroyObject
+ *    create private token objects in batches with C_IBM_CreateObjects
+ *    create private token objects with C_CreateObject from several threads
+ *
+ * For each test the latencies of the single calls are printed, together
+ * with the number of read and write system calls and the number of bytes
+ * written to storage per object, as counted in /proc/self/io.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <memory.h>
+#include <pthread.h>
+#include <dlfcn.h>
+#include <sys/types.h>
+#include <sys/time.h>
+
+#include "pkcs11types.h"
+#include "regress.h"
+#include "common.c"
+
+#define SYSTEMTIME struct timeval
+#ifdef GetSystemTime
+#undef GetSystemTime
+#endif
+#define GetSystemTime(x) gettimeofday((x),NULL)
+static inline unsigned long delta_time_us(struct timeval *t1,
+                                          struct timeval *t2)
+{
+    unsigned long d;
+    struct timeval td;
+
+    timersub(t2, t1, &td);
+    d = td.tv_sec * 1000 * 1000 + td.tv_usec;
+
+    return (d ? d : 1);         // return 1us if delta is 0
+}
+
+CK_C_IBM_CreateObjects _C_IBM_CreateObjects;
+
+struct io_counters {
+    unsigned long syscr;
+    unsigned long syscw;
+    unsigned long write_bytes;
+};
+
+struct op_stats {
+    CK_ULONG count;
+    CK_ULONG tot_time;
+    CK_ULONG min_time;
+    CK_ULONG max_time;
+};
+
+static void get_io_counters(struct io_counters *io)
+{
+    char line[128];
+    FILE *fp;
+
+    memset(io, 0, sizeof(*io));
+
+    fp = fopen("/proc/self/io", "r");
+    if (fp == NULL)
+        return;
+
+    while (fgets(line, sizeof(line), fp) != NULL) {
+        if (sscanf(line, "syscr: %lu", &io->syscr) == 1)
+            continue;
+        if (sscanf(line, "syscw: %lu", &io->syscw) == 1)
+            continue;
+        sscanf(line, "write_bytes: %lu", &io->write_bytes);
+    }
+
+    fclose(fp);
+}
+
+static void init_stats(struct op_stats *st)
+{
+    memset(st, 0, sizeof(*st));
+    st->min_time = 0xFFFFFFFF;
+}
+
+static void add_stats(struct op_stats *st, CK_ULONG diff)
+{
+    st->count++;
+    st->tot_time += diff;
+    if (diff < st->min_time)
+        st->min_time = diff;
+    if (diff > st->max_time)
+        st->max_time = diff;
+}
+
+static void print_stats(struct op_stats *st, CK_ULONG objects,
+                        struct io_counters *io1, struct io_counters *io2)
+{
+    if (st->count == 0 || objects == 0)
+        return;
+
+    printf("%lu calls, %lu objects: total=%luus min=%luus max=%luus "
+           "avg=%luus obj/s=%.3f\n", st->count, objects, st->tot_time,
+           st->min_time, st->max_time, st->tot_time / st->count,
+           (double) objects * 1000 * 1000 / (double) st->tot_time);
+    printf("per object: syscr=%.2f syscw=%.2f write_bytes=%.1f\n",
+           (double) (io2->syscr - io1->syscr) / objects,
+           (double) (io2->syscw - io1->syscw) / objects,
+           (double) (io2->write_bytes - io1->write_bytes) / objects);
+}
+
+static CK_RV create_data_object(CK_SESSION_HANDLE session, CK_ULONG i,
+                                CK_OBJECT_HANDLE *obj)
+{
+    CK_OBJECT_CLASS class = CKO_DATA;
+    CK_BBOOL true = TRUE;
+    CK_BYTE value[256];
+    char label[64];
+    CK_ATTRIBUTE tmpl[] = {
+        {CKA_CLASS, &class, sizeof(class)},
+        {CKA_TOKEN, &true, sizeof(true)},
+        {CKA_PRIVATE, &true, sizeof(true)},
+        {CKA_LABEL, label, 0},
+        {CKA_VALUE, value, sizeof(value)},
+    };
+
+    snprintf(label, sizeof(label), "loadsave-%lu", i);
+    tmpl[3].ulValueLen = strlen(label);
+    memset(value, (int) i, sizeof(value));
+
+    return funcs->C_CreateObject(session, tmpl,
+                                 sizeof(tmpl) / sizeof(CK_ATTRIBUTE), obj);
+}
+
+int do_CreateUpdateDestroy(CK_ULONG count)
+{
+    CK_SESSION_HANDLE session;
+    CK_FLAGS flags;
+    CK_BYTE user_pin[PKCS11_MAX_PIN_LEN];
+    CK_ULONG user_pin_len;
+    CK_RV rc;
+
+    CK_OBJECT_HANDLE *objs = NULL;
+    CK_ULONG i, created = 0;
+    SYSTEMTIME t1, t2;
+    struct op_stats st;
+    struct io_counters io1, io2;
+    char label[64];
+    CK_ATTRIBUTE label_attr = { CKA_LABEL, label, 0 };
+
+    testcase_begin("Create %lu private token objects", count);
+    testcase_new_assertion();
+
+    testcase_rw_session();
+    testcase_user_login();
+
+    objs = calloc(count, sizeof(CK_OBJECT_HANDLE));
+    if (objs == NULL) {
+        testcase_error("calloc failed");
+        rc = CKR_HOST_MEMORY;
+        goto testcase_cleanup;
+    }
+
+    init_stats(&st);
+    get_io_counters(&io1);
+    for (created = 0; created < count; created++) {
+        GetSystemTime(&t1);
+        rc = create_data_object(session, created, &objs[created]);
+        if (rc != CKR_OK) {
+            testcase_error("C_CreateObject rc=%s", p11_get_ckr(rc));
+            goto testcase_cleanup;
+        }
+        GetSystemTime(&t2);
+        add_stats(&st, delta_time_us(&t1, &t2));
+    }
+    get_io_counters(&io2);
+    print_stats(&st, count, &io1, &io2);
+
+    testcase_pass("Create %lu private token objects", count);
+
+    testcase_begin("Update %lu private token objects", count);
+    testcase_new_assertion();
+
+    init_stats(&st);
+    get_io_counters(&io1);
+    for (i = 0; i < count; i++) {
+        snprintf(label, sizeof(label), "loadsave-updated-%lu", i);
+        label_attr.ulValueLen = strlen(label);
+
+        GetSystemTime(&t1);
+        rc = funcs->C_SetAttributeValue(session, objs[i], &label_attr, 1);
+        if (rc != CKR_OK) {
+            testcase_error("C_SetAttributeValue rc=%s", p11_get_ckr(rc));
+            goto testcase_cleanup;
+        }
+        GetSystemTime(&t2);
+        add_stats(&st, delta_time_us(&t1, &t2));
+    }
+    get_io_counters(&io2);
+    print_stats(&st, count, &io1, &io2);
+
+    testcase_pass("Update %lu private token objects", count);
+
+    testcase_begin("Destroy %lu private token objects", count);
+    testcase_new_assertion();
+
+    init_stats(&st);
+    get_io_counters(&io1);
+    for (; created > 0; created--) {
+        GetSystemTime(&t1);
+        rc = funcs->C_DestroyObject(session, objs[created - 1]);
+        if (rc != CKR_OK) {
+            testcase_error("C_DestroyObject rc=%s", p11_get_ckr(rc));
+            goto testcase_cleanup;
+        }
+        GetSystemTime(&t2);
+        add_stats(&st, delta_time_us(&t1, &t2));
+    }
+    get_io_counters(&io2);
+    print_stats(&st, count, &io1, &io2);
+
+    testcase_pass("Destroy %lu private token objects", count);
+
+testcase_cleanup:
+    for (i = 0; i < created; i++)
+        funcs->C_DestroyObject(session, objs[i]);
+    free(objs);
+    testcase_closeall_session();
+    if (rc != CKR_OK)
+        return FALSE;
+
+    return TRUE;
+}
+
+int do_CreateObjectsBatch(CK_ULONG count, CK_ULONG batch)
+{
+    CK_SESSION_HANDLE session;
+    CK_FLAGS flags;
+    CK_BYTE user_pin[PKCS11_MAX_PIN_LEN];
+    CK_ULONG user_pin_len;
+    CK_RV rc;
+
+    CK_OBJECT_CLASS class = CKO_DATA;
+    CK_BBOOL true = TRUE;
+    CK_BYTE value[256];
+    CK_ATTRIBUTE tmpl[] = {
+        {CKA_CLASS, &class, sizeof(class)},
+        {CKA_TOKEN, &true, sizeof(true)},
+        {CKA_PRIVATE, &true, sizeof(true)},
+        {CKA_VALUE, value, sizeof(value)},
+    };
+    CK_IBM_OBJECT_TEMPLATE *templates = NULL;
+    CK_OBJECT_HANDLE *objs = NULL;
+    CK_ULONG i, n, created = 0;
+    SYSTEMTIME t1, t2;
+    struct op_stats st;
+    struct io_counters io1, io2;
+
+    testcase_begin("Create %lu private token objects in batches of %lu",
+                   count, batch);
+
+    if (_C_IBM_CreateObjects == NULL) {
+        testcase_skip("C_IBM_CreateObjects not supported");
+        return TRUE;
+    }
+
+    testcase_new_assertion();
+
+    testcase_rw_session();
+    testcase_user_login();
+
+    objs = calloc(count, sizeof(CK_OBJECT_HANDLE));
+    templates = calloc(batch, sizeof(CK_IBM_OBJECT_TEMPLATE));
+    if (objs == NULL || templates == NULL) {
+        testcase_error("calloc failed");
+        rc = CKR_HOST_MEMORY;
+        goto testcase_cleanup;
+    }
+
+    memset(value, 0x5a, sizeof(value));
+    for (i = 0; i < batch; i++) {
+        templates[i].pTemplate = tmpl;
+        templates[i].ulCount = sizeof(tmpl) / sizeof(CK_ATTRIBUTE);
+    }
+
+    init_stats(&st);
+    get_io_counters(&io1);
+    while (created < count) {
+        n = count - created < batch ? count - created : batch;
+
+        GetSystemTime(&t1);
+        rc = _C_IBM_CreateObjects(session, templates, n, &objs[created]);
+        if (rc == CKR_FUNCTION_NOT_SUPPORTED) {
+            testcase_skip("Slot %lu doesn't support C_IBM_CreateObjects",
+                          SLOT_ID);
+            rc = CKR_OK;
+            goto testcase_cleanup;
+        }
+        if (rc != CKR_OK) {
+            testcase_error("C_IBM_CreateObjects rc=%s", p11_get_ckr(rc));
+            goto testcase_cleanup;
+        }
+        GetSystemTime(&t2);
+        add_stats(&st, delta_time_us(&t1, &t2));
+        created += n;
+    }
+    get_io_counters(&io2);
+    print_stats(&st, count, &io1, &io2);
+
+    testcase_pass("Create %lu private token objects in batches of %lu",
+                  count, batch);
+
+testcase_cleanup:
+    for (i = 0; i < created; i++)
+        funcs->C_DestroyObject(session, objs[i]);
+    free(objs);
+    free(templates);
+    testcase_closeall_session();
+    if (rc != CKR_OK)
+        return FALSE;
+
+    return TRUE;
+}
+
+struct thread_arg {
+    CK_SESSION_HANDLE session;
+    CK_ULONG first;
+    CK_ULONG count;
+    CK_OBJECT_HANDLE *objs;
+    CK_ULONG created;
+    struct op_stats st;
+    CK_RV rc;
+};
+
+static void *create_thread(void *arg)
+{
+    struct thread_arg *ta = arg;
+    SYSTEMTIME t1, t2;
+
+    init_stats(&ta->st);
+    for (ta->created = 0; ta->created < ta->count; ta->created++) {
+        GetSystemTime(&t1);
+        ta->rc = create_data_object(ta->session, ta->first + ta->created,
+                                    &ta->objs[ta->created]);
+        if (ta->rc != CKR_OK)
+            break;
+        GetSystemTime(&t2);
+        add_stats(&ta->st, delta_time_us(&t1, &t2));
+    }
+
+    return NULL;
+}
+
+int do_CreateThreads(CK_ULONG count, CK_ULONG threads)
+{
+    CK_SESSION_HANDLE session;
+    CK_FLAGS flags;
+    CK_BYTE user_pin[PKCS11_MAX_PIN_LEN];
+    CK_ULONG user_pin_len;
+    CK_RV rc;
+
+    struct thread_arg *ta = NULL;
+    pthread_t *tids = NULL;
+    CK_OBJECT_HANDLE *objs = NULL;
+    CK_ULONG i, j, started = 0;
+    SYSTEMTIME t1, t2;
+    struct op_stats st;
+    struct io_counters io1, io2;
+    CK_ULONG diff;
+
+    testcase_begin("Create %lu private token objects from %lu threads",
+                   count, threads);
+    testcase_new_assertion();
+
+    testcase_rw_session();
+    testcase_user_login();
+
+    objs = calloc(count, sizeof(CK_OBJECT_HANDLE));
+    ta = calloc(threads, sizeof(struct thread_arg));
+    tids = calloc(threads, sizeof(pthread_t));
+    if (objs == NULL || ta == NULL || tids == NULL) {
+        testcase_error("calloc failed");
+        rc = CKR_HOST_MEMORY;
+        goto testcase_cleanup;
+    }
+
+    for (i = 0; i < threads; i++) {
+        flags = CKF_SERIAL_SESSION | CKF_RW_SESSION;
+        rc = funcs->C_OpenSession(SLOT_ID, flags, NULL, NULL,
+                                  &ta[i].session);
+        if (rc != CKR_OK) {
+            testcase_error("C_OpenSession() rc = %s", p11_get_ckr(rc));
+            goto testcase_cleanup;
+        }
+        ta[i].first = i * (count / threads);
+        ta[i].count = (i == threads - 1) ? count - ta[i].first :
+                                           count / threads;
+        ta[i].objs = &objs[ta[i].first];
+    }
+
+    get_io_counters(&io1);
+    GetSystemTime(&t1);
+    for (started = 0; started < threads; started++) {
+        if (pthread_create(&tids[started], NULL, create_thread,
+                           &ta[started]) != 0) {
+            testcase_error("pthread_create failed");
+            rc = CKR_FUNCTION_FAILED;
+            break;
+        }
+    }
+    for (i = 0; i < started; i++)
+        pthread_join(tids[i], NULL);
+    GetSystemTime(&t2);
+    get_io_counters(&io2);
+    diff = delta_time_us(&t1, &t2);
+
+    if (rc != CKR_OK)
+        goto testcase_cleanup;
+
+    init_stats(&st);
+    for (i = 0; i < threads; i++) {
+        if (ta[i].rc != CKR_OK) {
+            testcase_error("C_CreateObject rc=%s", p11_get_ckr(ta[i].rc));
+            rc = ta[i].rc;
+            goto testcase_cleanup;
+        }
+        st.count += ta[i].st.count;
+        if (ta[i].st.min_time < st.min_time)
+            st.min_time = ta[i].st.min_time;
+        if (ta[i].st.max_time > st.max_time)
+            st.max_time = ta[i].st.max_time;
+    }
+    /* the wall clock time, not the sum of the latencies */
+    st.tot_time = diff;
+    print_stats(&st, count, &io1, &io2);
+
+    testcase_pass("Create %lu private token objects from %lu threads",
+                  count, threads);
+
+testcase_cleanup:
+    if (ta != NULL) {
+        for (i = 0; i < threads; i++) {
+            for (j = 0; j < ta[i].created; j++)
+                funcs->C_DestroyObject(session, ta[i].objs[j]);
+        }
+    }
+    free(objs);
+    free(ta);
+    free(tids);
+    testcase_closeall_session();
+    if (rc != CKR_OK)
+        return FALSE;
+
+    return TRUE;
+}
+
+void loadsave_usage(char *fct)
+{
+    printf("usage:  %s -slot <num>", fct);
+    printf(" [-count <num>] [-batch <num>] [-threads <num>]");
+    printf(" [-h] \n\n");
+    printf("  -count <num>    number of token objects per test (default 200)\n");
+    printf("  -batch <num>    objects per C_IBM_CreateObjects call "
+           "(default 50)\n");
+    printf("  -threads <num>  number of concurrent threads (default 4)\n");
+
+    return;
+}
+
+int main(int argc, char **argv)
+{
+    CK_C_INITIALIZE_ARGS cinit_args;
+    int rc, i;
+    CK_ULONG count = 200, batch = 50, threads = 4;
+
+    SLOT_ID = 1000;
+
+    for (i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-h") == 0) {
+            loadsave_usage(argv[0]);
+            return 0;
+        }
+        if (i + 1 >= argc) {
+            printf("Argument of option '%s' missing\n", argv[i]);
+            loadsave_usage(argv[0]);
+            return 1;
+        }
+        if (strcmp(argv[i], "-slot") == 0) {
+            SLOT_ID = atoi(argv[i + 1]);
+        } else if (strcmp(argv[i], "-count") == 0) {
+            count = strtoul(argv[i + 1], NULL, 10);
+        } else if (strcmp(argv[i], "-batch") == 0) {
+            batch = strtoul(argv[i + 1], NULL, 10);
+        } else if (strcmp(argv[i], "-threads") == 0) {
+            threads = strtoul(argv[i + 1], NULL, 10);
+        } else {
+            printf("unknown option '%s'\n", argv[i]);
+            loadsave_usage(argv[0]);
+            return 1;
+        }
+        i++;
+    }
+
+    // error if slot has not been identified.
+    if (SLOT_ID == 1000) {
+        printf("Please specify the slot to be tested.\n");
+        loadsave_usage(argv[0]);
+        return 1;
+    }
+
+    if (count == 0 || batch == 0 || threads == 0 || threads > count) {
+        printf("Invalid count, batch or threads value.\n");
+        loadsave_usage(argv[0]);
+        return 1;
+    }
+
+    printf("Using slot #%lu...\n\n", SLOT_ID);
+
+    rc = do_GetFunctionList();
+    if (!rc)
+        return rc;
+
+    *(void **)(&_C_IBM_CreateObjects) = dlsym(pkcs11lib,
+                                              "C_IBM_CreateObjects");
+
+    memset(&cinit_args, 0x0, sizeof(cinit_args));
+    cinit_args.flags = CKF_OS_LOCKING_OK;
+
+    funcs->C_Initialize(&cinit_args);
+
+    testcase_setup();
+
+    testsuite_begin("Token object create/update/destroy.");
+    rc = do_CreateUpdateDestroy(count);
+    if (!rc)
+        goto out;
+
+    testsuite_begin("Token object batch create.");
+    rc = do_CreateObjectsBatch(count, batch);
+    if (!rc)
+        goto out;
+
+    testsuite_begin("Token object concurrent create.");
+    rc = do_CreateThreads(count, threads);
+    if (!rc)
+        goto out;
+
+out:
+    testcase_print_result();
+
+    funcs->C_Finalize(NULL);
+
+    return testcase_return(rc);
+}
@@ -1,14 +1,15 @@
 noinst_PROGRAMS +=							\
 	testcases/misc_tests/obj_mgmt_tests				\
 	testcases/misc_tests/obj_mgmt_lock_tests			\
-	testcases/misc_tests/speed testcases/misc_tests/threadmkobj	\
+	testcases/misc_tests/speed testcases/misc_tests/loadsave	\
+	testcases/misc_tests/threadmkobj				\
 	testcases/misc_tests/tok_obj testcases/misc_tests/tok_rsa	\
 	testcases/misc_tests/tok_des					\
 	testcases/misc_tests/fork testcases/misc_tests/multi_instance   \
 	testcases/misc_tests/obj_lock testcases/misc_tests/tok2tok_transport \
 	testcases/misc_tests/obj_lock testcases/misc_tests/reencrypt    \
 	testcases/misc_tests/cca_export_import_test			\
-	testcases/misc_tests/events
+	testcases/misc_tests/events testcases/misc_tests/lazy_load
 
 testcases_misc_tests_obj_mgmt_tests_CFLAGS = ${testcases_inc}
 testcases_misc_tests_obj_mgmt_tests_LDADD =				\
@@ -27,6 +28,11 @@ testcases_misc_tests_speed_LDADD = testcases/common/libcommon.la
 testcases_misc_tests_speed_SOURCES =					\
 	usr/lib/common/p11util.c testcases/misc_tests/speed.c
 
+testcases_misc_tests_loadsave_CFLAGS = ${testcases_inc}
+testcases_misc_tests_loadsave_LDADD = testcases/common/libcommon.la
+testcases_misc_tests_loadsave_SOURCES =				\
+	usr/lib/common/p11util.c testcases/misc_tests/loadsave.c
+
 testcases_misc_tests_threadmkobj_CFLAGS = ${testcases_inc}
 testcases_misc_tests_threadmkobj_LDADD = testcases/common/libcommon.la
 testcases_misc_tests_threadmkobj_SOURCES =				\
@@ -54,6 +60,10 @@ testcases_misc_tests_multi_instance_LDADD = testcases/common/libcommon.la
 testcases_misc_tests_multi_instance_SOURCES = 				\
 	testcases/misc_tests/multi_instance.c
 
+testcases_misc_tests_lazy_load_CFLAGS = ${testcases_inc}
+testcases_misc_tests_lazy_load_LDADD = testcases/common/libcommon.la
+testcases_misc_tests_lazy_load_SOURCES = testcases/misc_tests/lazy_load.c
+
 testcases_misc_tests_obj_lock_CFLAGS = ${testcases_inc}
 testcases_misc_tests_obj_lock_LDADD = testcases/common/libcommon.la
 testcases_misc_tests_obj_lock_SOURCES = 				\
@@ -0,0 +1,74 @@
+#!/bin/bash
+#
+# COPYRIGHT (c) International Business Machines Corp. 2024
+#
+# This program is provided under the terms of the Common Public License,
+# version 1.0 (CPL-1.0). Any use, reproduction or distribution for this software
+# constitutes recipient's acceptance of CPL-1.0 terms which can be found
+# in the file LICENSE file or at https://opensource.org/licenses/cpl1.0.php
+
+# Converts the token objects of a token to the single file object store with
+# 'pkcstok_migrate --objstore mmap' and back with '--objstore files', and
+# checks that the token shows the same objects after each conversion.
+#
+# - Requires pkcs11-tool (opensc).
+# - The PKCSLIB environment must point to your system's libopencryptoki.so.
+# - The PKCS11_SO_PIN environment variable must hold the SO pin.
+# - The PKCS11_USER_PIN environment variable must hold the user pin.
+# - The OCK_CONFDIR environment variable must point to your system's openCryptoki configuration directory.
+# - The OCK_DATASTORE environment variable must point to the token's datastore directory.
+# - The SLOT environment variable must hold the slot id of the token under test.
+#
+# sudo -E ./objstore_migration.sh
+
+set -ex
+
+# tmp files
+OBJS_PRE=objstore-pre.out
+OBJS_MMAP=objstore-mmap.out
+OBJS_FILES=objstore-files.out
+
+list_objects() {
+	pkcs11-tool --module=$PKCSLIB --slot $SLOT --list-objects > $1
+	pkcs11-tool --module=$PKCSLIB --slot $SLOT --login --pin $PKCS11_USER_PIN --list-objects >> $1
+	p11sak list-key all --slot $SLOT --pin $PKCS11_USER_PIN >> $1
+}
+
+migrate() {
+	killall pkcsslotd
+	rm -rf ${OCK_DATASTORE}_BAK
+	echo -e "y\n" | pkcstok_migrate --verbose debug --slot $SLOT --sopin $PKCS11_SO_PIN --userpin $PKCS11_USER_PIN --confdir $OCK_CONFDIR --datastore $OCK_DATASTORE --objstore $1
+	pkcsslotd
+}
+
+# generate public and private token objects
+p11sak generate-key aes 256 --slot $SLOT --pin $PKCS11_USER_PIN --label objstore-aes
+p11sak generate-key rsa 2048 --slot $SLOT --pin $PKCS11_USER_PIN --label objstore-rsa
+p11sak generate-key ec prime256v1 --slot $SLOT --pin $PKCS11_USER_PIN --label objstore-ec
+
+list_objects $OBJS_PRE
+
+# files -> mmap
+migrate mmap
+test -f $OCK_DATASTORE/TOK_OBJ/OBJ.DB
+test ! -e $OCK_DATASTORE/TOK_OBJ/OBJ.IDX
+grep -Eq "objstore *= *\"?mmap" $OCK_CONFDIR/opencryptoki.conf
+list_objects $OBJS_MMAP
+cmp $OBJS_PRE $OBJS_MMAP
+
+# mmap -> files
+migrate files
+test -f $OCK_DATASTORE/TOK_OBJ/OBJ.IDX
+test ! -e $OCK_DATASTORE/TOK_OBJ/OBJ.DB
+grep -Eq "objstore *= *\"?files" $OCK_CONFDIR/opencryptoki.conf
+list_objects $OBJS_FILES
+cmp $OBJS_PRE $OBJS_FILES
+
+# cleanup
+p11sak remove-key aes --slot $SLOT --pin $PKCS11_USER_PIN --label objstore-aes -f
+p11sak remove-key rsa --slot $SLOT --pin $PKCS11_USER_PIN --label objstore-rsa:pub -f
+p11sak remove-key rsa --slot $SLOT --pin $PKCS11_USER_PIN --label objstore-rsa:prv -f
+p11sak remove-key ec --slot $SLOT --pin $PKCS11_USER_PIN --label objstore-ec:pub -f
+p11sak remove-key ec --slot $SLOT --pin $PKCS11_USER_PIN --label objstore-ec:prv -f
+rm -rf ${OCK_DATASTORE}_BAK
+rm -f $OBJS_PRE $OBJS_MMAP $OBJS_FILES
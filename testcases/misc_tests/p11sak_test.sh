@@ -34,6 +34,8 @@ P11SAK_RSA_POST=p11sak-rsa-post.out
 P11SAK_EC_PRE=p11sak-ec-pre.out
 P11SAK_EC_LONG=p11sak-ec-long.out
 P11SAK_EC_POST=p11sak-ec-post.out
+P11SAK_PAGE_IMPORT=p11sak-page-import.txt
+P11SAK_PAGE_LIST=p11sak-page-list.out
 
 
 echo "** Setting SLOT=30 to the Softtoken unless otherwise set - 'p11sak_test.sh'"
@@ -519,6 +521,40 @@ echo "* TESTCASE list-key ec FAIL Failed to list ec public keys CK_BYTE attribut
 fi
 
 
+echo "** Now list more keys than fit in one page - 'p11sak_test.sh'"
+
+
+# list-key reads the keys in pages of 256 and prefetches their attributes with
+# C_IBM_GetAttributeValues, if available. A label that does not fit into the
+# prefetch buffer is read with C_GetAttributeValue instead.
+P11SAK_PAGE_KEYS=260
+P11SAK_LONG_LABEL=p11sak-page-long-$(printf 'x%.0s' {1..300})
+for i in $(seq 1 $P11SAK_PAGE_KEYS); do
+	printf "aes p11sak-page-%03d %032x\n" $i $i
+done > $P11SAK_PAGE_IMPORT
+printf "aes %s %032x\n" $P11SAK_LONG_LABEL 0 >> $P11SAK_PAGE_IMPORT
+
+p11sak import-key --file $P11SAK_PAGE_IMPORT --slot $SLOT --pin $PKCS11_USER_PIN
+p11sak list-key aes --slot $SLOT --pin $PKCS11_USER_PIN &> $P11SAK_PAGE_LIST
+
+if [[ $(grep -c 'AES 128 | p11sak-page-[0-9]*$' $P11SAK_PAGE_LIST) == "$P11SAK_PAGE_KEYS" &&
+      $(grep -o 'p11sak-page-[0-9]*$' $P11SAK_PAGE_LIST | sort -u | wc -l) == "$P11SAK_PAGE_KEYS" ]]; then
+echo "* TESTCASE list-key aes PASS Listed $P11SAK_PAGE_KEYS aes keys over several pages"
+else
+echo "* TESTCASE list-key aes FAIL Failed to list $P11SAK_PAGE_KEYS aes keys over several pages"
+fi
+if [[ $(grep -c "AES 128 | $P11SAK_LONG_LABEL\$" $P11SAK_PAGE_LIST) == "1" ]]; then
+echo "* TESTCASE list-key aes PASS Listed aes key with a long label"
+else
+echo "* TESTCASE list-key aes FAIL Failed to list aes key with a long label"
+fi
+
+for i in $(seq 1 $P11SAK_PAGE_KEYS); do
+	p11sak remove-key aes --slot $SLOT --pin $PKCS11_USER_PIN --label $(printf "p11sak-page-%03d" $i) -f
+done
+p11sak remove-key aes --slot $SLOT --pin $PKCS11_USER_PIN --label $P11SAK_LONG_LABEL -f
+
+
 echo "** Now remove temporary output files - 'p11sak_test.sh'"
 
 
@@ -537,6 +573,8 @@ rm -f $P11SAK_RSA_POST
 rm -f $P11SAK_EC_PRE
 rm -f $P11SAK_EC_LONG
 rm -f $P11SAK_EC_POST
+rm -f $P11SAK_PAGE_IMPORT
+rm -f $P11SAK_PAGE_LIST
 
 echo "** Now DONE testing - 'p11sak_test.sh'"
 
@@ -18,6 +18,16 @@
  *    DES3 encrypt and decrypt (with modes ECB and CBC)
  *    AES encrypt and decrypt (with modes ECB and CBC, with keylength 128, 192,
  *    256), SHA1, SHA256, SHA512
+ *    AES small message encrypt (with modes ECB and CBC, with keylength 128,
+ *    256, single-part and multi-part with datalength 16, 64, 256)
+ *    C_GenerateRandom (with datalength 16, 32, 256, 4096, 65536)
+ *    SHA256, SHA512 of small records (with datalength 64, 256, one
+ *    C_Digest per record and batches of records with C_IBM_DigestBatch)
+ *    ECDSA verify (P-256 with SHA256, one C_VerifyInit and C_Verify per
+ *    signature and batches of signatures with C_IBM_VerifyBatch)
+ *    ECDSA sign (P-256 with SHA256) and AES-256 CBC_PAD encrypt of 1K
+ *    records, one call after the other and all in flight at once with
+ *    C_IBM_SignAsync and C_IBM_EncryptAsync)
  */
 
 
@@ -27,8 +37,12 @@
 #include <memory.h>
 #include <sys/types.h>
 #include <sys/time.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+#include <stdint.h>
 
 #include "pkcs11types.h"
+#include "ec_curves.h"
 #include "regress.h"
 #include "common.c"
 
@@ -37,6 +51,23 @@
 #define SHA512_HASH_LEN 64
 #define MAX_HASH_LEN SHA512_HASH_LEN
 
+#define SHA_BATCH_RECORDS 256
+
+#define EC_VERIFY_KEYS      4
+#define EC_VERIFY_RECORDS   256
+#define EC_MAX_SIG_LEN      72
+
+CK_C_IBM_DigestBatch _C_IBM_DigestBatch;
+CK_C_IBM_VerifyBatch _C_IBM_VerifyBatch;
+
+#define ASYNC_RECORDS       256
+#define ASYNC_DATA_LEN      1024
+#define ASYNC_OUT_LEN       (ASYNC_DATA_LEN + 16)
+
+CK_C_IBM_SignAsync _C_IBM_SignAsync;
+CK_C_IBM_EncryptAsync _C_IBM_EncryptAsync;
+CK_C_IBM_AsyncWait _C_IBM_AsyncWait;
+
 
 // the GetSystemTime and SYSTEMTIME implementation
 // from regress.h only has a ms resolution
@@ -886,6 +917,160 @@ testcase_cleanup:
     return TRUE;
 }
 
+// Small messages are dominated by the per call overhead (key setup,
+// context allocation) rather than by the cipher itself. Single-part
+// operations with datalen bytes are measured, as well as a multi-part
+// operation over BIG_REQUEST bytes that is fed in chunks of datalen bytes.
+int do_AES_SmallMsg(int keylength, const char *mode, CK_ULONG datalen)
+{
+    CK_SESSION_HANDLE session;
+    CK_MECHANISM mech;
+    CK_FLAGS flags;
+    CK_BYTE user_pin[PKCS11_MAX_PIN_LEN];
+    CK_ULONG user_pin_len;
+    CK_RV rc;
+
+    CK_OBJECT_HANDLE h_key;
+    CK_BYTE original[BIG_REQUEST];
+    CK_BYTE cipher[BIG_REQUEST];
+    CK_ULONG cipher_len, part_len, ofs;
+    CK_ULONG key_len = keylength / 8;
+
+    CK_BYTE init_v[16] = {
+        0x01, 0x02, 0x03, 0x04, 0x05,
+        0x06, 0x07, 0x08, 0x09, 0x0A,
+        0x0B, 0x0C, 0x0D, 0x0E, 0x0F,
+        0x10
+    };
+
+    CK_ULONG i, iterations = 100000, chunk_iterations = 5000;
+    SYSTEMTIME t1, t2;
+    CK_ULONG tot_time;
+
+    testcase_begin("AES small message Encrypt with mode=%s keylen=%ld "
+                   "datalen=%ld", mode, key_len * 8, datalen);
+
+    if (!mech_supported(SLOT_ID, CKM_AES_KEY_GEN)) {
+        testcase_skip("Slot %lu doesn't support CKM_AES_KEY_GEN (0x%x)",
+                      SLOT_ID, CKM_AES_KEY_GEN);
+        return TRUE;
+    }
+    if (strcmp(mode, "ECB") == 0 && !mech_supported(SLOT_ID, CKM_AES_ECB)) {
+        testcase_skip("Slot %lu doesn't support CKM_AES_ECB (0x%x)",
+                      SLOT_ID, CKM_AES_ECB);
+        return TRUE;
+    }
+    if (strcmp(mode, "CBC") == 0 && !mech_supported(SLOT_ID, CKM_AES_CBC)) {
+        testcase_skip("Slot %lu doesn't support CKM_AES_CBC (0x%x)",
+                      SLOT_ID, CKM_AES_CBC);
+        return TRUE;
+    }
+
+    testcase_new_assertion();
+
+    testcase_rw_session();
+    testcase_user_login();
+
+    mech.mechanism = CKM_AES_KEY_GEN;
+    mech.ulParameterLen = 0;
+    mech.pParameter = NULL;
+
+    rc = generate_AESKey(session, key_len, CK_TRUE, &mech, &h_key);
+    if (rc != CKR_OK) {
+        if (rc == CKR_POLICY_VIOLATION) {
+            testcase_skip("AES key generation is not allowed by policy");
+            goto testcase_cleanup;
+        }
+        testcase_error("C_GenerateKey rc=%s", p11_get_ckr(rc));
+        goto testcase_cleanup;
+    }
+
+    for (i = 0; i < BIG_REQUEST; i++)
+        original[i] = i % 255;
+
+    if (strcmp(mode, "ECB") == 0) {
+        mech.mechanism = CKM_AES_ECB;
+        mech.ulParameterLen = 0;
+        mech.pParameter = NULL;
+    } else if (strcmp(mode, "CBC") == 0) {
+        mech.mechanism = CKM_AES_CBC;
+        mech.ulParameterLen = 16;
+        mech.pParameter = init_v;
+    } else {
+        testcase_error("unknown mode %s in do_AES_SmallMsg()", mode);
+        rc = CKR_MECHANISM_INVALID;
+        goto testcase_cleanup;
+    }
+
+    GetSystemTime(&t1);
+    for (i = 0; i < iterations; i++) {
+        rc = funcs->C_EncryptInit(session, &mech, h_key);
+        if (rc != CKR_OK) {
+            testcase_error("C_EncryptInit rc=%s", p11_get_ckr(rc));
+            goto testcase_cleanup;
+        }
+
+        cipher_len = sizeof(cipher);
+        rc = funcs->C_Encrypt(session, original, datalen, cipher, &cipher_len);
+        if (rc != CKR_OK) {
+            testcase_error("C_Encrypt rc=%s", p11_get_ckr(rc));
+            goto testcase_cleanup;
+        }
+    }
+    GetSystemTime(&t2);
+    tot_time = delta_time_us(&t1, &t2);
+
+    printf("single-part: %ld iterations: total=%ldms avg=%ldns "
+           "op/s=%.3f %.3fMB/s\n", iterations, tot_time / 1000,
+           (tot_time * 1000) / iterations,
+           (double) iterations * 1000000 / (double) tot_time,
+           ((double) iterations * datalen / (double) (1024 * 1024)) *
+           1000000 / (double) tot_time);
+
+    GetSystemTime(&t1);
+    for (i = 0; i < chunk_iterations; i++) {
+        rc = funcs->C_EncryptInit(session, &mech, h_key);
+        if (rc != CKR_OK) {
+            testcase_error("C_EncryptInit rc=%s", p11_get_ckr(rc));
+            goto testcase_cleanup;
+        }
+
+        for (ofs = 0; ofs + datalen <= BIG_REQUEST; ofs += datalen) {
+            part_len = sizeof(cipher) - ofs;
+            rc = funcs->C_EncryptUpdate(session, original + ofs, datalen,
+                                        cipher + ofs, &part_len);
+            if (rc != CKR_OK) {
+                testcase_error("C_EncryptUpdate rc=%s", p11_get_ckr(rc));
+                goto testcase_cleanup;
+            }
+        }
+
+        part_len = sizeof(cipher);
+        rc = funcs->C_EncryptFinal(session, cipher, &part_len);
+        if (rc != CKR_OK) {
+            testcase_error("C_EncryptFinal rc=%s", p11_get_ckr(rc));
+            goto testcase_cleanup;
+        }
+    }
+    GetSystemTime(&t2);
+    tot_time = delta_time_us(&t1, &t2);
+
+    printf("multi-part:  %ld iterations of %d bytes: total=%ldms "
+           "%.3fMB/s\n", chunk_iterations, BIG_REQUEST, tot_time / 1000,
+           ((double) chunk_iterations * BIG_REQUEST / (double) (1024 * 1024)) *
+           1000000 / (double) tot_time);
+
+    testcase_pass("AES small message Encrypt with mode=%s keylen=%ld "
+                  "datalen=%ld", mode, key_len * 8, datalen);
+
+testcase_cleanup:
+    testcase_closeall_session();
+    if (rc != CKR_OK)
+        return FALSE;
+
+    return TRUE;
+}
+
 int do_SHA(const char *mode)
 {
     CK_SESSION_HANDLE session;
@@ -1009,11 +1194,659 @@ testcase_cleanup:
     return TRUE;
 }
 
+// batch: FALSE = C_DigestInit and C_Digest per record,
+//        TRUE = one C_IBM_DigestBatch call for SHA_BATCH_RECORDS records
+int do_SHA_SmallRecords(const char *mode, CK_ULONG data_len, CK_BBOOL batch)
+{
+    CK_SESSION_HANDLE session;
+    CK_MECHANISM mech;
+    CK_FLAGS flags;
+    CK_RV rc;
+
+    CK_BYTE *data = NULL;
+    CK_BYTE hashes[SHA_BATCH_RECORDS * MAX_HASH_LEN];
+    CK_IBM_DATA records[SHA_BATCH_RECORDS];
+    CK_ULONG hash_len, h_len;
+
+    SYSTEMTIME t1, t2;
+    CK_ULONG diff, avg_time, tot_time, min_time, max_time;
+    CK_ULONG i, j, iterations = 1000;
+
+    testcase_begin("SHA (%s) with %d records of datalen=%lu (%s)", mode,
+                   SHA_BATCH_RECORDS, data_len,
+                   batch ? "C_IBM_DigestBatch" : "C_Digest");
+
+    if (strcmp(mode, "SHA256") == 0) {
+        mech.mechanism = CKM_SHA256;
+        hash_len = SHA256_HASH_LEN;
+    } else if (strcmp(mode, "SHA512") == 0) {
+        mech.mechanism = CKM_SHA512;
+        hash_len = SHA512_HASH_LEN;
+    } else {
+        testcase_error("unknown mode %s in do_SHA_SmallRecords()", mode);
+        return FALSE;
+    }
+    mech.ulParameterLen = 0;
+    mech.pParameter = NULL;
+
+    if (!mech_supported(SLOT_ID, mech.mechanism)) {
+        testcase_skip("Slot %lu doesn't support %s (0x%lx)",
+                      SLOT_ID, mode, mech.mechanism);
+        return TRUE;
+    }
+    if (batch && _C_IBM_DigestBatch == NULL) {
+        testcase_skip("C_IBM_DigestBatch not supported");
+        return TRUE;
+    }
+
+    testcase_new_assertion();
+
+    testcase_rw_session();
+
+    // generate some data to hash, every record is different
+    //
+    data = malloc(SHA_BATCH_RECORDS * data_len);
+    if (data == NULL) {
+        testcase_error("malloc failed");
+        rc = CKR_HOST_MEMORY;
+        goto testcase_cleanup;
+    }
+    for (i = 0; i < SHA_BATCH_RECORDS * data_len; i++)
+        data[i] = i % 251;
+    for (j = 0; j < SHA_BATCH_RECORDS; j++) {
+        records[j].pData = data + j * data_len;
+        records[j].ulDataLen = data_len;
+    }
+
+    tot_time = 0;
+    max_time = 0;
+    min_time = 0xFFFFFFFF;
+
+    for (i = 0; i < iterations + 2; i++) {
+        GetSystemTime(&t1);
+
+        if (batch) {
+            h_len = sizeof(hashes);
+            rc = _C_IBM_DigestBatch(session, &mech, records,
+                                    SHA_BATCH_RECORDS, hashes, &h_len);
+            if (rc == CKR_FUNCTION_NOT_SUPPORTED) {
+                testcase_skip("Slot %lu doesn't support C_IBM_DigestBatch",
+                              SLOT_ID);
+                rc = CKR_OK;
+                goto testcase_cleanup;
+            }
+            if (rc != CKR_OK) {
+                testcase_error("C_IBM_DigestBatch rc=%s", p11_get_ckr(rc));
+                goto testcase_cleanup;
+            }
+        } else {
+            for (j = 0; j < SHA_BATCH_RECORDS; j++) {
+                rc = funcs->C_DigestInit(session, &mech);
+                if (rc != CKR_OK) {
+                    testcase_error("C_DigestInit rc=%s", p11_get_ckr(rc));
+                    goto testcase_cleanup;
+                }
+
+                h_len = MAX_HASH_LEN;
+                rc = funcs->C_Digest(session, records[j].pData,
+                                     records[j].ulDataLen,
+                                     hashes + j * hash_len, &h_len);
+                if (rc != CKR_OK) {
+                    testcase_error("C_Digest rc=%s", p11_get_ckr(rc));
+                    goto testcase_cleanup;
+                }
+            }
+            h_len = SHA_BATCH_RECORDS * hash_len;
+        }
+
+        GetSystemTime(&t2);
+
+        if (h_len != SHA_BATCH_RECORDS * hash_len) {
+            testcase_error
+                ("returned length %ld doesn't match to expected len %ld\n",
+                 h_len, SHA_BATCH_RECORDS * hash_len);
+            rc = CKR_FUNCTION_FAILED;
+            goto testcase_cleanup;
+        }
+
+        diff = delta_time_us(&t1, &t2);
+        tot_time += diff;
+        if (diff < min_time)
+            min_time = diff;
+
+        if (diff > max_time)
+            max_time = diff;
+    }
+
+    tot_time -= min_time;
+    tot_time -= max_time;
+    avg_time = tot_time / iterations;
+
+    // us -> ms
+    tot_time /= 1000;
+    if (tot_time == 0)
+        tot_time = 1;
+
+    printf("%ld iterations: total=%ldms min=%ldus max=%ldus avg=%ldus "
+           "records/s=%.3f %.3fMB/s\n", iterations, tot_time, min_time,
+           max_time, avg_time,
+           (double) (iterations * SHA_BATCH_RECORDS * 1000) / (double) tot_time,
+           (((double) (iterations * SHA_BATCH_RECORDS * 1000) /
+             (double) (1024 * 1024)) * data_len) / (double) tot_time);
+
+    testcase_pass("SHA (%s) with %d records of datalen=%lu (%s)", mode,
+                  SHA_BATCH_RECORDS, data_len,
+                  batch ? "C_IBM_DigestBatch" : "C_Digest");
+
+testcase_cleanup:
+    free(data);
+    testcase_closeall_session();
+    if (rc != CKR_OK)
+        return FALSE;
+
+    return TRUE;
+}
+
+// batch: FALSE = C_VerifyInit and C_Verify per signature,
+//        TRUE = one C_IBM_VerifyBatch call for EC_VERIFY_RECORDS signatures
+int do_ECDSA_VerifyBatch(CK_BBOOL batch)
+{
+    CK_SESSION_HANDLE session;
+    CK_MECHANISM mech = { CKM_EC_KEY_PAIR_GEN, NULL, 0 };
+    CK_FLAGS flags;
+    CK_BYTE user_pin[PKCS11_MAX_PIN_LEN];
+    CK_ULONG user_pin_len;
+    CK_RV rc;
+
+    CK_BYTE ec_params[] = OCK_PRIME256V1;
+    CK_BBOOL true = TRUE;
+    CK_ATTRIBUTE publ_tmpl[] = {
+        {CKA_VERIFY, &true, sizeof(true)},
+        {CKA_EC_PARAMS, ec_params, sizeof(ec_params)},
+    };
+    CK_ATTRIBUTE priv_tmpl[] = {
+        {CKA_SIGN, &true, sizeof(true)},
+    };
+    CK_OBJECT_HANDLE publ_keys[EC_VERIFY_KEYS], priv_keys[EC_VERIFY_KEYS];
+
+    CK_BYTE data[EC_VERIFY_RECORDS][100];
+    CK_BYTE signatures[EC_VERIFY_RECORDS][EC_MAX_SIG_LEN];
+    CK_IBM_VERIFY_DATA items[EC_VERIFY_RECORDS];
+    CK_RV results[EC_VERIFY_RECORDS];
+    CK_ULONG sig_len;
+
+    SYSTEMTIME t1, t2;
+    CK_ULONG diff, avg_time, tot_time, min_time, max_time;
+    CK_ULONG i, j, iterations = 100;
+
+    testcase_begin("ECDSA (P-256, SHA256) Verify with %d signatures of %d keys "
+                   "(%s)", EC_VERIFY_RECORDS, EC_VERIFY_KEYS,
+                   batch ? "C_IBM_VerifyBatch" : "C_Verify");
+
+    if (!mech_supported(SLOT_ID, CKM_EC_KEY_PAIR_GEN)) {
+        testcase_skip("Slot %lu doesn't support CKM_EC_KEY_PAIR_GEN (0x%x)",
+                      SLOT_ID, CKM_EC_KEY_PAIR_GEN);
+        return TRUE;
+    }
+    if (!mech_supported(SLOT_ID, CKM_ECDSA_SHA256)) {
+        testcase_skip("Slot %lu doesn't support CKM_ECDSA_SHA256 (0x%x)",
+                      SLOT_ID, CKM_ECDSA_SHA256);
+        return TRUE;
+    }
+    if (batch && _C_IBM_VerifyBatch == NULL) {
+        testcase_skip("C_IBM_VerifyBatch not supported");
+        return TRUE;
+    }
+
+    testcase_new_assertion();
+
+    testcase_rw_session();
+    testcase_user_login();
+
+    for (j = 0; j < EC_VERIFY_KEYS; j++) {
+        rc = funcs->C_GenerateKeyPair(session, &mech, publ_tmpl, 2,
+                                      priv_tmpl, 1, &publ_keys[j],
+                                      &priv_keys[j]);
+        if (rc != CKR_OK) {
+            testcase_error("C_GenerateKeyPair rc=%s", p11_get_ckr(rc));
+            goto testcase_cleanup;
+        }
+    }
+
+    // sign different data for every record, the keys are used in turn
+    //
+    mech.mechanism = CKM_ECDSA_SHA256;
+    for (j = 0; j < EC_VERIFY_RECORDS; j++) {
+        for (i = 0; i < sizeof(data[j]); i++)
+            data[j][i] = (i + j) % 251;
+
+        rc = funcs->C_SignInit(session, &mech, priv_keys[j % EC_VERIFY_KEYS]);
+        if (rc != CKR_OK) {
+            testcase_error("C_SignInit rc=%s", p11_get_ckr(rc));
+            goto testcase_cleanup;
+        }
+
+        sig_len = sizeof(signatures[j]);
+        rc = funcs->C_Sign(session, data[j], sizeof(data[j]), signatures[j],
+                           &sig_len);
+        if (rc != CKR_OK) {
+            testcase_error("C_Sign rc=%s", p11_get_ckr(rc));
+            goto testcase_cleanup;
+        }
+
+        items[j].hKey = publ_keys[j % EC_VERIFY_KEYS];
+        items[j].pData = data[j];
+        items[j].ulDataLen = sizeof(data[j]);
+        items[j].pSignature = signatures[j];
+        items[j].ulSignatureLen = sig_len;
+    }
+
+    tot_time = 0;
+    max_time = 0;
+    min_time = 0xFFFFFFFF;
+
+    for (i = 0; i < iterations + 2; i++) {
+        GetSystemTime(&t1);
+
+        if (batch) {
+            rc = _C_IBM_VerifyBatch(session, &mech, items, EC_VERIFY_RECORDS,
+                                    results);
+            if (rc == CKR_FUNCTION_NOT_SUPPORTED) {
+                testcase_skip("Slot %lu doesn't support C_IBM_VerifyBatch",
+                              SLOT_ID);
+                rc = CKR_OK;
+                goto testcase_cleanup;
+            }
+            if (rc != CKR_OK) {
+                testcase_error("C_IBM_VerifyBatch rc=%s", p11_get_ckr(rc));
+                goto testcase_cleanup;
+            }
+        } else {
+            for (j = 0; j < EC_VERIFY_RECORDS; j++) {
+                rc = funcs->C_VerifyInit(session, &mech, items[j].hKey);
+                if (rc != CKR_OK) {
+                    testcase_error("C_VerifyInit rc=%s", p11_get_ckr(rc));
+                    goto testcase_cleanup;
+                }
+
+                results[j] = funcs->C_Verify(session, items[j].pData,
+                                             items[j].ulDataLen,
+                                             items[j].pSignature,
+                                             items[j].ulSignatureLen);
+            }
+        }
+
+        GetSystemTime(&t2);
+
+        for (j = 0; j < EC_VERIFY_RECORDS; j++) {
+            if (results[j] != CKR_OK) {
+                testcase_error("Verify of signature %lu rc=%s", j,
+                               p11_get_ckr(results[j]));
+                rc = results[j];
+                goto testcase_cleanup;
+            }
+        }
+
+        diff = delta_time_us(&t1, &t2);
+        tot_time += diff;
+        if (diff < min_time)
+            min_time = diff;
+
+        if (diff > max_time)
+            max_time = diff;
+    }
+
+    tot_time -= min_time;
+    tot_time -= max_time;
+    avg_time = tot_time / iterations;
+
+    // us -> ms
+    tot_time /= 1000;
+    if (tot_time == 0)
+        tot_time = 1;
+
+    printf("%ld iterations: total=%ldms min=%ldus max=%ldus avg=%ldus "
+           "verify/s=%.3f\n", iterations, tot_time, min_time, max_time,
+           avg_time,
+           (double) (iterations * EC_VERIFY_RECORDS * 1000) /
+           (double) tot_time);
+
+    testcase_pass("ECDSA (P-256, SHA256) Verify with %d signatures of %d keys "
+                  "(%s)", EC_VERIFY_RECORDS, EC_VERIFY_KEYS,
+                  batch ? "C_IBM_VerifyBatch" : "C_Verify");
+
+testcase_cleanup:
+    testcase_closeall_session();
+    if (rc != CKR_OK)
+        return FALSE;
+
+    return TRUE;
+}
+
+// sign: TRUE = ECDSA P-256 with SHA256, FALSE = AES-256 CBC_PAD encrypt
+// async: FALSE = C_xxxInit and C_xxx per record,
+//        TRUE = C_IBM_SignAsync or C_IBM_EncryptAsync for all records, then
+//               wait for them with an eventfd and collect the results
+int do_AsyncOps(CK_BBOOL sign, CK_BBOOL async)
+{
+    CK_SESSION_HANDLE session;
+    CK_MECHANISM mech = { CKM_EC_KEY_PAIR_GEN, NULL, 0 };
+    CK_FLAGS flags;
+    CK_BYTE user_pin[PKCS11_MAX_PIN_LEN];
+    CK_ULONG user_pin_len;
+    CK_RV rc;
+
+    CK_BYTE ec_params[] = OCK_PRIME256V1;
+    CK_BBOOL true = TRUE;
+    CK_ATTRIBUTE publ_tmpl[] = {
+        {CKA_VERIFY, &true, sizeof(true)},
+        {CKA_EC_PARAMS, ec_params, sizeof(ec_params)},
+    };
+    CK_ATTRIBUTE priv_tmpl[] = {
+        {CKA_SIGN, &true, sizeof(true)},
+    };
+    CK_OBJECT_HANDLE publ_key, key;
+    CK_BYTE iv[16];
+    const char *name = sign ? "ECDSA (P-256, SHA256) Sign" :
+                              "AES-256 CBC_PAD Encrypt";
+
+    CK_BYTE *data = NULL, *out = NULL;
+    CK_ULONG out_lens[ASYNC_RECORDS], ops[ASYNC_RECORDS];
+    CK_BYTE check[ASYNC_OUT_LEN];
+    CK_ULONG check_len;
+    uint64_t events, done;
+    int efd = -1;
+
+    SYSTEMTIME t1, t2;
+    CK_ULONG diff, avg_time, tot_time, min_time, max_time;
+    CK_ULONG i, j, iterations = 100;
+
+    testcase_begin("%s of %d records of datalen=%d (%s)", name,
+                   ASYNC_RECORDS, ASYNC_DATA_LEN,
+                   async ? "asynchronous" : "synchronous");
+
+    if (sign && (!mech_supported(SLOT_ID, CKM_EC_KEY_PAIR_GEN) ||
+                 !mech_supported(SLOT_ID, CKM_ECDSA_SHA256))) {
+        testcase_skip("Slot %lu doesn't support ECDSA with SHA256", SLOT_ID);
+        return TRUE;
+    }
+    if (!sign && (!mech_supported(SLOT_ID, CKM_AES_KEY_GEN) ||
+                  !mech_supported(SLOT_ID, CKM_AES_CBC_PAD))) {
+        testcase_skip("Slot %lu doesn't support AES CBC_PAD", SLOT_ID);
+        return TRUE;
+    }
+    if (async && (_C_IBM_SignAsync == NULL || _C_IBM_EncryptAsync == NULL ||
+                  _C_IBM_AsyncWait == NULL)) {
+        testcase_skip("C_IBM_SignAsync/C_IBM_EncryptAsync not supported");
+        return TRUE;
+    }
+
+    testcase_new_assertion();
+
+    testcase_rw_session();
+    testcase_user_login();
+
+    if (sign) {
+        rc = funcs->C_GenerateKeyPair(session, &mech, publ_tmpl, 2,
+                                      priv_tmpl, 1, &publ_key, &key);
+        if (rc != CKR_OK) {
+            testcase_error("C_GenerateKeyPair rc=%s", p11_get_ckr(rc));
+            goto testcase_cleanup;
+        }
+        mech.mechanism = CKM_ECDSA_SHA256;
+    } else {
+        mech.mechanism = CKM_AES_KEY_GEN;
+        rc = generate_AESKey(session, 32, CK_TRUE, &mech, &key);
+        if (rc != CKR_OK)
+            goto testcase_cleanup;
+        memset(iv, 0x5a, sizeof(iv));
+        mech.mechanism = CKM_AES_CBC_PAD;
+        mech.pParameter = iv;
+        mech.ulParameterLen = sizeof(iv);
+    }
+
+    data = malloc(ASYNC_RECORDS * ASYNC_DATA_LEN);
+    out = malloc(ASYNC_RECORDS * ASYNC_OUT_LEN);
+    if (data == NULL || out == NULL) {
+        testcase_error("malloc failed");
+        rc = CKR_HOST_MEMORY;
+        goto testcase_cleanup;
+    }
+    for (i = 0; i < ASYNC_RECORDS * ASYNC_DATA_LEN; i++)
+        data[i] = i % 251;
+
+    if (async) {
+        efd = eventfd(0, EFD_CLOEXEC);
+        if (efd < 0) {
+            testcase_error("eventfd failed");
+            rc = CKR_FUNCTION_FAILED;
+            goto testcase_cleanup;
+        }
+    }
+
+    tot_time = 0;
+    max_time = 0;
+    min_time = 0xFFFFFFFF;
+
+    for (i = 0; i < iterations + 2; i++) {
+        GetSystemTime(&t1);
+
+        for (j = 0; j < ASYNC_RECORDS; j++) {
+            out_lens[j] = ASYNC_OUT_LEN;
+            if (async) {
+                if (sign)
+                    rc = _C_IBM_SignAsync(session, &mech, key,
+                                          data + j * ASYNC_DATA_LEN,
+                                          ASYNC_DATA_LEN,
+                                          out + j * ASYNC_OUT_LEN,
+                                          &out_lens[j], efd, &ops[j]);
+                else
+                    rc = _C_IBM_EncryptAsync(session, &mech, key,
+                                             data + j * ASYNC_DATA_LEN,
+                                             ASYNC_DATA_LEN,
+                                             out + j * ASYNC_OUT_LEN,
+                                             &out_lens[j], efd, &ops[j]);
+                if (rc == CKR_FUNCTION_NOT_SUPPORTED) {
+                    testcase_skip("Slot %lu doesn't support asynchronous "
+                                  "operations", SLOT_ID);
+                    rc = CKR_OK;
+                    goto testcase_cleanup;
+                }
+                if (rc != CKR_OK) {
+                    testcase_error("C_IBM_%sAsync rc=%s",
+                                   sign ? "Sign" : "Encrypt", p11_get_ckr(rc));
+                    goto testcase_cleanup;
+                }
+                continue;
+            }
+
+            if (sign) {
+                rc = funcs->C_SignInit(session, &mech, key);
+                if (rc == CKR_OK)
+                    rc = funcs->C_Sign(session, data + j * ASYNC_DATA_LEN,
+                                       ASYNC_DATA_LEN, out + j * ASYNC_OUT_LEN,
+                                       &out_lens[j]);
+            } else {
+                rc = funcs->C_EncryptInit(session, &mech, key);
+                if (rc == CKR_OK)
+                    rc = funcs->C_Encrypt(session, data + j * ASYNC_DATA_LEN,
+                                          ASYNC_DATA_LEN,
+                                          out + j * ASYNC_OUT_LEN,
+                                          &out_lens[j]);
+            }
+            if (rc != CKR_OK) {
+                testcase_error("C_%s rc=%s", sign ? "Sign" : "Encrypt",
+                               p11_get_ckr(rc));
+                goto testcase_cleanup;
+            }
+        }
+
+        if (async) {
+            // every completed operation increments the eventfd by one
+            for (done = 0; done < ASYNC_RECORDS; done += events) {
+                if (read(efd, &events, sizeof(events)) != sizeof(events)) {
+                    testcase_error("read of the eventfd failed");
+                    rc = CKR_FUNCTION_FAILED;
+                    goto testcase_cleanup;
+                }
+            }
+
+            for (j = 0; j < ASYNC_RECORDS; j++) {
+                rc = _C_IBM_AsyncWait(session, ops[j], FALSE);
+                if (rc != CKR_OK) {
+                    testcase_error("Operation %lu rc=%s", j, p11_get_ckr(rc));
+                    goto testcase_cleanup;
+                }
+            }
+        }
+
+        GetSystemTime(&t2);
+
+        diff = delta_time_us(&t1, &t2);
+        tot_time += diff;
+        if (diff < min_time)
+            min_time = diff;
+
+        if (diff > max_time)
+            max_time = diff;
+    }
+
+    // check the results of the last iteration
+    //
+    for (j = 0; j < ASYNC_RECORDS; j++) {
+        if (sign) {
+            rc = funcs->C_VerifyInit(session, &mech, publ_key);
+            if (rc == CKR_OK)
+                rc = funcs->C_Verify(session, data + j * ASYNC_DATA_LEN,
+                                     ASYNC_DATA_LEN, out + j * ASYNC_OUT_LEN,
+                                     out_lens[j]);
+        } else {
+            check_len = sizeof(check);
+            rc = funcs->C_EncryptInit(session, &mech, key);
+            if (rc == CKR_OK)
+                rc = funcs->C_Encrypt(session, data + j * ASYNC_DATA_LEN,
+                                      ASYNC_DATA_LEN, check, &check_len);
+            if (rc == CKR_OK && (check_len != out_lens[j] ||
+                                 memcmp(check, out + j * ASYNC_OUT_LEN,
+                                        check_len) != 0))
+                rc = CKR_ENCRYPTED_DATA_INVALID;
+        }
+        if (rc != CKR_OK) {
+            testcase_error("Result of record %lu is wrong, rc=%s", j,
+                           p11_get_ckr(rc));
+            goto testcase_cleanup;
+        }
+    }
+
+    tot_time -= min_time;
+    tot_time -= max_time;
+    avg_time = tot_time / iterations;
+
+    // us -> ms
+    tot_time /= 1000;
+    if (tot_time == 0)
+        tot_time = 1;
+
+    printf("%ld iterations: total=%ldms min=%ldus max=%ldus avg=%ldus "
+           "op/s=%.3f\n", iterations, tot_time, min_time, max_time, avg_time,
+           (double) (iterations * ASYNC_RECORDS * 1000) / (double) tot_time);
+
+    testcase_pass("%s of %d records of datalen=%d (%s)", name,
+                  ASYNC_RECORDS, ASYNC_DATA_LEN,
+                  async ? "asynchronous" : "synchronous");
+
+testcase_cleanup:
+    if (efd >= 0)
+        close(efd);
+    free(data);
+    free(out);
+    testcase_closeall_session();
+    if (rc != CKR_OK)
+        return FALSE;
+
+    return TRUE;
+}
+
+int do_GenerateRandom(CK_ULONG data_len)
+{
+    CK_SESSION_HANDLE session;
+    CK_FLAGS flags;
+    CK_RV rc;
+
+    CK_BYTE *data = NULL;
+
+    SYSTEMTIME t1, t2;
+    CK_ULONG diff, avg_time, tot_time, min_time, max_time;
+    CK_ULONG i, iterations = 20000;
+
+    testcase_begin("C_GenerateRandom with datalen=%lu", data_len);
+
+    testcase_new_assertion();
+
+    testcase_rw_session();
+
+    data = malloc(data_len);
+    if (data == NULL) {
+        testcase_error("malloc failed");
+        rc = CKR_HOST_MEMORY;
+        goto testcase_cleanup;
+    }
+
+    tot_time = 0;
+    max_time = 0;
+    min_time = 0xFFFFFFFF;
+
+    for (i = 0; i < iterations + 2; i++) {
+        GetSystemTime(&t1);
+
+        rc = funcs->C_GenerateRandom(session, data, data_len);
+        if (rc != CKR_OK) {
+            testcase_error("C_GenerateRandom rc=%s", p11_get_ckr(rc));
+            goto testcase_cleanup;
+        }
+
+        GetSystemTime(&t2);
+        diff = delta_time_us(&t1, &t2);
+        tot_time += diff;
+        if (diff < min_time)
+            min_time = diff;
+
+        if (diff > max_time)
+            max_time = diff;
+    }
+
+    tot_time -= min_time;
+    tot_time -= max_time;
+    avg_time = tot_time / iterations;
+
+    // us -> ms
+    tot_time /= 1000;
+    if (tot_time == 0)
+        tot_time = 1;
+
+    printf("%ld iterations: total=%ldms min=%ldus max=%ldus avg=%ldus "
+           "op/s=%.3f %.3fMB/s\n", iterations, tot_time, min_time, max_time,
+           avg_time, (double) (iterations * 1000) / (double) tot_time,
+           (((double) (iterations * 1000) / (double) (1024 * 1024)) *
+            data_len) / (double) tot_time);
+
+    testcase_pass("C_GenerateRandom with datalen=%lu", data_len);
+
+testcase_cleanup:
+    free(data);
+    testcase_closeall_session();
+    if (rc != CKR_OK)
+        return FALSE;
+
+    return TRUE;
+}
+
 void speed_usage(char *fct)
 {
     printf("usage:  %s -slot <num>", fct);
     printf(" [-rsa_keygen] [-rsa_signverify]");
-    printf(" [-rsa_endecrypt] [-des3] [-aes] [-sha]");
+    printf(" [-rsa_endecrypt] [-des3] [-aes] [-aes_small] [-sha] [-sha_small]");
+    printf(" [-rng] [-ec_verify_batch] [-async]");
     printf(" [-h] \n\n");
 
     return;
@@ -1028,7 +1861,19 @@ int main(int argc, char **argv)
     int do_rsa_endecrypt = 0;
     int do_des3_endecrypt = 0;
     int do_aes_endecrypt = 0;
+    int do_aes_small = 0;
     int do_sha = 0;
+    int do_rng = 0;
+    int do_sha_small = 0;
+    int do_ec_verify_batch = 0;
+    int do_async = 0;
+    CK_ULONG sha_small_lens[] = { 64, 256 };
+    const char *sha_small_modes[] = { "SHA256", "SHA512" };
+    CK_ULONG rng_lens[] = { 16, 32, 256, 4096, 65536 };
+    CK_ULONG small_lens[] = { 16, 64, 256 };
+    const char *small_modes[] = { "ECB", "CBC" };
+    int small_keylens[] = { 128, 256 };
+    unsigned int j, k, l;
 
     SLOT_ID = 1000;
 
@@ -1052,8 +1897,18 @@ int main(int argc, char **argv)
             do_des3_endecrypt = 1;
         } else if (strcmp(argv[i], "-aes") == 0) {
             do_aes_endecrypt = 1;
+        } else if (strcmp(argv[i], "-aes_small") == 0) {
+            do_aes_small = 1;
         } else if (strcmp(argv[i], "-sha") == 0) {
             do_sha = 1;
+        } else if (strcmp(argv[i], "-sha_small") == 0) {
+            do_sha_small = 1;
+        } else if (strcmp(argv[i], "-rng") == 0) {
+            do_rng = 1;
+        } else if (strcmp(argv[i], "-ec_verify_batch") == 0) {
+            do_ec_verify_batch = 1;
+        } else if (strcmp(argv[i], "-async") == 0) {
+            do_async = 1;
         } else if (strcmp(argv[i], "-h") == 0) {
             speed_usage(argv[0]);
             return 0;
@@ -1072,13 +1927,19 @@ int main(int argc, char **argv)
     }
 
     if (do_rsa_keygen + do_rsa_signverify + do_rsa_endecrypt
-        + do_des3_endecrypt + do_aes_endecrypt + do_sha == 0) {
+        + do_des3_endecrypt + do_aes_endecrypt + do_aes_small + do_sha
+        + do_sha_small + do_rng + do_ec_verify_batch + do_async == 0) {
         do_rsa_keygen = 1;
         do_rsa_signverify = 1;
         do_rsa_endecrypt = 1;
         do_des3_endecrypt = 1;
         do_aes_endecrypt = 1;
+        do_aes_small = 1;
         do_sha = 1;
+        do_sha_small = 1;
+        do_rng = 1;
+        do_ec_verify_batch = 1;
+        do_async = 1;
     }
 
     printf("Using slot #%lu...\n\n", SLOT_ID);
@@ -1087,6 +1948,12 @@ int main(int argc, char **argv)
     if (!rc)
         return rc;
 
+    *(void **)(&_C_IBM_DigestBatch) = dlsym(pkcs11lib, "C_IBM_DigestBatch");
+    *(void **)(&_C_IBM_VerifyBatch) = dlsym(pkcs11lib, "C_IBM_VerifyBatch");
+    *(void **)(&_C_IBM_SignAsync) = dlsym(pkcs11lib, "C_IBM_SignAsync");
+    *(void **)(&_C_IBM_EncryptAsync) = dlsym(pkcs11lib, "C_IBM_EncryptAsync");
+    *(void **)(&_C_IBM_AsyncWait) = dlsym(pkcs11lib, "C_IBM_AsyncWait");
+
     memset(&cinit_args, 0x0, sizeof(cinit_args));
     cinit_args.flags = CKF_OS_LOCKING_OK;
 
@@ -1165,6 +2032,20 @@ int main(int argc, char **argv)
             goto out;
     }
 
+    if (do_aes_small) {
+        testsuite_begin("AES small message Encrypt.");
+        for (j = 0; j < sizeof(small_keylens) / sizeof(int); j++) {
+            for (k = 0; k < sizeof(small_modes) / sizeof(char *); k++) {
+                for (l = 0; l < sizeof(small_lens) / sizeof(CK_ULONG); l++) {
+                    rc = do_AES_SmallMsg(small_keylens[j], small_modes[k],
+                                         small_lens[l]);
+                    if (!rc)
+                        goto out;
+                }
+            }
+        }
+    }
+
     if (do_sha) {
         testsuite_begin("SHA Digest.");
         rc = do_SHA("SHA1");
@@ -1178,6 +2059,57 @@ int main(int argc, char **argv)
             goto out;
     }
 
+    if (do_sha_small) {
+        testsuite_begin("SHA Digest of small records.");
+        for (j = 0; j < sizeof(sha_small_modes) / sizeof(char *); j++) {
+            for (k = 0; k < sizeof(sha_small_lens) / sizeof(CK_ULONG); k++) {
+                rc = do_SHA_SmallRecords(sha_small_modes[j],
+                                         sha_small_lens[k], FALSE);
+                if (!rc)
+                    goto out;
+                rc = do_SHA_SmallRecords(sha_small_modes[j],
+                                         sha_small_lens[k], TRUE);
+                if (!rc)
+                    goto out;
+            }
+        }
+    }
+
+    if (do_rng) {
+        testsuite_begin("Random number generation.");
+        for (j = 0; j < sizeof(rng_lens) / sizeof(CK_ULONG); j++) {
+            rc = do_GenerateRandom(rng_lens[j]);
+            if (!rc)
+                goto out;
+        }
+    }
+
+    if (do_ec_verify_batch) {
+        testsuite_begin("ECDSA batch Verify.");
+        rc = do_ECDSA_VerifyBatch(FALSE);
+        if (!rc)
+            goto out;
+        rc = do_ECDSA_VerifyBatch(TRUE);
+        if (!rc)
+            goto out;
+    }
+
+    if (do_async) {
+        testsuite_begin("Asynchronous Sign and Encrypt.");
+        rc = do_AsyncOps(TRUE, FALSE);
+        if (!rc)
+            goto out;
+        rc = do_AsyncOps(TRUE, TRUE);
+        if (!rc)
+            goto out;
+        rc = do_AsyncOps(FALSE, FALSE);
+        if (!rc)
+            goto out;
+        rc = do_AsyncOps(FALSE, TRUE);
+        if (!rc)
+            goto out;
+    }
+
 out:
     testcase_print_result();
 
@@ -0,0 +1,460 @@
+/*
+ * COPYRIGHT (c) International Business Machines Corp. 2024
+ *
+ * This program is provided under the terms of the Common Public License,
+ * version 1.0 (CPL-1.0). Any use, reproduction or distribution for this
+ * software constitutes recipient's acceptance of CPL-1.0 terms which can be
+ * found in the file LICENSE file or at
+ * https://opensource.org/licenses/cpl1.0.php
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <memory.h>
+#include <dlfcn.h>
+#include <poll.h>
+#include <stdint.h>
+#include <sys/eventfd.h>
+
+#include "pkcs11types.h"
+#include "ec_curves.h"
+#include "regress.h"
+#include "common.c"
+
+#define NUM_OPS         8
+#define MAX_SIG_LEN     256
+#define DATA_LEN        64
+#define TIMEOUT_MS      10000
+
+CK_C_IBM_SignAsync _C_IBM_SignAsync;
+CK_C_IBM_EncryptAsync _C_IBM_EncryptAsync;
+CK_C_IBM_AsyncWait _C_IBM_AsyncWait;
+
+/*
+ * Waits until the eventfd was incremented count times, or the timeout
+ * expired.
+ */
+static CK_RV wait_notifications(int efd, CK_ULONG count)
+{
+    struct pollfd pfd;
+    uint64_t val;
+    CK_ULONG notified = 0;
+
+    pfd.fd = efd;
+    pfd.events = POLLIN;
+
+    while (notified < count) {
+        if (poll(&pfd, 1, TIMEOUT_MS) != 1) {
+            testcase_fail("Got %lu of %lu notifications", notified, count);
+            return CKR_FUNCTION_FAILED;
+        }
+        if (read(efd, &val, sizeof(val)) != sizeof(val)) {
+            testcase_error("read of the eventfd failed");
+            return CKR_FUNCTION_FAILED;
+        }
+        notified += val;
+    }
+
+    if (notified != count) {
+        testcase_fail("Got %lu notifications for %lu operations", notified,
+                      count);
+        return CKR_FUNCTION_FAILED;
+    }
+
+    return CKR_OK;
+}
+
+static CK_RV verify_signature(CK_SESSION_HANDLE session,
+                              CK_OBJECT_HANDLE publ_key, CK_BYTE *data,
+                              CK_BYTE *sig, CK_ULONG sig_len)
+{
+    CK_MECHANISM mech = { CKM_ECDSA_SHA256, NULL, 0 };
+    CK_RV rc;
+
+    rc = funcs->C_VerifyInit(session, &mech, publ_key);
+    if (rc != CKR_OK) {
+        testcase_error("C_VerifyInit() rc = %s", p11_get_ckr(rc));
+        return rc;
+    }
+
+    rc = funcs->C_Verify(session, data, DATA_LEN, sig, sig_len);
+    if (rc != CKR_OK)
+        testcase_fail("C_Verify() of an asynchronous signature rc = %s",
+                      p11_get_ckr(rc));
+
+    return rc;
+}
+
+/* API Routines exercised:
+ * C_IBM_SignAsync
+ * C_IBM_EncryptAsync
+ * C_IBM_AsyncWait
+ * C_Verify
+ * C_Encrypt
+ *
+ * 5 TestCases
+ * Setup: Generate an EC key pair and an AES key, and create a generic
+ *        secret key.
+ * Testcase 1: Start a signature and poll for its result.
+ * Testcase 2: Start several encryptions with an eventfd, wait for their
+ *             notifications, and compare their results with C_Encrypt.
+ * Testcase 3: Collect a result with another session, and twice.
+ * Testcase 4: Start a signature with a HMAC mechanism.
+ * Testcase 5: Close a session while its operations are running.
+ */
+CK_RV do_Async(void)
+{
+    CK_FLAGS flags;
+    CK_SESSION_HANDLE session, session2 = CK_INVALID_HANDLE;
+    CK_SESSION_HANDLE session3 = CK_INVALID_HANDLE;
+    CK_RV rc = 0;
+    CK_BYTE user_pin[PKCS11_MAX_PIN_LEN];
+    CK_ULONG user_pin_len;
+
+    CK_MECHANISM mech = { CKM_EC_KEY_PAIR_GEN, NULL, 0 };
+    CK_MECHANISM aes_gen_mech = { CKM_AES_KEY_GEN, NULL, 0 };
+    CK_BYTE iv[16] = { 0 };
+    CK_MECHANISM aes_mech = { CKM_AES_CBC, iv, sizeof(iv) };
+    CK_MECHANISM hmac_mech = { CKM_SHA256_HMAC, NULL, 0 };
+    CK_BYTE ec_params[] = OCK_PRIME256V1;
+    CK_BBOOL true = TRUE;
+    CK_ULONG aes_len = 32;
+    CK_OBJECT_CLASS key_class = CKO_SECRET_KEY;
+    CK_KEY_TYPE generic_type = CKK_GENERIC_SECRET;
+    CK_BYTE secret[32] = { 0 };
+    CK_ATTRIBUTE publ_tmpl[] = {
+        {CKA_VERIFY, &true, sizeof(true)},
+        {CKA_EC_PARAMS, ec_params, sizeof(ec_params)},
+    };
+    CK_ATTRIBUTE priv_tmpl[] = {
+        {CKA_SIGN, &true, sizeof(true)},
+    };
+    CK_ATTRIBUTE aes_tmpl[] = {
+        {CKA_VALUE_LEN, &aes_len, sizeof(aes_len)},
+        {CKA_ENCRYPT, &true, sizeof(true)},
+    };
+    CK_ATTRIBUTE hmac_tmpl[] = {
+        {CKA_CLASS, &key_class, sizeof(key_class)},
+        {CKA_KEY_TYPE, &generic_type, sizeof(generic_type)},
+        {CKA_VALUE, secret, sizeof(secret)},
+        {CKA_SIGN, &true, sizeof(true)},
+    };
+    CK_OBJECT_HANDLE publ_key = CK_INVALID_HANDLE;
+    CK_OBJECT_HANDLE priv_key = CK_INVALID_HANDLE;
+    CK_OBJECT_HANDLE aes_key = CK_INVALID_HANDLE;
+    CK_OBJECT_HANDLE hmac_key = CK_INVALID_HANDLE;
+
+    CK_BYTE data[NUM_OPS][DATA_LEN];
+    CK_BYTE out[NUM_OPS][MAX_SIG_LEN];
+    CK_ULONG out_len[NUM_OPS];
+    CK_BYTE expected[DATA_LEN];
+    CK_ULONG expected_len;
+    CK_ULONG ops[NUM_OPS], op;
+    CK_ULONG i, polls;
+    int efd = -1;
+
+    testcase_begin("starting...");
+
+    if (!mech_supported(SLOT_ID, CKM_EC_KEY_PAIR_GEN) ||
+        !mech_supported(SLOT_ID, CKM_ECDSA_SHA256) ||
+        !mech_supported(SLOT_ID, CKM_AES_KEY_GEN) ||
+        !mech_supported(SLOT_ID, CKM_AES_CBC)) {
+        testcase_skip("Slot %lu doesn't support the mechanisms of the test",
+                      SLOT_ID);
+        return CKR_OK;
+    }
+
+    for (i = 0; i < NUM_OPS; i++)
+        memset(data[i], (int)i + 1, DATA_LEN);
+
+    testcase_rw_session();
+    testcase_user_login();
+
+    rc = funcs->C_GenerateKeyPair(session, &mech, publ_tmpl, 2, priv_tmpl, 1,
+                                  &publ_key, &priv_key);
+    if (rc != CKR_OK) {
+        if (is_rejected_by_policy(rc, session)) {
+            testcase_skip("EC key generation is not allowed by policy");
+            rc = CKR_OK;
+            goto testcase_cleanup;
+        }
+        testcase_error("C_GenerateKeyPair() rc = %s", p11_get_ckr(rc));
+        goto testcase_cleanup;
+    }
+    rc = funcs->C_GenerateKey(session, &aes_gen_mech, aes_tmpl, 2, &aes_key);
+    if (rc != CKR_OK) {
+        if (is_rejected_by_policy(rc, session)) {
+            testcase_skip("AES key generation is not allowed by policy");
+            rc = CKR_OK;
+            goto testcase_cleanup;
+        }
+        testcase_error("C_GenerateKey() rc = %s", p11_get_ckr(rc));
+        goto testcase_cleanup;
+    }
+
+    efd = eventfd(0, EFD_CLOEXEC);
+    if (efd < 0) {
+        testcase_error("eventfd failed");
+        rc = CKR_FUNCTION_FAILED;
+        goto testcase_cleanup;
+    }
+
+    /* Testcase 1: poll for the result of a signature */
+    testcase_new_assertion();
+
+    mech.mechanism = CKM_ECDSA_SHA256;
+    out_len[0] = sizeof(out[0]);
+    rc = _C_IBM_SignAsync(session, &mech, priv_key, data[0], DATA_LEN,
+                          out[0], &out_len[0], -1, &op);
+    if (rc != CKR_OK) {
+        if (rc == CKR_FUNCTION_NOT_SUPPORTED) {
+            testcase_skip("Slot %lu doesn't support C_IBM_SignAsync",
+                          SLOT_ID);
+            rc = CKR_OK;
+            goto testcase_cleanup;
+        }
+        testcase_fail("C_IBM_SignAsync() rc = %s", p11_get_ckr(rc));
+        goto testcase_cleanup;
+    }
+
+    for (polls = 0; polls < TIMEOUT_MS; polls++) {
+        rc = _C_IBM_AsyncWait(session, op, FALSE);
+        if (rc != CKR_IBM_ASYNC_PENDING)
+            break;
+        usleep(1000);
+    }
+    if (rc != CKR_OK) {
+        testcase_fail("C_IBM_AsyncWait() rc = %s after %lu polls",
+                      p11_get_ckr(rc), polls);
+        goto testcase_cleanup;
+    }
+    rc = verify_signature(session, publ_key, data[0], out[0], out_len[0]);
+    if (rc != CKR_OK)
+        goto testcase_cleanup;
+
+    testcase_pass("Got the signature after %lu polls.", polls);
+
+    /* Testcase 2: wait for the notifications of several encryptions */
+    testcase_new_assertion();
+
+    for (i = 0; i < NUM_OPS; i++) {
+        out_len[i] = sizeof(out[i]);
+        rc = _C_IBM_EncryptAsync(session, &aes_mech, aes_key, data[i],
+                                 DATA_LEN, out[i], &out_len[i], efd, &ops[i]);
+        if (rc != CKR_OK) {
+            testcase_fail("C_IBM_EncryptAsync() rc = %s", p11_get_ckr(rc));
+            goto testcase_cleanup;
+        }
+    }
+
+    rc = wait_notifications(efd, NUM_OPS);
+    if (rc != CKR_OK)
+        goto testcase_cleanup;
+
+    for (i = 0; i < NUM_OPS; i++) {
+        /* notified operations are done */
+        rc = _C_IBM_AsyncWait(session, ops[i], FALSE);
+        if (rc != CKR_OK) {
+            testcase_fail("C_IBM_AsyncWait() of operation %lu rc = %s", i,
+                          p11_get_ckr(rc));
+            goto testcase_cleanup;
+        }
+
+        rc = funcs->C_EncryptInit(session, &aes_mech, aes_key);
+        if (rc != CKR_OK) {
+            testcase_error("C_EncryptInit() rc = %s", p11_get_ckr(rc));
+            goto testcase_cleanup;
+        }
+        expected_len = sizeof(expected);
+        rc = funcs->C_Encrypt(session, data[i], DATA_LEN, expected,
+                              &expected_len);
+        if (rc != CKR_OK) {
+            testcase_error("C_Encrypt() rc = %s", p11_get_ckr(rc));
+            goto testcase_cleanup;
+        }
+        if (out_len[i] != expected_len ||
+            memcmp(out[i], expected, expected_len) != 0) {
+            testcase_fail("Operation %lu: result differs from C_Encrypt", i);
+            rc = CKR_FUNCTION_FAILED;
+            goto testcase_cleanup;
+        }
+    }
+
+    testcase_pass("Got %d notifications and results.", NUM_OPS);
+
+    /* Testcase 3: collect with the wrong session, and twice */
+    testcase_new_assertion();
+
+    rc = funcs->C_OpenSession(SLOT_ID, flags, NULL, NULL, &session2);
+    if (rc != CKR_OK) {
+        testcase_error("C_OpenSession() rc = %s", p11_get_ckr(rc));
+        goto testcase_cleanup;
+    }
+
+    out_len[0] = sizeof(out[0]);
+    rc = _C_IBM_SignAsync(session, &mech, priv_key, data[0], DATA_LEN,
+                          out[0], &out_len[0], -1, &op);
+    if (rc != CKR_OK) {
+        testcase_fail("C_IBM_SignAsync() rc = %s", p11_get_ckr(rc));
+        goto testcase_cleanup;
+    }
+
+    rc = _C_IBM_AsyncWait(session2, op, TRUE);
+    if (rc != CKR_ARGUMENTS_BAD) {
+        testcase_fail("C_IBM_AsyncWait() with another session rc = %s "
+                      "(expected CKR_ARGUMENTS_BAD)", p11_get_ckr(rc));
+        rc = CKR_FUNCTION_FAILED;
+        goto testcase_cleanup;
+    }
+    rc = _C_IBM_AsyncWait(session, op, TRUE);
+    if (rc != CKR_OK) {
+        testcase_fail("C_IBM_AsyncWait() rc = %s", p11_get_ckr(rc));
+        goto testcase_cleanup;
+    }
+    rc = _C_IBM_AsyncWait(session, op, TRUE);
+    if (rc != CKR_ARGUMENTS_BAD) {
+        testcase_fail("C_IBM_AsyncWait() of a collected operation rc = %s "
+                      "(expected CKR_ARGUMENTS_BAD)", p11_get_ckr(rc));
+        rc = CKR_FUNCTION_FAILED;
+        goto testcase_cleanup;
+    }
+
+    testcase_pass("Results can only be collected once, by their session.");
+
+    /* Testcase 4: HMAC keeps its state in the session */
+    testcase_new_assertion();
+
+    rc = funcs->C_CreateObject(session, hmac_tmpl, 4, &hmac_key);
+    if (rc != CKR_OK) {
+        if (is_rejected_by_policy(rc, session)) {
+            testcase_skip("Key import is not allowed by policy");
+            rc = CKR_OK;
+            goto testcase5;
+        }
+        testcase_error("C_CreateObject() rc = %s", p11_get_ckr(rc));
+        goto testcase_cleanup;
+    }
+
+    out_len[0] = sizeof(out[0]);
+    rc = _C_IBM_SignAsync(session, &hmac_mech, hmac_key, data[0], DATA_LEN,
+                          out[0], &out_len[0], -1, &op);
+    if (rc != CKR_MECHANISM_INVALID) {
+        testcase_fail("C_IBM_SignAsync() with CKM_SHA256_HMAC rc = %s "
+                      "(expected CKR_MECHANISM_INVALID)", p11_get_ckr(rc));
+        if (rc == CKR_OK)
+            _C_IBM_AsyncWait(session, op, TRUE);
+        rc = CKR_FUNCTION_FAILED;
+        goto testcase_cleanup;
+    }
+
+    testcase_pass("HMAC signatures are rejected.");
+
+testcase5:
+    /* Testcase 5: close a session while its operations are running */
+    testcase_new_assertion();
+
+    rc = funcs->C_OpenSession(SLOT_ID, flags, NULL, NULL, &session3);
+    if (rc != CKR_OK) {
+        testcase_error("C_OpenSession() rc = %s", p11_get_ckr(rc));
+        goto testcase_cleanup;
+    }
+
+    for (i = 0; i < NUM_OPS; i++) {
+        out_len[i] = sizeof(out[i]);
+        rc = _C_IBM_SignAsync(session3, &mech, priv_key, data[i], DATA_LEN,
+                              out[i], &out_len[i], efd, &ops[i]);
+        if (rc != CKR_OK) {
+            testcase_fail("C_IBM_SignAsync() rc = %s", p11_get_ckr(rc));
+            goto testcase_cleanup;
+        }
+    }
+
+    rc = funcs->C_CloseSession(session3);
+    session3 = CK_INVALID_HANDLE;
+    if (rc != CKR_OK) {
+        testcase_fail("C_CloseSession() with running operations rc = %s",
+                      p11_get_ckr(rc));
+        goto testcase_cleanup;
+    }
+
+    /* the operations still complete, and are freed with the token */
+    rc = wait_notifications(efd, NUM_OPS);
+    if (rc != CKR_OK)
+        goto testcase_cleanup;
+
+    for (i = 0; i < NUM_OPS; i++) {
+        rc = verify_signature(session, publ_key, data[i], out[i], out_len[i]);
+        if (rc != CKR_OK)
+            goto testcase_cleanup;
+    }
+
+    testcase_pass("Operations complete after their session was closed.");
+
+testcase_cleanup:
+    if (efd >= 0)
+        close(efd);
+    if (publ_key != CK_INVALID_HANDLE)
+        funcs->C_DestroyObject(session, publ_key);
+    if (priv_key != CK_INVALID_HANDLE)
+        funcs->C_DestroyObject(session, priv_key);
+    if (aes_key != CK_INVALID_HANDLE)
+        funcs->C_DestroyObject(session, aes_key);
+    if (hmac_key != CK_INVALID_HANDLE)
+        funcs->C_DestroyObject(session, hmac_key);
+    if (session3 != CK_INVALID_HANDLE)
+        funcs->C_CloseSession(session3);
+    if (session2 != CK_INVALID_HANDLE)
+        funcs->C_CloseSession(session2);
+
+    testcase_user_logout();
+    if (funcs->C_CloseSession(session) != CKR_OK)
+        testcase_error("C_CloseSession failed");
+
+    return rc;
+}
+
+int main(int argc, char **argv)
+{
+    int rc;
+    CK_C_INITIALIZE_ARGS cinit_args;
+    CK_RV rv = 0;
+
+    rc = do_ParseArgs(argc, argv);
+    if (rc != 1)
+        return rc;
+
+    printf("Using slot #%lu...\n\n", SLOT_ID);
+    printf("With option: nostop: %d\n", no_stop);
+
+    rc = do_GetFunctionList();
+    if (!rc) {
+        testcase_error("do_getFunctionList(), rc=%s", p11_get_ckr(rc));
+        return rc;
+    }
+
+    testcase_setup();
+
+    *(void **)(&_C_IBM_SignAsync) = dlsym(pkcs11lib, "C_IBM_SignAsync");
+    *(void **)(&_C_IBM_EncryptAsync) = dlsym(pkcs11lib, "C_IBM_EncryptAsync");
+    *(void **)(&_C_IBM_AsyncWait) = dlsym(pkcs11lib, "C_IBM_AsyncWait");
+    if (_C_IBM_SignAsync == NULL || _C_IBM_EncryptAsync == NULL ||
+        _C_IBM_AsyncWait == NULL) {
+        testcase_skip("C_IBM_SignAsync/C_IBM_EncryptAsync not supported");
+        testcase_print_result();
+        return 0;
+    }
+
+    memset(&cinit_args, 0x0, sizeof(cinit_args));
+    cinit_args.flags = CKF_OS_LOCKING_OK;
+
+    funcs->C_Initialize(&cinit_args);
+
+    rv = do_Async();
+    testcase_print_result();
+
+    funcs->C_Finalize(NULL);
+
+    return testcase_return(rv);
+}
@@ -0,0 +1,335 @@
+/*
+ * COPYRIGHT (c) International Business Machines Corp. 2024
+ *
+ * This program is provided under the terms of the Common Public License,
+ * version 1.0 (CPL-1.0). Any use, reproduction or distribution for this
+ * software constitutes recipient's acceptance of CPL-1.0 terms which can be
+ * found in the file LICENSE file or at
+ * https://opensource.org/licenses/cpl1.0.php
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <memory.h>
+#include <dlfcn.h>
+
+#include "pkcs11types.h"
+#include "regress.h"
+#include "common.c"
+
+#define NUM_OBJS        8
+#define INVALID_OBJ     5
+
+CK_C_IBM_CreateObjects _C_IBM_CreateObjects;
+
+/*
+ * Counts the objects with the application, and checks that they are the
+ * ones in handles.
+ */
+static CK_RV find_app_objects(CK_SESSION_HANDLE session, CK_CHAR *app,
+                              CK_ULONG app_len, CK_OBJECT_HANDLE *handles,
+                              CK_ULONG num_handles, CK_ULONG *find_count,
+                              CK_ULONG *not_found)
+{
+    CK_ATTRIBUTE search_tmpl[] = {
+        {CKA_APPLICATION, app, app_len},
+    };
+    CK_OBJECT_HANDLE obj_list[NUM_OBJS + 1];
+    CK_ULONG i, j;
+    CK_RV rc;
+
+    *find_count = 0;
+    *not_found = 0;
+
+    rc = funcs->C_FindObjectsInit(session, search_tmpl, 1);
+    if (rc != CKR_OK) {
+        testcase_fail("C_FindObjectsInit() rc = %s", p11_get_ckr(rc));
+        return rc;
+    }
+
+    rc = funcs->C_FindObjects(session, obj_list, NUM_OBJS + 1, find_count);
+    if (rc != CKR_OK) {
+        testcase_fail("C_FindObjects() rc = %s", p11_get_ckr(rc));
+        funcs->C_FindObjectsFinal(session);
+        return rc;
+    }
+
+    rc = funcs->C_FindObjectsFinal(session);
+    if (rc != CKR_OK) {
+        testcase_fail("C_FindObjectsFinal() rc = %s", p11_get_ckr(rc));
+        return rc;
+    }
+
+    for (i = 0; i < *find_count; i++) {
+        for (j = 0; j < num_handles && obj_list[i] != handles[j]; j++)
+            ;
+        if (j == num_handles)
+            (*not_found)++;
+    }
+
+    return CKR_OK;
+}
+
+/* API Routines exercised:
+ * C_IBM_CreateObjects
+ * C_GetAttributeValue
+ * C_FindObjectsInit
+ * C_FindObjects
+ * C_DestroyObject
+ *
+ * 3 TestCases
+ * Setup: Build templates for session and token objects, public and private.
+ * Testcase 1: Create all objects in one call, and check their handles and
+ *             labels.
+ * Testcase 2: Create a batch that contains one invalid template, and check
+ *             that none of the objects of the batch is left behind.
+ * Testcase 3: Create an empty batch.
+ */
+CK_RV do_CreateObjects(void)
+{
+    CK_FLAGS flags;
+    CK_SESSION_HANDLE session;
+    CK_RV rc = 0;
+    CK_BYTE user_pin[PKCS11_MAX_PIN_LEN];
+    CK_ULONG user_pin_len;
+
+    CK_OBJECT_HANDLE objs[NUM_OBJS];
+    CK_IBM_OBJECT_TEMPLATE templates[NUM_OBJS];
+    CK_ATTRIBUTE data_tmpl[NUM_OBJS][5];
+    CK_BYTE labels[NUM_OBJS][32];
+    CK_BYTE label[32];
+    CK_ATTRIBUTE label_attr;
+    CK_ULONG created = 0;
+    CK_ULONG find_count, not_found;
+    CK_ULONG i, j;
+
+    CK_OBJECT_CLASS data_class = CKO_DATA;
+    CK_OBJECT_CLASS key_class = CKO_SECRET_KEY;
+    CK_KEY_TYPE aes_type = CKK_AES;
+    CK_BBOOL true = TRUE;
+    CK_BBOOL false = FALSE;
+    CK_CHAR app1[] = "createobjects batch";
+    CK_CHAR app2[] = "createobjects failing batch";
+
+    /* a secret key without a value is incomplete */
+    CK_ATTRIBUTE invalid_tmpl[] = {
+        {CKA_CLASS, &key_class, sizeof(key_class)},
+        {CKA_KEY_TYPE, &aes_type, sizeof(aes_type)},
+        {CKA_APPLICATION, app2, sizeof(app2)},
+    };
+
+    testcase_begin("starting...");
+    testcase_rw_session();
+    testcase_user_login();
+
+    /*
+     * Every other object is a token object, every other pair is private.
+     * All objects of a batch have the same application, so that they can
+     * be searched for.
+     */
+    for (i = 0; i < NUM_OBJS; i++) {
+        snprintf((char *)labels[i], sizeof(labels[i]),
+                 "createobjects %lu", i);
+
+        data_tmpl[i][0].type = CKA_CLASS;
+        data_tmpl[i][0].pValue = &data_class;
+        data_tmpl[i][0].ulValueLen = sizeof(data_class);
+        data_tmpl[i][1].type = CKA_TOKEN;
+        data_tmpl[i][1].pValue = (i % 2) ? &true : &false;
+        data_tmpl[i][1].ulValueLen = sizeof(CK_BBOOL);
+        data_tmpl[i][2].type = CKA_PRIVATE;
+        data_tmpl[i][2].pValue = (i % 4) >= 2 ? &true : &false;
+        data_tmpl[i][2].ulValueLen = sizeof(CK_BBOOL);
+        data_tmpl[i][3].type = CKA_LABEL;
+        data_tmpl[i][3].pValue = labels[i];
+        data_tmpl[i][3].ulValueLen = strlen((char *)labels[i]);
+        data_tmpl[i][4].type = CKA_APPLICATION;
+        data_tmpl[i][4].pValue = app1;
+        data_tmpl[i][4].ulValueLen = sizeof(app1);
+
+        templates[i].pTemplate = data_tmpl[i];
+        templates[i].ulCount = 5;
+        objs[i] = CK_INVALID_HANDLE;
+    }
+
+    /* Testcase 1: Create all objects in one call */
+    testcase_new_assertion();
+
+    rc = _C_IBM_CreateObjects(session, templates, NUM_OBJS, objs);
+    if (rc != CKR_OK) {
+        if (rc == CKR_FUNCTION_NOT_SUPPORTED) {
+            testcase_skip("Slot %lu doesn't support C_IBM_CreateObjects",
+                          SLOT_ID);
+            rc = CKR_OK;
+            goto testcase_cleanup;
+        }
+        if (is_rejected_by_policy(rc, session)) {
+            testcase_skip("Object creation is not allowed by policy");
+            rc = CKR_OK;
+            goto testcase_cleanup;
+        }
+        testcase_fail("C_IBM_CreateObjects() rc = %s", p11_get_ckr(rc));
+        goto testcase_cleanup;
+    }
+    created = NUM_OBJS;
+
+    for (i = 0; i < NUM_OBJS; i++) {
+        for (j = 0; j < i; j++) {
+            if (objs[i] == objs[j])
+                break;
+        }
+        if (objs[i] == CK_INVALID_HANDLE || j < i) {
+            testcase_fail("Object %lu has an invalid or duplicate handle", i);
+            goto testcase_cleanup;
+        }
+
+        label_attr.type = CKA_LABEL;
+        label_attr.pValue = label;
+        label_attr.ulValueLen = sizeof(label);
+        rc = funcs->C_GetAttributeValue(session, objs[i], &label_attr, 1);
+        if (rc != CKR_OK) {
+            testcase_fail("C_GetAttributeValue() rc = %s", p11_get_ckr(rc));
+            goto testcase_cleanup;
+        }
+        if (label_attr.ulValueLen != strlen((char *)labels[i]) ||
+            memcmp(label, labels[i], label_attr.ulValueLen) != 0) {
+            testcase_fail("Object %lu has the wrong label", i);
+            goto testcase_cleanup;
+        }
+    }
+
+    rc = find_app_objects(session, app1, sizeof(app1), objs, NUM_OBJS,
+                          &find_count, &not_found);
+    if (rc != CKR_OK)
+        goto testcase_cleanup;
+    if (find_count != NUM_OBJS || not_found != 0) {
+        testcase_fail("Should have found the %d objects, found %lu, "
+                      "%lu of them wrong", NUM_OBJS, find_count, not_found);
+        goto testcase_cleanup;
+    }
+
+    testcase_pass("Created %d objects in one call.", NUM_OBJS);
+
+    for (i = 0; i < created; i++) {
+        rc = funcs->C_DestroyObject(session, objs[i]);
+        if (rc != CKR_OK) {
+            testcase_error("C_DestroyObject() rc = %s", p11_get_ckr(rc));
+            goto testcase_cleanup;
+        }
+        objs[i] = CK_INVALID_HANDLE;
+    }
+    created = 0;
+
+    /*
+     * Testcase 2: One invalid template in the middle of the batch. The
+     * objects before it, token objects among them, are created first and
+     * must be removed again.
+     */
+    testcase_new_assertion();
+
+    for (i = 0; i < NUM_OBJS; i++) {
+        data_tmpl[i][4].pValue = app2;
+        data_tmpl[i][4].ulValueLen = sizeof(app2);
+    }
+    templates[INVALID_OBJ].pTemplate = invalid_tmpl;
+    templates[INVALID_OBJ].ulCount = 3;
+
+    rc = _C_IBM_CreateObjects(session, templates, NUM_OBJS, objs);
+    if (rc == CKR_OK) {
+        created = NUM_OBJS;
+        testcase_fail("C_IBM_CreateObjects() with an invalid template "
+                      "succeeded");
+        goto testcase_cleanup;
+    }
+    if (rc != CKR_TEMPLATE_INCOMPLETE) {
+        testcase_fail("C_IBM_CreateObjects() rc = %s (expected "
+                      "CKR_TEMPLATE_INCOMPLETE)", p11_get_ckr(rc));
+        goto testcase_cleanup;
+    }
+
+    for (i = 0; i < INVALID_OBJ; i++) {
+        if (objs[i] != CK_INVALID_HANDLE) {
+            testcase_fail("Handle of object %lu was not invalidated", i);
+            goto testcase_cleanup;
+        }
+    }
+
+    rc = find_app_objects(session, app2, sizeof(app2), objs, 0,
+                          &find_count, &not_found);
+    if (rc != CKR_OK)
+        goto testcase_cleanup;
+    if (find_count != 0) {
+        testcase_fail("Found %lu objects of the failed batch", find_count);
+        goto testcase_cleanup;
+    }
+
+    testcase_pass("A failed batch leaves no objects behind.");
+
+    /* Testcase 3: An empty batch */
+    testcase_new_assertion();
+
+    rc = _C_IBM_CreateObjects(session, templates, 0, objs);
+    if (rc != CKR_OK) {
+        testcase_fail("C_IBM_CreateObjects() with no objects rc = %s",
+                      p11_get_ckr(rc));
+        goto testcase_cleanup;
+    }
+
+    testcase_pass("Created an empty batch.");
+
+testcase_cleanup:
+    for (i = 0; i < created; i++) {
+        if (objs[i] != CK_INVALID_HANDLE)
+            funcs->C_DestroyObject(session, objs[i]);
+    }
+
+    testcase_user_logout();
+    if (funcs->C_CloseSession(session) != CKR_OK)
+        testcase_error("C_CloseSession failed");
+
+    return rc;
+}
+
+int main(int argc, char **argv)
+{
+    int rc;
+    CK_C_INITIALIZE_ARGS cinit_args;
+    CK_RV rv = 0;
+
+    rc = do_ParseArgs(argc, argv);
+    if (rc != 1)
+        return rc;
+
+    printf("Using slot #%lu...\n\n", SLOT_ID);
+    printf("With option: nostop: %d\n", no_stop);
+
+    rc = do_GetFunctionList();
+    if (!rc) {
+        testcase_error("do_getFunctionList(), rc=%s", p11_get_ckr(rc));
+        return rc;
+    }
+
+    testcase_setup();
+
+    *(void **)(&_C_IBM_CreateObjects) =
+                                dlsym(pkcs11lib, "C_IBM_CreateObjects");
+    if (_C_IBM_CreateObjects == NULL) {
+        testcase_skip("C_IBM_CreateObjects not supported");
+        testcase_print_result();
+        return 0;
+    }
+
+    memset(&cinit_args, 0x0, sizeof(cinit_args));
+    cinit_args.flags = CKF_OS_LOCKING_OK;
+
+    funcs->C_Initialize(&cinit_args);
+
+    rv = do_CreateObjects();
+    testcase_print_result();
+
+    funcs->C_Finalize(NULL);
+
+    return testcase_return(rv);
+}
@@ -264,6 +264,330 @@ testcase_cleanup:
     return rc;
 }
 
+/*
+ * Measure C_FindObjectsInit/C_FindObjects with a large number of session
+ * objects. Each matching object needs an object handle, so this exercises
+ * the object to handle lookup for every object found.
+ */
+#define FIND_PERF_NUM_OBJS  10000
+
+CK_RV do_FindObjectsPerf(void)
+{
+    CK_FLAGS flags;
+    CK_SESSION_HANDLE session;
+    CK_RV rc = 0;
+    CK_BYTE user_pin[PKCS11_MAX_PIN_LEN];
+    CK_ULONG user_pin_len;
+    CK_OBJECT_HANDLE *keyobj = NULL, *obj_list = NULL;
+    CK_ULONG num_objs = 0, find_count = 0, i;
+    SYSTEMTIME t1, t2;
+
+    CK_OBJECT_CLASS key_class = CKO_SECRET_KEY;
+    CK_KEY_TYPE aes_type = CKK_AES;
+    CK_BBOOL false = FALSE;
+    CK_CHAR aes_value[] = "This is a fake aes key.";
+    CK_CHAR perf_id[] = "My FindObjects perf keys.";
+
+    CK_ATTRIBUTE aes_tmpl[] = {
+        {CKA_CLASS, &key_class, sizeof(key_class)},
+        {CKA_KEY_TYPE, &aes_type, sizeof(aes_type)},
+        {CKA_PRIVATE, &false, sizeof(false)},
+        {CKA_ID, &perf_id, sizeof(perf_id)},
+        {CKA_VALUE, &aes_value, sizeof(aes_value)}
+    };
+
+    CK_ATTRIBUTE search_tmpl[] = {
+        {CKA_ID, &perf_id, sizeof(perf_id)},
+    };
+
+    testcase_begin("starting...");
+    testcase_rw_session();
+    testcase_user_login();
+
+    keyobj = calloc(FIND_PERF_NUM_OBJS, sizeof(CK_OBJECT_HANDLE));
+    obj_list = calloc(FIND_PERF_NUM_OBJS, sizeof(CK_OBJECT_HANDLE));
+    if (keyobj == NULL || obj_list == NULL) {
+        testcase_error("calloc failed");
+        rc = CKR_HOST_MEMORY;
+        goto testcase_cleanup;
+    }
+
+    for (num_objs = 0; num_objs < FIND_PERF_NUM_OBJS; num_objs++) {
+        rc = funcs->C_CreateObject(session, aes_tmpl, 5, &keyobj[num_objs]);
+        if (rc != CKR_OK) {
+            if (is_rejected_by_policy(rc, session)) {
+                testcase_skip("key import is not allowed by policy");
+                rc = CKR_OK;
+                goto testcase_cleanup;
+            }
+            testcase_error("C_CreateObject() rc = %s", p11_get_ckr(rc));
+            goto testcase_cleanup;
+        }
+    }
+
+    testcase_new_assertion();
+
+    GetSystemTime(&t1);
+
+    rc = funcs->C_FindObjectsInit(session, search_tmpl, 1);
+    if (rc != CKR_OK) {
+        testcase_fail("C_FindObjectsInit() rc = %s", p11_get_ckr(rc));
+        goto testcase_cleanup;
+    }
+
+    rc = funcs->C_FindObjects(session, obj_list, FIND_PERF_NUM_OBJS,
+                              &find_count);
+    if (rc != CKR_OK) {
+        testcase_fail("C_FindObjects() rc = %s", p11_get_ckr(rc));
+        funcs->C_FindObjectsFinal(session);
+        goto testcase_cleanup;
+    }
+
+    rc = funcs->C_FindObjectsFinal(session);
+    if (rc != CKR_OK) {
+        testcase_fail("C_FindObjectsFinal() rc = %s", p11_get_ckr(rc));
+        goto testcase_cleanup;
+    }
+
+    GetSystemTime(&t2);
+
+    if (find_count != FIND_PERF_NUM_OBJS) {
+        testcase_fail("Should have found %d objects, found %d",
+                      FIND_PERF_NUM_OBJS, (int) find_count);
+        goto testcase_cleanup;
+    }
+
+    printf("Find %d objects: ", FIND_PERF_NUM_OBJS);
+    process_time(t1, t2);
+
+    testcase_pass("Found all %d objects.", FIND_PERF_NUM_OBJS);
+
+    /* An existence check must not match all objects up front */
+    testcase_new_assertion();
+
+    GetSystemTime(&t1);
+
+    rc = funcs->C_FindObjectsInit(session, search_tmpl, 1);
+    if (rc != CKR_OK) {
+        testcase_fail("C_FindObjectsInit() rc = %s", p11_get_ckr(rc));
+        goto testcase_cleanup;
+    }
+
+    rc = funcs->C_FindObjects(session, obj_list, 1, &find_count);
+    if (rc != CKR_OK) {
+        testcase_fail("C_FindObjects() rc = %s", p11_get_ckr(rc));
+        funcs->C_FindObjectsFinal(session);
+        goto testcase_cleanup;
+    }
+
+    rc = funcs->C_FindObjectsFinal(session);
+    if (rc != CKR_OK) {
+        testcase_fail("C_FindObjectsFinal() rc = %s", p11_get_ckr(rc));
+        goto testcase_cleanup;
+    }
+
+    GetSystemTime(&t2);
+
+    if (find_count != 1) {
+        testcase_fail("Should have found 1 object, found %d",
+                      (int) find_count);
+        goto testcase_cleanup;
+    }
+    for (i = 0; i < num_objs && keyobj[i] != obj_list[0]; i++)
+        ;
+    if (i == num_objs) {
+        testcase_fail("Wrong object found!");
+        goto testcase_cleanup;
+    }
+
+    printf("Find 1 of %d objects: ", FIND_PERF_NUM_OBJS);
+    process_time(t1, t2);
+
+    testcase_pass("Found 1 of %d objects.", FIND_PERF_NUM_OBJS);
+
+testcase_cleanup:
+    for (i = 0; i < num_objs; i++)
+        funcs->C_DestroyObject(session, keyobj[i]);
+    free(keyobj);
+    free(obj_list);
+
+    testcase_user_logout();
+    if (funcs->C_CloseSession(session) != CKR_OK)
+        testcase_error("C_CloseSession failed");
+
+    return rc;
+}
+
+/*
+ * Destroy and create objects while a search is active. The search must skip
+ * the destroyed objects, must return each object at most once, and must
+ * return all objects that existed for the whole search. Objects created
+ * during the search may or may not be returned.
+ */
+#define FIND_MOD_NUM_OBJS   20
+#define FIND_MOD_NUM_NEW    5
+#define FIND_MOD_CHUNK      5
+
+static CK_BBOOL find_handle(CK_OBJECT_HANDLE *list, CK_ULONG count,
+                            CK_OBJECT_HANDLE handle)
+{
+    CK_ULONG i;
+
+    for (i = 0; i < count; i++) {
+        if (list[i] == handle)
+            return TRUE;
+    }
+    return FALSE;
+}
+
+CK_RV do_FindObjectsModify(void)
+{
+    CK_FLAGS flags;
+    CK_SESSION_HANDLE session;
+    CK_RV rc = 0;
+    CK_BYTE user_pin[PKCS11_MAX_PIN_LEN];
+    CK_ULONG user_pin_len;
+    CK_OBJECT_HANDLE objs[FIND_MOD_NUM_OBJS];
+    CK_OBJECT_HANDLE new_objs[FIND_MOD_NUM_NEW];
+    CK_OBJECT_HANDLE found[FIND_MOD_NUM_OBJS + FIND_MOD_NUM_NEW +
+                           FIND_MOD_CHUNK];
+    CK_BBOOL destroyed[FIND_MOD_NUM_OBJS] = { 0 };
+    CK_ULONG num_objs = 0, num_new = 0, num_found = 0, find_count, i;
+    CK_BBOOL active = FALSE;
+
+    CK_OBJECT_CLASS data_class = CKO_DATA;
+    CK_BBOOL false = FALSE;
+    CK_CHAR mod_label[] = "My FindObjects modify objects.";
+    CK_CHAR value[] = "FindObjects modify data";
+
+    CK_ATTRIBUTE data_tmpl[] = {
+        {CKA_CLASS, &data_class, sizeof(data_class)},
+        {CKA_PRIVATE, &false, sizeof(false)},
+        {CKA_LABEL, &mod_label, sizeof(mod_label)},
+        {CKA_VALUE, &value, sizeof(value)}
+    };
+
+    CK_ATTRIBUTE search_tmpl[] = {
+        {CKA_LABEL, &mod_label, sizeof(mod_label)},
+    };
+
+    testcase_begin("starting...");
+    testcase_rw_session();
+    testcase_user_login();
+
+    for (num_objs = 0; num_objs < FIND_MOD_NUM_OBJS; num_objs++) {
+        rc = funcs->C_CreateObject(session, data_tmpl, 4, &objs[num_objs]);
+        if (rc != CKR_OK) {
+            testcase_error("C_CreateObject() rc = %s", p11_get_ckr(rc));
+            goto testcase_cleanup;
+        }
+    }
+
+    testcase_new_assertion();
+
+    rc = funcs->C_FindObjectsInit(session, search_tmpl, 1);
+    if (rc != CKR_OK) {
+        testcase_fail("C_FindObjectsInit() rc = %s", p11_get_ckr(rc));
+        goto testcase_cleanup;
+    }
+    active = TRUE;
+
+    rc = funcs->C_FindObjects(session, found, FIND_MOD_CHUNK, &find_count);
+    if (rc != CKR_OK) {
+        testcase_fail("C_FindObjects() rc = %s", p11_get_ckr(rc));
+        goto testcase_cleanup;
+    }
+    if (find_count != FIND_MOD_CHUNK) {
+        testcase_fail("Should have found %d objects, found %d",
+                      FIND_MOD_CHUNK, (int) find_count);
+        goto testcase_cleanup;
+    }
+    num_found = find_count;
+
+    /* destroy every other object that was not returned yet */
+    for (i = 0; i < num_objs; i += 2) {
+        if (find_handle(found, num_found, objs[i]))
+            continue;
+        rc = funcs->C_DestroyObject(session, objs[i]);
+        if (rc != CKR_OK) {
+            testcase_error("C_DestroyObject() rc = %s", p11_get_ckr(rc));
+            goto testcase_cleanup;
+        }
+        destroyed[i] = TRUE;
+    }
+
+    for (num_new = 0; num_new < FIND_MOD_NUM_NEW; num_new++) {
+        rc = funcs->C_CreateObject(session, data_tmpl, 4, &new_objs[num_new]);
+        if (rc != CKR_OK) {
+            testcase_error("C_CreateObject() rc = %s", p11_get_ckr(rc));
+            goto testcase_cleanup;
+        }
+    }
+
+    do {
+        rc = funcs->C_FindObjects(session, found + num_found,
+                                  FIND_MOD_CHUNK, &find_count);
+        if (rc != CKR_OK) {
+            testcase_fail("C_FindObjects() rc = %s", p11_get_ckr(rc));
+            goto testcase_cleanup;
+        }
+
+        /* every object found must be one that exists, and only once */
+        for (i = num_found; i < num_found + find_count; i++) {
+            if (find_handle(found, i, found[i])) {
+                testcase_fail("Object %lu found twice", found[i]);
+                goto testcase_cleanup;
+            }
+            if (!find_handle(objs, num_objs, found[i]) &&
+                !find_handle(new_objs, num_new, found[i])) {
+                testcase_fail("Unknown object %lu found", found[i]);
+                goto testcase_cleanup;
+            }
+        }
+        num_found += find_count;
+    } while (find_count > 0);
+
+    rc = funcs->C_FindObjectsFinal(session);
+    active = FALSE;
+    if (rc != CKR_OK) {
+        testcase_fail("C_FindObjectsFinal() rc = %s", p11_get_ckr(rc));
+        goto testcase_cleanup;
+    }
+
+    for (i = 0; i < num_objs; i++) {
+        /* a new object might have gotten the handle of a destroyed one */
+        if (destroyed[i]) {
+            if (find_handle(found, num_found, objs[i]) &&
+                !find_handle(new_objs, num_new, objs[i])) {
+                testcase_fail("Destroyed object %lu found", objs[i]);
+                goto testcase_cleanup;
+            }
+        } else if (!find_handle(found, num_found, objs[i])) {
+            testcase_fail("Object %lu not found", objs[i]);
+            goto testcase_cleanup;
+        }
+    }
+
+    testcase_pass("Found the objects while objects were destroyed and "
+                  "created.");
+
+testcase_cleanup:
+    if (active)
+        funcs->C_FindObjectsFinal(session);
+    for (i = 0; i < num_objs; i++) {
+        if (!destroyed[i])
+            funcs->C_DestroyObject(session, objs[i]);
+    }
+    for (i = 0; i < num_new; i++)
+        funcs->C_DestroyObject(session, new_objs[i]);
+
+    testcase_user_logout();
+    if (funcs->C_CloseSession(session) != CKR_OK)
+        testcase_error("C_CloseSession failed");
+
+    return rc;
+}
+
 int main(int argc, char **argv)
 {
     int rc;
@@ -302,6 +626,10 @@ int main(int argc, char **argv)
 
     testcase_setup();
     rc = do_FindObjects();
+    if (rc == CKR_OK || no_stop)
+        rc = do_FindObjectsModify();
+    if (rc == CKR_OK || no_stop)
+        rc = do_FindObjectsPerf();
     testcase_print_result();
 
     funcs->C_Finalize(NULL);
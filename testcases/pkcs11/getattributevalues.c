@@ -0,0 +1,329 @@
+/*
+ * COPYRIGHT (c) International Business Machines Corp. 2024
+ *
+ * This program is provided under the terms of the Common Public License,
+ * version 1.0 (CPL-1.0). Any use, reproduction or distribution for this
+ * software constitutes recipient's acceptance of CPL-1.0 terms which can be
+ * found in the file LICENSE file or at
+ * https://opensource.org/licenses/cpl1.0.php
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <memory.h>
+#include <dlfcn.h>
+
+#include "pkcs11types.h"
+#include "regress.h"
+#include "common.c"
+
+#define NUM_OBJS        6
+#define NUM_ATTRS       3
+
+CK_C_IBM_GetAttributeValues _C_IBM_GetAttributeValues;
+
+struct obj_attrs {
+    CK_ATTRIBUTE attrs[NUM_ATTRS];
+    CK_OBJECT_CLASS class;
+    CK_BYTE label[64];
+    CK_BYTE value[64];
+};
+
+static void init_obj_attrs(struct obj_attrs *oa)
+{
+    memset(oa, 0, sizeof(*oa));
+    oa->attrs[0].type = CKA_CLASS;
+    oa->attrs[0].pValue = &oa->class;
+    oa->attrs[0].ulValueLen = sizeof(oa->class);
+    oa->attrs[1].type = CKA_LABEL;
+    oa->attrs[1].pValue = oa->label;
+    oa->attrs[1].ulValueLen = sizeof(oa->label);
+    oa->attrs[2].type = CKA_VALUE;
+    oa->attrs[2].pValue = oa->value;
+    oa->attrs[2].ulValueLen = sizeof(oa->value);
+}
+
+/*
+ * Gets the attributes of all objects with one C_IBM_GetAttributeValues call,
+ * and checks that the result for each object is the one that
+ * C_GetAttributeValue returns. The return values of C_IBM_GetAttributeValues
+ * are returned in rvs.
+ */
+static CK_RV check_get_attribute_values(CK_SESSION_HANDLE session,
+                                        CK_OBJECT_HANDLE *objs, CK_RV *rvs)
+{
+    struct obj_attrs multi[NUM_OBJS], single;
+    CK_IBM_OBJECT_TEMPLATE templates[NUM_OBJS];
+    CK_ULONG i, j;
+    CK_RV rc;
+
+    for (i = 0; i < NUM_OBJS; i++) {
+        init_obj_attrs(&multi[i]);
+        templates[i].pTemplate = multi[i].attrs;
+        templates[i].ulCount = NUM_ATTRS;
+    }
+
+    rc = _C_IBM_GetAttributeValues(session, objs, NUM_OBJS, templates, rvs);
+    if (rc != CKR_OK)
+        return rc;
+
+    for (i = 0; i < NUM_OBJS; i++) {
+        init_obj_attrs(&single);
+        rc = funcs->C_GetAttributeValue(session, objs[i], single.attrs,
+                                        NUM_ATTRS);
+        if (rc != rvs[i]) {
+            testcase_fail("Object %lu: C_IBM_GetAttributeValues returned %s, "
+                          "C_GetAttributeValue %s", i, p11_get_ckr(rvs[i]),
+                          p11_get_ckr(rc));
+            return CKR_FUNCTION_FAILED;
+        }
+        if (rc != CKR_OK && rc != CKR_ATTRIBUTE_SENSITIVE)
+            continue;
+
+        for (j = 0; j < NUM_ATTRS; j++) {
+            if (multi[i].attrs[j].ulValueLen != single.attrs[j].ulValueLen ||
+                (single.attrs[j].ulValueLen != CK_UNAVAILABLE_INFORMATION &&
+                 memcmp(multi[i].attrs[j].pValue, single.attrs[j].pValue,
+                        single.attrs[j].ulValueLen) != 0)) {
+                testcase_fail("Object %lu: attribute %s differs", i,
+                              p11_get_cka(single.attrs[j].type));
+                return CKR_FUNCTION_FAILED;
+            }
+        }
+    }
+
+    return CKR_OK;
+}
+
+/* API Routines exercised:
+ * C_IBM_GetAttributeValues
+ * C_GetAttributeValue
+ * C_CreateObject
+ * C_DestroyObject
+ *
+ * 2 TestCases
+ * Setup: Create public and private data objects, session and token objects,
+ *        and a sensitive key.
+ * Testcase 1: Get the attributes of the objects, an invalid handle and a
+ *             handle of a destroyed object in a user session.
+ * Testcase 2: Get the same attributes in a public session.
+ * Each object's result must be the one that C_GetAttributeValue returns.
+ */
+CK_RV do_GetAttributeValues(void)
+{
+    CK_FLAGS flags;
+    CK_SESSION_HANDLE session;
+    CK_RV rc = 0;
+    CK_BYTE user_pin[PKCS11_MAX_PIN_LEN];
+    CK_ULONG user_pin_len;
+
+    CK_OBJECT_HANDLE objs[NUM_OBJS];
+    CK_OBJECT_HANDLE token_obj = CK_INVALID_HANDLE;
+    CK_RV rvs[NUM_OBJS];
+    CK_ULONG i;
+
+    CK_OBJECT_CLASS data_class = CKO_DATA;
+    CK_OBJECT_CLASS key_class = CKO_SECRET_KEY;
+    CK_KEY_TYPE aes_type = CKK_AES;
+    CK_BBOOL true = TRUE;
+    CK_BBOOL false = FALSE;
+    CK_CHAR pub_label[] = "getattributevalues public";
+    CK_CHAR priv_label[] = "getattributevalues private";
+    CK_CHAR key_label[] = "getattributevalues sensitive";
+    CK_CHAR data_value[] = "getattributevalues data";
+    CK_BYTE aes_value[16] = { 0 };
+
+    CK_ATTRIBUTE pub_tmpl[] = {
+        {CKA_CLASS, &data_class, sizeof(data_class)},
+        {CKA_PRIVATE, &false, sizeof(false)},
+        {CKA_LABEL, &pub_label, sizeof(pub_label)},
+        {CKA_VALUE, &data_value, sizeof(data_value)}
+    };
+    CK_ATTRIBUTE priv_tmpl[] = {
+        {CKA_CLASS, &data_class, sizeof(data_class)},
+        {CKA_PRIVATE, &true, sizeof(true)},
+        {CKA_LABEL, &priv_label, sizeof(priv_label)},
+        {CKA_VALUE, &data_value, sizeof(data_value)},
+        {CKA_TOKEN, &false, sizeof(false)}
+    };
+    CK_ATTRIBUTE key_tmpl[] = {
+        {CKA_CLASS, &key_class, sizeof(key_class)},
+        {CKA_KEY_TYPE, &aes_type, sizeof(aes_type)},
+        {CKA_PRIVATE, &false, sizeof(false)},
+        {CKA_SENSITIVE, &true, sizeof(true)},
+        {CKA_LABEL, &key_label, sizeof(key_label)},
+        {CKA_VALUE, &aes_value, sizeof(aes_value)}
+    };
+    CK_RV expected[NUM_OBJS] = {
+        CKR_OK,                         /* public session object */
+        CKR_OK,                         /* private session object */
+        CKR_OK,                         /* private token object */
+        CKR_ATTRIBUTE_SENSITIVE,        /* CKA_VALUE of a sensitive key */
+        CKR_OBJECT_HANDLE_INVALID,      /* invalid handle */
+        CKR_OBJECT_HANDLE_INVALID,      /* destroyed object */
+    };
+
+    for (i = 0; i < NUM_OBJS; i++)
+        objs[i] = CK_INVALID_HANDLE;
+
+    testcase_begin("starting...");
+    testcase_rw_session();
+    testcase_user_login();
+
+    rc = funcs->C_CreateObject(session, pub_tmpl, 4, &objs[0]);
+    if (rc != CKR_OK) {
+        testcase_error("C_CreateObject() rc = %s", p11_get_ckr(rc));
+        goto testcase_cleanup;
+    }
+    rc = funcs->C_CreateObject(session, priv_tmpl, 5, &objs[1]);
+    if (rc != CKR_OK) {
+        testcase_error("C_CreateObject() rc = %s", p11_get_ckr(rc));
+        goto testcase_cleanup;
+    }
+    priv_tmpl[4].pValue = &true;
+    rc = funcs->C_CreateObject(session, priv_tmpl, 5, &token_obj);
+    if (rc != CKR_OK) {
+        testcase_error("C_CreateObject() rc = %s", p11_get_ckr(rc));
+        goto testcase_cleanup;
+    }
+    objs[2] = token_obj;
+    rc = funcs->C_CreateObject(session, key_tmpl, 6, &objs[3]);
+    if (rc != CKR_OK) {
+        if (is_rejected_by_policy(rc, session)) {
+            testcase_skip("Key import is not allowed by policy");
+            rc = CKR_OK;
+            goto testcase_cleanup;
+        }
+        testcase_error("C_CreateObject() rc = %s", p11_get_ckr(rc));
+        goto testcase_cleanup;
+    }
+    rc = funcs->C_CreateObject(session, pub_tmpl, 4, &objs[5]);
+    if (rc != CKR_OK) {
+        testcase_error("C_CreateObject() rc = %s", p11_get_ckr(rc));
+        goto testcase_cleanup;
+    }
+    rc = funcs->C_DestroyObject(session, objs[5]);
+    if (rc != CKR_OK) {
+        testcase_error("C_DestroyObject() rc = %s", p11_get_ckr(rc));
+        goto testcase_cleanup;
+    }
+
+    /* Testcase 1: all objects in a user session */
+    testcase_new_assertion();
+
+    rc = check_get_attribute_values(session, objs, rvs);
+    if (rc != CKR_OK) {
+        if (rc == CKR_FUNCTION_NOT_SUPPORTED) {
+            testcase_skip("Slot %lu doesn't support C_IBM_GetAttributeValues",
+                          SLOT_ID);
+            rc = CKR_OK;
+            goto testcase_cleanup;
+        }
+        if (rc != CKR_FUNCTION_FAILED)
+            testcase_fail("C_IBM_GetAttributeValues() rc = %s",
+                          p11_get_ckr(rc));
+        goto testcase_cleanup;
+    }
+    for (i = 0; i < NUM_OBJS; i++) {
+        if (rvs[i] != expected[i]) {
+            testcase_fail("Object %lu: rc = %s, expected %s", i,
+                          p11_get_ckr(rvs[i]), p11_get_ckr(expected[i]));
+            rc = CKR_FUNCTION_FAILED;
+            goto testcase_cleanup;
+        }
+    }
+
+    testcase_pass("Got the attributes of %d objects in a user session.",
+                  NUM_OBJS);
+
+    /* Testcase 2: the private objects are not accessible after logout */
+    testcase_new_assertion();
+
+    rc = funcs->C_Logout(session);
+    if (rc != CKR_OK) {
+        testcase_error("C_Logout() rc = %s", p11_get_ckr(rc));
+        goto testcase_cleanup;
+    }
+
+    rc = check_get_attribute_values(session, objs, rvs);
+    if (rc != CKR_OK) {
+        if (rc != CKR_FUNCTION_FAILED)
+            testcase_fail("C_IBM_GetAttributeValues() rc = %s",
+                          p11_get_ckr(rc));
+        goto testcase_relogin;
+    }
+    for (i = 0; i < NUM_OBJS; i++) {
+        if ((i == 1 || i == 2) ? rvs[i] == CKR_OK : rvs[i] != expected[i]) {
+            testcase_fail("Object %lu: rc = %s in a public session", i,
+                          p11_get_ckr(rvs[i]));
+            rc = CKR_FUNCTION_FAILED;
+            goto testcase_relogin;
+        }
+    }
+
+    testcase_pass("Got the attributes of %d objects in a public session.",
+                  NUM_OBJS);
+
+testcase_relogin:
+    /* the private token object can only be destroyed after a login */
+    if (funcs->C_Login(session, CKU_USER, user_pin, user_pin_len) != CKR_OK)
+        testcase_error("C_Login() failed");
+
+testcase_cleanup:
+    for (i = 0; i < 4; i++) {
+        if (objs[i] != CK_INVALID_HANDLE && objs[i] != token_obj)
+            funcs->C_DestroyObject(session, objs[i]);
+    }
+    if (token_obj != CK_INVALID_HANDLE)
+        funcs->C_DestroyObject(session, token_obj);
+
+    testcase_user_logout();
+    if (funcs->C_CloseSession(session) != CKR_OK)
+        testcase_error("C_CloseSession failed");
+
+    return rc;
+}
+
+int main(int argc, char **argv)
+{
+    int rc;
+    CK_C_INITIALIZE_ARGS cinit_args;
+    CK_RV rv = 0;
+
+    rc = do_ParseArgs(argc, argv);
+    if (rc != 1)
+        return rc;
+
+    printf("Using slot #%lu...\n\n", SLOT_ID);
+    printf("With option: nostop: %d\n", no_stop);
+
+    rc = do_GetFunctionList();
+    if (!rc) {
+        testcase_error("do_getFunctionList(), rc=%s", p11_get_ckr(rc));
+        return rc;
+    }
+
+    testcase_setup();
+
+    *(void **)(&_C_IBM_GetAttributeValues) =
+                                dlsym(pkcs11lib, "C_IBM_GetAttributeValues");
+    if (_C_IBM_GetAttributeValues == NULL) {
+        testcase_skip("C_IBM_GetAttributeValues not supported");
+        testcase_print_result();
+        return 0;
+    }
+
+    memset(&cinit_args, 0x0, sizeof(cinit_args));
+    cinit_args.flags = CKF_OS_LOCKING_OK;
+
+    funcs->C_Initialize(&cinit_args);
+
+    rv = do_GetAttributeValues();
+    testcase_print_result();
+
+    funcs->C_Finalize(NULL);
+
+    return testcase_return(rv);
+}
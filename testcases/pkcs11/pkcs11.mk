@@ -4,8 +4,9 @@ noinst_PROGRAMS +=							\
 	testcases/pkcs11/attribute testcases/pkcs11/findobjects		\
 	testcases/pkcs11/destroyobjects	testcases/pkcs11/copyobjects	\
 	testcases/pkcs11/generate_keypair testcases/pkcs11/gen_purpose	\
-	testcases/pkcs11/getobjectsize					\
-	testcases/pkcs11/get_interface
+	testcases/pkcs11/getobjectsize testcases/pkcs11/createobjects	\
+	testcases/pkcs11/getattributevalues testcases/pkcs11/get_interface	\
+	testcases/pkcs11/verifybatch testcases/pkcs11/async
 
 testcases_pkcs11_hw_fn_CFLAGS = ${testcases_inc}
 testcases_pkcs11_hw_fn_LDADD = testcases/common/libcommon.la
@@ -55,7 +56,27 @@ testcases_pkcs11_getobjectsize_LDADD = testcases/common/libcommon.la
 testcases_pkcs11_getobjectsize_SOURCES =				\
 	testcases/pkcs11/getobjectsize.c
 
+testcases_pkcs11_createobjects_CFLAGS = ${testcases_inc}
+testcases_pkcs11_createobjects_LDADD = testcases/common/libcommon.la
+testcases_pkcs11_createobjects_SOURCES =				\
+	testcases/pkcs11/createobjects.c
+
+testcases_pkcs11_getattributevalues_CFLAGS = ${testcases_inc}
+testcases_pkcs11_getattributevalues_LDADD = testcases/common/libcommon.la
+testcases_pkcs11_getattributevalues_SOURCES =				\
+	testcases/pkcs11/getattributevalues.c
+
 testcases_pkcs11_get_interface_CFLAGS = ${testcases_inc}
 testcases_pkcs11_get_interface_LDADD = testcases/common/libcommon.la
 testcases_pkcs11_get_interface_SOURCES =				\
 	testcases/pkcs11/get_interface.c
+
+testcases_pkcs11_verifybatch_CFLAGS = ${testcases_inc}
+testcases_pkcs11_verifybatch_LDADD = testcases/common/libcommon.la
+testcases_pkcs11_verifybatch_SOURCES =				\
+	testcases/pkcs11/verifybatch.c
+
+testcases_pkcs11_async_CFLAGS = ${testcases_inc}
+testcases_pkcs11_async_LDADD = testcases/common/libcommon.la
+testcases_pkcs11_async_SOURCES =				\
+	testcases/pkcs11/async.c
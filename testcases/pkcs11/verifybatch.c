@@ -0,0 +1,285 @@
+/*
+ * COPYRIGHT (c) International Business Machines Corp. 2024
+ *
+ * This program is provided under the terms of the Common Public License,
+ * version 1.0 (CPL-1.0). Any use, reproduction or distribution for this
+ * software constitutes recipient's acceptance of CPL-1.0 terms which can be
+ * found in the file LICENSE file or at
+ * https://opensource.org/licenses/cpl1.0.php
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <memory.h>
+#include <dlfcn.h>
+
+#include "pkcs11types.h"
+#include "ec_curves.h"
+#include "regress.h"
+#include "common.c"
+
+#define NUM_ITEMS       9
+#define MAX_SIG_LEN     256
+
+CK_C_IBM_VerifyBatch _C_IBM_VerifyBatch;
+
+static CK_RV sign_data(CK_SESSION_HANDLE session, CK_OBJECT_HANDLE priv_key,
+                       CK_BYTE *data, CK_ULONG data_len,
+                       CK_BYTE *sig, CK_ULONG *sig_len)
+{
+    CK_MECHANISM mech = { CKM_ECDSA_SHA256, NULL, 0 };
+    CK_RV rc;
+
+    rc = funcs->C_SignInit(session, &mech, priv_key);
+    if (rc != CKR_OK) {
+        testcase_error("C_SignInit() rc = %s", p11_get_ckr(rc));
+        return rc;
+    }
+
+    rc = funcs->C_Sign(session, data, data_len, sig, sig_len);
+    if (rc != CKR_OK)
+        testcase_error("C_Sign() rc = %s", p11_get_ckr(rc));
+
+    return rc;
+}
+
+/* API Routines exercised:
+ * C_IBM_VerifyBatch
+ * C_GenerateKeyPair
+ * C_SignInit
+ * C_Sign
+ *
+ * 2 TestCases
+ * Setup: Generate two EC key pairs, the public key of the second one can
+ *        not be used for verification, and sign data with both.
+ * Testcase 1: Verify a batch that mixes valid signatures with invalid
+ *             signatures and keys, using some keys several times, and check
+ *             the result of every item.
+ * Testcase 2: Verify a batch with a mechanism that is not supported.
+ */
+CK_RV do_VerifyBatch(void)
+{
+    CK_FLAGS flags;
+    CK_SESSION_HANDLE session;
+    CK_RV rc = 0;
+    CK_BYTE user_pin[PKCS11_MAX_PIN_LEN];
+    CK_ULONG user_pin_len;
+
+    CK_MECHANISM mech = { CKM_EC_KEY_PAIR_GEN, NULL, 0 };
+    CK_BYTE ec_params[] = OCK_PRIME256V1;
+    CK_BBOOL true = TRUE;
+    CK_BBOOL false = FALSE;
+    CK_ATTRIBUTE publ_tmpl[] = {
+        {CKA_VERIFY, &true, sizeof(true)},
+        {CKA_EC_PARAMS, ec_params, sizeof(ec_params)},
+    };
+    CK_ATTRIBUTE priv_tmpl[] = {
+        {CKA_SIGN, &true, sizeof(true)},
+    };
+    CK_OBJECT_HANDLE publ_key = CK_INVALID_HANDLE;
+    CK_OBJECT_HANDLE priv_key = CK_INVALID_HANDLE;
+    CK_OBJECT_HANDLE noverify_publ_key = CK_INVALID_HANDLE;
+    CK_OBJECT_HANDLE noverify_priv_key = CK_INVALID_HANDLE;
+
+    CK_BYTE data1[] = "verifybatch data 1";
+    CK_BYTE data2[] = "verifybatch data 2";
+    CK_BYTE sig1[MAX_SIG_LEN], sig2[MAX_SIG_LEN], sig3[MAX_SIG_LEN];
+    CK_BYTE tampered[MAX_SIG_LEN], oversized[MAX_SIG_LEN + 1];
+    CK_ULONG sig1_len, sig2_len, sig3_len;
+    CK_IBM_VERIFY_DATA items[NUM_ITEMS];
+    CK_RV results[NUM_ITEMS], expected[NUM_ITEMS];
+    CK_ULONG i;
+
+    testcase_begin("starting...");
+
+    if (!mech_supported(SLOT_ID, CKM_EC_KEY_PAIR_GEN)) {
+        testcase_skip("Slot %lu doesn't support CKM_EC_KEY_PAIR_GEN (0x%x)",
+                      SLOT_ID, CKM_EC_KEY_PAIR_GEN);
+        return CKR_OK;
+    }
+    if (!mech_supported(SLOT_ID, CKM_ECDSA_SHA256)) {
+        testcase_skip("Slot %lu doesn't support CKM_ECDSA_SHA256 (0x%x)",
+                      SLOT_ID, CKM_ECDSA_SHA256);
+        return CKR_OK;
+    }
+
+    testcase_rw_session();
+    testcase_user_login();
+
+    rc = funcs->C_GenerateKeyPair(session, &mech, publ_tmpl, 2, priv_tmpl, 1,
+                                  &publ_key, &priv_key);
+    if (rc != CKR_OK) {
+        if (is_rejected_by_policy(rc, session)) {
+            testcase_skip("EC key generation is not allowed by policy");
+            rc = CKR_OK;
+            goto testcase_cleanup;
+        }
+        testcase_error("C_GenerateKeyPair() rc = %s", p11_get_ckr(rc));
+        goto testcase_cleanup;
+    }
+    publ_tmpl[0].pValue = &false;
+    rc = funcs->C_GenerateKeyPair(session, &mech, publ_tmpl, 2, priv_tmpl, 1,
+                                  &noverify_publ_key, &noverify_priv_key);
+    if (rc != CKR_OK) {
+        testcase_error("C_GenerateKeyPair() rc = %s", p11_get_ckr(rc));
+        goto testcase_cleanup;
+    }
+
+    sig1_len = sizeof(sig1);
+    rc = sign_data(session, priv_key, data1, sizeof(data1), sig1, &sig1_len);
+    if (rc != CKR_OK)
+        goto testcase_cleanup;
+    sig2_len = sizeof(sig2);
+    rc = sign_data(session, priv_key, data2, sizeof(data2), sig2, &sig2_len);
+    if (rc != CKR_OK)
+        goto testcase_cleanup;
+    sig3_len = sizeof(sig3);
+    rc = sign_data(session, noverify_priv_key, data1, sizeof(data1), sig3,
+                   &sig3_len);
+    if (rc != CKR_OK)
+        goto testcase_cleanup;
+
+    memcpy(tampered, sig1, sig1_len);
+    tampered[sig1_len / 2] ^= 0x01;
+    memcpy(oversized, sig1, sig1_len);
+    oversized[sig1_len] = 0;
+
+    /* Testcase 1: a batch with valid and invalid items */
+    testcase_new_assertion();
+
+    /* a valid signature */
+    items[0] = (CK_IBM_VERIFY_DATA) { publ_key, data1, sizeof(data1),
+                                      sig1, sig1_len };
+    expected[0] = CKR_OK;
+    /* a tampered signature */
+    items[1] = (CK_IBM_VERIFY_DATA) { publ_key, data1, sizeof(data1),
+                                      tampered, sig1_len };
+    expected[1] = CKR_SIGNATURE_INVALID;
+    /* a signature that is longer than any signature of the key */
+    items[2] = (CK_IBM_VERIFY_DATA) { publ_key, data1, sizeof(data1),
+                                      oversized, sig1_len + 1 };
+    expected[2] = CKR_SIGNATURE_LEN_RANGE;
+    /* a key handle that does not exist */
+    items[3] = (CK_IBM_VERIFY_DATA) { CK_INVALID_HANDLE, data1, sizeof(data1),
+                                      sig1, sig1_len };
+    expected[3] = CKR_KEY_HANDLE_INVALID;
+    /* a key that can not be used for verification */
+    items[4] = (CK_IBM_VERIFY_DATA) { noverify_publ_key, data1, sizeof(data1),
+                                      sig3, sig3_len };
+    expected[4] = CKR_KEY_FUNCTION_NOT_PERMITTED;
+    /* the first key again, with another valid signature */
+    items[5] = (CK_IBM_VERIFY_DATA) { publ_key, data2, sizeof(data2),
+                                      sig2, sig2_len };
+    expected[5] = CKR_OK;
+    /* the first key again, with the signature of other data */
+    items[6] = (CK_IBM_VERIFY_DATA) { publ_key, data2, sizeof(data2),
+                                      sig1, sig1_len };
+    expected[6] = CKR_SIGNATURE_INVALID;
+    /* the bad keys again */
+    items[7] = items[3];
+    expected[7] = expected[3];
+    items[8] = items[4];
+    expected[8] = expected[4];
+
+    for (i = 0; i < NUM_ITEMS; i++)
+        results[i] = CKR_GENERAL_ERROR;
+
+    mech.mechanism = CKM_ECDSA_SHA256;
+    rc = _C_IBM_VerifyBatch(session, &mech, items, NUM_ITEMS, results);
+    if (rc != CKR_OK) {
+        if (rc == CKR_FUNCTION_NOT_SUPPORTED) {
+            testcase_skip("Slot %lu doesn't support C_IBM_VerifyBatch",
+                          SLOT_ID);
+            rc = CKR_OK;
+            goto testcase_cleanup;
+        }
+        testcase_fail("C_IBM_VerifyBatch() rc = %s", p11_get_ckr(rc));
+        goto testcase_cleanup;
+    }
+
+    for (i = 0; i < NUM_ITEMS; i++) {
+        if (results[i] != expected[i]) {
+            testcase_fail("Item %lu: rc = %s, expected %s", i,
+                          p11_get_ckr(results[i]), p11_get_ckr(expected[i]));
+            rc = CKR_FUNCTION_FAILED;
+            goto testcase_cleanup;
+        }
+    }
+
+    testcase_pass("Got the expected result for each of %d items.",
+                  NUM_ITEMS);
+
+    /* Testcase 2: a mechanism that is not supported for batches */
+    testcase_new_assertion();
+
+    mech.mechanism = CKM_SHA256_RSA_PKCS;
+    rc = _C_IBM_VerifyBatch(session, &mech, items, NUM_ITEMS, results);
+    if (rc != CKR_MECHANISM_INVALID) {
+        testcase_fail("C_IBM_VerifyBatch() with CKM_SHA256_RSA_PKCS rc = %s "
+                      "(expected CKR_MECHANISM_INVALID)", p11_get_ckr(rc));
+        rc = CKR_FUNCTION_FAILED;
+        goto testcase_cleanup;
+    }
+    rc = CKR_OK;
+
+    testcase_pass("A batch with an unsupported mechanism is rejected.");
+
+testcase_cleanup:
+    if (publ_key != CK_INVALID_HANDLE)
+        funcs->C_DestroyObject(session, publ_key);
+    if (priv_key != CK_INVALID_HANDLE)
+        funcs->C_DestroyObject(session, priv_key);
+    if (noverify_publ_key != CK_INVALID_HANDLE)
+        funcs->C_DestroyObject(session, noverify_publ_key);
+    if (noverify_priv_key != CK_INVALID_HANDLE)
+        funcs->C_DestroyObject(session, noverify_priv_key);
+
+    testcase_user_logout();
+    if (funcs->C_CloseSession(session) != CKR_OK)
+        testcase_error("C_CloseSession failed");
+
+    return rc;
+}
+
+int main(int argc, char **argv)
+{
+    int rc;
+    CK_C_INITIALIZE_ARGS cinit_args;
+    CK_RV rv = 0;
+
+    rc = do_ParseArgs(argc, argv);
+    if (rc != 1)
+        return rc;
+
+    printf("Using slot #%lu...\n\n", SLOT_ID);
+    printf("With option: nostop: %d\n", no_stop);
+
+    rc = do_GetFunctionList();
+    if (!rc) {
+        testcase_error("do_getFunctionList(), rc=%s", p11_get_ckr(rc));
+        return rc;
+    }
+
+    testcase_setup();
+
+    *(void **)(&_C_IBM_VerifyBatch) = dlsym(pkcs11lib, "C_IBM_VerifyBatch");
+    if (_C_IBM_VerifyBatch == NULL) {
+        testcase_skip("C_IBM_VerifyBatch not supported");
+        testcase_print_result();
+        return 0;
+    }
+
+    memset(&cinit_args, 0x0, sizeof(cinit_args));
+    cinit_args.flags = CKF_OS_LOCKING_OK;
+
+    funcs->C_Initialize(&cinit_args);
+
+    rv = do_VerifyBatch();
+    testcase_print_result();
+
+    funcs->C_Finalize(NULL);
+
+    return testcase_return(rv);
+}
@@ -0,0 +1,448 @@
+/*
+ * COPYRIGHT (c) International Business Machines Corp. 2024
+ *
+ * This program is provided under the terms of the Common Public License,
+ * version 1.0 (CPL-1.0). Any use, reproduction or distribution for this
+ * software constitutes recipient's acceptance of CPL-1.0 terms which can be
+ * found in the file LICENSE file or at
+ * https://opensource.org/licenses/cpl1.0.php
+ */
+
+/*
+ * Tests of the single file token object store. The store's source is
+ * included, so that the tests can simulate a process that died in the
+ * middle of an update.
+ */
+#include "objdb.c"
+#include "unittest.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#define NUM_OBJS        600
+
+static char dbpath[PATH_MAX];
+
+static void objname(char *name, unsigned long i)
+{
+    snprintf(name, OBJDB_NAME_LEN + 1, "OB%06X",
+             (unsigned int)(i & 0xffffff));
+}
+
+/* Object contents of a given version, sizes vary from 1 to 300 bytes */
+static CK_ULONG objdata(CK_BYTE *buf, unsigned long i, unsigned long version)
+{
+    CK_ULONG len = 1 + (i * 37 + version * 11) % 300, j;
+
+    for (j = 0; j < len; j++)
+        buf[j] = (CK_BYTE)(i + version + j);
+    return len;
+}
+
+static int put(struct objdb *db, unsigned long i, unsigned long version)
+{
+    char name[OBJDB_NAME_LEN + 1];
+    CK_BYTE buf[300];
+    CK_ULONG len;
+
+    objname(name, i);
+    len = objdata(buf, i, version);
+    if (objdb_put(db, name, buf, len) != CKR_OK) {
+        fprintf(stderr, "objdb_put(%s) failed\n", name);
+        return -1;
+    }
+    return 0;
+}
+
+/* Checks the object's contents, version 0 means that it must not exist */
+static int check(struct objdb *db, unsigned long i, unsigned long version)
+{
+    char name[OBJDB_NAME_LEN + 1];
+    CK_BYTE buf[300], *data;
+    CK_ULONG len, data_len;
+
+    objname(name, i);
+    if (objdb_get(db, name, &data, &data_len) != CKR_OK) {
+        fprintf(stderr, "objdb_get(%s) failed\n", name);
+        return -1;
+    }
+
+    if (version == 0) {
+        if (data != NULL) {
+            fprintf(stderr, "deleted object %s still found\n", name);
+            return -1;
+        }
+        return 0;
+    }
+
+    len = objdata(buf, i, version);
+    if (data == NULL || data_len != len || memcmp(data, buf, len) != 0) {
+        fprintf(stderr, "object %s does not have the contents of version "
+                "%lu\n", name, version);
+        return -1;
+    }
+    return 0;
+}
+
+static int check_all(struct objdb *db, const unsigned long *versions,
+                     unsigned long count)
+{
+    unsigned long i;
+
+    for (i = 0; i < count; i++) {
+        if (check(db, i, versions[i]))
+            return -1;
+    }
+    return 0;
+}
+
+static CK_RV count_cb(const char *name, CK_BYTE *data, CK_ULONG len,
+                      void *private)
+{
+    unsigned long *count = private;
+
+    (void)name;
+    (void)data;
+    (void)len;
+    (*count)++;
+    return CKR_OK;
+}
+
+static int check_count(struct objdb *db, const unsigned long *versions,
+                       unsigned long count)
+{
+    unsigned long i, expected = 0, found = 0;
+
+    for (i = 0; i < count; i++) {
+        if (versions[i] != 0)
+            expected++;
+    }
+
+    if (objdb_for_each(db, count_cb, &found) != CKR_OK) {
+        fprintf(stderr, "objdb_for_each failed\n");
+        return -1;
+    }
+    if (found != expected) {
+        fprintf(stderr, "objdb_for_each found %lu objects, expected %lu\n",
+                found, expected);
+        return -1;
+    }
+    return 0;
+}
+
+static ino_t inode(void)
+{
+    struct stat sb;
+
+    if (stat(dbpath, &sb) != 0)
+        return 0;
+    return sb.st_ino;
+}
+
+/* Put, update, delete, and reopen */
+static int testbasic(unsigned long *versions)
+{
+    char name[OBJDB_NAME_LEN + 1];
+    struct objdb db;
+    unsigned long i;
+    int res = -1;
+
+    if (objdb_open(&db, dbpath) != CKR_OK) {
+        fprintf(stderr, "objdb_open failed\n");
+        return -1;
+    }
+
+    for (i = 0; i < 100; i++) {
+        if (put(&db, i, 1))
+            goto out;
+        versions[i] = 1;
+    }
+    for (i = 0; i < 100; i += 3) {
+        if (put(&db, i, 2))
+            goto out;
+        versions[i] = 2;
+    }
+    for (i = 1; i < 100; i += 5) {
+        objname(name, i);
+        if (objdb_delete(&db, name) != CKR_OK) {
+            fprintf(stderr, "objdb_delete(%s) failed\n", name);
+            goto out;
+        }
+        versions[i] = 0;
+    }
+    /* deleting an object that does not exist is not an error */
+    if (objdb_delete(&db, "NOTTHERE") != CKR_OK) {
+        fprintf(stderr, "objdb_delete of a missing object failed\n");
+        goto out;
+    }
+    if (check_all(&db, versions, 100) || check_count(&db, versions, 100))
+        goto out;
+
+    if (objdb_sync(&db) != CKR_OK) {
+        fprintf(stderr, "objdb_sync failed\n");
+        goto out;
+    }
+    objdb_close(&db);
+
+    if (objdb_open(&db, dbpath) != CKR_OK) {
+        fprintf(stderr, "objdb_open failed after close\n");
+        return -1;
+    }
+    if (check_all(&db, versions, 100) || check_count(&db, versions, 100)) {
+        fprintf(stderr, "store differs after reopen\n");
+        goto out;
+    }
+
+    res = 0;
+out:
+    objdb_close(&db);
+    return res;
+}
+
+/*
+ * A process died while updating the store: the dirty flag is set, the
+ * index is lost, and the last record was only partially written.
+ */
+static int testrebuild(unsigned long *versions)
+{
+    struct objdb db;
+    struct objdb_hdr *hdr;
+    struct objdb_rec *rec;
+    uint64_t tail;
+    int res = -1;
+
+    if (objdb_open(&db, dbpath) != CKR_OK) {
+        fprintf(stderr, "objdb_open failed\n");
+        return -1;
+    }
+
+    hdr = objdb_hdr(&db);
+    tail = be64toh(hdr->tail);
+    rec = (struct objdb_rec *)(db.map + tail);
+    rec->magic = htobe32(OBJDB_REC_MAGIC);
+    memcpy(rec->name, "OB000000", OBJDB_NAME_LEN);
+    rec->len = htobe32(16);
+    rec->csum = htobe32(0);     /* never written */
+
+    memset(objdb_index(&db), 0,
+           (size_t)be32toh(hdr->index_slots) * sizeof(struct objdb_slot));
+    hdr->index_used = 0;
+    hdr->tail = htobe64(be64toh(hdr->data_off));
+    hdr->flags |= htobe32(OBJDB_DIRTY);
+    objdb_close(&db);
+
+    if (objdb_open(&db, dbpath) != CKR_OK) {
+        fprintf(stderr, "objdb_open failed for a dirty store\n");
+        return -1;
+    }
+
+    hdr = objdb_hdr(&db);
+    if (be32toh(hdr->flags) & OBJDB_DIRTY) {
+        fprintf(stderr, "dirty flag still set after rebuild\n");
+        goto out;
+    }
+    if (be64toh(hdr->tail) != tail) {
+        fprintf(stderr, "rebuild did not stop at the partial record\n");
+        goto out;
+    }
+    if (check_all(&db, versions, 100) || check_count(&db, versions, 100)) {
+        fprintf(stderr, "store differs after rebuild\n");
+        goto out;
+    }
+
+    /* the partial record is overwritten by the next update */
+    if (put(&db, 0, 3))
+        goto out;
+    versions[0] = 3;
+    if (check_all(&db, versions, 100))
+        goto out;
+
+    res = 0;
+out:
+    objdb_close(&db);
+    return res;
+}
+
+/*
+ * Growing the index and reclaiming superseded records both replace the
+ * file. A second handle, like another process, must follow the new file.
+ */
+static int testcompaction(unsigned long *versions)
+{
+    struct objdb db, other;
+    uint32_t slots;
+    unsigned long i, round;
+    ino_t ino;
+    int res = -1;
+
+    if (objdb_open(&db, dbpath) != CKR_OK) {
+        fprintf(stderr, "objdb_open failed\n");
+        return -1;
+    }
+    if (objdb_open(&other, dbpath) != CKR_OK) {
+        fprintf(stderr, "objdb_open failed for the second handle\n");
+        objdb_close(&db);
+        return -1;
+    }
+
+    /* more objects than the initial index can take */
+    ino = inode();
+    slots = be32toh(objdb_hdr(&db)->index_slots);
+    for (i = 0; i < NUM_OBJS; i++) {
+        if (put(&db, i, 4))
+            goto out;
+        versions[i] = 4;
+    }
+    if (be32toh(objdb_hdr(&db)->index_slots) <= slots || inode() == ino) {
+        fprintf(stderr, "index was not grown\n");
+        goto out;
+    }
+    if (check_all(&other, versions, NUM_OBJS)) {
+        fprintf(stderr, "second handle differs after index growth\n");
+        goto out;
+    }
+
+    /* superseded records are reclaimed instead of growing the file */
+    ino = inode();
+    for (round = 5; round < 25; round++) {
+        for (i = 0; i < NUM_OBJS; i += 2) {
+            if (put(&db, i, round))
+                goto out;
+            versions[i] = round;
+        }
+    }
+    if (inode() == ino) {
+        fprintf(stderr, "superseded records were not reclaimed\n");
+        goto out;
+    }
+    if (be64toh(objdb_hdr(&db)->dead_bytes) >
+        be64toh(objdb_hdr(&db)->file_len)) {
+        fprintf(stderr, "dead bytes not accounted correctly\n");
+        goto out;
+    }
+    if (check_all(&db, versions, NUM_OBJS) ||
+        check_count(&db, versions, NUM_OBJS) ||
+        check_all(&other, versions, NUM_OBJS)) {
+        fprintf(stderr, "store differs after compaction\n");
+        goto out;
+    }
+
+    objdb_close(&db);
+    if (objdb_open(&db, dbpath) != CKR_OK) {
+        fprintf(stderr, "objdb_open failed after compaction\n");
+        goto out;
+    }
+    if (check_all(&db, versions, NUM_OBJS)) {
+        fprintf(stderr, "store differs after compaction and reopen\n");
+        goto out;
+    }
+
+    /* C_InitToken removes all objects */
+    if (objdb_reset(&db) != CKR_OK) {
+        fprintf(stderr, "objdb_reset failed\n");
+        goto out;
+    }
+    memset(versions, 0, NUM_OBJS * sizeof(*versions));
+    if (check_count(&db, versions, NUM_OBJS) ||
+        check_all(&other, versions, NUM_OBJS)) {
+        fprintf(stderr, "store not empty after reset\n");
+        goto out;
+    }
+
+    res = 0;
+out:
+    objdb_close(&other);
+    objdb_close(&db);
+    return res;
+}
+
+/* Damage the data of the object's current record */
+static void tear(struct objdb *db, unsigned long i)
+{
+    char name[OBJDB_NAME_LEN + 1];
+    struct objdb_slot *slot;
+    struct objdb_rec *rec;
+
+    objname(name, i);
+    slot = objdb_find_slot(objdb_index(db),
+                           be32toh(objdb_hdr(db)->index_slots), name,
+                           objdb_name_hash(name));
+    rec = (struct objdb_rec *)(db->map + be64toh(slot->offset));
+    ((CK_BYTE *)(rec + 1))[0] ^= 0xff;
+}
+
+/*
+ * The system crashed after the index and the tail of an update reached the
+ * disk, but only a part of its record. Reading the object must not return
+ * the partial record, but rebuild the index from the valid records.
+ */
+static int testtorn(unsigned long *versions)
+{
+    struct objdb db;
+    unsigned long i;
+    int res = -1;
+
+    if (objdb_open(&db, dbpath) != CKR_OK) {
+        fprintf(stderr, "objdb_open failed\n");
+        return -1;
+    }
+
+    for (i = 0; i < 10; i++) {
+        if (put(&db, i, 1))
+            goto out;
+        versions[i] = 1;
+    }
+
+    /* found by objdb_get */
+    if (put(&db, 3, 2))
+        goto out;
+    tear(&db, 3);
+    if (check_all(&db, versions, 10)) {
+        fprintf(stderr, "torn record not detected by objdb_get\n");
+        goto out;
+    }
+
+    /* found by objdb_for_each */
+    if (put(&db, 5, 2))
+        goto out;
+    tear(&db, 5);
+    if (check_count(&db, versions, 10) || check_all(&db, versions, 10)) {
+        fprintf(stderr, "torn record not detected by objdb_for_each\n");
+        goto out;
+    }
+
+    /* the torn record is overwritten by the next update */
+    if (put(&db, 5, 3))
+        goto out;
+    versions[5] = 3;
+    if (check_all(&db, versions, 10))
+        goto out;
+
+    res = 0;
+out:
+    objdb_close(&db);
+    return res;
+}
+
+int main(void)
+{
+    char dir[] = "/tmp/objdbtestXXXXXX";
+    unsigned long versions[NUM_OBJS] = { 0 };
+    int res = TEST_PASS;
+
+    if (mkdtemp(dir) == NULL) {
+        perror("mkdtemp");
+        return TEST_SKIP;
+    }
+    snprintf(dbpath, sizeof(dbpath), "%s/%s", dir, PK_LITE_OBJ_DB);
+
+    if (testbasic(versions) || testrebuild(versions) ||
+        testcompaction(versions) || testtorn(versions))
+        res = TEST_FAIL;
+
+    unlink(dbpath);
+    rmdir(dir);
+    return res;
+}
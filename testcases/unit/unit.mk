@@ -1,8 +1,10 @@
 check_PROGRAMS = testcases/unit/policytest testcases/unit/hashmaptest	\
-	testcases/unit/mechtabletest testcases/unit/configdump
+	testcases/unit/mechtabletest testcases/unit/configdump		\
+	testcases/unit/objdbtest
 
 TESTS = testcases/unit/policytest testcases/unit/hashmaptest		\
-	testcases/unit/mechtabletest testcases/unit/configdump
+	testcases/unit/mechtabletest testcases/unit/configdump		\
+	testcases/unit/objdbtest
 
 testcases_unit_policytest_CFLAGS=-I${top_srcdir}/usr/lib/common		\
 	-I${top_srcdir}/usr/lib/api -I${top_srcdir}/usr/include		\
@@ -42,3 +44,10 @@ testcases_unit_configdump_SOURCES = testcases/unit/configdump.c	\
 
 testcases_unit_configdump_CFLAGS=-I${top_srcdir}/usr/lib/config	\
 	-I${top_builddir}/usr/lib/config
+
+testcases_unit_objdbtest_CFLAGS=-I${top_srcdir}/usr/lib/common		\
+	-I${top_srcdir}/usr/lib/api -I${top_srcdir}/usr/include		\
+	-I${top_builddir}/usr/lib/api -DSTDLL_NAME=\"objdbtest\"
+
+testcases_unit_objdbtest_SOURCES = testcases/unit/objdbtest.c		\
+	usr/lib/common/trace.c
@@ -285,6 +285,30 @@ extern "C" {
                                 CK_OBJECT_HANDLE, CK_MECHANISM_PTR,
                                 CK_OBJECT_HANDLE, CK_BYTE_PTR,
                                 CK_ULONG, CK_BYTE_PTR, CK_ULONG_PTR);
+
+    CK_RV C_IBM_CreateObjects(CK_SESSION_HANDLE, CK_IBM_OBJECT_TEMPLATE_PTR,
+                              CK_ULONG, CK_OBJECT_HANDLE_PTR);
+
+    CK_RV C_IBM_GetAttributeValues(CK_SESSION_HANDLE, CK_OBJECT_HANDLE_PTR,
+                                   CK_ULONG, CK_IBM_OBJECT_TEMPLATE_PTR,
+                                   CK_RV *);
+
+    CK_RV C_IBM_DigestBatch(CK_SESSION_HANDLE, CK_MECHANISM_PTR,
+                            CK_IBM_DATA_PTR, CK_ULONG, CK_BYTE_PTR,
+                            CK_ULONG_PTR);
+
+    CK_RV C_IBM_VerifyBatch(CK_SESSION_HANDLE, CK_MECHANISM_PTR,
+                            CK_IBM_VERIFY_DATA_PTR, CK_ULONG, CK_RV *);
+
+    CK_RV C_IBM_SignAsync(CK_SESSION_HANDLE, CK_MECHANISM_PTR,
+                          CK_OBJECT_HANDLE, CK_BYTE_PTR, CK_ULONG,
+                          CK_BYTE_PTR, CK_ULONG_PTR, int, CK_ULONG_PTR);
+
+    CK_RV C_IBM_EncryptAsync(CK_SESSION_HANDLE, CK_MECHANISM_PTR,
+                             CK_OBJECT_HANDLE, CK_BYTE_PTR, CK_ULONG,
+                             CK_BYTE_PTR, CK_ULONG_PTR, int, CK_ULONG_PTR);
+
+    CK_RV C_IBM_AsyncWait(CK_SESSION_HANDLE, CK_ULONG, CK_BBOOL);
 #ifdef __cplusplus
 }
 #endif
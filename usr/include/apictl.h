@@ -53,7 +53,7 @@ struct API_Slot {
 typedef struct {
     key_t shm_tok;
 
-    struct btree sess_btree;
+    struct handle_table sess_table;
     void *SharedMemP;
     Slot_Mgr_Socket_t SocketDataP;
     Slot_Mgr_Client_Cred_t ClientCred;
@@ -11,6 +11,8 @@
 #ifndef __LOCAL_TYPES
 #define __LOCAL_TYPES
 
+#include <pthread.h>
+
 #define member_size(type, member) sizeof(((type *)0)->member)
 
 typedef unsigned char uint8;
@@ -57,6 +59,40 @@ struct btree {
     void (*delete_func)(void *);
 };
 
+/*
+ * Handle table
+ *
+ * A flat table of reference counted values (which must start with struct
+ * bt_ref_hdr, like btree values), addressed by handles of the form
+ * (generation << HT_INDEX_BITS) | (index + 1). Lookups are lock-free: they
+ * are a single indexed load of the entry plus atomic operations on the
+ * entry's state word, which holds the generation, a live flag, and a count
+ * of readers currently pinning the entry. Adding and removing entries is
+ * serialized by the table's mutex. A removed entry's generation is bumped,
+ * so stale handles are not resolved to a reused entry.
+ */
+#define HT_INDEX_BITS       20
+#define HT_INDEX_MASK       ((1UL << HT_INDEX_BITS) - 1)
+#define HT_CHUNK_BITS       10
+#define HT_CHUNK_SIZE       (1UL << HT_CHUNK_BITS)
+#define HT_DIR_SIZE         (1UL << (HT_INDEX_BITS - HT_CHUNK_BITS))
+#define HT_MAX_ENTRIES      HT_INDEX_MASK
+
+struct ht_entry {
+    volatile unsigned long state;
+    void *volatile value;
+    unsigned long next_free;    /* index + 1 of next free entry, or 0 */
+};
+
+struct handle_table {
+    struct ht_entry *volatile dir[HT_DIR_SIZE];
+    volatile unsigned long size;        /* entries ever used */
+    volatile unsigned long in_use;      /* entries currently live */
+    unsigned long free_list;            /* index + 1 of first free entry */
+    pthread_mutex_t mutex;
+    void (*delete_func)(void *);
+};
+
 typedef struct _STDLL_TokData_t STDLL_TokData_t;
 typedef struct _LW_SHM_TYPE LW_SHM_TYPE;
 typedef struct API_Slot API_Slot_t;
@@ -75,4 +111,16 @@ void *bt_node_free(struct btree *t, unsigned long node_num,
 void bt_destroy(struct btree *t);
 void bt_init(struct btree *t, void (*delete_func)(void *));
 
+void *ht_get_value(struct handle_table *t, unsigned long handle);
+int ht_put_value(struct handle_table *t, void *value);
+int ht_is_empty(struct handle_table *t);
+void ht_for_each(STDLL_TokData_t *, struct handle_table *t,
+                 void (*)(STDLL_TokData_t *, void *, unsigned long, void *),
+                 void *);
+unsigned long ht_in_use(struct handle_table *t);
+unsigned long ht_add(struct handle_table *t, void *value);
+void *ht_remove(struct handle_table *t, unsigned long handle, int put_value);
+void ht_destroy(struct handle_table *t);
+void ht_init(struct handle_table *t, void (*delete_func)(void *));
+
 #endif
@@ -977,6 +977,15 @@ typedef struct CK_MECHANISM_INFO {
  *      Bit Flag               Mask        Meaning */
 #define CKF_HW                 0x00000001       /* performed by HW */
 
+/* The flags CKF_MESSAGE_ENCRYPT, CKF_MESSAGE_DECRYPT, CKF_MESSAGE_SIGN,
+ * CKF_MESSAGE_VERIFY and CKF_MULTI_MESSAGE are new for v3.0. They specify
+ * whether or not a mechanism can be used with the message based functions */
+#define CKF_MESSAGE_ENCRYPT    0x00000002
+#define CKF_MESSAGE_DECRYPT    0x00000004
+#define CKF_MESSAGE_SIGN       0x00000008
+#define CKF_MESSAGE_VERIFY     0x00000010
+#define CKF_MULTI_MESSAGE      0x00000020
+
 /* The flags CKF_ENCRYPT, CKF_DECRYPT, CKF_DIGEST, CKF_SIGN,
  * CKG_SIGN_RECOVER, CKF_VERIFY, CKF_VERIFY_RECOVER,
  * CKF_GENERATE, CKF_GENERATE_KEY_PAIR, CKF_WRAP, CKF_UNWRAP,
@@ -1155,6 +1164,8 @@ typedef CK_ULONG CK_RV;
 /* Not really a return value, but stored in ulDeviceError of session
    info for policy violations. */
 #define CKR_POLICY_VIOLATION                  (CKR_VENDOR_DEFINED + 0x1)
+/* Returned by C_IBM_AsyncWait for an operation that is not done yet */
+#define CKR_IBM_ASYNC_PENDING                 (CKR_VENDOR_DEFINED + 0x2)
 
 
 /* CK_NOTIFY is an application callback that processes events */
@@ -1218,6 +1229,10 @@ typedef CK_C_INITIALIZE_ARGS CK_PTR CK_C_INITIALIZE_ARGS_PTR;
 /* CKF_DONT_BLOCK is for the function C_WaitForSlotEvent */
 #define CKF_DONT_BLOCK     1
 
+/* CKF_END_OF_MESSAGE is for the functions C_EncryptMessageNext and
+ * C_DecryptMessageNext, new for v3.0 */
+#define CKF_END_OF_MESSAGE 0x00000001
+
 
 /* CK_KEA_DERIVE_PARAMS provides the parameters to the
  * CKM_KEA_DERIVE mechanism */
@@ -1313,6 +1328,30 @@ typedef struct CK_GCM_PARAMS_COMPAT {
     CK_ULONG ulTagBits;
 } CK_GCM_PARAMS_COMPAT;
 
+/* CK_GENERATOR_FUNCTION is new for v3.0 and specifies how the IV of a
+ * message based AEAD operation is produced */
+typedef CK_ULONG CK_GENERATOR_FUNCTION;
+
+#define CKG_NO_GENERATE                 0x00000000UL
+#define CKG_GENERATE                    0x00000001UL
+#define CKG_GENERATE_COUNTER            0x00000002UL
+#define CKG_GENERATE_RANDOM             0x00000003UL
+#define CKG_GENERATE_COUNTER_XOR        0x00000004UL
+
+/* CK_GCM_MESSAGE_PARAMS is new for v3.0 and provides the per-message
+ * parameters to the CKM_AES_GCM mechanism used with the message based
+ * functions */
+typedef struct CK_GCM_MESSAGE_PARAMS {
+    CK_BYTE_PTR pIv;
+    CK_ULONG ulIvLen;
+    CK_ULONG ulIvFixedBits;
+    CK_GENERATOR_FUNCTION ivGenerator;
+    CK_BYTE_PTR pTag;
+    CK_ULONG ulTagBits;
+} CK_GCM_MESSAGE_PARAMS;
+
+typedef CK_GCM_MESSAGE_PARAMS CK_PTR CK_GCM_MESSAGE_PARAMS_PTR;
+
 /* CK_RC5_CBC_PARAMS provides the parameters to the CKM_RC5_CBC
  * mechanism */
 /* CK_RC5_CBC_PARAMS is new for v2.0 */
@@ -1529,6 +1568,36 @@ typedef struct CK_IBM_ATTRIBUTEBOUND_WRAP {
       CK_OBJECT_HANDLE hSignVerifyKey;
 } CK_IBM_ATTRIBUTEBOUND_WRAP_PARAMS;
 
+/*
+ * Template of one of the objects to create with C_IBM_CreateObjects, or of
+ * one of the objects to get the attributes of with C_IBM_GetAttributeValues
+ */
+typedef struct CK_IBM_OBJECT_TEMPLATE {
+    CK_ATTRIBUTE_PTR pTemplate;
+    CK_ULONG ulCount;
+} CK_IBM_OBJECT_TEMPLATE;
+
+typedef CK_IBM_OBJECT_TEMPLATE CK_PTR CK_IBM_OBJECT_TEMPLATE_PTR;
+
+/* One of the data buffers to digest with C_IBM_DigestBatch */
+typedef struct CK_IBM_DATA {
+    CK_BYTE_PTR pData;
+    CK_ULONG ulDataLen;
+} CK_IBM_DATA;
+
+typedef CK_IBM_DATA CK_PTR CK_IBM_DATA_PTR;
+
+/* One of the signatures to verify with C_IBM_VerifyBatch */
+typedef struct CK_IBM_VERIFY_DATA {
+    CK_OBJECT_HANDLE hKey;
+    CK_BYTE_PTR pData;
+    CK_ULONG ulDataLen;
+    CK_BYTE_PTR pSignature;
+    CK_ULONG ulSignatureLen;
+} CK_IBM_VERIFY_DATA;
+
+typedef CK_IBM_VERIFY_DATA CK_PTR CK_IBM_VERIFY_DATA_PTR;
+
 /* EC key derivation functions */
 #define CKD_NULL                    0x00000001UL
 #define CKD_SHA1_KDF                0x00000002UL
@@ -1574,6 +1643,10 @@ typedef struct CK_IBM_FUNCTION_LIST_1_0 CK_IBM_FUNCTION_LIST_1_0;
 typedef struct CK_IBM_FUNCTION_LIST_1_0 CK_PTR CK_IBM_FUNCTION_LIST_1_0_PTR;
 typedef CK_IBM_FUNCTION_LIST_1_0_PTR CK_PTR CK_IBM_FUNCTION_LIST_1_0_PTR_PTR;
 
+typedef struct CK_IBM_FUNCTION_LIST_1_1 CK_IBM_FUNCTION_LIST_1_1;
+typedef struct CK_IBM_FUNCTION_LIST_1_1 CK_PTR CK_IBM_FUNCTION_LIST_1_1_PTR;
+typedef CK_IBM_FUNCTION_LIST_1_1_PTR CK_PTR CK_IBM_FUNCTION_LIST_1_1_PTR_PTR;
+
 typedef CK_RV (CK_PTR CK_C_Initialize) (CK_VOID_PTR pReserved);
 typedef CK_RV (CK_PTR CK_C_Finalize) (CK_VOID_PTR pReserved);
 typedef CK_RV (CK_PTR CK_C_Terminate) (void);
@@ -1937,6 +2010,47 @@ typedef CK_RV (CK_PTR CK_C_IBM_ReencryptSingle) (CK_SESSION_HANDLE hSession,
                                                  CK_ULONG ulEncryptedDataLen,
                                                  CK_BYTE_PTR pReencryptedData,
                                                  CK_ULONG_PTR pulReencryptedDataLen);
+typedef CK_RV (CK_PTR CK_C_IBM_CreateObjects) (CK_SESSION_HANDLE hSession,
+                                               CK_IBM_OBJECT_TEMPLATE_PTR pTemplates,
+                                               CK_ULONG ulObjectCount,
+                                               CK_OBJECT_HANDLE_PTR phObjects);
+typedef CK_RV (CK_PTR CK_C_IBM_GetAttributeValues) (CK_SESSION_HANDLE hSession,
+                                                    CK_OBJECT_HANDLE_PTR phObjects,
+                                                    CK_ULONG ulObjectCount,
+                                                    CK_IBM_OBJECT_TEMPLATE_PTR pTemplates,
+                                                    CK_RV *pReturnValues);
+typedef CK_RV (CK_PTR CK_C_IBM_DigestBatch) (CK_SESSION_HANDLE hSession,
+                                             CK_MECHANISM_PTR pMechanism,
+                                             CK_IBM_DATA_PTR pData,
+                                             CK_ULONG ulDataCount,
+                                             CK_BYTE_PTR pDigests,
+                                             CK_ULONG_PTR pulDigestsLen);
+typedef CK_RV (CK_PTR CK_C_IBM_VerifyBatch) (CK_SESSION_HANDLE hSession,
+                                             CK_MECHANISM_PTR pMechanism,
+                                             CK_IBM_VERIFY_DATA_PTR pItems,
+                                             CK_ULONG ulItemCount,
+                                             CK_RV *pReturnValues);
+typedef CK_RV (CK_PTR CK_C_IBM_SignAsync) (CK_SESSION_HANDLE hSession,
+                                           CK_MECHANISM_PTR pMechanism,
+                                           CK_OBJECT_HANDLE hKey,
+                                           CK_BYTE_PTR pData,
+                                           CK_ULONG ulDataLen,
+                                           CK_BYTE_PTR pSignature,
+                                           CK_ULONG_PTR pulSignatureLen,
+                                           int iNotifyFd,
+                                           CK_ULONG_PTR phOperation);
+typedef CK_RV (CK_PTR CK_C_IBM_EncryptAsync) (CK_SESSION_HANDLE hSession,
+                                              CK_MECHANISM_PTR pMechanism,
+                                              CK_OBJECT_HANDLE hKey,
+                                              CK_BYTE_PTR pData,
+                                              CK_ULONG ulDataLen,
+                                              CK_BYTE_PTR pEncryptedData,
+                                              CK_ULONG_PTR pulEncryptedDataLen,
+                                              int iNotifyFd,
+                                              CK_ULONG_PTR phOperation);
+typedef CK_RV (CK_PTR CK_C_IBM_AsyncWait) (CK_SESSION_HANDLE hSession,
+                                           CK_ULONG hOperation,
+                                           CK_BBOOL bBlock);
 
 struct CK_FUNCTION_LIST {
     CK_VERSION version;
@@ -2112,6 +2226,18 @@ struct CK_IBM_FUNCTION_LIST_1_0 {
     CK_C_IBM_ReencryptSingle C_IBM_ReencryptSingle;
 };
 
+struct CK_IBM_FUNCTION_LIST_1_1 {
+    CK_VERSION version;
+    CK_C_IBM_ReencryptSingle C_IBM_ReencryptSingle;
+    CK_C_IBM_CreateObjects C_IBM_CreateObjects;
+    CK_C_IBM_GetAttributeValues C_IBM_GetAttributeValues;
+    CK_C_IBM_DigestBatch C_IBM_DigestBatch;
+    CK_C_IBM_VerifyBatch C_IBM_VerifyBatch;
+    CK_C_IBM_SignAsync C_IBM_SignAsync;
+    CK_C_IBM_EncryptAsync C_IBM_EncryptAsync;
+    CK_C_IBM_AsyncWait C_IBM_AsyncWait;
+};
+
 #ifdef __cplusplus
 }
 #endif
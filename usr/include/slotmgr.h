@@ -100,6 +100,17 @@ typedef struct {
     LW_SHM_TYPE *shm_addr;      // token specific shm address
 } Slot_Info_t;
 
+/* token object store formats (objstore in opencryptoki.conf) */
+#define OBJSTORE_FILES                0   // one file per object in TOK_OBJ
+#define OBJSTORE_MMAP                 1   // single file TOK_OBJ/OBJ.DB
+
+/* token object loading (objload in opencryptoki.conf) */
+#define OBJLOAD_EAGER                 0   // load all objects at init/login
+#define OBJLOAD_LAZY                  1   // load objects on first use
+
+/* lowest PBKDF2 iteration count accepted for pbkdf2_iterations */
+#define PBKDF2_MIN_ITERATIONS         1000
+
 #define FLAG_EVENT_SUPPORT_DISABLED   0x01
 #define FLAG_STATISTICS_ENABLED       0x02
 #define FLAG_STATISTICS_IMPLICIT      0x04
@@ -193,6 +204,10 @@ typedef struct {
     char tokname[NAME_MAX + 1]; // token specific directory
     LW_SHM_TYPE *shm_addr;      // token specific shm address
     uint32_t version; // version: major<<16|minor
+    uint32_t objstore; // OBJSTORE_FILES or OBJSTORE_MMAP
+    uint32_t objload; // OBJLOAD_EAGER or OBJLOAD_LAZY
+    uint32_t pbkdf2_it; // PBKDF2 iterations for new PINs, 0 = default
+    uint32_t login_cache_ttl; // seconds, 0 = no login key cache
 } Slot_Info_t_64;
 
 typedef Slot_Info_t_64 SLOT_INFO;
@@ -349,6 +349,117 @@ typedef CK_RV (CK_PTR ST_C_IBM_ReencryptSingle)(STDLL_TokData_t *tokdata,
                                                 CK_ULONG ulEncryptedDataLen,
                                                 CK_BYTE_PTR pReencryptedData,
                                             CK_ULONG_PTR pulReencryptedDataLen);
+typedef CK_RV (CK_PTR ST_C_IBM_CreateObjects)(STDLL_TokData_t *tokdata,
+                                              ST_SESSION_T *hSession,
+                                              CK_IBM_OBJECT_TEMPLATE_PTR pTemplates,
+                                              CK_ULONG ulObjectCount,
+                                              CK_OBJECT_HANDLE_PTR phObjects);
+typedef CK_RV (CK_PTR ST_C_IBM_GetAttributeValues)(STDLL_TokData_t *tokdata,
+                                                   ST_SESSION_T *hSession,
+                                                   CK_OBJECT_HANDLE_PTR phObjects,
+                                                   CK_ULONG ulObjectCount,
+                                                   CK_IBM_OBJECT_TEMPLATE_PTR pTemplates,
+                                                   CK_RV *pReturnValues);
+typedef CK_RV (CK_PTR ST_C_IBM_DigestBatch)(STDLL_TokData_t *tokdata,
+                                            ST_SESSION_T *hSession,
+                                            CK_MECHANISM_PTR pMechanism,
+                                            CK_IBM_DATA_PTR pData,
+                                            CK_ULONG ulDataCount,
+                                            CK_BYTE_PTR pDigests,
+                                            CK_ULONG_PTR pulDigestsLen);
+typedef CK_RV (CK_PTR ST_C_IBM_VerifyBatch)(STDLL_TokData_t *tokdata,
+                                            ST_SESSION_T *hSession,
+                                            CK_MECHANISM_PTR pMechanism,
+                                            CK_IBM_VERIFY_DATA_PTR pItems,
+                                            CK_ULONG ulItemCount,
+                                            CK_RV *pReturnValues);
+typedef CK_RV (CK_PTR ST_C_IBM_SignAsync)(STDLL_TokData_t *tokdata,
+                                          ST_SESSION_T *hSession,
+                                          CK_MECHANISM_PTR pMechanism,
+                                          CK_OBJECT_HANDLE hKey,
+                                          CK_BYTE_PTR pData,
+                                          CK_ULONG ulDataLen,
+                                          CK_BYTE_PTR pSignature,
+                                          CK_ULONG_PTR pulSignatureLen,
+                                          int iNotifyFd,
+                                          CK_ULONG_PTR phOperation);
+typedef CK_RV (CK_PTR ST_C_IBM_EncryptAsync)(STDLL_TokData_t *tokdata,
+                                             ST_SESSION_T *hSession,
+                                             CK_MECHANISM_PTR pMechanism,
+                                             CK_OBJECT_HANDLE hKey,
+                                             CK_BYTE_PTR pData,
+                                             CK_ULONG ulDataLen,
+                                             CK_BYTE_PTR pEncryptedData,
+                                             CK_ULONG_PTR pulEncryptedDataLen,
+                                             int iNotifyFd,
+                                             CK_ULONG_PTR phOperation);
+typedef CK_RV (CK_PTR ST_C_IBM_AsyncWait)(STDLL_TokData_t *tokdata,
+                                          ST_SESSION_T *hSession,
+                                          CK_ULONG hOperation,
+                                          CK_BBOOL bBlock);
+
+typedef CK_RV (CK_PTR ST_C_MessageEncryptInit)(STDLL_TokData_t *tokdata,
+                                               ST_SESSION_T *hSession,
+                                               CK_MECHANISM_PTR pMechanism,
+                                               CK_OBJECT_HANDLE hKey);
+typedef CK_RV (CK_PTR ST_C_EncryptMessage)(STDLL_TokData_t *tokdata,
+                                           ST_SESSION_T *hSession,
+                                           CK_VOID_PTR pParameter,
+                                           CK_ULONG ulParameterLen,
+                                           CK_BYTE_PTR pAssociatedData,
+                                           CK_ULONG ulAssociatedDataLen,
+                                           CK_BYTE_PTR pPlaintext,
+                                           CK_ULONG ulPlaintextLen,
+                                           CK_BYTE_PTR pCiphertext,
+                                           CK_ULONG_PTR pulCiphertextLen);
+typedef CK_RV (CK_PTR ST_C_EncryptMessageBegin)(STDLL_TokData_t *tokdata,
+                                                ST_SESSION_T *hSession,
+                                                CK_VOID_PTR pParameter,
+                                                CK_ULONG ulParameterLen,
+                                                CK_BYTE_PTR pAssociatedData,
+                                                CK_ULONG ulAssociatedDataLen);
+typedef CK_RV (CK_PTR ST_C_EncryptMessageNext)(STDLL_TokData_t *tokdata,
+                                               ST_SESSION_T *hSession,
+                                               CK_VOID_PTR pParameter,
+                                               CK_ULONG ulParameterLen,
+                                               CK_BYTE_PTR pPlaintextPart,
+                                               CK_ULONG ulPlaintextPartLen,
+                                               CK_BYTE_PTR pCiphertextPart,
+                                           CK_ULONG_PTR pulCiphertextPartLen,
+                                               CK_FLAGS flags);
+typedef CK_RV (CK_PTR ST_C_MessageEncryptFinal)(STDLL_TokData_t *tokdata,
+                                                ST_SESSION_T *hSession);
+typedef CK_RV (CK_PTR ST_C_MessageDecryptInit)(STDLL_TokData_t *tokdata,
+                                               ST_SESSION_T *hSession,
+                                               CK_MECHANISM_PTR pMechanism,
+                                               CK_OBJECT_HANDLE hKey);
+typedef CK_RV (CK_PTR ST_C_DecryptMessage)(STDLL_TokData_t *tokdata,
+                                           ST_SESSION_T *hSession,
+                                           CK_VOID_PTR pParameter,
+                                           CK_ULONG ulParameterLen,
+                                           CK_BYTE_PTR pAssociatedData,
+                                           CK_ULONG ulAssociatedDataLen,
+                                           CK_BYTE_PTR pCiphertext,
+                                           CK_ULONG ulCiphertextLen,
+                                           CK_BYTE_PTR pPlaintext,
+                                           CK_ULONG_PTR pulPlaintextLen);
+typedef CK_RV (CK_PTR ST_C_DecryptMessageBegin)(STDLL_TokData_t *tokdata,
+                                                ST_SESSION_T *hSession,
+                                                CK_VOID_PTR pParameter,
+                                                CK_ULONG ulParameterLen,
+                                                CK_BYTE_PTR pAssociatedData,
+                                                CK_ULONG ulAssociatedDataLen);
+typedef CK_RV (CK_PTR ST_C_DecryptMessageNext)(STDLL_TokData_t *tokdata,
+                                               ST_SESSION_T *hSession,
+                                               CK_VOID_PTR pParameter,
+                                               CK_ULONG ulParameterLen,
+                                               CK_BYTE_PTR pCiphertextPart,
+                                               CK_ULONG ulCiphertextPartLen,
+                                               CK_BYTE_PTR pPlaintextPart,
+                                               CK_ULONG_PTR pulPlaintextPartLen,
+                                               CK_FLAGS flags);
+typedef CK_RV (CK_PTR ST_C_MessageDecryptFinal)(STDLL_TokData_t *tokdata,
+                                                ST_SESSION_T *hSession);
 
 typedef CK_RV (CK_PTR ST_C_HandleEvent)(STDLL_TokData_t *tokdata,
                                         unsigned int event_type,
@@ -429,6 +540,24 @@ struct ST_FCN_LIST {
     ST_C_CancelFunction ST_CancelFunction;
 
     ST_C_IBM_ReencryptSingle ST_IBM_ReencryptSingle;
+    ST_C_IBM_CreateObjects ST_IBM_CreateObjects;
+    ST_C_IBM_GetAttributeValues ST_IBM_GetAttributeValues;
+    ST_C_IBM_DigestBatch ST_IBM_DigestBatch;
+    ST_C_IBM_VerifyBatch ST_IBM_VerifyBatch;
+    ST_C_IBM_SignAsync ST_IBM_SignAsync;
+    ST_C_IBM_EncryptAsync ST_IBM_EncryptAsync;
+    ST_C_IBM_AsyncWait ST_IBM_AsyncWait;
+
+    ST_C_MessageEncryptInit ST_MessageEncryptInit;
+    ST_C_EncryptMessage ST_EncryptMessage;
+    ST_C_EncryptMessageBegin ST_EncryptMessageBegin;
+    ST_C_EncryptMessageNext ST_EncryptMessageNext;
+    ST_C_MessageEncryptFinal ST_MessageEncryptFinal;
+    ST_C_MessageDecryptInit ST_MessageDecryptInit;
+    ST_C_DecryptMessage ST_DecryptMessage;
+    ST_C_DecryptMessageBegin ST_DecryptMessageBegin;
+    ST_C_DecryptMessageNext ST_DecryptMessageNext;
+    ST_C_MessageDecryptFinal ST_MessageDecryptFinal;
 
     /* The functions defined below are not part of the external API */
     ST_C_HandleEvent ST_HandleEvent;
@@ -28,6 +28,7 @@ opencryptoki_libopencryptoki_la_SOURCES = usr/lib/api/api_interface.c	\
 	usr/lib/config/configuration.c					\
 	usr/lib/common/ec_curve_translation.c				\
 	usr/lib/common/kdf_translation.c				\
+	usr/lib/common/handle_table.c					\
 	usr/lib/common/mgf_translation.c				\
 	usr/lib/api/supportedstrengths.c				\
 	usr/lib/config/cfgparse.y usr/lib/config/cfglex.l
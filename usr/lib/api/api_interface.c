@@ -99,6 +99,18 @@ static CK_IBM_FUNCTION_LIST_1_0 func_list_ibm_1_0 = {
     C_IBM_ReencryptSingle
 };
 
+static CK_IBM_FUNCTION_LIST_1_1 func_list_ibm_1_1 = {
+    {1, 1},
+    C_IBM_ReencryptSingle,
+    C_IBM_CreateObjects,
+    C_IBM_GetAttributeValues,
+    C_IBM_DigestBatch,
+    C_IBM_VerifyBatch,
+    C_IBM_SignAsync,
+    C_IBM_EncryptAsync,
+    C_IBM_AsyncWait
+};
+
 static CK_FUNCTION_LIST func_list_pkcs11_2_40 = {
     {2, 40},
     C_Initialize,
@@ -289,6 +301,11 @@ static CK_INTERFACE interface_list[] = {
         &func_list_pkcs11_2_40,
         CKF_INTERFACE_FORK_SAFE /*XXX*/
     },
+    {
+        (CK_UTF8CHAR *)"Vendor IBM",
+        &func_list_ibm_1_1,
+        CKF_INTERFACE_FORK_SAFE /*XXX*/
+    },
     {
         (CK_UTF8CHAR *)"Vendor IBM",
         &func_list_ibm_1_0,
@@ -1703,7 +1720,7 @@ CK_RV C_Finalize(CK_VOID_PTR pReserved)
     // Un register from Slot D
     API_UnRegister();
 
-    bt_destroy(&Anchor->sess_btree);
+    ht_destroy(&Anchor->sess_table);
 
 #if OPENSSL_VERSION_PREREQ(3, 0)
     /*
@@ -3005,7 +3022,7 @@ CK_RV C_Initialize(CK_VOID_PTR pVoid)
     //if ( Shared Memory Mapped not Successful )
     //                Free allocated Memory
     //                Return CKR_HOST_MEMORY
-    bt_init(&Anchor->sess_btree, free);
+    ht_init(&Anchor->sess_table, free);
 
 #if OPENSSL_VERSION_PREREQ(3, 0)
     /*
@@ -3179,7 +3196,7 @@ error_shm:
 
 error:
     policy_unload(&policy);
-    bt_destroy(&Anchor->sess_btree);
+    ht_destroy(&Anchor->sess_table);
     if (Anchor->socketfd >= 0)
         close(Anchor->socketfd);
 
@@ -4884,22 +4901,48 @@ CK_RV C_MessageEncryptInit(CK_SESSION_HANDLE hSession,
                            CK_MECHANISM *pMechanism, CK_OBJECT_HANDLE hKey)
 {
     CK_RV rv;
-
-    UNUSED(hSession);
-    UNUSED(pMechanism);
-    UNUSED(hKey);
+    API_Slot_t *sltp;
+    STDLL_FcnList_t *fcn;
+    ST_SESSION_T rSession;
 
     TRACE_INFO("C_MessageEncryptInit\n");
-
     if (API_Initialized() == FALSE) {
         TRACE_ERROR("%s\n", ock_err(ERR_CRYPTOKI_NOT_INITIALIZED));
-        rv = CKR_CRYPTOKI_NOT_INITIALIZED;
-        goto ret;
+        return CKR_CRYPTOKI_NOT_INITIALIZED;
+    }
+
+    if (!pMechanism) {
+        TRACE_ERROR("%s\n", ock_err(ERR_ARGUMENTS_BAD));
+        return CKR_ARGUMENTS_BAD;
+    }
+    if (!Valid_Session(hSession, &rSession)) {
+        TRACE_ERROR("%s\n", ock_err(ERR_SESSION_HANDLE_INVALID));
+        TRACE_ERROR("Session handle id: %lu\n", hSession);
+        return CKR_SESSION_HANDLE_INVALID;
+    }
+    TRACE_INFO("Valid Session handle id: %lu\n", rSession.sessionh);
+
+    sltp = &(Anchor->SltList[rSession.slotID]);
+    if (sltp->DLLoaded == FALSE) {
+        TRACE_ERROR("%s\n", ock_err(ERR_TOKEN_NOT_PRESENT));
+        return CKR_TOKEN_NOT_PRESENT;
+    }
+    if ((fcn = sltp->FcnList) == NULL) {
+        TRACE_ERROR("%s\n", ock_err(ERR_TOKEN_NOT_PRESENT));
+        return CKR_TOKEN_NOT_PRESENT;
+    }
+    if (fcn->ST_MessageEncryptInit) {
+        BEGIN_OPENSSL_LIBCTX(Anchor->openssl_libctx, rv)
+        // Map the Session to the slot session
+        rv = fcn->ST_MessageEncryptInit(sltp->TokData, &rSession, pMechanism,
+                                      hKey);
+        TRACE_INFO("fcn->ST_MessageEncryptInit returned:0x%lx\n", rv);
+        END_OPENSSL_LIBCTX(rv)
+    } else {
+        TRACE_ERROR("%s\n", ock_err(ERR_FUNCTION_NOT_SUPPORTED));
+        rv = CKR_FUNCTION_NOT_SUPPORTED;
     }
 
-    TRACE_ERROR("%s\n", ock_err(ERR_FUNCTION_NOT_SUPPORTED));
-    rv = CKR_FUNCTION_NOT_SUPPORTED;
-ret:
     return rv;
 }
 
@@ -4910,28 +4953,51 @@ CK_RV C_EncryptMessage(CK_SESSION_HANDLE hSession,
                        CK_BYTE *pCiphertext, CK_ULONG *pulCiphertextLen)
 {
     CK_RV rv;
-
-    UNUSED(hSession);
-    UNUSED(pParameter);
-    UNUSED(ulParameterLen);
-    UNUSED(pAssociatedData);
-    UNUSED(ulAssociatedDataLen);
-    UNUSED(pPlaintext);
-    UNUSED(ulPlaintextLen);
-    UNUSED(pCiphertext);
-    UNUSED(pulCiphertextLen);
+    API_Slot_t *sltp;
+    STDLL_FcnList_t *fcn;
+    ST_SESSION_T rSession;
 
     TRACE_INFO("C_EncryptMessage\n");
-
     if (API_Initialized() == FALSE) {
         TRACE_ERROR("%s\n", ock_err(ERR_CRYPTOKI_NOT_INITIALIZED));
-        rv = CKR_CRYPTOKI_NOT_INITIALIZED;
-        goto ret;
+        return CKR_CRYPTOKI_NOT_INITIALIZED;
+    }
+
+    if (!pParameter || !pulCiphertextLen) {
+        TRACE_ERROR("%s\n", ock_err(ERR_ARGUMENTS_BAD));
+        return CKR_ARGUMENTS_BAD;
+    }
+    if (!Valid_Session(hSession, &rSession)) {
+        TRACE_ERROR("%s\n", ock_err(ERR_SESSION_HANDLE_INVALID));
+        TRACE_ERROR("Session handle id: %lu\n", hSession);
+        return CKR_SESSION_HANDLE_INVALID;
+    }
+    TRACE_INFO("Valid Session handle id: %lu\n", rSession.sessionh);
+
+    sltp = &(Anchor->SltList[rSession.slotID]);
+    if (sltp->DLLoaded == FALSE) {
+        TRACE_ERROR("%s\n", ock_err(ERR_TOKEN_NOT_PRESENT));
+        return CKR_TOKEN_NOT_PRESENT;
+    }
+    if ((fcn = sltp->FcnList) == NULL) {
+        TRACE_ERROR("%s\n", ock_err(ERR_TOKEN_NOT_PRESENT));
+        return CKR_TOKEN_NOT_PRESENT;
+    }
+    if (fcn->ST_EncryptMessage) {
+        BEGIN_OPENSSL_LIBCTX(Anchor->openssl_libctx, rv)
+        // Map the Session to the slot session
+        rv = fcn->ST_EncryptMessage(sltp->TokData, &rSession,
+                                  pParameter, ulParameterLen,
+                                  pAssociatedData, ulAssociatedDataLen,
+                                  pPlaintext, ulPlaintextLen,
+                                  pCiphertext, pulCiphertextLen);
+        TRACE_INFO("fcn->ST_EncryptMessage returned:0x%lx\n", rv);
+        END_OPENSSL_LIBCTX(rv)
+    } else {
+        TRACE_ERROR("%s\n", ock_err(ERR_FUNCTION_NOT_SUPPORTED));
+        rv = CKR_FUNCTION_NOT_SUPPORTED;
     }
 
-    TRACE_ERROR("%s\n", ock_err(ERR_FUNCTION_NOT_SUPPORTED));
-    rv = CKR_FUNCTION_NOT_SUPPORTED;
-ret:
     return rv;
 }
 
@@ -4941,24 +5007,49 @@ CK_RV C_EncryptMessageBegin(CK_SESSION_HANDLE hSession,
                             CK_ULONG ulAssociatedDataLen)
 {
     CK_RV rv;
-
-    UNUSED(hSession);
-    UNUSED(pParameter);
-    UNUSED(ulParameterLen);
-    UNUSED(pAssociatedData);
-    UNUSED(ulAssociatedDataLen);
+    API_Slot_t *sltp;
+    STDLL_FcnList_t *fcn;
+    ST_SESSION_T rSession;
 
     TRACE_INFO("C_EncryptMessageBegin\n");
-
     if (API_Initialized() == FALSE) {
         TRACE_ERROR("%s\n", ock_err(ERR_CRYPTOKI_NOT_INITIALIZED));
-        rv = CKR_CRYPTOKI_NOT_INITIALIZED;
-        goto ret;
+        return CKR_CRYPTOKI_NOT_INITIALIZED;
+    }
+
+    if (!pParameter) {
+        TRACE_ERROR("%s\n", ock_err(ERR_ARGUMENTS_BAD));
+        return CKR_ARGUMENTS_BAD;
+    }
+    if (!Valid_Session(hSession, &rSession)) {
+        TRACE_ERROR("%s\n", ock_err(ERR_SESSION_HANDLE_INVALID));
+        TRACE_ERROR("Session handle id: %lu\n", hSession);
+        return CKR_SESSION_HANDLE_INVALID;
+    }
+    TRACE_INFO("Valid Session handle id: %lu\n", rSession.sessionh);
+
+    sltp = &(Anchor->SltList[rSession.slotID]);
+    if (sltp->DLLoaded == FALSE) {
+        TRACE_ERROR("%s\n", ock_err(ERR_TOKEN_NOT_PRESENT));
+        return CKR_TOKEN_NOT_PRESENT;
+    }
+    if ((fcn = sltp->FcnList) == NULL) {
+        TRACE_ERROR("%s\n", ock_err(ERR_TOKEN_NOT_PRESENT));
+        return CKR_TOKEN_NOT_PRESENT;
+    }
+    if (fcn->ST_EncryptMessageBegin) {
+        BEGIN_OPENSSL_LIBCTX(Anchor->openssl_libctx, rv)
+        // Map the Session to the slot session
+        rv = fcn->ST_EncryptMessageBegin(sltp->TokData, &rSession,
+                                       pParameter, ulParameterLen,
+                                       pAssociatedData, ulAssociatedDataLen);
+        TRACE_INFO("fcn->ST_EncryptMessageBegin returned:0x%lx\n", rv);
+        END_OPENSSL_LIBCTX(rv)
+    } else {
+        TRACE_ERROR("%s\n", ock_err(ERR_FUNCTION_NOT_SUPPORTED));
+        rv = CKR_FUNCTION_NOT_SUPPORTED;
     }
 
-    TRACE_ERROR("%s\n", ock_err(ERR_FUNCTION_NOT_SUPPORTED));
-    rv = CKR_FUNCTION_NOT_SUPPORTED;
-ret:
     return rv;
 }
 
@@ -4971,47 +5062,94 @@ CK_RV C_EncryptMessageNext(CK_SESSION_HANDLE hSession,
                            CK_ULONG flags)
 {
     CK_RV rv;
-
-    UNUSED(hSession);
-    UNUSED(pParameter);
-    UNUSED(ulParameterLen);
-    UNUSED(pPlaintextPart);
-    UNUSED(ulPlaintextPartLen);
-    UNUSED(pCiphertextPart);
-    UNUSED(pulCiphertextPartLen);
-    UNUSED(flags);
+    API_Slot_t *sltp;
+    STDLL_FcnList_t *fcn;
+    ST_SESSION_T rSession;
 
     TRACE_INFO("C_EncryptMessageNext\n");
-
     if (API_Initialized() == FALSE) {
         TRACE_ERROR("%s\n", ock_err(ERR_CRYPTOKI_NOT_INITIALIZED));
-        rv = CKR_CRYPTOKI_NOT_INITIALIZED;
-        goto ret;
+        return CKR_CRYPTOKI_NOT_INITIALIZED;
+    }
+
+    if (!pParameter || !pulCiphertextPartLen) {
+        TRACE_ERROR("%s\n", ock_err(ERR_ARGUMENTS_BAD));
+        return CKR_ARGUMENTS_BAD;
+    }
+    if (!Valid_Session(hSession, &rSession)) {
+        TRACE_ERROR("%s\n", ock_err(ERR_SESSION_HANDLE_INVALID));
+        TRACE_ERROR("Session handle id: %lu\n", hSession);
+        return CKR_SESSION_HANDLE_INVALID;
+    }
+    TRACE_INFO("Valid Session handle id: %lu\n", rSession.sessionh);
+
+    sltp = &(Anchor->SltList[rSession.slotID]);
+    if (sltp->DLLoaded == FALSE) {
+        TRACE_ERROR("%s\n", ock_err(ERR_TOKEN_NOT_PRESENT));
+        return CKR_TOKEN_NOT_PRESENT;
+    }
+    if ((fcn = sltp->FcnList) == NULL) {
+        TRACE_ERROR("%s\n", ock_err(ERR_TOKEN_NOT_PRESENT));
+        return CKR_TOKEN_NOT_PRESENT;
+    }
+    if (fcn->ST_EncryptMessageNext) {
+        BEGIN_OPENSSL_LIBCTX(Anchor->openssl_libctx, rv)
+        // Map the Session to the slot session
+        rv = fcn->ST_EncryptMessageNext(sltp->TokData, &rSession,
+                                      pParameter, ulParameterLen,
+                                      pPlaintextPart, ulPlaintextPartLen,
+                                      pCiphertextPart, pulCiphertextPartLen,
+                                      flags);
+        TRACE_INFO("fcn->ST_EncryptMessageNext returned:0x%lx\n", rv);
+        END_OPENSSL_LIBCTX(rv)
+    } else {
+        TRACE_ERROR("%s\n", ock_err(ERR_FUNCTION_NOT_SUPPORTED));
+        rv = CKR_FUNCTION_NOT_SUPPORTED;
     }
 
-    TRACE_ERROR("%s\n", ock_err(ERR_FUNCTION_NOT_SUPPORTED));
-    rv = CKR_FUNCTION_NOT_SUPPORTED;
-ret:
     return rv;
 }
 
 CK_RV C_MessageEncryptFinal(CK_SESSION_HANDLE hSession)
 {
     CK_RV rv;
+    API_Slot_t *sltp;
+    STDLL_FcnList_t *fcn;
+    ST_SESSION_T rSession;
 
-    UNUSED(hSession);
-
-    TRACE_INFO("C_EncryptMessageFinal\n");
-
+    TRACE_INFO("C_MessageEncryptFinal\n");
     if (API_Initialized() == FALSE) {
         TRACE_ERROR("%s\n", ock_err(ERR_CRYPTOKI_NOT_INITIALIZED));
-        rv = CKR_CRYPTOKI_NOT_INITIALIZED;
-        goto ret;
+        return CKR_CRYPTOKI_NOT_INITIALIZED;
+    }
+
+    if (!Valid_Session(hSession, &rSession)) {
+        TRACE_ERROR("%s\n", ock_err(ERR_SESSION_HANDLE_INVALID));
+        TRACE_ERROR("Session handle id: %lu\n", hSession);
+        return CKR_SESSION_HANDLE_INVALID;
+    }
+    TRACE_INFO("Valid Session handle id: %lu\n", rSession.sessionh);
+
+    sltp = &(Anchor->SltList[rSession.slotID]);
+    if (sltp->DLLoaded == FALSE) {
+        TRACE_ERROR("%s\n", ock_err(ERR_TOKEN_NOT_PRESENT));
+        return CKR_TOKEN_NOT_PRESENT;
+    }
+    if ((fcn = sltp->FcnList) == NULL) {
+        TRACE_ERROR("%s\n", ock_err(ERR_TOKEN_NOT_PRESENT));
+        return CKR_TOKEN_NOT_PRESENT;
+    }
+    if (fcn->ST_MessageEncryptFinal) {
+        BEGIN_OPENSSL_LIBCTX(Anchor->openssl_libctx, rv)
+        // Map the Session to the slot session
+        rv = fcn->ST_MessageEncryptFinal(sltp->TokData, &rSession);
+        TRACE_INFO("fcn->ST_MessageEncryptFinal returned:0x%lx\n", rv);
+        END_OPENSSL_LIBCTX(rv)
+    } else {
+        TRACE_ERROR("%s\n", ock_err(ERR_FUNCTION_NOT_SUPPORTED));
+        rv = CKR_FUNCTION_NOT_SUPPORTED;
     }
 
-    TRACE_ERROR("%s\n", ock_err(ERR_FUNCTION_NOT_SUPPORTED));
-    rv = CKR_FUNCTION_NOT_SUPPORTED;
-ret:
     return rv;
 }
 
@@ -5019,22 +5157,48 @@ CK_RV C_MessageDecryptInit(CK_SESSION_HANDLE hSession,
                            CK_MECHANISM *pMechanism, CK_OBJECT_HANDLE hKey)
 {
     CK_RV rv;
-
-    UNUSED(hSession);
-    UNUSED(pMechanism);
-    UNUSED(hKey);
+    API_Slot_t *sltp;
+    STDLL_FcnList_t *fcn;
+    ST_SESSION_T rSession;
 
     TRACE_INFO("C_MessageDecryptInit\n");
-
     if (API_Initialized() == FALSE) {
         TRACE_ERROR("%s\n", ock_err(ERR_CRYPTOKI_NOT_INITIALIZED));
-        rv = CKR_CRYPTOKI_NOT_INITIALIZED;
-        goto ret;
+        return CKR_CRYPTOKI_NOT_INITIALIZED;
+    }
+
+    if (!pMechanism) {
+        TRACE_ERROR("%s\n", ock_err(ERR_ARGUMENTS_BAD));
+        return CKR_ARGUMENTS_BAD;
+    }
+    if (!Valid_Session(hSession, &rSession)) {
+        TRACE_ERROR("%s\n", ock_err(ERR_SESSION_HANDLE_INVALID));
+        TRACE_ERROR("Session handle id: %lu\n", hSession);
+        return CKR_SESSION_HANDLE_INVALID;
+    }
+    TRACE_INFO("Valid Session handle id: %lu\n", rSession.sessionh);
+
+    sltp = &(Anchor->SltList[rSession.slotID]);
+    if (sltp->DLLoaded == FALSE) {
+        TRACE_ERROR("%s\n", ock_err(ERR_TOKEN_NOT_PRESENT));
+        return CKR_TOKEN_NOT_PRESENT;
+    }
+    if ((fcn = sltp->FcnList) == NULL) {
+        TRACE_ERROR("%s\n", ock_err(ERR_TOKEN_NOT_PRESENT));
+        return CKR_TOKEN_NOT_PRESENT;
+    }
+    if (fcn->ST_MessageDecryptInit) {
+        BEGIN_OPENSSL_LIBCTX(Anchor->openssl_libctx, rv)
+        // Map the Session to the slot session
+        rv = fcn->ST_MessageDecryptInit(sltp->TokData, &rSession, pMechanism,
+                                      hKey);
+        TRACE_INFO("fcn->ST_MessageDecryptInit returned:0x%lx\n", rv);
+        END_OPENSSL_LIBCTX(rv)
+    } else {
+        TRACE_ERROR("%s\n", ock_err(ERR_FUNCTION_NOT_SUPPORTED));
+        rv = CKR_FUNCTION_NOT_SUPPORTED;
     }
 
-    TRACE_ERROR("%s\n", ock_err(ERR_FUNCTION_NOT_SUPPORTED));
-    rv = CKR_FUNCTION_NOT_SUPPORTED;
-ret:
     return rv;
 }
 
@@ -5045,28 +5209,51 @@ CK_RV C_DecryptMessage(CK_SESSION_HANDLE hSession,
                        CK_BYTE *pPlaintext, CK_ULONG *pulPlaintextLen)
 {
     CK_RV rv;
-
-    UNUSED(hSession);
-    UNUSED(pParameter);
-    UNUSED(ulParameterLen);
-    UNUSED(pAssociatedData);
-    UNUSED(ulAssociatedDataLen);
-    UNUSED(pCiphertext);
-    UNUSED(ulCiphertextLen);
-    UNUSED(pPlaintext);
-    UNUSED(pulPlaintextLen);
+    API_Slot_t *sltp;
+    STDLL_FcnList_t *fcn;
+    ST_SESSION_T rSession;
 
     TRACE_INFO("C_DecryptMessage\n");
-
     if (API_Initialized() == FALSE) {
         TRACE_ERROR("%s\n", ock_err(ERR_CRYPTOKI_NOT_INITIALIZED));
-        rv = CKR_CRYPTOKI_NOT_INITIALIZED;
-        goto ret;
+        return CKR_CRYPTOKI_NOT_INITIALIZED;
+    }
+
+    if (!pParameter || !pulPlaintextLen) {
+        TRACE_ERROR("%s\n", ock_err(ERR_ARGUMENTS_BAD));
+        return CKR_ARGUMENTS_BAD;
+    }
+    if (!Valid_Session(hSession, &rSession)) {
+        TRACE_ERROR("%s\n", ock_err(ERR_SESSION_HANDLE_INVALID));
+        TRACE_ERROR("Session handle id: %lu\n", hSession);
+        return CKR_SESSION_HANDLE_INVALID;
+    }
+    TRACE_INFO("Valid Session handle id: %lu\n", rSession.sessionh);
+
+    sltp = &(Anchor->SltList[rSession.slotID]);
+    if (sltp->DLLoaded == FALSE) {
+        TRACE_ERROR("%s\n", ock_err(ERR_TOKEN_NOT_PRESENT));
+        return CKR_TOKEN_NOT_PRESENT;
+    }
+    if ((fcn = sltp->FcnList) == NULL) {
+        TRACE_ERROR("%s\n", ock_err(ERR_TOKEN_NOT_PRESENT));
+        return CKR_TOKEN_NOT_PRESENT;
+    }
+    if (fcn->ST_DecryptMessage) {
+        BEGIN_OPENSSL_LIBCTX(Anchor->openssl_libctx, rv)
+        // Map the Session to the slot session
+        rv = fcn->ST_DecryptMessage(sltp->TokData, &rSession,
+                                  pParameter, ulParameterLen,
+                                  pAssociatedData, ulAssociatedDataLen,
+                                  pCiphertext, ulCiphertextLen,
+                                  pPlaintext, pulPlaintextLen);
+        TRACE_INFO("fcn->ST_DecryptMessage returned:0x%lx\n", rv);
+        END_OPENSSL_LIBCTX(rv)
+    } else {
+        TRACE_ERROR("%s\n", ock_err(ERR_FUNCTION_NOT_SUPPORTED));
+        rv = CKR_FUNCTION_NOT_SUPPORTED;
     }
 
-    TRACE_ERROR("%s\n", ock_err(ERR_FUNCTION_NOT_SUPPORTED));
-    rv = CKR_FUNCTION_NOT_SUPPORTED;
-ret:
     return rv;
 }
 
@@ -5076,24 +5263,49 @@ CK_RV C_DecryptMessageBegin(CK_SESSION_HANDLE hSession,
                             CK_ULONG ulAssociatedDataLen)
 {
     CK_RV rv;
-
-    UNUSED(hSession);
-    UNUSED(pParameter);
-    UNUSED(ulParameterLen);
-    UNUSED(pAssociatedData);
-    UNUSED(ulAssociatedDataLen);
+    API_Slot_t *sltp;
+    STDLL_FcnList_t *fcn;
+    ST_SESSION_T rSession;
 
     TRACE_INFO("C_DecryptMessageBegin\n");
-
     if (API_Initialized() == FALSE) {
         TRACE_ERROR("%s\n", ock_err(ERR_CRYPTOKI_NOT_INITIALIZED));
-        rv = CKR_CRYPTOKI_NOT_INITIALIZED;
-        goto ret;
+        return CKR_CRYPTOKI_NOT_INITIALIZED;
+    }
+
+    if (!pParameter) {
+        TRACE_ERROR("%s\n", ock_err(ERR_ARGUMENTS_BAD));
+        return CKR_ARGUMENTS_BAD;
+    }
+    if (!Valid_Session(hSession, &rSession)) {
+        TRACE_ERROR("%s\n", ock_err(ERR_SESSION_HANDLE_INVALID));
+        TRACE_ERROR("Session handle id: %lu\n", hSession);
+        return CKR_SESSION_HANDLE_INVALID;
+    }
+    TRACE_INFO("Valid Session handle id: %lu\n", rSession.sessionh);
+
+    sltp = &(Anchor->SltList[rSession.slotID]);
+    if (sltp->DLLoaded == FALSE) {
+        TRACE_ERROR("%s\n", ock_err(ERR_TOKEN_NOT_PRESENT));
+        return CKR_TOKEN_NOT_PRESENT;
+    }
+    if ((fcn = sltp->FcnList) == NULL) {
+        TRACE_ERROR("%s\n", ock_err(ERR_TOKEN_NOT_PRESENT));
+        return CKR_TOKEN_NOT_PRESENT;
+    }
+    if (fcn->ST_DecryptMessageBegin) {
+        BEGIN_OPENSSL_LIBCTX(Anchor->openssl_libctx, rv)
+        // Map the Session to the slot session
+        rv = fcn->ST_DecryptMessageBegin(sltp->TokData, &rSession,
+                                       pParameter, ulParameterLen,
+                                       pAssociatedData, ulAssociatedDataLen);
+        TRACE_INFO("fcn->ST_DecryptMessageBegin returned:0x%lx\n", rv);
+        END_OPENSSL_LIBCTX(rv)
+    } else {
+        TRACE_ERROR("%s\n", ock_err(ERR_FUNCTION_NOT_SUPPORTED));
+        rv = CKR_FUNCTION_NOT_SUPPORTED;
     }
 
-    TRACE_ERROR("%s\n", ock_err(ERR_FUNCTION_NOT_SUPPORTED));
-    rv = CKR_FUNCTION_NOT_SUPPORTED;
-ret:
     return rv;
 }
 
@@ -5106,47 +5318,94 @@ CK_RV C_DecryptMessageNext(CK_SESSION_HANDLE hSession,
                            CK_FLAGS flags)
 {
     CK_RV rv;
-
-    UNUSED(hSession);
-    UNUSED(pParameter);
-    UNUSED(ulParameterLen);
-    UNUSED(pCiphertextPart);
-    UNUSED(ulCiphertextPartLen);
-    UNUSED(pPlaintextPart);
-    UNUSED(pulPlaintextPartLen);
-    UNUSED(flags);
+    API_Slot_t *sltp;
+    STDLL_FcnList_t *fcn;
+    ST_SESSION_T rSession;
 
     TRACE_INFO("C_DecryptMessageNext\n");
-
     if (API_Initialized() == FALSE) {
         TRACE_ERROR("%s\n", ock_err(ERR_CRYPTOKI_NOT_INITIALIZED));
-        rv = CKR_CRYPTOKI_NOT_INITIALIZED;
-        goto ret;
+        return CKR_CRYPTOKI_NOT_INITIALIZED;
+    }
+
+    if (!pParameter || !pulPlaintextPartLen) {
+        TRACE_ERROR("%s\n", ock_err(ERR_ARGUMENTS_BAD));
+        return CKR_ARGUMENTS_BAD;
+    }
+    if (!Valid_Session(hSession, &rSession)) {
+        TRACE_ERROR("%s\n", ock_err(ERR_SESSION_HANDLE_INVALID));
+        TRACE_ERROR("Session handle id: %lu\n", hSession);
+        return CKR_SESSION_HANDLE_INVALID;
+    }
+    TRACE_INFO("Valid Session handle id: %lu\n", rSession.sessionh);
+
+    sltp = &(Anchor->SltList[rSession.slotID]);
+    if (sltp->DLLoaded == FALSE) {
+        TRACE_ERROR("%s\n", ock_err(ERR_TOKEN_NOT_PRESENT));
+        return CKR_TOKEN_NOT_PRESENT;
+    }
+    if ((fcn = sltp->FcnList) == NULL) {
+        TRACE_ERROR("%s\n", ock_err(ERR_TOKEN_NOT_PRESENT));
+        return CKR_TOKEN_NOT_PRESENT;
+    }
+    if (fcn->ST_DecryptMessageNext) {
+        BEGIN_OPENSSL_LIBCTX(Anchor->openssl_libctx, rv)
+        // Map the Session to the slot session
+        rv = fcn->ST_DecryptMessageNext(sltp->TokData, &rSession,
+                                      pParameter, ulParameterLen,
+                                      pCiphertextPart, ulCiphertextPartLen,
+                                      pPlaintextPart, pulPlaintextPartLen,
+                                      flags);
+        TRACE_INFO("fcn->ST_DecryptMessageNext returned:0x%lx\n", rv);
+        END_OPENSSL_LIBCTX(rv)
+    } else {
+        TRACE_ERROR("%s\n", ock_err(ERR_FUNCTION_NOT_SUPPORTED));
+        rv = CKR_FUNCTION_NOT_SUPPORTED;
     }
 
-    TRACE_ERROR("%s\n", ock_err(ERR_FUNCTION_NOT_SUPPORTED));
-    rv = CKR_FUNCTION_NOT_SUPPORTED;
-ret:
     return rv;
 }
 
 CK_RV C_MessageDecryptFinal(CK_SESSION_HANDLE hSession)
 {
     CK_RV rv;
-
-    UNUSED(hSession);
+    API_Slot_t *sltp;
+    STDLL_FcnList_t *fcn;
+    ST_SESSION_T rSession;
 
     TRACE_INFO("C_MessageDecryptFinal\n");
-
     if (API_Initialized() == FALSE) {
         TRACE_ERROR("%s\n", ock_err(ERR_CRYPTOKI_NOT_INITIALIZED));
-        rv = CKR_CRYPTOKI_NOT_INITIALIZED;
-        goto ret;
+        return CKR_CRYPTOKI_NOT_INITIALIZED;
+    }
+
+    if (!Valid_Session(hSession, &rSession)) {
+        TRACE_ERROR("%s\n", ock_err(ERR_SESSION_HANDLE_INVALID));
+        TRACE_ERROR("Session handle id: %lu\n", hSession);
+        return CKR_SESSION_HANDLE_INVALID;
+    }
+    TRACE_INFO("Valid Session handle id: %lu\n", rSession.sessionh);
+
+    sltp = &(Anchor->SltList[rSession.slotID]);
+    if (sltp->DLLoaded == FALSE) {
+        TRACE_ERROR("%s\n", ock_err(ERR_TOKEN_NOT_PRESENT));
+        return CKR_TOKEN_NOT_PRESENT;
+    }
+    if ((fcn = sltp->FcnList) == NULL) {
+        TRACE_ERROR("%s\n", ock_err(ERR_TOKEN_NOT_PRESENT));
+        return CKR_TOKEN_NOT_PRESENT;
+    }
+    if (fcn->ST_MessageDecryptFinal) {
+        BEGIN_OPENSSL_LIBCTX(Anchor->openssl_libctx, rv)
+        // Map the Session to the slot session
+        rv = fcn->ST_MessageDecryptFinal(sltp->TokData, &rSession);
+        TRACE_INFO("fcn->ST_MessageDecryptFinal returned:0x%lx\n", rv);
+        END_OPENSSL_LIBCTX(rv)
+    } else {
+        TRACE_ERROR("%s\n", ock_err(ERR_FUNCTION_NOT_SUPPORTED));
+        rv = CKR_FUNCTION_NOT_SUPPORTED;
     }
 
-    TRACE_ERROR("%s\n", ock_err(ERR_FUNCTION_NOT_SUPPORTED));
-    rv = CKR_FUNCTION_NOT_SUPPORTED;
-ret:
     return rv;
 }
 
@@ -5458,6 +5717,441 @@ CK_RV C_IBM_ReencryptSingle(CK_SESSION_HANDLE hSession,
     return rv;
 }
 
+CK_RV C_IBM_CreateObjects(CK_SESSION_HANDLE hSession,
+                          CK_IBM_OBJECT_TEMPLATE_PTR pTemplates,
+                          CK_ULONG ulObjectCount,
+                          CK_OBJECT_HANDLE_PTR phObjects)
+{
+    CK_RV rv;
+    API_Slot_t *sltp;
+    STDLL_FcnList_t *fcn;
+    ST_SESSION_T rSession;
+    CK_ULONG i;
+
+    TRACE_INFO("C_IBM_CreateObjects\n");
+    if (API_Initialized() == FALSE) {
+        TRACE_ERROR("%s\n", ock_err(ERR_CRYPTOKI_NOT_INITIALIZED));
+        return CKR_CRYPTOKI_NOT_INITIALIZED;
+    }
+
+    if (!Valid_Session(hSession, &rSession)) {
+        TRACE_ERROR("%s\n", ock_err(ERR_SESSION_HANDLE_INVALID));
+        TRACE_ERROR("Session handle id: %lu\n", hSession);
+        return CKR_SESSION_HANDLE_INVALID;
+    }
+    TRACE_INFO("Valid Session handle id: %lu\n", rSession.sessionh);
+
+    if (ulObjectCount == 0)
+        return CKR_OK;
+    if (!pTemplates || !phObjects) {
+        TRACE_ERROR("%s\n", ock_err(ERR_ARGUMENTS_BAD));
+        return CKR_ARGUMENTS_BAD;
+    }
+    // Same checks as C_CreateObject does for every template
+    for (i = 0; i < ulObjectCount; i++) {
+        if (!pTemplates[i].pTemplate) {
+            TRACE_ERROR("%s\n", ock_err(ERR_ARGUMENTS_BAD));
+            return CKR_ARGUMENTS_BAD;
+        }
+        if (pTemplates[i].ulCount == 0) {
+            TRACE_ERROR("%s\n", ock_err(ERR_TEMPLATE_INCOMPLETE));
+            return CKR_TEMPLATE_INCOMPLETE;
+        }
+    }
+
+    sltp = &(Anchor->SltList[rSession.slotID]);
+    if (sltp->DLLoaded == FALSE) {
+        TRACE_ERROR("%s\n", ock_err(ERR_TOKEN_NOT_PRESENT));
+        return CKR_TOKEN_NOT_PRESENT;
+    }
+    if ((fcn = sltp->FcnList) == NULL) {
+        TRACE_ERROR("%s\n", ock_err(ERR_TOKEN_NOT_PRESENT));
+        return CKR_TOKEN_NOT_PRESENT;
+    }
+    if (fcn->ST_IBM_CreateObjects) {
+        BEGIN_OPENSSL_LIBCTX(Anchor->openssl_libctx, rv)
+        // Map the Session to the slot session
+        rv = fcn->ST_IBM_CreateObjects(sltp->TokData, &rSession, pTemplates,
+                                       ulObjectCount, phObjects);
+        TRACE_DEVEL("fcn->ST_IBM_CreateObjects returned: 0x%lx\n", rv);
+        END_OPENSSL_LIBCTX(rv)
+    } else {
+        TRACE_ERROR("%s\n", ock_err(ERR_FUNCTION_NOT_SUPPORTED));
+        rv = CKR_FUNCTION_NOT_SUPPORTED;
+    }
+
+    return rv;
+}
+
+CK_RV C_IBM_GetAttributeValues(CK_SESSION_HANDLE hSession,
+                               CK_OBJECT_HANDLE_PTR phObjects,
+                               CK_ULONG ulObjectCount,
+                               CK_IBM_OBJECT_TEMPLATE_PTR pTemplates,
+                               CK_RV *pReturnValues)
+{
+    CK_RV rv;
+    API_Slot_t *sltp;
+    STDLL_FcnList_t *fcn;
+    ST_SESSION_T rSession;
+    CK_ULONG i;
+
+    TRACE_INFO("C_IBM_GetAttributeValues\n");
+    if (API_Initialized() == FALSE) {
+        TRACE_ERROR("%s\n", ock_err(ERR_CRYPTOKI_NOT_INITIALIZED));
+        return CKR_CRYPTOKI_NOT_INITIALIZED;
+    }
+
+    if (!Valid_Session(hSession, &rSession)) {
+        TRACE_ERROR("%s\n", ock_err(ERR_SESSION_HANDLE_INVALID));
+        TRACE_ERROR("Session handle id: %lu\n", hSession);
+        return CKR_SESSION_HANDLE_INVALID;
+    }
+    TRACE_INFO("Valid Session handle id: %lu\n", rSession.sessionh);
+
+    if (ulObjectCount == 0)
+        return CKR_OK;
+    if (!phObjects || !pTemplates || !pReturnValues) {
+        TRACE_ERROR("%s\n", ock_err(ERR_ARGUMENTS_BAD));
+        return CKR_ARGUMENTS_BAD;
+    }
+    // Same checks as C_GetAttributeValue does for every template
+    for (i = 0; i < ulObjectCount; i++) {
+        if (!pTemplates[i].pTemplate || pTemplates[i].ulCount == 0) {
+            TRACE_ERROR("%s\n", ock_err(ERR_ARGUMENTS_BAD));
+            return CKR_ARGUMENTS_BAD;
+        }
+    }
+
+    sltp = &(Anchor->SltList[rSession.slotID]);
+    if (sltp->DLLoaded == FALSE) {
+        TRACE_ERROR("%s\n", ock_err(ERR_TOKEN_NOT_PRESENT));
+        return CKR_TOKEN_NOT_PRESENT;
+    }
+    if ((fcn = sltp->FcnList) == NULL) {
+        TRACE_ERROR("%s\n", ock_err(ERR_TOKEN_NOT_PRESENT));
+        return CKR_TOKEN_NOT_PRESENT;
+    }
+    if (fcn->ST_IBM_GetAttributeValues) {
+        BEGIN_OPENSSL_LIBCTX(Anchor->openssl_libctx, rv)
+        // Map the Session to the slot session
+        rv = fcn->ST_IBM_GetAttributeValues(sltp->TokData, &rSession,
+                                            phObjects, ulObjectCount,
+                                            pTemplates, pReturnValues);
+        TRACE_DEVEL("fcn->ST_IBM_GetAttributeValues returned: 0x%lx\n", rv);
+        END_OPENSSL_LIBCTX(rv)
+    } else {
+        TRACE_ERROR("%s\n", ock_err(ERR_FUNCTION_NOT_SUPPORTED));
+        rv = CKR_FUNCTION_NOT_SUPPORTED;
+    }
+
+    return rv;
+}
+
+CK_RV C_IBM_DigestBatch(CK_SESSION_HANDLE hSession,
+                        CK_MECHANISM_PTR pMechanism,
+                        CK_IBM_DATA_PTR pData,
+                        CK_ULONG ulDataCount,
+                        CK_BYTE_PTR pDigests,
+                        CK_ULONG_PTR pulDigestsLen)
+{
+    CK_RV rv;
+    API_Slot_t *sltp;
+    STDLL_FcnList_t *fcn;
+    ST_SESSION_T rSession;
+    CK_ULONG i;
+
+    TRACE_INFO("C_IBM_DigestBatch\n");
+    if (API_Initialized() == FALSE) {
+        TRACE_ERROR("%s\n", ock_err(ERR_CRYPTOKI_NOT_INITIALIZED));
+        return CKR_CRYPTOKI_NOT_INITIALIZED;
+    }
+
+    if (!Valid_Session(hSession, &rSession)) {
+        TRACE_ERROR("%s\n", ock_err(ERR_SESSION_HANDLE_INVALID));
+        TRACE_ERROR("Session handle id: %lu\n", hSession);
+        return CKR_SESSION_HANDLE_INVALID;
+    }
+    TRACE_INFO("Valid Session handle id: %lu\n", rSession.sessionh);
+
+    if (!pMechanism || !pulDigestsLen) {
+        TRACE_ERROR("%s\n", ock_err(ERR_ARGUMENTS_BAD));
+        return CKR_ARGUMENTS_BAD;
+    }
+    if (ulDataCount == 0) {
+        *pulDigestsLen = 0;
+        return CKR_OK;
+    }
+    if (!pData) {
+        TRACE_ERROR("%s\n", ock_err(ERR_ARGUMENTS_BAD));
+        return CKR_ARGUMENTS_BAD;
+    }
+    // Same check as C_Digest does for every data buffer
+    for (i = 0; i < ulDataCount; i++) {
+        if (!pData[i].pData) {
+            TRACE_ERROR("%s\n", ock_err(ERR_ARGUMENTS_BAD));
+            return CKR_ARGUMENTS_BAD;
+        }
+    }
+
+    sltp = &(Anchor->SltList[rSession.slotID]);
+    if (sltp->DLLoaded == FALSE) {
+        TRACE_ERROR("%s\n", ock_err(ERR_TOKEN_NOT_PRESENT));
+        return CKR_TOKEN_NOT_PRESENT;
+    }
+    if ((fcn = sltp->FcnList) == NULL) {
+        TRACE_ERROR("%s\n", ock_err(ERR_TOKEN_NOT_PRESENT));
+        return CKR_TOKEN_NOT_PRESENT;
+    }
+    if (fcn->ST_IBM_DigestBatch) {
+        BEGIN_OPENSSL_LIBCTX(Anchor->openssl_libctx, rv)
+        // Map the Session to the slot session
+        rv = fcn->ST_IBM_DigestBatch(sltp->TokData, &rSession, pMechanism,
+                                     pData, ulDataCount, pDigests,
+                                     pulDigestsLen);
+        TRACE_DEVEL("fcn->ST_IBM_DigestBatch returned: 0x%lx\n", rv);
+        END_OPENSSL_LIBCTX(rv)
+    } else {
+        TRACE_ERROR("%s\n", ock_err(ERR_FUNCTION_NOT_SUPPORTED));
+        rv = CKR_FUNCTION_NOT_SUPPORTED;
+    }
+
+    return rv;
+}
+
+CK_RV C_IBM_VerifyBatch(CK_SESSION_HANDLE hSession,
+                        CK_MECHANISM_PTR pMechanism,
+                        CK_IBM_VERIFY_DATA_PTR pItems,
+                        CK_ULONG ulItemCount,
+                        CK_RV *pReturnValues)
+{
+    CK_RV rv;
+    API_Slot_t *sltp;
+    STDLL_FcnList_t *fcn;
+    ST_SESSION_T rSession;
+    CK_ULONG i;
+
+    TRACE_INFO("C_IBM_VerifyBatch\n");
+    if (API_Initialized() == FALSE) {
+        TRACE_ERROR("%s\n", ock_err(ERR_CRYPTOKI_NOT_INITIALIZED));
+        return CKR_CRYPTOKI_NOT_INITIALIZED;
+    }
+
+    if (!Valid_Session(hSession, &rSession)) {
+        TRACE_ERROR("%s\n", ock_err(ERR_SESSION_HANDLE_INVALID));
+        TRACE_ERROR("Session handle id: %lu\n", hSession);
+        return CKR_SESSION_HANDLE_INVALID;
+    }
+    TRACE_INFO("Valid Session handle id: %lu\n", rSession.sessionh);
+
+    if (!pMechanism) {
+        TRACE_ERROR("%s\n", ock_err(ERR_ARGUMENTS_BAD));
+        return CKR_ARGUMENTS_BAD;
+    }
+    if (ulItemCount == 0)
+        return CKR_OK;
+    if (!pItems || !pReturnValues) {
+        TRACE_ERROR("%s\n", ock_err(ERR_ARGUMENTS_BAD));
+        return CKR_ARGUMENTS_BAD;
+    }
+    // Same check as C_Verify does for every data and signature
+    for (i = 0; i < ulItemCount; i++) {
+        if (!pItems[i].pData || !pItems[i].pSignature) {
+            TRACE_ERROR("%s\n", ock_err(ERR_ARGUMENTS_BAD));
+            return CKR_ARGUMENTS_BAD;
+        }
+    }
+
+    sltp = &(Anchor->SltList[rSession.slotID]);
+    if (sltp->DLLoaded == FALSE) {
+        TRACE_ERROR("%s\n", ock_err(ERR_TOKEN_NOT_PRESENT));
+        return CKR_TOKEN_NOT_PRESENT;
+    }
+    if ((fcn = sltp->FcnList) == NULL) {
+        TRACE_ERROR("%s\n", ock_err(ERR_TOKEN_NOT_PRESENT));
+        return CKR_TOKEN_NOT_PRESENT;
+    }
+    if (fcn->ST_IBM_VerifyBatch) {
+        BEGIN_OPENSSL_LIBCTX(Anchor->openssl_libctx, rv)
+        // Map the Session to the slot session
+        rv = fcn->ST_IBM_VerifyBatch(sltp->TokData, &rSession, pMechanism,
+                                     pItems, ulItemCount, pReturnValues);
+        TRACE_DEVEL("fcn->ST_IBM_VerifyBatch returned: 0x%lx\n", rv);
+        END_OPENSSL_LIBCTX(rv)
+    } else {
+        TRACE_ERROR("%s\n", ock_err(ERR_FUNCTION_NOT_SUPPORTED));
+        rv = CKR_FUNCTION_NOT_SUPPORTED;
+    }
+
+    return rv;
+}
+
+CK_RV C_IBM_SignAsync(CK_SESSION_HANDLE hSession,
+                      CK_MECHANISM_PTR pMechanism,
+                      CK_OBJECT_HANDLE hKey,
+                      CK_BYTE_PTR pData,
+                      CK_ULONG ulDataLen,
+                      CK_BYTE_PTR pSignature,
+                      CK_ULONG_PTR pulSignatureLen,
+                      int iNotifyFd,
+                      CK_ULONG_PTR phOperation)
+{
+    CK_RV rv;
+    API_Slot_t *sltp;
+    STDLL_FcnList_t *fcn;
+    ST_SESSION_T rSession;
+
+    TRACE_INFO("C_IBM_SignAsync\n");
+    if (API_Initialized() == FALSE) {
+        TRACE_ERROR("%s\n", ock_err(ERR_CRYPTOKI_NOT_INITIALIZED));
+        return CKR_CRYPTOKI_NOT_INITIALIZED;
+    }
+
+    if (!Valid_Session(hSession, &rSession)) {
+        TRACE_ERROR("%s\n", ock_err(ERR_SESSION_HANDLE_INVALID));
+        TRACE_ERROR("Session handle id: %lu\n", hSession);
+        return CKR_SESSION_HANDLE_INVALID;
+    }
+    TRACE_INFO("Valid Session handle id: %lu\n", rSession.sessionh);
+
+    // There is no length query, the result is only known when it is done
+    if (!pMechanism || !pData || !pSignature || !pulSignatureLen ||
+        !phOperation || iNotifyFd < -1) {
+        TRACE_ERROR("%s\n", ock_err(ERR_ARGUMENTS_BAD));
+        return CKR_ARGUMENTS_BAD;
+    }
+
+    sltp = &(Anchor->SltList[rSession.slotID]);
+    if (sltp->DLLoaded == FALSE) {
+        TRACE_ERROR("%s\n", ock_err(ERR_TOKEN_NOT_PRESENT));
+        return CKR_TOKEN_NOT_PRESENT;
+    }
+    if ((fcn = sltp->FcnList) == NULL) {
+        TRACE_ERROR("%s\n", ock_err(ERR_TOKEN_NOT_PRESENT));
+        return CKR_TOKEN_NOT_PRESENT;
+    }
+    if (fcn->ST_IBM_SignAsync) {
+        BEGIN_OPENSSL_LIBCTX(Anchor->openssl_libctx, rv)
+        // Map the Session to the slot session
+        rv = fcn->ST_IBM_SignAsync(sltp->TokData, &rSession, pMechanism,
+                                   hKey, pData, ulDataLen, pSignature,
+                                   pulSignatureLen, iNotifyFd, phOperation);
+        TRACE_DEVEL("fcn->ST_IBM_SignAsync returned: 0x%lx\n", rv);
+        END_OPENSSL_LIBCTX(rv)
+    } else {
+        TRACE_ERROR("%s\n", ock_err(ERR_FUNCTION_NOT_SUPPORTED));
+        rv = CKR_FUNCTION_NOT_SUPPORTED;
+    }
+
+    return rv;
+}
+
+CK_RV C_IBM_EncryptAsync(CK_SESSION_HANDLE hSession,
+                         CK_MECHANISM_PTR pMechanism,
+                         CK_OBJECT_HANDLE hKey,
+                         CK_BYTE_PTR pData,
+                         CK_ULONG ulDataLen,
+                         CK_BYTE_PTR pEncryptedData,
+                         CK_ULONG_PTR pulEncryptedDataLen,
+                         int iNotifyFd,
+                         CK_ULONG_PTR phOperation)
+{
+    CK_RV rv;
+    API_Slot_t *sltp;
+    STDLL_FcnList_t *fcn;
+    ST_SESSION_T rSession;
+
+    TRACE_INFO("C_IBM_EncryptAsync\n");
+    if (API_Initialized() == FALSE) {
+        TRACE_ERROR("%s\n", ock_err(ERR_CRYPTOKI_NOT_INITIALIZED));
+        return CKR_CRYPTOKI_NOT_INITIALIZED;
+    }
+
+    if (!Valid_Session(hSession, &rSession)) {
+        TRACE_ERROR("%s\n", ock_err(ERR_SESSION_HANDLE_INVALID));
+        TRACE_ERROR("Session handle id: %lu\n", hSession);
+        return CKR_SESSION_HANDLE_INVALID;
+    }
+    TRACE_INFO("Valid Session handle id: %lu\n", rSession.sessionh);
+
+    // There is no length query, the result is only known when it is done
+    if (!pMechanism || !pData || !pEncryptedData || !pulEncryptedDataLen ||
+        !phOperation || iNotifyFd < -1) {
+        TRACE_ERROR("%s\n", ock_err(ERR_ARGUMENTS_BAD));
+        return CKR_ARGUMENTS_BAD;
+    }
+
+    sltp = &(Anchor->SltList[rSession.slotID]);
+    if (sltp->DLLoaded == FALSE) {
+        TRACE_ERROR("%s\n", ock_err(ERR_TOKEN_NOT_PRESENT));
+        return CKR_TOKEN_NOT_PRESENT;
+    }
+    if ((fcn = sltp->FcnList) == NULL) {
+        TRACE_ERROR("%s\n", ock_err(ERR_TOKEN_NOT_PRESENT));
+        return CKR_TOKEN_NOT_PRESENT;
+    }
+    if (fcn->ST_IBM_EncryptAsync) {
+        BEGIN_OPENSSL_LIBCTX(Anchor->openssl_libctx, rv)
+        // Map the Session to the slot session
+        rv = fcn->ST_IBM_EncryptAsync(sltp->TokData, &rSession, pMechanism,
+                                      hKey, pData, ulDataLen, pEncryptedData,
+                                      pulEncryptedDataLen, iNotifyFd,
+                                      phOperation);
+        TRACE_DEVEL("fcn->ST_IBM_EncryptAsync returned: 0x%lx\n", rv);
+        END_OPENSSL_LIBCTX(rv)
+    } else {
+        TRACE_ERROR("%s\n", ock_err(ERR_FUNCTION_NOT_SUPPORTED));
+        rv = CKR_FUNCTION_NOT_SUPPORTED;
+    }
+
+    return rv;
+}
+
+CK_RV C_IBM_AsyncWait(CK_SESSION_HANDLE hSession,
+                      CK_ULONG hOperation,
+                      CK_BBOOL bBlock)
+{
+    CK_RV rv;
+    API_Slot_t *sltp;
+    STDLL_FcnList_t *fcn;
+    ST_SESSION_T rSession;
+
+    TRACE_INFO("C_IBM_AsyncWait\n");
+    if (API_Initialized() == FALSE) {
+        TRACE_ERROR("%s\n", ock_err(ERR_CRYPTOKI_NOT_INITIALIZED));
+        return CKR_CRYPTOKI_NOT_INITIALIZED;
+    }
+
+    if (!Valid_Session(hSession, &rSession)) {
+        TRACE_ERROR("%s\n", ock_err(ERR_SESSION_HANDLE_INVALID));
+        TRACE_ERROR("Session handle id: %lu\n", hSession);
+        return CKR_SESSION_HANDLE_INVALID;
+    }
+    TRACE_INFO("Valid Session handle id: %lu\n", rSession.sessionh);
+
+    sltp = &(Anchor->SltList[rSession.slotID]);
+    if (sltp->DLLoaded == FALSE) {
+        TRACE_ERROR("%s\n", ock_err(ERR_TOKEN_NOT_PRESENT));
+        return CKR_TOKEN_NOT_PRESENT;
+    }
+    if ((fcn = sltp->FcnList) == NULL) {
+        TRACE_ERROR("%s\n", ock_err(ERR_TOKEN_NOT_PRESENT));
+        return CKR_TOKEN_NOT_PRESENT;
+    }
+    if (fcn->ST_IBM_AsyncWait) {
+        BEGIN_OPENSSL_LIBCTX(Anchor->openssl_libctx, rv)
+        // Map the Session to the slot session
+        rv = fcn->ST_IBM_AsyncWait(sltp->TokData, &rSession, hOperation,
+                                   bBlock);
+        TRACE_DEVEL("fcn->ST_IBM_AsyncWait returned: 0x%lx\n", rv);
+        END_OPENSSL_LIBCTX(rv)
+    } else {
+        TRACE_ERROR("%s\n", ock_err(ERR_FUNCTION_NOT_SUPPORTED));
+        rv = CKR_FUNCTION_NOT_SUPPORTED;
+    }
+
+    return rv;
+}
+
 #ifdef __sun
 #pragma init(api_init)
 #else
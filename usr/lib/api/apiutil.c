@@ -117,14 +117,14 @@ unsigned long AddToSessionList(ST_SESSION_T *pSess)
 {
     unsigned long handle;
 
-    handle = bt_node_add(&(Anchor->sess_btree), pSess);
+    handle = ht_add(&(Anchor->sess_table), pSess);
 
     return handle;
 }
 
 void RemoveFromSessionList(CK_SESSION_HANDLE handle)
 {
-    bt_node_free(&(Anchor->sess_btree), handle, TRUE);
+    ht_remove(&(Anchor->sess_table), handle, TRUE);
 }
 
 struct closeme_arg {
@@ -157,7 +157,7 @@ void CloseMe(STDLL_TokData_t *tokdata, void *node_value,
                                   closeme_arg->in_fork_initializer);
         if (rv == CKR_OK) {
             decr_sess_counts(closeme_arg->slot_id);
-            bt_node_free(&(Anchor->sess_btree), node_handle, TRUE);
+            ht_remove(&(Anchor->sess_table), node_handle, TRUE);
         }
     }
 }
@@ -178,8 +178,8 @@ void CloseAllSessions(CK_SLOT_ID slot_id, CK_BBOOL in_fork_initializer)
     arg.in_fork_initializer = in_fork_initializer;
 
     /* for every node in the API-level session tree, call CloseMe on it */
-    bt_for_each_node(sltp->TokData, &(Anchor->sess_btree), CloseMe,
-                     (void *)&arg);
+    ht_for_each(sltp->TokData, &(Anchor->sess_table), CloseMe,
+                (void *)&arg);
 
 }
 
@@ -188,13 +188,13 @@ int Valid_Session(CK_SESSION_HANDLE handle, ST_SESSION_T *rSession)
     ST_SESSION_T *tmp;
     int rc;
 
-    tmp = bt_get_node_value(&(Anchor->sess_btree), handle);
+    tmp = ht_get_value(&(Anchor->sess_table), handle);
     if (tmp) {
         rSession->slotID = tmp->slotID;
         rSession->sessionh = tmp->sessionh;
     }
     rc = tmp ? TRUE : FALSE;
-    bt_put_node_value(&(Anchor->sess_btree), tmp);
+    ht_put_value(&(Anchor->sess_table), tmp);
     tmp = NULL;
 
     return rc;
@@ -225,14 +225,30 @@ int slot_present(CK_SLOT_ID id)
     return TRUE;
 }
 
+/*
+ * The session counters in the slot manager's shared memory are updated with
+ * atomic operations only, so opening and closing sessions does not need to
+ * serialize on the global API lock file. ProcLock() is only used for the
+ * registration of the process in the process table.
+ */
+static void sess_count_decr(uint32 *count)
+{
+    uint32 val = __atomic_load_n(count, __ATOMIC_RELAXED);
+
+    do {
+        if (val == 0)
+            return;
+    } while (!__atomic_compare_exchange_n(count, &val, val - 1, 0,
+                                          __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+}
+
 void get_sess_count(CK_SLOT_ID slotID, CK_ULONG *ret)
 {
     Slot_Mgr_Shr_t *shm;
 
     shm = Anchor->SharedMemP;
-    ProcLock();
-    *ret = shm->slot_global_sessions[slotID];
-    ProcUnLock();
+    *ret = __atomic_load_n(&shm->slot_global_sessions[slotID],
+                           __ATOMIC_RELAXED);
 }
 
 void incr_sess_counts(CK_SLOT_ID slotID)
@@ -244,17 +260,14 @@ void incr_sess_counts(CK_SLOT_ID slotID)
     Slot_Mgr_Proc_t *procp;
 #endif
 
-    // Get the slot mutex
     shm = Anchor->SharedMemP;
 
-    ProcLock();
-
-    shm->slot_global_sessions[slotID]++;
+    __atomic_add_fetch(&shm->slot_global_sessions[slotID], 1,
+                       __ATOMIC_RELAXED);
 
     procp = &shm->proc_table[Anchor->MgrProcIndex];
-    procp->slot_session_count[slotID]++;
-
-    ProcUnLock();
+    __atomic_add_fetch(&procp->slot_session_count[slotID], 1,
+                       __ATOMIC_RELAXED);
 }
 
 void decr_sess_counts(CK_SLOT_ID slotID)
@@ -266,21 +279,12 @@ void decr_sess_counts(CK_SLOT_ID slotID)
     Slot_Mgr_Proc_t *procp;
 #endif
 
-    // Get the slot mutex
     shm = Anchor->SharedMemP;
 
-    ProcLock();
-
-    if (shm->slot_global_sessions[slotID] > 0) {
-        shm->slot_global_sessions[slotID]--;
-    }
+    sess_count_decr(&shm->slot_global_sessions[slotID]);
 
     procp = &shm->proc_table[Anchor->MgrProcIndex];
-    if (procp->slot_session_count[slotID] > 0) {
-        procp->slot_session_count[slotID]++;
-    }
-
-    ProcUnLock();
+    sess_count_decr(&procp->slot_session_count[slotID]);
 }
 
 // Check if any sessions from other applicaitons exist on this particular
@@ -295,12 +299,10 @@ int sessions_exist(CK_SLOT_ID slotID)
     Slot_Mgr_Shr_t *shm;
     uint32 numSessions;
 
-    // Get the slot mutex
     shm = Anchor->SharedMemP;
 
-    ProcLock();
-    numSessions = shm->slot_global_sessions[slotID];
-    ProcUnLock();
+    numSessions = __atomic_load_n(&shm->slot_global_sessions[slotID],
+                                  __ATOMIC_RELAXED);
 
     return numSessions != 0;
 }
@@ -604,6 +606,9 @@ int DL_Load_and_Init(API_Slot_t *sltp, CK_SLOT_ID slotID, policy_t policy,
     sltp->TokData->policy = policy;
     sltp->TokData->mechtable_funcs = &mechtable_funcs;
     sltp->TokData->statistics = statistics;
+#if OPENSSL_VERSION_PREREQ(3, 0)
+    sltp->TokData->openssl_libctx = Anchor->openssl_libctx;
+#endif
     
     if (strlen(sinfp->dll_location) > 0) {
         // Check if this DLL has been loaded already.. If so, just increment
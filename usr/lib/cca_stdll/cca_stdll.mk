@@ -37,8 +37,10 @@ opencryptoki_stdll_libpkcs11_cca_la_SOURCES = usr/lib/common/asn1.c	\
 	usr/lib/common/sw_crypt.c usr/lib/common/shared_memory.c	\
 	usr/lib/common/profile_obj.c usr/lib/cca_stdll/cca_specific.c	\
 	usr/lib/common/attributes.c usr/lib/common/dlist.c		\
+	usr/lib/common/handle_table.c usr/lib/common/objdb.c		\
+	usr/lib/common/worker_pool.c usr/lib/common/async_mgr.c	\
 	usr/lib/common/utility_common.c usr/lib/common/ec_supported.c	\
-	usr/lib/api/policyhelper.c
+	usr/lib/api/policyhelper.c usr/lib/api/hashmap.c
 
 if ENABLE_LOCKS
 opencryptoki_stdll_libpkcs11_cca_la_SOURCES +=				\
@@ -135,6 +135,9 @@ token_spec_t token_specific = {
     NULL,                       // set_attribute_values
     NULL,                       // set_attrs_for_new_object
     NULL,                       // handle_event
+    NULL,                       // aes_gcm_msg_init
+    NULL,                       // aes_gcm_msg_begin
+    NULL,                       // aes_gcm_msg_next
 };
 
 #endif
@@ -0,0 +1,285 @@
+/*
+ * COPYRIGHT (c) International Business Machines Corp. 2024
+ *
+ * This program is provided under the terms of the Common Public License,
+ * version 1.0 (CPL-1.0). Any use, reproduction or distribution for this
+ * software constitutes recipient's acceptance of CPL-1.0 terms which can be
+ * found in the file LICENSE file or at
+ * https://opensource.org/licenses/cpl1.0.php
+ */
+
+// File:  async_mgr.c
+//
+// Asynchronous single-part sign and encrypt operations
+//
+// An operation is initialized in the calling thread, so that argument, key
+// and policy errors are returned right away. The sign or encrypt call itself
+// runs on one of the token's worker threads. When it is done, its result is
+// stored with the operation and the eventfd given by the application, if any,
+// is incremented by one.
+//
+// Operations stay in the token's async_table until the application collects
+// their result. Operations whose result is never collected are freed when the
+// token is finalized.
+//
+
+#include <pthread.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <errno.h>
+
+#include "pkcs11types.h"
+#include "defs.h"
+#include "host_defs.h"
+#include "h_extern.h"
+#include "trace.h"
+#include "worker_pool.h"
+
+struct async_op {
+    struct bt_ref_hdr hdr;      // must be first, see handle_table.c
+    STDLL_TokData_t *tokdata;
+    CK_SESSION_HANDLE session;
+    SESSION *sess;              // referenced until the operation is done
+    CK_ULONG operation;         // OP_SIGN_INIT or OP_ENCRYPT_INIT
+    union {
+        SIGN_VERIFY_CONTEXT sign;
+        ENCR_DECR_CONTEXT encr;
+    } ctx;
+    CK_BYTE *in_data;
+    CK_ULONG in_data_len;
+    CK_BYTE *out_data;
+    CK_ULONG *out_data_len;
+    int notify_fd;
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    CK_BBOOL done;
+    CK_RV rc;
+};
+
+// Delete function of the async_table, the operation is done at this point
+//
+void async_mgr_free_op(void *value)
+{
+    struct async_op *op = value;
+
+    pthread_cond_destroy(&op->cond);
+    pthread_mutex_destroy(&op->mutex);
+    free(op);
+}
+
+// The soft token's HMAC functions keep their state in the session's sign
+// context, not in the one passed to sign_mgr_sign(). Only the signature
+// mechanisms that keep all state in the passed context can run in parallel
+// to other operations of the same session.
+//
+static CK_BBOOL async_sign_mech_supported(CK_MECHANISM_TYPE mech)
+{
+    switch (mech) {
+    case CKM_RSA_PKCS:
+    case CKM_RSA_X_509:
+    case CKM_RSA_PKCS_PSS:
+    case CKM_MD5_RSA_PKCS:
+    case CKM_SHA1_RSA_PKCS:
+    case CKM_SHA224_RSA_PKCS:
+    case CKM_SHA256_RSA_PKCS:
+    case CKM_SHA384_RSA_PKCS:
+    case CKM_SHA512_RSA_PKCS:
+    case CKM_SHA1_RSA_PKCS_PSS:
+    case CKM_SHA224_RSA_PKCS_PSS:
+    case CKM_SHA256_RSA_PKCS_PSS:
+    case CKM_SHA384_RSA_PKCS_PSS:
+    case CKM_SHA512_RSA_PKCS_PSS:
+    case CKM_DSA:
+    case CKM_ECDSA:
+    case CKM_ECDSA_SHA1:
+    case CKM_ECDSA_SHA224:
+    case CKM_ECDSA_SHA256:
+    case CKM_ECDSA_SHA384:
+    case CKM_ECDSA_SHA512:
+        return TRUE;
+    default:
+        return FALSE;
+    }
+}
+
+static void async_op_run(void *private)
+{
+    struct async_op *op = private;
+    STDLL_TokData_t *tokdata = op->tokdata;
+    uint64_t one = 1;
+    CK_RV rc;
+
+    if (op->operation == OP_SIGN_INIT) {
+        rc = sign_mgr_sign(tokdata, op->sess, FALSE, &op->ctx.sign,
+                           op->in_data, op->in_data_len,
+                           op->out_data, op->out_data_len);
+        if (rc != CKR_OK)
+            TRACE_DEVEL("sign_mgr_sign() failed.\n");
+        sign_mgr_cleanup(tokdata, op->sess, &op->ctx.sign);
+    } else {
+        rc = encr_mgr_encrypt(tokdata, op->sess, FALSE, &op->ctx.encr,
+                              op->in_data, op->in_data_len,
+                              op->out_data, op->out_data_len);
+        if (rc != CKR_OK)
+            TRACE_DEVEL("encr_mgr_encrypt() failed.\n");
+        encr_mgr_cleanup(tokdata, op->sess, &op->ctx.encr);
+    }
+
+    session_mgr_put(tokdata, op->sess);
+    op->sess = NULL;
+
+    // The eventfd is written before a waiter can see the result, so the
+    // application may close it as soon as it collected all results.
+    pthread_mutex_lock(&op->mutex);
+    op->rc = rc;
+    op->done = TRUE;
+    pthread_cond_broadcast(&op->cond);
+    if (op->notify_fd >= 0 &&
+        write(op->notify_fd, &one, sizeof(one)) != sizeof(one))
+        TRACE_WARNING("Failed to write the notification fd: %s\n",
+                      strerror(errno));
+    pthread_mutex_unlock(&op->mutex);
+
+    ht_put_value(&tokdata->async_table, op);
+}
+
+//
+// Starts a single-part sign (OP_SIGN_INIT) or encrypt (OP_ENCRYPT_INIT)
+// operation and returns its handle. in_data, out_data and out_data_len must
+// stay valid until the operation is done. The length of the output is
+// returned in out_data_len when the operation is done, there is no length
+// query.
+//
+CK_RV async_mgr_submit(STDLL_TokData_t *tokdata, SESSION *sess,
+                       CK_ULONG operation, CK_MECHANISM *mech,
+                       CK_OBJECT_HANDLE key,
+                       CK_BYTE *in_data, CK_ULONG in_data_len,
+                       CK_BYTE *out_data, CK_ULONG *out_data_len,
+                       int notify_fd, CK_ULONG *handle, CK_BBOOL checkpolicy)
+{
+    struct async_op *op;
+    CK_RV rc;
+
+    if (operation == OP_SIGN_INIT &&
+        !async_sign_mech_supported(mech->mechanism)) {
+        TRACE_ERROR("%s\n", ock_err(ERR_MECHANISM_INVALID));
+        return CKR_MECHANISM_INVALID;
+    }
+
+    op = calloc(1, sizeof(*op));
+    if (op == NULL) {
+        TRACE_ERROR("%s\n", ock_err(ERR_HOST_MEMORY));
+        return CKR_HOST_MEMORY;
+    }
+
+    op->tokdata = tokdata;
+    op->session = sess->handle;
+    op->operation = operation;
+    op->in_data = in_data;
+    op->in_data_len = in_data_len;
+    op->out_data = out_data;
+    op->out_data_len = out_data_len;
+    op->notify_fd = notify_fd;
+    pthread_mutex_init(&op->mutex, NULL);
+    pthread_cond_init(&op->cond, NULL);
+
+    if (operation == OP_SIGN_INIT) {
+        op->ctx.sign.count_statistics = TRUE;
+        rc = sign_mgr_init(tokdata, sess, &op->ctx.sign, mech, FALSE, key,
+                           checkpolicy);
+        if (rc != CKR_OK) {
+            TRACE_DEVEL("sign_mgr_init() failed.\n");
+            goto error;
+        }
+    } else {
+        op->ctx.encr.count_statistics = TRUE;
+        rc = encr_mgr_init(tokdata, sess, &op->ctx.encr, OP_ENCRYPT_INIT,
+                           mech, key, checkpolicy);
+        if (rc != CKR_OK) {
+            TRACE_DEVEL("encr_mgr_init() failed.\n");
+            goto error;
+        }
+    }
+
+    // The operation keeps its own reference to the session
+    op->sess = session_mgr_find(tokdata, sess->handle);
+    if (op->sess == NULL) {
+        TRACE_ERROR("%s\n", ock_err(ERR_SESSION_HANDLE_INVALID));
+        rc = CKR_SESSION_HANDLE_INVALID;
+        goto error;
+    }
+
+    *handle = ht_add(&tokdata->async_table, op);
+    if (*handle == 0) {
+        rc = CKR_HOST_MEMORY;
+        goto error;
+    }
+
+    // One reference for the table, one for the job
+    __atomic_add_fetch(&op->hdr.ref, 1, __ATOMIC_ACQ_REL);
+
+    if (tokdata->workers == NULL ||
+        worker_pool_submit(tokdata->workers, async_op_run, op) != CKR_OK) {
+        // Without a worker thread, the operation is done right away
+        async_op_run(op);
+    }
+
+    return CKR_OK;
+
+error:
+    if (op->sess != NULL)
+        session_mgr_put(tokdata, op->sess);
+    if (operation == OP_SIGN_INIT)
+        sign_mgr_cleanup(tokdata, sess, &op->ctx.sign);
+    else
+        encr_mgr_cleanup(tokdata, sess, &op->ctx.encr);
+    async_mgr_free_op(op);
+
+    return rc;
+}
+
+//
+// Returns the result of an operation of the session once it is done, and
+// frees the operation. If block is FALSE and the operation is not done yet,
+// CKR_IBM_ASYNC_PENDING is returned and the operation stays valid.
+//
+CK_RV async_mgr_wait(STDLL_TokData_t *tokdata, SESSION *sess,
+                     CK_ULONG handle, CK_BBOOL block)
+{
+    struct async_op *op;
+    CK_BBOOL done;
+    CK_RV rc;
+
+    op = ht_get_value(&tokdata->async_table, handle);
+    if (op == NULL || op->session != sess->handle) {
+        TRACE_ERROR("%s\n", ock_err(ERR_ARGUMENTS_BAD));
+        rc = CKR_ARGUMENTS_BAD;
+        goto out;
+    }
+
+    pthread_mutex_lock(&op->mutex);
+    while (block && !op->done)
+        pthread_cond_wait(&op->cond, &op->mutex);
+    done = op->done;
+    rc = op->rc;
+    pthread_mutex_unlock(&op->mutex);
+
+    if (!done) {
+        rc = CKR_IBM_ASYNC_PENDING;
+        goto out;
+    }
+
+    // Only one caller collects the result
+    if (ht_remove(&tokdata->async_table, handle, TRUE) == NULL) {
+        TRACE_ERROR("%s\n", ock_err(ERR_ARGUMENTS_BAD));
+        rc = CKR_ARGUMENTS_BAD;
+    }
+
+out:
+    if (op != NULL)
+        ht_put_value(&tokdata->async_table, op);
+
+    return rc;
+}
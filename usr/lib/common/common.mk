@@ -5,4 +5,6 @@ noinst_HEADERS +=							\
 	usr/lib/common/trace.h usr/lib/common/h_extern.h		\
 	usr/lib/common/sw_crypt.h usr/lib/common/defs.h			\
 	usr/lib/common/p11util.h usr/lib/common/event_client.h		\
-	usr/lib/common/list.h usr/lib/common/tok_specific.h
+	usr/lib/common/list.h usr/lib/common/tok_specific.h		\
+	usr/lib/common/objdb.h usr/lib/common/drbg.h			\
+	usr/lib/common/worker_pool.h
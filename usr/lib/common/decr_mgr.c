@@ -1149,3 +1149,239 @@ CK_RV decr_mgr_decrypt_final(STDLL_TokData_t *tokdata,
 
     return CKR_FUNCTION_FAILED;
 }
+
+//
+//
+CK_RV decr_mgr_msg_init(STDLL_TokData_t *tokdata, SESSION *sess,
+                        ENCR_DECR_CONTEXT *ctx, CK_MECHANISM *mech,
+                        CK_OBJECT_HANDLE key_handle, CK_BBOOL checkpolicy)
+{
+    OBJECT *key_obj = NULL;
+    CK_KEY_TYPE keytype;
+    CK_BBOOL flag;
+    CK_ULONG strength = POLICY_STRENGTH_IDX_0;
+    CK_RV rc;
+
+    if (!sess || !ctx || !mech) {
+        TRACE_ERROR("Invalid function arguments.\n");
+        return CKR_FUNCTION_FAILED;
+    }
+    if (ctx->active != FALSE) {
+        TRACE_ERROR("%s\n", ock_err(ERR_OPERATION_ACTIVE));
+        return CKR_OPERATION_ACTIVE;
+    }
+
+    rc = object_mgr_find_in_map1(tokdata, key_handle, &key_obj, READ_LOCK);
+    if (rc != CKR_OK) {
+        TRACE_ERROR("Failed to acquire key from specified handle.\n");
+        if (rc == CKR_OBJECT_HANDLE_INVALID)
+            return CKR_KEY_HANDLE_INVALID;
+        else
+            return rc;
+    }
+
+    rc = template_attribute_get_bool(key_obj->template, CKA_DECRYPT, &flag);
+    if (rc != CKR_OK) {
+        TRACE_ERROR("Could not find CKA_DECRYPT for the key.\n");
+        rc = CKR_KEY_FUNCTION_NOT_PERMITTED;
+        goto done;
+    }
+
+    if (flag != TRUE) {
+        TRACE_ERROR("%s\n", ock_err(ERR_KEY_FUNCTION_NOT_PERMITTED));
+        rc = CKR_KEY_FUNCTION_NOT_PERMITTED;
+        goto done;
+    }
+
+    if (checkpolicy) {
+        rc = tokdata->policy->is_mech_allowed(tokdata->policy, mech,
+                                              &key_obj->strength,
+                                              POLICY_CHECK_DECRYPT, sess);
+        if (rc != CKR_OK) {
+            TRACE_ERROR("POLICY VIOLATION: message decrypt init\n");
+            goto done;
+        }
+    }
+    if (!key_object_is_mechanism_allowed(key_obj->template, mech->mechanism)) {
+        TRACE_ERROR("Mechanism not allwed per CKA_ALLOWED_MECHANISMS.\n");
+        rc = CKR_MECHANISM_INVALID;
+        goto done;
+    }
+
+    switch (mech->mechanism) {
+#ifndef NOAES
+    case CKM_AES_GCM:
+        /* The GCM parameters are supplied with each message */
+        if (mech->ulParameterLen != 0 || mech->pParameter != NULL) {
+            TRACE_ERROR("%s\n", ock_err(ERR_MECHANISM_PARAM_INVALID));
+            rc = CKR_MECHANISM_PARAM_INVALID;
+            goto done;
+        }
+
+        rc = template_attribute_get_ulong(key_obj->template, CKA_KEY_TYPE,
+                                          &keytype);
+        if (rc != CKR_OK) {
+            TRACE_ERROR("Could not find CKA_KEY_TYPE for the key.\n");
+            goto done;
+        }
+
+        if (keytype != CKK_AES) {
+            TRACE_ERROR("%s\n", ock_err(ERR_KEY_TYPE_INCONSISTENT));
+            rc = CKR_KEY_TYPE_INCONSISTENT;
+            goto done;
+        }
+
+        ctx->context_len = sizeof(AES_GCM_MSG_CONTEXT);
+        ctx->context = (CK_BYTE *) malloc(sizeof(AES_GCM_MSG_CONTEXT));
+        if (!ctx->context) {
+            TRACE_ERROR("%s\n", ock_err(ERR_HOST_MEMORY));
+            rc = CKR_HOST_MEMORY;
+            goto done;
+        }
+        memset(ctx->context, 0x0, sizeof(AES_GCM_MSG_CONTEXT));
+
+        strength = key_obj->strength.strength;
+
+        /* Release obj lock, token specific aes-gcm may re-acquire the lock */
+        object_put(tokdata, key_obj, TRUE);
+        key_obj = NULL;
+
+        rc = aes_gcm_msg_init(tokdata, sess, ctx, mech, key_handle, 0);
+        if (rc != CKR_OK) {
+            TRACE_ERROR("Could not initialize AES_GCM message context.\n");
+            decr_mgr_cleanup(tokdata, sess, ctx);
+            goto done;
+        }
+        break;
+#endif
+    default:
+        TRACE_ERROR("%s\n", ock_err(ERR_MECHANISM_INVALID));
+        rc = CKR_MECHANISM_INVALID;
+        goto done;
+    }
+
+    ctx->key = key_handle;
+    ctx->mech.ulParameterLen = 0;
+    ctx->mech.mechanism = mech->mechanism;
+    ctx->mech.pParameter = NULL;
+    ctx->multi_init = FALSE;
+    ctx->multi = FALSE;
+    ctx->active = TRUE;
+    ctx->pkey_active = FALSE;
+
+    rc = CKR_OK;
+
+done:
+    if (ctx->count_statistics == TRUE && rc == CKR_OK)
+        INC_COUNTER(tokdata, sess, mech, key_obj, strength);
+
+    object_put(tokdata, key_obj, TRUE);
+    key_obj = NULL;
+
+    return rc;
+}
+
+//
+//
+CK_RV decr_mgr_decrypt_msg_begin(STDLL_TokData_t *tokdata, SESSION *sess,
+                                 ENCR_DECR_CONTEXT *ctx,
+                                 CK_VOID_PTR param, CK_ULONG param_len,
+                                 CK_BYTE *aad, CK_ULONG aad_len)
+{
+    if (!sess || !ctx) {
+        TRACE_ERROR("Invalid function arguments.\n");
+        return CKR_FUNCTION_FAILED;
+    }
+    if (ctx->active == FALSE) {
+        TRACE_ERROR("%s\n", ock_err(ERR_OPERATION_NOT_INITIALIZED));
+        return CKR_OPERATION_NOT_INITIALIZED;
+    }
+
+    switch (ctx->mech.mechanism) {
+#ifndef NOAES
+    case CKM_AES_GCM:
+        return aes_gcm_msg_begin(tokdata, sess, ctx, param, param_len,
+                                 aad, aad_len, 0);
+#endif
+    default:
+        TRACE_ERROR("%s\n", ock_err(ERR_MECHANISM_INVALID));
+        return CKR_MECHANISM_INVALID;
+    }
+}
+
+//
+//
+CK_RV decr_mgr_decrypt_msg_next(STDLL_TokData_t *tokdata, SESSION *sess,
+                                CK_BBOOL length_only, ENCR_DECR_CONTEXT *ctx,
+                                CK_VOID_PTR param, CK_ULONG param_len,
+                                CK_BYTE *in_data, CK_ULONG in_data_len,
+                                CK_BYTE *out_data, CK_ULONG *out_data_len,
+                                CK_FLAGS flags)
+{
+    if (!sess || !ctx) {
+        TRACE_ERROR("Invalid function arguments.\n");
+        return CKR_FUNCTION_FAILED;
+    }
+    if (ctx->active == FALSE) {
+        TRACE_ERROR("%s\n", ock_err(ERR_OPERATION_NOT_INITIALIZED));
+        return CKR_OPERATION_NOT_INITIALIZED;
+    }
+
+    switch (ctx->mech.mechanism) {
+#ifndef NOAES
+    case CKM_AES_GCM:
+        return aes_gcm_msg_next(tokdata, sess, length_only, ctx,
+                                param, param_len, in_data, in_data_len,
+                                out_data, out_data_len, flags, 0);
+#endif
+    default:
+        TRACE_ERROR("%s\n", ock_err(ERR_MECHANISM_INVALID));
+        return CKR_MECHANISM_INVALID;
+    }
+}
+
+// Single-part message decryption. The output length is checked before
+// the message is begun, so a too small buffer does not consume an IV.
+//
+CK_RV decr_mgr_decrypt_msg(STDLL_TokData_t *tokdata, SESSION *sess,
+                           CK_BBOOL length_only, ENCR_DECR_CONTEXT *ctx,
+                           CK_VOID_PTR param, CK_ULONG param_len,
+                           CK_BYTE *aad, CK_ULONG aad_len,
+                           CK_BYTE *in_data, CK_ULONG in_data_len,
+                           CK_BYTE *out_data, CK_ULONG *out_data_len)
+{
+    CK_ULONG req_len;
+    CK_RV rc;
+
+    if (!out_data_len) {
+        TRACE_ERROR("Invalid function arguments.\n");
+        return CKR_FUNCTION_FAILED;
+    }
+
+    rc = decr_mgr_decrypt_msg_next(tokdata, sess, TRUE, ctx, param, param_len,
+                                   in_data, in_data_len, NULL, &req_len,
+                                   CKF_END_OF_MESSAGE);
+    if (rc != CKR_OK)
+        return rc;
+
+    if (length_only) {
+        *out_data_len = req_len;
+        return CKR_OK;
+    }
+
+    if (*out_data_len < req_len) {
+        *out_data_len = req_len;
+        TRACE_ERROR("%s\n", ock_err(ERR_BUFFER_TOO_SMALL));
+        return CKR_BUFFER_TOO_SMALL;
+    }
+
+    rc = decr_mgr_decrypt_msg_begin(tokdata, sess, ctx, param, param_len,
+                                    aad, aad_len);
+    if (rc != CKR_OK)
+        return rc;
+
+    return decr_mgr_decrypt_msg_next(tokdata, sess, FALSE, ctx,
+                                     param, param_len, in_data, in_data_len,
+                                     out_data, out_data_len,
+                                     CKF_END_OF_MESSAGE);
+}
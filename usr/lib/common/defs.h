@@ -165,7 +165,21 @@ struct oc_sha_ctx {
 
 #define DEFAULT_SO_PIN  "87654321"
 
-#define MAX_TOK_OBJS 2048
+// Maximum number of public resp. private token objects. The shared memory
+// hash tables holding them start with TOK_OBJ_MIN_CAPACITY slots each and
+// grow on demand up to TOK_OBJ_MAX_CAPACITY slots.
+#define MAX_TOK_OBJS 131072
+#define TOK_OBJ_MIN_CAPACITY 1024
+#define TOK_OBJ_MAX_CAPACITY (2 * MAX_TOK_OBJS)
+
+// Layout version of the token's shared memory segment (LW_SHM_TYPE)
+#define LW_SHM_VERSION 3
+
+// Number of entries in the token object change log in shared memory, must be
+// a power of 2. Processes that fall further behind do a full resync.
+#define TOK_OBJ_CHANGE_LOG_SIZE 1024
+#define TOK_OBJ_CHANGE_ADD 1
+#define TOK_OBJ_CHANGE_DEL 2
 
 
 typedef enum {
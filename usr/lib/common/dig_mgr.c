@@ -167,9 +167,32 @@ CK_RV digest_mgr_cleanup(STDLL_TokData_t *tokdata, SESSION *sess,
     }
     ctx->context_free_func = NULL;
 
+    /*
+     * Only the session's own digest context keeps a pooled context for the
+     * next operation. Digest contexts used internally, e.g. by the sign and
+     * verify managers, are freed right after their single operation.
+     */
+    if (sess == NULL || ctx != &sess->digest_ctx)
+        digest_mgr_free_pool(tokdata, sess, ctx);
+
     return CKR_OK;
 }
 
+//
+//
+void digest_mgr_free_pool(STDLL_TokData_t *tokdata, SESSION *sess,
+                          DIGEST_CONTEXT *ctx)
+{
+    if (ctx->pool_context != NULL) {
+        if (ctx->pool_context_free_func != NULL)
+            ctx->pool_context_free_func(tokdata, sess, ctx->pool_context, 0);
+        else
+            free(ctx->pool_context);
+        ctx->pool_context = NULL;
+    }
+    ctx->pool_context_free_func = NULL;
+}
+
 
 
 //
@@ -261,6 +284,80 @@ out:
 }
 
 
+//
+// Digests each of the count data buffers with the given mechanism. The
+// digests are returned one after the other in out_data. The session's digest
+// context is used for all of them, so they share its pooled token context.
+//
+CK_RV digest_mgr_digest_batch(STDLL_TokData_t *tokdata,
+                              SESSION *sess, CK_MECHANISM *mech,
+                              CK_IBM_DATA *data, CK_ULONG count,
+                              CK_BYTE *out_data, CK_ULONG *out_data_len,
+                              CK_BBOOL checkpolicy)
+{
+    DIGEST_CONTEXT *ctx = &sess->digest_ctx;
+    CK_ULONG i, hash_len, len;
+    CK_RV rc;
+
+    ctx->count_statistics = TRUE;
+    rc = digest_mgr_init(tokdata, sess, ctx, mech, checkpolicy);
+    if (rc != CKR_OK) {
+        TRACE_DEVEL("digest_mgr_init() failed.\n");
+        return rc;
+    }
+
+    /* All digests have the same length */
+    rc = digest_mgr_digest(tokdata, sess, TRUE, ctx, data[0].pData,
+                           data[0].ulDataLen, NULL, &hash_len);
+    if (rc != CKR_OK) {
+        TRACE_DEVEL("digest_mgr_digest() failed.\n");
+        return rc;
+    }
+
+    if (out_data == NULL) {
+        *out_data_len = hash_len * count;
+        rc = CKR_OK;
+        goto out;
+    }
+    if (*out_data_len < hash_len * count) {
+        *out_data_len = hash_len * count;
+        TRACE_ERROR("%s\n", ock_err(ERR_BUFFER_TOO_SMALL));
+        rc = CKR_BUFFER_TOO_SMALL;
+        goto out;
+    }
+
+    for (i = 0; i < count; i++) {
+        if (i > 0) {
+            /* Policy was checked for the first one already */
+            ctx->count_statistics = TRUE;
+            rc = digest_mgr_init(tokdata, sess, ctx, mech, FALSE);
+            if (rc != CKR_OK) {
+                TRACE_DEVEL("digest_mgr_init() failed.\n");
+                goto out;
+            }
+        }
+
+        /* This ends the operation, but keeps the pooled context */
+        len = hash_len;
+        rc = digest_mgr_digest(tokdata, sess, FALSE, ctx, data[i].pData,
+                               data[i].ulDataLen, out_data + i * hash_len,
+                               &len);
+        if (rc != CKR_OK) {
+            TRACE_DEVEL("digest_mgr_digest() failed for data %lu.\n", i);
+            goto out;
+        }
+    }
+
+    *out_data_len = hash_len * count;
+
+out:
+    if (ctx->active)
+        digest_mgr_cleanup(tokdata, sess, ctx);
+
+    return rc;
+}
+
+
 //
 //
 CK_RV digest_mgr_digest_update(STDLL_TokData_t *tokdata,
@@ -0,0 +1,362 @@
+/*
+ * COPYRIGHT (c) International Business Machines Corp. 2024
+ *
+ * This program is provided under the terms of the Common Public License,
+ * version 1.0 (CPL-1.0). Any use, reproduction or distribution for this
+ * software constitutes recipient's acceptance of CPL-1.0 terms which can be
+ * found in the file LICENSE file or at
+ * https://opensource.org/licenses/cpl1.0.php
+ */
+
+/*
+ * drbg.c
+ *
+ * CTR_DRBG as specified in NIST SP 800-90A section 10.2.1, using AES-256
+ * without a derivation function. The entropy input is read with getrandom().
+ *
+ * Each thread has its own instance, so generating random data takes no locks.
+ * The keystream of the AES-256-CTR mode cipher is exactly the sequence of the
+ * encrypted counter values V+1, V+2, ... of the DRBG, so one cipher call
+ * produces all blocks of a request.
+ *
+ * Requests of less than DRBG_BUFFER_LEN bytes are served from a per-thread
+ * buffer that is refilled with one generate call, so that small requests like
+ * IVs and object key wrapping keys do not need a cipher call each. Bytes taken
+ * from the buffer are wiped.
+ *
+ * A forked child inherits the instances of its parent. The token's final
+ * function is called with in_fork_initializer set from the child's fork
+ * handler (child_fork_initializer), and drbg_final() then wipes and drops all
+ * inherited instances. Threads of the child seed new instances on first use.
+ */
+
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sys/random.h>
+
+#include <openssl/evp.h>
+#include <openssl/crypto.h>
+
+#include "pkcs11types.h"
+#include "defs.h"
+#include "host_defs.h"
+#include "h_extern.h"
+#include "trace.h"
+#include "pkcs_utils.h"
+#include "drbg.h"
+
+#define DRBG_KEY_LEN            32
+#define DRBG_BLOCK_LEN          16
+#define DRBG_SEED_LEN           (DRBG_KEY_LEN + DRBG_BLOCK_LEN)
+/* SP 800-90A allows 2^19 bits per request and 2^48 requests per seed */
+#define DRBG_MAX_REQUEST        65536
+#define DRBG_RESEED_INTERVAL    (1UL << 20)
+#define DRBG_BUFFER_LEN         512
+
+struct drbg_state {
+    struct drbg_state *prev;
+    struct drbg_state *next;
+    EVP_CIPHER_CTX *ctx;
+    unsigned char key[DRBG_KEY_LEN];
+    unsigned char v[DRBG_BLOCK_LEN];
+    unsigned long reseed_counter;
+    unsigned char buf[DRBG_BUFFER_LEN];
+    size_t buf_avail;           /* unused bytes at the end of buf */
+};
+
+static pthread_mutex_t drbg_mutex = PTHREAD_MUTEX_INITIALIZER;
+static unsigned int drbg_refcount = 0;
+static pthread_key_t drbg_key;
+static struct drbg_state *drbg_states = NULL;
+/* incremented whenever all instances are dropped */
+static unsigned long drbg_generation = 0;
+
+/*
+ * The key is only used for its destructor. A thread's instance pointer is
+ * also kept in thread local storage, together with the generation it belongs
+ * to. Instances of an older generation have been freed by drbg_final().
+ */
+static __thread struct drbg_state *drbg_tls_state = NULL;
+static __thread unsigned long drbg_tls_generation = 0;
+
+/* Adds n to the 128 bit big endian counter v. */
+static void drbg_add_v(unsigned char *v, unsigned long n)
+{
+    int i;
+
+    for (i = DRBG_BLOCK_LEN - 1; i >= 0 && n != 0; i--) {
+        n += v[i];
+        v[i] = n & 0xff;
+        n >>= 8;
+    }
+}
+
+/*
+ * Computes E(K, V+1) || E(K, V+2) || ... for len bytes and advances V by the
+ * number of blocks used.
+ */
+static CK_RV drbg_ctr(struct drbg_state *s, unsigned char *out, size_t len)
+{
+    unsigned char iv[DRBG_BLOCK_LEN];
+    int outlen;
+
+    memcpy(iv, s->v, sizeof(iv));
+    drbg_add_v(iv, 1);
+
+    memset(out, 0, len);
+    if (EVP_EncryptInit_ex(s->ctx, EVP_aes_256_ctr(), NULL, s->key, iv) != 1 ||
+        EVP_EncryptUpdate(s->ctx, out, &outlen, out, len) != 1 ||
+        (size_t)outlen != len) {
+        TRACE_ERROR("AES-256-CTR failed.\n");
+        return CKR_FUNCTION_FAILED;
+    }
+
+    drbg_add_v(s->v, (len + DRBG_BLOCK_LEN - 1) / DRBG_BLOCK_LEN);
+
+    return CKR_OK;
+}
+
+/* CTR_DRBG_Update with provided_data, or with zeros if it is NULL. */
+static CK_RV drbg_update(struct drbg_state *s, const unsigned char *data)
+{
+    unsigned char temp[DRBG_SEED_LEN];
+    CK_RV rc;
+    int i;
+
+    rc = drbg_ctr(s, temp, sizeof(temp));
+    if (rc != CKR_OK)
+        goto out;
+
+    if (data != NULL) {
+        for (i = 0; i < DRBG_SEED_LEN; i++)
+            temp[i] ^= data[i];
+    }
+
+    memcpy(s->key, temp, DRBG_KEY_LEN);
+    memcpy(s->v, temp + DRBG_KEY_LEN, DRBG_BLOCK_LEN);
+
+out:
+    OPENSSL_cleanse(temp, sizeof(temp));
+
+    return rc;
+}
+
+static CK_RV drbg_get_entropy(unsigned char *seed, size_t len)
+{
+    size_t total = 0;
+    ssize_t n;
+
+    while (total < len) {
+        n = getrandom(seed + total, len - total, 0);
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            if (errno == ENOSYS)
+                return local_rng(seed + total, len - total);
+            TRACE_ERROR("getrandom failed: %s\n", strerror(errno));
+            return CKR_FUNCTION_FAILED;
+        }
+        total += n;
+    }
+
+    return CKR_OK;
+}
+
+/* Instantiate (if V and Key are still zero) or reseed. */
+static CK_RV drbg_seed(struct drbg_state *s)
+{
+    unsigned char seed[DRBG_SEED_LEN];
+    CK_RV rc;
+
+    rc = drbg_get_entropy(seed, sizeof(seed));
+    if (rc == CKR_OK)
+        rc = drbg_update(s, seed);
+    if (rc == CKR_OK)
+        s->reseed_counter = 1;
+
+    OPENSSL_cleanse(seed, sizeof(seed));
+
+    return rc;
+}
+
+/* CTR_DRBG_Generate for up to DRBG_MAX_REQUEST bytes. */
+static CK_RV drbg_generate_one(struct drbg_state *s, unsigned char *out,
+                               size_t len)
+{
+    CK_RV rc;
+
+    if (s->reseed_counter > DRBG_RESEED_INTERVAL) {
+        rc = drbg_seed(s);
+        if (rc != CKR_OK)
+            return rc;
+    }
+
+    rc = drbg_ctr(s, out, len);
+    if (rc != CKR_OK)
+        return rc;
+
+    rc = drbg_update(s, NULL);
+    if (rc != CKR_OK)
+        return rc;
+
+    s->reseed_counter++;
+
+    return CKR_OK;
+}
+
+static void drbg_state_free(struct drbg_state *s)
+{
+    EVP_CIPHER_CTX_free(s->ctx);
+    OPENSSL_cleanse(s, sizeof(*s));
+    free(s);
+}
+
+/* Thread exit: unlink and free the thread's instance. */
+static void drbg_thread_exit(void *value)
+{
+    struct drbg_state *s = value;
+
+    pthread_mutex_lock(&drbg_mutex);
+    if (s->prev != NULL)
+        s->prev->next = s->next;
+    else
+        drbg_states = s->next;
+    if (s->next != NULL)
+        s->next->prev = s->prev;
+    pthread_mutex_unlock(&drbg_mutex);
+
+    drbg_state_free(s);
+}
+
+static struct drbg_state *drbg_get_state(void)
+{
+    struct drbg_state *s;
+
+    if (drbg_tls_state != NULL && drbg_tls_generation == drbg_generation)
+        return drbg_tls_state;
+
+    s = calloc(1, sizeof(*s));
+    if (s == NULL) {
+        TRACE_ERROR("%s\n", ock_err(ERR_HOST_MEMORY));
+        return NULL;
+    }
+
+    s->ctx = EVP_CIPHER_CTX_new();
+    if (s->ctx == NULL || drbg_seed(s) != CKR_OK) {
+        TRACE_ERROR("Failed to instantiate the DRBG.\n");
+        drbg_state_free(s);
+        return NULL;
+    }
+
+    pthread_mutex_lock(&drbg_mutex);
+    s->next = drbg_states;
+    if (drbg_states != NULL)
+        drbg_states->prev = s;
+    drbg_states = s;
+    pthread_mutex_unlock(&drbg_mutex);
+
+    if (pthread_setspecific(drbg_key, s) != 0) {
+        drbg_thread_exit(s);
+        return NULL;
+    }
+
+    drbg_tls_state = s;
+    drbg_tls_generation = drbg_generation;
+
+    return s;
+}
+
+CK_RV drbg_init(void)
+{
+    CK_RV rc = CKR_OK;
+
+    pthread_mutex_lock(&drbg_mutex);
+    if (drbg_refcount == 0 &&
+        pthread_key_create(&drbg_key, drbg_thread_exit) != 0) {
+        TRACE_ERROR("pthread_key_create failed.\n");
+        rc = CKR_FUNCTION_FAILED;
+    } else {
+        drbg_refcount++;
+    }
+    pthread_mutex_unlock(&drbg_mutex);
+
+    return rc;
+}
+
+void drbg_final(CK_BBOOL in_fork_initializer)
+{
+    struct drbg_state *s, *next;
+
+    /*
+     * In a forked child, another thread of the parent may have held the
+     * mutex at the time of the fork.
+     */
+    if (in_fork_initializer)
+        pthread_mutex_init(&drbg_mutex, NULL);
+
+    pthread_mutex_lock(&drbg_mutex);
+    if (drbg_refcount == 0 || --drbg_refcount > 0) {
+        pthread_mutex_unlock(&drbg_mutex);
+        return;
+    }
+
+    /*
+     * The library may be unloaded after this, so no thread must run the key
+     * destructor anymore. Instances of threads that are still alive are freed
+     * here.
+     */
+    pthread_key_delete(drbg_key);
+    for (s = drbg_states; s != NULL; s = next) {
+        next = s->next;
+        drbg_state_free(s);
+    }
+    drbg_states = NULL;
+    drbg_generation++;
+    pthread_mutex_unlock(&drbg_mutex);
+}
+
+CK_RV drbg_generate(CK_BYTE *output, CK_ULONG bytes)
+{
+    struct drbg_state *s;
+    size_t len;
+    CK_RV rc;
+
+    if (drbg_refcount == 0)
+        return local_rng(output, bytes);
+
+    s = drbg_get_state();
+    if (s == NULL)
+        return CKR_FUNCTION_FAILED;
+
+    if (bytes < DRBG_BUFFER_LEN) {
+        if (s->buf_avail < bytes) {
+            rc = drbg_generate_one(s, s->buf, DRBG_BUFFER_LEN);
+            if (rc != CKR_OK) {
+                s->buf_avail = 0;
+                return rc;
+            }
+            s->buf_avail = DRBG_BUFFER_LEN;
+        }
+
+        len = DRBG_BUFFER_LEN - s->buf_avail;
+        memcpy(output, s->buf + len, bytes);
+        OPENSSL_cleanse(s->buf + len, bytes);
+        s->buf_avail -= bytes;
+
+        return CKR_OK;
+    }
+
+    while (bytes > 0) {
+        len = bytes < DRBG_MAX_REQUEST ? bytes : DRBG_MAX_REQUEST;
+        rc = drbg_generate_one(s, output, len);
+        if (rc != CKR_OK)
+            return rc;
+        output += len;
+        bytes -= len;
+    }
+
+    return CKR_OK;
+}
@@ -0,0 +1,29 @@
+/*
+ * COPYRIGHT (c) International Business Machines Corp. 2024
+ *
+ * This program is provided under the terms of the Common Public License,
+ * version 1.0 (CPL-1.0). Any use, reproduction or distribution for this
+ * software constitutes recipient's acceptance of CPL-1.0 terms which can be
+ * found in the file LICENSE file or at
+ * https://opensource.org/licenses/cpl1.0.php
+ */
+
+#ifndef DRBG_H
+#define DRBG_H
+
+#include "pkcs11types.h"
+
+/*
+ * Buffered CTR_DRBG (NIST SP 800-90A, AES-256, no derivation function) with
+ * one instance per thread, seeded with getrandom().
+ *
+ * drbg_init() and drbg_final() are reference counted, a token calls them from
+ * its init and final functions. drbg_final() with in_fork_initializer set
+ * drops the instances inherited from the parent process, so that a forked
+ * child never repeats the parent's output.
+ */
+CK_RV drbg_init(void);
+void drbg_final(CK_BBOOL in_fork_initializer);
+CK_RV drbg_generate(CK_BYTE *output, CK_ULONG bytes);
+
+#endif
@@ -433,9 +433,15 @@ CK_RV restore_private_token_object(STDLL_TokData_t *tokdata,
                                    OBJECT *pObj,
                                    const char *fname);
 
+CK_RV get_new_token_object_name(STDLL_TokData_t *tokdata, CK_BYTE *name);
 CK_RV delete_token_object(STDLL_TokData_t *tokdata, OBJECT *ptr);
 CK_RV delete_token_data(STDLL_TokData_t *tokdata);
 
+CK_RV begin_token_object_writeback(STDLL_TokData_t *tokdata);
+CK_RV end_token_object_writeback(STDLL_TokData_t *tokdata, CK_BBOOL discard);
+void clear_object_key_cache(STDLL_TokData_t *tokdata);
+void sync_token_objects(STDLL_TokData_t *tokdata);
+
 char *get_pk_dir(STDLL_TokData_t *tokdata, char *, size_t);
 
 CK_RV init_token_data(STDLL_TokData_t *, CK_SLOT_ID);
@@ -461,6 +467,15 @@ CK_RV compute_PKCS5_PBKDF2_HMAC(STDLL_TokData_t *tokdata,
                                 CK_BYTE *salt, CK_ULONG salt_len,
                                 CK_ULONG it_count, const EVP_MD *digest,
                                 CK_ULONG key_len, CK_BYTE *key);
+uint64_t pbkdf2_iterations(STDLL_TokData_t *tokdata, uint64_t default_it);
+CK_RV compute_login_keys(STDLL_TokData_t *tokdata, CK_USER_TYPE userType,
+                         CK_CHAR *pPin, CK_ULONG ulPinLen,
+                         unsigned char *login_key, unsigned char *wrap_key,
+                         CK_BBOOL *cached);
+void login_cache_put(STDLL_TokData_t *tokdata, CK_USER_TYPE userType,
+                     CK_CHAR *pPin, CK_ULONG ulPinLen,
+                     unsigned char *login_key, unsigned char *wrap_key);
+void login_cache_remove(STDLL_TokData_t *tokdata, CK_USER_TYPE userType);
 CK_RV compute_md5(STDLL_TokData_t *tokdata, CK_BYTE *data, CK_ULONG len,
                   CK_BYTE *hash);
 CK_RV compute_sha1(STDLL_TokData_t *tokdata, CK_BYTE *data, CK_ULONG len,
@@ -1496,6 +1511,19 @@ CK_RV aes_gcm_free_param(CK_GCM_PARAMS *params);
 void aes_gcm_param_from_compat(const CK_GCM_PARAMS_COMPAT *from,
                                CK_GCM_PARAMS *to);
 
+CK_RV aes_gcm_msg_init(STDLL_TokData_t *tokdata, SESSION *,
+                       ENCR_DECR_CONTEXT *, CK_MECHANISM *,
+                       CK_OBJECT_HANDLE, CK_BYTE);
+
+CK_RV aes_gcm_msg_begin(STDLL_TokData_t *tokdata, SESSION *,
+                        ENCR_DECR_CONTEXT *, CK_VOID_PTR, CK_ULONG,
+                        CK_BYTE *, CK_ULONG, CK_BYTE);
+
+CK_RV aes_gcm_msg_next(STDLL_TokData_t *tokdata, SESSION *, CK_BBOOL,
+                       ENCR_DECR_CONTEXT *, CK_VOID_PTR, CK_ULONG,
+                       CK_BYTE *, CK_ULONG, CK_BYTE *, CK_ULONG *,
+                       CK_FLAGS, CK_BYTE);
+
 CK_RV aes_ofb_encrypt(STDLL_TokData_t *tokdata, SESSION *sess,
                       CK_BBOOL length_only,
                       ENCR_DECR_CONTEXT *ctx, CK_BYTE *in_data,
@@ -1831,6 +1859,29 @@ CK_RV encr_mgr_encrypt_update(STDLL_TokData_t *tokdata, SESSION *sess,
                               CK_BYTE *in_data, CK_ULONG in_data_len,
                               CK_BYTE *out_data, CK_ULONG *out_data_len);
 
+CK_RV encr_mgr_msg_init(STDLL_TokData_t *tokdata, SESSION *sess,
+                        ENCR_DECR_CONTEXT *ctx, CK_MECHANISM *mech,
+                        CK_OBJECT_HANDLE key_handle, CK_BBOOL checkpolicy);
+
+CK_RV encr_mgr_encrypt_msg(STDLL_TokData_t *tokdata, SESSION *sess,
+                           CK_BBOOL length_only, ENCR_DECR_CONTEXT *ctx,
+                           CK_VOID_PTR param, CK_ULONG param_len,
+                           CK_BYTE *aad, CK_ULONG aad_len,
+                           CK_BYTE *in_data, CK_ULONG in_data_len,
+                           CK_BYTE *out_data, CK_ULONG *out_data_len);
+
+CK_RV encr_mgr_encrypt_msg_begin(STDLL_TokData_t *tokdata, SESSION *sess,
+                                 ENCR_DECR_CONTEXT *ctx,
+                                 CK_VOID_PTR param, CK_ULONG param_len,
+                                 CK_BYTE *aad, CK_ULONG aad_len);
+
+CK_RV encr_mgr_encrypt_msg_next(STDLL_TokData_t *tokdata, SESSION *sess,
+                                CK_BBOOL length_only, ENCR_DECR_CONTEXT *ctx,
+                                CK_VOID_PTR param, CK_ULONG param_len,
+                                CK_BYTE *in_data, CK_ULONG in_data_len,
+                                CK_BYTE *out_data, CK_ULONG *out_data_len,
+                                CK_FLAGS flags);
+
 CK_RV encr_mgr_reencrypt_single(STDLL_TokData_t *tokdata, SESSION *sess,
                                 ENCR_DECR_CONTEXT *decr_ctx,
                                 CK_MECHANISM *decr_mech,
@@ -1870,6 +1921,29 @@ CK_RV decr_mgr_decrypt_update(STDLL_TokData_t *tokdata,
                               CK_BYTE *in_data, CK_ULONG in_data_len,
                               CK_BYTE *out_data, CK_ULONG *out_data_len);
 
+CK_RV decr_mgr_msg_init(STDLL_TokData_t *tokdata, SESSION *sess,
+                        ENCR_DECR_CONTEXT *ctx, CK_MECHANISM *mech,
+                        CK_OBJECT_HANDLE key_handle, CK_BBOOL checkpolicy);
+
+CK_RV decr_mgr_decrypt_msg(STDLL_TokData_t *tokdata, SESSION *sess,
+                           CK_BBOOL length_only, ENCR_DECR_CONTEXT *ctx,
+                           CK_VOID_PTR param, CK_ULONG param_len,
+                           CK_BYTE *aad, CK_ULONG aad_len,
+                           CK_BYTE *in_data, CK_ULONG in_data_len,
+                           CK_BYTE *out_data, CK_ULONG *out_data_len);
+
+CK_RV decr_mgr_decrypt_msg_begin(STDLL_TokData_t *tokdata, SESSION *sess,
+                                 ENCR_DECR_CONTEXT *ctx,
+                                 CK_VOID_PTR param, CK_ULONG param_len,
+                                 CK_BYTE *aad, CK_ULONG aad_len);
+
+CK_RV decr_mgr_decrypt_msg_next(STDLL_TokData_t *tokdata, SESSION *sess,
+                                CK_BBOOL length_only, ENCR_DECR_CONTEXT *ctx,
+                                CK_VOID_PTR param, CK_ULONG param_len,
+                                CK_BYTE *in_data, CK_ULONG in_data_len,
+                                CK_BYTE *out_data, CK_ULONG *out_data_len,
+                                CK_FLAGS flags);
+
 CK_RV decr_mgr_update_des_ecb(STDLL_TokData_t *tokdata, SESSION *sess,
                               CK_BBOOL length_only, ENCR_DECR_CONTEXT *ctx,
                               CK_BYTE *in_data, CK_ULONG in_data_len,
@@ -1895,6 +1969,9 @@ CK_RV decr_mgr_update_des3_cbc(STDLL_TokData_t *tokdata, SESSION *sess,
 CK_RV digest_mgr_cleanup(STDLL_TokData_t *tokdata, SESSION *sess,
                          DIGEST_CONTEXT *ctx);
 
+void digest_mgr_free_pool(STDLL_TokData_t *tokdata, SESSION *sess,
+                          DIGEST_CONTEXT *ctx);
+
 CK_RV digest_mgr_init(STDLL_TokData_t *tokdata,
                       SESSION *sess,
                       DIGEST_CONTEXT *ctx, CK_MECHANISM *mech,
@@ -1906,6 +1983,12 @@ CK_RV digest_mgr_digest(STDLL_TokData_t *tokdata,
                         CK_BYTE *data, CK_ULONG data_len,
                         CK_BYTE *hash, CK_ULONG *hash_len);
 
+CK_RV digest_mgr_digest_batch(STDLL_TokData_t *tokdata,
+                              SESSION *sess, CK_MECHANISM *mech,
+                              CK_IBM_DATA *data, CK_ULONG count,
+                              CK_BYTE *out_data, CK_ULONG *out_data_len,
+                              CK_BBOOL checkpolicy);
+
 CK_RV digest_mgr_digest_update(STDLL_TokData_t *tokdata,
                                SESSION *sess,
                                DIGEST_CONTEXT *ctx,
@@ -2051,6 +2134,25 @@ CK_RV verify_mgr_verify_final(STDLL_TokData_t *tokdata,
                               SIGN_VERIFY_CONTEXT *ctx,
                               CK_BYTE *signature, CK_ULONG sig_len);
 
+CK_RV verify_mgr_verify_batch(STDLL_TokData_t *tokdata,
+                              SESSION *sess, CK_MECHANISM *mech,
+                              CK_IBM_VERIFY_DATA *items, CK_ULONG count,
+                              CK_RV *results, CK_BBOOL checkpolicy);
+
+
+// asynchronous operation manager routines
+//
+void async_mgr_free_op(void *value);
+
+CK_RV async_mgr_submit(STDLL_TokData_t *tokdata, SESSION *sess,
+                       CK_ULONG operation, CK_MECHANISM *mech,
+                       CK_OBJECT_HANDLE key,
+                       CK_BYTE *in_data, CK_ULONG in_data_len,
+                       CK_BYTE *out_data, CK_ULONG *out_data_len,
+                       int notify_fd, CK_ULONG *handle, CK_BBOOL checkpolicy);
+
+CK_RV async_mgr_wait(STDLL_TokData_t *tokdata, SESSION *sess,
+                     CK_ULONG handle, CK_BBOOL block);
 
 // session manager routines
 //
@@ -2090,20 +2192,35 @@ CK_RV object_mgr_add(STDLL_TokData_t *tokdata,
                      CK_ATTRIBUTE *pTemplate,
                      CK_ULONG ulCount, CK_OBJECT_HANDLE *handle);
 
+CK_RV object_mgr_add_objects(STDLL_TokData_t *tokdata,
+                             SESSION *sess,
+                             CK_IBM_OBJECT_TEMPLATE *pTemplates,
+                             CK_ULONG ulObjectCount,
+                             CK_OBJECT_HANDLE *handles);
+
 CK_RV object_mgr_add_to_map(STDLL_TokData_t *tokdata,
                             SESSION *sess,
                             OBJECT *obj,
                             unsigned long obj_handle,
                             CK_OBJECT_HANDLE *handle);
 
-void object_mgr_add_to_shm(OBJECT *obj, LW_SHM_TYPE *shm);
+void object_mgr_shm_write_begin(LW_SHM_TYPE *shm);
+void object_mgr_shm_write_end(LW_SHM_TYPE *shm);
+size_t object_mgr_shm_size(size_t hdr_len, CK_ULONG capacity);
+CK_RV object_mgr_shm_init(LW_SHM_TYPE *shm, size_t hdr_len, CK_BBOOL created);
+TOK_OBJ_ENTRY *object_mgr_shm_entries(LW_SHM_TYPE *shm, CK_BBOOL priv);
+CK_RV object_mgr_add_to_shm(OBJECT *obj, LW_SHM_TYPE *shm);
 CK_RV object_mgr_del_from_shm(OBJECT *obj, LW_SHM_TYPE *shm);
 CK_RV object_mgr_check_shm(STDLL_TokData_t *tokdata, OBJECT *obj);
-CK_RV object_mgr_search_shm_for_obj(TOK_OBJ_ENTRY *list,
-                                    CK_ULONG lo,
-                                    CK_ULONG hi,
+CK_RV object_mgr_search_shm_for_obj(LW_SHM_TYPE *shm, CK_BBOOL priv,
                                     OBJECT *obj, CK_ULONG *index);
 CK_RV object_mgr_update_from_shm(STDLL_TokData_t *tokdata);
+void object_mgr_index_init(STDLL_TokData_t *tokdata);
+void object_mgr_index_final(STDLL_TokData_t *tokdata);
+void object_mgr_index_add(STDLL_TokData_t *tokdata, struct btree *t,
+                          unsigned long obj_handle, OBJECT *obj);
+void object_mgr_index_remove(STDLL_TokData_t *tokdata, OBJECT *obj);
+void object_mgr_index_update(STDLL_TokData_t *tokdata, OBJECT *obj);
 CK_RV object_mgr_update_publ_tok_obj_from_shm(STDLL_TokData_t *tokdata);
 CK_RV object_mgr_update_priv_tok_obj_from_shm(STDLL_TokData_t *tokdata);
 
@@ -2149,14 +2266,28 @@ CK_RV object_mgr_find_build_list(SESSION *sess,
                                  CK_ULONG ulCount,
                                  DL_NODE *obj_list, CK_BBOOL public_only);
 
+CK_RV object_mgr_find_next(STDLL_TokData_t *tokdata, SESSION *sess,
+                           CK_OBJECT_HANDLE *phObject,
+                           CK_ULONG ulMaxObjectCount,
+                           CK_ULONG *pulObjectCount);
+
 CK_RV object_mgr_find_final(SESSION *sess);
 
+void object_mgr_find_free(SESSION *sess);
+
 CK_RV object_mgr_get_attribute_values(STDLL_TokData_t *tokdata,
                                       SESSION *sess,
                                       CK_OBJECT_HANDLE handle,
                                       CK_ATTRIBUTE *pTemplate,
                                       CK_ULONG ulCount);
 
+CK_RV object_mgr_get_attribute_values_multi(STDLL_TokData_t *tokdata,
+                                            SESSION *sess,
+                                            CK_OBJECT_HANDLE *phObjects,
+                                            CK_ULONG ulObjectCount,
+                                            CK_IBM_OBJECT_TEMPLATE *pTemplates,
+                                            CK_RV *pReturnValues);
+
 CK_RV object_mgr_get_object_size(STDLL_TokData_t *tokdata,
                                  CK_OBJECT_HANDLE handle, CK_ULONG *size);
 
@@ -2175,6 +2306,11 @@ CK_RV object_mgr_restore_obj_withSize(STDLL_TokData_t *tokdata,
                                       int data_size,
                                       const char *fname);
 
+CK_RV object_mgr_add_restored_obj(STDLL_TokData_t *tokdata, OBJECT *obj);
+
+CK_RV object_mgr_add_lazy_obj(STDLL_TokData_t *tokdata, const char *name,
+                              CK_BBOOL priv);
+
 CK_RV object_mgr_save_token_object(STDLL_TokData_t *tokdata, OBJECT *obj);
 
 CK_RV object_mgr_set_attribute_values(STDLL_TokData_t *tokdata,
@@ -2191,17 +2327,6 @@ CK_RV object_put(STDLL_TokData_t *tokdata, OBJECT *obj, CK_BBOOL unlock);
 
 /* structures used to hold arguments to callback functions triggered by either
  * bt_for_each_node or bt_node_free */
-struct find_args {
-    int done;
-    OBJECT *obj;
-    CK_OBJECT_HANDLE map_handle;
-};
-
-struct find_by_name_args {
-    int done;
-    char *name;
-};
-
 struct find_build_list_args {
     CK_ATTRIBUTE *pTemplate;
     SESSION *sess;
@@ -2216,10 +2341,19 @@ struct purge_args {
     SESS_OBJ_TYPE type;
 };
 
+struct update_tok_obj_name {
+    char name[8];
+    CK_ULONG order;
+    CK_BYTE op;                 // TOK_OBJ_CHANGE_ADD or _DEL
+    CK_BBOOL found;             // object is in the local btree
+};
+
 struct update_tok_obj_args {
-    TOK_OBJ_ENTRY *entries;
-    CK_ULONG_32 *num_entries;
+    CK_BBOOL priv;
+    CK_BBOOL full;              // full resync instead of applying changes
     struct btree *t;
+    struct update_tok_obj_name *names;  // sorted by name
+    CK_ULONG num_names;
 };
 
 
@@ -2270,6 +2404,9 @@ CK_BBOOL object_is_attr_bound(OBJECT *obj);
 
 CK_RV object_init_lock(OBJECT *obj);
 CK_RV object_destroy_lock(OBJECT *obj);
+OBJ_EX_DATA *object_ex_data_get(OBJECT *obj, size_t size,
+                                void (*free_func)(OBJ_EX_DATA *ex_data));
+void object_ex_data_free(OBJECT *obj);
 CK_RV object_lock(OBJECT *obj, OBJ_LOCK_TYPE type);
 CK_RV object_unlock(OBJECT *obj);
 
@@ -2993,6 +3130,22 @@ CK_RV openssl_specific_aes_gcm_update(STDLL_TokData_t *tokdata, SESSION *sess,
 CK_RV openssl_specific_aes_gcm_final(STDLL_TokData_t *tokdata, SESSION *sess,
                                      ENCR_DECR_CONTEXT *ctx, CK_BYTE *out_data,
                                      CK_ULONG *out_data_len, CK_BYTE encrypt);
+CK_RV openssl_specific_aes_gcm_msg_init(STDLL_TokData_t *tokdata,
+                                        SESSION *sess, ENCR_DECR_CONTEXT *ctx,
+                                        CK_MECHANISM *mech,
+                                        CK_OBJECT_HANDLE hkey, CK_BYTE encrypt);
+CK_RV openssl_specific_aes_gcm_msg_begin(STDLL_TokData_t *tokdata,
+                                         SESSION *sess, ENCR_DECR_CONTEXT *ctx,
+                                         CK_GCM_MESSAGE_PARAMS *param,
+                                         CK_BYTE *aad, CK_ULONG aad_len,
+                                         CK_BYTE encrypt);
+CK_RV openssl_specific_aes_gcm_msg_next(STDLL_TokData_t *tokdata,
+                                        SESSION *sess, ENCR_DECR_CONTEXT *ctx,
+                                        CK_GCM_MESSAGE_PARAMS *param,
+                                        CK_BYTE *in_data, CK_ULONG in_data_len,
+                                        CK_BYTE *out_data,
+                                        CK_ULONG *out_data_len,
+                                        CK_FLAGS flags, CK_BYTE encrypt);
 CK_RV openssl_specific_aes_mac(STDLL_TokData_t *tokdata, CK_BYTE *message,
                                CK_ULONG message_len, OBJECT *key, CK_BYTE *mac);
 CK_RV openssl_specific_aes_cmac(STDLL_TokData_t *tokdata, CK_BYTE *message,
@@ -0,0 +1,383 @@
+/*
+ * COPYRIGHT (c) International Business Machines Corp. 2024
+ *
+ * This program is provided under the terms of the Common Public License,
+ * version 1.0 (CPL-1.0). Any use, reproduction or distribution for this
+ * software constitutes recipient's acceptance of CPL-1.0 terms which can be
+ * found in the file LICENSE file or at
+ * https://opensource.org/licenses/cpl1.0.php
+ */
+
+/*
+ * handle_table.c
+ *
+ * Flat handle table with lock-free lookups, used for session handles.
+ *
+ * Each entry has a state word with the following layout:
+ *
+ *   | generation | live flag | pin count |
+ *                  HT_LIVE     HT_PIN_MASK
+ *
+ * A reader pins a live entry of the right generation by incrementing the
+ * pin count with a compare-and-swap, takes a reference on the value, and
+ * unpins the entry again. A writer removing an entry clears the live flag
+ * (so that no new pins can be taken), waits for the (very short lived)
+ * pins to drain, and only then drops the table's reference to the value.
+ * Thus a value is never freed while a reader is about to reference it, and
+ * readers never block each other or wait for a writer.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <sched.h>
+
+#include "pkcs11types.h"
+#include "local_types.h"
+#include "trace.h"
+
+#define HT_PIN_BITS         16
+#define HT_PIN_MASK         ((1UL << HT_PIN_BITS) - 1)
+#define HT_LIVE             (1UL << HT_PIN_BITS)
+#define HT_GEN_SHIFT        (HT_PIN_BITS + 1)
+#define HT_GEN_MASK         (~0UL >> HT_INDEX_BITS)
+
+#define HT_STATE_GEN(s)     ((s) >> HT_GEN_SHIFT)
+#define HT_HANDLE_GEN(h)    ((h) >> HT_INDEX_BITS)
+#define HT_MAKE_HANDLE(gen, idx) \
+    (((gen) << HT_INDEX_BITS) | ((idx) + 1))
+
+static struct ht_entry *ht_entry(struct handle_table *t, unsigned long idx)
+{
+    struct ht_entry *chunk;
+
+    if (idx >= __atomic_load_n(&t->size, __ATOMIC_ACQUIRE))
+        return NULL;
+
+    chunk = __atomic_load_n(&t->dir[idx >> HT_CHUNK_BITS], __ATOMIC_ACQUIRE);
+    if (chunk == NULL)
+        return NULL;
+
+    return &chunk[idx & (HT_CHUNK_SIZE - 1)];
+}
+
+/*
+ * Get the value of the specified handle. Returns NULL if the handle is not
+ * valid (anymore). Increases the value's reference counter to prevent it from
+ * being freed while in use. The caller needs to call ht_put_value() to
+ * decrease the reference counter when the value is no longer used.
+ */
+void *ht_get_value(struct handle_table *t, unsigned long handle)
+{
+    struct ht_entry *e;
+    unsigned long state;
+    void *v;
+
+    if ((handle & HT_INDEX_MASK) == 0)
+        return NULL;
+
+    e = ht_entry(t, (handle & HT_INDEX_MASK) - 1);
+    if (e == NULL)
+        return NULL;
+
+    state = __atomic_load_n(&e->state, __ATOMIC_ACQUIRE);
+    do {
+        if ((state & HT_LIVE) == 0 ||
+            HT_STATE_GEN(state) != HT_HANDLE_GEN(handle))
+            return NULL;
+        if ((state & HT_PIN_MASK) == HT_PIN_MASK) {
+            /* Pin count saturated, wait for some readers to leave */
+            sched_yield();
+            state = __atomic_load_n(&e->state, __ATOMIC_ACQUIRE);
+            continue;
+        }
+    } while (!__atomic_compare_exchange_n(&e->state, &state, state + 1,
+                                          0, __ATOMIC_ACQ_REL,
+                                          __ATOMIC_ACQUIRE));
+
+    /* The entry is pinned, its value can not be dropped concurrently */
+    v = e->value;
+    __atomic_add_fetch(&((struct bt_ref_hdr *)v)->ref, 1, __ATOMIC_ACQ_REL);
+
+    __atomic_sub_fetch(&e->state, 1, __ATOMIC_RELEASE);
+
+    TRACE_DEBUG("ht_get_value: Table: %p Value: %p Ref: %lu\n",
+                (void *)t, v, ((struct bt_ref_hdr *)v)->ref);
+
+    return v;
+}
+
+/*
+ * Decrease the value's reference counter.
+ * If the reference counter reaches zero, then the table's delete callback
+ * function is called to delete the value.
+ * Returns 1 if the value has been deleted, 0 otherwise.
+ */
+int ht_put_value(struct handle_table *t, void *value)
+{
+    struct bt_ref_hdr *hdr = value;
+    unsigned long ref;
+
+    if (value == NULL)
+        return 0;
+
+    ref = __atomic_load_n(&hdr->ref, __ATOMIC_ACQUIRE);
+    do {
+        if (ref == 0) {
+            TRACE_WARNING("ht_put_value: Table: %p Value %p Ref already 0.\n",
+                          (void *)t, value);
+            return 0;
+        }
+    } while (!__atomic_compare_exchange_n(&hdr->ref, &ref, ref - 1, 0,
+                                          __ATOMIC_ACQ_REL,
+                                          __ATOMIC_ACQUIRE));
+
+    TRACE_DEBUG("ht_put_value: Table: %p Value: %p Ref: %lu\n",
+                (void *)t, value, ref - 1);
+
+    if (ref == 1 && t->delete_func) {
+        TRACE_DEBUG("delete_func: Table: %p Value: %p\n", (void *)t, value);
+
+        t->delete_func(value);
+        return 1;
+    }
+
+    return 0;
+}
+
+/*
+ * Return the handle of the newly added value, or 0 for failure.
+ * Value must start with struct bt_ref_hdr to maintain the reference counter.
+ * The reference counter is initialized to 1.
+ */
+unsigned long ht_add(struct handle_table *t, void *value)
+{
+    struct ht_entry *e, *chunk;
+    unsigned long idx, state, handle;
+
+    ((struct bt_ref_hdr *)value)->ref = 1;
+
+    if (pthread_mutex_lock(&t->mutex)) {
+        TRACE_ERROR("Handle table Lock failed.\n");
+        return 0;
+    }
+
+    if (t->free_list != 0) {
+        idx = t->free_list - 1;
+        e = ht_entry(t, idx);
+        t->free_list = e->next_free;
+    } else {
+        idx = t->size;
+        if (idx >= HT_MAX_ENTRIES) {
+            TRACE_ERROR("Handle table %p is full.\n", (void *)t);
+            handle = 0;
+            goto out;
+        }
+
+        chunk = t->dir[idx >> HT_CHUNK_BITS];
+        if (chunk == NULL) {
+            chunk = calloc(HT_CHUNK_SIZE, sizeof(struct ht_entry));
+            if (chunk == NULL) {
+                TRACE_ERROR("%s\n", ock_err(ERR_HOST_MEMORY));
+                handle = 0;
+                goto out;
+            }
+            __atomic_store_n(&t->dir[idx >> HT_CHUNK_BITS], chunk,
+                             __ATOMIC_RELEASE);
+        }
+        e = &chunk[idx & (HT_CHUNK_SIZE - 1)];
+        /* Publish the new entry, it is not live yet */
+        __atomic_store_n(&t->size, idx + 1, __ATOMIC_RELEASE);
+    }
+
+    e->next_free = 0;
+    e->value = value;
+
+    state = __atomic_load_n(&e->state, __ATOMIC_ACQUIRE);
+    __atomic_store_n(&e->state, state | HT_LIVE, __ATOMIC_RELEASE);
+    __atomic_add_fetch(&t->in_use, 1, __ATOMIC_RELEASE);
+
+    handle = HT_MAKE_HANDLE(HT_STATE_GEN(state), idx);
+
+    TRACE_DEBUG("ht_add: Table: %p Value: %p Handle: 0x%lx\n", (void *)t,
+                value, handle);
+
+out:
+    pthread_mutex_unlock(&t->mutex);
+
+    return handle;
+}
+
+/*
+ * ht_remove
+ *
+ * Remove the entry of @handle from table @t, and, if @put_value is set,
+ * decrease the value's reference counter. If the reference counter reaches
+ * zero, the table's delete callback is called on the value.
+ * Return the removed value. Note that if the callback routine frees
+ * the value, then the returned value might have already been freed. You still
+ * can use it as indication that the handle was found and removed.
+ */
+void *ht_remove(struct handle_table *t, unsigned long handle, int put_value)
+{
+    struct ht_entry *e;
+    unsigned long state, gen;
+    void *value = NULL;
+
+    if ((handle & HT_INDEX_MASK) == 0)
+        return NULL;
+
+    if (pthread_mutex_lock(&t->mutex)) {
+        TRACE_ERROR("Handle table Lock failed.\n");
+        return NULL;
+    }
+
+    e = ht_entry(t, (handle & HT_INDEX_MASK) - 1);
+    if (e == NULL)
+        goto out;
+
+    /* Clear the live flag, so that no new readers can pin the entry */
+    state = __atomic_load_n(&e->state, __ATOMIC_ACQUIRE);
+    do {
+        if ((state & HT_LIVE) == 0 ||
+            HT_STATE_GEN(state) != HT_HANDLE_GEN(handle))
+            goto out;
+    } while (!__atomic_compare_exchange_n(&e->state, &state, state & ~HT_LIVE,
+                                          0, __ATOMIC_ACQ_REL,
+                                          __ATOMIC_ACQUIRE));
+
+    /* Wait for the readers that pinned the entry before */
+    while (__atomic_load_n(&e->state, __ATOMIC_ACQUIRE) & HT_PIN_MASK)
+        sched_yield();
+
+    value = e->value;
+    e->value = NULL;
+
+    /* Bump the generation to invalidate the handle, and free the entry */
+    gen = (HT_STATE_GEN(state) + 1) & HT_GEN_MASK;
+    __atomic_store_n(&e->state, gen << HT_GEN_SHIFT, __ATOMIC_RELEASE);
+    e->next_free = t->free_list;
+    t->free_list = (handle & HT_INDEX_MASK);
+    __atomic_sub_fetch(&t->in_use, 1, __ATOMIC_RELEASE);
+
+    TRACE_DEBUG("ht_remove: Table: %p Value: %p Handle: 0x%lx\n", (void *)t,
+                value, handle);
+
+out:
+    pthread_mutex_unlock(&t->mutex);
+
+    if (value && put_value)
+        ht_put_value(t, value);
+
+    return value;
+}
+
+/* ht_is_empty
+ *
+ * return 0 if the table has at least 1 entry in use, !0 otherwise
+ */
+int ht_is_empty(struct handle_table *t)
+{
+    return __atomic_load_n(&t->in_use, __ATOMIC_ACQUIRE) == 0;
+}
+
+/* ht_in_use
+ *
+ * return the number of entries in the table that are in use
+ */
+unsigned long ht_in_use(struct handle_table *t)
+{
+    return __atomic_load_n(&t->in_use, __ATOMIC_ACQUIRE);
+}
+
+/* ht_for_each
+ *
+ * For each entry in use in the table, run @func on it
+ *
+ * @func:
+ *  p1 is the entry's value
+ *  p2 is the entry's handle
+ *  p3 is passed through this function for the caller
+ */
+void ht_for_each(STDLL_TokData_t *tokdata, struct handle_table *t,
+                 void (*func)(STDLL_TokData_t *tokdata, void *p1,
+                              unsigned long p2, void *p3), void *p3)
+{
+    struct ht_entry *e;
+    unsigned long idx, state, handle;
+    void *value;
+
+    for (idx = 0; idx < __atomic_load_n(&t->size, __ATOMIC_ACQUIRE); idx++) {
+        e = ht_entry(t, idx);
+        if (e == NULL)
+            continue;
+
+        state = __atomic_load_n(&e->state, __ATOMIC_ACQUIRE);
+        if ((state & HT_LIVE) == 0)
+            continue;
+
+        handle = HT_MAKE_HANDLE(HT_STATE_GEN(state), idx);
+        value = ht_get_value(t, handle);
+        if (value) {
+            (*func) (tokdata, value, handle, p3);
+
+            ht_put_value(t, value);
+            value = NULL;
+        }
+    }
+}
+
+/* ht_destroy
+ *
+ * Call the table's delete callback on all values still in use, and free
+ * the table's entries.
+ * It is assumed that ht_destroy is called during final cleanup, and thus is
+ * not used concurrently with any other function on the same table.
+ */
+void ht_destroy(struct handle_table *t)
+{
+    struct ht_entry *e;
+    unsigned long idx;
+
+    for (idx = 0; idx < t->size; idx++) {
+        e = ht_entry(t, idx);
+        if (e == NULL || (e->state & HT_LIVE) == 0)
+            continue;
+
+        if (t->delete_func) {
+            TRACE_DEBUG("ht_destroy: Table: %p Value: %p Ref: %lu\n",
+                        (void *)t, e->value,
+                        ((struct bt_ref_hdr *)e->value)->ref);
+
+            t->delete_func(e->value);
+        }
+    }
+
+    for (idx = 0; idx < HT_DIR_SIZE; idx++) {
+        free(t->dir[idx]);
+        t->dir[idx] = NULL;
+    }
+
+    t->size = 0;
+    t->in_use = 0;
+    t->free_list = 0;
+    t->delete_func = NULL;
+    pthread_mutex_destroy(&t->mutex);
+}
+
+/* ht_init
+ *
+ * Initialize a handle table with a delete callback function that is used to
+ * delete values during ht_remove() and ht_destroy().
+ */
+void ht_init(struct handle_table *t, void (*delete_func)(void *))
+{
+    unsigned long idx;
+
+    for (idx = 0; idx < HT_DIR_SIZE; idx++)
+        t->dir[idx] = NULL;
+    t->size = 0;
+    t->in_use = 0;
+    t->free_list = 0;
+    pthread_mutex_init(&t->mutex, NULL);
+    t->delete_func = delete_func;
+}
@@ -20,11 +20,17 @@
 #include <pthread.h>
 
 #include "local_types.h"
+#include "defs.h"
 #include "../api/policy.h"
 #include "../api/mechtable.h"
 #include "../api/statistics.h"
 
+#if OPENSSL_VERSION_PREREQ(3, 0)
+    #include <openssl/crypto.h>
+#endif
+
 struct _SESSION;
+struct hashmap;
 
 typedef void (*context_free_func_t)(STDLL_TokData_t *tokdata, struct _SESSION *sess,
                                     CK_BYTE *context, CK_ULONG context_len);
@@ -56,6 +62,9 @@ typedef struct _DIGEST_CONTEXT {
                                 // on first call *after* init
     CK_BBOOL state_unsaveable;
     CK_BBOOL count_statistics;
+    CK_BYTE *pool_context;      // context of a finished operation that the
+                                // token may reuse for the next one
+    context_free_func_t pool_context_free_func;
 } DIGEST_CONTEXT;
 
 typedef struct _SIGN_VERIFY_CONTEXT {
@@ -86,12 +95,15 @@ typedef struct _SESSION {
     CK_ULONG_32 find_len;       // max # of handles in the list
     CK_ULONG_32 find_idx;       // current position
     CK_BBOOL find_active;
+    void *find_cursor;          // state of the active search, see obj_mgr.c
 
     ENCR_DECR_CONTEXT encr_ctx;
     ENCR_DECR_CONTEXT decr_ctx;
     DIGEST_CONTEXT digest_ctx;
     SIGN_VERIFY_CONTEXT sign_ctx;
     SIGN_VERIFY_CONTEXT verify_ctx;
+    ENCR_DECR_CONTEXT msg_encr_ctx;     // C_MessageEncryptInit
+    ENCR_DECR_CONTEXT msg_decr_ctx;     // C_MessageDecryptInit
 
     void *private_data;
 } SESSION;
@@ -138,6 +150,19 @@ typedef struct _AES_GCM_CONTEXT {
     CK_ULONG ulClen;
 } AES_GCM_CONTEXT;
 
+/* Context of a message based AES-GCM operation. It lives from
+ * C_MessageEncryptInit/C_MessageDecryptInit until the matching Final call,
+ * so the token specific part holds the per-key state that all messages
+ * share. */
+typedef struct _AES_GCM_MSG_CONTEXT {
+    CK_BBOOL in_message;        // Begin called, END_OF_MESSAGE not yet seen
+    CK_ULONG tag_len;           // tag length of the current message
+    CK_ULONG iv_counter;        // CKG_GENERATE_COUNTER: messages so far
+    CK_BYTE iv_base[sizeof(CK_ULONG)]; // CKG_GENERATE_COUNTER_XOR: trailing
+    CK_ULONG iv_base_len;              // IV bytes of the first message
+    CK_VOID_PTR token_data;     // token specific, keyed cipher state
+} AES_GCM_MSG_CONTEXT;
+
 typedef struct _SHA1_CONTEXT {
     unsigned int buf[16];
     unsigned int hash_value[5];
@@ -185,11 +210,27 @@ typedef pthread_mutex_t MUTEX;
 
 // This is actualy wrong... XPROC will be with spinlocks
 
+// The attributes of a template are kept in an array sorted by attribute
+// type. Each attribute is allocated as one block with its value following
+// the CK_ATTRIBUTE structure, so pointers to an attribute stay valid until
+// that attribute is replaced or the template is freed.
+//
 typedef struct _TEMPLATE {
-    DL_NODE *attribute_list;
+    CK_ATTRIBUTE **attrs;       // attributes, sorted by type
+    CK_ULONG count;             // # attributes in the array
+    CK_ULONG alloc;             // # attributes allocated
 } TEMPLATE;
 
 
+// number of attributes in the object attribute index (see obj_mgr.c)
+#define OBJ_INDEX_NUM_ATTRS  4
+
+// token specific data cached with an object, e.g. a prepared crypto key.
+// The token embeds this as first member of its own structure.
+typedef struct _OBJ_EX_DATA {
+    void (*free_func)(struct _OBJ_EX_DATA *ex_data);
+} OBJ_EX_DATA;
+
 typedef struct _OBJECT {
     struct bt_ref_hdr hdr;
     CK_OBJECT_CLASS class;
@@ -202,11 +243,29 @@ typedef struct _OBJECT {
     CK_ULONG count_lo;          // only significant for token objects
     CK_ULONG index;             // SAB  Index into the SHM
     CK_OBJECT_HANDLE map_handle;
+    CK_BBOOL lazy;              // token object not loaded from disk yet
 
     // policy support (set via store_object_strength_f pointer)
     struct objstrength strength;
+
+    // attribute index support, protected by the token's obj_index_mutex
+    struct btree *index_tree;   // btree the object is indexed in, or NULL
+    unsigned long index_handle; // handle of the object in index_tree
+    CK_ULONG index_mask;        // bit set for each attribute indexed
+    CK_ULONG index_keys[OBJ_INDEX_NUM_ATTRS];
+    CK_ULONG index_pos[OBJ_INDEX_NUM_ATTRS];
+
+    // cached token specific data, built under the object's read lock and
+    // dropped whenever the template changes (under the write lock)
+    OBJ_EX_DATA *ex_data;
 } OBJECT;
 
+typedef struct _OBJ_INDEX_ENTRY {
+    struct btree *t;
+    unsigned long obj_handle;
+    OBJECT *obj;
+} OBJ_INDEX_ENTRY;
+
 
 typedef struct _OBJECT_MAP {
     struct bt_ref_hdr hdr;
@@ -348,14 +407,36 @@ typedef struct _TOK_OBJ_ENTRY {
     CK_ULONG_32 count_hi;
 } TOK_OBJ_ENTRY;
 
+typedef struct _TOK_OBJ_CHANGE {
+    CK_ULONG_32 seq;
+    CK_BYTE op;                     // TOK_OBJ_CHANGE_ADD or _DEL
+    CK_BBOOL priv;
+    char name[8];
+} TOK_OBJ_CHANGE;
+
 struct _LW_SHM_TYPE {
     TOKEN_DATA nv_token_data;
     CK_ULONG_32 num_priv_tok_obj;
     CK_ULONG_32 num_publ_tok_obj;
     CK_BBOOL priv_loaded;
     CK_BBOOL publ_loaded;
-    TOK_OBJ_ENTRY publ_tok_objs[MAX_TOK_OBJS];
-    TOK_OBJ_ENTRY priv_tok_objs[MAX_TOK_OBJS];
+    // sequence counter of the token object lists, odd while a writer (holding
+    // the XProcLock) modifies them. See object_mgr_shm_write_begin/end().
+    CK_ULONG_32 tok_obj_seq;
+    CK_ULONG_32 version;            // LW_SHM_VERSION
+    // The public and private token object lists are hash tables of
+    // tok_obj_capacity entries each, stored back to back tok_obj_offset
+    // bytes after the start of this structure.
+    // See object_mgr_shm_entries().
+    CK_ULONG_32 tok_obj_offset;
+    CK_ULONG_32 tok_obj_capacity;
+    CK_ULONG_32 num_priv_tok_obj_slots; // used slots incl. deleted ones
+    CK_ULONG_32 num_publ_tok_obj_slots; // used slots incl. deleted ones
+    // Ring of the latest additions to and deletions from the token object
+    // lists, tok_obj_change_seq is the sequence number of the last one.
+    // See object_mgr_shm_log_change().
+    CK_ULONG_32 tok_obj_change_seq;
+    TOK_OBJ_CHANGE tok_obj_changes[TOK_OBJ_CHANGE_LOG_SIZE];
 };
 
 struct _STDLL_TokData_t {
@@ -379,10 +460,20 @@ struct _STDLL_TokData_t {
     TOKEN_DATA *nv_token_data;
     void *private_data;
     uint32_t version; /* major<<16|minor */
+    uint32_t objstore; /* OBJSTORE_FILES or OBJSTORE_MMAP */
+    struct objdb *objdb; /* single file object store, if objstore is mmap */
+    uint32_t objload; /* OBJLOAD_EAGER or OBJLOAD_LAZY */
+    uint32_t pbkdf2_it; /* PBKDF2 iterations for new PINs, 0 = default */
+    uint32_t login_cache_ttl; /* seconds, 0 = no login key cache */
+    struct obj_key_cache *obj_key_cache; /* unwrapped object keys */
+    struct obj_writeback *obj_writeback; /* deferred token object writes */
+    struct obj_sync *obj_sync; /* grouped token object directory syncs */
+    struct worker_pool *workers; /* threads for batched operations */
     unsigned char so_wrap_key[32];
     unsigned char user_wrap_key[32];
     pthread_mutex_t login_mutex;
-    struct btree sess_btree;
+    struct handle_table sess_table;
+    struct handle_table async_table; /* pending C_IBM_*Async operations */
 #ifdef ENABLE_LOCKS
     pthread_rwlock_t sess_list_rwlock;
 #endif
@@ -390,12 +481,24 @@ struct _STDLL_TokData_t {
     struct btree sess_obj_btree;
     struct btree publ_token_obj_btree;
     struct btree priv_token_obj_btree;
+    struct hashmap *obj_index;  // attribute index of all objects
+    pthread_mutex_t obj_index_mutex;
+    CK_BBOOL obj_index_valid;   // FALSE if the index is incomplete
+    // last change of the SHM token object lists applied to the local btrees,
+    // only valid while the corresponding *_synced flag is set
+    CK_ULONG_32 publ_tok_obj_change_seq;
+    CK_ULONG_32 priv_tok_obj_change_seq;
+    CK_BBOOL publ_tok_obj_synced;
+    CK_BBOOL priv_tok_obj_synced;
     MECH_LIST_ELEMENT *mech_list;
     CK_ULONG mech_list_len;
     struct policy *policy;
     const struct mechtable_funcs *mechtable_funcs;
     struct statistics *statistics;
     struct tokstore_strength store_strength;
+#if OPENSSL_VERSION_PREREQ(3, 0)
+    OSSL_LIB_CTX *openssl_libctx; /* library context of the API layer */
+#endif
 };
 
 #endif
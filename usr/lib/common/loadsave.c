@@ -25,11 +25,13 @@
 #include <sys/stat.h>
 #include <sys/ipc.h>
 #include <sys/file.h>
+#include <fcntl.h>
 #include <errno.h>
 #include <syslog.h>
 #include <pwd.h>
 #include <grp.h>
 #include <openssl/evp.h>
+#include <openssl/crypto.h>
 #include <endian.h>
 
 #include "pkcs11types.h"
@@ -42,6 +44,8 @@
 #include "trace.h"
 #include "ock_syslog.h"
 #include "slotmgr.h" // for ock_snprintf
+#include "objdb.h"
+#include "worker_pool.h"
 
 extern void set_perm(int);
 
@@ -150,54 +154,831 @@ error:
 }
 
 //
+// Returns the token's single file object store in *db, or NULL if the token
+// keeps one file per object (objstore = files). The store is opened on first
+// use.
 // Note: The token lock (XProcLock) must be held when calling this function.
-// The object must hold the READ lock when this function is called.
 //
-CK_RV save_token_object(STDLL_TokData_t *tokdata, OBJECT *obj)
+static CK_RV get_token_objdb(STDLL_TokData_t *tokdata, struct objdb **db)
 {
-    FILE *fp = NULL;
-    char line[256];
     char fname[PATH_MAX];
     CK_RV rc;
 
-    // write token object
-    if (object_is_private(obj) == TRUE)
-        rc = save_private_token_object(tokdata, obj);
-    else
-        rc = save_public_token_object(tokdata, obj);
-    if (rc != CKR_OK)
+    *db = tokdata->objdb;
+    if (*db != NULL || tokdata->objstore != OBJSTORE_MMAP ||
+        tokdata->version < TOK_NEW_DATA_STORE)
+        return CKR_OK;
+
+    if (get_token_object_path(fname, sizeof(fname), tokdata,
+                              PK_LITE_OBJ_DB) < 0)
+        return CKR_FUNCTION_FAILED;
+
+    *db = calloc(1, sizeof(**db));
+    if (*db == NULL) {
+        TRACE_ERROR("%s\n", ock_err(ERR_HOST_MEMORY));
+        return CKR_HOST_MEMORY;
+    }
+
+    rc = objdb_open(*db, fname);
+    if (rc != CKR_OK) {
+        OCK_SYSLOG(LOG_ERR, "Cannot open token object store %s", fname);
+        free(*db);
+        *db = NULL;
         return rc;
+    }
+
+    set_perm((*db)->fd);
+    tokdata->objdb = *db;
+
+    return CKR_OK;
+}
+
+/*
+ * Cache of the unwrapped object keys of private token objects.
+ *
+ * Every private token object (tokversion >= 3.12) is sealed with an object
+ * key of its own, which is stored in the object's header, wrapped with the
+ * master key. The cache maps wrapped object keys to their unwrapped value,
+ * so that saving or reloading an object does not need an AES key unwrap
+ * every time. Since the lookup is by the wrapped key, an entry is only ever
+ * found for the master key it was wrapped with. The IV is not cached, it is
+ * always taken from the object's current header.
+ *
+ * The cache is direct mapped and thus bounded in size. It is wiped when the
+ * master key is loaded and when the private token objects are purged, i.e.
+ * at logout.
+ */
+#define OBJ_KEY_CACHE_SIZE      1024
+
+struct obj_key_cache_entry {
+    CK_BBOOL valid;
+    unsigned char key_wrapped[40];
+    unsigned char key[32];
+};
+
+struct obj_key_cache {
+    pthread_mutex_t mutex;      // the loader's workers use it in parallel
+    struct obj_key_cache_entry entries[OBJ_KEY_CACHE_SIZE];
+};
+
+//
+// Creates the object key cache, if not done yet. Object keys are just not
+// cached if this fails.
+// Note: The token lock (XProcLock) must be held when calling this function.
+//
+static void init_object_key_cache(STDLL_TokData_t *tokdata)
+{
+    struct obj_key_cache *cache;
+
+    if (tokdata->obj_key_cache != NULL)
+        return;
+
+    cache = calloc(1, sizeof(*cache));
+    if (cache == NULL)
+        return;
+
+    if (pthread_mutex_init(&cache->mutex, NULL) != 0) {
+        free(cache);
+        return;
+    }
+
+    tokdata->obj_key_cache = cache;
+}
+
+static struct obj_key_cache_entry *
+        object_key_cache_entry(struct obj_key_cache *cache,
+                               const unsigned char key_wrapped[40])
+{
+    uint32_t hash;
+
+    /* the wrapped key is random, so are any 4 bytes of it */
+    memcpy(&hash, key_wrapped + 8, sizeof(hash));
+
+    return &cache->entries[hash % OBJ_KEY_CACHE_SIZE];
+}
+
+static CK_BBOOL get_cached_object_key(STDLL_TokData_t *tokdata,
+                                      const unsigned char key_wrapped[40],
+                                      unsigned char key[32])
+{
+    struct obj_key_cache *cache = tokdata->obj_key_cache;
+    struct obj_key_cache_entry *entry;
+    CK_BBOOL found = FALSE;
+
+    if (cache == NULL || pthread_mutex_lock(&cache->mutex) != 0)
+        return FALSE;
+
+    entry = object_key_cache_entry(cache, key_wrapped);
+    if (entry->valid && memcmp(entry->key_wrapped, key_wrapped, 40) == 0) {
+        memcpy(key, entry->key, 32);
+        found = TRUE;
+    }
+
+    pthread_mutex_unlock(&cache->mutex);
+    return found;
+}
+
+static void put_cached_object_key(STDLL_TokData_t *tokdata,
+                                  const unsigned char key_wrapped[40],
+                                  const unsigned char key[32])
+{
+    struct obj_key_cache *cache = tokdata->obj_key_cache;
+    struct obj_key_cache_entry *entry;
+
+    if (cache == NULL || pthread_mutex_lock(&cache->mutex) != 0)
+        return;
+
+    entry = object_key_cache_entry(cache, key_wrapped);
+    memcpy(entry->key_wrapped, key_wrapped, 40);
+    memcpy(entry->key, key, 32);
+    entry->valid = TRUE;
+
+    pthread_mutex_unlock(&cache->mutex);
+}
+
+//
+// Wipes all cached object keys.
+//
+void clear_object_key_cache(STDLL_TokData_t *tokdata)
+{
+    struct obj_key_cache *cache = tokdata->obj_key_cache;
+
+    if (cache == NULL || pthread_mutex_lock(&cache->mutex) != 0)
+        return;
+
+    OPENSSL_cleanse(cache->entries, sizeof(cache->entries));
+
+    pthread_mutex_unlock(&cache->mutex);
+}
+
+static void free_object_key_cache(STDLL_TokData_t *tokdata)
+{
+    struct obj_key_cache *cache = tokdata->obj_key_cache;
+
+    if (cache == NULL)
+        return;
+
+    OPENSSL_cleanse(cache->entries, sizeof(cache->entries));
+    pthread_mutex_destroy(&cache->mutex);
+    free(cache);
+    tokdata->obj_key_cache = NULL;
+}
+
+/*
+ * Deferred token object writes.
+ *
+ * Callers that save several token objects in a row can bracket the saves
+ * with begin_token_object_writeback() and end_token_object_writeback(),
+ * while holding the token lock (XProcLock) for the whole time. The object
+ * records are then kept in memory and written out together when the
+ * outermost bracket ends:
+ *  - With one file per object, each record is written to a temporary file
+ *    that is then renamed over the object file. The temporary files are
+ *    synced before they are renamed, in groups of files that are all
+ *    written before the first one is synced, so that the kernel can write
+ *    them back together. The new objects are added to OBJ.IDX with a single
+ *    append, and the TOK_OBJ directory is synced once (see below).
+ *  - With the single file object store, the records are appended to OBJ.DB,
+ *    which is then synced once.
+ * So either all objects of a batch are stored, or, if the process dies in
+ * between, any of them is stored either in its previous or its new version.
+ */
+// Number of temporary files that are kept open to be synced together
+#define WRITEBACK_SYNC_FILES    64
+
+struct obj_writeback_rec {
+    CK_BYTE name[8];
+    CK_BYTE *data;
+    CK_ULONG len;
+};
+
+struct obj_writeback {
+    unsigned int nesting;
+    CK_ULONG num_recs;
+    CK_ULONG max_recs;
+    struct obj_writeback_rec *recs;
+};
+
+static inline CK_BBOOL token_object_writeback_active(STDLL_TokData_t *tokdata)
+{
+    return tokdata->obj_writeback != NULL &&
+           tokdata->obj_writeback->nesting > 0;
+}
+
+static struct obj_writeback_rec *
+        find_token_object_writeback(struct obj_writeback *wb,
+                                    const CK_BYTE *name)
+{
+    CK_ULONG i;
+
+    for (i = 0; i < wb->num_recs; i++) {
+        if (memcmp(wb->recs[i].name, name, 8) == 0)
+            return &wb->recs[i];
+    }
+
+    return NULL;
+}
+
+//
+// Queues a token object record for writing, replacing an already queued
+// record of the same object.
+//
+static CK_RV queue_token_object_writeback(struct obj_writeback *wb,
+                                          const CK_BYTE *name,
+                                          const CK_BYTE *data, CK_ULONG len)
+{
+    struct obj_writeback_rec *rec, *tmp;
+    CK_BYTE *copy;
+
+    copy = malloc(len);
+    if (copy == NULL) {
+        TRACE_ERROR("%s\n", ock_err(ERR_HOST_MEMORY));
+        return CKR_HOST_MEMORY;
+    }
+    memcpy(copy, data, len);
+
+    rec = find_token_object_writeback(wb, name);
+    if (rec == NULL) {
+        if (wb->num_recs == wb->max_recs) {
+            tmp = realloc(wb->recs, (wb->max_recs + 64) * sizeof(*tmp));
+            if (tmp == NULL) {
+                TRACE_ERROR("%s\n", ock_err(ERR_HOST_MEMORY));
+                free(copy);
+                return CKR_HOST_MEMORY;
+            }
+            wb->recs = tmp;
+            wb->max_recs += 64;
+        }
+        rec = &wb->recs[wb->num_recs++];
+        memcpy(rec->name, name, 8);
+    } else {
+        free(rec->data);
+    }
+
+    rec->data = copy;
+    rec->len = len;
+
+    return CKR_OK;
+}
+
+static void drop_token_object_writeback(struct obj_writeback *wb,
+                                        const CK_BYTE *name)
+{
+    struct obj_writeback_rec *rec;
+
+    rec = find_token_object_writeback(wb, name);
+    if (rec == NULL)
+        return;
+
+    free(rec->data);
+    *rec = wb->recs[--wb->num_recs];
+}
+
+static int compare_token_object_names(const void *a, const void *b)
+{
+    return memcmp(a, b, 8);
+}
+
+//
+// Adds those of the count token object names (8 bytes each) to OBJ.IDX that
+// are not listed there yet. The names are sorted by this function.
+// Note: The token lock (XProcLock) must be held when calling this function.
+//
+static CK_RV add_token_object_index(STDLL_TokData_t *tokdata, CK_BYTE *names,
+                                    CK_ULONG count)
+{
+    FILE *fp = NULL;
+    char line[256];
+    char fname[PATH_MAX];
+    CK_BBOOL *listed;
+    CK_BYTE *name;
+    CK_ULONG i;
+    CK_RV rc = CKR_OK;
+
+    listed = calloc(count, sizeof(*listed));
+    if (listed == NULL) {
+        TRACE_ERROR("%s\n", ock_err(ERR_HOST_MEMORY));
+        return CKR_HOST_MEMORY;
+    }
 
-    // update the index file if it exists
+    qsort(names, count, 8, compare_token_object_names);
+
+    // find the names that are listed already, if the index file exists
     fp = open_token_object_index(fname, sizeof(fname), tokdata, "r");
     if (fp) {
         set_perm(fileno(fp));
         while (fgets(line, 50, fp)) {
-            line[strlen(line) - 1] = 0;
-            if (strcmp(line, (char *)obj->name) == 0) {
-                fclose(fp);
-                // object is already in the list
-                return CKR_OK;
-            }
+            line[strcspn(line, "\n")] = 0;
+            if (strlen(line) != 8)
+                continue;
+            name = bsearch(line, names, count, 8, compare_token_object_names);
+            if (name != NULL)
+                listed[(name - names) / 8] = TRUE;
         }
         fclose(fp);
     }
-    // we didn't find it...either the index file doesn't exist or this
-    // is a new object...
-    //
+
+    for (i = 0; i < count && listed[i]; i++)
+        ;
+    if (i == count)
+        goto done;
+
     fp = fopen(fname, "a");
     if (!fp) {
         TRACE_ERROR("fopen(%s): %s\n", fname, strerror(errno));
-        return CKR_FUNCTION_FAILED;
+        rc = CKR_FUNCTION_FAILED;
+        goto done;
     }
 
     set_perm(fileno(fp));
-    fprintf(fp, "%s\n", obj->name);
+    for (; i < count; i++) {
+        if (!listed[i])
+            fprintf(fp, "%.8s\n", names + i * 8);
+    }
     fclose(fp);
 
+done:
+    free(listed);
+    return rc;
+}
+
+//
+// Writes a token file. The file is synced and closed, unless fdp is not NULL.
+// Then the file's descriptor is returned in fdp, and the caller must sync and
+// close it.
+//
+static CK_RV write_token_file(const char *fname, const CK_BYTE *data,
+                              CK_ULONG len, int *fdp)
+{
+    ssize_t n;
+    int fd;
+
+    fd = open(fname, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC,
+              S_IRUSR | S_IWUSR);
+    if (fd < 0) {
+        TRACE_ERROR("open(%s): %s\n", fname, strerror(errno));
+        return CKR_FUNCTION_FAILED;
+    }
+
+    set_perm(fd);
+
+    while (len > 0) {
+        n = write(fd, data, len);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0) {
+            TRACE_ERROR("write(%s): %s\n", fname, strerror(errno));
+            goto error;
+        }
+        data += n;
+        len -= n;
+    }
+
+    if (fdp != NULL) {
+        *fdp = fd;
+        return CKR_OK;
+    }
+
+    if (fdatasync(fd) != 0) {
+        TRACE_ERROR("fdatasync(%s): %s\n", fname, strerror(errno));
+        goto error;
+    }
+
+    close(fd);
+    return CKR_OK;
+
+error:
+    close(fd);
+    unlink(fname);
+    return CKR_FUNCTION_FAILED;
+}
+
+/*
+ * Grouped syncs of the token object directory.
+ *
+ * A token object file is replaced by writing its new version to a temporary
+ * file, which is synced and then renamed over the object file. The rename,
+ * and any update of OBJ.IDX, is only durable once the TOK_OBJ directory and
+ * OBJ.IDX are synced as well. Instead of doing that for every object, the
+ * writers only request a sync while holding the token lock, and the sync is
+ * done after the lock is released (see XProcUnLock). Threads that release
+ * the lock while another thread syncs wait for that sync, or for the next
+ * one, and all requests that came in in between are served by a single
+ * fsync of the directory and OBJ.IDX.
+ */
+struct obj_sync {
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    unsigned long requested;    // number of the last requested sync
+    unsigned long synced;       // number of the last request that is synced
+    CK_BBOOL syncing;
+};
+
+static void sync_token_object_dir(STDLL_TokData_t *tokdata)
+{
+    char dname[PATH_MAX];
+    int fd;
+
+    if (ock_snprintf(dname, sizeof(dname), "%s/" PK_LITE_OBJ_DIR,
+                     tokdata->data_store) != 0)
+        return;
+
+    fd = open(dname, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd < 0) {
+        TRACE_ERROR("open(%s): %s\n", dname, strerror(errno));
+        return;
+    }
+    if (fsync(fd) != 0)
+        TRACE_ERROR("fsync(%s): %s\n", dname, strerror(errno));
+    close(fd);
+
+    if (ock_snprintf(dname, sizeof(dname), "%s/" PK_LITE_OBJ_DIR "/"
+                     PK_LITE_OBJ_IDX, tokdata->data_store) != 0)
+        return;
+
+    // there is no OBJ.IDX with the single file object store
+    fd = open(dname, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        if (errno != ENOENT)
+            TRACE_ERROR("open(%s): %s\n", dname, strerror(errno));
+        return;
+    }
+    if (fdatasync(fd) != 0)
+        TRACE_ERROR("fdatasync(%s): %s\n", dname, strerror(errno));
+    close(fd);
+}
+
+//
+// Syncs and closes the num_fds temporary token object files in fds.
+//
+static CK_RV sync_token_object_files(int *fds, unsigned int *num_fds)
+{
+    unsigned int i;
+    CK_RV rc = CKR_OK;
+
+    for (i = 0; i < *num_fds; i++) {
+        if (rc == CKR_OK && fdatasync(fds[i]) != 0) {
+            TRACE_ERROR("fdatasync: %s\n", strerror(errno));
+            rc = CKR_FUNCTION_FAILED;
+        }
+        close(fds[i]);
+    }
+
+    *num_fds = 0;
+    return rc;
+}
+
+//
+// Requests a sync of the token object directory, which is done when the
+// token lock is released.
+// Note: The token lock (XProcLock) must be held when calling this function.
+//
+static void request_token_object_sync(STDLL_TokData_t *tokdata)
+{
+    struct obj_sync *os = tokdata->obj_sync;
+
+    if (os == NULL) {
+        os = calloc(1, sizeof(*os));
+        if (os == NULL)
+            goto sync_now;
+        if (pthread_mutex_init(&os->mutex, NULL) != 0) {
+            free(os);
+            goto sync_now;
+        }
+        if (pthread_cond_init(&os->cond, NULL) != 0) {
+            pthread_mutex_destroy(&os->mutex);
+            free(os);
+            goto sync_now;
+        }
+        tokdata->obj_sync = os;
+    }
+
+    if (pthread_mutex_lock(&os->mutex) != 0)
+        goto sync_now;
+    os->requested++;
+    pthread_mutex_unlock(&os->mutex);
+    return;
+
+sync_now:
+    sync_token_object_dir(tokdata);
+}
+
+//
+// Does the requested syncs of the token object directory, or waits for a
+// concurrent thread doing them.
+// Note: The token lock (XProcLock) must NOT be held when calling this
+// function.
+//
+void sync_token_objects(STDLL_TokData_t *tokdata)
+{
+    struct obj_sync *os = tokdata->obj_sync;
+    unsigned long target;
+
+    if (os == NULL || pthread_mutex_lock(&os->mutex) != 0)
+        return;
+
+    target = os->requested;
+    while (os->syncing && os->synced < target)
+        pthread_cond_wait(&os->cond, &os->mutex);
+
+    if (os->synced < target) {
+        /* become the leader, and also serve all requests made so far */
+        target = os->requested;
+        os->syncing = TRUE;
+        pthread_mutex_unlock(&os->mutex);
+
+        sync_token_object_dir(tokdata);
+
+        pthread_mutex_lock(&os->mutex);
+        os->synced = target;
+        os->syncing = FALSE;
+        pthread_cond_broadcast(&os->cond);
+    }
+
+    pthread_mutex_unlock(&os->mutex);
+}
+
+static void free_token_object_sync(STDLL_TokData_t *tokdata)
+{
+    struct obj_sync *os = tokdata->obj_sync;
+
+    if (os == NULL)
+        return;
+
+    pthread_cond_destroy(&os->cond);
+    pthread_mutex_destroy(&os->mutex);
+    free(os);
+    tokdata->obj_sync = NULL;
+}
+
+//
+// Atomically replaces a token object file: The data is written to a synced
+// temporary file, which is then renamed over the object file.
+// Note: The token lock (XProcLock) must be held when calling this function.
+//
+static CK_RV write_token_object_file(STDLL_TokData_t *tokdata,
+                                     const CK_BYTE *name,
+                                     const CK_BYTE *data, CK_ULONG len)
+{
+    char fname[PATH_MAX], tmpname[PATH_MAX];
+    CK_RV rc;
+
+    if (ock_snprintf(fname, sizeof(fname), "%s/%s/%.8s", tokdata->data_store,
+                     PK_LITE_OBJ_DIR, (char *)name) != 0 ||
+        ock_snprintf(tmpname, sizeof(tmpname), "%s.TMP", fname) != 0) {
+        TRACE_ERROR("token object file name buffer overflow\n");
+        return CKR_FUNCTION_FAILED;
+    }
+
+    rc = write_token_file(tmpname, data, len, NULL);
+    if (rc != CKR_OK)
+        return rc;
+
+    if (rename(tmpname, fname) != 0) {
+        TRACE_ERROR("rename(%s): %s\n", tmpname, strerror(errno));
+        unlink(tmpname);
+        return CKR_FUNCTION_FAILED;
+    }
+
+    request_token_object_sync(tokdata);
+    return CKR_OK;
+}
+
+//
+// Writes all queued token object records.
+// Note: The token lock (XProcLock) must be held when calling this function.
+//
+static CK_RV flush_token_object_writeback(STDLL_TokData_t *tokdata,
+                                          struct obj_writeback *wb)
+{
+    char fname[PATH_MAX], tmpname[PATH_MAX];
+    char name[8 + 5];
+    struct objdb *db;
+    CK_BYTE *names = NULL;
+    CK_ULONG i, written = 0;
+    int fds[WRITEBACK_SYNC_FILES];
+    unsigned int num_fds = 0;
+    CK_RV rc;
+
+    if (wb->num_recs == 0)
+        return CKR_OK;
+
+    rc = get_token_objdb(tokdata, &db);
+    if (rc != CKR_OK)
+        return rc;
+
+    if (db != NULL) {
+        for (i = 0; i < wb->num_recs; i++) {
+            memcpy(name, wb->recs[i].name, 8);
+            name[8] = 0;
+            rc = objdb_put(db, name, wb->recs[i].data, wb->recs[i].len);
+            if (rc != CKR_OK)
+                return rc;
+        }
+        return objdb_sync(db);
+    }
+
+    names = malloc(wb->num_recs * 8);
+    if (names == NULL) {
+        TRACE_ERROR("%s\n", ock_err(ERR_HOST_MEMORY));
+        return CKR_HOST_MEMORY;
+    }
+
+    // write the new versions next to the current ones. The files are kept
+    // open and are synced in groups, once all files of a group are written.
+    for (written = 0; written < wb->num_recs; ) {
+        sprintf(name, "%.8s.TMP", wb->recs[written].name);
+        if (get_token_object_path(tmpname, sizeof(tmpname), tokdata,
+                                  name) < 0) {
+            rc = CKR_FUNCTION_FAILED;
+            goto done;
+        }
+        rc = write_token_file(tmpname, wb->recs[written].data,
+                              wb->recs[written].len, &fds[num_fds]);
+        if (rc != CKR_OK)
+            goto done;
+        written++;
+        num_fds++;
+
+        if (num_fds == WRITEBACK_SYNC_FILES || written == wb->num_recs) {
+            rc = sync_token_object_files(fds, &num_fds);
+            if (rc != CKR_OK)
+                goto done;
+        }
+    }
+
+    // replace the current versions
+    for (i = 0; i < wb->num_recs; i++) {
+        memcpy(names + i * 8, wb->recs[i].name, 8);
+        sprintf(name, "%.8s", wb->recs[i].name);
+        if (get_token_object_path(fname, sizeof(fname), tokdata, name) < 0)
+            continue;
+        strcpy(tmpname, fname);
+        strcat(tmpname, ".TMP");
+        if (rename(tmpname, fname) != 0) {
+            TRACE_ERROR("rename(%s): %s\n", tmpname, strerror(errno));
+            unlink(tmpname);
+            rc = CKR_FUNCTION_FAILED;
+        }
+    }
+    written = 0;
+
+    if (rc == CKR_OK)
+        rc = add_token_object_index(tokdata, names, wb->num_recs);
+
+    request_token_object_sync(tokdata);
+
+done:
+    // remove the temporary files of an incomplete batch
+    for (i = 0; i < num_fds; i++)
+        close(fds[i]);
+    for (i = 0; i < written; i++) {
+        sprintf(name, "%.8s.TMP", wb->recs[i].name);
+        if (get_token_object_path(tmpname, sizeof(tmpname), tokdata,
+                                  name) == 0)
+            unlink(tmpname);
+    }
+    free(names);
+    return rc;
+}
+
+static void discard_token_object_writeback(struct obj_writeback *wb)
+{
+    CK_ULONG i;
+
+    for (i = 0; i < wb->num_recs; i++)
+        free(wb->recs[i].data);
+    wb->num_recs = 0;
+}
+
+//
+// Starts deferring token object writes, see above. Calls can be nested.
+// Note: The token lock (XProcLock) must be held when calling this function,
+// and until the matching end_token_object_writeback() call.
+//
+CK_RV begin_token_object_writeback(STDLL_TokData_t *tokdata)
+{
+    if (tokdata->version < TOK_NEW_DATA_STORE)
+        return CKR_OK;
+
+    if (tokdata->obj_writeback == NULL) {
+        tokdata->obj_writeback = calloc(1, sizeof(struct obj_writeback));
+        if (tokdata->obj_writeback == NULL) {
+            TRACE_ERROR("%s\n", ock_err(ERR_HOST_MEMORY));
+            return CKR_HOST_MEMORY;
+        }
+    }
+
+    tokdata->obj_writeback->nesting++;
     return CKR_OK;
 }
 
+//
+// Ends deferring token object writes. The outermost call writes the deferred
+// token objects, unless discard is TRUE.
+// Note: The token lock (XProcLock) must be held when calling this function.
+//
+CK_RV end_token_object_writeback(STDLL_TokData_t *tokdata, CK_BBOOL discard)
+{
+    struct obj_writeback *wb = tokdata->obj_writeback;
+    CK_RV rc = CKR_OK;
+
+    if (tokdata->version < TOK_NEW_DATA_STORE || wb == NULL ||
+        wb->nesting == 0)
+        return CKR_OK;
+
+    if (--wb->nesting > 0)
+        return CKR_OK;
+
+    if (!discard)
+        rc = flush_token_object_writeback(tokdata, wb);
+
+    discard_token_object_writeback(wb);
+    return rc;
+}
+
+//
+// Returns a new unique token object name.
+// Note: The token lock (XProcLock) must be held when calling this function.
+//
+CK_RV get_new_token_object_name(STDLL_TokData_t *tokdata, CK_BYTE *name)
+{
+    static const char chars[] =
+        "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789";
+    char fname[PATH_MAX];
+    struct objdb *db;
+    CK_BYTE rnd[6], *data;
+    CK_ULONG len;
+    CK_RV rc;
+    int fd, i;
+
+    rc = get_token_objdb(tokdata, &db);
+    if (rc != CKR_OK)
+        return rc;
+
+    if (db == NULL) {
+        /* create unique file name in token directory */
+        if (get_token_object_path(fname, sizeof(fname), tokdata,
+                                  "OBXXXXXX") < 0)
+            return CKR_FUNCTION_FAILED;
+
+        fd = mkstemp(fname);
+        if (fd < 0) {
+            TRACE_ERROR("mkstemp failed with: %s\n", strerror(errno));
+            return CKR_FUNCTION_FAILED;
+        }
+        close(fd); /* written and permissions set by save_token_object */
+
+        memcpy(name, &fname[strlen(fname) - 8], 8);
+        return CKR_OK;
+    }
+
+    /* same name format as mkstemp, but without creating a file */
+    memcpy(name, "OB", 2);
+    do {
+        rc = rng_generate(tokdata, rnd, sizeof(rnd));
+        if (rc != CKR_OK)
+            return rc;
+        for (i = 0; i < (int)sizeof(rnd); i++)
+            name[2 + i] = chars[rnd[i] % (sizeof(chars) - 1)];
+
+        rc = objdb_get(db, (char *)name, &data, &len);
+        if (rc != CKR_OK)
+            return rc;
+    } while (data != NULL);
+
+    return CKR_OK;
+}
+
+//
+// Note: The token lock (XProcLock) must be held when calling this function.
+// The object must hold the READ lock when this function is called.
+//
+CK_RV save_token_object(STDLL_TokData_t *tokdata, OBJECT *obj)
+{
+    struct objdb *db;
+    CK_RV rc;
+
+    // write token object
+    if (object_is_private(obj) == TRUE)
+        rc = save_private_token_object(tokdata, obj);
+    else
+        rc = save_public_token_object(tokdata, obj);
+    if (rc != CKR_OK)
+        return rc;
+
+    // the object store has its own index, and deferred writes update
+    // OBJ.IDX when they are flushed
+    if (token_object_writeback_active(tokdata))
+        return CKR_OK;
+    rc = get_token_objdb(tokdata, &db);
+    if (rc != CKR_OK || db != NULL)
+        return rc;
+
+    // update the index file
+    return add_token_object_index(tokdata, obj->name, 1);
+}
+
 //
 // Note: The token lock (XProcLock) must be held when calling this function.
 //
@@ -205,6 +986,17 @@ CK_RV delete_token_object(STDLL_TokData_t *tokdata, OBJECT *obj)
 {
     FILE *fp1, *fp2;
     char objidx[PATH_MAX], idxtmp[PATH_MAX], fname[PATH_MAX], line[256];
+    struct objdb *db;
+    CK_RV rc;
+
+    if (token_object_writeback_active(tokdata))
+        drop_token_object_writeback(tokdata->obj_writeback, obj->name);
+
+    rc = get_token_objdb(tokdata, &db);
+    if (rc != CKR_OK)
+        return rc;
+    if (db != NULL)
+        return objdb_delete(db, (char *)obj->name);
 
     // FIXME:  on UNIX, we need to make sure these guys aren't symlinks
     //         before we blindly write to these files...
@@ -236,33 +1028,30 @@ CK_RV delete_token_object(STDLL_TokData_t *tokdata, OBJECT *obj)
     }
 
     fclose(fp1);
-    fclose(fp2);
-    fp2 = fopen(objidx, "w");
-    fp1 = fopen(idxtmp, "r");
-    if (!fp1 || !fp2) {
-        if (fp1)
-            fclose(fp1);
-        if (fp2)
-            fclose(fp2);
-        TRACE_ERROR("fopen failed\n");
+
+    // replace the index file atomically
+    if (fflush(fp2) != 0 || fdatasync(fileno(fp2)) != 0) {
+        TRACE_ERROR("fdatasync(%s): %s\n", idxtmp, strerror(errno));
+        fclose(fp2);
+        unlink(idxtmp);
         return CKR_FUNCTION_FAILED;
     }
+    fclose(fp2);
 
-    set_perm(fileno(fp2));
-
-    while (fgets(line, 50, fp1)) {
-        fprintf(fp2, "%s", line);
+    if (rename(idxtmp, objidx) != 0) {
+        TRACE_ERROR("rename(%s): %s\n", idxtmp, strerror(errno));
+        unlink(idxtmp);
+        return CKR_FUNCTION_FAILED;
     }
 
-    fclose(fp1);
-    fclose(fp2);
-
     if (get_token_object_path(fname, sizeof(fname), tokdata,
                               (char *) obj->name) < 0)
        TRACE_DEVEL("file name buffer overflow in obj unlink\n");
     else
         unlink(fname);
 
+    request_token_object_sync(tokdata);
+
     return CKR_OK;
 }
 
@@ -270,6 +1059,21 @@ CK_RV delete_token_data(STDLL_TokData_t *tokdata)
 {
     CK_RV rc = CKR_OK;
     char *cmd = NULL;
+    struct objdb *db;
+
+    clear_object_key_cache(tokdata);
+
+    if (tokdata->objstore == OBJSTORE_MMAP &&
+        tokdata->version >= TOK_NEW_DATA_STORE) {
+        rc = XProcLock(tokdata);
+        if (rc != CKR_OK)
+            return rc;
+        rc = get_token_objdb(tokdata, &db);
+        if (rc == CKR_OK)
+            rc = objdb_reset(db);
+        XProcUnLock(tokdata);
+        return rc;
+    }
 
     // Construct a string to delete the token objects.
     //
@@ -337,6 +1141,19 @@ void final_data_store(STDLL_TokData_t * tokdata)
         free(tokdata->pk_dir);
         tokdata->pk_dir = NULL;
     }
+    if (tokdata->objdb != NULL) {
+        objdb_close(tokdata->objdb);
+        free(tokdata->objdb);
+        tokdata->objdb = NULL;
+    }
+    if (tokdata->obj_writeback != NULL) {
+        discard_token_object_writeback(tokdata->obj_writeback);
+        free(tokdata->obj_writeback->recs);
+        free(tokdata->obj_writeback);
+        tokdata->obj_writeback = NULL;
+    }
+    free_token_object_sync(tokdata);
+    free_object_key_cache(tokdata);
 }
 
 /******************************************************************************
@@ -642,12 +1459,11 @@ out_nolock:
 //
 static CK_RV save_private_token_object_old(STDLL_TokData_t *tokdata, OBJECT *obj)
 {
-    FILE *fp = NULL;
     CK_BYTE *obj_data = NULL;
     CK_BYTE *clear = NULL;
     CK_BYTE *cipher = NULL;
+    CK_BYTE *buf = NULL;
     CK_BYTE *ptr = NULL;
-    char fname[PATH_MAX];
     CK_BYTE hash_sha[SHA1_HASH_SIZE];
     CK_BYTE *key = NULL;
     CK_ULONG key_len = 0L;
@@ -722,30 +1538,22 @@ static CK_RV save_private_token_object_old(STDLL_TokData_t *tokdata, OBJECT *obj
         goto error;
     }
 
-    if (ock_snprintf(fname, PATH_MAX, "%s/%s/%.8s", tokdata->data_store,
-                     PK_LITE_OBJ_DIR, (char *)obj->name) != 0) {
-        TRACE_ERROR("private token object old name buffer overflow\n");
-        rc = CKR_FUNCTION_FAILED;
-        goto error;
-    }
-    fp = fopen(fname, "w");
-    if (!fp) {
-        TRACE_ERROR("fopen(%s): %s\n", fname, strerror(errno));
-        rc = CKR_FUNCTION_FAILED;
-        goto error;
-    }
-
-    set_perm(fileno(fp));
-
     total_len = sizeof(CK_ULONG_32) + sizeof(CK_BBOOL) + cipher_len;
 
     flag = TRUE;
 
-    (void) fwrite(&total_len, sizeof(CK_ULONG_32), 1, fp);
-    (void) fwrite(&flag, sizeof(CK_BBOOL), 1, fp);
-    (void) fwrite(cipher, cipher_len, 1, fp);
+    buf = malloc(total_len);
+    if (!buf)
+        goto oom_error;
+    memcpy(buf, &total_len, sizeof(CK_ULONG_32));
+    memcpy(buf + sizeof(CK_ULONG_32), &flag, sizeof(CK_BBOOL));
+    memcpy(buf + sizeof(CK_ULONG_32) + sizeof(CK_BBOOL), cipher, cipher_len);
 
-    fclose(fp);
+    rc = write_token_object_file(tokdata, obj->name, buf, total_len);
+    if (rc != CKR_OK)
+        goto error;
+
+    free(buf);
     free(obj_data);
     free(clear);
     free(cipher);
@@ -757,6 +1565,8 @@ oom_error:
     rc = CKR_HOST_MEMORY;
 
 error:
+    if (buf)
+        free(buf);
     if (obj_data)
         free(obj_data);
     if (clear)
@@ -1528,9 +2338,8 @@ done:
 //
 CK_RV save_public_token_object_old(STDLL_TokData_t *tokdata, OBJECT * obj)
 {
-    FILE *fp = NULL;
     CK_BYTE *clear = NULL;
-    char fname[PATH_MAX];
+    CK_BYTE *buf = NULL;
     CK_ULONG clear_len;
     CK_BBOOL flag = FALSE;
     CK_RV rc;
@@ -1541,33 +2350,30 @@ CK_RV save_public_token_object_old(STDLL_TokData_t *tokdata, OBJECT * obj)
         goto error;
     }
 
-    if (ock_snprintf(fname, PATH_MAX, "%s/%s/%.8s", tokdata->data_store,
-                     PK_LITE_OBJ_DIR, (char *)obj->name) != 0) {
-        TRACE_ERROR("public token object file name buffer overflow\n");
-        rc = CKR_FUNCTION_FAILED;
-        goto error;
-    }
-    fp = fopen(fname, "w");
-    if (!fp) {
-        TRACE_ERROR("fopen(%s): %s\n", fname, strerror(errno));
-        rc = CKR_FUNCTION_FAILED;
+    total_len = clear_len + sizeof(CK_ULONG_32) + sizeof(CK_BBOOL);
+
+    buf = malloc(total_len);
+    if (!buf) {
+        TRACE_ERROR("%s\n", ock_err(ERR_HOST_MEMORY));
+        rc = CKR_HOST_MEMORY;
         goto error;
     }
+    memcpy(buf, &total_len, sizeof(CK_ULONG_32));
+    memcpy(buf + sizeof(CK_ULONG_32), &flag, sizeof(CK_BBOOL));
+    memcpy(buf + sizeof(CK_ULONG_32) + sizeof(CK_BBOOL), clear, clear_len);
 
-    set_perm(fileno(fp));
-
-    total_len = clear_len + sizeof(CK_ULONG_32) + sizeof(CK_BBOOL);
-
-    (void) fwrite(&total_len, sizeof(CK_ULONG_32), 1, fp);
-    (void) fwrite(&flag, sizeof(CK_BBOOL), 1, fp);
-    (void) fwrite(clear, clear_len, 1, fp);
+    rc = write_token_object_file(tokdata, obj->name, buf, total_len);
+    if (rc != CKR_OK)
+        goto error;
 
-    fclose(fp);
+    free(buf);
     free(clear);
 
     return CKR_OK;
 
 error:
+    if (buf)
+        free(buf);
     if (clear)
         free(clear);
 
@@ -1820,15 +2626,36 @@ static CK_RV aes_256_unwrap(STDLL_TokData_t *tokdata,
     memcpy(key, buffer, 32);
     rc = CKR_OK;
 
-    if ((tokdata->statistics->flags & STATISTICS_FLAG_COUNT_INTERNAL) != 0)
-        tokdata->statistics->increment_func(tokdata->statistics,
-                                            tokdata->slot_id,
-                                            &tokdata->store_strength.wrap_crypt,
-                                            tokdata->store_strength.wrap_strength);
+    if ((tokdata->statistics->flags & STATISTICS_FLAG_COUNT_INTERNAL) != 0)
+        tokdata->statistics->increment_func(tokdata->statistics,
+                                            tokdata->slot_id,
+                                            &tokdata->store_strength.wrap_crypt,
+                                            tokdata->store_strength.wrap_strength);
+
+done:
+    EVP_CIPHER_CTX_free(ctx);
+    return rc;
+}
+
+//
+// Unwraps an object key with the master key, or takes it from the object
+// key cache.
+//
+static CK_RV unwrap_object_key(STDLL_TokData_t *tokdata,
+                               unsigned char key[32],
+                               const unsigned char key_wrapped[40])
+{
+    CK_RV rc;
+
+    if (get_cached_object_key(tokdata, key_wrapped, key))
+        return CKR_OK;
+
+    rc = aes_256_unwrap(tokdata, key, key_wrapped, tokdata->master_key);
+    if (rc != CKR_OK)
+        return rc;
 
-done:
-    EVP_CIPHER_CTX_free(ctx);
-    return rc;
+    put_cached_object_key(tokdata, key_wrapped, key);
+    return CKR_OK;
 }
 
 CK_RV generate_master_key(STDLL_TokData_t *tokdata, CK_BYTE *key)
@@ -1913,6 +2740,7 @@ CK_RV load_masterkey_so(STDLL_TokData_t *tokdata)
     if (tokdata->version < TOK_NEW_DATA_STORE)
         return load_masterkey_so_old(tokdata);
 
+    clear_object_key_cache(tokdata);
     memset(tokdata->master_key, 0, sizeof(tokdata->master_key));
 
     // this file gets created on C_InitToken so we can assume that it always
@@ -2004,6 +2832,7 @@ CK_RV load_masterkey_user(STDLL_TokData_t *tokdata)
     if (tokdata->version < TOK_NEW_DATA_STORE)
         return load_masterkey_user_old(tokdata);
 
+    clear_object_key_cache(tokdata);
     memset(tokdata->master_key, 0, sizeof(tokdata->master_key));
 
     // this file gets created on C_InitToken so we can assume that it always
@@ -2269,20 +3098,128 @@ static inline int inc32(unsigned char ctr[4])
 #define HEADER_LEN  64
 #define FOOTER_LEN  16
 
+/**
+ * public tok obj layout
+ *
+ * ----------------           <--+
+ * u32 tokversion                | 16-byte header
+ * u8  private_flag              |
+ * u8  reserved[7]               |
+ * u32 object_len                |
+ * ----------------           <--+
+ * u8  object[object_len]        | body
+ * ----------------           <--+
+ */
+#define PUB_HEADER_LEN  16
+
 //
+// Reads the header of the stored token object. Sets *found to FALSE if the
+// object has not been stored yet.
 // Note: The token lock (XProcLock) must be held when calling this function.
 //
-CK_RV save_private_token_object(STDLL_TokData_t *tokdata, OBJECT *obj)
+static CK_RV read_token_object_header(STDLL_TokData_t *tokdata, OBJECT *obj,
+                                      CK_BYTE *header, CK_ULONG header_len,
+                                      CK_BBOOL *found)
 {
     FILE *fp = NULL;
-    CK_BYTE *obj_data = NULL;
     char fname[PATH_MAX];
     struct stat sb;
+    struct objdb *db;
+    struct obj_writeback_rec *rec;
+    CK_BYTE *data;
+    CK_ULONG len;
+    CK_RV rc;
+
+    *found = FALSE;
+
+    if (token_object_writeback_active(tokdata)) {
+        rec = find_token_object_writeback(tokdata->obj_writeback, obj->name);
+        if (rec != NULL && rec->len >= header_len) {
+            memcpy(header, rec->data, header_len);
+            *found = TRUE;
+            return CKR_OK;
+        }
+    }
+
+    rc = get_token_objdb(tokdata, &db);
+    if (rc != CKR_OK)
+        return rc;
+
+    if (db != NULL) {
+        rc = objdb_get(db, (char *)obj->name, &data, &len);
+        if (rc != CKR_OK)
+            return rc;
+        if (data != NULL && len >= header_len) {
+            memcpy(header, data, header_len);
+            *found = TRUE;
+        }
+        return CKR_OK;
+    }
+
+    sprintf(fname, "%s/%s/", tokdata->data_store, PK_LITE_OBJ_DIR);
+    strncat(fname, (char *)obj->name, 8);
+
+    fp = fopen(fname, "r");
+    if (fp == NULL)
+        return CKR_OK;
+
+    if (fstat(fileno(fp), &sb) != 0) {
+        TRACE_ERROR("fstat(%s): %s\n", fname, strerror(errno));
+        rc = CKR_FUNCTION_FAILED;
+        goto done;
+    }
+
+    /* New token objects files created by mkstemp have a size of zero */
+    if (sb.st_size == 0)
+        goto done;
+
+    if (fread(header, header_len, 1, fp) != 1) {
+        TRACE_ERROR("fread(%s): %s\n", fname, strerror(errno));
+        rc = CKR_FUNCTION_FAILED;
+        goto done;
+    }
+    *found = TRUE;
+
+done:
+    fclose(fp);
+    return rc;
+}
+
+//
+// Writes the token object record (header, body and footer) to the store.
+// Note: The token lock (XProcLock) must be held when calling this function.
+//
+static CK_RV write_token_object(STDLL_TokData_t *tokdata, OBJECT *obj,
+                                const CK_BYTE *data, CK_ULONG len)
+{
+    struct objdb *db;
+    CK_RV rc;
+
+    if (token_object_writeback_active(tokdata))
+        return queue_token_object_writeback(tokdata->obj_writeback, obj->name,
+                                            data, len);
+
+    rc = get_token_objdb(tokdata, &db);
+    if (rc != CKR_OK)
+        return rc;
+
+    if (db != NULL)
+        return objdb_put(db, (char *)obj->name, data, len);
+
+    return write_token_object_file(tokdata, obj->name, data, len);
+}
+
+//
+// Note: The token lock (XProcLock) must be held when calling this function.
+//
+CK_RV save_private_token_object(STDLL_TokData_t *tokdata, OBJECT *obj)
+{
+    CK_BYTE *obj_data = NULL;
     CK_ULONG obj_data_len;
     CK_RV rc;
     CK_ULONG_32 obj_data_len_32;
     CK_ULONG_32 total_len;
-    CK_BBOOL flag = CK_TRUE;
+    CK_BBOOL flag = CK_TRUE, found;
     unsigned char obj_key[256 / 8], obj_iv[96 / 8], obj_key_wrapped[40];
     unsigned char *data = NULL;
     uint32_t tmp;
@@ -2291,8 +3228,7 @@ CK_RV save_private_token_object(STDLL_TokData_t *tokdata, OBJECT *obj)
     if (tokdata->version < TOK_NEW_DATA_STORE)
         return save_private_token_object_old(tokdata, obj);
 
-    sprintf(fname, "%s/%s/", tokdata->data_store, PK_LITE_OBJ_DIR);
-    strncat(fname, (char *)obj->name, 8);
+    init_object_key_cache(tokdata);
 
     rc = object_flatten(obj, &obj_data, &obj_data_len);
     obj_data_len_32 = obj_data_len;
@@ -2308,32 +3244,15 @@ CK_RV save_private_token_object(STDLL_TokData_t *tokdata, OBJECT *obj)
         goto done;
     }
 
-    fp = fopen(fname, "r");
-    if (fp == NULL) {
+    rc = read_token_object_header(tokdata, obj, data, HEADER_LEN, &found);
+    if (rc != CKR_OK)
+        goto done;
+
+    if (!found) {
         /* create new token object */
         new = 1;
     } else {
-        if (fstat(fileno(fp), &sb) != 0) {
-            TRACE_ERROR("fstat(%s): %s\n", fname, strerror(errno));
-            rc = CKR_FUNCTION_FAILED;
-            goto done;
-        }
-
-        /* New token objects files created by mkstemp have a size of zero */
-        if (sb.st_size == 0) {
-            new = 1;
-            goto do_work;
-        }
-
         /* update existing token object */
-        if (fread(data, HEADER_LEN, 1, fp) != 1) {
-            TRACE_ERROR("fread(%s): %s\n", fname, strerror(errno));
-            rc = CKR_FUNCTION_FAILED;
-            goto done;
-        }
-
-        fclose(fp);
-        fp = NULL;
 
         /* iv */
         memcpy(obj_iv, data + 48, 12);
@@ -2347,13 +3266,12 @@ CK_RV save_private_token_object(STDLL_TokData_t *tokdata, OBJECT *obj)
             memcpy(obj_key_wrapped, data + 8, 40);
 
             /* get key */
-            rc = aes_256_unwrap(tokdata, obj_key, obj_key_wrapped,
-                                tokdata->master_key);
+            rc = unwrap_object_key(tokdata, obj_key, obj_key_wrapped);
             if (rc != CKR_OK)
                 goto done;
         }
     }
-do_work:
+
     if (new) {
         /* get key */
         rng_generate(tokdata, obj_key, 32);
@@ -2370,6 +3288,8 @@ do_work:
                           tokdata->master_key);
         if (rc != CKR_OK)
             goto done;
+
+        put_cached_object_key(tokdata, obj_key_wrapped, obj_key);
     }
 
     /* version */
@@ -2404,53 +3324,398 @@ do_work:
     if (rc != CKR_OK)
         goto done;
 
-    fp = fopen(fname, "w");
-    if (!fp) {
-        TRACE_ERROR("fopen(%s): %s\n", fname, strerror(errno));
-        rc = CKR_FUNCTION_FAILED;
-        goto done;
+    rc = write_token_object(tokdata, obj, data, total_len);
+
+done:
+    if (obj_data)
+        free(obj_data);
+    if (data)
+        free(data);
+    return rc;
+}
+
+//
+// Parses the header of a token object record, that is the contents of a
+// token object file or of a record of the single file object store. Returns
+// the record's private flag and the length of the object data.
+//
+static CK_RV parse_token_object_record(CK_BYTE *rec, CK_ULONG rec_len,
+                                       CK_BBOOL *priv, CK_ULONG_32 *size,
+                                       const char *fname)
+{
+    uint32_t ver, len;
+
+    if (rec_len < PUB_HEADER_LEN)
+        goto corrupted;
+
+    memcpy(&ver, rec, 4);
+    memcpy(priv, rec + 4, 1);
+
+    if (*priv) {
+        if (rec_len < HEADER_LEN + FOOTER_LEN)
+            goto corrupted;
+        memcpy(&len, rec + 60, 4);
+    } else {
+        memcpy(&len, rec + 12, 4);
+    }
+
+    /*
+     * In OCK 3.12 - 3.14 the version and size was not stored in BE. So if
+     * version field is in platform endianness, keep size as is also.
+     */
+    *size = (ver == TOK_NEW_DATA_STORE) ? len : be32toh(len);
+
+    if (*size > rec_len - (*priv ? HEADER_LEN + FOOTER_LEN : PUB_HEADER_LEN))
+        goto corrupted;
+
+    return CKR_OK;
+
+corrupted:
+    OCK_SYSLOG(LOG_ERR, "Token object %s appears corrupted (ignoring it)",
+               fname);
+    return CKR_FUNCTION_FAILED;
+}
+
+//
+// Reloads a token object from a record of the single file object store.
+//
+static CK_RV restore_token_object_record(STDLL_TokData_t *tokdata,
+                                         CK_BYTE *rec, CK_ULONG rec_len,
+                                         OBJECT *obj, const char *name)
+{
+    char fname[PATH_MAX];
+    CK_BBOOL priv;
+    CK_ULONG_32 size;
+    CK_RV rc;
+
+    /* object_restore_withSize() checks the name against the file name */
+    if (get_token_object_path(fname, sizeof(fname), tokdata,
+                              (char *)name) < 0)
+        return CKR_FUNCTION_FAILED;
+
+    rc = parse_token_object_record(rec, rec_len, &priv, &size, fname);
+    if (rc != CKR_OK)
+        return rc;
+
+    if (priv)
+        return restore_private_token_object(tokdata, rec, rec + HEADER_LEN,
+                                            size, rec + HEADER_LEN + size,
+                                            obj, fname);
+
+    return object_mgr_restore_obj(tokdata, rec + PUB_HEADER_LEN, obj, fname);
+}
+
+//
+// Unwraps the object key of a private token object with the master key and
+// decrypts the object. The caller must free the returned clear text, which
+// has the same length as the encrypted data.
+//
+static CK_RV unseal_private_token_object(STDLL_TokData_t *tokdata,
+                                         CK_BYTE *header,
+                                         CK_BYTE *data, CK_ULONG len,
+                                         CK_BYTE *footer,
+                                         CK_BYTE **clear)
+{
+    unsigned char obj_iv[12], obj_key[32], obj_key_wrapped[40];
+    CK_BYTE *buff = NULL;
+    CK_RV rc;
+
+    /* wrapped key */
+    memcpy(obj_key_wrapped, header + 8, 40);
+    /* iv */
+    memcpy(obj_iv, header + 48, 12);
+
+    rc = unwrap_object_key(tokdata, obj_key, obj_key_wrapped);
+    if (rc != CKR_OK) {
+        rc = CKR_FUNCTION_FAILED;
+        goto done;
+    }
+
+    buff = (CK_BYTE *)malloc(len);
+    if (buff == NULL) {
+        TRACE_ERROR("%s\n", ock_err(ERR_HOST_MEMORY));
+        rc = CKR_HOST_MEMORY;
+        goto done;
+    }
+
+    rc = aes_256_gcm_unseal(tokdata,
+                            buff, /* plain-text */
+                            header, HEADER_LEN, /* aad */
+                            data, len, /* cipher-text*/
+                            footer, /* tag */
+                            obj_key, obj_iv);
+    if (rc != CKR_OK) {
+        rc = CKR_FUNCTION_FAILED;
+        goto done;
+    }
+
+    *clear = buff;
+    buff = NULL;
+done:
+    if (buff)
+        free(buff);
+    return rc;
+}
+
+//
+//
+CK_RV restore_private_token_object(STDLL_TokData_t *tokdata,
+                                   CK_BYTE *header,
+                                   CK_BYTE *data, CK_ULONG len,
+                                   CK_BYTE *footer,
+                                   OBJECT *pObj,
+                                   const char *fname)
+{
+    CK_BYTE *buff = NULL;
+    CK_RV rc;
+
+    if (tokdata->version < TOK_NEW_DATA_STORE)
+        return restore_private_token_object_old(tokdata, data, len, pObj,
+                                                fname);
+
+    rc = unseal_private_token_object(tokdata, header, data, len, footer,
+                                     &buff);
+    if (rc != CKR_OK)
+        return rc;
+
+    rc = object_mgr_restore_obj(tokdata, buff, pObj, fname);
+
+    free(buff);
+    return rc;
+}
+
+/*
+ * Token objects are loaded in batches of up to LOAD_BATCH_SIZE objects. The
+ * records of a batch are decrypted and decoded by a pool of worker threads,
+ * since unwrapping the keys and unsealing the private objects with the
+ * master key is what makes C_Login slow for tokens with many objects. The
+ * decoded objects are then added to the token one by one, in the order they
+ * were read.
+ */
+#define LOAD_BATCH_SIZE         256
+#define LOAD_MAX_WORKERS        8
+#define LOAD_OBJS_PER_WORKER    16
+
+struct load_job {
+    char *fname;
+    CK_BYTE *rec;
+    CK_ULONG rec_len;
+    CK_BBOOL free_rec;          // rec is malloc'ed, not mapped
+    OBJECT *obj;
+    CK_RV rc;
+};
+
+struct load_batch {
+    STDLL_TokData_t *tokdata;
+    CK_BBOOL priv;
+    CK_RV rc;                   // error that stops loading
+    CK_ULONG num_jobs;
+    CK_ULONG next_job;          // next job to be taken by a worker
+    struct load_job jobs[LOAD_BATCH_SIZE];
+};
+
+//
+// Decodes, and for private objects decrypts, a token object record into a
+// new object that is not added to the token yet. This is called by the
+// loader's worker threads in parallel.
+//
+static CK_RV decode_token_object_record(STDLL_TokData_t *tokdata,
+                                        CK_BYTE *rec, CK_ULONG rec_len,
+                                        const char *fname, OBJECT **obj)
+{
+    CK_BYTE *clear = NULL;
+    CK_BBOOL priv;
+    CK_ULONG_32 size;
+    CK_RV rc;
+
+    rc = parse_token_object_record(rec, rec_len, &priv, &size, fname);
+    if (rc != CKR_OK)
+        return rc;
+
+    if (!priv)
+        return object_restore_withSize(tokdata->policy, rec + PUB_HEADER_LEN,
+                                       obj, FALSE, size, fname);
+
+    rc = unseal_private_token_object(tokdata, rec, rec + HEADER_LEN, size,
+                                     rec + HEADER_LEN + size, &clear);
+    if (rc != CKR_OK)
+        return rc;
+
+    rc = object_restore_withSize(tokdata->policy, clear, obj, FALSE, size,
+                                 fname);
+
+    free(clear);
+    return rc;
+}
+
+static void *load_token_objects_worker(void *arg)
+{
+    struct load_batch *lb = arg;
+    struct load_job *job;
+    CK_ULONG i;
+
+    while ((i = __atomic_fetch_add(&lb->next_job, 1, __ATOMIC_RELAXED)) <
+                                                            lb->num_jobs) {
+        job = &lb->jobs[i];
+        job->rc = decode_token_object_record(lb->tokdata, job->rec,
+                                             job->rec_len, job->fname,
+                                             &job->obj);
+    }
+
+    return NULL;
+}
+
+//
+// Decodes the objects of the batch and adds them to the token. A private
+// object that can not be restored stops the loading, since this means that
+// the master key is wrong. Other objects that can not be restored are
+// skipped.
+//
+static CK_RV load_token_objects_batch(struct load_batch *lb)
+{
+    pthread_t threads[LOAD_MAX_WORKERS];
+    struct load_job *job;
+    CK_ULONG i, num_threads, started;
+    long cpus;
+
+    num_threads = lb->num_jobs / LOAD_OBJS_PER_WORKER;
+    cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    if (cpus > 0 && num_threads > (CK_ULONG)cpus)
+        num_threads = cpus;
+    if (num_threads > LOAD_MAX_WORKERS)
+        num_threads = LOAD_MAX_WORKERS;
+
+    lb->next_job = 0;
+
+    /* the calling thread is one of the workers */
+    for (started = 0; lb->rc == CKR_OK && started + 1 < num_threads;
+         started++) {
+        if (worker_thread_create(lb->tokdata, &threads[started],
+                                 load_token_objects_worker, lb) != 0) {
+            TRACE_DEVEL("Thread creation failed, using %lu workers.\n",
+                        started + 1);
+            break;
+        }
+    }
+    if (lb->rc == CKR_OK)
+        load_token_objects_worker(lb);
+    for (i = 0; i < started; i++)
+        pthread_join(threads[i], NULL);
+
+    for (i = 0; i < lb->num_jobs; i++) {
+        job = &lb->jobs[i];
+
+        if (lb->rc != CKR_OK) {
+            if (job->obj != NULL)
+                object_free(job->obj);
+        } else {
+            if (job->rc == CKR_OK)
+                job->rc = object_mgr_add_restored_obj(lb->tokdata, job->obj);
+            if (job->rc != CKR_OK) {
+                OCK_SYSLOG(LOG_ERR, "Cannot restore token object %s "
+                           "(ignoring it)", job->fname);
+                if (lb->priv)
+                    lb->rc = job->rc;
+            }
+        }
+
+        if (job->free_rec)
+            free(job->rec);
+        free(job->fname);
     }
 
-    set_perm(fileno(fp));
+    memset(lb->jobs, 0, lb->num_jobs * sizeof(struct load_job));
+    lb->num_jobs = 0;
 
-    if (fwrite(data, total_len, 1, fp) != 1) {
-        TRACE_ERROR("fwrite(%s): %s\n", fname, strerror(errno));
-        rc = CKR_FUNCTION_FAILED;
-        goto done;
+    return lb->rc;
+}
+
+//
+// Adds a token object record to the batch, and loads the batch when it is
+// full. Takes over the record if free_rec is TRUE.
+//
+static CK_RV load_token_objects_add(struct load_batch *lb, const char *fname,
+                                    CK_BYTE *rec, CK_ULONG rec_len,
+                                    CK_BBOOL free_rec)
+{
+    struct load_job *job = &lb->jobs[lb->num_jobs];
+
+    job->fname = strdup(fname);
+    if (job->fname == NULL) {
+        OCK_SYSLOG(LOG_ERR, "Cannot restore token object %s "
+                   "(ignoring it)", fname);
+        if (free_rec)
+            free(rec);
+        return lb->rc;
     }
 
-    fclose(fp);
-    fp = NULL;
+    job->rec = rec;
+    job->rec_len = rec_len;
+    job->free_rec = free_rec;
+    lb->num_jobs++;
 
-    rc = CKR_OK;
-done:
-    if (fp)
-        fclose(fp);
-    if (obj_data)
-        free(obj_data);
-    if (data)
-        free(data);
-    return rc;
+    if (lb->num_jobs == LOAD_BATCH_SIZE)
+        return load_token_objects_batch(lb);
+
+    return lb->rc;
 }
 
 //
-// Note: The token lock (XProcLock) must be held when calling this function.
+// With objload = lazy, only a placeholder is added for an object that the
+// other processes know about already, see object_mgr_add_lazy_obj().
+// Returns TRUE if a placeholder has been added.
 //
-CK_RV load_private_token_objects(STDLL_TokData_t *tokdata)
+static CK_BBOOL load_token_object_lazy(STDLL_TokData_t *tokdata,
+                                       const char *name, CK_BBOOL priv)
+{
+    CK_BBOOL loaded;
+
+    if (tokdata->objload != OBJLOAD_LAZY)
+        return FALSE;
+
+    if (priv)
+        loaded = tokdata->global_shm->priv_loaded;
+    else
+        loaded = tokdata->global_shm->publ_loaded;
+    if (!loaded)
+        return FALSE;
+
+    return object_mgr_add_lazy_obj(tokdata, name, priv) == CKR_OK;
+}
+
+static CK_RV load_token_object_cb(const char *name, CK_BYTE *data,
+                                  CK_ULONG len, void *private)
+{
+    struct load_batch *lb = private;
+    char fname[PATH_MAX];
+    CK_BBOOL priv;
+
+    /* a record too short for a header is reported by the decoder */
+    priv = lb->priv;
+    if (len >= PUB_HEADER_LEN)
+        memcpy(&priv, data + 4, 1);
+    if (priv != lb->priv || load_token_object_lazy(lb->tokdata, name, priv))
+        return CKR_OK;
+
+    if (get_token_object_path(fname, sizeof(fname), lb->tokdata,
+                              (char *)name) < 0)
+        return CKR_OK;
+
+    return load_token_objects_add(lb, fname, data, len, FALSE);
+}
+
+static CK_RV load_token_objects_files(STDLL_TokData_t *tokdata,
+                                      struct load_batch *lb)
 {
     FILE *fp1 = NULL, *fp2 = NULL;
-    CK_BYTE *buf = NULL;
+    CK_BYTE *buf;
     char tmp[PATH_MAX];
     char iname[PATH_MAX];
     char fname[PATH_MAX];
+    unsigned char header[PUB_HEADER_LEN];
     CK_BBOOL priv;
-    CK_ULONG_32 size;
-    CK_RV rc;
-    unsigned char header[HEADER_LEN], footer[FOOTER_LEN];
-    uint32_t len;
-
-    if (tokdata->version < TOK_NEW_DATA_STORE)
-        return load_private_token_objects_old(tokdata);
+    struct stat sb;
+    CK_RV rc = CKR_OK;
 
     fp1 = open_token_object_index(iname, sizeof(iname), tokdata, "r");
     if (!fp1)
@@ -2459,128 +3724,111 @@ CK_RV load_private_token_objects(STDLL_TokData_t *tokdata)
     while (fgets(tmp, 50, fp1)) {
         tmp[strlen(tmp) - 1] = 0;
 
-        fp2 = open_token_object_path(fname, sizeof(fname), tokdata, tmp,"r");
+        fp2 = open_token_object_path(fname, sizeof(fname), tokdata, tmp, "r");
         if (!fp2)
             continue;
 
-        if (fread(header, HEADER_LEN, 1, fp2) != 1) {
+        if (fread(header, PUB_HEADER_LEN, 1, fp2) != 1) {
             fclose(fp2);
+            OCK_SYSLOG(LOG_ERR, "Cannot read header\n");
             continue;
         }
 
         memcpy(&priv, header + 4, 1);
-        if (priv == FALSE) {
+        if (priv != lb->priv || load_token_object_lazy(tokdata, tmp, priv)) {
             fclose(fp2);
             continue;
         }
 
-        memcpy(&len, header + 60, 4);
-        size = be32toh(len);
-
-        buf = (CK_BYTE *)malloc(size);
-        if (!buf) {
+        if (fstat(fileno(fp2), &sb) != 0 || sb.st_size <= PUB_HEADER_LEN) {
             fclose(fp2);
             OCK_SYSLOG(LOG_ERR,
-                       "Cannot malloc %u bytes to read in "
-                       "token object %s (ignoring it)", size, fname);
+                       "Token object %s appears corrupted (ignoring it)",
+                       fname);
             continue;
         }
 
-        if (fread(buf, size, 1, fp2) != 1) {
-            free(buf);
+        buf = (CK_BYTE *)malloc(sb.st_size);
+        if (!buf) {
             fclose(fp2);
             OCK_SYSLOG(LOG_ERR,
-                       "Cannot read token object %s " "(ignoring it)", fname);
+                       "Cannot malloc %lu bytes to read in "
+                       "token object %s (ignoring it)",
+                       (unsigned long)sb.st_size, fname);
             continue;
         }
-        if (fread(footer, FOOTER_LEN, 1, fp2) != 1) {
+
+        memcpy(buf, header, PUB_HEADER_LEN);
+        if (fread(buf + PUB_HEADER_LEN, sb.st_size - PUB_HEADER_LEN, 1,
+                  fp2) != 1) {
             free(buf);
             fclose(fp2);
             OCK_SYSLOG(LOG_ERR,
                        "Cannot read token object %s " "(ignoring it)", fname);
             continue;
         }
+        fclose(fp2);
 
-        rc = restore_private_token_object(tokdata, header,
-                                          buf, size,
-                                          footer, NULL, fname);
+        rc = load_token_objects_add(lb, fname, buf, sb.st_size, TRUE);
         if (rc != CKR_OK)
-            goto error;
-
-        free(buf);
-        fclose(fp2);
+            break;
     }
 
     fclose(fp1);
-    return CKR_OK;
-error:
-    if (buf)
-        free(buf);
-    if (fp1)
-        fclose(fp1);
-    if (fp2)
-        fclose(fp2);
     return rc;
 }
 
 //
+// Loads the public or the private token objects.
 //
-CK_RV restore_private_token_object(STDLL_TokData_t *tokdata,
-                                   CK_BYTE *header,
-                                   CK_BYTE *data, CK_ULONG len,
-                                   CK_BYTE *footer,
-                                   OBJECT *pObj,
-                                   const char *fname)
+// Note: The token lock (XProcLock) must be held when calling this function.
+//
+static CK_RV load_token_objects(STDLL_TokData_t *tokdata, CK_BBOOL priv)
 {
-    unsigned char obj_iv[12], obj_key[32], obj_key_wrapped[40];
-    CK_BYTE *buff = NULL;
-    CK_RV rc;
-
-    if (tokdata->version < TOK_NEW_DATA_STORE)
-        return restore_private_token_object_old(tokdata, data, len, pObj,
-                                                fname);
+    struct load_batch *lb;
+    struct objdb *db;
+    CK_RV rc, rc2;
 
-    /* wrapped key */
-    memcpy(obj_key_wrapped, header + 8, 40);
-    /* iv */
-    memcpy(obj_iv, header + 48, 12);
-
-    rc = aes_256_unwrap(tokdata, obj_key, obj_key_wrapped, tokdata->master_key);
-    if (rc != CKR_OK) {
-        rc = CKR_FUNCTION_FAILED;
-        goto done;
-    }
+    rc = get_token_objdb(tokdata, &db);
+    if (rc != CKR_OK)
+        return rc;
 
-    buff = (CK_BYTE *)malloc(len);
-    if (buff == NULL) {
+    lb = calloc(1, sizeof(struct load_batch));
+    if (lb == NULL) {
         TRACE_ERROR("%s\n", ock_err(ERR_HOST_MEMORY));
-        rc = CKR_HOST_MEMORY;
-        goto done;
+        return CKR_HOST_MEMORY;
     }
+    lb->tokdata = tokdata;
+    lb->priv = priv;
 
-    rc = aes_256_gcm_unseal(tokdata,
-                            buff, /* plain-text */
-                            header, HEADER_LEN, /* aad */
-                            data, len, /* cipher-text*/
-                            footer, /* tag */
-                            obj_key, obj_iv);
-    if (rc != CKR_OK) {
-        rc = CKR_FUNCTION_FAILED;
-        goto done;
-    }
+    if (priv)
+        init_object_key_cache(tokdata);
 
-    rc = object_mgr_restore_obj(tokdata, buff, pObj, fname);
-    if (rc != CKR_OK) {
-        goto done;
-    }
+    if (db != NULL)
+        rc = objdb_for_each(db, load_token_object_cb, lb);
+    else
+        rc = load_token_objects_files(tokdata, lb);
 
-    rc = CKR_OK;
-done:
-    if (buff)
-        free(buff);
+    /* OBJ.DB records stay mapped until the object store is used again */
+    rc2 = load_token_objects_batch(lb);
+    if (rc == CKR_OK)
+        rc = rc2;
+
+    free(lb);
     return rc;
 }
 
+//
+// Note: The token lock (XProcLock) must be held when calling this function.
+//
+CK_RV load_private_token_objects(STDLL_TokData_t *tokdata)
+{
+    if (tokdata->version < TOK_NEW_DATA_STORE)
+        return load_private_token_objects_old(tokdata);
+
+    return load_token_objects(tokdata, TRUE);
+}
+
 CK_RV reload_token_object(STDLL_TokData_t *tokdata, OBJECT *obj)
 {
     unsigned char header[HEADER_LEN], footer[FOOTER_LEN];
@@ -2593,10 +3841,31 @@ CK_RV reload_token_object(STDLL_TokData_t *tokdata, OBJECT *obj)
     CK_RV rc;
     uint32_t len;
     uint32_t ver;
+    struct objdb *db;
+    CK_BYTE *rec;
+    CK_ULONG rec_len;
 
     if (tokdata->version < TOK_NEW_DATA_STORE)
         return reload_token_object_old(tokdata, obj);
 
+    rc = get_token_objdb(tokdata, &db);
+    if (rc != CKR_OK)
+        return rc;
+    if (db != NULL) {
+        memset(fname, 0x0, sizeof(fname));
+        memcpy(fname, obj->name, 8);
+
+        rc = objdb_get(db, fname, &rec, &rec_len);
+        if (rc != CKR_OK)
+            return rc;
+        if (rec == NULL) {
+            TRACE_ERROR("Token object %s not found\n", fname);
+            return CKR_FUNCTION_FAILED;
+        }
+        return restore_token_object_record(tokdata, rec, rec_len, obj,
+                                           fname);
+    }
+
     memset(fname, 0x0, sizeof(fname));
     sprintf(fname, "%s/%s/", tokdata->data_store, PK_LITE_OBJ_DIR);
     strncat(fname, (char *) obj->name, 8);
@@ -2667,33 +3936,16 @@ done:
     return rc;
 }
 
-/**
- * public tok obj layout
- *
- * ----------------           <--+
- * u32 tokversion                | 16-byte header
- * u8  private_flag              |
- * u8  reserved[7]               |
- * u32 object_len                |
- * ----------------           <--+
- * u8  object[object_len]        | body
- * ----------------           <--+
- */
-#define PUB_HEADER_LEN  16
-
 //
 // Note: The token lock (XProcLock) must be held when calling this function.
 //
 CK_RV save_public_token_object(STDLL_TokData_t *tokdata, OBJECT *obj)
 {
-    FILE *fp = NULL;
-    CK_BYTE *clear = NULL;
-    char fname[PATH_MAX];
+    CK_BYTE *clear = NULL, *data = NULL;
     CK_ULONG clear_len;
     CK_BBOOL flag = FALSE;
     CK_RV rc;
-    CK_ULONG_32 len, be_len;
-    unsigned char reserved[7] = {0};
+    CK_ULONG_32 len;
     uint32_t tmp;
 
     if (tokdata->version < TOK_NEW_DATA_STORE)
@@ -2705,36 +3957,27 @@ CK_RV save_public_token_object(STDLL_TokData_t *tokdata, OBJECT *obj)
     }
     len = (CK_ULONG_32)clear_len;
 
-    sprintf(fname, "%s/%s/", tokdata->data_store, PK_LITE_OBJ_DIR);
-    strncat(fname, (char *) obj->name, 8);
-
-    fp = fopen(fname, "w");
-    if (!fp) {
-        TRACE_ERROR("fopen(%s): %s\n", fname, strerror(errno));
-        rc = CKR_FUNCTION_FAILED;
+    data = calloc(1, PUB_HEADER_LEN + len);
+    if (data == NULL) {
+        rc = CKR_HOST_MEMORY;
         goto done;
     }
 
+    /* version */
     tmp = htobe32(tokdata->version);
-    be_len = htobe32(len);
-
-    set_perm(fileno(fp));
-    if (fwrite(&tmp, 4, 1, fp) != 1
-        || fwrite(&flag, 1, 1, fp) != 1
-        || fwrite(reserved, 7, 1, fp) != 1
-        || fwrite(&be_len, 4, 1, fp) != 1
-        || fwrite(clear, len, 1, fp) != 1) {
-        rc = CKR_FUNCTION_FAILED;
-        goto done;
-    }
+    memcpy(data, &tmp, 4);
+    /* flags, reserved */
+    memcpy(data + 4, &flag, 1);
+    /* object len */
+    tmp = htobe32(len);
+    memcpy(data + 12, &tmp, 4);
+    memcpy(data + PUB_HEADER_LEN, clear, len);
 
-    fclose(fp);
-    fp = NULL;
+    rc = write_token_object(tokdata, obj, data, PUB_HEADER_LEN + len);
 
-    rc = CKR_OK;
 done:
-    if (fp)
-        fclose(fp);
+    if (data)
+        free(data);
     if (clear)
         free(clear);
     return rc;
@@ -2745,82 +3988,8 @@ done:
 //
 CK_RV load_public_token_objects(STDLL_TokData_t *tokdata)
 {
-    FILE *fp1 = NULL, *fp2 = NULL;
-    CK_BYTE *buf = NULL;
-    char tmp[PATH_MAX];
-    char iname[PATH_MAX];
-    char fname[PATH_MAX];
-    CK_BBOOL priv;
-    CK_ULONG_32 size;
-    unsigned char header[PUB_HEADER_LEN];
-    uint32_t ver;
-
     if (tokdata->version < TOK_NEW_DATA_STORE)
         return load_public_token_objects_old(tokdata);
 
-    fp1 = open_token_object_index(iname, sizeof(iname), tokdata, "r");
-    if (!fp1)
-        return CKR_OK;          // no token objects
-
-    while (fgets(tmp, 50, fp1)) {
-        tmp[strlen(tmp) - 1] = 0;
-
-        sprintf(fname, "%s/%s/", tokdata->data_store, PK_LITE_OBJ_DIR);
-        strcat(fname, tmp);
-
-        fp2 = fopen(fname, "r");
-        if (!fp2)
-            continue;
-
-        if (fread(header, PUB_HEADER_LEN, 1, fp2) != 1) {
-            fclose(fp2);
-            OCK_SYSLOG(LOG_ERR, "Cannot read header\n");
-            continue;
-        }
-
-        memcpy(&ver, header, 4);
-        memcpy(&priv, header + 4, 1);
-        memcpy(&size, header + 12, 4);
-
-        /*
-         * In OCK 3.12 - 3.14 the version and size was not stored in BE. So if
-         * version field is in platform endianness, keep size as is also
-         */
-        if (ver != TOK_NEW_DATA_STORE)
-            size = be32toh(size);
-
-        if (priv == TRUE) {
-            fclose(fp2);
-            continue;
-        }
-
-        buf = (CK_BYTE *) malloc(size);
-        if (!buf) {
-            fclose(fp2);
-            OCK_SYSLOG(LOG_ERR,
-                       "Cannot malloc %u bytes to read in "
-                       "token object %s (ignoring it)", size, fname);
-            continue;
-        }
-
-        if (fread(buf, size, 1, fp2) != 1) {
-            fclose(fp2);
-            free(buf);
-            OCK_SYSLOG(LOG_ERR,
-                       "Cannot read token object %s " "(ignoring it)", fname);
-            continue;
-        }
-        // ... grab object mutex here.
-        if (object_mgr_restore_obj_withSize(tokdata,
-                                            buf, NULL, size, fname) != CKR_OK) {
-            OCK_SYSLOG(LOG_ERR,
-                       "Cannot restore token object %s "
-                       "(ignoring it)", fname);
-        }
-        free(buf);
-        fclose(fp2);
-    }
-
-    fclose(fp1);
-    return CKR_OK;
+    return load_token_objects(tokdata, FALSE);
 }
@@ -3485,6 +3485,244 @@ void aes_gcm_param_from_compat(const CK_GCM_PARAMS_COMPAT *from,
     to->ulTagBits = from->ulTagBits;
 }
 
+/*
+ * Fill the non-fixed trailing bits of the IV of a message based AES-GCM
+ * encryption according to the IV generator function of the message.
+ */
+static CK_RV aes_gcm_msg_generate_iv(STDLL_TokData_t *tokdata,
+                                     AES_GCM_MSG_CONTEXT *context,
+                                     CK_GCM_MESSAGE_PARAMS *param)
+{
+    CK_ULONG free_bits, bits, first, ctr, i, j;
+    CK_BYTE mask, val, save, base;
+    CK_RV rc;
+
+    free_bits = param->ulIvLen * 8 - param->ulIvFixedBits;
+    first = param->ulIvFixedBits / 8;
+
+    switch (param->ivGenerator) {
+    case CKG_NO_GENERATE:
+        return CKR_OK;
+    case CKG_GENERATE:
+    case CKG_GENERATE_RANDOM:
+        if (free_bits == 0)
+            return CKR_OK;
+
+        save = param->pIv[first];
+        rc = rng_generate(tokdata, param->pIv + first, param->ulIvLen - first);
+        if (rc != CKR_OK) {
+            TRACE_DEVEL("rng_generate failed.\n");
+            return rc;
+        }
+
+        /* Restore the fixed bits of a partially fixed byte */
+        mask = 0xff >> (param->ulIvFixedBits % 8);
+        param->pIv[first] = (save & ~mask) | (param->pIv[first] & mask);
+        return CKR_OK;
+    case CKG_GENERATE_COUNTER:
+    case CKG_GENERATE_COUNTER_XOR:
+        if (free_bits < sizeof(context->iv_counter) * 8 &&
+            (context->iv_counter >> free_bits) != 0) {
+            TRACE_ERROR("IV counter exhausted for the non-fixed IV bits\n");
+            return CKR_MECHANISM_PARAM_INVALID;
+        }
+
+        /*
+         * The counter is XORed into the IV of the first message, not into
+         * the IV of the previous one, which the caller's buffer holds when
+         * the message parameters are reused. The counter only changes the
+         * trailing sizeof(CK_ULONG) bytes.
+         */
+        if (param->ivGenerator == CKG_GENERATE_COUNTER_XOR &&
+            context->iv_counter == 0) {
+            context->iv_base_len = MIN(param->ulIvLen,
+                                       sizeof(context->iv_base));
+            memcpy(context->iv_base,
+                   param->pIv + param->ulIvLen - context->iv_base_len,
+                   context->iv_base_len);
+        }
+
+        ctr = context->iv_counter;
+        for (i = param->ulIvLen, j = 0, bits = free_bits; i > 0 && bits > 0;
+             i--, j++) {
+            mask = bits >= 8 ? 0xff : (0xff >> (8 - bits));
+            val = ctr & mask;
+            ctr >>= 8;
+            bits -= bits >= 8 ? 8 : bits;
+
+            if (param->ivGenerator == CKG_GENERATE_COUNTER_XOR) {
+                base = j < context->iv_base_len ?
+                    context->iv_base[context->iv_base_len - 1 - j] :
+                    param->pIv[i - 1];
+                param->pIv[i - 1] = base ^ val;
+            } else {
+                param->pIv[i - 1] = (param->pIv[i - 1] & ~mask) | val;
+            }
+        }
+
+        context->iv_counter++;
+        return CKR_OK;
+    default:
+        TRACE_ERROR("Unsupported IV generator 0x%lx\n", param->ivGenerator);
+        return CKR_MECHANISM_PARAM_INVALID;
+    }
+}
+
+static CK_RV aes_gcm_msg_check_param(CK_VOID_PTR param, CK_ULONG param_len)
+{
+    CK_GCM_MESSAGE_PARAMS *gcm_param = (CK_GCM_MESSAGE_PARAMS *)param;
+    CK_ULONG tag_len;
+
+    if (param == NULL || param_len != sizeof(CK_GCM_MESSAGE_PARAMS)) {
+        TRACE_ERROR("%s\n", ock_err(ERR_MECHANISM_PARAM_INVALID));
+        return CKR_MECHANISM_PARAM_INVALID;
+    }
+
+    if (gcm_param->pIv == NULL || gcm_param->ulIvLen == 0 ||
+        gcm_param->ulIvFixedBits > gcm_param->ulIvLen * 8) {
+        TRACE_ERROR("Invalid IV in the GCM message parameters.\n");
+        return CKR_MECHANISM_PARAM_INVALID;
+    }
+
+    tag_len = (gcm_param->ulTagBits + 7) / 8;
+    if (gcm_param->pTag == NULL || tag_len == 0 || tag_len > AES_BLOCK_SIZE) {
+        TRACE_ERROR("Invalid tag in the GCM message parameters.\n");
+        return CKR_MECHANISM_PARAM_INVALID;
+    }
+
+    return CKR_OK;
+}
+
+CK_RV aes_gcm_msg_init(STDLL_TokData_t *tokdata, SESSION *sess,
+                       ENCR_DECR_CONTEXT *ctx, CK_MECHANISM *mech,
+                       CK_OBJECT_HANDLE key, CK_BYTE direction)
+{
+    if (token_specific.t_aes_gcm_msg_init == NULL) {
+        TRACE_ERROR("%s\n", ock_err(ERR_MECHANISM_INVALID));
+        return CKR_MECHANISM_INVALID;
+    }
+
+    return token_specific.t_aes_gcm_msg_init(tokdata, sess, ctx, mech, key,
+                                             direction);
+}
+
+CK_RV aes_gcm_msg_begin(STDLL_TokData_t *tokdata, SESSION *sess,
+                        ENCR_DECR_CONTEXT *ctx,
+                        CK_VOID_PTR param, CK_ULONG param_len,
+                        CK_BYTE *aad, CK_ULONG aad_len, CK_BYTE direction)
+{
+    AES_GCM_MSG_CONTEXT *context;
+    CK_GCM_MESSAGE_PARAMS *gcm_param = (CK_GCM_MESSAGE_PARAMS *)param;
+    CK_RV rc;
+
+    if (!sess || !ctx || (!aad && aad_len != 0)) {
+        TRACE_ERROR("%s received bad argument(s)\n", __func__);
+        return CKR_FUNCTION_FAILED;
+    }
+
+    context = (AES_GCM_MSG_CONTEXT *)ctx->context;
+    if (context->in_message) {
+        TRACE_ERROR("%s\n", ock_err(ERR_OPERATION_ACTIVE));
+        return CKR_OPERATION_ACTIVE;
+    }
+
+    rc = aes_gcm_msg_check_param(param, param_len);
+    if (rc != CKR_OK)
+        return rc;
+
+    if (token_specific.t_aes_gcm_msg_begin == NULL) {
+        TRACE_ERROR("%s\n", ock_err(ERR_MECHANISM_INVALID));
+        return CKR_MECHANISM_INVALID;
+    }
+
+    /* The IV of a message to decrypt is always supplied by the caller */
+    if (direction) {
+        rc = aes_gcm_msg_generate_iv(tokdata, context, gcm_param);
+        if (rc != CKR_OK)
+            return rc;
+    }
+
+    rc = token_specific.t_aes_gcm_msg_begin(tokdata, sess, ctx, gcm_param,
+                                            aad, aad_len, direction);
+    if (rc != CKR_OK) {
+        TRACE_ERROR("Token specific AES GCM message begin failed: %02lx\n",
+                    rc);
+        return rc;
+    }
+
+    context->tag_len = (gcm_param->ulTagBits + 7) / 8;
+    context->in_message = TRUE;
+
+    return CKR_OK;
+}
+
+CK_RV aes_gcm_msg_next(STDLL_TokData_t *tokdata, SESSION *sess,
+                       CK_BBOOL length_only, ENCR_DECR_CONTEXT *ctx,
+                       CK_VOID_PTR param, CK_ULONG param_len,
+                       CK_BYTE *in_data, CK_ULONG in_data_len,
+                       CK_BYTE *out_data, CK_ULONG *out_data_len,
+                       CK_FLAGS flags, CK_BYTE direction)
+{
+    AES_GCM_MSG_CONTEXT *context;
+    CK_RV rc;
+
+    if (!sess || !ctx || (!in_data && in_data_len != 0) || !out_data_len) {
+        TRACE_ERROR("%s received bad argument(s)\n", __func__);
+        return CKR_FUNCTION_FAILED;
+    }
+
+    /* GCM is a stream mode, every message part is output immediately */
+    if (length_only) {
+        *out_data_len = in_data_len;
+        return CKR_OK;
+    }
+
+    if (*out_data_len < in_data_len) {
+        *out_data_len = in_data_len;
+        TRACE_ERROR("%s\n", ock_err(ERR_BUFFER_TOO_SMALL));
+        return CKR_BUFFER_TOO_SMALL;
+    }
+
+    context = (AES_GCM_MSG_CONTEXT *)ctx->context;
+    if (!context->in_message) {
+        TRACE_ERROR("%s\n", ock_err(ERR_OPERATION_NOT_INITIALIZED));
+        return CKR_OPERATION_NOT_INITIALIZED;
+    }
+
+    rc = aes_gcm_msg_check_param(param, param_len);
+    if (rc != CKR_OK)
+        goto done;
+
+    if ((((CK_GCM_MESSAGE_PARAMS *)param)->ulTagBits + 7) / 8 !=
+                                                        context->tag_len) {
+        TRACE_ERROR("Tag length changed within a message.\n");
+        rc = CKR_MECHANISM_PARAM_INVALID;
+        goto done;
+    }
+
+    if (token_specific.t_aes_gcm_msg_next == NULL) {
+        TRACE_ERROR("%s\n", ock_err(ERR_MECHANISM_INVALID));
+        rc = CKR_MECHANISM_INVALID;
+        goto done;
+    }
+
+    rc = token_specific.t_aes_gcm_msg_next(tokdata, sess, ctx,
+                                           (CK_GCM_MESSAGE_PARAMS *)param,
+                                           in_data, in_data_len,
+                                           out_data, out_data_len,
+                                           flags, direction);
+    if (rc != CKR_OK)
+        TRACE_ERROR("Token specific AES GCM message next failed: %02lx\n",
+                    rc);
+
+done:
+    /* Any error ends the current message, but not the message operation */
+    if (rc != CKR_OK || (flags & CKF_END_OF_MESSAGE))
+        context->in_message = FALSE;
+
+    return rc;
+}
+
 //
 // mechanisms
 //
@@ -853,6 +853,168 @@ out:
     return NULL;
 }
 
+/*
+ * The EVP_PKEYs built from a key object's template are cached with the
+ * object, so that repeated operations with the same key do not have to
+ * convert the key attributes again. The cache is dropped by the object
+ * manager whenever the object's template changes.
+ */
+enum openssl_pkey_slot {
+    OPENSSL_PKEY_PUBLIC = 0,
+    OPENSSL_PKEY_PRIVATE,
+    OPENSSL_PKEY_NUM_SLOTS,
+};
+
+/*
+ * Secret keys cache one keyed EVP_CIPHER_CTX per cipher mode and direction.
+ * These contexts already carry the expanded key schedule and are never used
+ * for a cipher operation themselves, they are only copied from.
+ */
+enum openssl_cipher_slot {
+    OPENSSL_CIPHER_ECB = 0,
+    OPENSSL_CIPHER_CBC,
+    OPENSSL_CIPHER_CTR,
+    OPENSSL_CIPHER_OFB,
+    OPENSSL_CIPHER_CFB8,
+    OPENSSL_CIPHER_CFB64,
+    OPENSSL_CIPHER_CFB128,
+    OPENSSL_CIPHER_NUM_SLOTS,
+};
+
+/*
+ * Secret keys used for HMAC cache one EVP_MD_CTX per digest, set up with
+ * EVP_DigestSignInit. The HMAC inner and outer pads are already absorbed into
+ * these contexts. Like the cipher contexts they are only copied from.
+ */
+enum openssl_hmac_slot {
+    OPENSSL_HMAC_SHA1 = 0,
+    OPENSSL_HMAC_SHA224,
+    OPENSSL_HMAC_SHA256,
+    OPENSSL_HMAC_SHA384,
+    OPENSSL_HMAC_SHA512,
+    OPENSSL_HMAC_SHA512_224,
+    OPENSSL_HMAC_SHA512_256,
+    OPENSSL_HMAC_SHA3_224,
+    OPENSSL_HMAC_SHA3_256,
+    OPENSSL_HMAC_SHA3_384,
+    OPENSSL_HMAC_SHA3_512,
+    OPENSSL_HMAC_NUM_SLOTS,
+};
+
+struct openssl_ex_data {
+    OBJ_EX_DATA ex_data;
+    EVP_PKEY *pkey[OPENSSL_PKEY_NUM_SLOTS];
+    EVP_CIPHER_CTX *cipher_ctx[OPENSSL_CIPHER_NUM_SLOTS][2];
+    EVP_MD_CTX *hmac_ctx[OPENSSL_HMAC_NUM_SLOTS];
+    /* CMAC key with its expanded key schedule, only copied from as well */
+#if !OPENSSL_VERSION_PREREQ(3, 0)
+    EVP_PKEY *cmac_pkey;
+#else
+    EVP_MAC_CTX *cmac_ctx;
+#endif
+};
+
+static void openssl_free_ex_data(OBJ_EX_DATA *ex_data)
+{
+    struct openssl_ex_data *data = (struct openssl_ex_data *)ex_data;
+    int i;
+
+    for (i = 0; i < OPENSSL_PKEY_NUM_SLOTS; i++) {
+        if (data->pkey[i] != NULL)
+            EVP_PKEY_free(data->pkey[i]);
+    }
+
+    for (i = 0; i < OPENSSL_CIPHER_NUM_SLOTS; i++) {
+        if (data->cipher_ctx[i][0] != NULL)
+            EVP_CIPHER_CTX_free(data->cipher_ctx[i][0]);
+        if (data->cipher_ctx[i][1] != NULL)
+            EVP_CIPHER_CTX_free(data->cipher_ctx[i][1]);
+    }
+
+    for (i = 0; i < OPENSSL_HMAC_NUM_SLOTS; i++) {
+        if (data->hmac_ctx[i] != NULL)
+            EVP_MD_CTX_free(data->hmac_ctx[i]);
+    }
+
+#if !OPENSSL_VERSION_PREREQ(3, 0)
+    if (data->cmac_pkey != NULL)
+        EVP_PKEY_free(data->cmac_pkey);
+#else
+    if (data->cmac_ctx != NULL)
+        EVP_MAC_CTX_free(data->cmac_ctx);
+#endif
+
+    free(data);
+}
+
+/*
+ * Returns a new reference to the EVP_PKEY cached in the given slot of the
+ * key object, building it via make_pkey on first use. The caller must hold
+ * the object's read lock and must free the returned key with EVP_PKEY_free.
+ */
+static CK_RV openssl_get_pkey(OBJECT *key_obj, enum openssl_pkey_slot slot,
+                              CK_RV (*make_pkey)(OBJECT *key_obj,
+                                                 EVP_PKEY **pkey),
+                              EVP_PKEY **pkey)
+{
+    struct openssl_ex_data *data;
+    EVP_PKEY *cached, *new_pkey = NULL;
+    CK_RV rc;
+
+    data = (struct openssl_ex_data *)object_ex_data_get(key_obj,
+                                                       sizeof(*data),
+                                                       openssl_free_ex_data);
+    if (data == NULL) {
+        /* Can not cache, build a private copy */
+        return make_pkey(key_obj, pkey);
+    }
+
+    cached = __atomic_load_n(&data->pkey[slot], __ATOMIC_ACQUIRE);
+    if (cached == NULL) {
+        rc = make_pkey(key_obj, &new_pkey);
+        if (rc != CKR_OK)
+            return rc;
+
+        if (__sync_bool_compare_and_swap(&data->pkey[slot], NULL, new_pkey)) {
+            cached = new_pkey;
+        } else {
+            /* Another thread was faster */
+            EVP_PKEY_free(new_pkey);
+            cached = __atomic_load_n(&data->pkey[slot], __ATOMIC_ACQUIRE);
+        }
+    }
+
+    if (EVP_PKEY_up_ref(cached) != 1) {
+        TRACE_ERROR("EVP_PKEY_up_ref failed\n");
+        return CKR_FUNCTION_FAILED;
+    }
+
+    *pkey = cached;
+    return CKR_OK;
+}
+
+static CK_RV rsa_make_public_pkey(OBJECT *key_obj, EVP_PKEY **pkey)
+{
+    *pkey = rsa_convert_public_key(key_obj);
+    if (*pkey == NULL) {
+        TRACE_ERROR("%s\n", ock_err(ERR_FUNCTION_FAILED));
+        return CKR_FUNCTION_FAILED;
+    }
+
+    return CKR_OK;
+}
+
+static CK_RV rsa_make_private_pkey(OBJECT *key_obj, EVP_PKEY **pkey)
+{
+    *pkey = rsa_convert_private_key(key_obj);
+    if (*pkey == NULL) {
+        TRACE_ERROR("%s\n", ock_err(ERR_FUNCTION_FAILED));
+        return CKR_FUNCTION_FAILED;
+    }
+
+    return CKR_OK;
+}
+
 CK_RV openssl_specific_rsa_encrypt(STDLL_TokData_t *tokdata, CK_BYTE *in_data,
                                    CK_ULONG in_data_len, CK_BYTE *out_data,
                                    OBJECT *key_obj)
@@ -864,12 +1026,10 @@ CK_RV openssl_specific_rsa_encrypt(STDLL_TokData_t *tokdata, CK_BYTE *in_data,
 
     UNUSED(tokdata);
 
-    pkey = rsa_convert_public_key(key_obj);
-    if (pkey == NULL) {
-        TRACE_ERROR("%s\n", ock_err(ERR_FUNCTION_FAILED));
-        rc = CKR_FUNCTION_FAILED;
+    rc = openssl_get_pkey(key_obj, OPENSSL_PKEY_PUBLIC, rsa_make_public_pkey,
+                          &pkey);
+    if (rc != CKR_OK)
         return rc;
-    }
 
     ctx = EVP_PKEY_CTX_new(pkey, NULL);
     if (ctx == NULL) {
@@ -915,12 +1075,10 @@ CK_RV openssl_specific_rsa_decrypt(STDLL_TokData_t *tokdata, CK_BYTE *in_data,
 
     UNUSED(tokdata);
 
-    pkey = rsa_convert_private_key(key_obj);
-    if (pkey == NULL) {
-        TRACE_ERROR("%s\n", ock_err(ERR_FUNCTION_FAILED));
-        rc = CKR_FUNCTION_FAILED;
+    rc = openssl_get_pkey(key_obj, OPENSSL_PKEY_PRIVATE, rsa_make_private_pkey,
+                          &pkey);
+    if (rc != CKR_OK)
         return rc;
-    }
 
     ctx = EVP_PKEY_CTX_new(pkey, NULL);
     if (ctx == NULL) {
@@ -2403,6 +2561,11 @@ out:
     return rc;
 }
 
+static CK_RV ec_make_pkey(OBJECT *key_obj, EVP_PKEY **pkey)
+{
+    return openssl_make_ec_key_from_template(key_obj->template, pkey);
+}
+
 CK_RV openssl_specific_ec_sign(STDLL_TokData_t *tokdata,  SESSION *sess,
                                CK_BYTE *in_data, CK_ULONG in_data_len,
                                CK_BYTE *out_data, CK_ULONG *out_data_len,
@@ -2423,7 +2586,8 @@ CK_RV openssl_specific_ec_sign(STDLL_TokData_t *tokdata,  SESSION *sess,
 
     *out_data_len = 0;
 
-    rc = openssl_make_ec_key_from_template(key_obj->template, &ec_key);
+    rc = openssl_get_pkey(key_obj, OPENSSL_PKEY_PRIVATE, ec_make_pkey,
+                          &ec_key);
     if (rc != CKR_OK)
         return rc;
 
@@ -2519,7 +2683,8 @@ CK_RV openssl_specific_ec_verify(STDLL_TokData_t *tokdata,
     UNUSED(tokdata);
     UNUSED(sess);
 
-    rc = openssl_make_ec_key_from_template(key_obj->template, &ec_key);
+    rc = openssl_get_pkey(key_obj, OPENSSL_PKEY_PUBLIC, ec_make_pkey,
+                          &ec_key);
     if (rc != CKR_OK)
         return rc;
 
@@ -2864,6 +3029,26 @@ static void openssl_specific_sha_free(STDLL_TokData_t *tokdata, SESSION *sess,
 
     EVP_MD_CTX_free((EVP_MD_CTX *)context);
 }
+
+/*
+ * Ends the operation of the digest context. Its EVP_MD_CTX is kept in the
+ * pool of the context, so that the next operation does not have to allocate
+ * a new one. EVP_DigestInit_ex re-initializes it, and keeps the digest
+ * implementation's internal context if the digest is the same.
+ */
+static void openssl_specific_sha_done(DIGEST_CONTEXT *ctx)
+{
+    if (ctx->pool_context == NULL) {
+        ctx->pool_context = ctx->context;
+        ctx->pool_context_free_func = openssl_specific_sha_free;
+    } else {
+        EVP_MD_CTX_free((EVP_MD_CTX *)ctx->context);
+    }
+
+    ctx->context = NULL;
+    ctx->context_len = 0;
+    ctx->context_free_func = NULL;
+}
 #endif
 
 CK_RV openssl_specific_sha_init(STDLL_TokData_t *tokdata, DIGEST_CONTEXT *ctx,
@@ -2890,10 +3075,16 @@ CK_RV openssl_specific_sha_init(STDLL_TokData_t *tokdata, DIGEST_CONTEXT *ctx,
     EVP_MD_CTX_free(md_ctx);
 #else
     ctx->context_len = 1;
-    ctx->context = (CK_BYTE *)EVP_MD_CTX_new();
-    if (ctx->context == NULL) {
-        TRACE_ERROR("%s\n", ock_err(ERR_HOST_MEMORY));
-        return CKR_HOST_MEMORY;
+    if (ctx->pool_context != NULL) {
+        ctx->context = ctx->pool_context;
+        ctx->pool_context = NULL;
+        ctx->pool_context_free_func = NULL;
+    } else {
+        ctx->context = (CK_BYTE *)EVP_MD_CTX_new();
+        if (ctx->context == NULL) {
+            TRACE_ERROR("%s\n", ock_err(ERR_HOST_MEMORY));
+            return CKR_HOST_MEMORY;
+        }
     }
 
     md = md_from_mech(&ctx->mech);
@@ -2901,6 +3092,7 @@ CK_RV openssl_specific_sha_init(STDLL_TokData_t *tokdata, DIGEST_CONTEXT *ctx,
         !EVP_DigestInit_ex((EVP_MD_CTX *)ctx->context, md, NULL)) {
         TRACE_ERROR("%s\n", ock_err(ERR_FUNCTION_FAILED));
         EVP_MD_CTX_free((EVP_MD_CTX *)ctx->context);
+        ctx->context = NULL;
         return CKR_FUNCTION_FAILED;
     }
 
@@ -2968,12 +3160,12 @@ CK_RV openssl_specific_sha(STDLL_TokData_t *tokdata, DIGEST_CONTEXT *ctx,
 out:
     EVP_MD_CTX_free(md_ctx);
     free(ctx->context);
-#else
-    EVP_MD_CTX_free((EVP_MD_CTX *)ctx->context);
-#endif
     ctx->context = NULL;
     ctx->context_len = 0;
     ctx->context_free_func = NULL;
+#else
+    openssl_specific_sha_done(ctx);
+#endif
 
     return rc;
 }
@@ -3079,10 +3271,7 @@ out:
 
     *out_data_len = len;
 
-    EVP_MD_CTX_free((EVP_MD_CTX *)ctx->context);
-    ctx->context = NULL;
-    ctx->context_len = 0;
-    ctx->context_free_func = NULL;
+    openssl_specific_sha_done(ctx);
 #endif
 
     return rc;
@@ -3245,6 +3434,118 @@ static const EVP_CIPHER *openssl_cipher_from_mech(CK_MECHANISM_TYPE mech,
     return NULL;
 }
 
+static int openssl_cipher_slot_from_mech(CK_MECHANISM_TYPE mech)
+{
+    switch (mech) {
+    case CKM_DES_ECB:
+    case CKM_DES3_ECB:
+    case CKM_AES_ECB:
+        return OPENSSL_CIPHER_ECB;
+    case CKM_DES_CBC:
+    case CKM_DES3_CBC:
+    case CKM_AES_CBC:
+        return OPENSSL_CIPHER_CBC;
+    case CKM_AES_CTR:
+        return OPENSSL_CIPHER_CTR;
+    case CKM_DES_OFB64:
+    case CKM_AES_OFB:
+        return OPENSSL_CIPHER_OFB;
+    case CKM_DES_CFB8:
+    case CKM_AES_CFB8:
+        return OPENSSL_CIPHER_CFB8;
+    case CKM_DES_CFB64:
+        return OPENSSL_CIPHER_CFB64;
+    case CKM_AES_CFB128:
+        return OPENSSL_CIPHER_CFB128;
+    default:
+        return -1;
+    }
+}
+
+static EVP_CIPHER_CTX *openssl_cipher_make_ctx(const EVP_CIPHER *cipher,
+                                               CK_ATTRIBUTE *key_attr,
+                                               CK_BYTE encrypt)
+{
+    EVP_CIPHER_CTX *ctx;
+
+    ctx = EVP_CIPHER_CTX_new();
+    if (ctx == NULL) {
+        TRACE_ERROR("%s\n", ock_err(ERR_HOST_MEMORY));
+        return NULL;
+    }
+
+    if (EVP_CipherInit_ex(ctx, cipher, NULL, key_attr->pValue,
+                          NULL, encrypt ? 1 : 0) != 1
+        || EVP_CIPHER_CTX_set_padding(ctx, 0) != 1) {
+        TRACE_ERROR("%s\n", ock_err(ERR_GENERAL_ERROR));
+        EVP_CIPHER_CTX_free(ctx);
+        return NULL;
+    }
+
+    return ctx;
+}
+
+/*
+ * Returns a new cipher context that is keyed for the given mechanism and
+ * direction, but has no IV set yet. The context is copied from the keyed
+ * context cached with the key object, so that the key schedule is only
+ * computed once per key, and not on every (chunk of a) cipher operation.
+ * The caller must hold the object's read lock and must free the returned
+ * context with EVP_CIPHER_CTX_free.
+ */
+static CK_RV openssl_cipher_get_ctx(OBJECT *key, CK_MECHANISM_TYPE mech,
+                                    const EVP_CIPHER *cipher,
+                                    CK_ATTRIBUTE *key_attr, CK_BYTE encrypt,
+                                    EVP_CIPHER_CTX **ctx)
+{
+    struct openssl_ex_data *data = NULL;
+    EVP_CIPHER_CTX *cached, *new_ctx;
+    int slot, dir = encrypt ? 1 : 0;
+
+    slot = openssl_cipher_slot_from_mech(mech);
+    if (slot >= 0)
+        data = (struct openssl_ex_data *)object_ex_data_get(key,
+                                                       sizeof(*data),
+                                                       openssl_free_ex_data);
+    if (data == NULL) {
+        /* Can not cache, build a private context */
+        *ctx = openssl_cipher_make_ctx(cipher, key_attr, encrypt);
+        return *ctx != NULL ? CKR_OK : CKR_FUNCTION_FAILED;
+    }
+
+    cached = __atomic_load_n(&data->cipher_ctx[slot][dir], __ATOMIC_ACQUIRE);
+    if (cached == NULL) {
+        new_ctx = openssl_cipher_make_ctx(cipher, key_attr, encrypt);
+        if (new_ctx == NULL)
+            return CKR_FUNCTION_FAILED;
+
+        if (__sync_bool_compare_and_swap(&data->cipher_ctx[slot][dir],
+                                         NULL, new_ctx)) {
+            cached = new_ctx;
+        } else {
+            /* Another thread was faster */
+            EVP_CIPHER_CTX_free(new_ctx);
+            cached = __atomic_load_n(&data->cipher_ctx[slot][dir],
+                                     __ATOMIC_ACQUIRE);
+        }
+    }
+
+    *ctx = EVP_CIPHER_CTX_new();
+    if (*ctx == NULL) {
+        TRACE_ERROR("%s\n", ock_err(ERR_HOST_MEMORY));
+        return CKR_HOST_MEMORY;
+    }
+
+    if (EVP_CIPHER_CTX_copy(*ctx, cached) != 1) {
+        TRACE_ERROR("EVP_CIPHER_CTX_copy failed\n");
+        EVP_CIPHER_CTX_free(*ctx);
+        *ctx = NULL;
+        return CKR_FUNCTION_FAILED;
+    }
+
+    return CKR_OK;
+}
+
 static CK_RV openssl_cipher_perform(OBJECT *key, CK_MECHANISM_TYPE mech,
                                     CK_BYTE *in_data,  CK_ULONG in_data_len,
                                     CK_BYTE *out_data, CK_ULONG *out_data_len,
@@ -3286,15 +3587,12 @@ static CK_RV openssl_cipher_perform(OBJECT *key, CK_MECHANISM_TYPE mech,
         return CKR_DATA_LEN_RANGE;
     }
 
-    ctx = EVP_CIPHER_CTX_new();
-    if (ctx == NULL) {
-        TRACE_ERROR("%s\n", ock_err(ERR_HOST_MEMORY));
-        return CKR_HOST_MEMORY;
-    }
+    rc = openssl_cipher_get_ctx(key, mech, cipher, key_attr, encrypt, &ctx);
+    if (rc != CKR_OK)
+        return rc;
 
-    if (EVP_CipherInit_ex(ctx, cipher, NULL, key_attr->pValue,
-                          init_v, encrypt ? 1 : 0) != 1
-        || EVP_CIPHER_CTX_set_padding(ctx, 0) != 1
+    /* Only (re-)set the IV, the key schedule is kept from the copy */
+    if (EVP_CipherInit_ex(ctx, NULL, NULL, NULL, init_v, encrypt ? 1 : 0) != 1
         || EVP_CipherUpdate(ctx, out_data, &outlen, in_data, in_data_len) != 1
         || EVP_CipherFinal_ex(ctx, out_data, &outlen) != 1) {
         TRACE_ERROR("%s\n", ock_err(ERR_GENERAL_ERROR));
@@ -3323,6 +3621,144 @@ done:
     return rc;
 }
 
+#if !OPENSSL_VERSION_PREREQ(3, 0)
+static EVP_PKEY *openssl_cmac_make_pkey(const EVP_CIPHER *cipher,
+                                        CK_ATTRIBUTE *key_attr)
+{
+    EVP_PKEY *pkey;
+
+    pkey = EVP_PKEY_new_CMAC_key(NULL, key_attr->pValue,
+                                 key_attr->ulValueLen, cipher);
+    if (pkey == NULL)
+        TRACE_ERROR("EVP_PKEY_new_CMAC_key failed\n");
+
+    return pkey;
+}
+
+/*
+ * Returns a new reference to the CMAC key cached with the key object. The
+ * EVP_PKEY holds the expanded key schedule, EVP_DigestSignInit only copies
+ * it. The caller must hold the object's read lock and must free the returned
+ * key with EVP_PKEY_free.
+ */
+static CK_RV openssl_cmac_get_pkey(OBJECT *key, const EVP_CIPHER *cipher,
+                                   CK_ATTRIBUTE *key_attr, EVP_PKEY **pkey)
+{
+    struct openssl_ex_data *data;
+    EVP_PKEY *cached, *new_pkey;
+
+    data = (struct openssl_ex_data *)object_ex_data_get(key, sizeof(*data),
+                                                       openssl_free_ex_data);
+    if (data == NULL) {
+        /* Can not cache, build a private key */
+        *pkey = openssl_cmac_make_pkey(cipher, key_attr);
+        return *pkey != NULL ? CKR_OK : CKR_FUNCTION_FAILED;
+    }
+
+    cached = __atomic_load_n(&data->cmac_pkey, __ATOMIC_ACQUIRE);
+    if (cached == NULL) {
+        new_pkey = openssl_cmac_make_pkey(cipher, key_attr);
+        if (new_pkey == NULL)
+            return CKR_FUNCTION_FAILED;
+
+        if (__sync_bool_compare_and_swap(&data->cmac_pkey, NULL, new_pkey)) {
+            cached = new_pkey;
+        } else {
+            /* Another thread was faster */
+            EVP_PKEY_free(new_pkey);
+            cached = __atomic_load_n(&data->cmac_pkey, __ATOMIC_ACQUIRE);
+        }
+    }
+
+    if (EVP_PKEY_up_ref(cached) != 1) {
+        TRACE_ERROR("EVP_PKEY_up_ref failed\n");
+        return CKR_FUNCTION_FAILED;
+    }
+
+    *pkey = cached;
+    return CKR_OK;
+}
+#else
+static EVP_MAC_CTX *openssl_cmac_make_ctx(const EVP_CIPHER *cipher,
+                                          CK_ATTRIBUTE *key_attr)
+{
+    EVP_MAC *mac;
+    EVP_MAC_CTX *mctx;
+    OSSL_PARAM params[2];
+
+    mac = EVP_MAC_fetch(NULL, "CMAC", NULL);
+    if (mac == NULL) {
+        TRACE_ERROR("%s\n", ock_err(ERR_FUNCTION_FAILED));
+        return NULL;
+    }
+
+    /* The context keeps its own reference to the MAC */
+    mctx = EVP_MAC_CTX_new(mac);
+    EVP_MAC_free(mac);
+    if (mctx == NULL) {
+        TRACE_ERROR("%s\n", ock_err(ERR_HOST_MEMORY));
+        return NULL;
+    }
+
+    params[0] = OSSL_PARAM_construct_utf8_string(OSSL_MAC_PARAM_CIPHER,
+                                      (char *)EVP_CIPHER_get0_name(cipher), 0);
+    params[1] = OSSL_PARAM_construct_end();
+
+    if (!EVP_MAC_init(mctx, key_attr->pValue, key_attr->ulValueLen, params)) {
+        TRACE_ERROR("%s\n", ock_err(ERR_FUNCTION_FAILED));
+        EVP_MAC_CTX_free(mctx);
+        return NULL;
+    }
+
+    return mctx;
+}
+
+/*
+ * Returns a new CMAC context that is keyed with the given key. The context
+ * is duplicated from the keyed context cached with the key object, so that
+ * the key schedule is only computed once per key. The caller must hold the
+ * object's read lock and must free the returned context with
+ * EVP_MAC_CTX_free.
+ */
+static CK_RV openssl_cmac_get_ctx(OBJECT *key, const EVP_CIPHER *cipher,
+                                  CK_ATTRIBUTE *key_attr, EVP_MAC_CTX **mctx)
+{
+    struct openssl_ex_data *data;
+    EVP_MAC_CTX *cached, *new_ctx;
+
+    data = (struct openssl_ex_data *)object_ex_data_get(key, sizeof(*data),
+                                                       openssl_free_ex_data);
+    if (data == NULL) {
+        /* Can not cache, build a private context */
+        *mctx = openssl_cmac_make_ctx(cipher, key_attr);
+        return *mctx != NULL ? CKR_OK : CKR_FUNCTION_FAILED;
+    }
+
+    cached = __atomic_load_n(&data->cmac_ctx, __ATOMIC_ACQUIRE);
+    if (cached == NULL) {
+        new_ctx = openssl_cmac_make_ctx(cipher, key_attr);
+        if (new_ctx == NULL)
+            return CKR_FUNCTION_FAILED;
+
+        if (__sync_bool_compare_and_swap(&data->cmac_ctx, NULL, new_ctx)) {
+            cached = new_ctx;
+        } else {
+            /* Another thread was faster */
+            EVP_MAC_CTX_free(new_ctx);
+            cached = __atomic_load_n(&data->cmac_ctx, __ATOMIC_ACQUIRE);
+        }
+    }
+
+    *mctx = EVP_MAC_CTX_dup(cached);
+    if (*mctx == NULL) {
+        TRACE_ERROR("EVP_MAC_CTX_dup failed\n");
+        return CKR_FUNCTION_FAILED;
+    }
+
+    return CKR_OK;
+}
+#endif
+
 CK_RV openssl_cmac_perform(CK_MECHANISM_TYPE mech, CK_BYTE *message,
                            CK_ULONG message_len, OBJECT *key, CK_BYTE *mac,
                            CK_BBOOL first, CK_BBOOL last, CK_VOID_PTR *ctx)
@@ -3339,15 +3775,11 @@ CK_RV openssl_cmac_perform(CK_MECHANISM_TYPE mech, CK_BYTE *message,
         EVP_PKEY_CTX *pctx;
         EVP_PKEY *pkey;
 #else
-        EVP_MAC *mac;
         EVP_MAC_CTX *mctx;
 #endif
         int macsize;
     };
     struct cmac_ctx *cmac = NULL;
-#if OPENSSL_VERSION_PREREQ(3, 0)
-    OSSL_PARAM params[2];
-#endif
 
     if (first) {
         if (key == NULL)
@@ -3406,13 +3838,9 @@ CK_RV openssl_cmac_perform(CK_MECHANISM_TYPE mech, CK_BYTE *message,
             goto err;
         }
 
-        cmac->pkey = EVP_PKEY_new_CMAC_key(NULL, key_attr->pValue,
-                                           key_attr->ulValueLen, cipher);
-        if (cmac->pkey == NULL) {
-            TRACE_ERROR("EVP_DigestSignInit failed\n");
-            rv = CKR_FUNCTION_FAILED;
+        rv = openssl_cmac_get_pkey(key, cipher, key_attr, &cmac->pkey);
+        if (rv != CKR_OK)
             goto err;
-        }
 
         if (EVP_DigestSignInit(cmac->mctx, &cmac->pctx,
                                NULL, NULL, cmac->pkey) != 1) {
@@ -3421,30 +3849,9 @@ CK_RV openssl_cmac_perform(CK_MECHANISM_TYPE mech, CK_BYTE *message,
             goto err;
         }
 #else
-        cmac->mac = EVP_MAC_fetch(NULL, "CMAC", NULL);
-        if (cmac->mac == NULL) {
-            TRACE_ERROR("%s\n", ock_err(ERR_FUNCTION_FAILED));
-            rv = CKR_FUNCTION_FAILED;
-            goto err;
-        }
-
-        cmac->mctx = EVP_MAC_CTX_new(cmac->mac);
-        if (cmac->mctx == NULL) {
-            TRACE_ERROR("%s\n", ock_err(ERR_HOST_MEMORY));
-            rv = CKR_HOST_MEMORY;
-            goto err;
-        }
-
-        params[0] = OSSL_PARAM_construct_utf8_string(OSSL_MAC_PARAM_CIPHER,
-                                      (char *)EVP_CIPHER_get0_name(cipher), 0);
-        params[1] = OSSL_PARAM_construct_end();
-
-        if (!EVP_MAC_init(cmac->mctx, key_attr->pValue, key_attr->ulValueLen,
-                          params)) {
-            TRACE_ERROR("%s\n", ock_err(ERR_FUNCTION_FAILED));
-            rv = CKR_FUNCTION_FAILED;
+        rv = openssl_cmac_get_ctx(key, cipher, key_attr, &cmac->mctx);
+        if (rv != CKR_OK)
             goto err;
-        }
 #endif
 
         *ctx = cmac;
@@ -3494,7 +3901,6 @@ CK_RV openssl_cmac_perform(CK_MECHANISM_TYPE mech, CK_BYTE *message,
         EVP_PKEY_free(cmac->pkey);
 #else
         EVP_MAC_CTX_free(cmac->mctx);
-        EVP_MAC_free(cmac->mac);
 #endif
         free(cmac);
         *ctx = NULL;
@@ -3511,8 +3917,6 @@ err:
 #else
         if (cmac->mctx != NULL)
             EVP_MAC_CTX_free(cmac->mctx);
-        if (cmac->mac != NULL)
-            EVP_MAC_free(cmac->mac);
 #endif
         free(cmac);
     }
@@ -4028,6 +4432,186 @@ done:
     return rc;
 }
 
+static void openssl_specific_aes_gcm_msg_free(STDLL_TokData_t *tokdata,
+                                              struct _SESSION *sess,
+                                              CK_BYTE *context,
+                                              CK_ULONG context_len)
+{
+    AES_GCM_MSG_CONTEXT *ctx = (AES_GCM_MSG_CONTEXT *)context;
+
+    UNUSED(tokdata);
+    UNUSED(sess);
+    UNUSED(context_len);
+
+    if (ctx == NULL)
+        return;
+
+    if (ctx->token_data != NULL)
+        EVP_CIPHER_CTX_free((EVP_CIPHER_CTX *)ctx->token_data);
+
+    free(context);
+}
+
+/*
+ * Set up the cipher context of a message based AES-GCM operation. The key
+ * is expanded only here, each message just re-initializes the IV.
+ */
+CK_RV openssl_specific_aes_gcm_msg_init(STDLL_TokData_t *tokdata,
+                                        SESSION *sess, ENCR_DECR_CONTEXT *ctx,
+                                        CK_MECHANISM *mech,
+                                        CK_OBJECT_HANDLE hkey, CK_BYTE encrypt)
+{
+    AES_GCM_MSG_CONTEXT *context = NULL;
+    OBJECT *key = NULL;
+    EVP_CIPHER_CTX *gcm_ctx = NULL;
+    CK_ATTRIBUTE *attr = NULL;
+    const EVP_CIPHER *cipher = NULL;
+    CK_RV rc;
+
+    UNUSED(sess);
+
+    context = (AES_GCM_MSG_CONTEXT *)ctx->context;
+
+    rc = object_mgr_find_in_map_nocache(tokdata, hkey, &key, READ_LOCK);
+    if (rc != CKR_OK) {
+        TRACE_ERROR("Failed to find specified object.\n");
+        return rc;
+    }
+    rc = template_attribute_get_non_empty(key->template, CKA_VALUE, &attr);
+    if (rc != CKR_OK) {
+        TRACE_ERROR("Could not find CKA_VALUE for the key\n");
+        goto done;
+    }
+
+    cipher = openssl_cipher_from_mech(mech->mechanism, attr->ulValueLen,
+                                      CKK_AES);
+    if (cipher == NULL) {
+        rc = CKR_MECHANISM_INVALID;
+        goto done;
+    }
+
+    gcm_ctx = EVP_CIPHER_CTX_new();
+    if (gcm_ctx == NULL) {
+        TRACE_ERROR("%s\n", ock_err(ERR_HOST_MEMORY));
+        rc = CKR_HOST_MEMORY;
+        goto done;
+    }
+
+    if (EVP_CipherInit_ex(gcm_ctx, cipher, NULL, attr->pValue, NULL,
+                          encrypt ? 1 : 0) != 1) {
+        TRACE_ERROR("GCM context initialization failed\n");
+        rc = CKR_GENERAL_ERROR;
+        goto done;
+    }
+
+    context->token_data = gcm_ctx;
+    ctx->state_unsaveable = CK_TRUE;
+    ctx->context_free_func = openssl_specific_aes_gcm_msg_free;
+
+done:
+    object_put(tokdata, key, TRUE);
+    key = NULL;
+
+    if (rc != CKR_OK)
+        EVP_CIPHER_CTX_free(gcm_ctx);
+
+    return rc;
+}
+
+CK_RV openssl_specific_aes_gcm_msg_begin(STDLL_TokData_t *tokdata,
+                                         SESSION *sess, ENCR_DECR_CONTEXT *ctx,
+                                         CK_GCM_MESSAGE_PARAMS *param,
+                                         CK_BYTE *aad, CK_ULONG aad_len,
+                                         CK_BYTE encrypt)
+{
+    AES_GCM_MSG_CONTEXT *context = NULL;
+    EVP_CIPHER_CTX *gcm_ctx = NULL;
+    int outlen;
+
+    UNUSED(tokdata);
+    UNUSED(sess);
+
+    context = (AES_GCM_MSG_CONTEXT *)ctx->context;
+    gcm_ctx = (EVP_CIPHER_CTX *)context->token_data;
+
+    if (gcm_ctx == NULL)
+        return CKR_OPERATION_NOT_INITIALIZED;
+
+    /* Keep the expanded key, only set up the IV for this message */
+    if (EVP_CIPHER_CTX_ctrl(gcm_ctx, EVP_CTRL_AEAD_SET_IVLEN,
+                            param->ulIvLen, NULL) != 1 ||
+        EVP_CipherInit_ex(gcm_ctx, NULL, NULL, NULL, param->pIv,
+                          encrypt ? 1 : 0) != 1) {
+        TRACE_ERROR("GCM message initialization failed\n");
+        return CKR_GENERAL_ERROR;
+    }
+
+    if (aad_len > 0) {
+        if (EVP_CipherUpdate(gcm_ctx, NULL, &outlen, aad, aad_len) != 1) {
+            TRACE_ERROR("GCM add AAD data failed\n");
+            return CKR_GENERAL_ERROR;
+        }
+    }
+
+    return CKR_OK;
+}
+
+CK_RV openssl_specific_aes_gcm_msg_next(STDLL_TokData_t *tokdata,
+                                        SESSION *sess, ENCR_DECR_CONTEXT *ctx,
+                                        CK_GCM_MESSAGE_PARAMS *param,
+                                        CK_BYTE *in_data, CK_ULONG in_data_len,
+                                        CK_BYTE *out_data,
+                                        CK_ULONG *out_data_len,
+                                        CK_FLAGS flags, CK_BYTE encrypt)
+{
+    AES_GCM_MSG_CONTEXT *context = NULL;
+    EVP_CIPHER_CTX *gcm_ctx = NULL;
+    int outlen = 0, finlen = 0;
+
+    UNUSED(tokdata);
+    UNUSED(sess);
+
+    context = (AES_GCM_MSG_CONTEXT *)ctx->context;
+    gcm_ctx = (EVP_CIPHER_CTX *)context->token_data;
+
+    if (gcm_ctx == NULL)
+        return CKR_OPERATION_NOT_INITIALIZED;
+
+    if (in_data_len > 0) {
+        if (EVP_CipherUpdate(gcm_ctx, out_data, &outlen,
+                             in_data, in_data_len) != 1) {
+            TRACE_ERROR("GCM update failed\n");
+            return CKR_GENERAL_ERROR;
+        }
+    }
+
+    if (flags & CKF_END_OF_MESSAGE) {
+        if (!encrypt &&
+            EVP_CIPHER_CTX_ctrl(gcm_ctx, EVP_CTRL_AEAD_SET_TAG,
+                                context->tag_len, param->pTag) != 1) {
+            TRACE_ERROR("GCM set tag failed\n");
+            return CKR_GENERAL_ERROR;
+        }
+
+        if (EVP_CipherFinal_ex(gcm_ctx, out_data + outlen, &finlen) != 1) {
+            TRACE_ERROR("GCM finalize %s failed\n",
+                        encrypt ? "encryption" : "decryption");
+            return encrypt ? CKR_GENERAL_ERROR : CKR_ENCRYPTED_DATA_INVALID;
+        }
+
+        if (encrypt &&
+            EVP_CIPHER_CTX_ctrl(gcm_ctx, EVP_CTRL_AEAD_GET_TAG,
+                                context->tag_len, param->pTag) != 1) {
+            TRACE_ERROR("GCM get tag failed\n");
+            return CKR_GENERAL_ERROR;
+        }
+    }
+
+    *out_data_len = outlen + finlen;
+
+    return CKR_OK;
+}
+
 CK_RV openssl_specific_aes_mac(STDLL_TokData_t *tokdata, CK_BYTE *message,
                                CK_ULONG message_len, OBJECT *key, CK_BYTE *mac)
 {
@@ -4200,6 +4784,93 @@ CK_RV openssl_specific_tdes_cmac(STDLL_TokData_t *tokdata, CK_BYTE *message,
                                 first, last, ctx);
 }
 
+static EVP_MD_CTX *openssl_hmac_make_ctx(const EVP_MD *md,
+                                         CK_ATTRIBUTE *key_attr)
+{
+    EVP_MD_CTX *mdctx;
+    EVP_PKEY *pkey;
+
+    pkey = EVP_PKEY_new_mac_key(EVP_PKEY_HMAC, NULL, key_attr->pValue,
+                                key_attr->ulValueLen);
+    if (pkey == NULL) {
+        TRACE_ERROR("EVP_PKEY_new_mac_key() failed.\n");
+        return NULL;
+    }
+
+    mdctx = EVP_MD_CTX_create();
+    if (mdctx == NULL) {
+        TRACE_ERROR("%s\n", ock_err(ERR_HOST_MEMORY));
+        goto out;
+    }
+
+    if (EVP_DigestSignInit(mdctx, NULL, md, NULL, pkey) != 1) {
+        TRACE_ERROR("EVP_DigestSignInit failed.\n");
+        EVP_MD_CTX_destroy(mdctx);
+        mdctx = NULL;
+    }
+
+out:
+    /* The context keeps its own reference to the key */
+    EVP_PKEY_free(pkey);
+
+    return mdctx;
+}
+
+/*
+ * Returns a new digest context that is set up for HMAC signing with the
+ * given key and digest. The context is copied from the one cached with the
+ * key object, so that the key is only padded and hashed into the inner and
+ * outer digest states once per key, and not on every sign or verify
+ * operation. The caller must hold the object's read lock and must free the
+ * returned context with EVP_MD_CTX_destroy.
+ */
+static CK_RV openssl_hmac_get_ctx(OBJECT *key, enum openssl_hmac_slot slot,
+                                  const EVP_MD *md, CK_ATTRIBUTE *key_attr,
+                                  EVP_MD_CTX **mdctx)
+{
+    struct openssl_ex_data *data;
+    EVP_MD_CTX *cached, *new_ctx;
+
+    data = (struct openssl_ex_data *)object_ex_data_get(key, sizeof(*data),
+                                                       openssl_free_ex_data);
+    if (data == NULL) {
+        /* Can not cache, build a private context */
+        *mdctx = openssl_hmac_make_ctx(md, key_attr);
+        return *mdctx != NULL ? CKR_OK : CKR_FUNCTION_FAILED;
+    }
+
+    cached = __atomic_load_n(&data->hmac_ctx[slot], __ATOMIC_ACQUIRE);
+    if (cached == NULL) {
+        new_ctx = openssl_hmac_make_ctx(md, key_attr);
+        if (new_ctx == NULL)
+            return CKR_FUNCTION_FAILED;
+
+        if (__sync_bool_compare_and_swap(&data->hmac_ctx[slot],
+                                         NULL, new_ctx)) {
+            cached = new_ctx;
+        } else {
+            /* Another thread was faster */
+            EVP_MD_CTX_destroy(new_ctx);
+            cached = __atomic_load_n(&data->hmac_ctx[slot], __ATOMIC_ACQUIRE);
+        }
+    }
+
+    *mdctx = EVP_MD_CTX_create();
+    if (*mdctx == NULL) {
+        TRACE_ERROR("%s\n", ock_err(ERR_HOST_MEMORY));
+        return CKR_HOST_MEMORY;
+    }
+
+    if (EVP_MD_CTX_copy_ex(*mdctx, cached) != 1) {
+        TRACE_ERROR("EVP_MD_CTX_copy_ex failed\n");
+        EVP_MD_CTX_destroy(*mdctx);
+        *mdctx = NULL;
+        return CKR_FUNCTION_FAILED;
+    }
+
+    return CKR_OK;
+}
+
 CK_RV openssl_specific_hmac_init(STDLL_TokData_t *tokdata,
                                  SIGN_VERIFY_CONTEXT *ctx,
                                  CK_MECHANISM_PTR mech,
@@ -4209,7 +4880,8 @@ CK_RV openssl_specific_hmac_init(STDLL_TokData_t *tokdata,
     OBJECT *key = NULL;
     CK_ATTRIBUTE *attr = NULL;
     EVP_MD_CTX *mdctx = NULL;
-    EVP_PKEY *pkey = NULL;
+    enum openssl_hmac_slot slot;
+    const EVP_MD *md;
 
     rc = object_mgr_find_in_map1(tokdata, Hkey, &key, READ_LOCK);
     if (rc != CKR_OK) {
@@ -4223,96 +4895,85 @@ CK_RV openssl_specific_hmac_init(STDLL_TokData_t *tokdata,
         goto done;
     }
 
-    pkey = EVP_PKEY_new_mac_key(EVP_PKEY_HMAC, NULL, attr->pValue,
-                                attr->ulValueLen);
-    if (pkey == NULL) {
-        TRACE_ERROR("EVP_PKEY_new_mac_key() failed.\n");
-        rc = CKR_FUNCTION_FAILED;
-        goto done;
-    }
-
-    mdctx = EVP_MD_CTX_create();
-    if (mdctx == NULL) {
-        TRACE_ERROR("%s\n", ock_err(ERR_HOST_MEMORY));
-        rc = CKR_HOST_MEMORY;
-        goto done;
-    }
-
     switch (mech->mechanism) {
     case CKM_SHA_1_HMAC_GENERAL:
     case CKM_SHA_1_HMAC:
-        rc = EVP_DigestSignInit(mdctx, NULL, EVP_sha1(), NULL, pkey);
+        slot = OPENSSL_HMAC_SHA1;
+        md = EVP_sha1();
         break;
     case CKM_SHA224_HMAC_GENERAL:
     case CKM_SHA224_HMAC:
-        rc = EVP_DigestSignInit(mdctx, NULL, EVP_sha224(), NULL, pkey);
+        slot = OPENSSL_HMAC_SHA224;
+        md = EVP_sha224();
         break;
     case CKM_SHA256_HMAC_GENERAL:
     case CKM_SHA256_HMAC:
-        rc = EVP_DigestSignInit(mdctx, NULL, EVP_sha256(), NULL, pkey);
+        slot = OPENSSL_HMAC_SHA256;
+        md = EVP_sha256();
         break;
     case CKM_SHA384_HMAC_GENERAL:
     case CKM_SHA384_HMAC:
-        rc = EVP_DigestSignInit(mdctx, NULL, EVP_sha384(), NULL, pkey);
+        slot = OPENSSL_HMAC_SHA384;
+        md = EVP_sha384();
         break;
     case CKM_SHA512_HMAC_GENERAL:
     case CKM_SHA512_HMAC:
-        rc = EVP_DigestSignInit(mdctx, NULL, EVP_sha512(), NULL, pkey);
+        slot = OPENSSL_HMAC_SHA512;
+        md = EVP_sha512();
         break;
 #ifdef NID_sha512_224WithRSAEncryption
     case CKM_SHA512_224_HMAC_GENERAL:
     case CKM_SHA512_224_HMAC:
-        rc = EVP_DigestSignInit(mdctx, NULL, EVP_sha512_224(), NULL, pkey);
+        slot = OPENSSL_HMAC_SHA512_224;
+        md = EVP_sha512_224();
         break;
 #endif
 #ifdef NID_sha512_256WithRSAEncryption
     case CKM_SHA512_256_HMAC_GENERAL:
     case CKM_SHA512_256_HMAC:
-        rc = EVP_DigestSignInit(mdctx, NULL, EVP_sha512_256(), NULL, pkey);
+        slot = OPENSSL_HMAC_SHA512_256;
+        md = EVP_sha512_256();
         break;
 #endif
 #ifdef NID_sha3_224
     case CKM_IBM_SHA3_224_HMAC:
-        rc = EVP_DigestSignInit(mdctx, NULL, EVP_sha3_224(), NULL, pkey);
+        slot = OPENSSL_HMAC_SHA3_224;
+        md = EVP_sha3_224();
         break;
 #endif
 #ifdef NID_sha3_256
     case CKM_IBM_SHA3_256_HMAC:
-        rc = EVP_DigestSignInit(mdctx, NULL, EVP_sha3_256(), NULL, pkey);
+        slot = OPENSSL_HMAC_SHA3_256;
+        md = EVP_sha3_256();
         break;
 #endif
 #ifdef NID_sha3_384
     case CKM_IBM_SHA3_384_HMAC:
-        rc = EVP_DigestSignInit(mdctx, NULL, EVP_sha3_384(), NULL, pkey);
+        slot = OPENSSL_HMAC_SHA3_384;
+        md = EVP_sha3_384();
         break;
 #endif
 #ifdef NID_sha3_512
     case CKM_IBM_SHA3_512_HMAC:
-        rc = EVP_DigestSignInit(mdctx, NULL, EVP_sha3_512(), NULL, pkey);
+        slot = OPENSSL_HMAC_SHA3_512;
+        md = EVP_sha3_512();
         break;
 #endif
     default:
-        EVP_MD_CTX_destroy(mdctx);
         TRACE_ERROR("%s\n", ock_err(ERR_MECHANISM_INVALID));
         rc = CKR_MECHANISM_INVALID;
         goto done;
     }
 
-    if (rc != 1) {
-        EVP_MD_CTX_destroy(mdctx);
+    rc = openssl_hmac_get_ctx(key, slot, md, attr, &mdctx);
+    if (rc != CKR_OK) {
         ctx->context = NULL;
-        TRACE_ERROR("EVP_DigestSignInit failed.\n");
-        rc = CKR_FUNCTION_FAILED;
         goto done;
-    } else {
-        ctx->context = (CK_BYTE *) mdctx;
     }
 
-    rc = CKR_OK;
-done:
-    if (pkey != NULL)
-        EVP_PKEY_free(pkey);
+    ctx->context = (CK_BYTE *) mdctx;
 
+done:
     object_put(tokdata, key, TRUE);
     key = NULL;
     return rc;
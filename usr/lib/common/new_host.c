@@ -47,6 +47,7 @@
 #include "trace.h"
 #include "slotmgr.h"
 #include "attributes.h"
+#include "worker_pool.h"
 
 #include "../api/apiproto.h"
 #include "../api/policy.h"
@@ -88,11 +89,13 @@ CK_RV ST_Initialize(API_Slot_t *sltp, CK_SLOT_ID SlotNumber,
     /* set trace info */
     set_trace(t);
 
-    bt_init(&sltp->TokData->sess_btree, free);
+    ht_init(&sltp->TokData->sess_table, free);
+    ht_init(&sltp->TokData->async_table, async_mgr_free_op);
     bt_init(&sltp->TokData->object_map_btree, free);
     bt_init(&sltp->TokData->sess_obj_btree, call_object_free);
     bt_init(&sltp->TokData->priv_token_obj_btree, call_object_free);
     bt_init(&sltp->TokData->publ_token_obj_btree, call_object_free);
+    object_mgr_index_init(sltp->TokData);
 
     if (strlen(sinfp->tokname)) {
         if (ock_snprintf(abs_tokdir_name, PATH_MAX, "%s/%s",
@@ -116,6 +119,10 @@ CK_RV ST_Initialize(API_Slot_t *sltp, CK_SLOT_ID SlotNumber,
     }
 
     sltp->TokData->version = sinfp->version;
+    sltp->TokData->objstore = sinfp->objstore;
+    sltp->TokData->objload = sinfp->objload;
+    sltp->TokData->pbkdf2_it = sinfp->pbkdf2_it;
+    sltp->TokData->login_cache_ttl = sinfp->login_cache_ttl;
     TRACE_DEVEL("Token version: %u.%u\n",
                 (unsigned int)(sinfp->version >> 16),
                 (unsigned int)(sinfp->version & 0xffff));
@@ -194,6 +201,10 @@ CK_RV ST_Initialize(API_Slot_t *sltp, CK_SLOT_ID SlotNumber,
 
     init_slotInfo(&(sltp->TokData->slot_info));
 
+    /* Without a worker pool, batched operations run in the calling thread */
+    if (sltp->TokData->workers == NULL)
+        sltp->TokData->workers = worker_pool_new(sltp->TokData);
+
     (sltp->FcnList) = &function_list;
 
 done:
@@ -231,15 +242,21 @@ CK_RV SC_Finalize(STDLL_TokData_t *tokdata, CK_SLOT_ID sid, SLOT_INFO *sinfp,
 
     tokdata->initialized = FALSE;
 
+    /* Pending asynchronous operations are done when the pool is freed */
+    worker_pool_free(tokdata->workers, in_fork_initializer);
+    tokdata->workers = NULL;
+    ht_destroy(&tokdata->async_table);
+
     session_mgr_close_all_sessions(tokdata);
     object_mgr_purge_token_objects(tokdata);
 
     /* Finally free the nodes on free list. */
-    bt_destroy(&tokdata->sess_btree);
+    ht_destroy(&tokdata->sess_table);
     bt_destroy(&tokdata->object_map_btree);
     bt_destroy(&tokdata->sess_obj_btree);
     bt_destroy(&tokdata->priv_token_obj_btree);
     bt_destroy(&tokdata->publ_token_obj_btree);
+    object_mgr_index_final(tokdata);
 
     detach_shm(tokdata, in_fork_initializer);
     /* close spin lock file */
@@ -467,6 +484,8 @@ CK_RV SC_InitToken(STDLL_TokData_t *tokdata, CK_SLOT_ID sid, CK_CHAR_PTR pPin,
     /* Before we reconstruct all the data, we should delete the
      * token objects from the filesystem.
      */
+    login_cache_remove(tokdata, CKU_SO);
+    login_cache_remove(tokdata, CKU_USER);
     object_mgr_destroy_token_objects(tokdata);
     delete_token_data(tokdata);
 
@@ -508,7 +527,7 @@ CK_RV SC_InitPIN(STDLL_TokData_t *tokdata, ST_SESSION_HANDLE *sSession,
     CK_FLAGS_32 *flags = NULL;
     TOKEN_DATA_VERSION *dat;
     unsigned char login_key[32], wrap_key[32], login_salt[64], wrap_salt[64];
-    uint64_t login_it, wrap_it;
+    uint64_t login_it = 0, wrap_it = 0;
 
     if (tokdata->initialized == FALSE) {
         TRACE_ERROR("%s\n", ock_err(ERR_CRYPTOKI_NOT_INITIALIZED));
@@ -576,7 +595,7 @@ CK_RV SC_InitPIN(STDLL_TokData_t *tokdata, ST_SESSION_HANDLE *sSession,
             goto done;
         }
     } else {
-        login_it = USER_KDF_LOGIN_IT;
+        login_it = pbkdf2_iterations(tokdata, USER_KDF_LOGIN_IT);
         memcpy(login_salt, USER_KDF_LOGIN_PURPOSE, 32);
         rng_generate(tokdata, login_salt + 32, 32);
 
@@ -590,7 +609,7 @@ CK_RV SC_InitPIN(STDLL_TokData_t *tokdata, ST_SESSION_HANDLE *sSession,
             goto done;
         }
 
-        wrap_it = USER_KDF_WRAP_IT;
+        wrap_it = pbkdf2_iterations(tokdata, USER_KDF_WRAP_IT);
         memcpy(wrap_salt, USER_KDF_WRAP_PURPOSE, 32);
         rng_generate(tokdata, wrap_salt + 32, 32);
 
@@ -613,6 +632,7 @@ CK_RV SC_InitPIN(STDLL_TokData_t *tokdata, ST_SESSION_HANDLE *sSession,
     if (tokdata->version < TOK_NEW_DATA_STORE) {
         memcpy(tokdata->nv_token_data->user_pin_sha, hash_sha, SHA1_HASH_SIZE);
     } else {
+        login_cache_remove(tokdata, CKU_USER);
         memcpy(dat->user_login_key, login_key, 256 / 8);
         memcpy(dat->user_login_salt, login_salt, 64);
         dat->user_login_it = login_it;
@@ -670,7 +690,7 @@ CK_RV SC_SetPIN(STDLL_TokData_t *tokdata, ST_SESSION_HANDLE *sSession,
     TOKEN_DATA_VERSION *dat;
     unsigned char old_login_key[32], new_login_key[32], new_wrap_key[32],
                   new_login_key_old_salt[32], login_salt[64], wrap_salt[64];
-    uint64_t login_it, wrap_it;
+    uint64_t login_it = 0, wrap_it = 0;
 
     if (tokdata->initialized == FALSE) {
         TRACE_ERROR("%s\n", ock_err(ERR_CRYPTOKI_NOT_INITIALIZED));
@@ -750,7 +770,7 @@ CK_RV SC_SetPIN(STDLL_TokData_t *tokdata, ST_SESSION_HANDLE *sSession,
                 goto done;
             }
         } else {
-            login_it = USER_KDF_LOGIN_IT;
+            login_it = pbkdf2_iterations(tokdata, USER_KDF_LOGIN_IT);
             memcpy(login_salt, USER_KDF_LOGIN_PURPOSE, 32);
             rng_generate(tokdata, login_salt + 32, 32);
 
@@ -763,7 +783,7 @@ CK_RV SC_SetPIN(STDLL_TokData_t *tokdata, ST_SESSION_HANDLE *sSession,
                 goto done;
             }
 
-            wrap_it = USER_KDF_WRAP_IT;
+            wrap_it = pbkdf2_iterations(tokdata, USER_KDF_WRAP_IT);
             memcpy(wrap_salt, USER_KDF_WRAP_PURPOSE, 32);
             rng_generate(tokdata, wrap_salt + 32, 32);
 
@@ -822,6 +842,7 @@ CK_RV SC_SetPIN(STDLL_TokData_t *tokdata, ST_SESSION_HANDLE *sSession,
                    SHA1_HASH_SIZE);
             memcpy(tokdata->user_pin_md5, hash_md5, MD5_HASH_SIZE);
         } else {
+            login_cache_remove(tokdata, CKU_USER);
             memcpy(dat->user_login_key, new_login_key, 256 / 8);
             memcpy(dat->user_login_salt, login_salt, 64);
             dat->user_login_it = login_it;
@@ -871,7 +892,7 @@ CK_RV SC_SetPIN(STDLL_TokData_t *tokdata, ST_SESSION_HANDLE *sSession,
                 goto done;
             }
         } else {
-            login_it = SO_KDF_LOGIN_IT;
+            login_it = pbkdf2_iterations(tokdata, SO_KDF_LOGIN_IT);
             memcpy(login_salt, SO_KDF_LOGIN_PURPOSE, 32);
             rng_generate(tokdata, login_salt + 32, 32);
 
@@ -884,7 +905,7 @@ CK_RV SC_SetPIN(STDLL_TokData_t *tokdata, ST_SESSION_HANDLE *sSession,
                 goto done;
             }
 
-            wrap_it = SO_KDF_WRAP_IT;
+            wrap_it = pbkdf2_iterations(tokdata, SO_KDF_WRAP_IT);
             memcpy(wrap_salt, SO_KDF_WRAP_PURPOSE, 32);
             rng_generate(tokdata, wrap_salt + 32, 32);
 
@@ -943,6 +964,7 @@ CK_RV SC_SetPIN(STDLL_TokData_t *tokdata, ST_SESSION_HANDLE *sSession,
                    SHA1_HASH_SIZE);
             memcpy(tokdata->so_pin_md5, hash_md5, MD5_HASH_SIZE);
         } else {
+            login_cache_remove(tokdata, CKU_SO);
             memcpy(dat->so_login_key, new_login_key, 256 / 8);
             memcpy(dat->so_login_salt, login_salt, 64);
             dat->so_login_it = login_it;
@@ -1212,6 +1234,7 @@ CK_RV SC_Login(STDLL_TokData_t *tokdata, ST_SESSION_HANDLE *sSession,
     CK_BYTE hash_sha[SHA1_HASH_SIZE];
     CK_RV rc = CKR_OK;
     unsigned char login_key[32], wrap_key[32];
+    CK_BBOOL cached;
     TOKEN_DATA_VERSION *dat;
 
     /* In v2.11, logins should be exclusive, since token
@@ -1333,21 +1356,10 @@ CK_RV SC_Login(STDLL_TokData_t *tokdata, ST_SESSION_HANDLE *sSession,
             compute_md5(tokdata, pPin, ulPinLen, tokdata->user_pin_md5);
             memset(tokdata->so_pin_md5, 0x0, MD5_HASH_SIZE);
         } else {
-            rc = compute_PKCS5_PBKDF2_HMAC(tokdata, pPin, ulPinLen,
-                                           dat->user_login_salt, 64,
-                                           dat->user_login_it, EVP_sha512(),
-                                           256 / 8, login_key);
-            if (rc != CKR_OK) {
-                TRACE_DEVEL("PBKDF2 failed.\n");
-                goto done;
-            }
-
-            rc = compute_PKCS5_PBKDF2_HMAC(tokdata, pPin, ulPinLen,
-                                           dat->user_wrap_salt, 64,
-                                           dat->user_wrap_it, EVP_sha512(),
-                                           256 / 8, wrap_key);
+            rc = compute_login_keys(tokdata, userType, pPin, ulPinLen,
+                                    login_key, wrap_key, &cached);
             if (rc != CKR_OK) {
-                TRACE_DEVEL("PBKDF2 failed.\n");
+                TRACE_DEVEL("compute_login_keys failed.\n");
                 goto done;
             }
 
@@ -1365,6 +1377,10 @@ CK_RV SC_Login(STDLL_TokData_t *tokdata, ST_SESSION_HANDLE *sSession,
 
             memcpy(tokdata->user_wrap_key, wrap_key, 256 / 8);
             memset(tokdata->so_wrap_key, 0, 256 / 8);
+
+            if (!cached)
+                login_cache_put(tokdata, userType, pPin, ulPinLen,
+                                login_key, wrap_key);
         }
 
         rc = load_masterkey_user(tokdata);
@@ -1434,21 +1450,10 @@ CK_RV SC_Login(STDLL_TokData_t *tokdata, ST_SESSION_HANDLE *sSession,
             compute_md5(tokdata, pPin, ulPinLen, tokdata->so_pin_md5);
             memset(tokdata->user_pin_md5, 0x0, MD5_HASH_SIZE);
         } else {
-            rc = compute_PKCS5_PBKDF2_HMAC(tokdata, pPin, ulPinLen,
-                                           dat->so_login_salt, 64,
-                                           dat->so_login_it, EVP_sha512(),
-                                           256 / 8, login_key);
-            if (rc != CKR_OK) {
-                TRACE_DEVEL("PBKDF2 failed.\n");
-                goto done;
-            }
-
-            rc = compute_PKCS5_PBKDF2_HMAC(tokdata, pPin, ulPinLen,
-                                           dat->so_wrap_salt, 64,
-                                           dat->so_wrap_it, EVP_sha512(),
-                                           256 / 8, wrap_key);
+            rc = compute_login_keys(tokdata, userType, pPin, ulPinLen,
+                                    login_key, wrap_key, &cached);
             if (rc != CKR_OK) {
-                TRACE_DEVEL("PBKDF2 failed.\n");
+                TRACE_DEVEL("compute_login_keys failed.\n");
                 goto done;
             }
 
@@ -1466,6 +1471,10 @@ CK_RV SC_Login(STDLL_TokData_t *tokdata, ST_SESSION_HANDLE *sSession,
 
             memcpy(tokdata->so_wrap_key, wrap_key, 256 / 8);
             memset(tokdata->user_wrap_key, 0, 256 / 8);
+
+            if (!cached)
+                login_cache_put(tokdata, userType, pPin, ulPinLen,
+                                login_key, wrap_key);
         }
 
         rc = load_masterkey_so(tokdata);
@@ -1938,20 +1947,14 @@ CK_RV SC_FindObjects(STDLL_TokData_t *tokdata, ST_SESSION_HANDLE *sSession,
         goto done;
     }
 
-    if (!sess->find_list) {
-        TRACE_DEVEL("sess->find_list is NULL.\n");
-        rc = CKR_OPERATION_NOT_INITIALIZED;
+    rc = object_mgr_find_next(tokdata, sess, phObject, ulMaxObjectCount,
+                              &count);
+    if (rc != CKR_OK) {
+        TRACE_DEVEL("object_mgr_find_next failed.\n");
         goto done;
     }
-    count = MIN(ulMaxObjectCount, (sess->find_count - sess->find_idx));
-
-    memcpy(phObject, sess->find_list + sess->find_idx,
-           count * sizeof(CK_OBJECT_HANDLE));
     *pulObjectCount = count;
 
-    sess->find_idx += count;
-    rc = CKR_OK;
-
 done:
     TRACE_INFO("C_FindObjects: rc = 0x%08lx, returned %lu objects\n",
                rc, count);
@@ -1988,15 +1991,7 @@ CK_RV SC_FindObjectsFinal(STDLL_TokData_t *tokdata,
         goto done;
     }
 
-    if (sess->find_list)
-        free(sess->find_list);
-
-    sess->find_list = NULL;
-    sess->find_len = 0;
-    sess->find_idx = 0;
-    sess->find_active = FALSE;
-
-    rc = CKR_OK;
+    rc = object_mgr_find_final(sess);
 
 done:
     TRACE_INFO("C_FindObjectsFinal: rc = 0x%08lx\n", rc);
@@ -2474,8 +2469,9 @@ done:
 }
 
 
-CK_RV SC_DigestInit(STDLL_TokData_t *tokdata, ST_SESSION_HANDLE *sSession,
-                    CK_MECHANISM_PTR pMechanism)
+CK_RV SC_MessageEncryptInit(STDLL_TokData_t *tokdata,
+                            ST_SESSION_HANDLE *sSession,
+                            CK_MECHANISM_PTR pMechanism, CK_OBJECT_HANDLE hKey)
 {
     SESSION *sess = NULL;
     CK_RV rc = CKR_OK;
@@ -2485,13 +2481,14 @@ CK_RV SC_DigestInit(STDLL_TokData_t *tokdata, ST_SESSION_HANDLE *sSession,
         rc = CKR_CRYPTOKI_NOT_INITIALIZED;
         goto done;
     }
+
     if (!pMechanism) {
         TRACE_ERROR("%s\n", ock_err(ERR_ARGUMENTS_BAD));
         rc = CKR_ARGUMENTS_BAD;
         goto done;
     }
 
-    rc = valid_mech(tokdata, pMechanism, CKF_DIGEST);
+    rc = valid_mech(tokdata, pMechanism, CKF_MESSAGE_ENCRYPT);
     if (rc != CKR_OK)
         goto done;
 
@@ -2509,21 +2506,21 @@ CK_RV SC_DigestInit(STDLL_TokData_t *tokdata, ST_SESSION_HANDLE *sSession,
         goto done;
     }
 
-    if (sess->digest_ctx.active == TRUE) {
+    if (sess->msg_encr_ctx.active == TRUE) {
         TRACE_ERROR("%s\n", ock_err(ERR_OPERATION_ACTIVE));
         rc = CKR_OPERATION_ACTIVE;
         goto done;
     }
 
-    sess->digest_ctx.count_statistics = TRUE;
-    rc = digest_mgr_init(tokdata, sess, &sess->digest_ctx, pMechanism, TRUE);
-    if (rc != CKR_OK)
-        TRACE_DEVEL("digest_mgr_init() failed.\n");
+    sess->msg_encr_ctx.count_statistics = TRUE;
+    rc = encr_mgr_msg_init(tokdata, sess, &sess->msg_encr_ctx, pMechanism, hKey,
+                           TRUE);
 
 done:
-    TRACE_INFO("C_DigestInit: rc = 0x%08lx, sess = %ld, mech = 0x%lx\n",
+    TRACE_INFO("C_MessageEncryptInit: rc = 0x%08lx, sess = %ld, "
+               "mech = 0x%lx\n",
                rc, (sess == NULL) ? -1 : (CK_LONG) sess->handle,
-               (pMechanism ? pMechanism->mechanism : (CK_ULONG)-1));
+               (pMechanism ? pMechanism->mechanism : (CK_ULONG)(-1)));
 
     if (sess != NULL)
         session_mgr_put(tokdata, sess);
@@ -2532,9 +2529,12 @@ done:
 }
 
 
-CK_RV SC_Digest(STDLL_TokData_t *tokdata, ST_SESSION_HANDLE *sSession,
-                CK_BYTE_PTR pData, CK_ULONG ulDataLen, CK_BYTE_PTR pDigest,
-                CK_ULONG_PTR pulDigestLen)
+CK_RV SC_EncryptMessage(STDLL_TokData_t *tokdata, ST_SESSION_HANDLE *sSession,
+                        CK_VOID_PTR pParameter, CK_ULONG ulParameterLen,
+                        CK_BYTE_PTR pAssociatedData,
+                        CK_ULONG ulAssociatedDataLen,
+                        CK_BYTE_PTR pPlaintext, CK_ULONG ulPlaintextLen,
+                        CK_BYTE_PTR pCiphertext, CK_ULONG_PTR pulCiphertextLen)
 {
     SESSION *sess = NULL;
     CK_BBOOL length_only = FALSE;
@@ -2553,23 +2553,34 @@ CK_RV SC_Digest(STDLL_TokData_t *tokdata, ST_SESSION_HANDLE *sSession,
         goto done;
     }
 
-    if (sess->digest_ctx.active == FALSE) {
+    if (!pParameter || (!pAssociatedData && ulAssociatedDataLen != 0) ||
+        (!pPlaintext && ulPlaintextLen != 0) || !pulCiphertextLen) {
+        TRACE_ERROR("%s\n", ock_err(ERR_ARGUMENTS_BAD));
+        rc = CKR_ARGUMENTS_BAD;
+        goto done;
+    }
+
+    if (sess->msg_encr_ctx.active == FALSE) {
         TRACE_ERROR("%s\n", ock_err(ERR_OPERATION_NOT_INITIALIZED));
         rc = CKR_OPERATION_NOT_INITIALIZED;
         goto done;
     }
 
-    if (!pDigest)
+    if (!pCiphertext)
         length_only = TRUE;
 
-    rc = digest_mgr_digest(tokdata, sess, length_only, &sess->digest_ctx,
-                           pData, ulDataLen, pDigest, pulDigestLen);
+    rc = encr_mgr_encrypt_msg(tokdata, sess, length_only, &sess->msg_encr_ctx,
+                              pParameter, ulParameterLen,
+                              pAssociatedData, ulAssociatedDataLen,
+                              pPlaintext, ulPlaintextLen,
+                              pCiphertext, pulCiphertextLen);
     if (rc != CKR_OK)
-        TRACE_DEVEL("digest_mgr_digest() failed.\n");
+        TRACE_DEVEL("encr_mgr_encrypt_msg() failed.\n");
 
 done:
-    TRACE_INFO("C_Digest: rc = 0x%08lx, sess = %ld, datalen = %lu\n",
-               rc, (sess == NULL) ? -1 : (CK_LONG) sess->handle, ulDataLen);
+    TRACE_INFO("C_EncryptMessage: rc = 0x%08lx, sess = %ld, amount = %lu\n",
+               rc, (sess == NULL) ? -1 : (CK_LONG) sess->handle,
+               ulPlaintextLen);
 
     if (sess != NULL)
         session_mgr_put(tokdata, sess);
@@ -2578,8 +2589,11 @@ done:
 }
 
 
-CK_RV SC_DigestUpdate(STDLL_TokData_t *tokdata, ST_SESSION_HANDLE *sSession,
-                      CK_BYTE_PTR pPart, CK_ULONG ulPartLen)
+CK_RV SC_EncryptMessageBegin(STDLL_TokData_t *tokdata,
+                             ST_SESSION_HANDLE *sSession,
+                             CK_VOID_PTR pParameter, CK_ULONG ulParameterLen,
+                             CK_BYTE_PTR pAssociatedData,
+                             CK_ULONG ulAssociatedDataLen)
 {
     SESSION *sess = NULL;
     CK_RV rc = CKR_OK;
@@ -2597,23 +2611,27 @@ CK_RV SC_DigestUpdate(STDLL_TokData_t *tokdata, ST_SESSION_HANDLE *sSession,
         goto done;
     }
 
-    if (sess->digest_ctx.active == FALSE) {
+    if (!pParameter || (!pAssociatedData && ulAssociatedDataLen != 0)) {
+        TRACE_ERROR("%s\n", ock_err(ERR_ARGUMENTS_BAD));
+        rc = CKR_ARGUMENTS_BAD;
+        goto done;
+    }
+
+    if (sess->msg_encr_ctx.active == FALSE) {
         TRACE_ERROR("%s\n", ock_err(ERR_OPERATION_NOT_INITIALIZED));
         rc = CKR_OPERATION_NOT_INITIALIZED;
         goto done;
     }
 
-    /* If there is data to hash, do so. */
-    if (ulPartLen) {
-        rc = digest_mgr_digest_update(tokdata, sess, &sess->digest_ctx,
-                                      pPart, ulPartLen);
-        if (rc != CKR_OK)
-            TRACE_DEVEL("digest_mgr_digest_update() failed.\n");
-    }
+    rc = encr_mgr_encrypt_msg_begin(tokdata, sess, &sess->msg_encr_ctx,
+                                    pParameter, ulParameterLen,
+                                    pAssociatedData, ulAssociatedDataLen);
+    if (rc != CKR_OK)
+        TRACE_DEVEL("encr_mgr_encrypt_msg_begin() failed.\n");
 
 done:
-    TRACE_INFO("C_DigestUpdate: rc = 0x%08lx, sess = %ld, datalen = %lu\n",
-               rc, (sess == NULL) ? -1 : (CK_LONG) sess->handle, ulPartLen);
+    TRACE_INFO("C_EncryptMessageBegin: rc = 0x%08lx, sess = %ld\n",
+               rc, (sess == NULL) ? -1 : (CK_LONG) sess->handle);
 
     if (sess != NULL)
         session_mgr_put(tokdata, sess);
@@ -2622,10 +2640,16 @@ done:
 }
 
 
-CK_RV SC_DigestKey(STDLL_TokData_t *tokdata, ST_SESSION_HANDLE *sSession,
-                   CK_OBJECT_HANDLE hKey)
+CK_RV SC_EncryptMessageNext(STDLL_TokData_t *tokdata,
+                            ST_SESSION_HANDLE *sSession,
+                            CK_VOID_PTR pParameter, CK_ULONG ulParameterLen,
+                            CK_BYTE_PTR pPlaintextPart,
+                            CK_ULONG ulPlaintextPartLen,
+                            CK_BYTE_PTR pCiphertextPart,
+                            CK_ULONG_PTR pulCiphertextPartLen, CK_FLAGS flags)
 {
     SESSION *sess = NULL;
+    CK_BBOOL length_only = FALSE;
     CK_RV rc = CKR_OK;
 
     if (tokdata->initialized == FALSE) {
@@ -2641,19 +2665,35 @@ CK_RV SC_DigestKey(STDLL_TokData_t *tokdata, ST_SESSION_HANDLE *sSession,
         goto done;
     }
 
-    if (sess->digest_ctx.active == FALSE) {
+    if (!pParameter || (!pPlaintextPart && ulPlaintextPartLen != 0) ||
+        !pulCiphertextPartLen) {
+        TRACE_ERROR("%s\n", ock_err(ERR_ARGUMENTS_BAD));
+        rc = CKR_ARGUMENTS_BAD;
+        goto done;
+    }
+
+    if (sess->msg_encr_ctx.active == FALSE) {
         TRACE_ERROR("%s\n", ock_err(ERR_OPERATION_NOT_INITIALIZED));
         rc = CKR_OPERATION_NOT_INITIALIZED;
         goto done;
     }
 
-    rc = digest_mgr_digest_key(tokdata, sess, &sess->digest_ctx, hKey);
+    if (!pCiphertextPart)
+        length_only = TRUE;
+
+    rc = encr_mgr_encrypt_msg_next(tokdata, sess, length_only,
+                                   &sess->msg_encr_ctx,
+                                   pParameter, ulParameterLen,
+                                   pPlaintextPart, ulPlaintextPartLen,
+                                   pCiphertextPart, pulCiphertextPartLen,
+                                   flags);
     if (rc != CKR_OK)
-        TRACE_DEVEL("digest_mgr_digest_key() failed.\n");
+        TRACE_DEVEL("encr_mgr_encrypt_msg_next() failed.\n");
 
 done:
-    TRACE_INFO("C_DigestKey: rc = 0x%08lx, sess = %ld, key = %lu\n",
-               rc, (sess == NULL) ? -1 : (CK_LONG) sess->handle, hKey);
+    TRACE_INFO("C_EncryptMessageNext: rc = 0x%08lx, sess = %ld, amount = %lu\n",
+               rc, (sess == NULL) ? -1 : (CK_LONG) sess->handle,
+               ulPlaintextPartLen);
 
     if (sess != NULL)
         session_mgr_put(tokdata, sess);
@@ -2662,11 +2702,10 @@ done:
 }
 
 
-CK_RV SC_DigestFinal(STDLL_TokData_t *tokdata, ST_SESSION_HANDLE *sSession,
-                     CK_BYTE_PTR pDigest, CK_ULONG_PTR pulDigestLen)
+CK_RV SC_MessageEncryptFinal(STDLL_TokData_t *tokdata,
+                             ST_SESSION_HANDLE *sSession)
 {
     SESSION *sess = NULL;
-    CK_BBOOL length_only = FALSE;
     CK_RV rc = CKR_OK;
 
     if (tokdata->initialized == FALSE) {
@@ -2682,22 +2721,16 @@ CK_RV SC_DigestFinal(STDLL_TokData_t *tokdata, ST_SESSION_HANDLE *sSession,
         goto done;
     }
 
-    if (sess->digest_ctx.active == FALSE) {
+    if (sess->msg_encr_ctx.active == FALSE) {
         TRACE_ERROR("%s\n", ock_err(ERR_OPERATION_NOT_INITIALIZED));
         rc = CKR_OPERATION_NOT_INITIALIZED;
         goto done;
     }
 
-    if (!pDigest)
-        length_only = TRUE;
-
-    rc = digest_mgr_digest_final(tokdata, sess, length_only,
-                                 &sess->digest_ctx, pDigest, pulDigestLen);
-    if (rc != CKR_OK)
-        TRACE_ERROR("digest_mgr_digest_final() failed.\n");
+    rc = encr_mgr_cleanup(tokdata, sess, &sess->msg_encr_ctx);
 
 done:
-    TRACE_INFO("C_DigestFinal: rc = 0x%08lx, sess = %ld\n",
+    TRACE_INFO("C_MessageEncryptFinal: rc = 0x%08lx, sess = %ld\n",
                rc, (sess == NULL) ? -1 : (CK_LONG) sess->handle);
 
     if (sess != NULL)
@@ -2707,8 +2740,9 @@ done:
 }
 
 
-CK_RV SC_SignInit(STDLL_TokData_t *tokdata, ST_SESSION_HANDLE *sSession,
-                  CK_MECHANISM_PTR pMechanism, CK_OBJECT_HANDLE hKey)
+CK_RV SC_MessageDecryptInit(STDLL_TokData_t *tokdata,
+                            ST_SESSION_HANDLE *sSession,
+                            CK_MECHANISM_PTR pMechanism, CK_OBJECT_HANDLE hKey)
 {
     SESSION *sess = NULL;
     CK_RV rc = CKR_OK;
@@ -2725,6 +2759,10 @@ CK_RV SC_SignInit(STDLL_TokData_t *tokdata, ST_SESSION_HANDLE *sSession,
         goto done;
     }
 
+    rc = valid_mech(tokdata, pMechanism, CKF_MESSAGE_DECRYPT);
+    if (rc != CKR_OK)
+        goto done;
+
     sess = session_mgr_find_reset_error(tokdata, sSession->sessionh);
     if (!sess) {
         TRACE_ERROR("%s\n", ock_err(ERR_SESSION_HANDLE_INVALID));
@@ -2732,10 +2770,6 @@ CK_RV SC_SignInit(STDLL_TokData_t *tokdata, ST_SESSION_HANDLE *sSession,
         goto done;
     }
 
-    rc = valid_mech(tokdata, pMechanism, CKF_SIGN);
-    if (rc != CKR_OK)
-        goto done;
-
     if (pin_expired(&sess->session_info,
                     tokdata->nv_token_data->token_info.flags) == TRUE) {
         TRACE_ERROR("%s\n", ock_err(ERR_PIN_EXPIRED));
@@ -2743,22 +2777,21 @@ CK_RV SC_SignInit(STDLL_TokData_t *tokdata, ST_SESSION_HANDLE *sSession,
         goto done;
     }
 
-    if (sess->sign_ctx.active == TRUE) {
-        rc = CKR_OPERATION_ACTIVE;
+    if (sess->msg_decr_ctx.active == TRUE) {
         TRACE_ERROR("%s\n", ock_err(ERR_OPERATION_ACTIVE));
+        rc = CKR_OPERATION_ACTIVE;
         goto done;
     }
 
-    sess->sign_ctx.count_statistics = TRUE;
-    rc = sign_mgr_init(tokdata, sess, &sess->sign_ctx, pMechanism, FALSE, hKey,
-                       TRUE);
-    if (rc != CKR_OK)
-        TRACE_DEVEL("sign_mgr_init() failed.\n");
+    sess->msg_decr_ctx.count_statistics = TRUE;
+    rc = decr_mgr_msg_init(tokdata, sess, &sess->msg_decr_ctx, pMechanism, hKey,
+                           TRUE);
 
 done:
-    TRACE_INFO("C_SignInit: rc = 0x%08lx, sess = %ld, mech = 0x%lx\n",
+    TRACE_INFO("C_MessageDecryptInit: rc = 0x%08lx, sess = %ld, "
+               "mech = 0x%lx\n",
                rc, (sess == NULL) ? -1 : (CK_LONG) sess->handle,
-               (pMechanism ? pMechanism->mechanism : (CK_ULONG)-1));
+               (pMechanism ? pMechanism->mechanism : (CK_ULONG)(-1)));
 
     if (sess != NULL)
         session_mgr_put(tokdata, sess);
@@ -2767,9 +2800,12 @@ done:
 }
 
 
-CK_RV SC_Sign(STDLL_TokData_t *tokdata, ST_SESSION_HANDLE *sSession,
-              CK_BYTE_PTR pData, CK_ULONG ulDataLen, CK_BYTE_PTR pSignature,
-              CK_ULONG_PTR pulSignatureLen)
+CK_RV SC_DecryptMessage(STDLL_TokData_t *tokdata, ST_SESSION_HANDLE *sSession,
+                        CK_VOID_PTR pParameter, CK_ULONG ulParameterLen,
+                        CK_BYTE_PTR pAssociatedData,
+                        CK_ULONG ulAssociatedDataLen,
+                        CK_BYTE_PTR pCiphertext, CK_ULONG ulCiphertextLen,
+                        CK_BYTE_PTR pPlaintext, CK_ULONG_PTR pulPlaintextLen)
 {
     SESSION *sess = NULL;
     CK_BBOOL length_only = FALSE;
@@ -2788,34 +2824,34 @@ CK_RV SC_Sign(STDLL_TokData_t *tokdata, ST_SESSION_HANDLE *sSession,
         goto done;
     }
 
-    if (!pData || !pulSignatureLen) {
+    if (!pParameter || (!pAssociatedData && ulAssociatedDataLen != 0) ||
+        (!pCiphertext && ulCiphertextLen != 0) || !pulPlaintextLen) {
         TRACE_ERROR("%s\n", ock_err(ERR_ARGUMENTS_BAD));
         rc = CKR_ARGUMENTS_BAD;
         goto done;
     }
 
-    if (sess->sign_ctx.active == FALSE) {
+    if (sess->msg_decr_ctx.active == FALSE) {
         TRACE_ERROR("%s\n", ock_err(ERR_OPERATION_NOT_INITIALIZED));
         rc = CKR_OPERATION_NOT_INITIALIZED;
         goto done;
     }
 
-    if (!pSignature)
+    if (!pPlaintext)
         length_only = TRUE;
 
-    rc = sign_mgr_sign(tokdata, sess, length_only, &sess->sign_ctx, pData,
-                       ulDataLen, pSignature, pulSignatureLen);
+    rc = decr_mgr_decrypt_msg(tokdata, sess, length_only, &sess->msg_decr_ctx,
+                              pParameter, ulParameterLen,
+                              pAssociatedData, ulAssociatedDataLen,
+                              pCiphertext, ulCiphertextLen,
+                              pPlaintext, pulPlaintextLen);
     if (rc != CKR_OK)
-        TRACE_DEVEL("sign_mgr_sign() failed.\n");
+        TRACE_DEVEL("decr_mgr_decrypt_msg() failed.\n");
 
 done:
-    if (rc != CKR_BUFFER_TOO_SMALL && (rc != CKR_OK || length_only != TRUE)) {
-        if (sess != NULL)
-            sign_mgr_cleanup(tokdata, sess, &sess->sign_ctx);
-    }
-
-    TRACE_INFO("C_Sign: rc = 0x%08lx, sess = %ld, datalen = %lu\n",
-               rc, (sess == NULL) ? -1 : (CK_LONG) sess->handle, ulDataLen);
+    TRACE_INFO("C_DecryptMessage: rc = 0x%08lx, sess = %ld, amount = %lu\n",
+               rc, (sess == NULL) ? -1 : (CK_LONG) sess->handle,
+               ulCiphertextLen);
 
     if (sess != NULL)
         session_mgr_put(tokdata, sess);
@@ -2824,8 +2860,11 @@ done:
 }
 
 
-CK_RV SC_SignUpdate(STDLL_TokData_t *tokdata, ST_SESSION_HANDLE *sSession,
-                    CK_BYTE_PTR pPart, CK_ULONG ulPartLen)
+CK_RV SC_DecryptMessageBegin(STDLL_TokData_t *tokdata,
+                             ST_SESSION_HANDLE *sSession,
+                             CK_VOID_PTR pParameter, CK_ULONG ulParameterLen,
+                             CK_BYTE_PTR pAssociatedData,
+                             CK_ULONG ulAssociatedDataLen)
 {
     SESSION *sess = NULL;
     CK_RV rc = CKR_OK;
@@ -2843,28 +2882,27 @@ CK_RV SC_SignUpdate(STDLL_TokData_t *tokdata, ST_SESSION_HANDLE *sSession,
         goto done;
     }
 
-    if (!pPart && ulPartLen != 0) {
+    if (!pParameter || (!pAssociatedData && ulAssociatedDataLen != 0)) {
         TRACE_ERROR("%s\n", ock_err(ERR_ARGUMENTS_BAD));
         rc = CKR_ARGUMENTS_BAD;
         goto done;
     }
 
-    if (sess->sign_ctx.active == FALSE) {
+    if (sess->msg_decr_ctx.active == FALSE) {
         TRACE_ERROR("%s\n", ock_err(ERR_OPERATION_NOT_INITIALIZED));
         rc = CKR_OPERATION_NOT_INITIALIZED;
         goto done;
     }
 
-    rc = sign_mgr_sign_update(tokdata, sess, &sess->sign_ctx, pPart, ulPartLen);
+    rc = decr_mgr_decrypt_msg_begin(tokdata, sess, &sess->msg_decr_ctx,
+                                    pParameter, ulParameterLen,
+                                    pAssociatedData, ulAssociatedDataLen);
     if (rc != CKR_OK)
-        TRACE_DEVEL("sign_mgr_sign_update() failed.\n");
+        TRACE_DEVEL("decr_mgr_decrypt_msg_begin() failed.\n");
 
 done:
-    if (rc != CKR_OK && sess != NULL)
-        sign_mgr_cleanup(tokdata, sess, &sess->sign_ctx);
-
-    TRACE_INFO("C_SignUpdate: rc = 0x%08lx, sess = %ld, datalen = %lu\n",
-               rc, (sess == NULL) ? -1 : (CK_LONG) sess->handle, ulPartLen);
+    TRACE_INFO("C_DecryptMessageBegin: rc = 0x%08lx, sess = %ld\n",
+               rc, (sess == NULL) ? -1 : (CK_LONG) sess->handle);
 
     if (sess != NULL)
         session_mgr_put(tokdata, sess);
@@ -2873,8 +2911,13 @@ done:
 }
 
 
-CK_RV SC_SignFinal(STDLL_TokData_t *tokdata, ST_SESSION_HANDLE *sSession,
-                   CK_BYTE_PTR pSignature, CK_ULONG_PTR pulSignatureLen)
+CK_RV SC_DecryptMessageNext(STDLL_TokData_t *tokdata,
+                            ST_SESSION_HANDLE *sSession,
+                            CK_VOID_PTR pParameter, CK_ULONG ulParameterLen,
+                            CK_BYTE_PTR pCiphertextPart,
+                            CK_ULONG ulCiphertextPartLen,
+                            CK_BYTE_PTR pPlaintextPart,
+                            CK_ULONG_PTR pulPlaintextPartLen, CK_FLAGS flags)
 {
     SESSION *sess = NULL;
     CK_BBOOL length_only = FALSE;
@@ -2893,33 +2936,72 @@ CK_RV SC_SignFinal(STDLL_TokData_t *tokdata, ST_SESSION_HANDLE *sSession,
         goto done;
     }
 
-    if (!pulSignatureLen) {
+    if (!pParameter || (!pCiphertextPart && ulCiphertextPartLen != 0) ||
+        !pulPlaintextPartLen) {
         TRACE_ERROR("%s\n", ock_err(ERR_ARGUMENTS_BAD));
         rc = CKR_ARGUMENTS_BAD;
         goto done;
     }
 
-    if (sess->sign_ctx.active == FALSE) {
+    if (sess->msg_decr_ctx.active == FALSE) {
         TRACE_ERROR("%s\n", ock_err(ERR_OPERATION_NOT_INITIALIZED));
         rc = CKR_OPERATION_NOT_INITIALIZED;
         goto done;
     }
 
-    if (!pSignature)
+    if (!pPlaintextPart)
         length_only = TRUE;
 
-    rc = sign_mgr_sign_final(tokdata, sess, length_only, &sess->sign_ctx,
-                             pSignature, pulSignatureLen);
+    rc = decr_mgr_decrypt_msg_next(tokdata, sess, length_only,
+                                   &sess->msg_decr_ctx,
+                                   pParameter, ulParameterLen,
+                                   pCiphertextPart, ulCiphertextPartLen,
+                                   pPlaintextPart, pulPlaintextPartLen,
+                                   flags);
     if (rc != CKR_OK)
-        TRACE_ERROR("sign_mgr_sign_final() failed.\n");
+        TRACE_DEVEL("decr_mgr_decrypt_msg_next() failed.\n");
 
 done:
-    if (rc != CKR_BUFFER_TOO_SMALL && (rc != CKR_OK || length_only != TRUE)) {
-        if (sess != NULL)
-            sign_mgr_cleanup(tokdata, sess, &sess->sign_ctx);
+    TRACE_INFO("C_DecryptMessageNext: rc = 0x%08lx, sess = %ld, amount = %lu\n",
+               rc, (sess == NULL) ? -1 : (CK_LONG) sess->handle,
+               ulCiphertextPartLen);
+
+    if (sess != NULL)
+        session_mgr_put(tokdata, sess);
+
+    return rc;
+}
+
+
+CK_RV SC_MessageDecryptFinal(STDLL_TokData_t *tokdata,
+                             ST_SESSION_HANDLE *sSession)
+{
+    SESSION *sess = NULL;
+    CK_RV rc = CKR_OK;
+
+    if (tokdata->initialized == FALSE) {
+        TRACE_ERROR("%s\n", ock_err(ERR_CRYPTOKI_NOT_INITIALIZED));
+        rc = CKR_CRYPTOKI_NOT_INITIALIZED;
+        goto done;
     }
 
-    TRACE_INFO("C_SignFinal: rc = 0x%08lx, sess = %ld\n",
+    sess = session_mgr_find_reset_error(tokdata, sSession->sessionh);
+    if (!sess) {
+        TRACE_ERROR("%s\n", ock_err(ERR_SESSION_HANDLE_INVALID));
+        rc = CKR_SESSION_HANDLE_INVALID;
+        goto done;
+    }
+
+    if (sess->msg_decr_ctx.active == FALSE) {
+        TRACE_ERROR("%s\n", ock_err(ERR_OPERATION_NOT_INITIALIZED));
+        rc = CKR_OPERATION_NOT_INITIALIZED;
+        goto done;
+    }
+
+    rc = decr_mgr_cleanup(tokdata, sess, &sess->msg_decr_ctx);
+
+done:
+    TRACE_INFO("C_MessageDecryptFinal: rc = 0x%08lx, sess = %ld\n",
                rc, (sess == NULL) ? -1 : (CK_LONG) sess->handle);
 
     if (sess != NULL)
@@ -2929,9 +3011,8 @@ done:
 }
 
 
-CK_RV SC_SignRecoverInit(STDLL_TokData_t *tokdata,
-                         ST_SESSION_HANDLE *sSession,
-                         CK_MECHANISM_PTR pMechanism, CK_OBJECT_HANDLE hKey)
+CK_RV SC_DigestInit(STDLL_TokData_t *tokdata, ST_SESSION_HANDLE *sSession,
+                    CK_MECHANISM_PTR pMechanism)
 {
     SESSION *sess = NULL;
     CK_RV rc = CKR_OK;
@@ -2947,7 +3028,7 @@ CK_RV SC_SignRecoverInit(STDLL_TokData_t *tokdata,
         goto done;
     }
 
-    rc = valid_mech(tokdata, pMechanism, CKF_SIGN_RECOVER);
+    rc = valid_mech(tokdata, pMechanism, CKF_DIGEST);
     if (rc != CKR_OK)
         goto done;
 
@@ -2965,19 +3046,19 @@ CK_RV SC_SignRecoverInit(STDLL_TokData_t *tokdata,
         goto done;
     }
 
-    if (sess->sign_ctx.active == TRUE) {
-        rc = CKR_OPERATION_ACTIVE;
+    if (sess->digest_ctx.active == TRUE) {
         TRACE_ERROR("%s\n", ock_err(ERR_OPERATION_ACTIVE));
+        rc = CKR_OPERATION_ACTIVE;
         goto done;
     }
 
-    rc = sign_mgr_init(tokdata, sess, &sess->sign_ctx, pMechanism, TRUE, hKey,
-                       TRUE);
+    sess->digest_ctx.count_statistics = TRUE;
+    rc = digest_mgr_init(tokdata, sess, &sess->digest_ctx, pMechanism, TRUE);
     if (rc != CKR_OK)
-        TRACE_DEVEL("sign_mgr_init() failed.\n");
+        TRACE_DEVEL("digest_mgr_init() failed.\n");
 
 done:
-    TRACE_INFO("C_SignRecoverInit: rc = 0x%08lx, sess = %ld, mech = 0x%lx\n",
+    TRACE_INFO("C_DigestInit: rc = 0x%08lx, sess = %ld, mech = 0x%lx\n",
                rc, (sess == NULL) ? -1 : (CK_LONG) sess->handle,
                (pMechanism ? pMechanism->mechanism : (CK_ULONG)-1));
 
@@ -2988,9 +3069,9 @@ done:
 }
 
 
-CK_RV SC_SignRecover(STDLL_TokData_t *tokdata, ST_SESSION_HANDLE *sSession,
-                     CK_BYTE_PTR pData, CK_ULONG ulDataLen,
-                     CK_BYTE_PTR pSignature, CK_ULONG_PTR pulSignatureLen)
+CK_RV SC_Digest(STDLL_TokData_t *tokdata, ST_SESSION_HANDLE *sSession,
+                CK_BYTE_PTR pData, CK_ULONG ulDataLen, CK_BYTE_PTR pDigest,
+                CK_ULONG_PTR pulDigestLen)
 {
     SESSION *sess = NULL;
     CK_BBOOL length_only = FALSE;
@@ -3009,33 +3090,22 @@ CK_RV SC_SignRecover(STDLL_TokData_t *tokdata, ST_SESSION_HANDLE *sSession,
         goto done;
     }
 
-    if (!pData || !pulSignatureLen) {
-        TRACE_ERROR("%s\n", ock_err(ERR_ARGUMENTS_BAD));
-        rc = CKR_ARGUMENTS_BAD;
-        goto done;
-    }
-
-    if ((sess->sign_ctx.active == FALSE) || (sess->sign_ctx.recover == FALSE)) {
-        rc = CKR_OPERATION_NOT_INITIALIZED;
+    if (sess->digest_ctx.active == FALSE) {
         TRACE_ERROR("%s\n", ock_err(ERR_OPERATION_NOT_INITIALIZED));
+        rc = CKR_OPERATION_NOT_INITIALIZED;
         goto done;
     }
 
-    if (!pSignature)
+    if (!pDigest)
         length_only = TRUE;
 
-    rc = sign_mgr_sign_recover(tokdata, sess, length_only, &sess->sign_ctx,
-                               pData, ulDataLen, pSignature, pulSignatureLen);
+    rc = digest_mgr_digest(tokdata, sess, length_only, &sess->digest_ctx,
+                           pData, ulDataLen, pDigest, pulDigestLen);
     if (rc != CKR_OK)
-        TRACE_DEVEL("sign_mgr_sign_recover() failed.\n");
+        TRACE_DEVEL("digest_mgr_digest() failed.\n");
 
 done:
-    if (rc != CKR_BUFFER_TOO_SMALL && (rc != CKR_OK || length_only != TRUE)) {
-        if (sess != NULL)
-            sign_mgr_cleanup(tokdata, sess, &sess->sign_ctx);
-    }
-
-    TRACE_INFO("C_SignRecover: rc = 0x%08lx, sess = %ld, datalen = %lu\n",
+    TRACE_INFO("C_Digest: rc = 0x%08lx, sess = %ld, datalen = %lu\n",
                rc, (sess == NULL) ? -1 : (CK_LONG) sess->handle, ulDataLen);
 
     if (sess != NULL)
@@ -3045,8 +3115,8 @@ done:
 }
 
 
-CK_RV SC_VerifyInit(STDLL_TokData_t *tokdata, ST_SESSION_HANDLE *sSession,
-                    CK_MECHANISM_PTR pMechanism, CK_OBJECT_HANDLE hKey)
+CK_RV SC_DigestUpdate(STDLL_TokData_t *tokdata, ST_SESSION_HANDLE *sSession,
+                      CK_BYTE_PTR pPart, CK_ULONG ulPartLen)
 {
     SESSION *sess = NULL;
     CK_RV rc = CKR_OK;
@@ -3056,14 +3126,481 @@ CK_RV SC_VerifyInit(STDLL_TokData_t *tokdata, ST_SESSION_HANDLE *sSession,
         rc = CKR_CRYPTOKI_NOT_INITIALIZED;
         goto done;
     }
-    if (!pMechanism) {
-        TRACE_ERROR("%s\n", ock_err(ERR_ARGUMENTS_BAD));
-        rc = CKR_ARGUMENTS_BAD;
-        goto done;
-    }
 
-    rc = valid_mech(tokdata, pMechanism, CKF_VERIFY);
-    if (rc != CKR_OK)
+    sess = session_mgr_find_reset_error(tokdata, sSession->sessionh);
+    if (!sess) {
+        TRACE_ERROR("%s\n", ock_err(ERR_SESSION_HANDLE_INVALID));
+        rc = CKR_SESSION_HANDLE_INVALID;
+        goto done;
+    }
+
+    if (sess->digest_ctx.active == FALSE) {
+        TRACE_ERROR("%s\n", ock_err(ERR_OPERATION_NOT_INITIALIZED));
+        rc = CKR_OPERATION_NOT_INITIALIZED;
+        goto done;
+    }
+
+    /* If there is data to hash, do so. */
+    if (ulPartLen) {
+        rc = digest_mgr_digest_update(tokdata, sess, &sess->digest_ctx,
+                                      pPart, ulPartLen);
+        if (rc != CKR_OK)
+            TRACE_DEVEL("digest_mgr_digest_update() failed.\n");
+    }
+
+done:
+    TRACE_INFO("C_DigestUpdate: rc = 0x%08lx, sess = %ld, datalen = %lu\n",
+               rc, (sess == NULL) ? -1 : (CK_LONG) sess->handle, ulPartLen);
+
+    if (sess != NULL)
+        session_mgr_put(tokdata, sess);
+
+    return rc;
+}
+
+
+CK_RV SC_DigestKey(STDLL_TokData_t *tokdata, ST_SESSION_HANDLE *sSession,
+                   CK_OBJECT_HANDLE hKey)
+{
+    SESSION *sess = NULL;
+    CK_RV rc = CKR_OK;
+
+    if (tokdata->initialized == FALSE) {
+        TRACE_ERROR("%s\n", ock_err(ERR_CRYPTOKI_NOT_INITIALIZED));
+        rc = CKR_CRYPTOKI_NOT_INITIALIZED;
+        goto done;
+    }
+
+    sess = session_mgr_find_reset_error(tokdata, sSession->sessionh);
+    if (!sess) {
+        TRACE_ERROR("%s\n", ock_err(ERR_SESSION_HANDLE_INVALID));
+        rc = CKR_SESSION_HANDLE_INVALID;
+        goto done;
+    }
+
+    if (sess->digest_ctx.active == FALSE) {
+        TRACE_ERROR("%s\n", ock_err(ERR_OPERATION_NOT_INITIALIZED));
+        rc = CKR_OPERATION_NOT_INITIALIZED;
+        goto done;
+    }
+
+    rc = digest_mgr_digest_key(tokdata, sess, &sess->digest_ctx, hKey);
+    if (rc != CKR_OK)
+        TRACE_DEVEL("digest_mgr_digest_key() failed.\n");
+
+done:
+    TRACE_INFO("C_DigestKey: rc = 0x%08lx, sess = %ld, key = %lu\n",
+               rc, (sess == NULL) ? -1 : (CK_LONG) sess->handle, hKey);
+
+    if (sess != NULL)
+        session_mgr_put(tokdata, sess);
+
+    return rc;
+}
+
+
+CK_RV SC_DigestFinal(STDLL_TokData_t *tokdata, ST_SESSION_HANDLE *sSession,
+                     CK_BYTE_PTR pDigest, CK_ULONG_PTR pulDigestLen)
+{
+    SESSION *sess = NULL;
+    CK_BBOOL length_only = FALSE;
+    CK_RV rc = CKR_OK;
+
+    if (tokdata->initialized == FALSE) {
+        TRACE_ERROR("%s\n", ock_err(ERR_CRYPTOKI_NOT_INITIALIZED));
+        rc = CKR_CRYPTOKI_NOT_INITIALIZED;
+        goto done;
+    }
+
+    sess = session_mgr_find_reset_error(tokdata, sSession->sessionh);
+    if (!sess) {
+        TRACE_ERROR("%s\n", ock_err(ERR_SESSION_HANDLE_INVALID));
+        rc = CKR_SESSION_HANDLE_INVALID;
+        goto done;
+    }
+
+    if (sess->digest_ctx.active == FALSE) {
+        TRACE_ERROR("%s\n", ock_err(ERR_OPERATION_NOT_INITIALIZED));
+        rc = CKR_OPERATION_NOT_INITIALIZED;
+        goto done;
+    }
+
+    if (!pDigest)
+        length_only = TRUE;
+
+    rc = digest_mgr_digest_final(tokdata, sess, length_only,
+                                 &sess->digest_ctx, pDigest, pulDigestLen);
+    if (rc != CKR_OK)
+        TRACE_ERROR("digest_mgr_digest_final() failed.\n");
+
+done:
+    TRACE_INFO("C_DigestFinal: rc = 0x%08lx, sess = %ld\n",
+               rc, (sess == NULL) ? -1 : (CK_LONG) sess->handle);
+
+    if (sess != NULL)
+        session_mgr_put(tokdata, sess);
+
+    return rc;
+}
+
+
+CK_RV SC_SignInit(STDLL_TokData_t *tokdata, ST_SESSION_HANDLE *sSession,
+                  CK_MECHANISM_PTR pMechanism, CK_OBJECT_HANDLE hKey)
+{
+    SESSION *sess = NULL;
+    CK_RV rc = CKR_OK;
+
+    if (tokdata->initialized == FALSE) {
+        TRACE_ERROR("%s\n", ock_err(ERR_CRYPTOKI_NOT_INITIALIZED));
+        rc = CKR_CRYPTOKI_NOT_INITIALIZED;
+        goto done;
+    }
+
+    if (!pMechanism) {
+        TRACE_ERROR("%s\n", ock_err(ERR_ARGUMENTS_BAD));
+        rc = CKR_ARGUMENTS_BAD;
+        goto done;
+    }
+
+    sess = session_mgr_find_reset_error(tokdata, sSession->sessionh);
+    if (!sess) {
+        TRACE_ERROR("%s\n", ock_err(ERR_SESSION_HANDLE_INVALID));
+        rc = CKR_SESSION_HANDLE_INVALID;
+        goto done;
+    }
+
+    rc = valid_mech(tokdata, pMechanism, CKF_SIGN);
+    if (rc != CKR_OK)
+        goto done;
+
+    if (pin_expired(&sess->session_info,
+                    tokdata->nv_token_data->token_info.flags) == TRUE) {
+        TRACE_ERROR("%s\n", ock_err(ERR_PIN_EXPIRED));
+        rc = CKR_PIN_EXPIRED;
+        goto done;
+    }
+
+    if (sess->sign_ctx.active == TRUE) {
+        rc = CKR_OPERATION_ACTIVE;
+        TRACE_ERROR("%s\n", ock_err(ERR_OPERATION_ACTIVE));
+        goto done;
+    }
+
+    sess->sign_ctx.count_statistics = TRUE;
+    rc = sign_mgr_init(tokdata, sess, &sess->sign_ctx, pMechanism, FALSE, hKey,
+                       TRUE);
+    if (rc != CKR_OK)
+        TRACE_DEVEL("sign_mgr_init() failed.\n");
+
+done:
+    TRACE_INFO("C_SignInit: rc = 0x%08lx, sess = %ld, mech = 0x%lx\n",
+               rc, (sess == NULL) ? -1 : (CK_LONG) sess->handle,
+               (pMechanism ? pMechanism->mechanism : (CK_ULONG)-1));
+
+    if (sess != NULL)
+        session_mgr_put(tokdata, sess);
+
+    return rc;
+}
+
+
+CK_RV SC_Sign(STDLL_TokData_t *tokdata, ST_SESSION_HANDLE *sSession,
+              CK_BYTE_PTR pData, CK_ULONG ulDataLen, CK_BYTE_PTR pSignature,
+              CK_ULONG_PTR pulSignatureLen)
+{
+    SESSION *sess = NULL;
+    CK_BBOOL length_only = FALSE;
+    CK_RV rc = CKR_OK;
+
+    if (tokdata->initialized == FALSE) {
+        TRACE_ERROR("%s\n", ock_err(ERR_CRYPTOKI_NOT_INITIALIZED));
+        rc = CKR_CRYPTOKI_NOT_INITIALIZED;
+        goto done;
+    }
+
+    sess = session_mgr_find_reset_error(tokdata, sSession->sessionh);
+    if (!sess) {
+        TRACE_ERROR("%s\n", ock_err(ERR_SESSION_HANDLE_INVALID));
+        rc = CKR_SESSION_HANDLE_INVALID;
+        goto done;
+    }
+
+    if (!pData || !pulSignatureLen) {
+        TRACE_ERROR("%s\n", ock_err(ERR_ARGUMENTS_BAD));
+        rc = CKR_ARGUMENTS_BAD;
+        goto done;
+    }
+
+    if (sess->sign_ctx.active == FALSE) {
+        TRACE_ERROR("%s\n", ock_err(ERR_OPERATION_NOT_INITIALIZED));
+        rc = CKR_OPERATION_NOT_INITIALIZED;
+        goto done;
+    }
+
+    if (!pSignature)
+        length_only = TRUE;
+
+    rc = sign_mgr_sign(tokdata, sess, length_only, &sess->sign_ctx, pData,
+                       ulDataLen, pSignature, pulSignatureLen);
+    if (rc != CKR_OK)
+        TRACE_DEVEL("sign_mgr_sign() failed.\n");
+
+done:
+    if (rc != CKR_BUFFER_TOO_SMALL && (rc != CKR_OK || length_only != TRUE)) {
+        if (sess != NULL)
+            sign_mgr_cleanup(tokdata, sess, &sess->sign_ctx);
+    }
+
+    TRACE_INFO("C_Sign: rc = 0x%08lx, sess = %ld, datalen = %lu\n",
+               rc, (sess == NULL) ? -1 : (CK_LONG) sess->handle, ulDataLen);
+
+    if (sess != NULL)
+        session_mgr_put(tokdata, sess);
+
+    return rc;
+}
+
+
+CK_RV SC_SignUpdate(STDLL_TokData_t *tokdata, ST_SESSION_HANDLE *sSession,
+                    CK_BYTE_PTR pPart, CK_ULONG ulPartLen)
+{
+    SESSION *sess = NULL;
+    CK_RV rc = CKR_OK;
+
+    if (tokdata->initialized == FALSE) {
+        TRACE_ERROR("%s\n", ock_err(ERR_CRYPTOKI_NOT_INITIALIZED));
+        rc = CKR_CRYPTOKI_NOT_INITIALIZED;
+        goto done;
+    }
+
+    sess = session_mgr_find_reset_error(tokdata, sSession->sessionh);
+    if (!sess) {
+        TRACE_ERROR("%s\n", ock_err(ERR_SESSION_HANDLE_INVALID));
+        rc = CKR_SESSION_HANDLE_INVALID;
+        goto done;
+    }
+
+    if (!pPart && ulPartLen != 0) {
+        TRACE_ERROR("%s\n", ock_err(ERR_ARGUMENTS_BAD));
+        rc = CKR_ARGUMENTS_BAD;
+        goto done;
+    }
+
+    if (sess->sign_ctx.active == FALSE) {
+        TRACE_ERROR("%s\n", ock_err(ERR_OPERATION_NOT_INITIALIZED));
+        rc = CKR_OPERATION_NOT_INITIALIZED;
+        goto done;
+    }
+
+    rc = sign_mgr_sign_update(tokdata, sess, &sess->sign_ctx, pPart, ulPartLen);
+    if (rc != CKR_OK)
+        TRACE_DEVEL("sign_mgr_sign_update() failed.\n");
+
+done:
+    if (rc != CKR_OK && sess != NULL)
+        sign_mgr_cleanup(tokdata, sess, &sess->sign_ctx);
+
+    TRACE_INFO("C_SignUpdate: rc = 0x%08lx, sess = %ld, datalen = %lu\n",
+               rc, (sess == NULL) ? -1 : (CK_LONG) sess->handle, ulPartLen);
+
+    if (sess != NULL)
+        session_mgr_put(tokdata, sess);
+
+    return rc;
+}
+
+
+CK_RV SC_SignFinal(STDLL_TokData_t *tokdata, ST_SESSION_HANDLE *sSession,
+                   CK_BYTE_PTR pSignature, CK_ULONG_PTR pulSignatureLen)
+{
+    SESSION *sess = NULL;
+    CK_BBOOL length_only = FALSE;
+    CK_RV rc = CKR_OK;
+
+    if (tokdata->initialized == FALSE) {
+        TRACE_ERROR("%s\n", ock_err(ERR_CRYPTOKI_NOT_INITIALIZED));
+        rc = CKR_CRYPTOKI_NOT_INITIALIZED;
+        goto done;
+    }
+
+    sess = session_mgr_find_reset_error(tokdata, sSession->sessionh);
+    if (!sess) {
+        TRACE_ERROR("%s\n", ock_err(ERR_SESSION_HANDLE_INVALID));
+        rc = CKR_SESSION_HANDLE_INVALID;
+        goto done;
+    }
+
+    if (!pulSignatureLen) {
+        TRACE_ERROR("%s\n", ock_err(ERR_ARGUMENTS_BAD));
+        rc = CKR_ARGUMENTS_BAD;
+        goto done;
+    }
+
+    if (sess->sign_ctx.active == FALSE) {
+        TRACE_ERROR("%s\n", ock_err(ERR_OPERATION_NOT_INITIALIZED));
+        rc = CKR_OPERATION_NOT_INITIALIZED;
+        goto done;
+    }
+
+    if (!pSignature)
+        length_only = TRUE;
+
+    rc = sign_mgr_sign_final(tokdata, sess, length_only, &sess->sign_ctx,
+                             pSignature, pulSignatureLen);
+    if (rc != CKR_OK)
+        TRACE_ERROR("sign_mgr_sign_final() failed.\n");
+
+done:
+    if (rc != CKR_BUFFER_TOO_SMALL && (rc != CKR_OK || length_only != TRUE)) {
+        if (sess != NULL)
+            sign_mgr_cleanup(tokdata, sess, &sess->sign_ctx);
+    }
+
+    TRACE_INFO("C_SignFinal: rc = 0x%08lx, sess = %ld\n",
+               rc, (sess == NULL) ? -1 : (CK_LONG) sess->handle);
+
+    if (sess != NULL)
+        session_mgr_put(tokdata, sess);
+
+    return rc;
+}
+
+
+CK_RV SC_SignRecoverInit(STDLL_TokData_t *tokdata,
+                         ST_SESSION_HANDLE *sSession,
+                         CK_MECHANISM_PTR pMechanism, CK_OBJECT_HANDLE hKey)
+{
+    SESSION *sess = NULL;
+    CK_RV rc = CKR_OK;
+
+    if (tokdata->initialized == FALSE) {
+        TRACE_ERROR("%s\n", ock_err(ERR_CRYPTOKI_NOT_INITIALIZED));
+        rc = CKR_CRYPTOKI_NOT_INITIALIZED;
+        goto done;
+    }
+    if (!pMechanism) {
+        TRACE_ERROR("%s\n", ock_err(ERR_ARGUMENTS_BAD));
+        rc = CKR_ARGUMENTS_BAD;
+        goto done;
+    }
+
+    rc = valid_mech(tokdata, pMechanism, CKF_SIGN_RECOVER);
+    if (rc != CKR_OK)
+        goto done;
+
+    sess = session_mgr_find_reset_error(tokdata, sSession->sessionh);
+    if (!sess) {
+        TRACE_ERROR("%s\n", ock_err(ERR_SESSION_HANDLE_INVALID));
+        rc = CKR_SESSION_HANDLE_INVALID;
+        goto done;
+    }
+
+    if (pin_expired(&sess->session_info,
+                    tokdata->nv_token_data->token_info.flags) == TRUE) {
+        TRACE_ERROR("%s\n", ock_err(ERR_PIN_EXPIRED));
+        rc = CKR_PIN_EXPIRED;
+        goto done;
+    }
+
+    if (sess->sign_ctx.active == TRUE) {
+        rc = CKR_OPERATION_ACTIVE;
+        TRACE_ERROR("%s\n", ock_err(ERR_OPERATION_ACTIVE));
+        goto done;
+    }
+
+    rc = sign_mgr_init(tokdata, sess, &sess->sign_ctx, pMechanism, TRUE, hKey,
+                       TRUE);
+    if (rc != CKR_OK)
+        TRACE_DEVEL("sign_mgr_init() failed.\n");
+
+done:
+    TRACE_INFO("C_SignRecoverInit: rc = 0x%08lx, sess = %ld, mech = 0x%lx\n",
+               rc, (sess == NULL) ? -1 : (CK_LONG) sess->handle,
+               (pMechanism ? pMechanism->mechanism : (CK_ULONG)-1));
+
+    if (sess != NULL)
+        session_mgr_put(tokdata, sess);
+
+    return rc;
+}
+
+
+CK_RV SC_SignRecover(STDLL_TokData_t *tokdata, ST_SESSION_HANDLE *sSession,
+                     CK_BYTE_PTR pData, CK_ULONG ulDataLen,
+                     CK_BYTE_PTR pSignature, CK_ULONG_PTR pulSignatureLen)
+{
+    SESSION *sess = NULL;
+    CK_BBOOL length_only = FALSE;
+    CK_RV rc = CKR_OK;
+
+    if (tokdata->initialized == FALSE) {
+        TRACE_ERROR("%s\n", ock_err(ERR_CRYPTOKI_NOT_INITIALIZED));
+        rc = CKR_CRYPTOKI_NOT_INITIALIZED;
+        goto done;
+    }
+
+    sess = session_mgr_find_reset_error(tokdata, sSession->sessionh);
+    if (!sess) {
+        TRACE_ERROR("%s\n", ock_err(ERR_SESSION_HANDLE_INVALID));
+        rc = CKR_SESSION_HANDLE_INVALID;
+        goto done;
+    }
+
+    if (!pData || !pulSignatureLen) {
+        TRACE_ERROR("%s\n", ock_err(ERR_ARGUMENTS_BAD));
+        rc = CKR_ARGUMENTS_BAD;
+        goto done;
+    }
+
+    if ((sess->sign_ctx.active == FALSE) || (sess->sign_ctx.recover == FALSE)) {
+        rc = CKR_OPERATION_NOT_INITIALIZED;
+        TRACE_ERROR("%s\n", ock_err(ERR_OPERATION_NOT_INITIALIZED));
+        goto done;
+    }
+
+    if (!pSignature)
+        length_only = TRUE;
+
+    rc = sign_mgr_sign_recover(tokdata, sess, length_only, &sess->sign_ctx,
+                               pData, ulDataLen, pSignature, pulSignatureLen);
+    if (rc != CKR_OK)
+        TRACE_DEVEL("sign_mgr_sign_recover() failed.\n");
+
+done:
+    if (rc != CKR_BUFFER_TOO_SMALL && (rc != CKR_OK || length_only != TRUE)) {
+        if (sess != NULL)
+            sign_mgr_cleanup(tokdata, sess, &sess->sign_ctx);
+    }
+
+    TRACE_INFO("C_SignRecover: rc = 0x%08lx, sess = %ld, datalen = %lu\n",
+               rc, (sess == NULL) ? -1 : (CK_LONG) sess->handle, ulDataLen);
+
+    if (sess != NULL)
+        session_mgr_put(tokdata, sess);
+
+    return rc;
+}
+
+
+CK_RV SC_VerifyInit(STDLL_TokData_t *tokdata, ST_SESSION_HANDLE *sSession,
+                    CK_MECHANISM_PTR pMechanism, CK_OBJECT_HANDLE hKey)
+{
+    SESSION *sess = NULL;
+    CK_RV rc = CKR_OK;
+
+    if (tokdata->initialized == FALSE) {
+        TRACE_ERROR("%s\n", ock_err(ERR_CRYPTOKI_NOT_INITIALIZED));
+        rc = CKR_CRYPTOKI_NOT_INITIALIZED;
+        goto done;
+    }
+    if (!pMechanism) {
+        TRACE_ERROR("%s\n", ock_err(ERR_ARGUMENTS_BAD));
+        rc = CKR_ARGUMENTS_BAD;
+        goto done;
+    }
+
+    rc = valid_mech(tokdata, pMechanism, CKF_VERIFY);
+    if (rc != CKR_OK)
         goto done;
 
     sess = session_mgr_find_reset_error(tokdata, sSession->sessionh);
@@ -4041,6 +4578,348 @@ done:
     return rc;
 }
 
+CK_RV SC_IBM_CreateObjects(STDLL_TokData_t *tokdata, ST_SESSION_T *sSession,
+                           CK_IBM_OBJECT_TEMPLATE_PTR pTemplates,
+                           CK_ULONG ulObjectCount,
+                           CK_OBJECT_HANDLE_PTR phObjects)
+{
+    SESSION *sess = NULL;
+    CK_RV rc = CKR_OK;
+
+    if (tokdata->initialized == FALSE) {
+        TRACE_ERROR("%s\n", ock_err(ERR_CRYPTOKI_NOT_INITIALIZED));
+        rc = CKR_CRYPTOKI_NOT_INITIALIZED;
+        goto done;
+    }
+
+    sess = session_mgr_find_reset_error(tokdata, sSession->sessionh);
+    if (!sess) {
+        TRACE_ERROR("%s\n", ock_err(ERR_SESSION_HANDLE_INVALID));
+        rc = CKR_SESSION_HANDLE_INVALID;
+        goto done;
+    }
+
+    if (pin_expired(&sess->session_info,
+                    tokdata->nv_token_data->token_info.flags)) {
+        TRACE_ERROR("%s\n", ock_err(ERR_PIN_EXPIRED));
+        rc = CKR_PIN_EXPIRED;
+        goto done;
+    }
+
+    /* Enforces policy */
+    rc = object_mgr_add_objects(tokdata, sess, pTemplates, ulObjectCount,
+                                phObjects);
+    if (rc != CKR_OK)
+        TRACE_DEVEL("object_mgr_add_objects() failed.\n");
+
+done:
+    TRACE_INFO("SC_IBM_CreateObjects: rc = 0x%08lx, sess = %ld, "
+               "count = %lu\n", rc,
+               (sess == NULL) ? -1 : (CK_LONG) sess->handle, ulObjectCount);
+
+    if (sess != NULL)
+        session_mgr_put(tokdata, sess);
+
+    return rc;
+}
+
+CK_RV SC_IBM_GetAttributeValues(STDLL_TokData_t *tokdata,
+                                ST_SESSION_T *sSession,
+                                CK_OBJECT_HANDLE_PTR phObjects,
+                                CK_ULONG ulObjectCount,
+                                CK_IBM_OBJECT_TEMPLATE_PTR pTemplates,
+                                CK_RV *pReturnValues)
+{
+    SESSION *sess = NULL;
+    CK_RV rc = CKR_OK;
+
+    if (tokdata->initialized == FALSE) {
+        TRACE_ERROR("%s\n", ock_err(ERR_CRYPTOKI_NOT_INITIALIZED));
+        rc = CKR_CRYPTOKI_NOT_INITIALIZED;
+        goto done;
+    }
+
+    sess = session_mgr_find_reset_error(tokdata, sSession->sessionh);
+    if (!sess) {
+        TRACE_ERROR("%s\n", ock_err(ERR_SESSION_HANDLE_INVALID));
+        rc = CKR_SESSION_HANDLE_INVALID;
+        goto done;
+    }
+
+    rc = object_mgr_get_attribute_values_multi(tokdata, sess, phObjects,
+                                               ulObjectCount, pTemplates,
+                                               pReturnValues);
+    if (rc != CKR_OK)
+        TRACE_DEVEL("object_mgr_get_attribute_values_multi() failed.\n");
+
+done:
+    TRACE_INFO("SC_IBM_GetAttributeValues: rc = 0x%08lx, sess = %ld, "
+               "count = %lu\n", rc,
+               (sess == NULL) ? -1 : (CK_LONG) sess->handle, ulObjectCount);
+
+    if (sess != NULL)
+        session_mgr_put(tokdata, sess);
+
+    return rc;
+}
+
+CK_RV SC_IBM_DigestBatch(STDLL_TokData_t *tokdata,
+                         ST_SESSION_T *sSession,
+                         CK_MECHANISM_PTR pMechanism,
+                         CK_IBM_DATA_PTR pData,
+                         CK_ULONG ulDataCount,
+                         CK_BYTE_PTR pDigests,
+                         CK_ULONG_PTR pulDigestsLen)
+{
+    SESSION *sess = NULL;
+    CK_RV rc = CKR_OK;
+
+    if (tokdata->initialized == FALSE) {
+        TRACE_ERROR("%s\n", ock_err(ERR_CRYPTOKI_NOT_INITIALIZED));
+        rc = CKR_CRYPTOKI_NOT_INITIALIZED;
+        goto done;
+    }
+
+    rc = valid_mech(tokdata, pMechanism, CKF_DIGEST);
+    if (rc != CKR_OK)
+        goto done;
+
+    sess = session_mgr_find_reset_error(tokdata, sSession->sessionh);
+    if (!sess) {
+        TRACE_ERROR("%s\n", ock_err(ERR_SESSION_HANDLE_INVALID));
+        rc = CKR_SESSION_HANDLE_INVALID;
+        goto done;
+    }
+
+    if (pin_expired(&sess->session_info,
+                    tokdata->nv_token_data->token_info.flags) == TRUE) {
+        TRACE_ERROR("%s\n", ock_err(ERR_PIN_EXPIRED));
+        rc = CKR_PIN_EXPIRED;
+        goto done;
+    }
+
+    if (sess->digest_ctx.active == TRUE) {
+        TRACE_ERROR("%s\n", ock_err(ERR_OPERATION_ACTIVE));
+        rc = CKR_OPERATION_ACTIVE;
+        goto done;
+    }
+
+    rc = digest_mgr_digest_batch(tokdata, sess, pMechanism, pData,
+                                 ulDataCount, pDigests, pulDigestsLen,
+                                 TRUE);
+    if (rc != CKR_OK)
+        TRACE_DEVEL("digest_mgr_digest_batch() failed.\n");
+
+done:
+    TRACE_INFO("SC_IBM_DigestBatch: rc = 0x%08lx, sess = %ld, mech = 0x%lx, "
+               "count = %lu\n", rc,
+               (sess == NULL) ? -1 : (CK_LONG) sess->handle,
+               pMechanism->mechanism, ulDataCount);
+
+    if (sess != NULL)
+        session_mgr_put(tokdata, sess);
+
+    return rc;
+}
+
+CK_RV SC_IBM_VerifyBatch(STDLL_TokData_t *tokdata,
+                         ST_SESSION_T *sSession,
+                         CK_MECHANISM_PTR pMechanism,
+                         CK_IBM_VERIFY_DATA_PTR pItems,
+                         CK_ULONG ulItemCount,
+                         CK_RV *pReturnValues)
+{
+    SESSION *sess = NULL;
+    CK_RV rc = CKR_OK;
+
+    if (tokdata->initialized == FALSE) {
+        TRACE_ERROR("%s\n", ock_err(ERR_CRYPTOKI_NOT_INITIALIZED));
+        rc = CKR_CRYPTOKI_NOT_INITIALIZED;
+        goto done;
+    }
+
+    rc = valid_mech(tokdata, pMechanism, CKF_VERIFY);
+    if (rc != CKR_OK)
+        goto done;
+
+    sess = session_mgr_find_reset_error(tokdata, sSession->sessionh);
+    if (!sess) {
+        TRACE_ERROR("%s\n", ock_err(ERR_SESSION_HANDLE_INVALID));
+        rc = CKR_SESSION_HANDLE_INVALID;
+        goto done;
+    }
+
+    if (pin_expired(&sess->session_info,
+                    tokdata->nv_token_data->token_info.flags) == TRUE) {
+        TRACE_ERROR("%s\n", ock_err(ERR_PIN_EXPIRED));
+        rc = CKR_PIN_EXPIRED;
+        goto done;
+    }
+
+    rc = verify_mgr_verify_batch(tokdata, sess, pMechanism, pItems,
+                                 ulItemCount, pReturnValues, TRUE);
+    if (rc != CKR_OK)
+        TRACE_DEVEL("verify_mgr_verify_batch() failed.\n");
+
+done:
+    TRACE_INFO("SC_IBM_VerifyBatch: rc = 0x%08lx, sess = %ld, mech = 0x%lx, "
+               "count = %lu\n", rc,
+               (sess == NULL) ? -1 : (CK_LONG) sess->handle,
+               pMechanism->mechanism, ulItemCount);
+
+    if (sess != NULL)
+        session_mgr_put(tokdata, sess);
+
+    return rc;
+}
+
+CK_RV SC_IBM_SignAsync(STDLL_TokData_t *tokdata,
+                       ST_SESSION_T *sSession,
+                       CK_MECHANISM_PTR pMechanism,
+                       CK_OBJECT_HANDLE hKey,
+                       CK_BYTE_PTR pData,
+                       CK_ULONG ulDataLen,
+                       CK_BYTE_PTR pSignature,
+                       CK_ULONG_PTR pulSignatureLen,
+                       int iNotifyFd,
+                       CK_ULONG_PTR phOperation)
+{
+    SESSION *sess = NULL;
+    CK_RV rc = CKR_OK;
+
+    if (tokdata->initialized == FALSE) {
+        TRACE_ERROR("%s\n", ock_err(ERR_CRYPTOKI_NOT_INITIALIZED));
+        rc = CKR_CRYPTOKI_NOT_INITIALIZED;
+        goto done;
+    }
+
+    rc = valid_mech(tokdata, pMechanism, CKF_SIGN);
+    if (rc != CKR_OK)
+        goto done;
+
+    sess = session_mgr_find_reset_error(tokdata, sSession->sessionh);
+    if (!sess) {
+        TRACE_ERROR("%s\n", ock_err(ERR_SESSION_HANDLE_INVALID));
+        rc = CKR_SESSION_HANDLE_INVALID;
+        goto done;
+    }
+
+    if (pin_expired(&sess->session_info,
+                    tokdata->nv_token_data->token_info.flags) == TRUE) {
+        TRACE_ERROR("%s\n", ock_err(ERR_PIN_EXPIRED));
+        rc = CKR_PIN_EXPIRED;
+        goto done;
+    }
+
+    rc = async_mgr_submit(tokdata, sess, OP_SIGN_INIT, pMechanism, hKey,
+                          pData, ulDataLen, pSignature, pulSignatureLen,
+                          iNotifyFd, phOperation, TRUE);
+    if (rc != CKR_OK)
+        TRACE_DEVEL("async_mgr_submit() failed.\n");
+
+done:
+    TRACE_INFO("SC_IBM_SignAsync: rc = 0x%08lx, sess = %ld, mech = 0x%lx, "
+               "amount = %lu\n", rc,
+               (sess == NULL) ? -1 : (CK_LONG) sess->handle,
+               pMechanism->mechanism, ulDataLen);
+
+    if (sess != NULL)
+        session_mgr_put(tokdata, sess);
+
+    return rc;
+}
+
+CK_RV SC_IBM_EncryptAsync(STDLL_TokData_t *tokdata,
+                          ST_SESSION_T *sSession,
+                          CK_MECHANISM_PTR pMechanism,
+                          CK_OBJECT_HANDLE hKey,
+                          CK_BYTE_PTR pData,
+                          CK_ULONG ulDataLen,
+                          CK_BYTE_PTR pEncryptedData,
+                          CK_ULONG_PTR pulEncryptedDataLen,
+                          int iNotifyFd,
+                          CK_ULONG_PTR phOperation)
+{
+    SESSION *sess = NULL;
+    CK_RV rc = CKR_OK;
+
+    if (tokdata->initialized == FALSE) {
+        TRACE_ERROR("%s\n", ock_err(ERR_CRYPTOKI_NOT_INITIALIZED));
+        rc = CKR_CRYPTOKI_NOT_INITIALIZED;
+        goto done;
+    }
+
+    rc = valid_mech(tokdata, pMechanism, CKF_ENCRYPT);
+    if (rc != CKR_OK)
+        goto done;
+
+    sess = session_mgr_find_reset_error(tokdata, sSession->sessionh);
+    if (!sess) {
+        TRACE_ERROR("%s\n", ock_err(ERR_SESSION_HANDLE_INVALID));
+        rc = CKR_SESSION_HANDLE_INVALID;
+        goto done;
+    }
+
+    if (pin_expired(&sess->session_info,
+                    tokdata->nv_token_data->token_info.flags) == TRUE) {
+        TRACE_ERROR("%s\n", ock_err(ERR_PIN_EXPIRED));
+        rc = CKR_PIN_EXPIRED;
+        goto done;
+    }
+
+    rc = async_mgr_submit(tokdata, sess, OP_ENCRYPT_INIT, pMechanism, hKey,
+                          pData, ulDataLen, pEncryptedData, pulEncryptedDataLen,
+                          iNotifyFd, phOperation, TRUE);
+    if (rc != CKR_OK)
+        TRACE_DEVEL("async_mgr_submit() failed.\n");
+
+done:
+    TRACE_INFO("SC_IBM_EncryptAsync: rc = 0x%08lx, sess = %ld, mech = 0x%lx, "
+               "amount = %lu\n", rc,
+               (sess == NULL) ? -1 : (CK_LONG) sess->handle,
+               pMechanism->mechanism, ulDataLen);
+
+    if (sess != NULL)
+        session_mgr_put(tokdata, sess);
+
+    return rc;
+}
+
+CK_RV SC_IBM_AsyncWait(STDLL_TokData_t *tokdata,
+                       ST_SESSION_T *sSession,
+                       CK_ULONG hOperation,
+                       CK_BBOOL bBlock)
+{
+    SESSION *sess = NULL;
+    CK_RV rc = CKR_OK;
+
+    if (tokdata->initialized == FALSE) {
+        TRACE_ERROR("%s\n", ock_err(ERR_CRYPTOKI_NOT_INITIALIZED));
+        rc = CKR_CRYPTOKI_NOT_INITIALIZED;
+        goto done;
+    }
+
+    sess = session_mgr_find_reset_error(tokdata, sSession->sessionh);
+    if (!sess) {
+        TRACE_ERROR("%s\n", ock_err(ERR_SESSION_HANDLE_INVALID));
+        rc = CKR_SESSION_HANDLE_INVALID;
+        goto done;
+    }
+
+    rc = async_mgr_wait(tokdata, sess, hOperation, bBlock);
+    if (rc != CKR_OK && rc != CKR_IBM_ASYNC_PENDING)
+        TRACE_DEVEL("async_mgr_wait() returned an error.\n");
+
+done:
+    TRACE_INFO("SC_IBM_AsyncWait: rc = 0x%08lx, sess = %ld, op = 0x%lx\n",
+               rc, (sess == NULL) ? -1 : (CK_LONG) sess->handle, hOperation);
+
+    if (sess != NULL)
+        session_mgr_put(tokdata, sess);
+
+    return rc;
+}
+
 CK_RV SC_HandleEvent(STDLL_TokData_t *tokdata, unsigned int event_type,
                      unsigned int event_flags, const char *payload,
                      unsigned int payload_len)
@@ -4124,6 +5003,24 @@ void SC_SetFunctionList(void)
     function_list.ST_CancelFunction = NULL;     // SC_CancelFunction;
 
     function_list.ST_IBM_ReencryptSingle = SC_IBM_ReencryptSingle;
+    function_list.ST_IBM_CreateObjects = SC_IBM_CreateObjects;
+    function_list.ST_IBM_GetAttributeValues = SC_IBM_GetAttributeValues;
+    function_list.ST_IBM_DigestBatch = SC_IBM_DigestBatch;
+    function_list.ST_IBM_VerifyBatch = SC_IBM_VerifyBatch;
+    function_list.ST_IBM_SignAsync = SC_IBM_SignAsync;
+    function_list.ST_IBM_EncryptAsync = SC_IBM_EncryptAsync;
+    function_list.ST_IBM_AsyncWait = SC_IBM_AsyncWait;
+
+    function_list.ST_MessageEncryptInit = SC_MessageEncryptInit;
+    function_list.ST_EncryptMessage = SC_EncryptMessage;
+    function_list.ST_EncryptMessageBegin = SC_EncryptMessageBegin;
+    function_list.ST_EncryptMessageNext = SC_EncryptMessageNext;
+    function_list.ST_MessageEncryptFinal = SC_MessageEncryptFinal;
+    function_list.ST_MessageDecryptInit = SC_MessageDecryptInit;
+    function_list.ST_DecryptMessage = SC_DecryptMessage;
+    function_list.ST_DecryptMessageBegin = SC_DecryptMessageBegin;
+    function_list.ST_DecryptMessageNext = SC_DecryptMessageNext;
+    function_list.ST_MessageDecryptFinal = SC_MessageDecryptFinal;
 
     function_list.ST_HandleEvent = SC_HandleEvent;
 }
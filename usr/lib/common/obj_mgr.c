@@ -28,9 +28,11 @@
 #include "attributes.h"
 #include "tok_spec_struct.h"
 #include "trace.h"
+#include "shared_memory.h"
 
 #include "../api/apiproto.h"
 #include "../api/policy.h"
+#include "../api/hashmap.h"
 
 static CK_RV object_mgr_check_session(SESSION *sess, CK_BBOOL priv_obj,
                                       CK_BBOOL sess_obj)
@@ -81,6 +83,293 @@ static CK_RV object_mgr_check_session(SESSION *sess, CK_BBOOL priv_obj,
     return CKR_OK;
 }
 
+/*
+ * Attribute index
+ *
+ * To avoid running template_compare() against every object on each
+ * C_FindObjectsInit, all objects are indexed by the values of the attributes
+ * most commonly used in searches. The index maps a hash of the attribute type
+ * and value to a bucket holding the objects (btree and handle) that have
+ * such an attribute. Hash collisions are harmless, because every candidate
+ * object is still compared against the full search template.
+ *
+ * The attributes are listed in the order of preference when selecting the
+ * attribute to use for a search, most selective first.
+ */
+static const CK_ATTRIBUTE_TYPE obj_index_attrs[OBJ_INDEX_NUM_ATTRS] = {
+    CKA_ID, CKA_LABEL, CKA_KEY_TYPE, CKA_CLASS,
+};
+
+/*
+ * Lazy token objects (objload = lazy) have no attributes to index yet. They
+ * are kept in a bucket of their own, which is added to the candidates of
+ * every search. Once loaded, they are re-indexed by their attributes. The
+ * key is outside the range of obj_index_hash() on 64 bit platforms.
+ */
+#define OBJ_INDEX_LAZY_KEY      ((CK_ULONG)-2)
+
+struct obj_index_bucket {
+    CK_ULONG count;
+    CK_ULONG size;
+    OBJ_INDEX_ENTRY *entries;
+};
+
+static CK_ULONG obj_index_hash(CK_ATTRIBUTE_TYPE type, const CK_BYTE *value,
+                               CK_ULONG len)
+{
+    uint64_t h = 0xcbf29ce484222325ULL; /* FNV-1a */
+    CK_ULONG i;
+
+    for (i = 0; i < sizeof(type); i++) {
+        h ^= (type >> (i * 8)) & 0xff;
+        h *= 0x100000001b3ULL;
+    }
+    for (i = 0; i < len; i++) {
+        h ^= value[i];
+        h *= 0x100000001b3ULL;
+    }
+
+    /* The hashmap can not store a key of (CK_ULONG)-1 */
+    return (CK_ULONG)(h >> 1);
+}
+
+static void obj_index_free_bucket(union hashmap_value val)
+{
+    struct obj_index_bucket *b = val.pVal;
+
+    if (b != NULL) {
+        free(b->entries);
+        free(b);
+    }
+}
+
+/*
+ * Sets up the attribute index. The index is optional: if it can not be set
+ * up, searches fall back to scanning all objects.
+ */
+void object_mgr_index_init(STDLL_TokData_t *tokdata)
+{
+    tokdata->obj_index = NULL;
+    tokdata->obj_index_valid = FALSE;
+
+    if (pthread_mutex_init(&tokdata->obj_index_mutex, NULL)) {
+        TRACE_ERROR("Initializing object index lock failed.\n");
+        return;
+    }
+
+    tokdata->obj_index = hashmap_new();
+    if (tokdata->obj_index == NULL) {
+        TRACE_ERROR("%s\n", ock_err(ERR_HOST_MEMORY));
+        pthread_mutex_destroy(&tokdata->obj_index_mutex);
+        return;
+    }
+    tokdata->obj_index_valid = TRUE;
+}
+
+void object_mgr_index_final(STDLL_TokData_t *tokdata)
+{
+    if (tokdata->obj_index == NULL)
+        return;
+
+    hashmap_free(tokdata->obj_index, obj_index_free_bucket);
+    tokdata->obj_index = NULL;
+    tokdata->obj_index_valid = FALSE;
+    pthread_mutex_destroy(&tokdata->obj_index_mutex);
+}
+
+/* The caller must hold the obj_index_mutex */
+static void obj_index_remove_locked(STDLL_TokData_t *tokdata, OBJECT *obj)
+{
+    union hashmap_value val;
+    struct obj_index_bucket *b;
+    OBJECT *moved;
+    CK_ULONG i, j, pos;
+
+    for (i = 0; i < OBJ_INDEX_NUM_ATTRS; i++) {
+        if ((obj->index_mask & (1UL << i)) == 0)
+            continue;
+
+        if (!hashmap_find(tokdata->obj_index, obj->index_keys[i], &val))
+            continue;
+        b = val.pVal;
+
+        pos = obj->index_pos[i];
+        if (pos >= b->count || b->entries[pos].obj != obj)
+            continue;
+
+        /* Move the last entry into the freed slot and update its position */
+        b->count--;
+        if (b->count == 0) {
+            hashmap_delete(tokdata->obj_index, obj->index_keys[i], NULL);
+            obj_index_free_bucket(val);
+            continue;
+        }
+        if (pos == b->count)
+            continue;
+
+        b->entries[pos] = b->entries[b->count];
+        moved = b->entries[pos].obj;
+        for (j = 0; j < OBJ_INDEX_NUM_ATTRS; j++) {
+            if ((moved->index_mask & (1UL << j)) &&
+                moved->index_keys[j] == obj->index_keys[i]) {
+                moved->index_pos[j] = pos;
+                break;
+            }
+        }
+    }
+
+    obj->index_tree = NULL;
+    obj->index_handle = 0;
+    obj->index_mask = 0;
+}
+
+/* The caller must hold the obj_index_mutex */
+static CK_RV obj_index_add_locked(STDLL_TokData_t *tokdata, struct btree *t,
+                                  unsigned long obj_handle, OBJECT *obj)
+{
+    union hashmap_value val;
+    struct obj_index_bucket *b;
+    OBJ_INDEX_ENTRY *entries;
+    CK_ATTRIBUTE *attr;
+    CK_ULONG i, j, key;
+    CK_BBOOL dup;
+
+    obj->index_tree = t;
+    obj->index_handle = obj_handle;
+    obj->index_mask = 0;
+
+    for (i = 0; i < OBJ_INDEX_NUM_ATTRS; i++) {
+        if (obj->lazy) {
+            if (i > 0)
+                break;
+            key = OBJ_INDEX_LAZY_KEY;
+        } else {
+            if (!template_attribute_find(obj->template, obj_index_attrs[i],
+                                         &attr))
+                continue;
+
+            key = obj_index_hash(attr->type, attr->pValue, attr->ulValueLen);
+        }
+        obj->index_keys[i] = key;
+
+        /* Don't add the object twice to the same bucket on a collision */
+        for (j = 0, dup = FALSE; j < i && !dup; j++)
+            dup = (obj->index_mask & (1UL << j)) && obj->index_keys[j] == key;
+        if (dup)
+            continue;
+
+        if (hashmap_find(tokdata->obj_index, key, &val)) {
+            b = val.pVal;
+        } else {
+            b = calloc(1, sizeof(struct obj_index_bucket));
+            if (b == NULL)
+                goto error;
+            val.pVal = b;
+            if (hashmap_add(tokdata->obj_index, key, val, NULL)) {
+                free(b);
+                goto error;
+            }
+        }
+
+        if (b->count >= b->size) {
+            entries = realloc(b->entries, (b->size ? b->size * 2 : 4) *
+                                          sizeof(OBJ_INDEX_ENTRY));
+            if (entries == NULL)
+                goto error;
+            b->entries = entries;
+            b->size = b->size ? b->size * 2 : 4;
+        }
+
+        b->entries[b->count].t = t;
+        b->entries[b->count].obj_handle = obj_handle;
+        b->entries[b->count].obj = obj;
+        obj->index_pos[i] = b->count;
+        obj->index_mask |= (1UL << i);
+        b->count++;
+    }
+
+    return CKR_OK;
+
+error:
+    /*
+     * An incomplete index would cause objects to be missed by searches,
+     * so stop using the index for this token and fall back to scanning.
+     */
+    TRACE_ERROR("%s\n", ock_err(ERR_HOST_MEMORY));
+    obj_index_remove_locked(tokdata, obj);
+    tokdata->obj_index_valid = FALSE;
+    return CKR_HOST_MEMORY;
+}
+
+/*
+ * Adds an object that has just been added to btree @t with handle
+ * @obj_handle to the attribute index.
+ */
+void object_mgr_index_add(STDLL_TokData_t *tokdata, struct btree *t,
+                          unsigned long obj_handle, OBJECT *obj)
+{
+    if (tokdata->obj_index == NULL)
+        return;
+
+    if (pthread_mutex_lock(&tokdata->obj_index_mutex)) {
+        TRACE_ERROR("Object index Lock failed.\n");
+        tokdata->obj_index_valid = FALSE;
+        return;
+    }
+
+    if (tokdata->obj_index_valid)
+        obj_index_add_locked(tokdata, t, obj_handle, obj);
+
+    pthread_mutex_unlock(&tokdata->obj_index_mutex);
+}
+
+/*
+ * Removes an object from the attribute index. Must be called before the
+ * object is removed from its btree.
+ */
+void object_mgr_index_remove(STDLL_TokData_t *tokdata, OBJECT *obj)
+{
+    if (tokdata->obj_index == NULL || obj->index_tree == NULL)
+        return;
+
+    if (pthread_mutex_lock(&tokdata->obj_index_mutex)) {
+        TRACE_ERROR("Object index Lock failed.\n");
+        tokdata->obj_index_valid = FALSE;
+        return;
+    }
+
+    obj_index_remove_locked(tokdata, obj);
+
+    pthread_mutex_unlock(&tokdata->obj_index_mutex);
+}
+
+/*
+ * Re-indexes an object after its template has been changed. The caller must
+ * hold the WRITE lock on the object.
+ */
+void object_mgr_index_update(STDLL_TokData_t *tokdata, OBJECT *obj)
+{
+    struct btree *t;
+    unsigned long obj_handle;
+
+    if (tokdata->obj_index == NULL || obj->index_tree == NULL)
+        return;
+
+    if (pthread_mutex_lock(&tokdata->obj_index_mutex)) {
+        TRACE_ERROR("Object index Lock failed.\n");
+        tokdata->obj_index_valid = FALSE;
+        return;
+    }
+
+    t = obj->index_tree;
+    obj_handle = obj->index_handle;
+    obj_index_remove_locked(tokdata, obj);
+    if (tokdata->obj_index_valid)
+        obj_index_add_locked(tokdata, t, obj_handle, obj);
+
+    pthread_mutex_unlock(&tokdata->obj_index_mutex);
+}
+
 CK_RV object_mgr_add(STDLL_TokData_t *tokdata,
                      SESSION *sess,
                      CK_ATTRIBUTE *pTemplate,
@@ -465,8 +754,8 @@ CK_RV object_mgr_create_final(STDLL_TokData_t *tokdata,
     CK_BBOOL locked = FALSE;
     CK_RV rc;
     unsigned long obj_handle;
-    char fname[PATH_MAX] = "";
-    int fd;
+    struct btree *t;
+    CK_BBOOL named = FALSE;
 
     if (!sess || !obj || !handle) {
         TRACE_ERROR("Invalid function arguments.\n");
@@ -491,7 +780,8 @@ CK_RV object_mgr_create_final(STDLL_TokData_t *tokdata,
         obj->session = sess;
         memset(obj->name, 0x0, sizeof(CK_BYTE) * 8);
 
-        if ((obj_handle = bt_node_add(&tokdata->sess_obj_btree, obj)) == 0) {
+        t = &tokdata->sess_obj_btree;
+        if ((obj_handle = bt_node_add(t, obj)) == 0) {
             TRACE_ERROR("%s\n", ock_err(ERR_HOST_MEMORY));
             return CKR_HOST_MEMORY;
         }
@@ -522,24 +812,12 @@ CK_RV object_mgr_create_final(STDLL_TokData_t *tokdata,
             }
         }
 
-        /* create unique file name in token directory */
-        if (ock_snprintf(fname, sizeof(fname), "%s/" PK_LITE_OBJ_DIR "/%s",
-                         tokdata->data_store, "OBXXXXXX") != 0) {
-            TRACE_ERROR("buffer overflow for object path");
-            rc = CKR_FUNCTION_FAILED;
-            goto done;
-        }
-
-        fd = mkstemp(fname);
-        if (fd < 0) {
-            TRACE_ERROR("mkstemp failed with: %s\n", strerror(errno));
-            rc = CKR_FUNCTION_FAILED;
+        rc = get_new_token_object_name(tokdata, obj->name);
+        if (rc != CKR_OK)
             goto done;
-        }
-        close(fd); /* written and permissions set by save_token_object */
+        named = TRUE;
 
         obj->session = NULL;
-        memcpy(&obj->name, &fname[strlen(fname) - 8], 8);
 
         rc = save_token_object(tokdata, obj);
         if (rc != CKR_OK)
@@ -547,14 +825,19 @@ CK_RV object_mgr_create_final(STDLL_TokData_t *tokdata,
 
         // add the object identifier to the shared memory segment
         //
-        object_mgr_add_to_shm(obj, tokdata->global_shm);
+        rc = object_mgr_add_to_shm(obj, tokdata->global_shm);
+        if (rc != CKR_OK) {
+            TRACE_DEVEL("object_mgr_add_to_shm failed.\n");
+            goto done;
+        }
 
         // now, store the object in the token object btree
         //
         if (priv_obj)
-            obj_handle = bt_node_add(&tokdata->priv_token_obj_btree, obj);
+            t = &tokdata->priv_token_obj_btree;
         else
-            obj_handle = bt_node_add(&tokdata->publ_token_obj_btree, obj);
+            t = &tokdata->publ_token_obj_btree;
+        obj_handle = bt_node_add(t, obj);
 
         if (!obj_handle) {
             TRACE_ERROR("%s\n", ock_err(ERR_HOST_MEMORY));
@@ -594,6 +877,8 @@ CK_RV object_mgr_create_final(STDLL_TokData_t *tokdata,
 
             object_mgr_del_from_shm(obj, tokdata->global_shm);
         }
+    } else {
+        object_mgr_index_add(tokdata, t, obj_handle, obj);
     }
 
 done:
@@ -604,6 +889,9 @@ done:
                 TRACE_ERROR("Failed to release Process Lock.\n");
             }
         } else {
+            /* remove what was already stored of the new token object */
+            if (named)
+                delete_token_object(tokdata, obj);
             /* return error that occurred first */
             XProcUnLock(tokdata);
         }
@@ -611,45 +899,21 @@ done:
 
     if (rc == CKR_OK)
         TRACE_DEVEL("Object created: handle: %lu\n", *handle);
-    else if (fname[0] != '\0')
-        remove(fname);
 
     return rc;
 }
 
-CK_RV object_mgr_destroy_object(STDLL_TokData_t *tokdata,
-                                SESSION *sess, CK_OBJECT_HANDLE handle)
+//
+// Removes the object with the given handle from the object map and the
+// token, without any checks whether this is allowed.
+//
+static CK_RV object_mgr_remove_object(STDLL_TokData_t *tokdata,
+                                      CK_OBJECT_HANDLE handle)
 {
     CK_RV rc = CKR_OK;
     OBJECT_MAP *map;
     OBJECT *o = NULL;
     CK_BBOOL locked = FALSE;
-    CK_BBOOL priv_obj;
-    CK_BBOOL sess_obj;
-
-    UNUSED(sess);
-
-    rc = object_mgr_find_in_map1(tokdata, handle, &o, READ_LOCK);
-    if (rc != CKR_OK || o == NULL) {
-        TRACE_DEVEL("object_mgr_find_in_map1 failed.\n");
-        return CKR_OBJECT_HANDLE_INVALID;
-    }
-
-    if (!object_is_destroyable(o)) {
-        TRACE_ERROR("Object is not destroyable\n");
-        object_put(tokdata, o, TRUE);
-        o = NULL;
-        return CKR_ACTION_PROHIBITED;
-    }
-
-    sess_obj = object_is_session_object(o);
-    priv_obj = object_is_private(o);
-
-    rc = object_mgr_check_session(sess, priv_obj, sess_obj);
-    object_put(tokdata, o, TRUE);
-    o = NULL;
-    if (rc != CKR_OK)
-        return rc;
 
     /* Don't use a delete callback, the map will be freed below */
     map = bt_node_free(&tokdata->object_map_btree, handle, FALSE);
@@ -659,6 +923,12 @@ CK_RV object_mgr_destroy_object(STDLL_TokData_t *tokdata,
     }
 
     if (map->is_session_obj) {
+        o = bt_get_node_value(&tokdata->sess_obj_btree, map->obj_handle);
+        if (o != NULL) {
+            object_mgr_index_remove(tokdata, o);
+            bt_put_node_value(&tokdata->sess_obj_btree, o);
+            o = NULL;
+        }
         bt_node_free(&tokdata->sess_obj_btree, map->obj_handle, TRUE);
     } else {
         if (XProcLock(tokdata)) {
@@ -681,6 +951,7 @@ CK_RV object_mgr_destroy_object(STDLL_TokData_t *tokdata,
 
 
         delete_token_object(tokdata, o);
+        object_mgr_index_remove(tokdata, o);
 
         DUMP_SHM(tokdata->global_shm, "before");
         object_mgr_del_from_shm(o, tokdata->global_shm);
@@ -722,6 +993,104 @@ done:
     return rc;
 }
 
+CK_RV object_mgr_destroy_object(STDLL_TokData_t *tokdata,
+                                SESSION *sess, CK_OBJECT_HANDLE handle)
+{
+    CK_RV rc = CKR_OK;
+    OBJECT *o = NULL;
+    CK_BBOOL priv_obj;
+    CK_BBOOL sess_obj;
+
+    UNUSED(sess);
+
+    rc = object_mgr_find_in_map1(tokdata, handle, &o, READ_LOCK);
+    if (rc != CKR_OK || o == NULL) {
+        TRACE_DEVEL("object_mgr_find_in_map1 failed.\n");
+        return CKR_OBJECT_HANDLE_INVALID;
+    }
+
+    if (!object_is_destroyable(o)) {
+        TRACE_ERROR("Object is not destroyable\n");
+        object_put(tokdata, o, TRUE);
+        o = NULL;
+        return CKR_ACTION_PROHIBITED;
+    }
+
+    sess_obj = object_is_session_object(o);
+    priv_obj = object_is_private(o);
+
+    rc = object_mgr_check_session(sess, priv_obj, sess_obj);
+    object_put(tokdata, o, TRUE);
+    o = NULL;
+    if (rc != CKR_OK)
+        return rc;
+
+    return object_mgr_remove_object(tokdata, handle);
+}
+
+//
+// Creates several objects like object_mgr_add() does, either all of them or
+// none. The token lock (XProcLock) is held for the whole time, and the token
+// object writes are deferred until all objects are created, so that they are
+// written, and OBJ.IDX is updated, in one go.
+//
+CK_RV object_mgr_add_objects(STDLL_TokData_t *tokdata,
+                             SESSION *sess,
+                             CK_IBM_OBJECT_TEMPLATE *pTemplates,
+                             CK_ULONG ulObjectCount,
+                             CK_OBJECT_HANDLE *handles)
+{
+    CK_ULONG i, created = 0;
+    CK_RV rc, rc2;
+
+    if (!sess || (!pTemplates && ulObjectCount > 0) || !handles) {
+        TRACE_ERROR("Invalid function arguments.\n");
+        return CKR_ARGUMENTS_BAD;
+    }
+
+    rc = XProcLock(tokdata);
+    if (rc != CKR_OK) {
+        TRACE_ERROR("Failed to get Process Lock.\n");
+        return rc;
+    }
+
+    rc = begin_token_object_writeback(tokdata);
+    if (rc != CKR_OK)
+        goto unlock;
+
+    for (created = 0; created < ulObjectCount; created++) {
+        rc = object_mgr_add(tokdata, sess, pTemplates[created].pTemplate,
+                            pTemplates[created].ulCount, &handles[created]);
+        if (rc != CKR_OK) {
+            TRACE_DEVEL("object_mgr_add() failed for object %lu.\n", created);
+            break;
+        }
+    }
+
+    rc2 = end_token_object_writeback(tokdata, rc != CKR_OK);
+    if (rc == CKR_OK)
+        rc = rc2;
+
+    if (rc != CKR_OK) {
+        for (i = 0; i < created; i++) {
+            object_mgr_remove_object(tokdata, handles[i]);
+            handles[i] = CK_INVALID_HANDLE;
+        }
+    }
+
+unlock:
+    if (rc == CKR_OK) {
+        rc = XProcUnLock(tokdata);
+        if (rc != CKR_OK)
+            TRACE_ERROR("Failed to release Process Lock.\n");
+    } else {
+        /* return error that occurred first */
+        XProcUnLock(tokdata);
+    }
+
+    return rc;
+}
+
 /* delete_token_obj_cb
  *
  * Callback to delete an object if its a token object
@@ -757,6 +1126,7 @@ void delete_token_obj_cb(STDLL_TokData_t *tokdata, void *node,
         locked = TRUE;
 
         delete_token_object(tokdata, o);
+        object_mgr_index_remove(tokdata, o);
 
         object_mgr_del_from_shm(o, tokdata->global_shm);
 
@@ -806,13 +1176,20 @@ CK_RV object_mgr_destroy_token_objects(STDLL_TokData_t *tokdata)
 
     // now we want to purge the token object list in shared memory
     //
+    object_mgr_shm_write_begin(tokdata->global_shm);
+
     tokdata->global_shm->num_priv_tok_obj = 0;
     tokdata->global_shm->num_publ_tok_obj = 0;
+    tokdata->global_shm->num_priv_tok_obj_slots = 0;
+    tokdata->global_shm->num_publ_tok_obj_slots = 0;
 
-    memset(&tokdata->global_shm->publ_tok_objs, 0x0,
-           MAX_TOK_OBJS * sizeof(TOK_OBJ_ENTRY));
-    memset(&tokdata->global_shm->priv_tok_objs, 0x0,
-           MAX_TOK_OBJS * sizeof(TOK_OBJ_ENTRY));
+    memset(object_mgr_shm_entries(tokdata->global_shm, FALSE), 0x0,
+           2 * tokdata->global_shm->tok_obj_capacity * sizeof(TOK_OBJ_ENTRY));
+
+    // skip over the whole change log, so that all processes do a full resync
+    tokdata->global_shm->tok_obj_change_seq += TOK_OBJ_CHANGE_LOG_SIZE + 1;
+
+    object_mgr_shm_write_end(tokdata->global_shm);
 
     rc = XProcUnLock(tokdata);
     if (rc != CKR_OK) {
@@ -897,6 +1274,36 @@ CK_RV object_mgr_find_in_map_nocache(STDLL_TokData_t *tokdata,
     return rc;
 }
 
+/*
+ * Returns the object that a map handle refers to, with a reference taken on
+ * it, and the btree holding it. The caller must release the reference with
+ * bt_put_node_value(). Returns NULL if the handle is invalid.
+ */
+static OBJECT *object_mgr_map_get_object(STDLL_TokData_t *tokdata,
+                                         CK_OBJECT_HANDLE handle,
+                                         struct btree **t)
+{
+    OBJECT_MAP *map;
+    OBJECT *obj;
+
+    map = bt_get_node_value(&tokdata->object_map_btree, handle);
+    if (map == NULL)
+        return NULL;
+
+    if (map->is_session_obj)
+        *t = &tokdata->sess_obj_btree;
+    else if (map->is_private)
+        *t = &tokdata->priv_token_obj_btree;
+    else
+        *t = &tokdata->publ_token_obj_btree;
+
+    obj = bt_get_node_value(*t, map->obj_handle);
+
+    bt_put_node_value(&tokdata->object_map_btree, map);
+
+    return obj;
+}
+
 // object_mgr_find_in_map1()
 //
 // Locates the specified object in the map
@@ -998,42 +1405,43 @@ done:
     return rc;
 }
 
-void find_obj_cb(STDLL_TokData_t *tokdata, void *node,
-                 unsigned long map_handle, void *p3)
+/*
+ * Returns TRUE if the object map entry @map_handle refers to object @obj.
+ * The map handle stored in the object (obj->map_handle) is used as a reverse
+ * index from the object to its map entry. It can become stale when the map
+ * entry is freed (e.g. by object_mgr_purge_map()) and possibly re-used for
+ * another object, so it must always be verified before it is used.
+ */
+static CK_BBOOL object_mgr_map_refers_to(STDLL_TokData_t *tokdata,
+                                         CK_OBJECT_HANDLE map_handle,
+                                         OBJECT *obj)
 {
-    OBJECT_MAP *map = (OBJECT_MAP *) node;
-    OBJECT *obj;
-    struct find_args *fa = (struct find_args *) p3;
+    OBJECT_MAP *map;
+    struct btree *t;
+    OBJECT *o;
+    CK_BBOOL ret;
 
-    UNUSED(tokdata);
+    if (map_handle == CK_INVALID_HANDLE)
+        return FALSE;
 
-    if (fa->done)
-        return;
+    map = bt_get_node_value(&tokdata->object_map_btree, map_handle);
+    if (map == NULL)
+        return FALSE;
 
     if (map->is_session_obj)
-        obj = bt_get_node_value(&tokdata->sess_obj_btree, map->obj_handle);
+        t = &tokdata->sess_obj_btree;
     else if (map->is_private)
-        obj = bt_get_node_value(&tokdata->priv_token_obj_btree, map->obj_handle);
+        t = &tokdata->priv_token_obj_btree;
     else
-        obj = bt_get_node_value(&tokdata->publ_token_obj_btree, map->obj_handle);
+        t = &tokdata->publ_token_obj_btree;
 
-    if (!obj)
-        return;
+    o = bt_get_node_value(t, map->obj_handle);
+    ret = (o == obj);
 
-    /* if this object is the one we're looking for (matches p3->obj), return
-     * its map_handle in p3->map_handle */
-    if (obj == fa->obj) {
-        fa->map_handle = map_handle;
-        fa->done = TRUE;
-    }
+    bt_put_node_value(t, o);
+    bt_put_node_value(&tokdata->object_map_btree, map);
 
-    if (map->is_session_obj)
-        bt_put_node_value(&tokdata->sess_obj_btree, obj);
-    else if (map->is_private)
-        bt_put_node_value(&tokdata->priv_token_obj_btree, obj);
-    else
-        bt_put_node_value(&tokdata->publ_token_obj_btree, obj);
-    obj = NULL;
+    return ret;
 }
 
 // object_mgr_find_in_map2()
@@ -1043,7 +1451,6 @@ void find_obj_cb(STDLL_TokData_t *tokdata, void *node,
 CK_RV object_mgr_find_in_map2(STDLL_TokData_t *tokdata,
                               OBJECT *obj, CK_OBJECT_HANDLE *handle)
 {
-    struct find_args fa;
     CK_RV rc;
 
     if (!obj || !handle) {
@@ -1051,19 +1458,10 @@ CK_RV object_mgr_find_in_map2(STDLL_TokData_t *tokdata,
         return CKR_FUNCTION_FAILED;
     }
 
-    fa.done = FALSE;
-    fa.obj = obj;
-    fa.map_handle = 0;
-
-    // pass the fa structure with the values to operate on in the find_obj_cb
-    // function
-    bt_for_each_node(tokdata, &tokdata->object_map_btree, find_obj_cb, &fa);
-
-    if (fa.done == FALSE || fa.map_handle == 0) {
+    if (!object_mgr_map_refers_to(tokdata, obj->map_handle, obj))
         return CKR_OBJECT_HANDLE_INVALID;
-    }
 
-    *handle = fa.map_handle;
+    *handle = obj->map_handle;
 
     if (!object_is_session_object(obj)) {
         rc = object_mgr_check_shm(tokdata, obj);
@@ -1076,22 +1474,56 @@ CK_RV object_mgr_find_in_map2(STDLL_TokData_t *tokdata,
     return CKR_OK;
 }
 
-void find_build_list_cb(STDLL_TokData_t *tokdata, void *node,
-                        unsigned long obj_handle, void *p3)
+/*
+ * State of an active object search of a session (sess->find_cursor).
+ *
+ * C_FindObjectsInit only sets up the cursor. The objects are matched
+ * against the search template, and the matching objects are added to the
+ * object map, as C_FindObjects asks for them. So a search that only asks
+ * for the first match does not need to look at all objects.
+ *
+ * The cursor either walks the object btrees node by node, or the candidates
+ * taken from the attribute index at C_FindObjectsInit time. Objects that are
+ * destroyed while the search is active are skipped, objects that are created
+ * while it is active may or may not be found.
+ */
+struct find_cursor {
+    struct find_build_list_args fa;
+    CK_ATTRIBUTE *template;         /* copy of the search template */
+    CK_ULONG template_len;
+    struct btree *trees[3];
+    CK_ULONG num_trees;
+    CK_ULONG tree;                  /* current btree */
+    unsigned long node;             /* next node of the current btree */
+    CK_BBOOL use_index;
+    OBJ_INDEX_ENTRY *entries;       /* candidates from the attribute index */
+    CK_ULONG num_entries;
+    CK_ULONG entry;                 /* next candidate */
+};
+
+/*
+ * Checks if the object matches the search in fa, and returns its handle
+ * from the object map (it is added to the map if necessary).
+ */
+static CK_BBOOL find_match_object(STDLL_TokData_t *tokdata, OBJECT *obj,
+                                  unsigned long obj_handle,
+                                  struct find_build_list_args *fa,
+                                  CK_OBJECT_HANDLE *map_handle)
 {
-    OBJECT *obj = (OBJECT *) node;
-    struct find_build_list_args *fa = (struct find_build_list_args *) p3;
-    CK_OBJECT_HANDLE map_handle = CK_INVALID_HANDLE;
     CK_BBOOL match = FALSE, flag = FALSE;
-    CK_OBJECT_HANDLE *find_list;
-    CK_ULONG find_len;
     CK_OBJECT_CLASS class;
     CK_RV rc;
 
     if (object_lock(obj, READ_LOCK) != CKR_OK)
-        return;
+        return FALSE;
 
     if ((object_is_private(obj) == FALSE) || (fa->public_only == FALSE)) {
+        // a lazy token object must be loaded before it can be matched
+        if (obj->lazy && object_mgr_check_shm(tokdata, obj) != CKR_OK) {
+            TRACE_DEVEL("object_mgr_check_shm failed.\n");
+            goto done;
+        }
+
         // if the user doesn't specify any template attributes then we return
         // all objects
         //
@@ -1100,62 +1532,130 @@ void find_build_list_cb(STDLL_TokData_t *tokdata, void *node,
         else
             match = template_compare(fa->pTemplate, fa->ulCount, obj->template);
     }
-    // if we have a match, find the object in the map (add it if necessary)
-    // then add the object to the list of found objects //
-    if (match) {
-        rc = object_mgr_find_in_map2(tokdata, obj, &map_handle);
-        if (rc != CKR_OK) {
-            rc = object_mgr_add_to_map(tokdata, fa->sess, obj, obj_handle,
-                                       &map_handle);
-            if (rc != CKR_OK) {
-                TRACE_DEVEL("object_mgr_add_to_map failed.\n");
-                goto done;
-            }
+    if (!match)
+        goto done;
+
+    // If hw_feature is false here, we need to filter out all objects
+    // that have the CKO_HW_FEATURE attribute set. - KEY
+    if (fa->hw_feature == FALSE &&
+        template_attribute_get_ulong(obj->template, CKA_CLASS,
+                                     &class) == CKR_OK) {
+        if (class == CKO_HW_FEATURE) {
+            match = FALSE;
+            goto done;
         }
-        // If hw_feature is false here, we need to filter out all objects
-        // that have the CKO_HW_FEATURE attribute set. - KEY
-        if (fa->hw_feature == FALSE &&
-            template_attribute_get_ulong(obj->template, CKA_CLASS,
-                                         &class) == CKR_OK) {
-             if (class == CKO_HW_FEATURE)
-                goto done;
+    }
+
+    /* Don't find objects that have been created with the CKA_HIDDEN
+     * attribute set */
+    if (fa->hidden_object == FALSE &&
+        template_attribute_get_bool(obj->template, CKA_HIDDEN,
+                                    &flag) == CKR_OK) {
+        if (flag == TRUE) {
+            match = FALSE;
+            goto done;
         }
+    }
 
-        /* Don't find objects that have been created with the CKA_HIDDEN
-         * attribute set */
-        if (fa->hidden_object == FALSE &&
-            template_attribute_get_bool(obj->template, CKA_HIDDEN,
-                                        &flag) == CKR_OK) {
-            if (flag == TRUE)
-                goto done;
+    // find the object in the map (add it if necessary)
+    rc = object_mgr_find_in_map2(tokdata, obj, map_handle);
+    if (rc != CKR_OK) {
+        rc = object_mgr_add_to_map(tokdata, fa->sess, obj, obj_handle,
+                                   map_handle);
+        if (rc != CKR_OK) {
+            TRACE_DEVEL("object_mgr_add_to_map failed.\n");
+            match = FALSE;
         }
+    }
 
-        fa->sess->find_list[fa->sess->find_count] = map_handle;
-        fa->sess->find_count++;
+done:
+    object_unlock(obj);
+    return match;
+}
 
-        if (fa->sess->find_count >= fa->sess->find_len) {
-            fa->sess->find_len += 15;
-            find_len = fa->sess->find_len + 15;
-            find_list = (CK_OBJECT_HANDLE *)realloc(fa->sess->find_list,
-                                        find_len * sizeof(CK_OBJECT_HANDLE));
-            if (!find_list) {
-                TRACE_ERROR("%s\n", ock_err(ERR_HOST_MEMORY));
-                goto done;
+/*
+ * Uses the attribute index to get the candidate objects for the search
+ * template in fa. The caller must free the returned candidates.
+ * Returns FALSE if the index can not be used for this search, so that the
+ * caller needs to scan all objects.
+ */
+static CK_BBOOL obj_index_find(STDLL_TokData_t *tokdata,
+                               struct find_build_list_args *fa,
+                               OBJ_INDEX_ENTRY **candidates,
+                               CK_ULONG *num_candidates)
+{
+    union hashmap_value val;
+    struct obj_index_bucket *b;
+    OBJ_INDEX_ENTRY *entries = NULL, *tmp;
+    CK_ATTRIBUTE *attr = NULL;
+    CK_ULONG keys[2];
+    CK_ULONG i, j, k, count = 0;
+
+    if (tokdata->obj_index == NULL || fa->pTemplate == NULL)
+        return FALSE;
+
+    for (i = 0; i < OBJ_INDEX_NUM_ATTRS && attr == NULL; i++) {
+        for (j = 0; j < fa->ulCount; j++) {
+            if (fa->pTemplate[j].type == obj_index_attrs[i] &&
+                (fa->pTemplate[j].pValue != NULL ||
+                 fa->pTemplate[j].ulValueLen == 0)) {
+                attr = &fa->pTemplate[j];
+                break;
             }
-            fa->sess->find_list = find_list;
-            fa->sess->find_len = find_len;
         }
     }
+    if (attr == NULL)
+        return FALSE;
 
-done:
-    object_unlock(obj);
+    if (pthread_mutex_lock(&tokdata->obj_index_mutex)) {
+        TRACE_ERROR("Object index Lock failed.\n");
+        return FALSE;
+    }
+
+    if (!tokdata->obj_index_valid) {
+        pthread_mutex_unlock(&tokdata->obj_index_mutex);
+        return FALSE;
+    }
+
+    /*
+     * Take a copy of the candidates, they must not be matched while holding
+     * the index lock, since matching might re-index objects.
+     * The lazy objects not loaded yet are candidates for every search.
+     */
+    keys[0] = obj_index_hash(attr->type, attr->pValue, attr->ulValueLen);
+    keys[1] = OBJ_INDEX_LAZY_KEY;
+    for (k = 0; k < 2; k++) {
+        if (!hashmap_find(tokdata->obj_index, keys[k], &val))
+            continue;
+        b = val.pVal;
+        if (b->count == 0)
+            continue;
+
+        tmp = realloc(entries, (count + b->count) * sizeof(OBJ_INDEX_ENTRY));
+        if (tmp == NULL) {
+            pthread_mutex_unlock(&tokdata->obj_index_mutex);
+            free(entries);
+            return FALSE;
+        }
+        entries = tmp;
+        memcpy(entries + count, b->entries,
+               b->count * sizeof(OBJ_INDEX_ENTRY));
+        count += b->count;
+    }
+
+    pthread_mutex_unlock(&tokdata->obj_index_mutex);
+
+    *candidates = entries;
+    *num_candidates = count;
+
+    return TRUE;
 }
 
 CK_RV object_mgr_find_init(STDLL_TokData_t *tokdata,
                            SESSION *sess,
                            CK_ATTRIBUTE *pTemplate, CK_ULONG ulCount)
 {
-    struct find_build_list_args fa;
+    struct find_cursor *cur;
     CK_OBJECT_CLASS class = 0;
     CK_BBOOL flag = FALSE;
     CK_RV rc;
@@ -1170,30 +1670,51 @@ CK_RV object_mgr_find_init(STDLL_TokData_t *tokdata,
         return CKR_OPERATION_ACTIVE;
         TRACE_ERROR("%s\n", ock_err(ERR_OPERATION_ACTIVE));
     }
-    // initialize the found object list.  if it doesn't exist, allocate
-    // a list big enough for 10 handles.  we'll reallocate if we need more
-    //
-    if (sess->find_list != NULL) {
-        memset(sess->find_list, 0x0, sess->find_len * sizeof(CK_OBJECT_HANDLE));
-    } else {
-        sess->find_list =
-            (CK_OBJECT_HANDLE *) malloc(10 * sizeof(CK_OBJECT_HANDLE));
-        if (!sess->find_list) {
-            TRACE_ERROR("%s\n", ock_err(ERR_HOST_MEMORY));
-            return CKR_HOST_MEMORY;
-        } else {
-            memset(sess->find_list, 0x0, 10 * sizeof(CK_OBJECT_HANDLE));
-            sess->find_len = 10;
+
+    // PKCS#11 v2.11 (pg. 79): "When searching using C_FindObjectsInit
+    // and C_FindObjects, hardware feature objects are not returned
+    // unless the CKA_CLASS attribute in the template has the value
+    // CKO_HW_FEATURE." So, we check for CKO_HW_FEATURE and if its set,
+    // we'll find these objects below. - KEY
+    rc = get_ulong_attribute_by_type(pTemplate, ulCount, CKA_CLASS, &class);
+    if (rc == CKR_ATTRIBUTE_VALUE_INVALID) {
+        TRACE_ERROR("%s\n", ock_err(ERR_ATTRIBUTE_VALUE_INVALID));
+        return CKR_ATTRIBUTE_VALUE_INVALID;
+    }
+
+    rc = get_bool_attribute_by_type(pTemplate, ulCount, CKA_HIDDEN, &flag);
+    if (rc == CKR_ATTRIBUTE_VALUE_INVALID) {
+        TRACE_ERROR("%s\n", ock_err(ERR_ATTRIBUTE_VALUE_INVALID));
+        return CKR_ATTRIBUTE_VALUE_INVALID;
+    }
+
+    cur = calloc(1, sizeof(*cur));
+    if (cur == NULL) {
+        TRACE_ERROR("%s\n", ock_err(ERR_HOST_MEMORY));
+        return CKR_HOST_MEMORY;
+    }
+
+    // the search template must outlive C_FindObjectsInit
+    if (pTemplate != NULL && ulCount > 0) {
+        rc = dup_attribute_array(pTemplate, ulCount, &cur->template,
+                                 &cur->template_len);
+        if (rc != CKR_OK) {
+            TRACE_DEVEL("dup_attribute_array failed.\n");
+            free(cur);
+            return rc;
         }
     }
 
-    sess->find_count = 0;
-    sess->find_idx = 0;
+    cur->fa.hw_feature = (class == CKO_HW_FEATURE);
+    cur->fa.hidden_object = (flag == TRUE);
+    cur->fa.sess = sess;
+    cur->fa.pTemplate = cur->template;
+    cur->fa.ulCount = cur->template_len;
 
     rc = XProcLock(tokdata);
     if (rc != CKR_OK) {
         TRACE_ERROR("Failed to get Process Lock.\n");
-        return rc;
+        goto error;
     }
 
     object_mgr_update_from_shm(tokdata);
@@ -1201,69 +1722,140 @@ CK_RV object_mgr_find_init(STDLL_TokData_t *tokdata,
     rc = XProcUnLock(tokdata);
     if (rc != CKR_OK) {
         TRACE_ERROR("Failed to release Process Lock.\n");
-        return rc;
+        goto error;
     }
 
-    fa.hw_feature = FALSE;
-    fa.hidden_object = FALSE;
-    fa.sess = sess;
-    fa.pTemplate = pTemplate;
-    fa.ulCount = ulCount;
-
     // which objects can be returned:
     //
     //   Public Session:   public session objects, public token objects
     //   User Session:     all session objects,    all token objects
     //   SO session:       public session objects, public token objects
     //
-    // PKCS#11 v2.11 (pg. 79): "When searching using C_FindObjectsInit
-    // and C_FindObjects, hardware feature objects are not returned
-    // unless the CKA_CLASS attribute in the template has the value
-    // CKO_HW_FEATURE." So, we check for CKO_HW_FEATURE and if its set,
-    // we'll find these objects below. - KEY
-    rc = get_ulong_attribute_by_type(pTemplate, ulCount, CKA_CLASS, &class);
-    if (rc == CKR_ATTRIBUTE_VALUE_INVALID) {
-        TRACE_ERROR("%s\n", ock_err(ERR_ATTRIBUTE_VALUE_INVALID));
-        return CKR_ATTRIBUTE_VALUE_INVALID;
-    }
-    if (rc == CKR_OK && class == CKO_HW_FEATURE)
-        fa.hw_feature = TRUE;
-
-    rc = get_bool_attribute_by_type(pTemplate, ulCount, CKA_HIDDEN, &flag);
-    if (rc == CKR_ATTRIBUTE_VALUE_INVALID) {
-        TRACE_ERROR("%s\n", ock_err(ERR_ATTRIBUTE_VALUE_INVALID));
-        return CKR_ATTRIBUTE_VALUE_INVALID;
-    }
-    if (rc == CKR_OK && flag == TRUE)
-        fa.hidden_object = TRUE;
-
     switch (sess->session_info.state) {
     case CKS_RO_PUBLIC_SESSION:
     case CKS_RW_PUBLIC_SESSION:
     case CKS_RW_SO_FUNCTIONS:
-        fa.public_only = TRUE;
-
-        bt_for_each_node(tokdata, &tokdata->publ_token_obj_btree,
-                         find_build_list_cb, &fa);
-        bt_for_each_node(tokdata, &tokdata->sess_obj_btree, find_build_list_cb,
-                         &fa);
+        cur->fa.public_only = TRUE;
+        cur->trees[cur->num_trees++] = &tokdata->publ_token_obj_btree;
+        cur->trees[cur->num_trees++] = &tokdata->sess_obj_btree;
         break;
     case CKS_RO_USER_FUNCTIONS:
     case CKS_RW_USER_FUNCTIONS:
-        fa.public_only = FALSE;
-
-        bt_for_each_node(tokdata, &tokdata->priv_token_obj_btree,
-                         find_build_list_cb, &fa);
-        bt_for_each_node(tokdata, &tokdata->publ_token_obj_btree,
-                         find_build_list_cb, &fa);
-        bt_for_each_node(tokdata, &tokdata->sess_obj_btree, find_build_list_cb,
-                         &fa);
+        cur->fa.public_only = FALSE;
+        cur->trees[cur->num_trees++] = &tokdata->priv_token_obj_btree;
+        cur->trees[cur->num_trees++] = &tokdata->publ_token_obj_btree;
+        cur->trees[cur->num_trees++] = &tokdata->sess_obj_btree;
         break;
     }
+    cur->node = 1;
+
+    cur->use_index = obj_index_find(tokdata, &cur->fa, &cur->entries,
+                                    &cur->num_entries);
 
+    sess->find_cursor = cur;
+    sess->find_count = 0;
+    sess->find_idx = 0;
     sess->find_active = TRUE;
 
     return CKR_OK;
+
+error:
+    if (cur->template != NULL)
+        cleanse_and_free_attribute_array(cur->template, cur->template_len);
+    free(cur);
+    return rc;
+}
+
+//
+// Returns up to ulMaxObjectCount handles of objects matching the active
+// search of the session, and advances the search.
+//
+CK_RV object_mgr_find_next(STDLL_TokData_t *tokdata, SESSION *sess,
+                           CK_OBJECT_HANDLE *phObject,
+                           CK_ULONG ulMaxObjectCount,
+                           CK_ULONG *pulObjectCount)
+{
+    struct find_cursor *cur;
+    OBJ_INDEX_ENTRY *entry;
+    CK_OBJECT_HANDLE map_handle;
+    struct btree *t;
+    unsigned long node;
+    CK_ULONG count = 0;
+    OBJECT *obj;
+
+    if (!sess || !phObject || !pulObjectCount) {
+        TRACE_ERROR("Invalid function argument.\n");
+        return CKR_FUNCTION_FAILED;
+    }
+    if (sess->find_active == FALSE || sess->find_cursor == NULL) {
+        TRACE_ERROR("%s\n", ock_err(ERR_OPERATION_NOT_INITIALIZED));
+        return CKR_OPERATION_NOT_INITIALIZED;
+    }
+    cur = sess->find_cursor;
+
+    while (count < ulMaxObjectCount) {
+        if (cur->use_index) {
+            if (cur->entry >= cur->num_entries)
+                break;
+            entry = &cur->entries[cur->entry++];
+
+            if (cur->fa.public_only &&
+                entry->t == &tokdata->priv_token_obj_btree)
+                continue;
+
+            /* Only use the object if it is still in its btree */
+            obj = bt_get_node_value(entry->t, entry->obj_handle);
+            if (obj == entry->obj &&
+                find_match_object(tokdata, obj, entry->obj_handle, &cur->fa,
+                                  &map_handle))
+                phObject[count++] = map_handle;
+            bt_put_node_value(entry->t, obj);
+            continue;
+        }
+
+        if (cur->tree >= cur->num_trees)
+            break;
+        t = cur->trees[cur->tree];
+        if (cur->node > t->size) {
+            cur->tree++;
+            cur->node = 1;
+            continue;
+        }
+        node = cur->node++;
+
+        obj = bt_get_node_value(t, node);
+        if (obj == NULL)
+            continue;
+        if (find_match_object(tokdata, obj, node, &cur->fa, &map_handle))
+            phObject[count++] = map_handle;
+        bt_put_node_value(t, obj);
+    }
+
+    sess->find_count += count;
+    sess->find_idx += count;
+    *pulObjectCount = count;
+
+    return CKR_OK;
+}
+
+//
+// Frees the state of the session's object search, if any.
+//
+void object_mgr_find_free(SESSION *sess)
+{
+    struct find_cursor *cur = sess->find_cursor;
+
+    if (cur != NULL) {
+        if (cur->template != NULL)
+            cleanse_and_free_attribute_array(cur->template, cur->template_len);
+        free(cur->entries);
+        free(cur);
+        sess->find_cursor = NULL;
+    }
+
+    free(sess->find_list);
+    sess->find_list = NULL;
+    sess->find_len = 0;
 }
 
 //
@@ -1278,8 +1870,7 @@ CK_RV object_mgr_find_final(SESSION *sess)
         TRACE_ERROR("%s\n", ock_err(ERR_OPERATION_NOT_INITIALIZED));
         return CKR_OPERATION_NOT_INITIALIZED;
     }
-    free(sess->find_list);
-    sess->find_list = NULL;
+    object_mgr_find_free(sess);
     sess->find_count = 0;
     sess->find_idx = 0;
     sess->find_active = FALSE;
@@ -1362,8 +1953,6 @@ void purge_session_obj_cb(STDLL_TokData_t *tokdata, void *node,
     struct purge_args *pa = (struct purge_args *) p3;
     CK_BBOOL del = FALSE;
 
-    UNUSED(tokdata);
-
     if (obj->session == pa->sess) {
         if (object_lock(obj, READ_LOCK) != CKR_OK)
             return;
@@ -1381,7 +1970,8 @@ void purge_session_obj_cb(STDLL_TokData_t *tokdata, void *node,
         object_unlock(obj);
 
         if (del == TRUE) {
-            if (obj->map_handle)
+            object_mgr_index_remove(tokdata, obj);
+            if (object_mgr_map_refers_to(tokdata, obj->map_handle, obj))
                 bt_node_free(&tokdata->object_map_btree, obj->map_handle, TRUE);
 
             bt_node_free(&tokdata->sess_obj_btree, obj_handle, TRUE);
@@ -1423,9 +2013,8 @@ void purge_token_obj_cb(STDLL_TokData_t *tokdata, void *node,
     OBJECT *obj = (OBJECT *) node;
     struct btree *t = (struct btree *) p3;
 
-    UNUSED(tokdata);
-
-    if (obj->map_handle)
+    object_mgr_index_remove(tokdata, obj);
+    if (object_mgr_map_refers_to(tokdata, obj->map_handle, obj))
         bt_node_free(&tokdata->object_map_btree, obj->map_handle, TRUE);
 
     bt_node_free(t, obj_handle, TRUE);
@@ -1441,6 +2030,8 @@ CK_BBOOL object_mgr_purge_token_objects(STDLL_TokData_t *tokdata)
                      &tokdata->priv_token_obj_btree);
     bt_for_each_node(tokdata, &tokdata->publ_token_obj_btree, purge_token_obj_cb,
                      &tokdata->publ_token_obj_btree);
+    tokdata->priv_tok_obj_synced = FALSE;
+    tokdata->publ_tok_obj_synced = FALSE;
 
     return TRUE;
 }
@@ -1450,10 +2041,155 @@ CK_BBOOL object_mgr_purge_private_token_objects(STDLL_TokData_t *tokdata)
 {
     bt_for_each_node(tokdata, &tokdata->priv_token_obj_btree, purge_token_obj_cb,
                      &tokdata->priv_token_obj_btree);
+    tokdata->priv_tok_obj_synced = FALSE;
+    clear_object_key_cache(tokdata);
 
     return TRUE;
 }
 
+// Adds a token object that has just been restored from disk to the token
+// object btree, the attribute index and, if the token objects have not been
+// loaded into the SHM yet, to the SHM. The object is freed on error.
+//
+CK_RV object_mgr_add_restored_obj(STDLL_TokData_t *tokdata, OBJECT *obj)
+{
+    CK_BBOOL priv;
+    struct btree *t;
+    unsigned long obj_handle;
+    CK_RV rc, tmp;
+
+    rc = XProcLock(tokdata);
+    if (rc != CKR_OK) {
+        TRACE_ERROR("Failed to get Process Lock.\n");
+        object_free(obj);
+        return rc;
+    }
+
+    priv = object_is_private(obj);
+
+    if (priv)
+        t = &tokdata->priv_token_obj_btree;
+    else
+        t = &tokdata->publ_token_obj_btree;
+
+    obj_handle = bt_node_add(t, obj);
+    if (!obj_handle) {
+        TRACE_ERROR("%s\n", ock_err(ERR_HOST_MEMORY));
+        rc = CKR_HOST_MEMORY;
+        object_free(obj);
+        goto unlock;
+    }
+
+    object_mgr_index_add(tokdata, t, obj_handle, obj);
+
+    if (priv) {
+        if (tokdata->global_shm->priv_loaded == FALSE) {
+            rc = object_mgr_add_to_shm(obj, tokdata->global_shm);
+        }
+    } else {
+        if (tokdata->global_shm->publ_loaded == FALSE) {
+            rc = object_mgr_add_to_shm(obj, tokdata->global_shm);
+        }
+    }
+
+unlock:
+    tmp = XProcUnLock(tokdata);
+    if (tmp != CKR_OK)
+        TRACE_ERROR("Failed to release Process Lock.\n");
+    if (rc == CKR_OK)
+        rc = tmp;
+
+    return rc;
+}
+
+// Adds a placeholder for the token object @name without reading it from
+// disk (objload = lazy). The placeholder's template only holds CKA_TOKEN and
+// CKA_PRIVATE. The object is loaded by object_mgr_check_shm() when its handle
+// is first resolved or it is matched against a search template.
+//
+// This is only possible for objects that are listed in the SHM already, so
+// that other processes know about them. Returns CKR_OBJECT_HANDLE_INVALID if
+// the object is not listed, the caller must then load it normally.
+//
+// The caller holds the XProcLock.
+//
+CK_RV object_mgr_add_lazy_obj(STDLL_TokData_t *tokdata, const char *name,
+                              CK_BBOOL priv)
+{
+    CK_BBOOL token = TRUE;
+    CK_ATTRIBUTE *attr = NULL;
+    OBJECT *obj;
+    struct btree *t;
+    unsigned long obj_handle;
+    CK_ULONG index;
+    CK_RV rc;
+
+    obj = (OBJECT *) calloc(1, sizeof(OBJECT));
+    if (obj == NULL) {
+        TRACE_ERROR("%s\n", ock_err(ERR_HOST_MEMORY));
+        return CKR_HOST_MEMORY;
+    }
+
+    rc = object_init_lock(obj);
+    if (rc != CKR_OK) {
+        free(obj);
+        return rc;
+    }
+
+    memcpy(obj->name, name, 8);
+    obj->lazy = TRUE;
+
+    rc = object_mgr_search_shm_for_obj(tokdata->global_shm, priv, obj,
+                                       &index);
+    if (rc != CKR_OK)
+        goto error;
+
+    obj->template = (TEMPLATE *) calloc(1, sizeof(TEMPLATE));
+    if (obj->template == NULL) {
+        TRACE_ERROR("%s\n", ock_err(ERR_HOST_MEMORY));
+        rc = CKR_HOST_MEMORY;
+        goto error;
+    }
+
+    rc = build_attribute(CKA_TOKEN, &token, sizeof(CK_BBOOL), &attr);
+    if (rc != CKR_OK)
+        goto error;
+    rc = template_update_attribute(obj->template, attr);
+    if (rc != CKR_OK) {
+        free(attr);
+        goto error;
+    }
+
+    rc = build_attribute(CKA_PRIVATE, &priv, sizeof(CK_BBOOL), &attr);
+    if (rc != CKR_OK)
+        goto error;
+    rc = template_update_attribute(obj->template, attr);
+    if (rc != CKR_OK) {
+        free(attr);
+        goto error;
+    }
+
+    if (priv)
+        t = &tokdata->priv_token_obj_btree;
+    else
+        t = &tokdata->publ_token_obj_btree;
+
+    obj_handle = bt_node_add(t, obj);
+    if (!obj_handle) {
+        TRACE_ERROR("%s\n", ock_err(ERR_HOST_MEMORY));
+        rc = CKR_HOST_MEMORY;
+        goto error;
+    }
+
+    object_mgr_index_add(tokdata, t, obj_handle, obj);
+
+    return CKR_OK;
+
+error:
+    object_free(obj);
+    return rc;
+}
+
 //
 //
 CK_RV object_mgr_restore_obj(STDLL_TokData_t *tokdata, CK_BYTE *data,
@@ -1470,8 +2206,7 @@ CK_RV object_mgr_restore_obj_withSize(STDLL_TokData_t *tokdata, CK_BYTE *data,
                                       const char *fname)
 {
     OBJECT *obj = NULL;
-    CK_BBOOL priv;
-    CK_RV rc, tmp;
+    CK_RV rc;
 
     if (!data) {
         TRACE_ERROR("Invalid function argument.\n");
@@ -1484,68 +2219,19 @@ CK_RV object_mgr_restore_obj_withSize(STDLL_TokData_t *tokdata, CK_BYTE *data,
         obj = oldObj;
         rc = object_restore_withSize(tokdata->policy,
                                      data, &obj, TRUE, data_size, fname);
+        if (rc == CKR_OK)
+            object_mgr_index_update(tokdata, obj);
     } else {
         rc = object_restore_withSize(tokdata->policy,
                                      data, &obj, FALSE, data_size, fname);
-        if (rc == CKR_OK) {
-            rc = XProcLock(tokdata);
-            if (rc != CKR_OK) {
-                TRACE_ERROR("Failed to get Process Lock.\n");
-                object_free(obj);
-                return rc;
-            }
-
-            priv = object_is_private(obj);
+        if (rc == CKR_OK)
+            rc = object_mgr_add_restored_obj(tokdata, obj);
+        else
+            TRACE_DEVEL("object_restore_withSize failed.\n");
+    }
 
-            if (priv) {
-                if (!bt_node_add(&tokdata->priv_token_obj_btree, obj)) {
-                    TRACE_ERROR("%s\n", ock_err(ERR_HOST_MEMORY));
-                    rc = CKR_HOST_MEMORY;
-                    object_free(obj);
-                    goto unlock;
-                }
-            } else {
-                if (!bt_node_add(&tokdata->publ_token_obj_btree, obj)) {
-                    TRACE_ERROR("%s\n", ock_err(ERR_HOST_MEMORY));
-                    rc = CKR_HOST_MEMORY;
-                    object_free(obj);
-                    goto unlock;
-                }
-            }
-
-            if (priv) {
-                if (tokdata->global_shm->priv_loaded == FALSE) {
-                    if (tokdata->global_shm->num_priv_tok_obj < MAX_TOK_OBJS) {
-                        object_mgr_add_to_shm(obj, tokdata->global_shm);
-                    } else {
-                        TRACE_ERROR("%s\n", ock_err(ERR_HOST_MEMORY));
-                        rc = CKR_HOST_MEMORY;
-                    }
-                }
-            } else {
-                if (tokdata->global_shm->publ_loaded == FALSE) {
-                    if (tokdata->global_shm->num_publ_tok_obj < MAX_TOK_OBJS) {
-                        object_mgr_add_to_shm(obj, tokdata->global_shm);
-                    } else {
-                        TRACE_ERROR("%s\n", ock_err(ERR_HOST_MEMORY));
-                        rc = CKR_HOST_MEMORY;
-                    }
-                }
-            }
-
-unlock:
-            tmp = XProcUnLock(tokdata);
-            if (tmp != CKR_OK)
-                TRACE_ERROR("Failed to release Process Lock.\n");
-            if (rc == CKR_OK)
-                rc = tmp;
-        } else {
-            TRACE_DEVEL("object_restore_withSize failed.\n");
-        }
-    }
-
-    return rc;
-}
+    return rc;
+}
 
 /**
  * Save the token object to disk and update the shared memory segment.
@@ -1554,6 +2240,7 @@ CK_RV object_mgr_save_token_object(STDLL_TokData_t *tokdata, OBJECT *obj)
 {
     TOK_OBJ_ENTRY *entry = NULL;
     CK_ULONG index;
+    CK_BBOOL priv;
     CK_RV rc;
 
     obj->count_lo++;
@@ -1573,49 +2260,21 @@ CK_RV object_mgr_save_token_object(STDLL_TokData_t *tokdata, OBJECT *obj)
         goto done;
     }
 
-    if (object_is_private(obj)) {
-        if (tokdata->global_shm->num_priv_tok_obj == 0) {
-            TRACE_DEVEL("%s\n", ock_err(ERR_OBJECT_HANDLE_INVALID));
-            rc = CKR_OBJECT_HANDLE_INVALID;
-            XProcUnLock(tokdata);
-            goto done;
-        }
-        rc = object_mgr_search_shm_for_obj(tokdata->global_shm->
-                                           priv_tok_objs, 0,
-                                           tokdata->global_shm->
-                                           num_priv_tok_obj - 1, obj,
-                                           &index);
-
-        if (rc != CKR_OK) {
-            TRACE_DEVEL("object_mgr_search_shm_for_obj failed.\n");
-            XProcUnLock(tokdata);
-            goto done;
-        }
-
-        entry = &tokdata->global_shm->priv_tok_objs[index];
-    } else {
-        if (tokdata->global_shm->num_publ_tok_obj == 0) {
-            TRACE_DEVEL("%s\n", ock_err(ERR_OBJECT_HANDLE_INVALID));
-            rc = CKR_OBJECT_HANDLE_INVALID;
-            XProcUnLock(tokdata);
-            goto done;
-        }
-        rc = object_mgr_search_shm_for_obj(tokdata->global_shm->
-                                           publ_tok_objs, 0,
-                                           tokdata->global_shm->
-                                           num_publ_tok_obj - 1, obj,
-                                           &index);
-        if (rc != CKR_OK) {
-            TRACE_DEVEL("object_mgr_search_shm_for_obj failed.\n");
-            XProcUnLock(tokdata);
-            goto done;
-        }
-
-        entry = &tokdata->global_shm->publ_tok_objs[index];
+    priv = object_is_private(obj);
+    rc = object_mgr_search_shm_for_obj(tokdata->global_shm, priv, obj,
+                                       &index);
+    if (rc != CKR_OK) {
+        TRACE_DEVEL("object_mgr_search_shm_for_obj failed.\n");
+        XProcUnLock(tokdata);
+        goto done;
     }
 
+    entry = object_mgr_shm_entries(tokdata->global_shm, priv) + index;
+
+    object_mgr_shm_write_begin(tokdata->global_shm);
     entry->count_lo = obj->count_lo;
     entry->count_hi = obj->count_hi;
+    object_mgr_shm_write_end(tokdata->global_shm);
 
     rc = XProcUnLock(tokdata);
     if (rc != CKR_OK) {
@@ -1675,6 +2334,8 @@ CK_RV object_mgr_set_attribute_values(STDLL_TokData_t *tokdata,
         TRACE_DEVEL("object_set_attribute_values failed.\n");
         goto done;
     }
+
+    object_mgr_index_update(tokdata, obj);
     // okay.  the object has been updated.  if it's a session object,
     // we're finished.  if it's a token object, we need to update
     // non-volatile storage.
@@ -1698,34 +2359,307 @@ done:
 }
 
 
+// The token object lists in shared memory are two open addressing hash
+// tables (public and private objects) keyed by the 8 byte object name.
+// Empty slots are all zero, deleted entries leave a tombstone (deleted set,
+// name cleared) behind so that probe sequences stay intact. When the used
+// slots exceed 3/4 of the capacity the tables are rehashed, and the shared
+// memory segment grown if needed. This happens under the XProcLock, other
+// processes see the new layout immediately since the segment is mapped with
+// its maximum size (see sm_open()).
 //
+#define SHM_ENTRY_IS_FREE(e)    ((e)->name[0] == '\0')
+#define SHM_ENTRY_IS_EMPTY(e)   (SHM_ENTRY_IS_FREE(e) && !(e)->deleted)
+
+static size_t object_mgr_shm_tables_offset(size_t hdr_len)
+{
+    return (hdr_len + 7) & ~((size_t)7);
+}
+
+// Returns the size of a shared memory segment with a header of hdr_len bytes
+// (LW_SHM_TYPE plus any token specific data) followed by the token object
+// tables with the given capacity.
 //
-void object_mgr_add_to_shm(OBJECT *obj, LW_SHM_TYPE *global_shm)
+size_t object_mgr_shm_size(size_t hdr_len, CK_ULONG capacity)
 {
-    // TODO: Can't this function fail?
-    TOK_OBJ_ENTRY *entry = NULL;
+    return object_mgr_shm_tables_offset(hdr_len) +
+           2 * capacity * sizeof(TOK_OBJ_ENTRY);
+}
+
+// Sets up the token object tables in a newly created shared memory segment,
+// or checks that an existing one has the expected layout.
+//
+CK_RV object_mgr_shm_init(LW_SHM_TYPE *global_shm, size_t hdr_len,
+                          CK_BBOOL created)
+{
+    CK_ULONG_32 capacity;
+
+    if (created) {
+        global_shm->version = LW_SHM_VERSION;
+        global_shm->tok_obj_offset = object_mgr_shm_tables_offset(hdr_len);
+        global_shm->tok_obj_capacity = TOK_OBJ_MIN_CAPACITY;
+        return CKR_OK;
+    }
+
+    capacity = global_shm->tok_obj_capacity;
+    if (global_shm->version != LW_SHM_VERSION ||
+        global_shm->tok_obj_offset != object_mgr_shm_tables_offset(hdr_len) ||
+        capacity < TOK_OBJ_MIN_CAPACITY || capacity > TOK_OBJ_MAX_CAPACITY ||
+        (capacity & (capacity - 1)) != 0) {
+        TRACE_ERROR("Shared memory segment has an unsupported layout "
+                    "(version %u).\n", global_shm->version);
+        return CKR_FUNCTION_FAILED;
+    }
+
+    return CKR_OK;
+}
+
+TOK_OBJ_ENTRY *object_mgr_shm_entries(LW_SHM_TYPE *global_shm, CK_BBOOL priv)
+{
+    TOK_OBJ_ENTRY *entries;
+
+    entries = (TOK_OBJ_ENTRY *)((CK_BYTE *)global_shm +
+                                global_shm->tok_obj_offset);
+
+    return priv ? entries + global_shm->tok_obj_capacity : entries;
+}
+
+static CK_ULONG object_mgr_shm_hash(const char *name)
+{
+    CK_ULONG hash = 2166136261UL;
+    int i;
+
+    for (i = 0; i < 8; i++) {
+        hash ^= (CK_BYTE)name[i];
+        hash *= 16777619UL;
+    }
+
+    return hash;
+}
+
+// Writers of the token object lists in shared memory hold the XProcLock and
+// bracket their modifications with these, so that object_mgr_check_shm() can
+// check an object's freshness without taking the XProcLock.
+//
+void object_mgr_shm_write_begin(LW_SHM_TYPE *global_shm)
+{
+    __atomic_store_n(&global_shm->tok_obj_seq, global_shm->tok_obj_seq + 1,
+                     __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+void object_mgr_shm_write_end(LW_SHM_TYPE *global_shm)
+{
+    __atomic_store_n(&global_shm->tok_obj_seq, global_shm->tok_obj_seq + 1,
+                     __ATOMIC_RELEASE);
+}
+
+// Appends an addition to or deletion from the token object lists to the
+// change log in shared memory. Called between object_mgr_shm_write_begin()
+// and object_mgr_shm_write_end(), with the XProcLock held. Other processes
+// apply the changes logged since their last update to their local token
+// object btrees, see object_mgr_update_from_shm().
+//
+static void object_mgr_shm_log_change(LW_SHM_TYPE *global_shm, CK_BYTE op,
+                                      CK_BBOOL priv, const char *name)
+{
+    CK_ULONG_32 seq = global_shm->tok_obj_change_seq + 1;
+    TOK_OBJ_CHANGE *change;
+
+    change = &global_shm->tok_obj_changes[seq % TOK_OBJ_CHANGE_LOG_SIZE];
+    change->seq = seq;
+    change->op = op;
+    change->priv = priv;
+    memcpy(change->name, name, 8);
+
+    global_shm->tok_obj_change_seq = seq;
+}
+
+// Lock free check whether the token object's SHM entry still has the same
+// update counters as the object. Returns FALSE if the entry has changed, or
+// if a writer interfered, in which case the caller must do the full check
+// under the XProcLock.
+//
+static CK_BBOOL object_mgr_shm_entry_matches(LW_SHM_TYPE *global_shm,
+                                             OBJECT *obj, CK_BBOOL priv)
+{
+    TOK_OBJ_ENTRY *entry;
+    CK_ULONG index;
+
+    // obj->index is the last known slot of the object in the SHM
+    index = __atomic_load_n(&obj->index, __ATOMIC_RELAXED);
+    if (index >= __atomic_load_n(&global_shm->tok_obj_capacity,
+                                 __ATOMIC_RELAXED))
+        return FALSE;
+    entry = object_mgr_shm_entries(global_shm, priv) + index;
+
+    return memcmp(entry->name, obj->name, 8) == 0 &&
+           entry->count_lo == obj->count_lo &&
+           entry->count_hi == obj->count_hi;
+}
+
+static CK_BBOOL object_mgr_shm_is_current(LW_SHM_TYPE *global_shm,
+                                          OBJECT *obj, CK_BBOOL priv)
+{
+    CK_ULONG_32 seq;
+    CK_BBOOL current;
+
+    seq = __atomic_load_n(&global_shm->tok_obj_seq, __ATOMIC_ACQUIRE);
+    if (seq & 1)
+        return FALSE;
+
+    current = object_mgr_shm_entry_matches(global_shm, obj, priv);
+
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    if (__atomic_load_n(&global_shm->tok_obj_seq, __ATOMIC_RELAXED) != seq)
+        return FALSE;
+
+    return current;
+}
+
+// Inserts a name into a table that is known to have a free slot and not to
+// contain the name yet. Returns the slot used.
+//
+static CK_ULONG object_mgr_shm_insert(TOK_OBJ_ENTRY *entries,
+                                      CK_ULONG capacity, const char *name,
+                                      CK_ULONG_32 *num_slots)
+{
+    CK_ULONG mask = capacity - 1;
+    CK_ULONG idx;
+
+    for (idx = object_mgr_shm_hash(name) & mask;
+         !SHM_ENTRY_IS_FREE(&entries[idx]); idx = (idx + 1) & mask)
+        ;
+
+    // reusing a tombstone does not take up another slot
+    if (!entries[idx].deleted)
+        (*num_slots)++;
+
+    entries[idx].deleted = FALSE;
+    entries[idx].count_lo = 0;
+    entries[idx].count_hi = 0;
+    memcpy(entries[idx].name, name, 8);
+
+    return idx;
+}
+
+// Rehashes both token object tables into tables of the given capacity,
+// dropping all tombstones. The caller must hold the XProcLock.
+//
+static CK_RV object_mgr_shm_rehash(LW_SHM_TYPE *global_shm,
+                                   CK_ULONG capacity)
+{
+    CK_ULONG old_capacity = global_shm->tok_obj_capacity;
+    TOK_OBJ_ENTRY *old_entries, *entries, *e;
+    CK_ULONG i, idx;
+    int ret;
+
+    old_entries = malloc(2 * old_capacity * sizeof(TOK_OBJ_ENTRY));
+    if (old_entries == NULL) {
+        TRACE_ERROR("%s\n", ock_err(ERR_HOST_MEMORY));
+        return CKR_HOST_MEMORY;
+    }
+    memcpy(old_entries, object_mgr_shm_entries(global_shm, FALSE),
+           2 * old_capacity * sizeof(TOK_OBJ_ENTRY));
+
+    if (capacity > old_capacity) {
+        ret = sm_grow(global_shm,
+                      global_shm->tok_obj_offset +
+                      2 * capacity * sizeof(TOK_OBJ_ENTRY));
+        if (ret != 0) {
+            TRACE_ERROR("sm_grow failed.\n");
+            free(old_entries);
+            return CKR_HOST_MEMORY;
+        }
+    }
+
+    object_mgr_shm_write_begin(global_shm);
+
+    global_shm->tok_obj_capacity = capacity;
+    global_shm->num_publ_tok_obj_slots = 0;
+    global_shm->num_priv_tok_obj_slots = 0;
+    memset(object_mgr_shm_entries(global_shm, FALSE), 0,
+           2 * capacity * sizeof(TOK_OBJ_ENTRY));
+
+    for (i = 0; i < 2 * old_capacity; i++) {
+        e = &old_entries[i];
+        if (SHM_ENTRY_IS_FREE(e))
+            continue;
+
+        if (i < old_capacity) {
+            entries = object_mgr_shm_entries(global_shm, FALSE);
+            idx = object_mgr_shm_insert(entries, capacity, e->name,
+                                        &global_shm->num_publ_tok_obj_slots);
+        } else {
+            entries = object_mgr_shm_entries(global_shm, TRUE);
+            idx = object_mgr_shm_insert(entries, capacity, e->name,
+                                        &global_shm->num_priv_tok_obj_slots);
+        }
+        entries[idx].count_lo = e->count_lo;
+        entries[idx].count_hi = e->count_hi;
+    }
+
+    object_mgr_shm_write_end(global_shm);
+
+    free(old_entries);
+
+    TRACE_DEVEL("Token object tables rehashed, capacity %lu -> %lu\n",
+                old_capacity, capacity);
+
+    return CKR_OK;
+}
+
+//
+//
+CK_RV object_mgr_add_to_shm(OBJECT *obj, LW_SHM_TYPE *global_shm)
+{
+    TOK_OBJ_ENTRY *entries;
+    CK_ULONG_32 *num, *num_slots;
+    CK_ULONG capacity;
     CK_BBOOL priv;
+    CK_RV rc;
 
     // the calling routine is responsible for locking the global_shm mutex
     //
     priv = object_is_private(obj);
 
-    if (priv)
-        entry = &global_shm->priv_tok_objs[global_shm->num_priv_tok_obj];
-    else
-        entry = &global_shm->publ_tok_objs[global_shm->num_publ_tok_obj];
+    if (priv) {
+        num = &global_shm->num_priv_tok_obj;
+        num_slots = &global_shm->num_priv_tok_obj_slots;
+    } else {
+        num = &global_shm->num_publ_tok_obj;
+        num_slots = &global_shm->num_publ_tok_obj_slots;
+    }
 
-    entry->deleted = FALSE;
-    entry->count_lo = 0;
-    entry->count_hi = 0;
-    memcpy(entry->name, obj->name, 8);
+    if (*num >= MAX_TOK_OBJS) {
+        TRACE_ERROR("%s\n", ock_err(ERR_HOST_MEMORY));
+        return CKR_HOST_MEMORY;
+    }
 
-    if (priv)
-        global_shm->num_priv_tok_obj++;
-    else
-        global_shm->num_publ_tok_obj++;
+    capacity = global_shm->tok_obj_capacity;
+    if ((*num_slots + 1) * 4 > capacity * 3) {
+        // grow until the live entries fill at most half of the table
+        while ((*num + 1) * 2 > capacity)
+            capacity *= 2;
 
-    return;
+        rc = object_mgr_shm_rehash(global_shm, capacity);
+        if (rc != CKR_OK)
+            return rc;
+    }
+
+    entries = object_mgr_shm_entries(global_shm, priv);
+
+    object_mgr_shm_write_begin(global_shm);
+
+    obj->index = object_mgr_shm_insert(entries, capacity, (char *)obj->name,
+                                       num_slots);
+    (*num)++;
+    object_mgr_shm_log_change(global_shm, TOK_OBJ_CHANGE_ADD, priv,
+                              (char *)obj->name);
+
+    object_mgr_shm_write_end(global_shm);
+
+    return CKR_OK;
 }
 
 
@@ -1733,7 +2667,8 @@ void object_mgr_add_to_shm(OBJECT *obj, LW_SHM_TYPE *global_shm)
 //
 CK_RV object_mgr_del_from_shm(OBJECT *obj, LW_SHM_TYPE *global_shm)
 {
-    CK_ULONG index, count;
+    TOK_OBJ_ENTRY *entry;
+    CK_ULONG index;
     CK_BBOOL priv;
     CK_RV rc;
 
@@ -1743,87 +2678,28 @@ CK_RV object_mgr_del_from_shm(OBJECT *obj, LW_SHM_TYPE *global_shm)
 
     priv = object_is_private(obj);
 
-    if (priv) {
-        if (global_shm->num_priv_tok_obj == 0) {
-            TRACE_DEVEL("%s\n", ock_err(ERR_OBJECT_HANDLE_INVALID));
-            return CKR_OBJECT_HANDLE_INVALID;
-        }
-        rc = object_mgr_search_shm_for_obj(global_shm->priv_tok_objs,
-                                           0, global_shm->num_priv_tok_obj - 1,
-                                           obj, &index);
-        if (rc != CKR_OK) {
-            TRACE_DEVEL("object_mgr_search_shm_for_obj failed.\n");
-            return rc;
-        }
-        // Since the number of objects starts at 1 and index starts at zero, we
-        // decrement before we get count.  This eliminates the need to perform
-        // this operation later as well as decrementing the number of objects.
-        // (i.e. If we have 10 objects, num will be 10 but the last index is 9.
-        // If we want to delete the last object we need to subtract 9 from 9 not
-        // 10 from 9.)
-        //
+    rc = object_mgr_search_shm_for_obj(global_shm, priv, obj, &index);
+    if (rc != CKR_OK) {
+        TRACE_DEVEL("object_mgr_search_shm_for_obj failed.\n");
+        return rc;
+    }
+
+    entry = object_mgr_shm_entries(global_shm, priv) + index;
+
+    object_mgr_shm_write_begin(global_shm);
+
+    // leave a tombstone, the slot stays in use until the next rehash
+    memset(entry, 0, sizeof(TOK_OBJ_ENTRY));
+    entry->deleted = TRUE;
+    object_mgr_shm_log_change(global_shm, TOK_OBJ_CHANGE_DEL, priv,
+                              (char *)obj->name);
+
+    if (priv)
         global_shm->num_priv_tok_obj--;
-        if (index > global_shm->num_priv_tok_obj) {
-            count = index - global_shm->num_priv_tok_obj;
-        } else {
-            count = global_shm->num_priv_tok_obj - index;
-        }
-
-        if (count > 0) {
-            // If we aren't deleting the last element in the list
-            // Move up count number of elements effectively deleting the index
-            // NB: memmove is required since the copied regions may overlap
-            memmove((char *) &global_shm->priv_tok_objs[index],
-                    (char *) &global_shm->priv_tok_objs[index + 1],
-                    sizeof(TOK_OBJ_ENTRY) * count);
-            // We need to zero out the last entry... Since the memcopy
-            // does not zero it out...
-            memset((char *) &global_shm->
-                   priv_tok_objs[global_shm->num_priv_tok_obj + 1], 0,
-                   sizeof(TOK_OBJ_ENTRY));
-        } else {
-            // We are deleting the last element which is in num_priv_tok_obj
-            memset((char *) &global_shm->
-                   priv_tok_objs[global_shm->num_priv_tok_obj], 0,
-                   sizeof(TOK_OBJ_ENTRY));
-        }
-    } else {
-        if (global_shm->num_publ_tok_obj == 0) {
-            TRACE_DEVEL("%s\n", ock_err(ERR_OBJECT_HANDLE_INVALID));
-            return CKR_OBJECT_HANDLE_INVALID;
-        }
-        rc = object_mgr_search_shm_for_obj(global_shm->publ_tok_objs,
-                                           0, global_shm->num_publ_tok_obj - 1,
-                                           obj, &index);
-        if (rc != CKR_OK) {
-            TRACE_DEVEL("object_mgr_search_shm_for_obj failed.\n");
-            return rc;
-        }
+    else
         global_shm->num_publ_tok_obj--;
 
-
-        if (index > global_shm->num_publ_tok_obj) {
-            count = index - global_shm->num_publ_tok_obj;
-        } else {
-            count = global_shm->num_publ_tok_obj - index;
-        }
-
-        if (count > 0) {
-            // NB: memmove is required since the copied regions may overlap
-            memmove((char *) &global_shm->publ_tok_objs[index],
-                    (char *) &global_shm->publ_tok_objs[index + 1],
-                    sizeof(TOK_OBJ_ENTRY) * count);
-            // We need to zero out the last entry... Since the memcopy
-            // does not zero it out...
-            memset((char *) &global_shm->
-                   publ_tok_objs[global_shm->num_publ_tok_obj + 1], 0,
-                   sizeof(TOK_OBJ_ENTRY));
-        } else {
-            memset((char *) &global_shm->
-                   publ_tok_objs[global_shm->num_publ_tok_obj], 0,
-                   sizeof(TOK_OBJ_ENTRY));
-        }
-    }
+    object_mgr_shm_write_end(global_shm);
 
     return CKR_OK;
 }
@@ -1834,12 +2710,17 @@ CK_RV object_mgr_del_from_shm(OBJECT *obj, LW_SHM_TYPE *global_shm)
 CK_RV object_mgr_check_shm(STDLL_TokData_t *tokdata, OBJECT *obj)
 {
     TOK_OBJ_ENTRY *entry = NULL;
-    CK_BBOOL priv, rd_locked = TRUE, wr_locked = FALSE;
+    CK_BBOOL priv, lazy, rd_locked = TRUE, wr_locked = FALSE;
     CK_ULONG index;
     CK_RV rc;
 
     priv = object_is_private(obj);
 
+    /* a lazy object has not been loaded from disk yet */
+    if (!obj->lazy &&
+        object_mgr_shm_is_current(tokdata->global_shm, obj, priv))
+        return CKR_OK;
+
 retry:
     rc = XProcLock(tokdata);
     if (rc != CKR_OK) {
@@ -1847,42 +2728,15 @@ retry:
        goto done_no_xproc_unlock;
     }
 
-    if (priv) {
-        /* first check the object count. If it is 0, then just return. */
-        if (tokdata->global_shm->num_priv_tok_obj == 0) {
-            TRACE_ERROR("%s\n", ock_err(ERR_OBJECT_HANDLE_INVALID));
-            rc = CKR_OBJECT_HANDLE_INVALID;
-            goto done;
-        }
-        rc = object_mgr_search_shm_for_obj(tokdata->global_shm->priv_tok_objs,
-                                           0,
-                                           tokdata->global_shm->
-                                           num_priv_tok_obj - 1, obj, &index);
-        if (rc != CKR_OK) {
-            TRACE_ERROR("object_mgr_search_shm_for_obj failed.\n");
-            goto done;
-        }
-        entry = &tokdata->global_shm->priv_tok_objs[index];
-    } else {
-        /* first check the object count. If it is 0, then just return. */
-        if (tokdata->global_shm->num_publ_tok_obj == 0) {
-            TRACE_ERROR("%s\n", ock_err(ERR_OBJECT_HANDLE_INVALID));
-            rc = CKR_OBJECT_HANDLE_INVALID;
-            goto done;
-        }
-        rc = object_mgr_search_shm_for_obj(tokdata->global_shm->publ_tok_objs,
-                                           0,
-                                           tokdata->global_shm->num_publ_tok_obj
-                                           - 1,
-                                           obj, &index);
-        if (rc != CKR_OK) {
-            TRACE_ERROR("object_mgr_search_shm_for_obj failed.\n");
-            goto done;
-        }
-        entry = &tokdata->global_shm->publ_tok_objs[index];
+    rc = object_mgr_search_shm_for_obj(tokdata->global_shm, priv, obj,
+                                       &index);
+    if (rc != CKR_OK) {
+        TRACE_ERROR("object_mgr_search_shm_for_obj failed.\n");
+        goto done;
     }
+    entry = object_mgr_shm_entries(tokdata->global_shm, priv) + index;
 
-    if ((obj->count_hi == entry->count_hi)
+    if (!obj->lazy && (obj->count_hi == entry->count_hi)
         && (obj->count_lo == entry->count_lo)) {
         rc = CKR_OK;
         goto done;
@@ -1933,9 +2787,19 @@ retry:
 
     /* If we reach here, we do have the WRITE lock on the object */
 
+    /* a lazy object is re-indexed by its attributes when it is loaded */
+    lazy = obj->lazy;
+    obj->lazy = FALSE;
+
     rc = reload_token_object(tokdata, obj);
-    if (rc != CKR_OK)
+    if (rc != CKR_OK) {
+        obj->lazy = lazy;
         goto done;
+    }
+
+    /* the object is now the version the SHM entry counts refer to */
+    obj->count_hi = entry->count_hi;
+    obj->count_lo = entry->count_lo;
 
     rc = object_unlock(obj);
     if (rc != CKR_OK)
@@ -1967,42 +2831,140 @@ done_no_xproc_unlock:
     return rc;
 }
 
+struct get_attr_obj {
+    OBJECT *obj;
+    struct btree *t;
+    CK_BBOOL current;
+};
 
-// I'd use the standard bsearch() routine but I want an index, not a pointer.
-// Converting the pointer to an index might cause problems when switching
-// to a 64-bit environment...
 //
-CK_RV object_mgr_search_shm_for_obj(TOK_OBJ_ENTRY *obj_list,
-                                    CK_ULONG lo,
-                                    CK_ULONG hi, OBJECT *obj, CK_ULONG *index)
+// Gets the attribute values of several objects. pReturnValues[i] receives
+// what C_GetAttributeValue would return for phObjects[i] and pTemplates[i].
+//
+// The token objects are checked against the SHM all at once, with a single
+// lock free read of the SHM sequence counter. Only the objects that have
+// changed since they were loaded take the slow path of object_mgr_check_shm().
+//
+CK_RV object_mgr_get_attribute_values_multi(STDLL_TokData_t *tokdata,
+                                            SESSION *sess,
+                                            CK_OBJECT_HANDLE *phObjects,
+                                            CK_ULONG ulObjectCount,
+                                            CK_IBM_OBJECT_TEMPLATE *pTemplates,
+                                            CK_RV *pReturnValues)
 {
-// SAB  XXX reduce the search time since this is what seems to be burning cycles
-    CK_ULONG idx;
+    LW_SHM_TYPE *global_shm = tokdata->global_shm;
+    struct get_attr_obj *objs;
+    CK_ULONG_32 seq;
+    CK_ULONG i;
+    CK_RV rc;
 
-    UNUSED(lo);
+    if (!sess || !phObjects || !pTemplates || !pReturnValues) {
+        TRACE_ERROR("Invalid function argument.\n");
+        return CKR_FUNCTION_FAILED;
+    }
+
+    objs = calloc(ulObjectCount, sizeof(*objs));
+    if (objs == NULL) {
+        TRACE_ERROR("%s\n", ock_err(ERR_HOST_MEMORY));
+        return CKR_HOST_MEMORY;
+    }
+
+    for (i = 0; i < ulObjectCount; i++)
+        objs[i].obj = object_mgr_map_get_object(tokdata, phObjects[i],
+                                                &objs[i].t);
+
+    seq = __atomic_load_n(&global_shm->tok_obj_seq, __ATOMIC_ACQUIRE);
+    if ((seq & 1) == 0) {
+        for (i = 0; i < ulObjectCount; i++) {
+            if (objs[i].obj == NULL || objs[i].t == &tokdata->sess_obj_btree)
+                continue;
+            objs[i].current = object_mgr_shm_entry_matches(global_shm,
+                                    objs[i].obj,
+                                    objs[i].t == &tokdata->priv_token_obj_btree);
+        }
+
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (__atomic_load_n(&global_shm->tok_obj_seq, __ATOMIC_RELAXED) != seq) {
+            for (i = 0; i < ulObjectCount; i++)
+                objs[i].current = FALSE;
+        }
+    }
 
-    if (obj->index == 0) {
-        for (idx = 0; idx <= hi; idx++) {
-            if (memcmp(obj->name, obj_list[idx].name, 8) == 0) {
-                *index = idx;
-                obj->index = idx;
-                return CKR_OK;
+    for (i = 0; i < ulObjectCount; i++) {
+        if (objs[i].obj == NULL) {
+            TRACE_ERROR("%s handle: %lu\n", ock_err(ERR_OBJECT_HANDLE_INVALID),
+                        phObjects[i]);
+            pReturnValues[i] = CKR_OBJECT_HANDLE_INVALID;
+            continue;
+        }
+
+        rc = object_lock(objs[i].obj, READ_LOCK);
+        if (rc != CKR_OK) {
+            pReturnValues[i] = rc;
+            goto put;
+        }
+
+        if (objs[i].t != &tokdata->sess_obj_btree &&
+            (!objs[i].current || objs[i].obj->lazy)) {
+            rc = object_mgr_check_shm(tokdata, objs[i].obj);
+            if (rc != CKR_OK) {
+                TRACE_DEVEL("object_mgr_check_shm failed.\n");
+                pReturnValues[i] = rc;
+                goto unlock;
             }
         }
-    } else {
-        // SAB better double check
-        if (memcmp(obj->name, obj_list[obj->index].name, 8) == 0) {
-            *index = obj->index;
+
+        if (object_is_private(objs[i].obj) == TRUE &&
+            (sess->session_info.state == CKS_RO_PUBLIC_SESSION ||
+             sess->session_info.state == CKS_RW_PUBLIC_SESSION)) {
+            TRACE_ERROR("%s\n", ock_err(ERR_USER_NOT_LOGGED_IN));
+            pReturnValues[i] = CKR_USER_NOT_LOGGED_IN;
+            goto unlock;
+        }
+
+        pReturnValues[i] = object_get_attribute_values(objs[i].obj,
+                                                       pTemplates[i].pTemplate,
+                                                       pTemplates[i].ulCount);
+        if (pReturnValues[i] != CKR_OK)
+            TRACE_DEVEL("object_get_attribute_values failed.\n");
+
+unlock:
+        object_unlock(objs[i].obj);
+put:
+        bt_put_node_value(objs[i].t, objs[i].obj);
+    }
+
+    free(objs);
+
+    return CKR_OK;
+}
+
+
+// Looks up the object's slot in the token object table. The last known slot
+// is kept in obj->index and checked first.
+//
+CK_RV object_mgr_search_shm_for_obj(LW_SHM_TYPE *global_shm, CK_BBOOL priv,
+                                    OBJECT *obj, CK_ULONG *index)
+{
+    TOK_OBJ_ENTRY *entries = object_mgr_shm_entries(global_shm, priv);
+    CK_ULONG capacity = global_shm->tok_obj_capacity;
+    CK_ULONG mask = capacity - 1;
+    CK_ULONG idx, n;
+
+    if (obj->index < capacity &&
+        memcmp(obj->name, entries[obj->index].name, 8) == 0) {
+        *index = obj->index;
+        return CKR_OK;
+    }
+
+    idx = object_mgr_shm_hash((char *)obj->name) & mask;
+    for (n = 0; n < capacity; n++, idx = (idx + 1) & mask) {
+        if (SHM_ENTRY_IS_EMPTY(&entries[idx]))
+            break;
+        if (memcmp(obj->name, entries[idx].name, 8) == 0) {
+            *index = idx;
+            obj->index = idx;
             return CKR_OK;
-        } else {
-            // something is hosed.. go back to the brute force method
-            for (idx = 0; idx <= hi; idx++) {
-                if (memcmp(obj->name, obj_list[idx].name, 8) == 0) {
-                    *index = idx;
-                    obj->index = idx;
-                    return CKR_OK;
-                }
-            }
         }
     }
 
@@ -2024,158 +2986,282 @@ CK_RV object_mgr_update_from_shm(STDLL_TokData_t *tokdata)
     return CKR_OK;
 }
 
-void delete_objs_from_btree_cb(STDLL_TokData_t *tokdata, void *node,
-                               unsigned long obj_handle, void *p3)
+static int update_tok_obj_name_cmp(const void *a, const void *b)
 {
-    struct update_tok_obj_args *ua = (struct update_tok_obj_args *) p3;
-    TOK_OBJ_ENTRY *shm_te = NULL;
-    OBJECT *obj = (OBJECT *) node;
-    CK_ULONG index;
+    const struct update_tok_obj_name *na = a, *nb = b;
+    int rc;
 
-    UNUSED(tokdata);
-
-    /* for each TOK_OBJ_ENTRY in the SHM list */
-    for (index = 0; index < *(ua->num_entries); index++) {
-        shm_te = &(ua->entries[index]);
+    rc = memcmp(na->name, nb->name, 8);
+    if (rc != 0)
+        return rc;
 
-        /* found it, return */
-        if (!memcmp(obj->name, shm_te->name, 8)) {
-            return;
-        }
-    }
+    return (na->order > nb->order) - (na->order < nb->order);
+}
 
-    /* didn't find it in SHM, delete it from its btree and the object map */
-    bt_node_free(&tokdata->object_map_btree, obj->map_handle, TRUE);
-    bt_node_free(ua->t, obj_handle, TRUE);
+static int update_tok_obj_name_find_cmp(const void *key, const void *elem)
+{
+    return memcmp(key, ((const struct update_tok_obj_name *)elem)->name, 8);
 }
 
-void find_by_name_cb(STDLL_TokData_t *tokdata, void *node,
-                     unsigned long obj_handle, void *p3)
+// Collects the names of all token objects in the SHM list
+//
+static CK_RV object_mgr_collect_shm_names(LW_SHM_TYPE *global_shm,
+                                          CK_BBOOL priv,
+                                          struct update_tok_obj_name **names,
+                                          CK_ULONG *num_names)
 {
-    OBJECT *obj = (OBJECT *) node;
-    struct find_by_name_args *fa = (struct find_by_name_args *) p3;
+    TOK_OBJ_ENTRY *shm_te;
+    CK_ULONG index, num, count = 0;
 
-    UNUSED(tokdata);
-    UNUSED(obj_handle);
+    num = priv ? global_shm->num_priv_tok_obj : global_shm->num_publ_tok_obj;
+    *names = calloc(num + 1, sizeof(struct update_tok_obj_name));
+    if (*names == NULL) {
+        TRACE_ERROR("%s\n", ock_err(ERR_HOST_MEMORY));
+        return CKR_HOST_MEMORY;
+    }
 
-    if (fa->done)
-        return;
+    shm_te = object_mgr_shm_entries(global_shm, priv);
+    for (index = 0; index < global_shm->tok_obj_capacity && count < num;
+         index++, shm_te++) {
+        if (SHM_ENTRY_IS_FREE(shm_te))
+            continue;
 
-    if (!memcmp(obj->name, fa->name, 8)) {
-        fa->done = TRUE;
+        memcpy((*names)[count].name, shm_te->name, 8);
+        (*names)[count].order = count;
+        (*names)[count].op = TOK_OBJ_CHANGE_ADD;
+        count++;
     }
+
+    qsort(*names, count, sizeof(struct update_tok_obj_name),
+          update_tok_obj_name_cmp);
+    *num_names = count;
+
+    return CKR_OK;
 }
 
-CK_RV object_mgr_update_publ_tok_obj_from_shm(STDLL_TokData_t *tokdata)
+// Collects the names of the token objects added or deleted by the changes
+// after sequence number 'from' up to 'to', with the last change per name
+// only. Returns CKR_FUNCTION_FAILED if the change log does not reach back
+// far enough.
+//
+static CK_RV object_mgr_collect_shm_changes(LW_SHM_TYPE *global_shm,
+                                            CK_BBOOL priv,
+                                            CK_ULONG_32 from, CK_ULONG_32 to,
+                                            struct update_tok_obj_name **names,
+                                            CK_ULONG *num_names)
 {
-    struct update_tok_obj_args ua;
-    struct find_by_name_args fa;
-    TOK_OBJ_ENTRY *shm_te = NULL;
-    CK_ULONG index;
-    OBJECT *new_obj;
-    CK_RV rc;
+    TOK_OBJ_CHANGE *change;
+    CK_ULONG_32 seq;
+    CK_ULONG i, count = 0;
 
-    ua.entries = tokdata->global_shm->publ_tok_objs;
-    ua.num_entries = &(tokdata->global_shm->num_publ_tok_obj);
-    ua.t = &tokdata->publ_token_obj_btree;
+    *names = calloc(to - from, sizeof(struct update_tok_obj_name));
+    if (*names == NULL) {
+        TRACE_ERROR("%s\n", ock_err(ERR_HOST_MEMORY));
+        return CKR_HOST_MEMORY;
+    }
 
-    /* delete any objects not in SHM from the btree */
-    bt_for_each_node(tokdata, &tokdata->publ_token_obj_btree,
-                     delete_objs_from_btree_cb, &ua);
+    for (seq = from + 1; seq != to + 1; seq++) {
+        change = &global_shm->tok_obj_changes[seq % TOK_OBJ_CHANGE_LOG_SIZE];
+        if (change->seq != seq) {
+            TRACE_DEVEL("Change %u is no longer in the change log.\n", seq);
+            free(*names);
+            *names = NULL;
+            return CKR_FUNCTION_FAILED;
+        }
+        if (change->priv != priv)
+            continue;
 
-    /* for each item in SHM, add it to the btree if its not there */
-    for (index = 0; index < tokdata->global_shm->num_publ_tok_obj; index++) {
-        shm_te = &tokdata->global_shm->publ_tok_objs[index];
+        memcpy((*names)[count].name, change->name, 8);
+        (*names)[count].order = count;
+        (*names)[count].op = change->op;
+        count++;
+    }
 
-        fa.done = FALSE;
-        fa.name = shm_te->name;
+    // sort by name and order, then keep the last change of each name
+    qsort(*names, count, sizeof(struct update_tok_obj_name),
+          update_tok_obj_name_cmp);
+    for (i = 0, *num_names = 0; i < count; i++) {
+        if (i + 1 < count && memcmp((*names)[i].name, (*names)[i + 1].name,
+                                    8) == 0)
+            continue;
+        (*names)[(*num_names)++] = (*names)[i];
+    }
 
-        /* find an object from SHM in the btree */
-        bt_for_each_node(tokdata, &tokdata->publ_token_obj_btree,
-                         find_by_name_cb, &fa);
+    return CKR_OK;
+}
 
-        /* we didn't find it in the btree, so add it */
-        if (fa.done == FALSE) {
-            new_obj = (OBJECT *) malloc(sizeof(OBJECT));
-            if (new_obj == NULL)
-                return CKR_HOST_MEMORY;
-            memset(new_obj, 0x0, sizeof(OBJECT));
+static void update_tok_obj_cb(STDLL_TokData_t *tokdata, void *node,
+                              unsigned long obj_handle, void *p3)
+{
+    struct update_tok_obj_args *ua = (struct update_tok_obj_args *) p3;
+    struct update_tok_obj_name *name;
+    OBJECT *obj = (OBJECT *) node;
+    CK_ULONG index;
 
-            rc = object_init_lock(new_obj);
-            if (rc != CKR_OK) {
-                free(new_obj);
-                continue;
-            }
+    name = bsearch(obj->name, ua->names, ua->num_names,
+                   sizeof(struct update_tok_obj_name),
+                   update_tok_obj_name_find_cmp);
 
-            memcpy(new_obj->name, shm_te->name, 8);
-            rc = reload_token_object(tokdata, new_obj);
-            if (rc == CKR_OK)
-                bt_node_add(&tokdata->publ_token_obj_btree, new_obj);
-            else
-                object_free(new_obj);
+    if (ua->full) {
+        /* found it in the SHM list, keep it */
+        if (object_mgr_search_shm_for_obj(tokdata->global_shm, ua->priv, obj,
+                                          &index) == CKR_OK) {
+            if (name != NULL)
+                name->found = TRUE;
+            return;
         }
+    } else if (name == NULL) {
+        /* not changed */
+        return;
+    } else if (name->op == TOK_OBJ_CHANGE_ADD) {
+        name->found = TRUE;
+        return;
     }
 
-    return CKR_OK;
+    /* deleted from SHM, delete it from its btree and the object map */
+    object_mgr_index_remove(tokdata, obj);
+    if (object_mgr_map_refers_to(tokdata, obj->map_handle, obj))
+        bt_node_free(&tokdata->object_map_btree, obj->map_handle, TRUE);
+    bt_node_free(ua->t, obj_handle, TRUE);
 }
 
-CK_RV object_mgr_update_priv_tok_obj_from_shm(STDLL_TokData_t *tokdata)
+static CK_RV object_mgr_load_tok_obj(STDLL_TokData_t *tokdata,
+                                     struct btree *t, const char *name)
 {
-    struct update_tok_obj_args ua;
-    struct find_by_name_args fa;
-    TOK_OBJ_ENTRY *shm_te = NULL;
-    CK_ULONG index;
     OBJECT *new_obj;
+    unsigned long obj_handle;
     CK_RV rc;
 
-    // SAB XXX don't bother doing this call if we are not in the correct
-    // login state
-    if (!session_mgr_user_session_exists(tokdata))
+    if (tokdata->objload == OBJLOAD_LAZY &&
+        object_mgr_add_lazy_obj(tokdata, name,
+                                t == &tokdata->priv_token_obj_btree) == CKR_OK)
         return CKR_OK;
 
-    ua.entries = tokdata->global_shm->priv_tok_objs;
-    ua.num_entries = &(tokdata->global_shm->num_priv_tok_obj);
-    ua.t = &tokdata->priv_token_obj_btree;
+    new_obj = (OBJECT *) malloc(sizeof(OBJECT));
+    if (new_obj == NULL)
+        return CKR_HOST_MEMORY;
+    memset(new_obj, 0x0, sizeof(OBJECT));
+
+    rc = object_init_lock(new_obj);
+    if (rc != CKR_OK) {
+        free(new_obj);
+        return rc;
+    }
+
+    memcpy(new_obj->name, name, 8);
+    rc = reload_token_object(tokdata, new_obj);
+    if (rc != CKR_OK) {
+        object_free(new_obj);
+        return rc;
+    }
 
-    /* delete any objects not in SHM from the btree */
-    bt_for_each_node(tokdata, &tokdata->priv_token_obj_btree, delete_objs_from_btree_cb,
-                     &ua);
+    obj_handle = bt_node_add(t, new_obj);
+    if (obj_handle)
+        object_mgr_index_add(tokdata, t, obj_handle, new_obj);
 
-    /* for each item in SHM, add it to the btree if its not there */
-    for (index = 0; index < tokdata->global_shm->num_priv_tok_obj; index++) {
-        shm_te = &tokdata->global_shm->priv_tok_objs[index];
+    return CKR_OK;
+}
 
-        fa.done = FALSE;
-        fa.name = shm_te->name;
+// Brings the local public or private token object btree up to date with the
+// SHM list. Normally only the changes logged since the last update are
+// applied, with a single pass over the btree. A full resync is done for the
+// first update, after the private objects have been purged, or if more
+// changes happened than the change log holds.
+//
+// Objects that can not be loaded are tried again on the next update.
+//
+// The caller holds the XProcLock.
+//
+static CK_RV object_mgr_update_tok_obj_from_shm(STDLL_TokData_t *tokdata,
+                                                CK_BBOOL priv)
+{
+    LW_SHM_TYPE *global_shm = tokdata->global_shm;
+    struct update_tok_obj_args ua;
+    CK_ULONG_32 seq, *last_seq;
+    CK_BBOOL *synced, retry = FALSE;
+    CK_ULONG i;
+    CK_RV rc = CKR_FUNCTION_FAILED;
 
-        /* find an object from SHM in the btree */
-        bt_for_each_node(tokdata, &tokdata->priv_token_obj_btree, find_by_name_cb, &fa);
+    if (priv) {
+        last_seq = &tokdata->priv_tok_obj_change_seq;
+        synced = &tokdata->priv_tok_obj_synced;
+        ua.t = &tokdata->priv_token_obj_btree;
+    } else {
+        last_seq = &tokdata->publ_tok_obj_change_seq;
+        synced = &tokdata->publ_tok_obj_synced;
+        ua.t = &tokdata->publ_token_obj_btree;
+    }
 
-        /* we didn't find it in the btree, so add it */
-        if (fa.done == FALSE) {
-            new_obj = (OBJECT *) malloc(sizeof(OBJECT));
-            if (new_obj == NULL)
-                return CKR_HOST_MEMORY;
-            memset(new_obj, 0x0, sizeof(OBJECT));
+    seq = global_shm->tok_obj_change_seq;
+    if (*synced && *last_seq == seq)
+        return CKR_OK;
 
-            rc = object_init_lock(new_obj);
-            if (rc != CKR_OK) {
-                free(new_obj);
-                continue;
-            }
+    ua.priv = priv;
+    ua.full = !*synced || seq - *last_seq > TOK_OBJ_CHANGE_LOG_SIZE;
+    if (!ua.full) {
+        rc = object_mgr_collect_shm_changes(global_shm, priv, *last_seq, seq,
+                                            &ua.names, &ua.num_names);
+        if (rc == CKR_HOST_MEMORY)
+            return rc;
+        ua.full = (rc != CKR_OK);
+    }
+    if (ua.full) {
+        rc = object_mgr_collect_shm_names(global_shm, priv, &ua.names,
+                                          &ua.num_names);
+        if (rc != CKR_OK)
+            return rc;
+    }
+
+    /* delete any deleted objects from the btree, find the existing ones */
+    *synced = FALSE;
+    bt_for_each_node(tokdata, ua.t, update_tok_obj_cb, &ua);
+
+    /* add any added objects to the btree if they are not there */
+    for (i = 0; i < ua.num_names; i++) {
+        if (ua.names[i].op != TOK_OBJ_CHANGE_ADD || ua.names[i].found)
+            continue;
 
-            memcpy(new_obj->name, shm_te->name, 8);
-            rc = reload_token_object(tokdata, new_obj);
-            if (rc == CKR_OK)
-                bt_node_add(&tokdata->priv_token_obj_btree, new_obj);
-            else
-                object_free(new_obj);
+        rc = object_mgr_load_tok_obj(tokdata, ua.t, ua.names[i].name);
+        if (rc == CKR_HOST_MEMORY) {
+            free(ua.names);
+            return rc;
+        }
+        if (rc != CKR_OK) {
+            TRACE_DEVEL("Cannot load token object %.8s, trying again on "
+                        "the next update.\n", ua.names[i].name);
+            retry = TRUE;
         }
     }
 
+    free(ua.names);
+
+    // An object that could not be loaded is tried again on the next update:
+    // a full resync is done again, or the changes since the previous update
+    // are applied again.
+    if (retry && ua.full)
+        return CKR_OK;
+    if (!retry)
+        *last_seq = seq;
+    *synced = TRUE;
+
     return CKR_OK;
 }
 
+CK_RV object_mgr_update_publ_tok_obj_from_shm(STDLL_TokData_t *tokdata)
+{
+    return object_mgr_update_tok_obj_from_shm(tokdata, FALSE);
+}
+
+CK_RV object_mgr_update_priv_tok_obj_from_shm(STDLL_TokData_t *tokdata)
+{
+    // SAB XXX don't bother doing this call if we are not in the correct
+    // login state
+    if (!session_mgr_user_session_exists(tokdata))
+        return CKR_OK;
+
+    return object_mgr_update_tok_obj_from_shm(tokdata, TRUE);
+}
+
 // SAB FIXME FIXME
 
 void purge_map_by_type_cb(STDLL_TokData_t *tokdata, void *node,
@@ -2241,15 +3327,20 @@ CK_RV object_put(STDLL_TokData_t *tokdata, OBJECT *obj, CK_BBOOL unlock)
 #ifdef DEBUG
 void dump_shm(LW_SHM_TYPE *global_shm, const char *s)
 {
+    TOK_OBJ_ENTRY *entries;
     CK_ULONG i;
     TRACE_DEBUG("%s: dump_shm priv:\n", s);
 
-    for (i = 0; i < global_shm->num_priv_tok_obj; i++) {
-        TRACE_DEBUG("[%lu]: %.8s\n", i, global_shm->priv_tok_objs[i].name);
+    entries = object_mgr_shm_entries(global_shm, TRUE);
+    for (i = 0; i < global_shm->tok_obj_capacity; i++) {
+        if (!SHM_ENTRY_IS_FREE(&entries[i]))
+            TRACE_DEBUG("[%lu]: %.8s\n", i, entries[i].name);
     }
     TRACE_DEBUG("%s: dump_shm publ:\n", s);
-    for (i = 0; i < global_shm->num_publ_tok_obj; i++) {
-        TRACE_DEBUG("[%lu]: %.8s\n", i, global_shm->publ_tok_objs[i].name);
+    entries = object_mgr_shm_entries(global_shm, FALSE);
+    for (i = 0; i < global_shm->tok_obj_capacity; i++) {
+        if (!SHM_ENTRY_IS_FREE(&entries[i]))
+            TRACE_DEBUG("[%lu]: %.8s\n", i, entries[i].name);
     }
 }
 #endif
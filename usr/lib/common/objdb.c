@@ -0,0 +1,894 @@
+/*
+ * COPYRIGHT (c) International Business Machines Corp. 2024
+ *
+ * This program is provided under the terms of the Common Public License,
+ * version 1.0 (CPL-1.0). Any use, reproduction or distribution for this
+ * software constitutes recipient's acceptance of CPL-1.0 terms which can be
+ * found in the file LICENSE file or at
+ * https://opensource.org/licenses/cpl1.0.php
+ */
+
+/*
+ * objdb.c
+ *
+ * Single file, memory mapped token object store.
+ *
+ * File layout (all integers big endian):
+ *
+ *   +--------------------+  0
+ *   | header             |
+ *   +--------------------+  OBJDB_PAGE
+ *   | hash index         |  index_slots * struct objdb_slot
+ *   +--------------------+  data_off (page aligned)
+ *   | record             |
+ *   | record             |
+ *   | ...                |
+ *   +--------------------+  tail
+ *   | unused             |
+ *   +--------------------+  file_len
+ *
+ * Records are only ever appended. An update appends a new record for the
+ * object and points its index slot to it, a delete appends a tombstone
+ * record and removes the slot. The index is an open addressing hash table
+ * with linear probing and backward shift deletion, so it never contains
+ * deleted markers.
+ *
+ * The index is only a cache of the record log: the header's OBJDB_DIRTY flag
+ * is set while the index and the tail are updated. If it is found set, a
+ * process died in the middle of an update and the index is rebuilt by
+ * replaying the records up to the first one with a bad checksum.
+ *
+ * A record is synced to disk before the tail and the index slot refer to it.
+ * After a crash of the system, the header and index pages may still have
+ * reached the disk in any order. Records are therefore checked when they are
+ * read, and a record that does not match its index slot or its checksum
+ * also causes the index to be rebuilt.
+ *
+ * When the space of superseded records exceeds the space of the live ones,
+ * or the index gets too full, the live records are copied into a new file
+ * that replaces the old one by an atomic rename after it was synced to disk.
+ * The old file is flagged OBJDB_OBSOLETE before that, so other processes
+ * that still have it mapped know that they have to re-open the store.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <endian.h>
+#include <libgen.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "pkcs11types.h"
+#include "objdb.h"
+#include "trace.h"
+#include "slotmgr.h" // for ock_snprintf
+
+#define OBJDB_MAGIC             "OCKOBJDB"
+#define OBJDB_VERSION           1
+#define OBJDB_PAGE              4096
+#define OBJDB_MIN_SLOTS         256
+#define OBJDB_MIN_SPACE         (64 * 1024)
+
+#define OBJDB_DIRTY             0x00000001
+#define OBJDB_OBSOLETE          0x00000002
+
+#define OBJDB_REC_MAGIC         0x4f424a52      /* "OBJR" */
+#define OBJDB_REC_DELETED       0x00000001
+
+#define OBJDB_NAME_LEN          8
+
+struct objdb_hdr {
+    char magic[8];
+    uint32_t version;
+    uint32_t flags;
+    uint64_t file_len;
+    uint64_t data_off;
+    uint64_t tail;
+    uint64_t live_bytes;        /* size of the records in the index */
+    uint64_t dead_bytes;        /* size of superseded records and tombstones */
+    uint32_t index_slots;       /* power of 2 */
+    uint32_t index_used;
+};
+
+struct objdb_slot {
+    char name[OBJDB_NAME_LEN];
+    uint64_t offset;            /* 0 = free slot */
+    uint32_t len;
+    uint32_t hash;
+};
+
+struct objdb_rec {
+    uint32_t magic;
+    uint32_t flags;
+    char name[OBJDB_NAME_LEN];
+    uint32_t len;
+    uint32_t csum;
+};
+
+#define OBJDB_ALIGN(x, a)       (((x) + (a) - 1) & ~((uint64_t)(a) - 1))
+#define OBJDB_REC_SIZE(len)     OBJDB_ALIGN(sizeof(struct objdb_rec) + (len), 8)
+
+static inline struct objdb_hdr *objdb_hdr(struct objdb *db)
+{
+    return (struct objdb_hdr *)db->map;
+}
+
+static inline struct objdb_slot *objdb_index(struct objdb *db)
+{
+    return (struct objdb_slot *)(db->map + OBJDB_PAGE);
+}
+
+static uint64_t objdb_data_off(uint32_t slots)
+{
+    return OBJDB_ALIGN(OBJDB_PAGE + (uint64_t)slots * sizeof(struct objdb_slot),
+                       OBJDB_PAGE);
+}
+
+static uint32_t fnv1a(uint32_t h, const void *data, size_t len)
+{
+    const unsigned char *p = data;
+    size_t i;
+
+    for (i = 0; i < len; i++) {
+        h ^= p[i];
+        h *= 16777619u;
+    }
+    return h;
+}
+
+static uint32_t objdb_name_hash(const char *name)
+{
+    return fnv1a(2166136261u, name, OBJDB_NAME_LEN);
+}
+
+static uint32_t objdb_rec_csum(const struct objdb_rec *rec,
+                               const CK_BYTE *data, uint32_t len)
+{
+    uint32_t h;
+
+    h = fnv1a(2166136261u, &rec->flags, sizeof(rec->flags));
+    h = fnv1a(h, rec->name, sizeof(rec->name));
+    h = fnv1a(h, &rec->len, sizeof(rec->len));
+    return fnv1a(h, data, len);
+}
+
+static void objdb_copy_name(char *dst, const char *name)
+{
+    /* The name is not NUL terminated if it has OBJDB_NAME_LEN characters */
+    memset(dst, 0, OBJDB_NAME_LEN);
+    memcpy(dst, name, strnlen(name, OBJDB_NAME_LEN));
+}
+
+/*
+ * Returns the index slot of the specified name, or the free slot where it
+ * would have to be inserted.
+ */
+static struct objdb_slot *objdb_find_slot(struct objdb_slot *index,
+                                          uint32_t slots, const char *name,
+                                          uint32_t hash)
+{
+    uint32_t mask = slots - 1, i;
+
+    for (i = hash & mask; ; i = (i + 1) & mask) {
+        if (index[i].offset == 0)
+            return &index[i];
+        if (be32toh(index[i].hash) == hash &&
+            memcmp(index[i].name, name, OBJDB_NAME_LEN) == 0)
+            return &index[i];
+    }
+}
+
+static void objdb_remove_slot(struct objdb_slot *index, uint32_t slots,
+                              struct objdb_slot *slot)
+{
+    uint32_t mask = slots - 1, i, j, k;
+
+    i = slot - index;
+    for (j = (i + 1) & mask; index[j].offset != 0; j = (j + 1) & mask) {
+        k = be32toh(index[j].hash) & mask;
+        /* move slot j to i unless its home position lies in (i, j] */
+        if ((i <= j) ? (i < k && k <= j) : (i < k || k <= j))
+            continue;
+        index[i] = index[j];
+        i = j;
+    }
+    memset(&index[i], 0, sizeof(index[i]));
+}
+
+static CK_RV objdb_map(struct objdb *db, size_t len)
+{
+    CK_BYTE *map;
+
+    map = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_SHARED, db->fd, 0);
+    if (map == MAP_FAILED) {
+        TRACE_ERROR("mmap(%s) failed: %s\n", db->path, strerror(errno));
+        return CKR_FUNCTION_FAILED;
+    }
+    if (db->map != NULL)
+        munmap(db->map, db->map_len);
+    db->map = map;
+    db->map_len = len;
+    return CKR_OK;
+}
+
+static void objdb_init_hdr(struct objdb_hdr *hdr, uint64_t file_len,
+                           uint32_t slots)
+{
+    memset(hdr, 0, sizeof(*hdr));
+    memcpy(hdr->magic, OBJDB_MAGIC, sizeof(hdr->magic));
+    hdr->version = htobe32(OBJDB_VERSION);
+    hdr->file_len = htobe64(file_len);
+    hdr->data_off = htobe64(objdb_data_off(slots));
+    hdr->tail = hdr->data_off;
+    hdr->index_slots = htobe32(slots);
+}
+
+/*
+ * Rebuild the index by replaying the record log. Called with OBJDB_DIRTY
+ * set, i.e. after a process died while updating the store.
+ */
+static CK_RV objdb_rebuild(struct objdb *db)
+{
+    struct objdb_hdr *hdr = objdb_hdr(db);
+    struct objdb_slot *index = objdb_index(db), *slot;
+    uint32_t slots = be32toh(hdr->index_slots), used = 0, hash, len;
+    uint64_t off, end, size, live = 0, dead = 0;
+    struct objdb_rec *rec;
+
+    TRACE_WARNING("Object store %s was not closed cleanly, rebuilding "
+                  "its index\n", db->path);
+
+    memset(index, 0, (size_t)slots * sizeof(*index));
+
+    off = be64toh(hdr->data_off);
+    end = be64toh(hdr->file_len);
+    while (off + sizeof(*rec) <= end) {
+        rec = (struct objdb_rec *)(db->map + off);
+        len = be32toh(rec->len);
+        size = OBJDB_REC_SIZE(len);
+        if (be32toh(rec->magic) != OBJDB_REC_MAGIC || off + size > end ||
+            objdb_rec_csum(rec, (CK_BYTE *)(rec + 1), len) !=
+                                                        be32toh(rec->csum))
+            break;
+
+        hash = objdb_name_hash(rec->name);
+        slot = objdb_find_slot(index, slots, rec->name, hash);
+        if (slot->offset != 0) {
+            size_t old = OBJDB_REC_SIZE(be32toh(slot->len));
+
+            live -= old;
+            dead += old;
+            used--;
+            objdb_remove_slot(index, slots, slot);
+        }
+        if (be32toh(rec->flags) & OBJDB_REC_DELETED) {
+            dead += size;
+        } else {
+            if (used + 1 >= slots) {
+                TRACE_ERROR("Object store %s index overflow\n", db->path);
+                return CKR_FUNCTION_FAILED;
+            }
+            slot = objdb_find_slot(index, slots, rec->name, hash);
+            memcpy(slot->name, rec->name, OBJDB_NAME_LEN);
+            slot->offset = htobe64(off);
+            slot->len = htobe32(len);
+            slot->hash = htobe32(hash);
+            live += size;
+            used++;
+        }
+        off += size;
+    }
+
+    hdr->tail = htobe64(off);
+    hdr->live_bytes = htobe64(live);
+    hdr->dead_bytes = htobe64(dead);
+    hdr->index_used = htobe32(used);
+    hdr->flags &= ~htobe32(OBJDB_DIRTY);
+
+    return CKR_OK;
+}
+
+static CK_RV objdb_open_fd(struct objdb *db)
+{
+    struct objdb_hdr hdr;
+    struct stat sb;
+    uint64_t file_len;
+    CK_RV rc;
+
+    db->fd = open(db->path, O_RDWR | O_CREAT | O_CLOEXEC,
+                  S_IRUSR | S_IWUSR | S_IRGRP | S_IWGRP);
+    if (db->fd < 0) {
+        TRACE_ERROR("open(%s) failed: %s\n", db->path, strerror(errno));
+        return CKR_FUNCTION_FAILED;
+    }
+
+    if (fstat(db->fd, &sb) != 0) {
+        TRACE_ERROR("fstat(%s) failed: %s\n", db->path, strerror(errno));
+        rc = CKR_FUNCTION_FAILED;
+        goto err;
+    }
+
+    memset(&hdr, 0, sizeof(hdr));
+    if (sb.st_size >= (off_t)sizeof(hdr) &&
+        pread(db->fd, &hdr, sizeof(hdr), 0) != sizeof(hdr)) {
+        TRACE_ERROR("pread(%s) failed: %s\n", db->path, strerror(errno));
+        rc = CKR_FUNCTION_FAILED;
+        goto err;
+    }
+
+    if (sb.st_size == 0 || hdr.magic[0] == '\0') {
+        /* new store, or its creation was interrupted */
+        file_len = objdb_data_off(OBJDB_MIN_SLOTS) + OBJDB_MIN_SPACE;
+        if (ftruncate(db->fd, file_len) != 0) {
+            TRACE_ERROR("ftruncate(%s) failed: %s\n", db->path,
+                        strerror(errno));
+            rc = CKR_FUNCTION_FAILED;
+            goto err;
+        }
+        rc = objdb_map(db, file_len);
+        if (rc != CKR_OK)
+            goto err;
+        objdb_init_hdr(objdb_hdr(db), file_len, OBJDB_MIN_SLOTS);
+        return CKR_OK;
+    }
+
+    if (memcmp(hdr.magic, OBJDB_MAGIC, sizeof(hdr.magic)) != 0 ||
+        be32toh(hdr.version) != OBJDB_VERSION ||
+        be64toh(hdr.file_len) > (uint64_t)sb.st_size) {
+        TRACE_ERROR("%s is not a valid object store\n", db->path);
+        rc = CKR_FUNCTION_FAILED;
+        goto err;
+    }
+
+    rc = objdb_map(db, be64toh(hdr.file_len));
+    if (rc != CKR_OK)
+        goto err;
+
+    if (be32toh(objdb_hdr(db)->flags) & OBJDB_DIRTY) {
+        rc = objdb_rebuild(db);
+        if (rc != CKR_OK)
+            goto err;
+    }
+
+    return CKR_OK;
+
+err:
+    if (db->map != NULL)
+        munmap(db->map, db->map_len);
+    db->map = NULL;
+    db->map_len = 0;
+    close(db->fd);
+    db->fd = -1;
+    return rc;
+}
+
+CK_RV objdb_open(struct objdb *db, const char *path)
+{
+    memset(db, 0, sizeof(*db));
+    db->fd = -1;
+
+    if (strlen(path) >= sizeof(db->path) - 4) {
+        TRACE_ERROR("object store path too long: %s\n", path);
+        return CKR_FUNCTION_FAILED;
+    }
+    strcpy(db->path, path);
+
+    return objdb_open_fd(db);
+}
+
+void objdb_close(struct objdb *db)
+{
+    if (db->map != NULL)
+        munmap(db->map, db->map_len);
+    db->map = NULL;
+    db->map_len = 0;
+    if (db->fd >= 0)
+        close(db->fd);
+    db->fd = -1;
+}
+
+/*
+ * Bring the mapping up to date with changes done by other processes: re-open
+ * the store if it was replaced by a compaction, and extend the mapping if the
+ * file has grown. Also repairs the index after a crashed update.
+ */
+static CK_RV objdb_refresh(struct objdb *db)
+{
+    struct objdb_hdr *hdr;
+    struct stat sb_old, sb_new;
+    CK_RV rc;
+
+    if (db->map == NULL)
+        return objdb_open_fd(db);
+
+    hdr = objdb_hdr(db);
+    if (be32toh(hdr->flags) & OBJDB_OBSOLETE) {
+        if (fstat(db->fd, &sb_old) != 0 || stat(db->path, &sb_new) != 0) {
+            TRACE_ERROR("stat(%s) failed: %s\n", db->path, strerror(errno));
+            return CKR_FUNCTION_FAILED;
+        }
+        if (sb_old.st_ino == sb_new.st_ino && sb_old.st_dev == sb_new.st_dev) {
+            /* compaction died before the rename, keep using this file */
+            hdr->flags &= ~htobe32(OBJDB_OBSOLETE);
+        } else {
+            objdb_close(db);
+            return objdb_open_fd(db);
+        }
+    }
+
+    if (be64toh(hdr->file_len) > db->map_len) {
+        rc = objdb_map(db, be64toh(hdr->file_len));
+        if (rc != CKR_OK)
+            return rc;
+        hdr = objdb_hdr(db);
+    }
+
+    if (be32toh(hdr->flags) & OBJDB_DIRTY)
+        return objdb_rebuild(db);
+
+    return CKR_OK;
+}
+
+static int objdb_sync_dir(const char *path)
+{
+    char dir[PATH_MAX];
+    int fd, rc;
+
+    strcpy(dir, path);
+    fd = open(dirname(dir), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd < 0)
+        return -1;
+    rc = fsync(fd);
+    close(fd);
+    return rc;
+}
+
+/*
+ * Write the live records into a new file with an index of the specified
+ * size (or an empty store if keep is FALSE), and atomically replace the
+ * current file with it.
+ */
+static CK_RV objdb_compact(struct objdb *db, uint32_t slots, CK_BBOOL keep)
+{
+    struct objdb_hdr *hdr = objdb_hdr(db), *nhdr;
+    struct objdb_slot *index = objdb_index(db), *nindex, *slot;
+    uint32_t old_slots = be32toh(hdr->index_slots), i, used = 0;
+    uint64_t live = keep ? be64toh(hdr->live_bytes) : 0;
+    uint64_t file_len, off, size;
+    char tmp[PATH_MAX];
+    struct objdb ndb;
+    struct stat sb;
+    CK_RV rc;
+
+    TRACE_DEVEL("Compacting object store %s (%u index slots)\n",
+                db->path, slots);
+
+    memset(&ndb, 0, sizeof(ndb));
+    if (ock_snprintf(tmp, sizeof(tmp), "%s.TMP", db->path) != 0) {
+        TRACE_ERROR("buffer overflow for object store path %s\n", db->path);
+        return CKR_FUNCTION_FAILED;
+    }
+    strcpy(ndb.path, db->path);
+
+    ndb.fd = open(tmp, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC,
+                  S_IRUSR | S_IWUSR);
+    if (ndb.fd < 0) {
+        TRACE_ERROR("open(%s) failed: %s\n", tmp, strerror(errno));
+        return CKR_FUNCTION_FAILED;
+    }
+    if (fstat(db->fd, &sb) == 0) {
+        if (fchown(ndb.fd, -1, sb.st_gid) != 0)
+            TRACE_DEVEL("fchown(%s) failed: %s\n", tmp, strerror(errno));
+        fchmod(ndb.fd, sb.st_mode & 07777);
+    }
+
+    file_len = OBJDB_ALIGN(objdb_data_off(slots) + live + live / 2 +
+                           OBJDB_MIN_SPACE, OBJDB_PAGE);
+    if (ftruncate(ndb.fd, file_len) != 0) {
+        TRACE_ERROR("ftruncate(%s) failed: %s\n", tmp, strerror(errno));
+        rc = CKR_FUNCTION_FAILED;
+        goto err;
+    }
+    rc = objdb_map(&ndb, file_len);
+    if (rc != CKR_OK)
+        goto err;
+
+    nhdr = objdb_hdr(&ndb);
+    nindex = objdb_index(&ndb);
+    objdb_init_hdr(nhdr, file_len, slots);
+    off = be64toh(nhdr->data_off);
+
+    for (i = 0; keep && i < old_slots; i++) {
+        if (index[i].offset == 0)
+            continue;
+        size = OBJDB_REC_SIZE(be32toh(index[i].len));
+        memcpy(ndb.map + off, db->map + be64toh(index[i].offset), size);
+        slot = objdb_find_slot(nindex, slots, index[i].name,
+                               be32toh(index[i].hash));
+        *slot = index[i];
+        slot->offset = htobe64(off);
+        off += size;
+        used++;
+    }
+
+    nhdr->tail = htobe64(off);
+    nhdr->live_bytes = htobe64(off - be64toh(nhdr->data_off));
+    nhdr->index_used = htobe32(used);
+
+    if (msync(ndb.map, file_len, MS_SYNC) != 0) {
+        TRACE_ERROR("msync(%s) failed: %s\n", tmp, strerror(errno));
+        rc = CKR_FUNCTION_FAILED;
+        goto err;
+    }
+
+    hdr->flags |= htobe32(OBJDB_OBSOLETE);
+    msync(db->map, OBJDB_PAGE, MS_SYNC);
+
+    if (rename(tmp, db->path) != 0) {
+        TRACE_ERROR("rename(%s) failed: %s\n", tmp, strerror(errno));
+        hdr->flags &= ~htobe32(OBJDB_OBSOLETE);
+        rc = CKR_FUNCTION_FAILED;
+        goto err;
+    }
+    if (objdb_sync_dir(db->path) != 0)
+        TRACE_DEVEL("fsync of directory of %s failed: %s\n", db->path,
+                    strerror(errno));
+
+    objdb_close(db);
+    *db = ndb;
+    return CKR_OK;
+
+err:
+    objdb_close(&ndb);
+    unlink(tmp);
+    return rc;
+}
+
+/*
+ * Make sure that a record of size bytes can be appended, and that the index
+ * can take another entry if grow_index is set.
+ */
+static CK_RV objdb_reserve(struct objdb *db, uint64_t size, CK_BBOOL grow_index)
+{
+    struct objdb_hdr *hdr = objdb_hdr(db);
+    uint32_t slots = be32toh(hdr->index_slots);
+    uint64_t live, dead, file_len, new_len;
+    CK_RV rc;
+
+    if (grow_index && (be32toh(hdr->index_used) + 1) * 4 > slots * 3) {
+        rc = objdb_compact(db, slots * 2, TRUE);
+        if (rc != CKR_OK)
+            return rc;
+        hdr = objdb_hdr(db);
+    }
+
+    file_len = be64toh(hdr->file_len);
+    if (be64toh(hdr->tail) + size <= file_len)
+        return CKR_OK;
+
+    live = be64toh(hdr->live_bytes);
+    dead = be64toh(hdr->dead_bytes);
+    if (dead > live && dead >= OBJDB_MIN_SPACE) {
+        rc = objdb_compact(db, be32toh(hdr->index_slots), TRUE);
+        if (rc != CKR_OK)
+            return rc;
+        hdr = objdb_hdr(db);
+        file_len = be64toh(hdr->file_len);
+        if (be64toh(hdr->tail) + size <= file_len)
+            return CKR_OK;
+    }
+
+    new_len = OBJDB_ALIGN(be64toh(hdr->tail) + size +
+                          (file_len - be64toh(hdr->data_off)) / 2,
+                          OBJDB_PAGE);
+    if (ftruncate(db->fd, new_len) != 0) {
+        TRACE_ERROR("ftruncate(%s) failed: %s\n", db->path, strerror(errno));
+        return CKR_FUNCTION_FAILED;
+    }
+    rc = objdb_map(db, new_len);
+    if (rc != CKR_OK)
+        return rc;
+    objdb_hdr(db)->file_len = htobe64(new_len);
+
+    return CKR_OK;
+}
+
+/*
+ * Append a record at the tail and sync it to disk. The tail is only moved
+ * once the record is on disk, so that it never refers to a partial record.
+ */
+static CK_RV objdb_append(struct objdb *db, const char *name, uint32_t flags,
+                          const CK_BYTE *data, uint32_t len, uint64_t *off)
+{
+    struct objdb_hdr *hdr = objdb_hdr(db);
+    uint64_t start, end;
+    struct objdb_rec *rec;
+    long pagesize;
+
+    *off = be64toh(hdr->tail);
+    rec = (struct objdb_rec *)(db->map + *off);
+
+    rec->magic = htobe32(OBJDB_REC_MAGIC);
+    rec->flags = htobe32(flags);
+    objdb_copy_name(rec->name, name);
+    rec->len = htobe32(len);
+    if (len > 0)
+        memcpy(rec + 1, data, len);
+    rec->csum = htobe32(objdb_rec_csum(rec, data, len));
+
+    pagesize = sysconf(_SC_PAGESIZE);
+    if (pagesize <= 0)
+        pagesize = OBJDB_PAGE;
+    start = *off & ~((uint64_t)pagesize - 1);
+    end = *off + OBJDB_REC_SIZE(len);
+    if (msync(db->map + start, end - start, MS_SYNC) != 0) {
+        TRACE_ERROR("msync(%s) failed: %s\n", db->path, strerror(errno));
+        /* a rebuild must not replay it */
+        rec->magic = 0;
+        return CKR_FUNCTION_FAILED;
+    }
+
+    hdr->tail = htobe64(end);
+    return CKR_OK;
+}
+
+/*
+ * Check that the record at the slot's offset is the one of the slot, and that
+ * it was completely written.
+ */
+static CK_BBOOL objdb_rec_valid(struct objdb *db, const struct objdb_slot *slot)
+{
+    uint64_t off = be64toh(slot->offset);
+    uint32_t len = be32toh(slot->len);
+    struct objdb_rec *rec = (struct objdb_rec *)(db->map + off);
+
+    if (off < be64toh(objdb_hdr(db)->data_off) ||
+        off + OBJDB_REC_SIZE(len) > be64toh(objdb_hdr(db)->tail))
+        return FALSE;
+
+    return be32toh(rec->magic) == OBJDB_REC_MAGIC &&
+           be32toh(rec->len) == len &&
+           memcmp(rec->name, slot->name, OBJDB_NAME_LEN) == 0 &&
+           objdb_rec_csum(rec, (CK_BYTE *)(rec + 1), len) ==
+                                                        be32toh(rec->csum);
+}
+
+/*
+ * An index slot refers to a bad record: the header and the index are not
+ * consistent with the records that reached the disk, rebuild them.
+ */
+static CK_RV objdb_repair(struct objdb *db, const char *name)
+{
+    TRACE_ERROR("Object store %s: bad record for %.8s\n", db->path, name);
+
+    objdb_hdr(db)->flags |= htobe32(OBJDB_DIRTY);
+    return objdb_rebuild(db);
+}
+
+CK_RV objdb_get(struct objdb *db, const char *name,
+                CK_BYTE **data, CK_ULONG *len)
+{
+    struct objdb_hdr *hdr;
+    struct objdb_slot *slot;
+    struct objdb_rec *rec;
+    char key[OBJDB_NAME_LEN];
+    CK_BBOOL repaired = FALSE;
+    CK_RV rc;
+
+    *data = NULL;
+    *len = 0;
+
+    rc = objdb_refresh(db);
+    if (rc != CKR_OK)
+        return rc;
+
+    objdb_copy_name(key, name);
+    for (;;) {
+        hdr = objdb_hdr(db);
+        slot = objdb_find_slot(objdb_index(db), be32toh(hdr->index_slots),
+                               key, objdb_name_hash(key));
+        if (slot->offset == 0)
+            return CKR_OK;
+        if (objdb_rec_valid(db, slot))
+            break;
+
+        /* the rebuilt index only refers to valid records */
+        if (repaired)
+            return CKR_FUNCTION_FAILED;
+        rc = objdb_repair(db, name);
+        if (rc != CKR_OK)
+            return rc;
+        repaired = TRUE;
+    }
+
+    rec = (struct objdb_rec *)(db->map + be64toh(slot->offset));
+    *data = (CK_BYTE *)(rec + 1);
+    *len = be32toh(rec->len);
+    return CKR_OK;
+}
+
+CK_RV objdb_put(struct objdb *db, const char *name,
+                const CK_BYTE *data, CK_ULONG len)
+{
+    struct objdb_hdr *hdr;
+    struct objdb_slot *slot;
+    char key[OBJDB_NAME_LEN];
+    uint64_t size = OBJDB_REC_SIZE(len), off, old;
+    uint32_t hash;
+    CK_RV rc;
+
+    if (len > UINT32_MAX - sizeof(struct objdb_rec))
+        return CKR_ARGUMENTS_BAD;
+
+    rc = objdb_refresh(db);
+    if (rc != CKR_OK)
+        return rc;
+
+    objdb_copy_name(key, name);
+    hash = objdb_name_hash(key);
+
+    rc = objdb_reserve(db, size, TRUE);
+    if (rc != CKR_OK)
+        return rc;
+
+    hdr = objdb_hdr(db);
+    hdr->flags |= htobe32(OBJDB_DIRTY);
+
+    rc = objdb_append(db, key, 0, data, len, &off);
+    if (rc != CKR_OK) {
+        hdr->flags &= ~htobe32(OBJDB_DIRTY);
+        return rc;
+    }
+
+    slot = objdb_find_slot(objdb_index(db), be32toh(hdr->index_slots), key,
+                           hash);
+    if (slot->offset != 0) {
+        old = OBJDB_REC_SIZE(be32toh(slot->len));
+        hdr->live_bytes = htobe64(be64toh(hdr->live_bytes) - old);
+        hdr->dead_bytes = htobe64(be64toh(hdr->dead_bytes) + old);
+    } else {
+        memcpy(slot->name, key, OBJDB_NAME_LEN);
+        slot->hash = htobe32(hash);
+        hdr->index_used = htobe32(be32toh(hdr->index_used) + 1);
+    }
+    slot->offset = htobe64(off);
+    slot->len = htobe32(len);
+    hdr->live_bytes = htobe64(be64toh(hdr->live_bytes) + size);
+
+    hdr->flags &= ~htobe32(OBJDB_DIRTY);
+
+    return CKR_OK;
+}
+
+CK_RV objdb_delete(struct objdb *db, const char *name)
+{
+    struct objdb_hdr *hdr;
+    struct objdb_slot *slot;
+    char key[OBJDB_NAME_LEN];
+    uint64_t old, off;
+    uint32_t hash;
+    CK_RV rc;
+
+    rc = objdb_refresh(db);
+    if (rc != CKR_OK)
+        return rc;
+
+    objdb_copy_name(key, name);
+    hash = objdb_name_hash(key);
+
+    hdr = objdb_hdr(db);
+    slot = objdb_find_slot(objdb_index(db), be32toh(hdr->index_slots), key,
+                           hash);
+    if (slot->offset == 0)
+        return CKR_OK;
+
+    rc = objdb_reserve(db, OBJDB_REC_SIZE(0), FALSE);
+    if (rc != CKR_OK)
+        return rc;
+
+    /* the reservation may have moved the index */
+    hdr = objdb_hdr(db);
+    slot = objdb_find_slot(objdb_index(db), be32toh(hdr->index_slots), key,
+                           hash);
+
+    hdr->flags |= htobe32(OBJDB_DIRTY);
+
+    rc = objdb_append(db, key, OBJDB_REC_DELETED, NULL, 0, &off);
+    if (rc != CKR_OK) {
+        hdr->flags &= ~htobe32(OBJDB_DIRTY);
+        return rc;
+    }
+
+    old = OBJDB_REC_SIZE(be32toh(slot->len));
+    hdr->live_bytes = htobe64(be64toh(hdr->live_bytes) - old);
+    hdr->dead_bytes = htobe64(be64toh(hdr->dead_bytes) + old +
+                              OBJDB_REC_SIZE(0));
+    hdr->index_used = htobe32(be32toh(hdr->index_used) - 1);
+    objdb_remove_slot(objdb_index(db), be32toh(hdr->index_slots), slot);
+
+    hdr->flags &= ~htobe32(OBJDB_DIRTY);
+
+    return CKR_OK;
+}
+
+/*
+ * Calls cb for each object in the store. The data pointers passed to cb are
+ * only valid until the store is modified.
+ */
+CK_RV objdb_for_each(struct objdb *db, objdb_cb_t cb, void *private)
+{
+    struct objdb_slot *index;
+    struct objdb_rec *rec;
+    char name[OBJDB_NAME_LEN + 1];
+    uint32_t slots, i;
+    CK_RV rc;
+
+    rc = objdb_refresh(db);
+    if (rc != CKR_OK)
+        return rc;
+
+    /*
+     * Check all records first, cb must not see an object twice. A rebuilt
+     * index only refers to valid records.
+     */
+    index = objdb_index(db);
+    slots = be32toh(objdb_hdr(db)->index_slots);
+    for (i = 0; i < slots; i++) {
+        if (index[i].offset != 0 && !objdb_rec_valid(db, &index[i])) {
+            rc = objdb_repair(db, index[i].name);
+            if (rc != CKR_OK)
+                return rc;
+            break;
+        }
+    }
+
+    index = objdb_index(db);
+    slots = be32toh(objdb_hdr(db)->index_slots);
+    for (i = 0; i < slots; i++) {
+        if (index[i].offset == 0)
+            continue;
+
+        rec = (struct objdb_rec *)(db->map + be64toh(index[i].offset));
+
+        memcpy(name, rec->name, OBJDB_NAME_LEN);
+        name[OBJDB_NAME_LEN] = '\0';
+        rc = cb(name, (CK_BYTE *)(rec + 1), be32toh(rec->len), private);
+        if (rc != CKR_OK)
+            return rc;
+    }
+
+    return CKR_OK;
+}
+
+/*
+ * Remove all objects, e.g. for C_InitToken.
+ */
+CK_RV objdb_reset(struct objdb *db)
+{
+    CK_RV rc;
+
+    rc = objdb_refresh(db);
+    if (rc != CKR_OK)
+        return rc;
+
+    return objdb_compact(db, OBJDB_MIN_SLOTS, FALSE);
+}
+
+/*
+ * Write all changes made so far to disk.
+ */
+CK_RV objdb_sync(struct objdb *db)
+{
+    if (msync(db->map, db->map_len, MS_SYNC) != 0) {
+        TRACE_ERROR("msync(%s): %s\n", db->path, strerror(errno));
+        return CKR_FUNCTION_FAILED;
+    }
+
+    return CKR_OK;
+}
@@ -0,0 +1,52 @@
+/*
+ * COPYRIGHT (c) International Business Machines Corp. 2024
+ *
+ * This program is provided under the terms of the Common Public License,
+ * version 1.0 (CPL-1.0). Any use, reproduction or distribution for this
+ * software constitutes recipient's acceptance of CPL-1.0 terms which can be
+ * found in the file LICENSE file or at
+ * https://opensource.org/licenses/cpl1.0.php
+ */
+
+#ifndef OBJDB_H
+#define OBJDB_H
+
+#include <stddef.h>
+#include <linux/limits.h>
+#include "pkcs11types.h"
+
+/*
+ * Single file token object store (objstore = mmap in opencryptoki.conf).
+ *
+ * All token objects of a token are kept in TOK_OBJ/OBJ.DB instead of one
+ * file per object plus OBJ.IDX. The file is mapped into memory, new object
+ * versions are appended to it and an embedded hash index maps the object
+ * names to their latest record. The record contents are the same as those
+ * of the per object files.
+ *
+ * The caller must hold the token's XProcLock for all operations.
+ */
+#define PK_LITE_OBJ_DB "OBJ.DB"
+
+struct objdb {
+    int fd;
+    CK_BYTE *map;
+    size_t map_len;
+    char path[PATH_MAX];
+};
+
+typedef CK_RV (*objdb_cb_t)(const char *name, CK_BYTE *data, CK_ULONG len,
+                            void *private);
+
+CK_RV objdb_open(struct objdb *db, const char *path);
+void objdb_close(struct objdb *db);
+CK_RV objdb_get(struct objdb *db, const char *name,
+                CK_BYTE **data, CK_ULONG *len);
+CK_RV objdb_put(struct objdb *db, const char *name,
+                const CK_BYTE *data, CK_ULONG len);
+CK_RV objdb_delete(struct objdb *db, const char *name);
+CK_RV objdb_for_each(struct objdb *db, objdb_cb_t cb, void *private);
+CK_RV objdb_reset(struct objdb *db);
+CK_RV objdb_sync(struct objdb *db);
+
+#endif
@@ -332,6 +332,7 @@ void object_free(OBJECT * obj)
     if (obj) {
         if (obj->template)
             template_free(obj->template);
+        object_ex_data_free(obj);
         object_destroy_lock(obj);
         free(obj);
     }
@@ -677,6 +678,10 @@ CK_RV object_set_attribute_values(STDLL_TokData_t * tokdata,
         }
    }
 
+    // any cached key material may no longer match the template
+    //
+    object_ex_data_free(obj);
+
     // merge in the new attributes
     //
     rc = template_merge(obj->template, &new_tmpl);
@@ -788,6 +793,7 @@ CK_RV object_restore_withSize(struct policy *policy,
         *new_obj = obj;
     } else {
         /* Reload of existing object only changes the template */
+        object_ex_data_free(*new_obj);
         template_free((*new_obj)->template);
         (*new_obj)->template = obj->template;
         (*new_obj)->strength.strength = obj->strength.strength;
@@ -927,6 +933,54 @@ CK_RV object_destroy_lock(OBJECT *obj)
     return CKR_OK;
 }
 
+/*
+ * Returns the token specific data cached with the object, allocating and
+ * attaching a zeroed structure of the given size if there is none yet.
+ * The caller must hold at least the object's read lock. Concurrent readers
+ * may race to attach the data, only one of them wins.
+ */
+OBJ_EX_DATA *object_ex_data_get(OBJECT *obj, size_t size,
+                                void (*free_func)(OBJ_EX_DATA *ex_data))
+{
+    OBJ_EX_DATA *ex_data;
+
+    ex_data = __atomic_load_n(&obj->ex_data, __ATOMIC_ACQUIRE);
+    if (ex_data != NULL)
+        return ex_data;
+
+    ex_data = calloc(1, size);
+    if (ex_data == NULL) {
+        TRACE_ERROR("%s\n", ock_err(ERR_HOST_MEMORY));
+        return NULL;
+    }
+    ex_data->free_func = free_func;
+
+    if (!__sync_bool_compare_and_swap(&obj->ex_data, NULL, ex_data)) {
+        free(ex_data);
+        ex_data = __atomic_load_n(&obj->ex_data, __ATOMIC_ACQUIRE);
+    }
+
+    return ex_data;
+}
+
+/*
+ * Drops the token specific data cached with the object. The caller must
+ * hold the object's write lock, or be the only user of the object.
+ */
+void object_ex_data_free(OBJECT *obj)
+{
+    OBJ_EX_DATA *ex_data = obj->ex_data;
+
+    if (ex_data == NULL)
+        return;
+
+    obj->ex_data = NULL;
+    if (ex_data->free_func != NULL)
+        ex_data->free_func(ex_data);
+    else
+        free(ex_data);
+}
+
 /*
  * Do NOT try to get an object lock, if the current thread holds the
  * XProcLock! This might case a deadlock !
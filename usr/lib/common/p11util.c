@@ -118,6 +118,7 @@ const char *p11_get_ckr(CK_RV rc)
         _sym2str(CKR_LIBRARY_LOAD_FAILED);
         _sym2str(CKR_PIN_TOO_WEAK);
         _sym2str(CKR_PUBLIC_KEY_INVALID);
+        _sym2str(CKR_IBM_ASYNC_PENDING);
     default:
         return "UNKNOWN";
     }
@@ -29,7 +29,7 @@
 // search for the specified session. returning a pointer to the session
 // might be dangerous, but performs well
 //
-// The returned session must be put back (using bt_put_node_value()) by the
+// The returned session must be put back (using session_mgr_put()) by the
 // caller to decrease the reference count!
 //
 // Returns:  SESSION * or NULL
@@ -42,7 +42,7 @@ SESSION *session_mgr_find(STDLL_TokData_t *tokdata, CK_SESSION_HANDLE handle)
         return NULL;
     }
 
-    result = bt_get_node_value(&tokdata->sess_btree, handle);
+    result = ht_get_value(&tokdata->sess_table, handle);
 
     return result;
 }
@@ -53,7 +53,7 @@ SESSION *session_mgr_find(STDLL_TokData_t *tokdata, CK_SESSION_HANDLE handle)
 // in the session info. returning a pointer to the session might be
 // dangerous, but performs well
 //
-// The returned session must be put back (using bt_put_node_value()) by the
+// The returned session must be put back (using session_mgr_put()) by the
 // caller to decrease the reference count!
 //
 // Returns:  SESSION * or NULL
@@ -70,7 +70,7 @@ SESSION *session_mgr_find_reset_error(STDLL_TokData_t *tokdata,
 
 void session_mgr_put(STDLL_TokData_t *tokdata, SESSION *session)
 {
-    bt_put_node_value(&tokdata->sess_btree, session);
+    ht_put_value(&tokdata->sess_table, session);
 }
 
 // session_mgr_new()
@@ -138,7 +138,7 @@ CK_RV session_mgr_new(STDLL_TokData_t *tokdata, CK_ULONG flags,
         }
     }
 
-    *phSession = bt_node_add(&tokdata->sess_btree, new_session);
+    *phSession = ht_add(&tokdata->sess_table, new_session);
     if (*phSession == 0) {
         rc = CKR_HOST_MEMORY;
         /* new_session will be free'd below */
@@ -242,7 +242,7 @@ CK_RV session_mgr_close_session(STDLL_TokData_t *tokdata,
     SESSION *sess;
     CK_RV rc = CKR_OK;
 
-    sess = bt_get_node_value(&tokdata->sess_btree, handle);
+    sess = ht_get_value(&tokdata->sess_table, handle);
     if (!sess) {
         TRACE_ERROR("%s\n", ock_err(ERR_SESSION_HANDLE_INVALID));
         rc = CKR_SESSION_HANDLE_INVALID;
@@ -261,8 +261,7 @@ CK_RV session_mgr_close_session(STDLL_TokData_t *tokdata,
     // Make sure this address is now invalid
     sess->handle = CK_INVALID_HANDLE;
 
-    if (sess->find_list)
-        free(sess->find_list);
+    object_mgr_find_free(sess);
 
     if (sess->encr_ctx.context) {
         if (sess->encr_ctx.context_free_func != NULL)
@@ -300,6 +299,8 @@ CK_RV session_mgr_close_session(STDLL_TokData_t *tokdata,
     if (sess->digest_ctx.mech.pParameter)
         free(sess->digest_ctx.mech.pParameter);
 
+    digest_mgr_free_pool(tokdata, sess, &sess->digest_ctx);
+
     if (sess->sign_ctx.context) {
         if (sess->sign_ctx.context_free_func != NULL)
             sess->sign_ctx.context_free_func(tokdata, sess,
@@ -324,9 +325,15 @@ CK_RV session_mgr_close_session(STDLL_TokData_t *tokdata,
     if (sess->verify_ctx.mech.pParameter)
         free(sess->verify_ctx.mech.pParameter);
 
-    bt_put_node_value(&tokdata->sess_btree, sess);
+    if (sess->msg_encr_ctx.active)
+        encr_mgr_cleanup(tokdata, sess, &sess->msg_encr_ctx);
+
+    if (sess->msg_decr_ctx.active)
+        decr_mgr_cleanup(tokdata, sess, &sess->msg_decr_ctx);
+
+    ht_put_value(&tokdata->sess_table, sess);
     sess = NULL;
-    bt_node_free(&tokdata->sess_btree, handle, TRUE);
+    ht_remove(&tokdata->sess_table, handle, TRUE);
 
     // XXX XXX  Not having this is a problem
     //  for IHS.  The spec states that there is an implicit logout
@@ -337,7 +344,7 @@ CK_RV session_mgr_close_session(STDLL_TokData_t *tokdata,
     //  objects EVERY time.   If we are logged out, we MUST purge the private
     //  objects from this process..
     //
-    if (bt_is_empty(&tokdata->sess_btree)) {
+    if (ht_is_empty(&tokdata->sess_table)) {
         // SAB  XXX  if all sessions are closed.  Is this effectivly logging out
         if (token_specific.t_logout) {
             rc = token_specific.t_logout(tokdata);
@@ -371,8 +378,7 @@ void session_free(STDLL_TokData_t *tokdata, void *node_value,
     object_mgr_purge_session_objects(tokdata, sess, ALL);
     sess->handle = CK_INVALID_HANDLE;
 
-    if (sess->find_list)
-        free(sess->find_list);
+    object_mgr_find_free(sess);
 
     if (sess->encr_ctx.context) {
         if (sess->encr_ctx.context_free_func != NULL)
@@ -410,6 +416,8 @@ void session_free(STDLL_TokData_t *tokdata, void *node_value,
     if (sess->digest_ctx.mech.pParameter)
         free(sess->digest_ctx.mech.pParameter);
 
+    digest_mgr_free_pool(tokdata, sess, &sess->digest_ctx);
+
     if (sess->sign_ctx.context) {
         if (sess->sign_ctx.context_free_func != NULL)
             sess->sign_ctx.context_free_func(tokdata, sess,
@@ -434,8 +442,14 @@ void session_free(STDLL_TokData_t *tokdata, void *node_value,
     if (sess->verify_ctx.mech.pParameter)
         free(sess->verify_ctx.mech.pParameter);
 
+    if (sess->msg_encr_ctx.active)
+        encr_mgr_cleanup(tokdata, sess, &sess->msg_encr_ctx);
+
+    if (sess->msg_decr_ctx.active)
+        decr_mgr_cleanup(tokdata, sess, &sess->msg_decr_ctx);
+
     /* NB: any access to sess or @node_value after this returns will segfault */
-    bt_node_free(&tokdata->sess_btree, node_idx, TRUE);
+    ht_remove(&tokdata->sess_table, node_idx, TRUE);
 }
 
 // session_mgr_close_all_sessions()
@@ -444,7 +458,7 @@ void session_free(STDLL_TokData_t *tokdata, void *node_value,
 //
 CK_RV session_mgr_close_all_sessions(STDLL_TokData_t *tokdata)
 {
-    bt_for_each_node(tokdata, &tokdata->sess_btree, session_free, NULL);
+    ht_for_each(tokdata, &tokdata->sess_table, session_free, NULL);
 
     __transaction_atomic {      /* start transaction */
         tokdata->global_login_state = CKS_RO_PUBLIC_SESSION;
@@ -491,8 +505,8 @@ void session_login(STDLL_TokData_t *tokdata, void *node_value,
 //
 CK_RV session_mgr_login_all(STDLL_TokData_t *tokdata, CK_USER_TYPE user_type)
 {
-    bt_for_each_node(tokdata, &tokdata->sess_btree, session_login,
-                     (void *)&user_type);
+    ht_for_each(tokdata, &tokdata->sess_table, session_login,
+                (void *)&user_type);
 
     return CKR_OK;
 }
@@ -530,7 +544,7 @@ void session_logout(STDLL_TokData_t *tokdata, void *node_value,
 //
 CK_RV session_mgr_logout_all(STDLL_TokData_t *tokdata)
 {
-    bt_for_each_node(tokdata, &tokdata->sess_btree, session_logout, NULL);
+    ht_for_each(tokdata, &tokdata->sess_table, session_logout, NULL);
 
     return CKR_OK;
 }
@@ -556,6 +570,12 @@ CK_RV session_mgr_get_op_state(SESSION *sess,
         return CKR_STATE_UNSAVEABLE;
     }
 
+    if (sess->msg_encr_ctx.active == TRUE ||
+        sess->msg_decr_ctx.active == TRUE) {
+        TRACE_ERROR("%s\n", ock_err(ERR_STATE_UNSAVEABLE));
+        return CKR_STATE_UNSAVEABLE;
+    }
+
     // ensure that at least one operation is active
     //
     active_ops = 0;
@@ -823,6 +843,8 @@ CK_RV session_mgr_set_op_state(STDLL_TokData_t *tokdata, SESSION *sess,
     CK_BYTE *ptr1 = NULL;
     CK_BYTE *ptr2 = NULL;
     CK_BYTE *ptr3 = NULL;
+    CK_BYTE *pool_context;
+    context_free_func_t pool_context_free_func;
     CK_ULONG len;
 
     if (!sess || !data) {
@@ -1039,10 +1061,16 @@ CK_RV session_mgr_set_op_state(STDLL_TokData_t *tokdata, SESSION *sess,
         sess->verify_ctx.mech.pParameter = mech_param;
         break;
     case STATE_DIGEST:
+        /* The pooled context belongs to the session, not to the state */
+        pool_context = sess->digest_ctx.pool_context;
+        pool_context_free_func = sess->digest_ctx.pool_context_free_func;
+
         memcpy(&sess->digest_ctx, ptr1, sizeof(DIGEST_CONTEXT));
 
         sess->digest_ctx.context = context;
         sess->digest_ctx.mech.pParameter = mech_param;
+        sess->digest_ctx.pool_context = pool_context;
+        sess->digest_ctx.pool_context_free_func = pool_context_free_func;
         break;
     }
 
@@ -76,7 +76,9 @@ struct shm_context {
     char name[SM_NAME_LEN + 1];
 
     /*
-     * `data_len` is the length of the variable length filed `data`.
+     * `data_len` is the length of the variable length filed `data`. For a
+     * growable region this is the maximum length, which is what every
+     * process maps, while the backing object may be shorter.
      */
     int data_len;
 
@@ -147,11 +149,16 @@ static char *convert_path_to_shm_name(const char *file_path)
  * Open a shared memory region identified by `sm_name` using permissions defined
  * by `mode` with length `len`.
  *
+ * The region can later be grown up to `max_len` bytes with sm_grow(). The
+ * full `max_len` is mapped right away, so the address of the region does not
+ * change when it grows. Pass `max_len` equal to `len` for a fixed size region.
+ *
  * If the shared memory already exists and doesn't match the given length an
  * error is returned (if `force` is zero) or the shared memory is reinitialized
  * (if `force` is non zero).
  */
-int sm_open(const char *sm_name, int mode, void **p_addr, size_t len, int force)
+int sm_open(const char *sm_name, int mode, void **p_addr, size_t len,
+            size_t max_len, int force)
 {
     int rc;
     int fd = -1;
@@ -160,9 +167,17 @@ int sm_open(const char *sm_name, int mode, void **p_addr, size_t len, int force)
     char *name = NULL;
     struct shm_context *ctx = NULL;
     size_t real_len = sizeof(*ctx) + len;
+    size_t real_max_len = sizeof(*ctx) + max_len;
     int created = 0;
+    int ref, data_len;
     struct group *grp;
 
+    if (max_len < len) {
+        TRACE_ERROR("Error: invalid shared memory length %lu (max %lu).\n",
+                    (unsigned long)len, (unsigned long)max_len);
+        return -EINVAL;
+    }
+
     /*
      * This is used for portability purpose. Please check `shm_open`
      * man page for more details.
@@ -236,70 +251,71 @@ int sm_open(const char *sm_name, int mode, void **p_addr, size_t len, int force)
 
     /*
      * The shared memory needs to be extended when created (when its length
-     * is zero). When its length is not zero and is not equal to the
-     * expected size, an error is returned if `force` is not set. If `force`
-     * is set, the existing shared memory is truncated and any data on it is
-     * lost.
+     * is zero). An existing region is compatible if its length lies between
+     * `len` and `max_len` and it was created with the same maximum length.
+     * Otherwise, an error is returned if `force` is not set and other
+     * processes are attached to it. If `force` is set, or nobody uses it, the
+     * existing shared memory is truncated and any data on it is lost.
      */
-    if (stat_buf.st_size == 0
-        || (force && (size_t)stat_buf.st_size != real_len)) {
-        /*
-         * If the shared memory region was just created, it's necessary
-         * to extend it to the expected size using ftruncate.
-         *
-         * It's important to notice that it is resized to a length
-         * greater than the value requested (`len`). The extra space is
-         * used to store additional information related to the shared
-         * memory, such as its size and identifier.
-         */
+    if (stat_buf.st_size == 0) {
         created = 1;
-        TRACE_DEVEL("Truncating \"%s\".\n", name);
-        if (ftruncate(fd, real_len) < 0) {
-            rc = -errno;
-            SYS_ERROR(errno, "Cannot truncate \"%s\".\n", name);
-            goto done;
-        }
-    } else if ((size_t)stat_buf.st_size != real_len) {
-        int ref;
-
-        /* get ref count */
+    } else {
+        /* get ref count and length */
         addr = mmap(NULL, sizeof(*ctx), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
-        if (addr == NULL) {
+        if (addr == MAP_FAILED) {
             rc = -errno;
             SYS_ERROR(errno, "Failed to map \"%s\" to memory.\n", name);
             goto done;
         }
         ctx = addr;
         ref = ctx->ref;
+        data_len = ctx->data_len;
         if (munmap(addr, sizeof(*ctx))) {
             rc = -errno;
             SYS_ERROR(errno, "Failed to unmap \"%s\" (%p).\n", name, (void *)ctx);
             goto done;;
         }
 
-        /*
-         * Too big real_len indicates the new token data format is used.
-         * If no application is attached to the shm (ref==1) it can be
-         * safely expanded/recreated. Otherwise, fail.
-         */
-        if (ref <= 1 && real_len > (size_t)stat_buf.st_size) {
-            created = 1;
-            TRACE_DEVEL("Truncating \"%s\".\n", name);
-            if (ftruncate(fd, real_len) < 0) {
-                rc = -errno;
-                SYS_ERROR(errno, "Cannot truncate \"%s\".\n", name);
+        if ((size_t)stat_buf.st_size < real_len ||
+            (size_t)stat_buf.st_size > real_max_len ||
+            data_len < 0 || (size_t)data_len != max_len) {
+            /*
+             * A different length indicates another shared memory layout
+             * (e.g. the token data format of a different version). If no
+             * application is attached to the shm (ref==1) it can be safely
+             * recreated. Otherwise, fail.
+             */
+            if (force || ref <= 1) {
+                created = 1;
+            } else {
+                rc = -1;
+                TRACE_ERROR("Error: shared memory \"%s\" exists and does not "
+                            "match the expected size.\n", name);
                 goto done;
             }
-        } else {
-            rc = -1;
-            TRACE_ERROR("Error: shared memory \"%s\" exists and does not "
-                        "match the expected size.\n", name);
+        }
+    }
+
+    if (created) {
+        /*
+         * If the shared memory region was just created, it's necessary
+         * to extend it to the expected size using ftruncate.
+         *
+         * It's important to notice that it is resized to a length
+         * greater than the value requested (`len`). The extra space is
+         * used to store additional information related to the shared
+         * memory, such as its size and identifier.
+         */
+        TRACE_DEVEL("Truncating \"%s\".\n", name);
+        if (ftruncate(fd, real_len) < 0) {
+            rc = -errno;
+            SYS_ERROR(errno, "Cannot truncate \"%s\".\n", name);
             goto done;
         }
     }
 
-    addr = mmap(NULL, real_len, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
-    if (addr == NULL) {
+    addr = mmap(NULL, real_max_len, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (addr == MAP_FAILED) {
         rc = -errno;
         SYS_ERROR(errno, "Failed to map \"%s\" to memory.\n", name);
         goto done;
@@ -315,8 +331,8 @@ int sm_open(const char *sm_name, int mode, void **p_addr, size_t len, int force)
     if (created) {
         strncpy(ctx->name, name, SM_NAME_LEN);
         ctx->name[SM_NAME_LEN] = '\0';
-        ctx->data_len = len;
-        memset(ctx->data, 0, ctx->data_len);
+        ctx->data_len = max_len;
+        memset(ctx->data, 0, len);
         ctx->ref = 0;
     }
     ctx->ref += 1;
@@ -393,6 +409,60 @@ int sm_close(void *addr, int destroy, int ignore_ref_count)
     return 0;
 }
 
+/*
+ * Grow a shared memory region opened by sm_open() to `len` bytes. The new
+ * space is initialized with zeros. Growing beyond the maximum length given
+ * to sm_open() fails, shrinking is not supported and silently ignored.
+ */
+int sm_grow(void *addr, size_t len)
+{
+    int rc = 0;
+    int fd;
+    struct stat stat_buf;
+    struct shm_context *ctx = get_shm_context(addr);
+    size_t real_len = sizeof(*ctx) + len;
+
+    if (ctx->ref <= 0) {
+        TRACE_ERROR("Error: invalid shared memory address %p (ref=%d).\n",
+                    addr, ctx->ref);
+        return -EINVAL;
+    }
+
+    if (len > (size_t)ctx->data_len) {
+        TRACE_ERROR("Error: shared memory \"%s\" can not grow beyond %d "
+                    "bytes.\n", ctx->name, ctx->data_len);
+        return -ENOSPC;
+    }
+
+    fd = shm_open(ctx->name, O_RDWR, 0);
+    if (fd < 0) {
+        rc = -errno;
+        SYS_ERROR(errno, "Failed to open shared memory \"%s\".\n", ctx->name);
+        return rc;
+    }
+
+    if (fstat(fd, &stat_buf)) {
+        rc = -errno;
+        SYS_ERROR(errno, "Cannot stat \"%s\".\n", ctx->name);
+        goto done;
+    }
+
+    if ((size_t)stat_buf.st_size < real_len) {
+        TRACE_DEVEL("Growing \"%s\" to %lu bytes.\n", ctx->name,
+                    (unsigned long)real_len);
+        if (ftruncate(fd, real_len) < 0) {
+            rc = -errno;
+            SYS_ERROR(errno, "Cannot truncate \"%s\".\n", ctx->name);
+            goto done;
+        }
+    }
+
+done:
+    close(fd);
+
+    return rc;
+}
+
 /*
  * Destroy a shared memory region.
  */
@@ -27,7 +27,9 @@
 
 
 int sm_open(const char *sm_name, int mode, void **p_addr, size_t len,
-            int force);
+            size_t max_len, int force);
+
+int sm_grow(void *addr, size_t len);
 
 int sm_close(void *addr, int destroy, int ignore_ref_count);
 
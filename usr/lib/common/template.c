@@ -266,30 +266,95 @@ CK_RV template_add_default_attributes(TEMPLATE *tmpl, TEMPLATE *basetmpl,
 }
 
 
+/* template_attribute_search()
+ *
+ * binary search for the attribute type in the sorted attribute array.
+ * Returns TRUE and its position if found, otherwise FALSE and the position
+ * where an attribute of that type has to be inserted.
+ */
+static CK_BBOOL template_attribute_search(TEMPLATE *tmpl,
+                                          CK_ATTRIBUTE_TYPE type,
+                                          CK_ULONG *pos)
+{
+    CK_ULONG lo = 0, hi = tmpl->count, mid;
+
+    /* Fast path for appending, e.g. when building a template in order */
+    if (hi == 0 || tmpl->attrs[hi - 1]->type < type) {
+        *pos = hi;
+        return FALSE;
+    }
+
+    while (lo < hi) {
+        mid = lo + (hi - lo) / 2;
+        if (tmpl->attrs[mid]->type < type)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    *pos = lo;
+    return lo < tmpl->count && tmpl->attrs[lo]->type == type;
+}
+
+/* template_reserve()
+ *
+ * make sure the attribute array can hold at least num attributes
+ */
+static CK_RV template_reserve(TEMPLATE *tmpl, CK_ULONG num)
+{
+    CK_ATTRIBUTE **attrs;
+    CK_ULONG alloc;
+
+    if (num <= tmpl->alloc)
+        return CKR_OK;
+
+    alloc = tmpl->alloc * 2;
+    if (alloc < 16)
+        alloc = 16;
+    if (alloc < num)
+        alloc = num;
+
+    attrs = realloc(tmpl->attrs, alloc * sizeof(CK_ATTRIBUTE *));
+    if (attrs == NULL) {
+        TRACE_ERROR("%s\n", ock_err(ERR_HOST_MEMORY));
+        return CKR_HOST_MEMORY;
+    }
+
+    tmpl->attrs = attrs;
+    tmpl->alloc = alloc;
+
+    return CKR_OK;
+}
+
+static void template_attribute_free(CK_ATTRIBUTE *attr)
+{
+    if (attr == NULL)
+        return;
+
+    if (is_attribute_attr_array(attr->type)) {
+        cleanse_and_free_attribute_array2((CK_ATTRIBUTE_PTR)attr->pValue,
+                                          attr->ulValueLen /
+                                                    sizeof(CK_ATTRIBUTE),
+                                          FALSE);
+    }
+    free(attr);
+}
+
 /* template_attribute_find()
  *
- * find the attribute in the list and return its value
+ * find the attribute in the template and return its value
  */
 CK_BBOOL template_attribute_find(TEMPLATE *tmpl, CK_ATTRIBUTE_TYPE type,
                                  CK_ATTRIBUTE **attr)
 {
-    DL_NODE *node = NULL;
-    CK_ATTRIBUTE *a = NULL;
+    CK_ULONG pos;
 
     if (!tmpl || !attr)
         return FALSE;
 
-    node = tmpl->attribute_list;
-
-    while (node != NULL) {
-        a = (CK_ATTRIBUTE *) node->data;
-
-        if (type == a->type) {
-            *attr = a;
-            return TRUE;
-        }
-
-        node = node->next;
+    if (template_attribute_search(tmpl, type, &pos)) {
+        *attr = tmpl->attrs[pos];
+        return TRUE;
     }
 
     *attr = NULL;
@@ -589,27 +654,26 @@ CK_BBOOL template_compare(CK_ATTRIBUTE *t1, CK_ULONG ulCount, TEMPLATE *t2)
 
 /* template_copy()
  *
- * This doesn't copy the template items verbatim.  The new template is in
- * the reverse order of the old one.  This should not have any effect.
- *
- * This is very similar to template_merge().  template_merge() can also
- * be used to copy a list (of unique attributes) but is slower because for
- * each attribute, it must search through the list.
+ * Copies all attributes of src into dest. Since src is sorted, the copies
+ * are appended to an empty dest in a single pass.
  */
 CK_RV template_copy(TEMPLATE *dest, TEMPLATE *src)
 {
     char unique_id_str[2 * UNIQUE_ID_LEN + 1];
-    DL_NODE *node, *list;
+    CK_ULONG i;
     CK_RV rc;
 
     if (!dest || !src) {
         TRACE_ERROR("Invalid function arguments.\n");
         return CKR_FUNCTION_FAILED;
     }
-    node = src->attribute_list;
 
-    while (node) {
-        CK_ATTRIBUTE *attr = (CK_ATTRIBUTE *) node->data;
+    rc = template_reserve(dest, dest->count + src->count);
+    if (rc != CKR_OK)
+        return rc;
+
+    for (i = 0; i < src->count; i++) {
+        CK_ATTRIBUTE *attr = src->attrs[i];
         CK_ATTRIBUTE *new_attr = NULL;
         CK_ULONG len;
 
@@ -654,19 +718,11 @@ CK_RV template_copy(TEMPLATE *dest, TEMPLATE *src)
             new_attr->ulValueLen = 2 * UNIQUE_ID_LEN;
         }
 
-        list = dlist_add_as_first(dest->attribute_list, new_attr);
-        if (list == NULL) {
-            if (is_attribute_attr_array(new_attr->type))
-                cleanse_and_free_attribute_array2(
-                                (CK_ATTRIBUTE_PTR)new_attr->pValue,
-                                new_attr->ulValueLen / sizeof(CK_ATTRIBUTE),
-                                FALSE);
-            free(new_attr);
-            TRACE_ERROR("%s\n", ock_err(ERR_HOST_MEMORY));
-            return CKR_HOST_MEMORY;
+        rc = template_update_attribute(dest, new_attr);
+        if (rc != CKR_OK) {
+            template_attribute_free(new_attr);
+            return rc;
         }
-        dest->attribute_list = list;
-        node = node->next;
     }
 
     return CKR_OK;
@@ -789,11 +845,11 @@ static CK_RV attribute_array_flatten(CK_ATTRIBUTE_PTR array_attr,
  */
 CK_RV template_flatten(TEMPLATE *tmpl, CK_BYTE *dest)
 {
-    DL_NODE *node = NULL;
     CK_BYTE *ptr = NULL;
     CK_ULONG_32 long_len = sizeof(CK_ULONG);
     CK_ATTRIBUTE_32 attr_32;
     CK_ULONG_32 Val_32;
+    CK_ULONG i;
     CK_RV rc;
 
     if (!tmpl || !dest) {
@@ -801,9 +857,8 @@ CK_RV template_flatten(TEMPLATE *tmpl, CK_BYTE *dest)
         return CKR_FUNCTION_FAILED;
     }
     ptr = dest;
-    node = tmpl->attribute_list;
-    while (node) {
-        CK_ATTRIBUTE *attr = (CK_ATTRIBUTE *) node->data;
+    for (i = 0; i < tmpl->count; i++) {
+        CK_ATTRIBUTE *attr = tmpl->attrs[i];
 
         if (is_attribute_attr_array(attr->type)) {
             rc = attribute_array_flatten(attr, &ptr);
@@ -812,7 +867,6 @@ CK_RV template_flatten(TEMPLATE *tmpl, CK_BYTE *dest)
                 return rc;
             }
 
-            node = node->next;
             continue;
         }
 
@@ -843,8 +897,6 @@ CK_RV template_flatten(TEMPLATE *tmpl, CK_BYTE *dest)
                 }
             }
         }
-
-        node = node->next;
     }
 
     return CKR_OK;
@@ -1011,6 +1063,12 @@ CK_RV template_unflatten_withSize(TEMPLATE **new_tmpl, CK_BYTE *buf,
     }
     memset(tmpl, 0x0, sizeof(TEMPLATE));
 
+    rc = template_reserve(tmpl, count);
+    if (rc != CKR_OK) {
+        free(tmpl);
+        return rc;
+    }
+
     ptr = buf;
     for (i = 0; i < count; i++) {
         if (long_len == 4) {
@@ -1202,26 +1260,15 @@ add_it:
 /* template_free() */
 CK_RV template_free(TEMPLATE *tmpl)
 {
+    CK_ULONG i;
+
     if (!tmpl)
         return CKR_OK;
 
-    while (tmpl->attribute_list) {
-        CK_ATTRIBUTE *attr = (CK_ATTRIBUTE *) tmpl->attribute_list->data;
-
-        if (attr) {
-            if (is_attribute_attr_array(attr->type)) {
-                cleanse_and_free_attribute_array2(
-                                    (CK_ATTRIBUTE_PTR)attr->pValue,
-                                    attr->ulValueLen / sizeof(CK_ATTRIBUTE),
-                                    FALSE);
-            }
-            free(attr);
-        }
-
-        tmpl->attribute_list = dlist_remove_node(tmpl->attribute_list,
-                                                 tmpl->attribute_list);
-    }
+    for (i = 0; i < tmpl->count; i++)
+        template_attribute_free(tmpl->attrs[i]);
 
+    free(tmpl->attrs);
     free(tmpl);
 
     return CKR_OK;
@@ -1231,40 +1278,31 @@ CK_RV template_free(TEMPLATE *tmpl)
 CK_BBOOL template_get_class(TEMPLATE *tmpl, CK_ULONG *class,
                             CK_ULONG *subclass)
 {
-    DL_NODE *node;
+    CK_ATTRIBUTE *attr;
     CK_BBOOL found = FALSE;
 
     if (!tmpl || !class || !subclass)
         return FALSE;
 
-    node = tmpl->attribute_list;
-
-    /* have to iterate through all attributes. no early exits */
-    while (node) {
-        CK_ATTRIBUTE *attr = (CK_ATTRIBUTE *) node->data;
-
-        if (attr->type == CKA_CLASS &&
-            attr->ulValueLen == sizeof(CK_OBJECT_CLASS) &&
-            attr->pValue != NULL) {
-            *class = *(CK_OBJECT_CLASS *) attr->pValue;
-            found = TRUE;
-        }
-
-        /* underneath, these guys are both CK_ULONG so we
-         * could combine this
-         */
-        if (attr->type == CKA_CERTIFICATE_TYPE &&
-            attr->ulValueLen == sizeof(CK_CERTIFICATE_TYPE) &&
-            attr->pValue != NULL)
-            *subclass = *(CK_CERTIFICATE_TYPE *) attr->pValue;
+    if (template_attribute_find(tmpl, CKA_CLASS, &attr) &&
+        attr->ulValueLen == sizeof(CK_OBJECT_CLASS) &&
+        attr->pValue != NULL) {
+        *class = *(CK_OBJECT_CLASS *) attr->pValue;
+        found = TRUE;
+    }
 
-        if (attr->type == CKA_KEY_TYPE &&
-            attr->ulValueLen == sizeof(CK_KEY_TYPE) &&
-            attr->pValue != NULL)
-            *subclass = *(CK_KEY_TYPE *) attr->pValue;
+    /* underneath, these guys are both CK_ULONG so we
+     * could combine this
+     */
+    if (template_attribute_find(tmpl, CKA_CERTIFICATE_TYPE, &attr) &&
+        attr->ulValueLen == sizeof(CK_CERTIFICATE_TYPE) &&
+        attr->pValue != NULL)
+        *subclass = *(CK_CERTIFICATE_TYPE *) attr->pValue;
 
-        node = node->next;
-    }
+    if (template_attribute_find(tmpl, CKA_KEY_TYPE, &attr) &&
+        attr->ulValueLen == sizeof(CK_KEY_TYPE) &&
+        attr->pValue != NULL)
+        *subclass = *(CK_KEY_TYPE *) attr->pValue;
 
     return found;
 }
@@ -1274,21 +1312,19 @@ CK_ULONG template_get_count(TEMPLATE *tmpl)
     if (tmpl == NULL)
         return 0;
 
-    return dlist_length(tmpl->attribute_list);
+    return tmpl->count;
 }
 
 CK_ULONG template_get_size(TEMPLATE *tmpl)
 {
-    DL_NODE *node;
-    CK_ULONG size = 0, i, num_attrs;
+    CK_ULONG size = 0, i, j, num_attrs;
     CK_ATTRIBUTE_PTR attrs;
 
     if (tmpl == NULL)
         return 0;
 
-    node = tmpl->attribute_list;
-    while (node) {
-        CK_ATTRIBUTE *attr = (CK_ATTRIBUTE *) node->data;
+    for (j = 0; j < tmpl->count; j++) {
+        CK_ATTRIBUTE *attr = tmpl->attrs[j];
 
         size += sizeof(CK_ATTRIBUTE) + attr->ulValueLen;
 
@@ -1298,8 +1334,6 @@ CK_ULONG template_get_size(TEMPLATE *tmpl)
             for (i = 0; i< num_attrs; i++)
                 size += sizeof(CK_ATTRIBUTE) + attrs[i].ulValueLen;
         }
-
-        node = node->next;
     }
 
     return size;
@@ -1328,19 +1362,13 @@ static CK_ULONG attribute_get_compressed_size(CK_ATTRIBUTE_PTR attr)
 
 CK_ULONG template_get_compressed_size(TEMPLATE *tmpl)
 {
-    DL_NODE *node;
-    CK_ULONG size = 0;
+    CK_ULONG size = 0, i;
 
     if (tmpl == NULL)
         return 0;
-    node = tmpl->attribute_list;
-    while (node) {
-        CK_ATTRIBUTE *attr = (CK_ATTRIBUTE *) node->data;
-
-        size += attribute_get_compressed_size(attr);
 
-        node = node->next;
-    }
+    for (i = 0; i < tmpl->count; i++)
+        size += attribute_get_compressed_size(tmpl->attrs[i]);
 
     return size;
 }
@@ -1436,32 +1464,56 @@ CK_BBOOL template_check_exportability(TEMPLATE *tmpl, CK_ATTRIBUTE_TYPE type)
  *
  * Merge two templates together:  dest = dest U src
  *
+ * Both attribute arrays are sorted, so they are merged in a single pass.
+ * Attributes in src replace attributes of the same type in dest.
  * src is destroyed in the process
  */
 CK_RV template_merge(TEMPLATE *dest, TEMPLATE **src)
 {
-    DL_NODE *node;
-    CK_RV rc;
+    CK_ATTRIBUTE **attrs;
+    CK_ULONG i = 0, j = 0, k = 0, num;
+    TEMPLATE *s;
 
     if (!dest || !src) {
         TRACE_ERROR("Invalid function arguments.\n");
         return CKR_FUNCTION_FAILED;
     }
-    node = (*src)->attribute_list;
+    s = *src;
 
-    while (node) {
-        CK_ATTRIBUTE *attr = (CK_ATTRIBUTE *) node->data;
+    num = dest->count + s->count;
+    if (num == 0)
+        goto done;
 
-        rc = template_update_attribute(dest, attr);
-        if (rc != CKR_OK) {
-            TRACE_DEVEL("template_update_attribute failed.\n");
-            return rc;
+    attrs = malloc(num * sizeof(CK_ATTRIBUTE *));
+    if (attrs == NULL) {
+        TRACE_ERROR("%s\n", ock_err(ERR_HOST_MEMORY));
+        return CKR_HOST_MEMORY;
+    }
+
+    while (i < dest->count && j < s->count) {
+        if (dest->attrs[i]->type < s->attrs[j]->type) {
+            attrs[k++] = dest->attrs[i++];
+        } else if (dest->attrs[i]->type > s->attrs[j]->type) {
+            attrs[k++] = s->attrs[j++];
+        } else {
+            template_attribute_free(dest->attrs[i++]);
+            attrs[k++] = s->attrs[j++];
         }
-        /* we've assigned the node's data to a node in 'dest' */
-        node->data = NULL;
-        node = node->next;
     }
+    while (i < dest->count)
+        attrs[k++] = dest->attrs[i++];
+    while (j < s->count)
+        attrs[k++] = s->attrs[j++];
+
+    free(dest->attrs);
+    dest->attrs = attrs;
+    dest->count = k;
+    dest->alloc = num;
 
+    /* we've assigned the attributes of 'src' to 'dest' */
+    s->count = 0;
+
+done:
     template_free(*src);
     *src = NULL;
 
@@ -1623,46 +1675,35 @@ error:
  */
 CK_RV template_update_attribute(TEMPLATE *tmpl, CK_ATTRIBUTE *new_attr)
 {
-    DL_NODE *node = NULL, *list;
-    CK_ATTRIBUTE *attr = NULL;
+    CK_ULONG pos;
+    CK_RV rc;
 
     if (!tmpl || !new_attr) {
         TRACE_ERROR("Invalid function arguments.\n");
         return CKR_ARGUMENTS_BAD;
     }
-    node = tmpl->attribute_list;
 
-    /* if the attribute already exists in the list, remove it.
+    /* if the attribute already exists in the template, replace it.
      * this algorithm will limit an attribute to appearing at most
-     * once in the list
+     * once in the template
      */
-    while (node != NULL) {
-        attr = (CK_ATTRIBUTE *) node->data;
-
-        if (new_attr->type == attr->type) {
-            if (is_attribute_attr_array(attr->type)) {
-                 cleanse_and_free_attribute_array2(
-                                     (CK_ATTRIBUTE_PTR)attr->pValue,
-                                     attr->ulValueLen / sizeof(CK_ATTRIBUTE),
-                                     FALSE);
-            }
-            free(attr);
-            tmpl->attribute_list =
-                dlist_remove_node(tmpl->attribute_list, node);
-            break;
-        }
-
-        node = node->next;
+    if (template_attribute_search(tmpl, new_attr->type, &pos)) {
+        template_attribute_free(tmpl->attrs[pos]);
+        tmpl->attrs[pos] = new_attr;
+        return CKR_OK;
     }
 
-    /* add the new attribute */
-    list = dlist_add_as_first(tmpl->attribute_list, new_attr);
-    if (list == NULL) {
-        TRACE_ERROR("%s\n", ock_err(ERR_HOST_MEMORY));
-        return CKR_HOST_MEMORY;
-    }
+    /* insert the new attribute */
+    rc = template_reserve(tmpl, tmpl->count + 1);
+    if (rc != CKR_OK)
+        return rc;
+
+    if (pos < tmpl->count)
+        memmove(&tmpl->attrs[pos + 1], &tmpl->attrs[pos],
+                (tmpl->count - pos) * sizeof(CK_ATTRIBUTE *));
+    tmpl->attrs[pos] = new_attr;
+    tmpl->count++;
 
-    tmpl->attribute_list = list;
     return CKR_OK;
 }
 
@@ -1806,13 +1847,11 @@ CK_RV template_validate_attributes(STDLL_TokData_t *tokdata, TEMPLATE *tmpl,
                                    CK_ULONG class, CK_ULONG subclass,
                                    CK_ULONG mode)
 {
-    DL_NODE *node;
+    CK_ULONG i;
     CK_RV rc = CKR_OK;
 
-    node = tmpl->attribute_list;
-
-    while (node) {
-        CK_ATTRIBUTE *attr = (CK_ATTRIBUTE *) node->data;
+    for (i = 0; i < tmpl->count; i++) {
+        CK_ATTRIBUTE *attr = tmpl->attrs[i];
 
         rc = template_validate_attribute(tokdata, tmpl, attr, class,
                                          subclass, mode);
@@ -1820,7 +1859,6 @@ CK_RV template_validate_attributes(STDLL_TokData_t *tokdata, TEMPLATE *tmpl,
             TRACE_DEVEL("template_validate_attribute failed.\n");
             return rc;
         }
-        node = node->next;
     }
 
     return CKR_OK;
@@ -1931,14 +1969,9 @@ CK_RV template_validate_base_attribute(TEMPLATE *tmpl, CK_ATTRIBUTE *attr,
 /* Debug function: dump list of attribues from a template */
 void dump_template(TEMPLATE *tmpl)
 {
-    DL_NODE *node = NULL;
-    CK_ATTRIBUTE *a = NULL;
-
-    node = tmpl->attribute_list;
-    while (node) {
-        a = (CK_ATTRIBUTE *) node->data;
-	TRACE_DEBUG_DUMPATTR(a);
-        node = node->next;
-    }
+    CK_ULONG i;
+
+    for (i = 0; i < tmpl->count; i++)
+	TRACE_DEBUG_DUMPATTR(tmpl->attrs[i]);
 }
 #endif
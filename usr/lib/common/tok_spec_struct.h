@@ -282,6 +282,20 @@ struct token_specific_struct {
     CK_RV(*t_handle_event) (STDLL_TokData_t *tokdata, unsigned int event_type,
                             unsigned int event_flags, const char *payload,
                             unsigned int payload_len);
+
+    // Token Specific message based AES-GCM functions
+    CK_RV(*t_aes_gcm_msg_init) (STDLL_TokData_t *, SESSION *,
+                                ENCR_DECR_CONTEXT *, CK_MECHANISM *,
+                                CK_OBJECT_HANDLE, CK_BYTE);
+
+    CK_RV(*t_aes_gcm_msg_begin) (STDLL_TokData_t *, SESSION *,
+                                 ENCR_DECR_CONTEXT *, CK_GCM_MESSAGE_PARAMS *,
+                                 CK_BYTE *, CK_ULONG, CK_BYTE);
+
+    CK_RV(*t_aes_gcm_msg_next) (STDLL_TokData_t *, SESSION *,
+                                ENCR_DECR_CONTEXT *, CK_GCM_MESSAGE_PARAMS *,
+                                CK_BYTE *, CK_ULONG, CK_BYTE *, CK_ULONG *,
+                                CK_FLAGS, CK_BYTE);
 };
 
 typedef struct token_specific_struct token_spec_t;
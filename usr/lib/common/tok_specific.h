@@ -270,6 +270,21 @@ CK_RV token_specific_aes_gcm_final(STDLL_TokData_t *, SESSION *,
                                    ENCR_DECR_CONTEXT *, CK_BYTE *,
                                    CK_ULONG *, CK_BYTE);
 
+CK_RV token_specific_aes_gcm_msg_init(STDLL_TokData_t *, SESSION *,
+                                      ENCR_DECR_CONTEXT *, CK_MECHANISM *,
+                                      CK_OBJECT_HANDLE, CK_BYTE);
+
+CK_RV token_specific_aes_gcm_msg_begin(STDLL_TokData_t *, SESSION *,
+                                       ENCR_DECR_CONTEXT *,
+                                       CK_GCM_MESSAGE_PARAMS *,
+                                       CK_BYTE *, CK_ULONG, CK_BYTE);
+
+CK_RV token_specific_aes_gcm_msg_next(STDLL_TokData_t *, SESSION *,
+                                      ENCR_DECR_CONTEXT *,
+                                      CK_GCM_MESSAGE_PARAMS *,
+                                      CK_BYTE *, CK_ULONG, CK_BYTE *,
+                                      CK_ULONG *, CK_FLAGS, CK_BYTE);
+
 CK_RV token_specific_aes_ofb(STDLL_TokData_t *,
                              CK_BYTE *,
                              CK_ULONG, CK_BYTE *, OBJECT *, CK_BYTE *, uint_32);
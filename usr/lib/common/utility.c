@@ -8,6 +8,7 @@
  * https://opensource.org/licenses/cpl1.0.php
  */
 
+#define _GNU_SOURCE
 #include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -23,6 +24,9 @@
 #include <grp.h>
 #include <pthread.h>
 #include <openssl/evp.h>
+#include <openssl/crypto.h>
+#include <sys/syscall.h>
+#include <linux/keyctl.h>
 
 #include "pkcs11types.h"
 #include "defs.h"
@@ -203,6 +207,8 @@ CK_RV XProcLock(STDLL_TokData_t *tokdata)
 
 CK_RV XProcUnLock(STDLL_TokData_t *tokdata)
 {
+    CK_BBOOL released;
+
     if (tokdata->spinxplfd < 0)  {
         TRACE_DEVEL("No file descriptor to unlock with.\n");
         return CKR_CANT_LOCK;
@@ -219,10 +225,15 @@ CK_RV XProcUnLock(STDLL_TokData_t *tokdata)
         }
     }
     tokdata->spinxplfd_count--;
+    released = (tokdata->spinxplfd_count == 0);
 
     if (XThreadUnLock(tokdata) != CKR_OK)
         return CKR_CANT_LOCK;
 
+    /* make token object changes durable, outside of the lock */
+    if (released)
+        sync_token_objects(tokdata);
+
     return CKR_OK;
 }
 
@@ -351,7 +362,7 @@ CK_RV init_token_data(STDLL_TokData_t *tokdata, CK_SLOT_ID slot_id)
         dat->version = tokdata->version;
 
         /* SO login key */
-        dat->so_login_it = SO_KDF_LOGIN_IT;
+        dat->so_login_it = pbkdf2_iterations(tokdata, SO_KDF_LOGIN_IT);
         memcpy(dat->so_login_salt, SO_KDF_LOGIN_PURPOSE, 32);
         rng_generate(tokdata, dat->so_login_salt + 32, 32);
 
@@ -366,7 +377,7 @@ CK_RV init_token_data(STDLL_TokData_t *tokdata, CK_SLOT_ID slot_id)
         }
 
         /* SO wrap key */
-        dat->so_wrap_it = SO_KDF_WRAP_IT;
+        dat->so_wrap_it = pbkdf2_iterations(tokdata, SO_KDF_WRAP_IT);
         memcpy(dat->so_wrap_salt, SO_KDF_WRAP_PURPOSE, 32);
         rng_generate(tokdata, dat->so_wrap_salt + 32, 32);
 
@@ -381,7 +392,8 @@ CK_RV init_token_data(STDLL_TokData_t *tokdata, CK_SLOT_ID slot_id)
         }
 
         /* User login key */
-        dat->user_login_it = USER_KDF_LOGIN_IT;
+        dat->user_login_it = pbkdf2_iterations(tokdata,
+                                               USER_KDF_LOGIN_IT);
         memcpy(dat->user_login_salt, USER_KDF_LOGIN_PURPOSE, 32);
         rng_generate(tokdata, dat->user_login_salt + 32, 32);
 
@@ -396,7 +408,7 @@ CK_RV init_token_data(STDLL_TokData_t *tokdata, CK_SLOT_ID slot_id)
         }
 
         /* User wrap key */
-        dat->user_wrap_it = USER_KDF_WRAP_IT;
+        dat->user_wrap_it = pbkdf2_iterations(tokdata, USER_KDF_WRAP_IT);
         memcpy(dat->user_wrap_salt, USER_KDF_WRAP_PURPOSE, 32);
         rng_generate(tokdata, dat->user_wrap_salt + 32, 32);
 
@@ -605,13 +617,23 @@ CK_RV attach_shm(STDLL_TokData_t *tokdata, CK_SLOT_ID slot_id)
         rc = CKR_FUNCTION_FAILED;
         goto err;
     }
-    ret = sm_open(buf, 0660, (void **) shm, sizeof(**shm), 0);
+    ret = sm_open(buf, 0660, (void **) shm,
+                  object_mgr_shm_size(sizeof(**shm), TOK_OBJ_MIN_CAPACITY),
+                  object_mgr_shm_size(sizeof(**shm), TOK_OBJ_MAX_CAPACITY), 0);
     if (ret < 0) {
         TRACE_DEVEL("sm_open failed.\n");
         rc = CKR_FUNCTION_FAILED;
         goto err;
     }
 
+    rc = object_mgr_shm_init(*shm, sizeof(**shm), ret == 0);
+    if (rc != CKR_OK) {
+        TRACE_DEVEL("object_mgr_shm_init failed.\n");
+        sm_close(*shm, 0, 0);
+        *shm = NULL;
+        goto err;
+    }
+
     return XProcUnLock(tokdata);
 
 err:
@@ -805,6 +827,258 @@ CK_RV compute_PKCS5_PBKDF2_HMAC(STDLL_TokData_t *tokdata,
 
 
 
+/*
+ * Returns the PBKDF2 iteration count to use for a new PIN: the slot's
+ * pbkdf2_iterations from opencryptoki.conf, or the built-in default. The
+ * count is stored with the token data, so PINs set before a change of the
+ * configuration keep working.
+ */
+uint64_t pbkdf2_iterations(STDLL_TokData_t *tokdata, uint64_t default_it)
+{
+    return tokdata->pbkdf2_it != 0 ? tokdata->pbkdf2_it : default_it;
+}
+
+/*
+ * Login key cache (login_cache_ttl in opencryptoki.conf).
+ *
+ * After a successful login, the login and wrap keys derived from the PIN are
+ * put into the user's kernel keyring for login_cache_ttl seconds. Other
+ * processes of the same user then log in to the token without running
+ * PBKDF2 again. The keyring entry is only accessible for the user itself.
+ *
+ * The description of an entry names the token's data store, the user type
+ * and the current login salt. Setting a PIN generates new salts, so that an
+ * entry is never used for a PIN it was not derived from. Besides the keys, an
+ * entry holds a SHA-256 hash of the salts and the PIN. A PIN that does not
+ * match it is checked by PBKDF2 as usual.
+ */
+#define LOGIN_CACHE_KEY_TYPE    "user"
+#define LOGIN_CACHE_KEY_PERM    0x3f3f0000  /* possessor and user: all */
+
+struct login_cache_entry {
+    unsigned char pin_hash[32];
+    unsigned char login_key[32];
+    unsigned char wrap_key[32];
+};
+
+static long login_cache_keyctl(int cmd, unsigned long arg2, unsigned long arg3,
+                               unsigned long arg4, unsigned long arg5)
+{
+    return syscall(__NR_keyctl, cmd, arg2, arg3, arg4, arg5);
+}
+
+static int login_cache_desc(STDLL_TokData_t *tokdata, CK_USER_TYPE userType,
+                            char *desc, size_t len)
+{
+    TOKEN_DATA_VERSION *dat = &tokdata->nv_token_data->dat;
+    const unsigned char *salt;
+    char hex[2 * 16 + 1];
+    int i, n;
+
+    salt = (userType == CKU_SO) ? dat->so_login_salt : dat->user_login_salt;
+    /* the first 32 bytes of the salt are a constant purpose string */
+    for (i = 0; i < 16; i++)
+        sprintf(hex + 2 * i, "%02x", salt[32 + i]);
+
+    n = snprintf(desc, len, "opencryptoki:%s:%s:%s", tokdata->data_store,
+                 userType == CKU_SO ? "so" : "user", hex);
+
+    return (n < 0 || (size_t)n >= len) ? -1 : 0;
+}
+
+static CK_RV login_cache_pin_hash(STDLL_TokData_t *tokdata,
+                                  CK_USER_TYPE userType,
+                                  CK_CHAR *pPin, CK_ULONG ulPinLen,
+                                  unsigned char *hash)
+{
+    TOKEN_DATA_VERSION *dat = &tokdata->nv_token_data->dat;
+    EVP_MD_CTX *ctx;
+    unsigned int len = 32;
+    CK_RV rc = CKR_OK;
+
+    ctx = EVP_MD_CTX_new();
+    if (ctx == NULL)
+        return CKR_HOST_MEMORY;
+
+    if (EVP_DigestInit_ex(ctx, EVP_sha256(), NULL) != 1 ||
+        EVP_DigestUpdate(ctx, userType == CKU_SO ? dat->so_login_salt :
+                                                   dat->user_login_salt,
+                         64) != 1 ||
+        EVP_DigestUpdate(ctx, userType == CKU_SO ? dat->so_wrap_salt :
+                                                   dat->user_wrap_salt,
+                         64) != 1 ||
+        EVP_DigestUpdate(ctx, pPin, ulPinLen) != 1 ||
+        EVP_DigestFinal_ex(ctx, hash, &len) != 1) {
+        TRACE_DEVEL("SHA-256 of the PIN failed.\n");
+        rc = CKR_FUNCTION_FAILED;
+    }
+
+    EVP_MD_CTX_free(ctx);
+
+    return rc;
+}
+
+static long login_cache_search(STDLL_TokData_t *tokdata,
+                               CK_USER_TYPE userType)
+{
+    char desc[512];
+
+    if (login_cache_desc(tokdata, userType, desc, sizeof(desc)) != 0)
+        return -1;
+
+    return login_cache_keyctl(KEYCTL_SEARCH, KEY_SPEC_USER_KEYRING,
+                              (unsigned long)LOGIN_CACHE_KEY_TYPE,
+                              (unsigned long)desc, 0);
+}
+
+/*
+ * Looks up the login and wrap keys of the PIN in the login key cache.
+ * Returns TRUE if they were found.
+ */
+static CK_BBOOL login_cache_get(STDLL_TokData_t *tokdata,
+                                CK_USER_TYPE userType,
+                                CK_CHAR *pPin, CK_ULONG ulPinLen,
+                                unsigned char *login_key,
+                                unsigned char *wrap_key)
+{
+    struct login_cache_entry entry;
+    unsigned char pin_hash[32];
+    CK_BBOOL found = FALSE;
+    long serial, len;
+
+    if (tokdata->login_cache_ttl == 0)
+        return FALSE;
+
+    serial = login_cache_search(tokdata, userType);
+    if (serial < 0)
+        return FALSE;
+
+    len = login_cache_keyctl(KEYCTL_READ, serial, (unsigned long)&entry,
+                             sizeof(entry), 0);
+    if (len != sizeof(entry))
+        goto out;
+
+    if (login_cache_pin_hash(tokdata, userType, pPin, ulPinLen,
+                             pin_hash) != CKR_OK)
+        goto out;
+
+    if (CRYPTO_memcmp(entry.pin_hash, pin_hash, sizeof(pin_hash)) != 0)
+        goto out;
+
+    memcpy(login_key, entry.login_key, sizeof(entry.login_key));
+    memcpy(wrap_key, entry.wrap_key, sizeof(entry.wrap_key));
+    found = TRUE;
+
+    TRACE_DEVEL("Login keys taken from the login key cache.\n");
+
+out:
+    OPENSSL_cleanse(&entry, sizeof(entry));
+
+    return found;
+}
+
+/*
+ * Puts the login and wrap keys of a PIN that has just been verified into the
+ * login key cache. Failures are not fatal, the next login derives the keys
+ * again.
+ */
+void login_cache_put(STDLL_TokData_t *tokdata, CK_USER_TYPE userType,
+                     CK_CHAR *pPin, CK_ULONG ulPinLen,
+                     unsigned char *login_key, unsigned char *wrap_key)
+{
+    struct login_cache_entry entry;
+    char desc[512];
+    long serial;
+
+    if (tokdata->login_cache_ttl == 0)
+        return;
+
+    if (login_cache_desc(tokdata, userType, desc, sizeof(desc)) != 0)
+        return;
+
+    if (login_cache_pin_hash(tokdata, userType, pPin, ulPinLen,
+                             entry.pin_hash) != CKR_OK)
+        return;
+    memcpy(entry.login_key, login_key, sizeof(entry.login_key));
+    memcpy(entry.wrap_key, wrap_key, sizeof(entry.wrap_key));
+
+    serial = syscall(__NR_add_key, LOGIN_CACHE_KEY_TYPE, desc, &entry,
+                     sizeof(entry), KEY_SPEC_USER_KEYRING);
+    OPENSSL_cleanse(&entry, sizeof(entry));
+    if (serial < 0) {
+        TRACE_DEVEL("add_key failed: %s\n", strerror(errno));
+        return;
+    }
+
+    if (login_cache_keyctl(KEYCTL_SETPERM, serial, LOGIN_CACHE_KEY_PERM,
+                           0, 0) < 0 ||
+        login_cache_keyctl(KEYCTL_SET_TIMEOUT, serial,
+                           tokdata->login_cache_ttl, 0, 0) < 0) {
+        TRACE_DEVEL("keyctl failed: %s\n", strerror(errno));
+        login_cache_keyctl(KEYCTL_INVALIDATE, serial, 0, 0, 0);
+    }
+}
+
+/*
+ * Removes the login key cache entry of the current PIN of a user type, before
+ * that PIN is changed.
+ */
+void login_cache_remove(STDLL_TokData_t *tokdata, CK_USER_TYPE userType)
+{
+    long serial;
+
+    if (tokdata->login_cache_ttl == 0)
+        return;
+
+    serial = login_cache_search(tokdata, userType);
+    if (serial >= 0)
+        login_cache_keyctl(KEYCTL_INVALIDATE, serial, 0, 0, 0);
+}
+
+/*
+ * Derives the login and wrap keys of a PIN at login, or takes them from the
+ * login key cache. *cached tells the caller which one happened.
+ */
+CK_RV compute_login_keys(STDLL_TokData_t *tokdata, CK_USER_TYPE userType,
+                         CK_CHAR *pPin, CK_ULONG ulPinLen,
+                         unsigned char *login_key, unsigned char *wrap_key,
+                         CK_BBOOL *cached)
+{
+    TOKEN_DATA_VERSION *dat = &tokdata->nv_token_data->dat;
+    CK_RV rc;
+
+    *cached = login_cache_get(tokdata, userType, pPin, ulPinLen,
+                              login_key, wrap_key);
+    if (*cached)
+        return CKR_OK;
+
+    rc = compute_PKCS5_PBKDF2_HMAC(tokdata, pPin, ulPinLen,
+                                   userType == CKU_SO ? dat->so_login_salt :
+                                                        dat->user_login_salt,
+                                   64,
+                                   userType == CKU_SO ? dat->so_login_it :
+                                                        dat->user_login_it,
+                                   EVP_sha512(), 256 / 8, login_key);
+    if (rc != CKR_OK) {
+        TRACE_DEVEL("PBKDF2 failed.\n");
+        return rc;
+    }
+
+    rc = compute_PKCS5_PBKDF2_HMAC(tokdata, pPin, ulPinLen,
+                                   userType == CKU_SO ? dat->so_wrap_salt :
+                                                        dat->user_wrap_salt,
+                                   64,
+                                   userType == CKU_SO ? dat->so_wrap_it :
+                                                        dat->user_wrap_it,
+                                   EVP_sha512(), 256 / 8, wrap_key);
+    if (rc != CKR_OK) {
+        TRACE_DEVEL("PBKDF2 failed.\n");
+        return rc;
+    }
+
+    return CKR_OK;
+}
+
 CK_RV get_keytype(STDLL_TokData_t *tokdata, CK_OBJECT_HANDLE hkey,
                   CK_KEY_TYPE *keytype)
 {
@@ -24,9 +24,11 @@
 #include "h_extern.h"
 #include "tok_spec_struct.h"
 #include "trace.h"
+#include "worker_pool.h"
 
 #include "../api/policy.h"
 #include "../api/statistics.h"
+#include "../api/hashmap.h"
 
 //
 //
@@ -1231,3 +1233,212 @@ CK_RV verify_mgr_verify_recover(STDLL_TokData_t *tokdata,
 
     return CKR_FUNCTION_FAILED;
 }
+
+
+struct verify_batch_key {
+    OBJECT *key_obj;            /* read locked while the batch runs */
+    CK_ULONG sig_len;           /* maximum signature length of the key */
+    CK_RV rc;
+};
+
+struct verify_batch {
+    STDLL_TokData_t *tokdata;
+    SESSION *sess;
+    CK_MECHANISM *mech;
+    CK_MECHANISM digest_mech;   /* CKM_ECDSA_SHAxxx only */
+    CK_IBM_VERIFY_DATA *items;
+    struct verify_batch_key *keys;
+    CK_ULONG *key_idx;          /* index into keys for each item */
+    CK_RV *results;
+};
+
+static void verify_batch_item(void *private, CK_ULONG i)
+{
+    struct verify_batch *batch = private;
+    struct verify_batch_key *key = &batch->keys[batch->key_idx[i]];
+    CK_IBM_VERIFY_DATA *item = &batch->items[i];
+    CK_BYTE hash[MAX_SHA_HASH_SIZE];
+    CK_BYTE *data = item->pData;
+    CK_ULONG data_len = item->ulDataLen;
+    DIGEST_CONTEXT digest_ctx;
+    CK_RV rc;
+
+    if (key->rc != CKR_OK) {
+        batch->results[i] = key->rc;
+        return;
+    }
+
+    INC_COUNTER(batch->tokdata, batch->sess, batch->mech, key->key_obj,
+                POLICY_STRENGTH_IDX_0);
+
+    if (item->ulSignatureLen > key->sig_len) {
+        TRACE_ERROR("%s\n", ock_err(ERR_SIGNATURE_LEN_RANGE));
+        batch->results[i] = CKR_SIGNATURE_LEN_RANGE;
+        return;
+    }
+
+    if (batch->mech->mechanism != CKM_ECDSA) {
+        memset(&digest_ctx, 0, sizeof(digest_ctx));
+        rc = digest_mgr_init(batch->tokdata, batch->sess, &digest_ctx,
+                             &batch->digest_mech, FALSE);
+        if (rc != CKR_OK) {
+            TRACE_DEVEL("Digest Mgr Init failed.\n");
+            batch->results[i] = rc;
+            return;
+        }
+
+        data_len = sizeof(hash);
+        rc = digest_mgr_digest(batch->tokdata, batch->sess, FALSE,
+                               &digest_ctx, item->pData, item->ulDataLen,
+                               hash, &data_len);
+        if (rc != CKR_OK) {
+            TRACE_DEVEL("Digest Mgr Digest failed.\n");
+            digest_mgr_cleanup(batch->tokdata, batch->sess, &digest_ctx);
+            batch->results[i] = rc;
+            return;
+        }
+        data = hash;
+    }
+
+    batch->results[i] = ckm_ec_verify(batch->tokdata, batch->sess, data,
+                                      data_len, item->pSignature,
+                                      item->ulSignatureLen, key->key_obj);
+}
+
+/*
+ * Checks the key of an item the way C_VerifyInit does, and keeps the key
+ * object read locked for the verify operations of all items using it.
+ */
+static void verify_batch_resolve_key(STDLL_TokData_t *tokdata, SESSION *sess,
+                                     CK_MECHANISM *mech,
+                                     CK_OBJECT_HANDLE handle,
+                                     struct verify_batch_key *key,
+                                     CK_BBOOL checkpolicy)
+{
+    SIGN_VERIFY_CONTEXT ctx;
+
+    memset(&ctx, 0, sizeof(ctx));
+    key->rc = verify_mgr_init(tokdata, sess, &ctx, mech, FALSE, handle,
+                              checkpolicy);
+    verify_mgr_cleanup(tokdata, sess, &ctx);
+    if (key->rc != CKR_OK)
+        return;
+
+    key->rc = object_mgr_find_in_map1(tokdata, handle, &key->key_obj,
+                                      READ_LOCK);
+    if (key->rc != CKR_OK) {
+        TRACE_ERROR("Failed to acquire key from specified handle.\n");
+        if (key->rc == CKR_OBJECT_HANDLE_INVALID)
+            key->rc = CKR_KEY_HANDLE_INVALID;
+        key->key_obj = NULL;
+        return;
+    }
+
+    key->rc = get_ecsiglen(key->key_obj, &key->sig_len);
+    if (key->rc != CKR_OK)
+        TRACE_DEVEL("get_ecsiglen failed.\n");
+}
+
+//
+// Verifies independent signatures made with the same mechanism. Every key is
+// checked and looked up only once, no matter how many items use it. The
+// verify operations of the items are spread over the token's worker threads.
+// The result of each item is returned in results, the return value is only
+// an error if the batch could not be processed at all.
+//
+// Only ECDSA is supported. Its verify functions keep no state in the session
+// or the context, so several items of a session can be verified at the same
+// time.
+//
+CK_RV verify_mgr_verify_batch(STDLL_TokData_t *tokdata,
+                              SESSION *sess, CK_MECHANISM *mech,
+                              CK_IBM_VERIFY_DATA *items, CK_ULONG count,
+                              CK_RV *results, CK_BBOOL checkpolicy)
+{
+    struct verify_batch batch;
+    struct hashmap *key_map = NULL;
+    union hashmap_value val;
+    CK_ULONG i, num_keys = 0;
+    CK_RV rc;
+
+    memset(&batch, 0, sizeof(batch));
+
+    switch (mech->mechanism) {
+    case CKM_ECDSA:
+        break;
+    case CKM_ECDSA_SHA1:
+        batch.digest_mech.mechanism = CKM_SHA_1;
+        break;
+    case CKM_ECDSA_SHA224:
+        batch.digest_mech.mechanism = CKM_SHA224;
+        break;
+    case CKM_ECDSA_SHA256:
+        batch.digest_mech.mechanism = CKM_SHA256;
+        break;
+    case CKM_ECDSA_SHA384:
+        batch.digest_mech.mechanism = CKM_SHA384;
+        break;
+    case CKM_ECDSA_SHA512:
+        batch.digest_mech.mechanism = CKM_SHA512;
+        break;
+    default:
+        TRACE_ERROR("%s\n", ock_err(ERR_MECHANISM_INVALID));
+        return CKR_MECHANISM_INVALID;
+    }
+    if (mech->ulParameterLen != 0) {
+        TRACE_ERROR("%s\n", ock_err(ERR_MECHANISM_PARAM_INVALID));
+        return CKR_MECHANISM_PARAM_INVALID;
+    }
+
+    batch.tokdata = tokdata;
+    batch.sess = sess;
+    batch.mech = mech;
+    batch.items = items;
+    batch.results = results;
+    batch.keys = calloc(count, sizeof(*batch.keys));
+    batch.key_idx = calloc(count, sizeof(*batch.key_idx));
+    key_map = hashmap_new();
+    if (batch.keys == NULL || batch.key_idx == NULL || key_map == NULL) {
+        TRACE_ERROR("%s\n", ock_err(ERR_HOST_MEMORY));
+        rc = CKR_HOST_MEMORY;
+        goto done;
+    }
+
+    for (i = 0; i < count; i++) {
+        /* The hashmap can not store a key of (CK_ULONG)-1 */
+        if (items[i].hKey != (CK_OBJECT_HANDLE)-1 &&
+            hashmap_find(key_map, items[i].hKey, &val)) {
+            batch.key_idx[i] = val.ulVal;
+            continue;
+        }
+
+        batch.key_idx[i] = num_keys;
+        verify_batch_resolve_key(tokdata, sess, mech, items[i].hKey,
+                                 &batch.keys[num_keys], checkpolicy);
+        num_keys++;
+
+        if (items[i].hKey == (CK_OBJECT_HANDLE)-1)
+            continue;
+        val.ulVal = batch.key_idx[i];
+        if (hashmap_add(key_map, items[i].hKey, val, NULL)) {
+            TRACE_ERROR("%s\n", ock_err(ERR_HOST_MEMORY));
+            rc = CKR_HOST_MEMORY;
+            goto done;
+        }
+    }
+
+    rc = worker_pool_for_each(tokdata->workers, count, verify_batch_item,
+                              &batch);
+
+done:
+    for (i = 0; i < num_keys; i++) {
+        if (batch.keys[i].key_obj != NULL)
+            object_put(tokdata, batch.keys[i].key_obj, TRUE);
+    }
+    if (key_map != NULL)
+        hashmap_free(key_map, NULL);
+    free(batch.keys);
+    free(batch.key_idx);
+
+    return rc;
+}
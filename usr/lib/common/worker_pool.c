@@ -0,0 +1,405 @@
+/*
+ * COPYRIGHT (c) International Business Machines Corp. 2024
+ *
+ * This program is provided under the terms of the Common Public License,
+ * version 1.0 (CPL-1.0). Any use, reproduction or distribution for this
+ * software constitutes recipient's acceptance of CPL-1.0 terms which can be
+ * found in the file LICENSE file or at
+ * https://opensource.org/licenses/cpl1.0.php
+ */
+
+/*
+ * worker_pool.c
+ *
+ * Worker threads of a token, used to spread independent operations of one
+ * PKCS#11 call over several CPUs.
+ *
+ * A pool starts with no threads. A new thread is started whenever a job is
+ * submitted while no thread is idle, up to one thread per online CPU (at most
+ * WORKER_POOL_MAX_THREADS). The threads block all signals, so that signal
+ * handlers of the application never run on them, and use opencryptoki's
+ * OpenSSL library context, see worker_thread_create().
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <unistd.h>
+#include <errno.h>
+#include <pthread.h>
+
+#include "pkcs11types.h"
+#include "defs.h"
+#include "host_defs.h"
+#include "h_extern.h"
+#include "trace.h"
+#include "worker_pool.h"
+
+struct worker_job {
+    struct worker_job *next;
+    worker_func_t func;
+    void *private;
+};
+
+struct worker_pool {
+    STDLL_TokData_t *tokdata;
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    struct worker_job *head;
+    struct worker_job *tail;
+    CK_BBOOL stop;
+    unsigned int max_threads;
+    unsigned int num_threads;
+    unsigned int idle;              /* threads waiting for a job */
+    pthread_t threads[WORKER_POOL_MAX_THREADS];
+};
+
+/*
+ * State of one worker_pool_for_each() call. The calling thread and every
+ * helper job hold a reference, the last one frees it.
+ */
+struct worker_batch {
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    worker_index_func_t func;
+    void *private;
+    CK_ULONG count;
+    CK_ULONG next;                  /* next index to process */
+    CK_ULONG done;                  /* number of processed indexes */
+    unsigned int refs;
+};
+
+/*
+ * Start of a thread created by worker_thread_create(). The creating thread
+ * waits until the new thread has set up its library context.
+ */
+struct worker_start {
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    STDLL_TokData_t *tokdata;
+    void *(*func)(void *);
+    void *arg;
+    CK_BBOOL done;
+    int rc;
+};
+
+static void *worker_start_thread(void *arg)
+{
+    struct worker_start *start = arg;
+    void *(*func)(void *) = start->func;
+    void *func_arg = start->arg;
+    int rc = 0;
+
+#if OPENSSL_VERSION_PREREQ(3, 0)
+    /*
+     * Threads inherit OpenSSL's global default library context, not the one
+     * that the API layer sets for the calling threads.
+     */
+    if (start->tokdata != NULL && start->tokdata->openssl_libctx != NULL &&
+        OSSL_LIB_CTX_set0_default(start->tokdata->openssl_libctx) == NULL) {
+        TRACE_ERROR("OSSL_LIB_CTX_set0_default failed\n");
+        rc = EINVAL;
+    }
+#endif
+
+    /* start is on the creating thread's stack, do not use it afterwards */
+    pthread_mutex_lock(&start->mutex);
+    start->rc = rc;
+    start->done = TRUE;
+    pthread_cond_signal(&start->cond);
+    pthread_mutex_unlock(&start->mutex);
+
+    if (rc != 0)
+        return NULL;
+
+    return func(func_arg);
+}
+
+int worker_thread_create(STDLL_TokData_t *tokdata, pthread_t *thread,
+                         void *(*func)(void *), void *arg)
+{
+    struct worker_start start;
+    sigset_t all, old;
+    int rc;
+
+    memset(&start, 0, sizeof(start));
+    pthread_mutex_init(&start.mutex, NULL);
+    pthread_cond_init(&start.cond, NULL);
+    start.tokdata = tokdata;
+    start.func = func;
+    start.arg = arg;
+
+    /* The new thread inherits the signal mask */
+    sigfillset(&all);
+    pthread_sigmask(SIG_SETMASK, &all, &old);
+    rc = pthread_create(thread, NULL, worker_start_thread, &start);
+    pthread_sigmask(SIG_SETMASK, &old, NULL);
+
+    if (rc == 0) {
+        pthread_mutex_lock(&start.mutex);
+        while (!start.done)
+            pthread_cond_wait(&start.cond, &start.mutex);
+        pthread_mutex_unlock(&start.mutex);
+
+        rc = start.rc;
+        if (rc != 0)
+            pthread_join(*thread, NULL);
+    }
+
+    pthread_cond_destroy(&start.cond);
+    pthread_mutex_destroy(&start.mutex);
+
+    return rc;
+}
+
+static void *worker_thread(void *arg)
+{
+    struct worker_pool *pool = arg;
+    struct worker_job *job;
+
+    pthread_mutex_lock(&pool->mutex);
+    for (;;) {
+        while (pool->head == NULL && !pool->stop) {
+            pool->idle++;
+            pthread_cond_wait(&pool->cond, &pool->mutex);
+            pool->idle--;
+        }
+        /* Queued jobs are still run when the pool is stopped */
+        if (pool->head == NULL)
+            break;
+
+        job = pool->head;
+        pool->head = job->next;
+        if (pool->head == NULL)
+            pool->tail = NULL;
+        pthread_mutex_unlock(&pool->mutex);
+
+        job->func(job->private);
+        free(job);
+
+        pthread_mutex_lock(&pool->mutex);
+    }
+    pthread_mutex_unlock(&pool->mutex);
+
+    return NULL;
+}
+
+/* Must be called with the pool's mutex held. */
+static void worker_pool_start_thread(struct worker_pool *pool)
+{
+    int rc;
+
+    rc = worker_thread_create(pool->tokdata,
+                              &pool->threads[pool->num_threads],
+                              worker_thread, pool);
+    if (rc != 0) {
+        /* Queued jobs are run by the threads that are already there */
+        TRACE_WARNING("Failed to start a worker thread: %s\n", strerror(rc));
+        return;
+    }
+
+    pool->num_threads++;
+}
+
+struct worker_pool *worker_pool_new(STDLL_TokData_t *tokdata)
+{
+    struct worker_pool *pool;
+    long cpus;
+
+    pool = calloc(1, sizeof(*pool));
+    if (pool == NULL) {
+        TRACE_ERROR("%s\n", ock_err(ERR_HOST_MEMORY));
+        return NULL;
+    }
+
+    cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    if (cpus < 1)
+        cpus = 1;
+    if (cpus > WORKER_POOL_MAX_THREADS)
+        cpus = WORKER_POOL_MAX_THREADS;
+    pool->max_threads = cpus;
+    pool->tokdata = tokdata;
+
+    pthread_mutex_init(&pool->mutex, NULL);
+    pthread_cond_init(&pool->cond, NULL);
+
+    return pool;
+}
+
+void worker_pool_free(struct worker_pool *pool, CK_BBOOL in_fork_initializer)
+{
+    struct worker_job *job;
+    unsigned int i;
+
+    if (pool == NULL)
+        return;
+
+    if (in_fork_initializer) {
+        /*
+         * The threads of the parent do not exist in the child, and the
+         * mutex may have been held by one of them at the time of the fork.
+         */
+        while (pool->head != NULL) {
+            job = pool->head;
+            pool->head = job->next;
+            free(job);
+        }
+        free(pool);
+        return;
+    }
+
+    pthread_mutex_lock(&pool->mutex);
+    pool->stop = TRUE;
+    pthread_cond_broadcast(&pool->cond);
+    pthread_mutex_unlock(&pool->mutex);
+
+    for (i = 0; i < pool->num_threads; i++)
+        pthread_join(pool->threads[i], NULL);
+
+    pthread_cond_destroy(&pool->cond);
+    pthread_mutex_destroy(&pool->mutex);
+    free(pool);
+}
+
+CK_RV worker_pool_submit(struct worker_pool *pool, worker_func_t func,
+                         void *private)
+{
+    struct worker_job *job;
+
+    job = malloc(sizeof(*job));
+    if (job == NULL) {
+        TRACE_ERROR("%s\n", ock_err(ERR_HOST_MEMORY));
+        return CKR_HOST_MEMORY;
+    }
+
+    job->next = NULL;
+    job->func = func;
+    job->private = private;
+
+    pthread_mutex_lock(&pool->mutex);
+    if (pool->stop) {
+        pthread_mutex_unlock(&pool->mutex);
+        free(job);
+        TRACE_ERROR("%s\n", ock_err(ERR_CRYPTOKI_NOT_INITIALIZED));
+        return CKR_CRYPTOKI_NOT_INITIALIZED;
+    }
+
+    if (pool->tail != NULL)
+        pool->tail->next = job;
+    else
+        pool->head = job;
+    pool->tail = job;
+
+    if (pool->idle == 0 && pool->num_threads < pool->max_threads)
+        worker_pool_start_thread(pool);
+    if (pool->num_threads == 0) {
+        /* Not a single thread could be started */
+        pool->head = NULL;
+        pool->tail = NULL;
+        pthread_mutex_unlock(&pool->mutex);
+        free(job);
+        return CKR_FUNCTION_FAILED;
+    }
+
+    pthread_cond_signal(&pool->cond);
+    pthread_mutex_unlock(&pool->mutex);
+
+    return CKR_OK;
+}
+
+static void worker_batch_run(struct worker_batch *batch)
+{
+    CK_ULONG i, n = 0;
+
+    for (;;) {
+        i = __atomic_fetch_add(&batch->next, 1, __ATOMIC_RELAXED);
+        if (i >= batch->count)
+            break;
+
+        batch->func(batch->private, i);
+        n++;
+    }
+
+    if (n == 0)
+        return;
+
+    pthread_mutex_lock(&batch->mutex);
+    batch->done += n;
+    if (batch->done == batch->count)
+        pthread_cond_broadcast(&batch->cond);
+    pthread_mutex_unlock(&batch->mutex);
+}
+
+static void worker_batch_put(struct worker_batch *batch)
+{
+    if (__atomic_sub_fetch(&batch->refs, 1, __ATOMIC_ACQ_REL) != 0)
+        return;
+
+    pthread_cond_destroy(&batch->cond);
+    pthread_mutex_destroy(&batch->mutex);
+    free(batch);
+}
+
+static void worker_batch_job(void *private)
+{
+    struct worker_batch *batch = private;
+
+    worker_batch_run(batch);
+    worker_batch_put(batch);
+}
+
+/*
+ * Calls func for every index from 0 to count - 1, spread over the calling
+ * thread and the pool's threads, and returns when all calls are done. The
+ * calling thread takes part, so the indexes are processed even if all
+ * threads of the pool are busy. Without a pool, all calls are made by the
+ * calling thread.
+ */
+CK_RV worker_pool_for_each(struct worker_pool *pool, CK_ULONG count,
+                           worker_index_func_t func, void *private)
+{
+    struct worker_batch *batch;
+    CK_ULONG i, helpers;
+
+    if (pool == NULL || count < 2) {
+        for (i = 0; i < count; i++)
+            func(private, i);
+        return CKR_OK;
+    }
+
+    batch = calloc(1, sizeof(*batch));
+    if (batch == NULL) {
+        TRACE_ERROR("%s\n", ock_err(ERR_HOST_MEMORY));
+        return CKR_HOST_MEMORY;
+    }
+
+    pthread_mutex_init(&batch->mutex, NULL);
+    pthread_cond_init(&batch->cond, NULL);
+    batch->func = func;
+    batch->private = private;
+    batch->count = count;
+
+    helpers = count - 1;
+    if (helpers > pool->max_threads)
+        helpers = pool->max_threads;
+    batch->refs = 1 + helpers;
+
+    for (i = 0; i < helpers; i++) {
+        if (worker_pool_submit(pool, worker_batch_job, batch) != CKR_OK) {
+            /* The remaining indexes are processed by the others */
+            __atomic_sub_fetch(&batch->refs, helpers - i, __ATOMIC_ACQ_REL);
+            break;
+        }
+    }
+
+    worker_batch_run(batch);
+
+    pthread_mutex_lock(&batch->mutex);
+    while (batch->done < batch->count)
+        pthread_cond_wait(&batch->cond, &batch->mutex);
+    pthread_mutex_unlock(&batch->mutex);
+
+    worker_batch_put(batch);
+
+    return CKR_OK;
+}
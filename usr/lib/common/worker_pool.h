@@ -0,0 +1,49 @@
+/*
+ * COPYRIGHT (c) International Business Machines Corp. 2024
+ *
+ * This program is provided under the terms of the Common Public License,
+ * version 1.0 (CPL-1.0). Any use, reproduction or distribution for this
+ * software constitutes recipient's acceptance of CPL-1.0 terms which can be
+ * found in the file LICENSE file or at
+ * https://opensource.org/licenses/cpl1.0.php
+ */
+
+#ifndef WORKER_POOL_H
+#define WORKER_POOL_H
+
+#include <pthread.h>
+
+#include "pkcs11types.h"
+#include "local_types.h"
+
+/*
+ * Pool of worker threads of a token. The threads are only started when the
+ * first job is submitted. Jobs run in the order they were submitted, jobs
+ * that are still queued when the pool is freed run before the threads exit.
+ *
+ * In a forked child (in_fork_initializer set) the pool's threads do not
+ * exist anymore, worker_pool_free() then only frees the memory.
+ */
+#define WORKER_POOL_MAX_THREADS     16
+
+struct worker_pool;
+
+typedef void (*worker_func_t)(void *private);
+typedef void (*worker_index_func_t)(void *private, CK_ULONG index);
+
+struct worker_pool *worker_pool_new(STDLL_TokData_t *tokdata);
+void worker_pool_free(struct worker_pool *pool, CK_BBOOL in_fork_initializer);
+CK_RV worker_pool_submit(struct worker_pool *pool, worker_func_t func,
+                         void *private);
+CK_RV worker_pool_for_each(struct worker_pool *pool, CK_ULONG count,
+                           worker_index_func_t func, void *private);
+
+/*
+ * Starts a thread of the token like pthread_create() does. The thread blocks
+ * all signals and uses the OpenSSL library context of opencryptoki, like the
+ * threads that call into the token do.
+ */
+int worker_thread_create(STDLL_TokData_t *tokdata, pthread_t *thread,
+                         void *(*func)(void *), void *arg);
+
+#endif
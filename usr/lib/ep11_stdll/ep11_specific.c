@@ -1882,13 +1882,12 @@ static CK_RV build_ep11_attrs(STDLL_TokData_t * tokdata, TEMPLATE *template,
                               CK_KEY_TYPE ktype, CK_OBJECT_CLASS class,
                               int curve_type)
 {
-    DL_NODE *node;
     CK_ATTRIBUTE_PTR attr;
+    CK_ULONG i;
     CK_RV rc;
 
-    node = template->attribute_list;
-    while (node != NULL) {
-        attr = node->data;
+    for (i = 0; i < template->count; i++) {
+        attr = template->attrs[i];
 
         /* EP11 handles this as 'read only' and reports an error if specified */
         switch (attr->type) {
@@ -1909,8 +1908,6 @@ static CK_RV build_ep11_attrs(STDLL_TokData_t * tokdata, TEMPLATE *template,
                 }
             }
         }
-
-        node = node->next;
     }
 
     return CKR_OK;
@@ -2514,7 +2511,7 @@ static CK_RV make_maced_spki(STDLL_TokData_t *tokdata, SESSION * sess,
     CK_ULONG attrs_len = 0;
     CK_ATTRIBUTE_PTR attr;
     CK_BBOOL bool_value;
-    DL_NODE *node;
+    CK_ULONG i;
     CK_BYTE csum[MAX_BLOBSIZE];
     CK_ULONG cslen = sizeof(csum);
     CK_KEY_TYPE keytype;
@@ -2531,9 +2528,9 @@ static CK_RV make_maced_spki(STDLL_TokData_t *tokdata, SESSION * sess,
      * m_UnwrapKey with CKM_IBM_TRANSPORTKEY allows boolean attributes only to
      * be added to MACed-SPKIs
      */
-    node = pub_key_obj->template->attribute_list;
-    while (node != NULL) {
-        attr = node->data;
+    i = 0;
+    while (i < pub_key_obj->template->count) {
+        attr = pub_key_obj->template->attrs[i];
 
         if (!attr_applicable_for_ep11(tokdata, attr, keytype,
                                       CKO_PUBLIC_KEY, curve_type))
@@ -2595,7 +2592,7 @@ static CK_RV make_maced_spki(STDLL_TokData_t *tokdata, SESSION * sess,
             break;
         }
 make_maced_spki_next:
-        node = node->next;
+        i++;
     }
 
     trace_attributes(__func__, "MACed SPKI import:", p_attrs, attrs_len);
@@ -11780,7 +11777,7 @@ CK_RV token_specific_set_attribute_values(STDLL_TokData_t *tokdata, OBJECT *obj,
     CK_OBJECT_CLASS class;
     size_t keyblobsize = 0;
     CK_BYTE *keyblob;
-    DL_NODE *node;
+    CK_ULONG i;
     CK_ATTRIBUTE *ibm_opaque_attr = NULL;
     CK_ATTRIBUTE_PTR attributes = NULL;
     CK_ULONG num_attributes = 0;
@@ -11810,9 +11807,8 @@ CK_RV token_specific_set_attribute_values(STDLL_TokData_t *tokdata, OBJECT *obj,
         return rc;
     }
 
-    node = new_tmpl->attribute_list;
-    while (node) {
-        attr = (CK_ATTRIBUTE *)node->data;
+    for (i = 0; i < new_tmpl->count; i++) {
+        attr = new_tmpl->attrs[i];
 
         /* EP11 can set certain boolean attributes only */
         switch (attr->type) {
@@ -11860,8 +11856,6 @@ CK_RV token_specific_set_attribute_values(STDLL_TokData_t *tokdata, OBJECT *obj,
             /* Either non-boolean, or read-only */
             break;
         }
-
-        node = node->next;
     }
 
     if (attributes != NULL && num_attributes > 0) {
@@ -38,10 +38,12 @@ opencryptoki_stdll_libpkcs11_ep11_la_SOURCES = usr/lib/common/asn1.c	\
 	usr/lib/common/shared_memory.c usr/lib/common/attributes.c	\
 	usr/lib/common/sw_crypt.c usr/lib/common/profile_obj.c		\
 	usr/lib/common/dlist.c usr/lib/common/pkey_utils.c		\
+	usr/lib/common/handle_table.c usr/lib/common/objdb.c		\
+	usr/lib/common/worker_pool.c					\
 	usr/lib/ep11_stdll/new_host.c					\
 	usr/lib/ep11_stdll/ep11_specific.c				\
 	usr/lib/common/utility_common.c usr/lib/common/ec_supported.c	\
-	usr/lib/api/policyhelper.c
+	usr/lib/api/policyhelper.c usr/lib/api/hashmap.c
 
 if ENABLE_LOCKS
 opencryptoki_stdll_libpkcs11_ep11_la_SOURCES +=				\
@@ -36,6 +36,7 @@
 #include "trace.h"
 #include "slotmgr.h"
 #include "attributes.h"
+#include "worker_pool.h"
 #include "ep11_specific.h"
 
 #include "../api/apiproto.h"
@@ -79,11 +80,12 @@ CK_RV ST_Initialize(API_Slot_t *sltp, CK_SLOT_ID SlotNumber,
     /* set trace info */
     set_trace(t);
 
-    bt_init(&sltp->TokData->sess_btree, free);
+    ht_init(&sltp->TokData->sess_table, free);
     bt_init(&sltp->TokData->object_map_btree, free);
     bt_init(&sltp->TokData->sess_obj_btree, call_object_free);
     bt_init(&sltp->TokData->priv_token_obj_btree, call_object_free);
     bt_init(&sltp->TokData->publ_token_obj_btree, call_object_free);
+    object_mgr_index_init(sltp->TokData);
 
     if (strlen(sinfp->tokname)) {
         if (ock_snprintf(abs_tokdir_name, PATH_MAX, "%s/%s",
@@ -107,6 +109,10 @@ CK_RV ST_Initialize(API_Slot_t *sltp, CK_SLOT_ID SlotNumber,
     }
 
     sltp->TokData->version = sinfp->version;
+    sltp->TokData->objstore = sinfp->objstore;
+    sltp->TokData->objload = sinfp->objload;
+    sltp->TokData->pbkdf2_it = sinfp->pbkdf2_it;
+    sltp->TokData->login_cache_ttl = sinfp->login_cache_ttl;
     TRACE_DEVEL("Token version: %u.%u\n",
                 (unsigned int)(sinfp->version >> 16),
                 (unsigned int)(sinfp->version & 0xffff));
@@ -185,6 +191,10 @@ CK_RV ST_Initialize(API_Slot_t *sltp, CK_SLOT_ID SlotNumber,
 
     init_slotInfo(&(sltp->TokData->slot_info));
 
+    /* Without a worker pool, batched operations run in the calling thread */
+    if (sltp->TokData->workers == NULL)
+        sltp->TokData->workers = worker_pool_new(sltp->TokData);
+
     (sltp->FcnList) = &function_list;
 
 done:
@@ -222,21 +232,25 @@ CK_RV SC_Finalize(STDLL_TokData_t *tokdata, CK_SLOT_ID sid, SLOT_INFO *sinfp,
 
     tokdata->initialized = FALSE;
 
+    worker_pool_free(tokdata->workers, in_fork_initializer);
+    tokdata->workers = NULL;
+
     if (session_mgr_so_session_exists(tokdata) ||
         session_mgr_user_session_exists(tokdata)) {
-        bt_for_each_node(tokdata, &tokdata->sess_btree, _ep11tok_logout_session,
-                         &in_fork_initializer);
+        ht_for_each(tokdata, &tokdata->sess_table, _ep11tok_logout_session,
+                    &in_fork_initializer);
     }
 
     session_mgr_close_all_sessions(tokdata);
     object_mgr_purge_token_objects(tokdata);
 
     /* Finally free the nodes on free list. */
-    bt_destroy(&tokdata->sess_btree);
+    ht_destroy(&tokdata->sess_table);
     bt_destroy(&tokdata->object_map_btree);
     bt_destroy(&tokdata->sess_obj_btree);
     bt_destroy(&tokdata->priv_token_obj_btree);
     bt_destroy(&tokdata->publ_token_obj_btree);
+    object_mgr_index_final(tokdata);
 
     detach_shm(tokdata, in_fork_initializer);
     /* close spin lock file */
@@ -442,6 +456,8 @@ CK_RV SC_InitToken(STDLL_TokData_t *tokdata, CK_SLOT_ID sid, CK_CHAR_PTR pPin,
     /* Before we reconstruct all the data, we should delete the
      * token objects from the filesystem.
      */
+    login_cache_remove(tokdata, CKU_SO);
+    login_cache_remove(tokdata, CKU_USER);
     object_mgr_destroy_token_objects(tokdata);
     delete_token_data(tokdata);
 
@@ -482,7 +498,7 @@ CK_RV SC_InitPIN(STDLL_TokData_t * tokdata, ST_SESSION_HANDLE * sSession,
     CK_RV rc = CKR_OK;
     TOKEN_DATA_VERSION *dat;
     unsigned char login_key[32], wrap_key[32], login_salt[64], wrap_salt[64];
-    uint64_t login_it, wrap_it;
+    uint64_t login_it = 0, wrap_it = 0;
 
     if (tokdata->initialized == FALSE) {
         TRACE_ERROR("%s\n", ock_err(ERR_CRYPTOKI_NOT_INITIALIZED));
@@ -533,7 +549,7 @@ CK_RV SC_InitPIN(STDLL_TokData_t * tokdata, ST_SESSION_HANDLE * sSession,
             goto done;
         }
     } else {
-        login_it = USER_KDF_LOGIN_IT;
+        login_it = pbkdf2_iterations(tokdata, USER_KDF_LOGIN_IT);
         memcpy(login_salt, USER_KDF_LOGIN_PURPOSE, 32);
         rng_generate(tokdata, login_salt + 32, 32);
 
@@ -547,7 +563,7 @@ CK_RV SC_InitPIN(STDLL_TokData_t * tokdata, ST_SESSION_HANDLE * sSession,
             goto done;
         }
 
-        wrap_it = USER_KDF_WRAP_IT;
+        wrap_it = pbkdf2_iterations(tokdata, USER_KDF_WRAP_IT);
         memcpy(wrap_salt, USER_KDF_WRAP_PURPOSE, 32);
         rng_generate(tokdata, wrap_salt + 32, 32);
 
@@ -570,6 +586,7 @@ CK_RV SC_InitPIN(STDLL_TokData_t * tokdata, ST_SESSION_HANDLE * sSession,
     if (tokdata->version < TOK_NEW_DATA_STORE) {
         memcpy(tokdata->nv_token_data->user_pin_sha, hash_sha, SHA1_HASH_SIZE);
     } else {
+        login_cache_remove(tokdata, CKU_USER);
         memcpy(dat->user_login_key, login_key, 256 / 8);
         memcpy(dat->user_login_salt, login_salt, 64);
         dat->user_login_it = login_it;
@@ -627,7 +644,7 @@ CK_RV SC_SetPIN(STDLL_TokData_t *tokdata, ST_SESSION_HANDLE *sSession,
     TOKEN_DATA_VERSION *dat;
     unsigned char old_login_key[32], new_login_key[32], new_wrap_key[32],
                   new_login_key_old_salt[32], login_salt[64], wrap_salt[64];
-    uint64_t login_it, wrap_it;
+    uint64_t login_it = 0, wrap_it = 0;
 
     if (tokdata->initialized == FALSE) {
         TRACE_ERROR("%s\n", ock_err(ERR_CRYPTOKI_NOT_INITIALIZED));
@@ -702,7 +719,7 @@ CK_RV SC_SetPIN(STDLL_TokData_t *tokdata, ST_SESSION_HANDLE *sSession,
                 goto done;
             }
         } else {
-            login_it = USER_KDF_LOGIN_IT;
+            login_it = pbkdf2_iterations(tokdata, USER_KDF_LOGIN_IT);
             memcpy(login_salt, USER_KDF_LOGIN_PURPOSE, 32);
             rng_generate(tokdata, login_salt + 32, 32);
 
@@ -715,7 +732,7 @@ CK_RV SC_SetPIN(STDLL_TokData_t *tokdata, ST_SESSION_HANDLE *sSession,
                 goto done;
             }
 
-            wrap_it = USER_KDF_WRAP_IT;
+            wrap_it = pbkdf2_iterations(tokdata, USER_KDF_WRAP_IT);
             memcpy(wrap_salt, USER_KDF_WRAP_PURPOSE, 32);
             rng_generate(tokdata, wrap_salt + 32, 32);
 
@@ -774,6 +791,7 @@ CK_RV SC_SetPIN(STDLL_TokData_t *tokdata, ST_SESSION_HANDLE *sSession,
                    SHA1_HASH_SIZE);
             memcpy(tokdata->user_pin_md5, hash_md5, MD5_HASH_SIZE);
         } else {
+            login_cache_remove(tokdata, CKU_USER);
             memcpy(dat->user_login_key, new_login_key, 256 / 8);
             memcpy(dat->user_login_salt, login_salt, 64);
             dat->user_login_it = login_it;
@@ -823,7 +841,7 @@ CK_RV SC_SetPIN(STDLL_TokData_t *tokdata, ST_SESSION_HANDLE *sSession,
                 goto done;
             }
         } else {
-            login_it = SO_KDF_LOGIN_IT;
+            login_it = pbkdf2_iterations(tokdata, SO_KDF_LOGIN_IT);
             memcpy(login_salt, SO_KDF_LOGIN_PURPOSE, 32);
             rng_generate(tokdata, login_salt + 32, 32);
 
@@ -836,7 +854,7 @@ CK_RV SC_SetPIN(STDLL_TokData_t *tokdata, ST_SESSION_HANDLE *sSession,
                 goto done;
             }
 
-            wrap_it = SO_KDF_WRAP_IT;
+            wrap_it = pbkdf2_iterations(tokdata, SO_KDF_WRAP_IT);
             memcpy(wrap_salt, SO_KDF_WRAP_PURPOSE, 32);
             rng_generate(tokdata, wrap_salt + 32, 32);
 
@@ -895,6 +913,7 @@ CK_RV SC_SetPIN(STDLL_TokData_t *tokdata, ST_SESSION_HANDLE *sSession,
                    SHA1_HASH_SIZE);
             memcpy(tokdata->so_pin_md5, hash_md5, MD5_HASH_SIZE);
         } else {
+            login_cache_remove(tokdata, CKU_SO);
             memcpy(dat->so_login_key, new_login_key, 256 / 8);
             memcpy(dat->so_login_salt, login_salt, 64);
             dat->so_login_it = login_it;
@@ -1070,7 +1089,7 @@ CK_RV SC_CloseAllSessions(STDLL_TokData_t *tokdata, CK_SLOT_ID sid)
 
     if (session_mgr_so_session_exists(tokdata) ||
         session_mgr_user_session_exists(tokdata)) {
-        bt_for_each_node(tokdata, &tokdata->sess_btree, _ep11tok_logout_session, NULL);
+        ht_for_each(tokdata, &tokdata->sess_table, _ep11tok_logout_session, NULL);
     }
 
     rc = session_mgr_close_all_sessions(tokdata);
@@ -1221,6 +1240,7 @@ CK_RV SC_Login(STDLL_TokData_t *tokdata, ST_SESSION_HANDLE *sSession,
     CK_BYTE hash_sha[SHA1_HASH_SIZE];
     CK_RV rc = CKR_OK;
     unsigned char login_key[32], wrap_key[32];
+    CK_BBOOL cached;
     TOKEN_DATA_VERSION *dat;
 
     /* In v2.11, logins should be exclusive, since token
@@ -1326,21 +1346,10 @@ CK_RV SC_Login(STDLL_TokData_t *tokdata, ST_SESSION_HANDLE *sSession,
             compute_md5(tokdata, pPin, ulPinLen, tokdata->user_pin_md5);
             memset(tokdata->so_pin_md5, 0x0, MD5_HASH_SIZE);
         } else {
-            rc = compute_PKCS5_PBKDF2_HMAC(tokdata, pPin, ulPinLen,
-                                           dat->user_login_salt, 64,
-                                           dat->user_login_it, EVP_sha512(),
-                                           256 / 8, login_key);
-            if (rc != CKR_OK) {
-                TRACE_DEVEL("PBKDF2 failed.\n");
-                goto done;
-            }
-
-            rc = compute_PKCS5_PBKDF2_HMAC(tokdata, pPin, ulPinLen,
-                                           dat->user_wrap_salt, 64,
-                                           dat->user_wrap_it, EVP_sha512(),
-                                           256 / 8, wrap_key);
+            rc = compute_login_keys(tokdata, userType, pPin, ulPinLen,
+                                    login_key, wrap_key, &cached);
             if (rc != CKR_OK) {
-                TRACE_DEVEL("PBKDF2 failed.\n");
+                TRACE_DEVEL("compute_login_keys failed.\n");
                 goto done;
             }
 
@@ -1358,6 +1367,10 @@ CK_RV SC_Login(STDLL_TokData_t *tokdata, ST_SESSION_HANDLE *sSession,
 
             memcpy(tokdata->user_wrap_key, wrap_key, 256 / 8);
             memset(tokdata->so_wrap_key, 0, 256 / 8);
+
+            if (!cached)
+                login_cache_put(tokdata, userType, pPin, ulPinLen,
+                                login_key, wrap_key);
         }
 
         rc = load_masterkey_user(tokdata);
@@ -1411,21 +1424,10 @@ CK_RV SC_Login(STDLL_TokData_t *tokdata, ST_SESSION_HANDLE *sSession,
             compute_md5(tokdata, pPin, ulPinLen, tokdata->so_pin_md5);
             memset(tokdata->user_pin_md5, 0x0, MD5_HASH_SIZE);
         } else {
-            rc = compute_PKCS5_PBKDF2_HMAC(tokdata, pPin, ulPinLen,
-                                           dat->so_login_salt, 64,
-                                           dat->so_login_it, EVP_sha512(),
-                                           256 / 8, login_key);
+            rc = compute_login_keys(tokdata, userType, pPin, ulPinLen,
+                                    login_key, wrap_key, &cached);
             if (rc != CKR_OK) {
-                TRACE_DEVEL("PBKDF2 failed.\n");
-                goto done;
-            }
-
-            rc = compute_PKCS5_PBKDF2_HMAC(tokdata, pPin, ulPinLen,
-                                           dat->so_wrap_salt, 64,
-                                           dat->so_wrap_it, EVP_sha512(),
-                                           256 / 8, wrap_key);
-            if (rc != CKR_OK) {
-                TRACE_DEVEL("PBKDF2 failed.\n");
+                TRACE_DEVEL("compute_login_keys failed.\n");
                 goto done;
             }
 
@@ -1443,6 +1445,10 @@ CK_RV SC_Login(STDLL_TokData_t *tokdata, ST_SESSION_HANDLE *sSession,
 
             memcpy(tokdata->so_wrap_key, wrap_key, 256 / 8);
             memset(tokdata->user_wrap_key, 0, 256 / 8);
+
+            if (!cached)
+                login_cache_put(tokdata, userType, pPin, ulPinLen,
+                                login_key, wrap_key);
         }
 
         rc = load_masterkey_so(tokdata);
@@ -1458,8 +1464,8 @@ done:
     }
 
     if (rc == CKR_OK) {
-        bt_for_each_node(tokdata, &tokdata->sess_btree, _ep11tok_login_session,
-                         &rc);
+        ht_for_each(tokdata, &tokdata->sess_table, _ep11tok_login_session,
+                    &rc);
         if (rc != CKR_OK)
             TRACE_DEVEL("_ep11tok_login_session failed.\n");
     }
@@ -1506,8 +1512,8 @@ CK_RV SC_Logout(STDLL_TokData_t *tokdata, ST_SESSION_HANDLE *sSession)
         goto done;
     }
 
-    bt_for_each_node(tokdata, &tokdata->sess_btree, _ep11tok_logout_session,
-                     NULL);
+    ht_for_each(tokdata, &tokdata->sess_table, _ep11tok_logout_session,
+                NULL);
 
     rc = session_mgr_logout_all(tokdata);
     if (rc != CKR_OK)
@@ -1917,20 +1923,14 @@ CK_RV SC_FindObjects(STDLL_TokData_t *tokdata, ST_SESSION_HANDLE *sSession,
         goto done;
     }
 
-    if (!sess->find_list) {
-        TRACE_DEVEL("sess->find_list is NULL.\n");
-        rc = CKR_OPERATION_NOT_INITIALIZED;
+    rc = object_mgr_find_next(tokdata, sess, phObject, ulMaxObjectCount,
+                              &count);
+    if (rc != CKR_OK) {
+        TRACE_DEVEL("object_mgr_find_next failed.\n");
         goto done;
     }
-    count = MIN(ulMaxObjectCount, (sess->find_count - sess->find_idx));
-
-    memcpy(phObject, sess->find_list + sess->find_idx,
-           count * sizeof(CK_OBJECT_HANDLE));
     *pulObjectCount = count;
 
-    sess->find_idx += count;
-    rc = CKR_OK;
-
 done:
     TRACE_INFO("C_FindObjects: rc = 0x%08lx, returned %lu objects\n",
                rc, count);
@@ -1967,15 +1967,7 @@ CK_RV SC_FindObjectsFinal(STDLL_TokData_t *tokdata,
         goto done;
     }
 
-    if (sess->find_list)
-        free(sess->find_list);
-
-    sess->find_list = NULL;
-    sess->find_len = 0;
-    sess->find_idx = 0;
-    sess->find_active = FALSE;
-
-    rc = CKR_OK;
+    rc = object_mgr_find_final(sess);
 
 done:
     TRACE_INFO("C_FindObjectsFinal: rc = 0x%08lx\n", rc);
@@ -4268,6 +4260,156 @@ done:
     return rc;
 }
 
+CK_RV SC_IBM_CreateObjects(STDLL_TokData_t *tokdata, ST_SESSION_T *sSession,
+                           CK_IBM_OBJECT_TEMPLATE_PTR pTemplates,
+                           CK_ULONG ulObjectCount,
+                           CK_OBJECT_HANDLE_PTR phObjects)
+{
+    SESSION *sess = NULL;
+    CK_RV rc = CKR_OK;
+
+    if (tokdata->initialized == FALSE) {
+        TRACE_ERROR("%s\n", ock_err(ERR_CRYPTOKI_NOT_INITIALIZED));
+        rc = CKR_CRYPTOKI_NOT_INITIALIZED;
+        goto done;
+    }
+
+    sess = session_mgr_find_reset_error(tokdata, sSession->sessionh);
+    if (!sess) {
+        TRACE_ERROR("%s\n", ock_err(ERR_SESSION_HANDLE_INVALID));
+        rc = CKR_SESSION_HANDLE_INVALID;
+        goto done;
+    }
+
+    if (pin_expired(&sess->session_info,
+                    tokdata->nv_token_data->token_info.flags)) {
+        TRACE_ERROR("%s\n", ock_err(ERR_PIN_EXPIRED));
+        rc = CKR_PIN_EXPIRED;
+        goto done;
+    }
+
+    /* Enforces policy */
+    rc = object_mgr_add_objects(tokdata, sess, pTemplates, ulObjectCount,
+                                phObjects);
+    if (rc != CKR_OK)
+        TRACE_DEVEL("object_mgr_add_objects() failed.\n");
+
+done:
+    TRACE_INFO("SC_IBM_CreateObjects: rc = 0x%08lx, sess = %ld, "
+               "count = %lu\n", rc,
+               (sess == NULL) ? -1 : (CK_LONG) sess->handle, ulObjectCount);
+
+    if (sess != NULL)
+        session_mgr_put(tokdata, sess);
+
+    return rc;
+}
+
+CK_RV SC_IBM_GetAttributeValues(STDLL_TokData_t *tokdata,
+                                ST_SESSION_T *sSession,
+                                CK_OBJECT_HANDLE_PTR phObjects,
+                                CK_ULONG ulObjectCount,
+                                CK_IBM_OBJECT_TEMPLATE_PTR pTemplates,
+                                CK_RV *pReturnValues)
+{
+    SESSION *sess = NULL;
+    CK_RV rc = CKR_OK;
+
+    if (tokdata->initialized == FALSE) {
+        TRACE_ERROR("%s\n", ock_err(ERR_CRYPTOKI_NOT_INITIALIZED));
+        rc = CKR_CRYPTOKI_NOT_INITIALIZED;
+        goto done;
+    }
+
+    sess = session_mgr_find_reset_error(tokdata, sSession->sessionh);
+    if (!sess) {
+        TRACE_ERROR("%s\n", ock_err(ERR_SESSION_HANDLE_INVALID));
+        rc = CKR_SESSION_HANDLE_INVALID;
+        goto done;
+    }
+
+    rc = object_mgr_get_attribute_values_multi(tokdata, sess, phObjects,
+                                               ulObjectCount, pTemplates,
+                                               pReturnValues);
+    if (rc != CKR_OK)
+        TRACE_DEVEL("object_mgr_get_attribute_values_multi() failed.\n");
+
+done:
+    TRACE_INFO("SC_IBM_GetAttributeValues: rc = 0x%08lx, sess = %ld, "
+               "count = %lu\n", rc,
+               (sess == NULL) ? -1 : (CK_LONG) sess->handle, ulObjectCount);
+
+    if (sess != NULL)
+        session_mgr_put(tokdata, sess);
+
+    return rc;
+}
+
+CK_RV SC_IBM_DigestBatch(STDLL_TokData_t *tokdata,
+                         ST_SESSION_T *sSession,
+                         CK_MECHANISM_PTR pMechanism,
+                         CK_IBM_DATA_PTR pData,
+                         CK_ULONG ulDataCount,
+                         CK_BYTE_PTR pDigests,
+                         CK_ULONG_PTR pulDigestsLen)
+{
+    SESSION *sess = NULL;
+    CK_RV rc = CKR_OK;
+
+    if (tokdata->initialized == FALSE) {
+        TRACE_ERROR("%s\n", ock_err(ERR_CRYPTOKI_NOT_INITIALIZED));
+        rc = CKR_CRYPTOKI_NOT_INITIALIZED;
+        goto done;
+    }
+
+    rc = valid_mech(tokdata, pMechanism);
+    if (rc != CKR_OK)
+        goto done;
+
+    sess = session_mgr_find_reset_error(tokdata, sSession->sessionh);
+    if (!sess) {
+        TRACE_ERROR("%s\n", ock_err(ERR_SESSION_HANDLE_INVALID));
+        rc = CKR_SESSION_HANDLE_INVALID;
+        goto done;
+    }
+    rc = tokdata->policy->is_mech_allowed(tokdata->policy, pMechanism, NULL,
+                                          POLICY_CHECK_DIGEST, sess);
+    if (rc != CKR_OK) {
+        TRACE_ERROR("POLICY_VIOLATION on digest initialization\n");
+        goto done;
+    }
+
+    if (pin_expired(&sess->session_info,
+                    tokdata->nv_token_data->token_info.flags) == TRUE) {
+        TRACE_ERROR("%s\n", ock_err(ERR_PIN_EXPIRED));
+        rc = CKR_PIN_EXPIRED;
+        goto done;
+    }
+
+    if (sess->digest_ctx.active == TRUE) {
+        TRACE_ERROR("%s\n", ock_err(ERR_OPERATION_ACTIVE));
+        rc = CKR_OPERATION_ACTIVE;
+        goto done;
+    }
+
+    rc = digest_mgr_digest_batch(tokdata, sess, pMechanism, pData,
+                                 ulDataCount, pDigests, pulDigestsLen,
+                                 FALSE);
+    if (rc != CKR_OK)
+        TRACE_DEVEL("digest_mgr_digest_batch() failed.\n");
+
+done:
+    TRACE_INFO("SC_IBM_DigestBatch: rc = 0x%08lx, sess = %ld, mech = 0x%lx, "
+               "count = %lu\n", rc,
+               (sess == NULL) ? -1 : (CK_LONG) sess->handle,
+               pMechanism->mechanism, ulDataCount);
+
+    if (sess != NULL)
+        session_mgr_put(tokdata, sess);
+
+    return rc;
+}
+
 CK_RV SC_HandleEvent(STDLL_TokData_t *tokdata, unsigned int event_type,
                      unsigned int event_flags, const char *payload,
                      unsigned int payload_len)
@@ -4351,6 +4493,20 @@ void SC_SetFunctionList(void)
     function_list.ST_CancelFunction = NULL;     // SC_CancelFunction;
 
     function_list.ST_IBM_ReencryptSingle = SC_IBM_ReencryptSingle;
+    function_list.ST_IBM_CreateObjects = SC_IBM_CreateObjects;
+    function_list.ST_IBM_GetAttributeValues = SC_IBM_GetAttributeValues;
+    function_list.ST_IBM_DigestBatch = SC_IBM_DigestBatch;
+
+    function_list.ST_MessageEncryptInit = NULL;
+    function_list.ST_EncryptMessage = NULL;
+    function_list.ST_EncryptMessageBegin = NULL;
+    function_list.ST_EncryptMessageNext = NULL;
+    function_list.ST_MessageEncryptFinal = NULL;
+    function_list.ST_MessageDecryptInit = NULL;
+    function_list.ST_DecryptMessage = NULL;
+    function_list.ST_DecryptMessageBegin = NULL;
+    function_list.ST_DecryptMessageNext = NULL;
+    function_list.ST_MessageDecryptFinal = NULL;
 
     function_list.ST_HandleEvent = SC_HandleEvent;
 }
@@ -138,6 +138,9 @@ token_spec_t token_specific = {
     &token_specific_set_attribute_values,
     &token_specific_set_attrs_for_new_object,
     &token_specific_handle_event,
+    NULL,                       // aes_gcm_msg_init
+    NULL,                       // aes_gcm_msg_begin
+    NULL,                       // aes_gcm_msg_next
 };
 
 #endif
@@ -36,9 +36,11 @@ opencryptoki_stdll_libpkcs11_ica_la_SOURCES =				\
 	usr/lib/common/mech_list.c usr/lib/common/shared_memory.c	\
 	usr/lib/common/profile_obj.c usr/lib/common/attributes.c	\
 	usr/lib/ica_s390_stdll/ica_specific.c usr/lib/common/dlist.c	\
+	usr/lib/common/handle_table.c usr/lib/common/objdb.c		\
+	usr/lib/common/worker_pool.c usr/lib/common/async_mgr.c	\
 	usr/lib/common/mech_openssl.c					\
 	usr/lib/common/utility_common.c usr/lib/common/ec_supported.c	\
-	usr/lib/api/policyhelper.c
+	usr/lib/api/policyhelper.c usr/lib/api/hashmap.c
 
 if ENABLE_LOCKS
 opencryptoki_stdll_libpkcs11_ica_la_SOURCES +=				\
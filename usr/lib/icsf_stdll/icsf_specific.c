@@ -742,13 +742,23 @@ CK_RV token_specific_attach_shm(STDLL_TokData_t * tokdata, CK_SLOT_ID slot_id)
      * exists. When the it's created (ret=0) the region is initialized with
      * zeroes.
      */
-    ret = sm_open(shm_id, 0660, (void **) &ptr, len, 1);
+    ret = sm_open(shm_id, 0660, (void **) &ptr,
+                  object_mgr_shm_size(len, TOK_OBJ_MIN_CAPACITY),
+                  object_mgr_shm_size(len, TOK_OBJ_MAX_CAPACITY), 1);
     if (ret < 0) {
         TRACE_ERROR("Failed to open shared memory \"%s\".\n", shm_id);
         rc = CKR_FUNCTION_FAILED;
         goto done;
     }
 
+    rc = object_mgr_shm_init(ptr, len, ret == 0);
+    if (rc != CKR_OK) {
+        TRACE_ERROR("Shared memory \"%s\" has an unsupported layout.\n",
+                    shm_id);
+        sm_close(ptr, 0, 0);
+        goto done;
+    }
+
     *shm = ptr;
     slot_data[slot_id] = (struct slot_data *)((unsigned char *)ptr
                                               + sizeof(**shm));
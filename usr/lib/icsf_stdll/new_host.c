@@ -77,11 +77,12 @@ CK_RV ST_Initialize(API_Slot_t *sltp, CK_SLOT_ID SlotNumber,
     /* set trace info */
     set_trace(t);
 
-    bt_init(&sltp->TokData->sess_btree, free);
+    ht_init(&sltp->TokData->sess_table, free);
     bt_init(&sltp->TokData->object_map_btree, free);
     bt_init(&sltp->TokData->sess_obj_btree, call_object_free);
     bt_init(&sltp->TokData->priv_token_obj_btree, call_object_free);
     bt_init(&sltp->TokData->publ_token_obj_btree, call_object_free);
+    object_mgr_index_init(sltp->TokData);
 
     if (strlen(sinfp->tokname)) {
         if (ock_snprintf(abs_tokdir_name, PATH_MAX, "%s/%s",
@@ -105,6 +106,10 @@ CK_RV ST_Initialize(API_Slot_t *sltp, CK_SLOT_ID SlotNumber,
     }
 
     sltp->TokData->version = sinfp->version;
+    sltp->TokData->objstore = sinfp->objstore;
+    sltp->TokData->objload = sinfp->objload;
+    sltp->TokData->pbkdf2_it = sinfp->pbkdf2_it;
+    sltp->TokData->login_cache_ttl = sinfp->login_cache_ttl;
     TRACE_DEVEL("Token version: %u.%u\n",
                 (unsigned int)(sinfp->version >> 16),
                 (unsigned int)(sinfp->version & 0xffff));
@@ -224,11 +229,12 @@ CK_RV SC_Finalize(STDLL_TokData_t *tokdata, CK_SLOT_ID sid, SLOT_INFO *sinfp,
     object_mgr_purge_token_objects(tokdata);
 
     /* Finally free the nodes on free list. */
-    bt_destroy(&tokdata->sess_btree);
+    ht_destroy(&tokdata->sess_table);
     bt_destroy(&tokdata->object_map_btree);
     bt_destroy(&tokdata->sess_obj_btree);
     bt_destroy(&tokdata->priv_token_obj_btree);
     bt_destroy(&tokdata->publ_token_obj_btree);
+    object_mgr_index_final(tokdata);
 
     detach_shm(tokdata, in_fork_initializer);
     /* close spin lock file */
@@ -3407,5 +3413,16 @@ void SC_SetFunctionList(void)
 
     function_list.ST_IBM_ReencryptSingle = SC_IBM_ReencryptSingle;
 
+    function_list.ST_MessageEncryptInit = NULL;
+    function_list.ST_EncryptMessage = NULL;
+    function_list.ST_EncryptMessageBegin = NULL;
+    function_list.ST_EncryptMessageNext = NULL;
+    function_list.ST_MessageEncryptFinal = NULL;
+    function_list.ST_MessageDecryptInit = NULL;
+    function_list.ST_DecryptMessage = NULL;
+    function_list.ST_DecryptMessageBegin = NULL;
+    function_list.ST_DecryptMessageNext = NULL;
+    function_list.ST_MessageDecryptFinal = NULL;
+
     function_list.ST_HandleEvent = SC_HandleEvent;
 }
@@ -34,6 +34,7 @@
 #include "tok_specific.h"
 #include "tok_struct.h"
 #include "trace.h"
+#include "drbg.h"
 
 #include <sys/types.h>
 #include <sys/stat.h>
@@ -198,7 +199,8 @@ static const MECH_LIST_ELEMENT soft_mech_list[] = {
     {CKM_AES_CFB8, {16, 32, CKF_ENCRYPT | CKF_DECRYPT | CKF_WRAP | CKF_UNWRAP}},
     {CKM_AES_CFB128, {16, 32, CKF_ENCRYPT | CKF_DECRYPT | CKF_WRAP | CKF_UNWRAP}},
 #endif
-    {CKM_AES_GCM, {16, 32, CKF_ENCRYPT | CKF_DECRYPT}},
+    {CKM_AES_GCM, {16, 32, CKF_ENCRYPT | CKF_DECRYPT | CKF_MESSAGE_ENCRYPT |
+                           CKF_MESSAGE_DECRYPT | CKF_MULTI_MESSAGE}},
     {CKM_AES_MAC, {16, 32, CKF_HW | CKF_SIGN | CKF_VERIFY}},
     {CKM_AES_MAC_GENERAL, {16, 32, CKF_HW | CKF_SIGN | CKF_VERIFY}},
     {CKM_AES_CMAC, {16, 32, CKF_SIGN | CKF_VERIFY}},
@@ -242,6 +244,14 @@ CK_RV token_specific_init(STDLL_TokData_t *tokdata, CK_SLOT_ID SlotNumber,
         return rc;
     }
 
+    rc = drbg_init();
+    if (rc != CKR_OK) {
+        TRACE_ERROR("DRBG initialization failed!  rc = 0x%lx\n", rc);
+        free(tokdata->mech_list);
+        tokdata->mech_list = NULL;
+        return rc;
+    }
+
     TRACE_INFO("soft %s slot=%lu running\n", __func__, SlotNumber);
 
     return CKR_OK;
@@ -250,15 +260,23 @@ CK_RV token_specific_init(STDLL_TokData_t *tokdata, CK_SLOT_ID SlotNumber,
 CK_RV token_specific_final(STDLL_TokData_t *tokdata,
                            CK_BBOOL token_specific_final)
 {
-    UNUSED(token_specific_final);
-
     TRACE_INFO("soft %s running\n", __func__);
 
+    drbg_final(token_specific_final);
+
     free(tokdata->mech_list);
     
     return CKR_OK;
 }
 
+CK_RV token_specific_rng(STDLL_TokData_t *tokdata, CK_BYTE *output,
+                         CK_ULONG bytes)
+{
+    UNUSED(tokdata);
+
+    return drbg_generate(output, bytes);
+}
+
 CK_RV token_specific_des_key_gen(STDLL_TokData_t *tokdata, CK_BYTE **des_key,
                                  CK_ULONG *len, CK_ULONG keysize,
                                  CK_BBOOL *is_opaque)
@@ -637,6 +655,39 @@ CK_RV token_specific_aes_gcm_final(STDLL_TokData_t *tokdata, SESSION *sess,
                                           out_data_len, encrypt);
 }
 
+CK_RV token_specific_aes_gcm_msg_init(STDLL_TokData_t *tokdata, SESSION *sess,
+                                      ENCR_DECR_CONTEXT *ctx,
+                                      CK_MECHANISM *mech,
+                                      CK_OBJECT_HANDLE key, CK_BYTE encrypt)
+{
+    return openssl_specific_aes_gcm_msg_init(tokdata, sess, ctx, mech,
+                                             key, encrypt);
+}
+
+CK_RV token_specific_aes_gcm_msg_begin(STDLL_TokData_t *tokdata,
+                                       SESSION *sess, ENCR_DECR_CONTEXT *ctx,
+                                       CK_GCM_MESSAGE_PARAMS *param,
+                                       CK_BYTE *aad, CK_ULONG aad_len,
+                                       CK_BYTE encrypt)
+{
+    return openssl_specific_aes_gcm_msg_begin(tokdata, sess, ctx, param,
+                                              aad, aad_len, encrypt);
+}
+
+CK_RV token_specific_aes_gcm_msg_next(STDLL_TokData_t *tokdata, SESSION *sess,
+                                      ENCR_DECR_CONTEXT *ctx,
+                                      CK_GCM_MESSAGE_PARAMS *param,
+                                      CK_BYTE *in_data, CK_ULONG in_data_len,
+                                      CK_BYTE *out_data,
+                                      CK_ULONG *out_data_len,
+                                      CK_FLAGS flags, CK_BYTE encrypt)
+{
+    return openssl_specific_aes_gcm_msg_next(tokdata, sess, ctx, param,
+                                             in_data, in_data_len,
+                                             out_data, out_data_len,
+                                             flags, encrypt);
+}
+
 CK_RV token_specific_aes_mac(STDLL_TokData_t *tokdata, CK_BYTE *message,
                              CK_ULONG message_len, OBJECT *key, CK_BYTE *mac)
 {
@@ -66,7 +66,7 @@ token_spec_t token_specific = {
     NULL,                       // init_token_data
     NULL,                       // load_token_data
     NULL,                       // save_token_data
-    NULL,                       // random number generator
+    &token_specific_rng,
     &token_specific_final,
     NULL,                       // init_token
     NULL,                       // login
@@ -177,6 +177,15 @@ token_spec_t token_specific = {
     NULL,                       // set_attribute_values
     NULL,                       // set_attrs_for_new_object
     NULL,                       // handle_event
+#ifndef NOAES
+    &token_specific_aes_gcm_msg_init,
+    &token_specific_aes_gcm_msg_begin,
+    &token_specific_aes_gcm_msg_next,
+#else
+    NULL,                       // aes_gcm_msg_init
+    NULL,                       // aes_gcm_msg_begin
+    NULL,                       // aes_gcm_msg_next
+#endif
 };
 
 #endif
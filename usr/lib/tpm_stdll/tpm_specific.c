@@ -276,11 +276,9 @@ CK_RV token_find_key(STDLL_TokData_t * tokdata, int key_type,
         goto done;
     }
 
-    /* pulled from SC_FindObjects */
-    ulObjCount = MIN(1, (dummy_sess.find_count - dummy_sess.find_idx));
-    memcpy(&hObj, dummy_sess.find_list + dummy_sess.find_idx,
-           ulObjCount * sizeof(CK_OBJECT_HANDLE));
-    dummy_sess.find_idx += ulObjCount;
+    rc = object_mgr_find_next(tokdata, &dummy_sess, &hObj, 1, &ulObjCount);
+    if (rc != CKR_OK)
+        goto done;
 
     if (ulObjCount > 1) {
         TRACE_INFO("More than one matching key found in the store!\n");
@@ -34,6 +34,7 @@ static const char *default_pkcs11lib = "libopencryptoki.so";
 
 static void *pkcs11lib = NULL;
 static CK_FUNCTION_LIST *funcs = NULL;
+static CK_IBM_FUNCTION_LIST_1_1 *ibm_funcs = NULL;
 
 static struct ConfigBaseNode *cfg = NULL;
 
@@ -78,6 +79,9 @@ static void load_pkcs11lib(void)
 {
     CK_RV rc;
     CK_RV (*pfoo)();
+    CK_C_GetInterface get_interface;
+    CK_INTERFACE *interface;
+    CK_VERSION version = { 1, 1 };
     const char *libname;
 
     /* check for environment variable PKCSLIB */
@@ -108,6 +112,13 @@ static void load_pkcs11lib(void)
         exit(99);
     }
 
+    /* the vendor interface is optional, it is used for bulk key import */
+    *(void**) (&get_interface) = dlsym(pkcs11lib, "C_GetInterface");
+    if (get_interface != NULL &&
+        get_interface((CK_UTF8CHAR *)"Vendor IBM", &version, &interface,
+                      0) == CKR_OK)
+        ibm_funcs = interface->pFunctionList;
+
     atexit(unload_pkcs11lib);
 }
 
@@ -252,6 +263,8 @@ static const char* cmd2str(p11sak_cmd cmd)
         return "list-key";
     case remove_key:
         return "remove-key";
+    case import_key:
+        return "import-key";
     default:
         return "unknown p11sak cmd";
     }
@@ -381,6 +394,7 @@ static void print_cmd_help(void)
     printf("      generate-key       Generate a key\n");
     printf("      list-key           List keys in the repository\n");
     printf("      remove-key         Delete keys in the repository\n");
+    printf("      import-key         Import keys from a file\n");
     printf("\n Options:\n");
     printf("      -h, --help         Show this help\n\n");
 }
@@ -455,6 +469,23 @@ static void print_removekeys_help(void)
     printf("      -h, --help                              Show this help\n\n");
 }
 
+static void print_importkeys_help(void)
+{
+    printf("\n Usage: p11sak import-key [OPTIONS]\n");
+    printf("\n Options:\n");
+    printf(
+            "      --file FILE                             file with the keys to import\n");
+    printf(
+            "      --slot SLOTID                           openCryptoki repository token SLOTID.\n");
+    printf("      --pin PIN                               pkcs11 user PIN\n");
+    printf(
+            "      --attr [M R L S E D G V W U A X N]      set key attributes\n");
+    printf("      -h, --help                              Show this help\n");
+    printf("\n Each line of FILE holds one secret key:\n");
+    printf("      des|3des|aes|generic LABEL HEXVALUE\n");
+    printf(" Empty lines and lines starting with '#' are ignored.\n\n");
+}
+
 static void print_gen_des_help(void)
 {
     printf("\n Options:\n");
@@ -1217,6 +1248,139 @@ static CK_ATTRIBUTE_TYPE col2type(int col)
     }
 }
 
+/**
+ * Attributes of a key prefetched for list_ckey
+ */
+struct list_key_attrs {
+    CK_ATTRIBUTE attrs[LIST_ATTR_COUNT];
+    CK_BBOOL valid;
+    CK_OBJECT_CLASS oclass;
+    CK_KEY_TYPE ktype;
+    CK_ULONG value_len;
+    CK_BBOOL bools[KEY_MAX_BOOL_ATTR_COUNT];
+    CK_BYTE label[LIST_LABEL_SIZE];
+};
+
+static CK_OBJECT_HANDLE list_cur_hkey = CK_INVALID_HANDLE;
+static struct list_key_attrs *list_cur_key = NULL;
+
+/**
+ * Fetch the attributes printed by list_ckey for a page of keys with a single
+ * C_IBM_GetAttributeValues call. Keys for which this does not work are left
+ * marked invalid and are read with C_GetAttributeValue as before.
+ */
+static void list_prefetch_attrs(CK_SESSION_HANDLE session,
+                                CK_OBJECT_HANDLE *handles, CK_ULONG count,
+                                struct list_key_attrs *keys,
+                                CK_IBM_OBJECT_TEMPLATE *tmpls, CK_RV *rvs)
+{
+    CK_ULONG i;
+    int j, n;
+    CK_RV rc;
+
+    for (i = 0; i < count; i++) {
+        keys[i].valid = CK_FALSE;
+        n = 0;
+        keys[i].attrs[n].type = CKA_CLASS;
+        keys[i].attrs[n].pValue = &keys[i].oclass;
+        keys[i].attrs[n++].ulValueLen = sizeof(keys[i].oclass);
+        keys[i].attrs[n].type = CKA_KEY_TYPE;
+        keys[i].attrs[n].pValue = &keys[i].ktype;
+        keys[i].attrs[n++].ulValueLen = sizeof(keys[i].ktype);
+        keys[i].attrs[n].type = CKA_VALUE_LEN;
+        keys[i].attrs[n].pValue = &keys[i].value_len;
+        keys[i].attrs[n++].ulValueLen = sizeof(keys[i].value_len);
+        for (j = 0; j < KEY_MAX_BOOL_ATTR_COUNT; j++) {
+            keys[i].attrs[n].type = col2type(j);
+            keys[i].attrs[n].pValue = &keys[i].bools[j];
+            keys[i].attrs[n++].ulValueLen = sizeof(CK_BBOOL);
+        }
+        keys[i].attrs[n].type = CKA_LABEL;
+        keys[i].attrs[n].pValue = keys[i].label;
+        keys[i].attrs[n++].ulValueLen = sizeof(keys[i].label);
+
+        tmpls[i].pTemplate = keys[i].attrs;
+        tmpls[i].ulCount = n;
+    }
+
+    if (ibm_funcs == NULL)
+        return;
+
+    rc = ibm_funcs->C_IBM_GetAttributeValues(session, handles, count,
+                                             tmpls, rvs);
+    if (rc != CKR_OK)
+        return;
+
+    for (i = 0; i < count; i++) {
+        /*
+         * These errors only affect single attributes, whose length is set to
+         * CK_UNAVAILABLE_INFORMATION. All other attributes are valid.
+         */
+        switch (rvs[i]) {
+        case CKR_OK:
+        case CKR_ATTRIBUTE_SENSITIVE:
+        case CKR_ATTRIBUTE_TYPE_INVALID:
+        case CKR_BUFFER_TOO_SMALL:
+            keys[i].valid = CK_TRUE;
+            break;
+        default:
+            break;
+        }
+    }
+}
+
+/**
+ * Satisfy an attribute request from the prefetched attributes, if all
+ * requested attributes are available there.
+ */
+static CK_BBOOL list_get_cached_attrs(struct list_key_attrs *key,
+                                      CK_ATTRIBUTE *tmpl, CK_ULONG count)
+{
+    CK_ATTRIBUTE *found[LIST_ATTR_COUNT];
+    CK_ULONG i;
+    int j;
+
+    if (!key->valid || count > LIST_ATTR_COUNT)
+        return CK_FALSE;
+
+    for (i = 0; i < count; i++) {
+        found[i] = NULL;
+        for (j = 0; j < LIST_ATTR_COUNT; j++) {
+            if (key->attrs[j].type == tmpl[i].type) {
+                found[i] = &key->attrs[j];
+                break;
+            }
+        }
+        if (found[i] == NULL ||
+            found[i]->ulValueLen == CK_UNAVAILABLE_INFORMATION)
+            return CK_FALSE;
+        if (tmpl[i].pValue != NULL && tmpl[i].ulValueLen < found[i]->ulValueLen)
+            return CK_FALSE;
+    }
+
+    for (i = 0; i < count; i++) {
+        if (tmpl[i].pValue != NULL)
+            memcpy(tmpl[i].pValue, found[i]->pValue, found[i]->ulValueLen);
+        tmpl[i].ulValueLen = found[i]->ulValueLen;
+    }
+
+    return CK_TRUE;
+}
+
+/**
+ * C_GetAttributeValue, served from the prefetched attributes of the key
+ * currently listed by list_ckey where possible.
+ */
+static CK_RV get_key_attrs(CK_SESSION_HANDLE session, CK_OBJECT_HANDLE hkey,
+                           CK_ATTRIBUTE *tmpl, CK_ULONG count)
+{
+    if (list_cur_key != NULL && list_cur_hkey == hkey &&
+        list_get_cached_attrs(list_cur_key, tmpl, count))
+        return CKR_OK;
+
+    return funcs->C_GetAttributeValue(session, hkey, tmpl, count);
+}
+
 /**
  *  Print in p11sak_defined_attrs.conf defined attributes in long format
  */
@@ -1269,7 +1433,7 @@ static CK_RV print_custom_attrs(CK_SESSION_HANDLE session, CK_OBJECT_HANDLE hkey
                     CK_ATTRIBUTE temp = {hex, &a_bool, sizeof(a_bool)};
 
                     // get attribute value
-                    rc = funcs->C_GetAttributeValue(session, hkey, &temp, 1);
+                    rc = get_key_attrs(session, hkey, &temp, 1);
                     if (rc == CKR_OK) {
                         if (temp.ulValueLen != sizeof(CK_BBOOL)) {
                             fprintf(stderr, " Error in retrieving Attribute %s: %lu\n",
@@ -1294,7 +1458,7 @@ static CK_RV print_custom_attrs(CK_SESSION_HANDLE session, CK_OBJECT_HANDLE hkey
                     CK_ATTRIBUTE temp = {hex, &a_ulong, sizeof(a_ulong)};
 
                     // get attribute value
-                    rc = funcs->C_GetAttributeValue(session, hkey, &temp, 1);
+                    rc = get_key_attrs(session, hkey, &temp, 1);
                     if (rc == CKR_OK) {
                         if (temp.ulValueLen != sizeof(CK_ULONG)) {
                             fprintf(stderr, " Error in retrieving Attribute %s: %lu\n",
@@ -1316,7 +1480,7 @@ static CK_RV print_custom_attrs(CK_SESSION_HANDLE session, CK_OBJECT_HANDLE hkey
                 } else if (strcmp((confignode_to_bareval(type)->value), "CK_BYTE") == 0) {
                     // get length 
                     CK_ATTRIBUTE temp = {hex, NULL, 0};
-                    rc = funcs->C_GetAttributeValue(session, hkey, &temp, 1);
+                    rc = get_key_attrs(session, hkey, &temp, 1);
                     if (rc == CKR_ATTRIBUTE_SENSITIVE && long_print) {
                         printf("          %s: SENSITIVE\n", confignode_to_bareval(name)->value);
                     } else if (rc != CKR_ATTRIBUTE_TYPE_INVALID && rc != CKR_OK) {
@@ -1331,7 +1495,7 @@ static CK_RV print_custom_attrs(CK_SESSION_HANDLE session, CK_OBJECT_HANDLE hkey
                         }
 
                         // get attribute value
-                        rc = funcs->C_GetAttributeValue(session, hkey, &temp, 1);
+                        rc = get_key_attrs(session, hkey, &temp, 1);
                         if (rc == CKR_OK) {
                             if (temp.ulValueLen != a_byte_array) {
                                 fprintf(stderr, " Error in retrieving Attribute %s: %lu\n",
@@ -1436,7 +1600,7 @@ static CK_RV sec_key_print_attributes(CK_SESSION_HANDLE session,
         { CKA_NEVER_EXTRACTABLE, &a_never_extractable, sizeof(a_never_extractable) } };
     CK_ULONG count = sizeof(bool_tmplt) / sizeof(CK_ATTRIBUTE);
 
-    rc = funcs->C_GetAttributeValue(session, hkey, bool_tmplt, count);
+    rc = get_key_attrs(session, hkey, bool_tmplt, count);
     if (rc != CKR_OK) {
         fprintf(stderr, "Attribute retrieval failed (error code 0x%lX: %s)\n", rc,
                 p11_get_ckr(rc));
@@ -1512,7 +1676,7 @@ static CK_RV priv_key_print_attributes(CK_SESSION_HANDLE session,
         { CKA_NEVER_EXTRACTABLE, &a_never_extractable, sizeof(a_never_extractable) } };
     CK_ULONG count = sizeof(bool_tmplt) / sizeof(CK_ATTRIBUTE);
 
-    rc = funcs->C_GetAttributeValue(session, hkey, bool_tmplt, count);
+    rc = get_key_attrs(session, hkey, bool_tmplt, count);
     if (rc != CKR_OK) {
         fprintf(stderr, "Attribute retrieval failed (error code 0x%lX: %s)\n", rc,
                 p11_get_ckr(rc));
@@ -1582,7 +1746,7 @@ static CK_RV pub_key_print_attributes(CK_SESSION_HANDLE session,
         { CKA_WRAP, &a_wrap, sizeof(a_wrap) }, };
     CK_ULONG count = sizeof(bool_tmplt) / sizeof(CK_ATTRIBUTE);
 
-    rc = funcs->C_GetAttributeValue(session, hkey, bool_tmplt, count);
+    rc = get_key_attrs(session, hkey, bool_tmplt, count);
     if (rc != CKR_OK) {
         fprintf(stderr, "Attribute retrieval failed (error code 0x%lX: %s)\n", rc,
                 p11_get_ckr(rc));
@@ -1633,7 +1797,7 @@ static CK_RV tok_key_get_label_attr(CK_SESSION_HANDLE session,
     CK_ATTRIBUTE template[1] = { { CKA_LABEL, NULL_PTR, 0 } };
     CK_ULONG label_len;
 
-    rc = funcs->C_GetAttributeValue(session, hkey, template, 1);
+    rc = get_key_attrs(session, hkey, template, 1);
     if (rc != CKR_OK) {
         fprintf(stderr, "Key cannot show CKA_LABEL attribute (error code 0x%lX: %s)\n",
                 rc, p11_get_ckr(rc));
@@ -1658,7 +1822,7 @@ static CK_RV tok_key_get_label_attr(CK_SESSION_HANDLE session,
     }
 
     template[0].pValue = label;
-    rc = funcs->C_GetAttributeValue(session, hkey, template, 1);
+    rc = get_key_attrs(session, hkey, template, 1);
     if (rc != CKR_OK) {
         fprintf(stderr, "Error retrieving CKA_LABEL attribute (error code 0x%lX: %s)\n",
                 rc, p11_get_ckr(rc));
@@ -1687,7 +1851,7 @@ static CK_RV tok_key_get_key_type(CK_SESSION_HANDLE session, CK_OBJECT_HANDLE hk
     CK_ATTRIBUTE template[1] =
             { { CKA_CLASS, &oclass, sizeof(CK_OBJECT_CLASS) } };
 
-    rc = funcs->C_GetAttributeValue(session, hkey, template, 1);
+    rc = get_key_attrs(session, hkey, template, 1);
     if (rc != CKR_OK) {
         fprintf(stderr, 
                 "Object does not have CKA_CLASS attribute (error code 0x%lX: %s)\n",
@@ -1727,7 +1891,7 @@ static CK_RV tok_key_get_key_type(CK_SESSION_HANDLE session, CK_OBJECT_HANDLE hk
     template[0].type = CKA_KEY_TYPE;
     template[0].pValue = &kt;
     template[0].ulValueLen = sizeof(CK_KEY_TYPE);
-    rc = funcs->C_GetAttributeValue(session, hkey, template, 1);
+    rc = get_key_attrs(session, hkey, template, 1);
     if (rc != CKR_OK) {
         fprintf(stderr, "Object does not have CKA_KEY_TYPE attribute (error code 0x%lX: %s)\n",
                rc, p11_get_ckr(rc));
@@ -1744,7 +1908,7 @@ static CK_RV tok_key_get_key_type(CK_SESSION_HANDLE session, CK_OBJECT_HANDLE hk
         template[0].type = CKA_VALUE_LEN;
         template[0].pValue = &vl;
         template[0].ulValueLen = sizeof(CK_ULONG);
-        rc = funcs->C_GetAttributeValue(session, hkey, template, 1);
+        rc = get_key_attrs(session, hkey, template, 1);
         if (rc != CKR_OK) {
             fprintf(stderr, "Object does not have CKA_VALUE_LEN attribute (error code 0x%lX: %s)\n",
                    rc, p11_get_ckr(rc));
@@ -1879,6 +2043,9 @@ static p11sak_cmd parse_cmd(const char *arg)
     } else if ((strcmp(arg, "remove-key") == 0) || (strcmp(arg, "rm-key") == 0)
             || (strcmp(arg, "rm") == 0)) {
         cmd = remove_key;
+    } else if ((strcmp(arg, "import-key") == 0)
+            || (strcmp(arg, "import") == 0)) {
+        cmd = import_key;
     } else {
         fprintf(stderr, "Unknown command %s\n", cmd2str(cmd));
         cmd = no_cmd;
@@ -2264,6 +2431,92 @@ static CK_RV parse_remove_key_args(char *argv[], int argc, p11sak_kt *kt,
 
     return rc;
 }
+/**
+ * Parse the import-key args.
+ */
+static CK_RV parse_import_key_args(char *argv[], int argc, CK_SLOT_ID *slot,
+                                   char **pin, char **file, char **attr_string)
+{
+    CK_BBOOL slotIDset = CK_FALSE;
+    int i;
+
+    int base = 0;
+    char *endptr, *str;
+
+    if (last_parm_is_help(argv, argc)) {
+        print_importkeys_help();
+        return CKR_ARGUMENTS_BAD;
+    }
+
+    for (i = 2; i < argc; i++) {
+        if (strcmp(argv[i], "--slot") == 0) {
+            if (i + 1 < argc) {
+                str = argv[i + 1];
+                errno = 0;
+                *slot = strtol(str, &endptr, base);
+
+                if (errno != 0 || endptr == str || *endptr != '\0') {
+                    fprintf(stderr, "--slot <SLOT> argument must be specified correctly.\n");
+                    return CKR_ARGUMENTS_BAD;
+                }
+
+                slotIDset = CK_TRUE;
+            } else {
+                fprintf(stderr, "--slot <SLOT> argument is missing.\n");
+                return CKR_ARGUMENTS_BAD;
+            }
+            i++;
+        } else if (strcmp(argv[i], "--pin") == 0) {
+            if (i + 1 < argc) {
+                *pin = argv[i + 1];
+            } else {
+                fprintf(stderr, "--pin <PIN> argument is missing.\n");
+                return CKR_ARGUMENTS_BAD;
+            }
+            i++;
+        } else if (strcmp(argv[i], "--file") == 0) {
+            if (i + 1 < argc) {
+                *file = argv[i + 1];
+            } else {
+                fprintf(stderr, "--file <FILE> argument is missing.\n");
+                return CKR_ARGUMENTS_BAD;
+            }
+            i++;
+        } else if ((strcmp(argv[i], "--attr") == 0)) {
+            if (i + 1 < argc) {
+                *attr_string = argv[i + 1];
+                if (strlen(argv[i + 1]) > KEY_MAX_BOOL_ATTR_COUNT) {
+                    fprintf(stderr, "--attr <ATTRIBUTES> argument is too long.\n");
+                    return CKR_ARGUMENTS_BAD;
+                }
+            } else {
+                fprintf(stderr, "--attr <ATTRIBUTES> argument is missing.\n");
+                return CKR_ARGUMENTS_BAD;
+            }
+            i++;
+        } else if ((strcmp(argv[i], "-h") == 0)
+                || (strcmp(argv[i], "--help") == 0)) {
+            print_importkeys_help();
+            return CKR_ARGUMENTS_BAD;
+        } else {
+            fprintf(stderr, "Unknown argument or option %s for command import-key\n",
+                    argv[i]);
+            return CKR_ARGUMENTS_BAD;
+        }
+    }
+
+    if (*file == NULL) {
+        fprintf(stderr, "--file <FILE> must be specified.\n");
+        return CKR_ARGUMENTS_BAD;
+    }
+
+    if (!slotIDset) {
+        fprintf(stderr, "--slot <SLOT> must be specified.\n");
+        return CKR_ARGUMENTS_BAD;
+    }
+
+    return CKR_OK;
+}
 /**
  * Parse the p11sak command args.
  */
@@ -2271,7 +2524,7 @@ static CK_RV parse_cmd_args(p11sak_cmd cmd, char *argv[], int argc,
                             p11sak_kt *kt, CK_ULONG *keylength, char **ECcurve,
                             CK_SLOT_ID *slot, char **pin, CK_ULONG *exponent,
                             char **label, char **attr_string, int *long_print,
-                            CK_BBOOL *forceAll)
+                            CK_BBOOL *forceAll, char **file)
 {
     CK_RV rc;
 
@@ -2288,6 +2541,9 @@ static CK_RV parse_cmd_args(p11sak_cmd cmd, char *argv[], int argc,
         rc = parse_remove_key_args(argv, argc, kt, slot, pin, label, keylength,
                 forceAll);
         break;
+    case import_key:
+        rc = parse_import_key_args(argv, argc, slot, pin, file, attr_string);
+        break;
     default:
         fprintf(stderr, "Error: unknown command %d specified.\n", cmd);
         rc = CKR_ARGUMENTS_BAD;
@@ -2484,23 +2740,124 @@ static CK_RV generate_ckey(CK_SESSION_HANDLE session, CK_SLOT_ID slot,
     }
 }
 /**
- * List the given key.
+ * Print a single key of the key list
  */
-static CK_RV list_ckey(CK_SESSION_HANDLE session, p11sak_kt kt, int long_print)
+static CK_RV list_one_ckey(CK_SESSION_HANDLE session, CK_OBJECT_HANDLE hkey,
+                           int long_print)
 {
-    CK_ULONG keylength, count;
+    CK_ULONG keylength;
     CK_OBJECT_CLASS keyclass;
-    CK_OBJECT_HANDLE hkey;
     char *keytype = NULL;
     char *label = NULL;
     CK_RV rc;
     int CELL_SIZE = 11;
 
-    rc = tok_key_list_init(session, kt, label);
+    rc = tok_key_get_key_type(session, hkey, &keyclass, &keytype,
+            &keylength);
+    if (rc != CKR_OK) {
+        fprintf(stderr, "Invalid key type (error code 0x%lX: %s)\n", rc,
+                p11_get_ckr(rc));
+        return CKR_OK;
+    }
+
+    rc = tok_key_get_label_attr(session, hkey, &label);
+    if (rc != CKR_OK) {
+        fprintf(stderr, "Retrieval of label failed (error code 0x%lX: %s)\n", rc,
+                p11_get_ckr(rc));
+    } else if (long_print) {
+        printf("Label: %s\t\t", label);
+    }
+
+    if (long_print) {
+        printf("\n      Key: ");
+        if (keylength > 0)
+            printf("%s %ld\t\t", keytype, keylength);
+        else
+            printf("%s\t\t", keytype);
+
+        printf("\n      Attributes:\n");
+    }
+
+    switch (keyclass) {
+    case CKO_SECRET_KEY:
+        rc = sec_key_print_attributes(session, hkey, long_print);
+        if (rc != CKR_OK) {
+            fprintf(stderr, 
+                    "Secret key attribute printing failed (error code 0x%lX: %s)\n",
+                    rc, p11_get_ckr(rc));
+            goto done;
+        }
+        break;
+    case CKO_PRIVATE_KEY:
+        rc = priv_key_print_attributes(session, hkey, long_print);
+        if (rc != CKR_OK) {
+            fprintf(stderr, 
+                    "Private key attribute printing failed (error code 0x%lX: %s)\n",
+                    rc, p11_get_ckr(rc));
+            goto done;
+        }
+        break;
+    case CKO_PUBLIC_KEY:
+        rc = pub_key_print_attributes(session, hkey, long_print);
+        if (rc != CKR_OK) {
+            fprintf(stderr, 
+                    "Public key attribute printing failed (error code 0x%lX: %s)\n",
+                    rc, p11_get_ckr(rc));
+            goto done;
+        }
+        break;
+    default:
+        fprintf(stderr, "Unhandled keyclass in list_ckey!\n");
+        break;
+    }
+
+    if (long_print == 0) {
+        if (keylength > 0) {
+            char tmp[16];
+            snprintf(tmp, sizeof(tmp), "%s %ld", keytype, keylength);
+            printf(" %*s | ", CELL_SIZE, tmp);
+        } else
+            printf(" %*s | ", CELL_SIZE, keytype);
+        printf("%s\n", label);
+    }
+
+    rc = CKR_OK;
+
+done:
+    free(label);
+    free(keytype);
+
+    return rc;
+}
+
+/**
+ * List the keys. The keys are retrieved in pages of LIST_BATCH_SIZE and the
+ * attributes of a page are prefetched with one C_IBM_GetAttributeValues call.
+ */
+static CK_RV list_ckey(CK_SESSION_HANDLE session, p11sak_kt kt, int long_print)
+{
+    CK_OBJECT_HANDLE *handles = NULL;
+    struct list_key_attrs *keys = NULL;
+    CK_IBM_OBJECT_TEMPLATE *tmpls = NULL;
+    CK_RV *rvs = NULL;
+    CK_ULONG i, count;
+    CK_RV rc;
+
+    handles = calloc(LIST_BATCH_SIZE, sizeof(*handles));
+    keys = calloc(LIST_BATCH_SIZE, sizeof(*keys));
+    tmpls = calloc(LIST_BATCH_SIZE, sizeof(*tmpls));
+    rvs = calloc(LIST_BATCH_SIZE, sizeof(*rvs));
+    if (handles == NULL || keys == NULL || tmpls == NULL || rvs == NULL) {
+        fprintf(stderr, "Error: cannot malloc storage for key list.\n");
+        rc = CKR_HOST_MEMORY;
+        goto done;
+    }
+
+    rc = tok_key_list_init(session, kt, NULL);
     if (rc != CKR_OK) {
         fprintf(stderr, "Init token key list failed (error code 0x%lX: %s)\n", rc,
                 p11_get_ckr(rc));
-        return rc;
+        goto done;
     }
 
     if (long_print == 0) {
@@ -2512,87 +2869,25 @@ static CK_RV list_ckey(CK_SESSION_HANDLE session, p11sak_kt kt, int long_print)
     }
 
     while (1) {
-        rc = funcs->C_FindObjects(session, &hkey, 1, &count);
+        rc = funcs->C_FindObjects(session, handles, LIST_BATCH_SIZE, &count);
         if (rc != CKR_OK) {
             fprintf(stderr, "C_FindObjects failed (error code 0x%lX: %s)\n", rc,
                     p11_get_ckr(rc));
-            return rc;
+            goto done;
         }
         if (count == 0)
             break;
 
-        rc = tok_key_get_key_type(session, hkey, &keyclass, &keytype,
-                &keylength);
-        if (rc != CKR_OK) {
-            fprintf(stderr, "Invalid key type (error code 0x%lX: %s)\n", rc,
-                    p11_get_ckr(rc));
-            continue;
-        }
-
-        rc = tok_key_get_label_attr(session, hkey, &label);
-        if (rc != CKR_OK) {
-            fprintf(stderr, "Retrieval of label failed (error code 0x%lX: %s)\n", rc,
-                    p11_get_ckr(rc));
-        } else if (long_print) {
-            printf("Label: %s\t\t", label);
-        }
-
-        if (long_print) {
-            printf("\n      Key: ");
-            if (keylength > 0)
-                printf("%s %ld\t\t", keytype, keylength);
-            else
-                printf("%s\t\t", keytype);
+        list_prefetch_attrs(session, handles, count, keys, tmpls, rvs);
 
-            printf("\n      Attributes:\n");
-        }
-
-        switch (keyclass) {
-        case CKO_SECRET_KEY:
-            rc = sec_key_print_attributes(session, hkey, long_print);
-            if (rc != CKR_OK) {
-                fprintf(stderr, 
-                        "Secret key attribute printing failed (error code 0x%lX: %s)\n",
-                        rc, p11_get_ckr(rc));
+        for (i = 0; i < count; i++) {
+            list_cur_hkey = handles[i];
+            list_cur_key = &keys[i];
+            rc = list_one_ckey(session, handles[i], long_print);
+            if (rc != CKR_OK)
                 goto done;
-            }
-            break;
-        case CKO_PRIVATE_KEY:
-            rc = priv_key_print_attributes(session, hkey, long_print);
-            if (rc != CKR_OK) {
-                fprintf(stderr, 
-                        "Private key attribute printing failed (error code 0x%lX: %s)\n",
-                        rc, p11_get_ckr(rc));
-                goto done;
-            }
-            break;
-        case CKO_PUBLIC_KEY:
-            rc = pub_key_print_attributes(session, hkey, long_print);
-            if (rc != CKR_OK) {
-                fprintf(stderr, 
-                        "Public key attribute printing failed (error code 0x%lX: %s)\n",
-                        rc, p11_get_ckr(rc));
-                goto done;
-            }
-            break;
-        default:
-            fprintf(stderr, "Unhandled keyclass in list_ckey!\n");
-            break;
         }
-
-        if (long_print == 0) {
-            if (keylength > 0) {
-                char tmp[16];
-                snprintf(tmp, sizeof(tmp), "%s %ld", keytype, keylength);
-                printf(" %*s | ", CELL_SIZE, tmp);
-            } else
-                printf(" %*s | ", CELL_SIZE, keytype);
-            printf("%s\n", label);
-        }
-        free(label);
-        label = NULL;
-        free(keytype);
-        keytype = NULL;
+        list_cur_key = NULL;
     }
 
     rc = funcs->C_FindObjectsFinal(session);
@@ -2605,11 +2900,13 @@ static CK_RV list_ckey(CK_SESSION_HANDLE session, p11sak_kt kt, int long_print)
     rc = CKR_OK;
 
 done:
+    list_cur_key = NULL;
+    list_cur_hkey = CK_INVALID_HANDLE;
+    free(handles);
+    free(keys);
+    free(tmpls);
+    free(rvs);
 
-    if (rc != CKR_OK) {
-        free(label);
-        free(keytype);
-    }
     return rc;
 }
 
@@ -2789,10 +3086,239 @@ done:
     return rc;
 }
 
+/**
+ * A secret key read from an import file, with its template.
+ */
+struct import_key {
+    CK_OBJECT_CLASS class;
+    CK_KEY_TYPE keytype;
+    char *label;
+    CK_BYTE *value;
+    CK_ULONG value_len;
+    CK_ATTRIBUTE attrs[5 + KEY_MAX_BOOL_ATTR_COUNT];
+};
+
+static void free_import_key(struct import_key *key)
+{
+    if (key->value != NULL) {
+        memset(key->value, 0, key->value_len);
+        free(key->value);
+    }
+    free(key->label);
+    memset(key, 0, sizeof(*key));
+}
+/**
+ * Parse a line of an import file: KEYTYPE LABEL HEXVALUE. Sets *skip for
+ * empty lines and comments.
+ */
+static CK_RV parse_import_line(char *line, unsigned long lineno,
+                               char *attr_string, struct import_key *key,
+                               CK_IBM_OBJECT_TEMPLATE *tmpl, CK_BBOOL *skip)
+{
+    char *type, *label, *hex, *saveptr;
+    CK_ULONG i, len, count = 0;
+    unsigned int byte;
+    p11sak_kt kt;
+
+    type = strtok_r(line, " \t\r\n", &saveptr);
+    if (type == NULL || type[0] == '#') {
+        *skip = CK_TRUE;
+        return CKR_OK;
+    }
+    *skip = CK_FALSE;
+
+    label = strtok_r(NULL, " \t\r\n", &saveptr);
+    hex = strtok_r(NULL, " \t\r\n", &saveptr);
+    if (label == NULL || hex == NULL ||
+        strtok_r(NULL, " \t\r\n", &saveptr) != NULL) {
+        fprintf(stderr, "Line %lu: expected KEYTYPE LABEL HEXVALUE\n", lineno);
+        return CKR_ARGUMENTS_BAD;
+    }
+
+    if (strcasecmp(type, "des") == 0) {
+        kt = kt_DES;
+    } else if (strcasecmp(type, "3des") == 0) {
+        kt = kt_3DES;
+    } else if (strcasecmp(type, "aes") == 0) {
+        kt = kt_AES;
+    } else if (strcasecmp(type, "generic") == 0) {
+        kt = kt_GENERIC;
+    } else {
+        fprintf(stderr, "Line %lu: key type %s is not supported\n", lineno,
+                type);
+        return CKR_ARGUMENTS_BAD;
+    }
+
+    len = strlen(hex);
+    if (len % 2 != 0) {
+        fprintf(stderr, "Line %lu: invalid key value\n", lineno);
+        return CKR_ARGUMENTS_BAD;
+    }
+
+    key->class = CKO_SECRET_KEY;
+    kt2CKK(kt, &key->keytype);
+    key->label = strdup(label);
+    key->value_len = len / 2;
+    key->value = malloc(key->value_len);
+    if (key->label == NULL || key->value == NULL) {
+        free_import_key(key);
+        return CKR_HOST_MEMORY;
+    }
+
+    for (i = 0; i < key->value_len; i++) {
+        if (!isxdigit(hex[2 * i]) || !isxdigit(hex[2 * i + 1]) ||
+            sscanf(&hex[2 * i], "%2x", &byte) != 1) {
+            fprintf(stderr, "Line %lu: invalid key value\n", lineno);
+            free_import_key(key);
+            return CKR_ARGUMENTS_BAD;
+        }
+        key->value[i] = byte;
+    }
+
+    key->attrs[count].type = CKA_CLASS;
+    key->attrs[count].pValue = &key->class;
+    key->attrs[count++].ulValueLen = sizeof(key->class);
+    key->attrs[count].type = CKA_KEY_TYPE;
+    key->attrs[count].pValue = &key->keytype;
+    key->attrs[count++].ulValueLen = sizeof(key->keytype);
+    key->attrs[count].type = CKA_TOKEN;
+    key->attrs[count].pValue = &ckb_true;
+    key->attrs[count++].ulValueLen = sizeof(CK_BBOOL);
+    key->attrs[count].type = CKA_LABEL;
+    key->attrs[count].pValue = key->label;
+    key->attrs[count++].ulValueLen = strlen(key->label);
+    key->attrs[count].type = CKA_VALUE;
+    key->attrs[count].pValue = key->value;
+    key->attrs[count++].ulValueLen = key->value_len;
+
+    /* attr_string length is checked in parse_import_key_args */
+    if (attr_string) {
+        for (i = 0; i < strlen(attr_string); i++)
+            set_bool_attr_from_string(&key->attrs[count++], attr_string[i]);
+    }
+
+    tmpl->pTemplate = key->attrs;
+    tmpl->ulCount = count;
+
+    return CKR_OK;
+}
+/**
+ * Create the keys of one import batch, all with a single call if the token
+ * supports C_IBM_CreateObjects.
+ */
+static CK_RV create_import_keys(CK_SESSION_HANDLE session,
+                                CK_IBM_OBJECT_TEMPLATE *tmpls,
+                                struct import_key *keys, CK_ULONG count,
+                                CK_OBJECT_HANDLE *handles, CK_ULONG *created)
+{
+    CK_ULONG i;
+    CK_RV rc;
+
+    if (ibm_funcs != NULL) {
+        rc = ibm_funcs->C_IBM_CreateObjects(session, tmpls, count, handles);
+        if (rc == CKR_OK)
+            *created += count;
+        if (rc != CKR_FUNCTION_NOT_SUPPORTED)
+            return rc;
+    }
+
+    for (i = 0; i < count; i++) {
+        rc = funcs->C_CreateObject(session, tmpls[i].pTemplate,
+                                   tmpls[i].ulCount, &handles[i]);
+        if (rc != CKR_OK) {
+            fprintf(stderr, "Import of key with label [%s] failed\n",
+                    keys[i].label);
+            return rc;
+        }
+        (*created)++;
+    }
+
+    return CKR_OK;
+}
+/**
+ * Import the secret keys listed in a file.
+ */
+static CK_RV import_ckeys(CK_SESSION_HANDLE session, char *file,
+                          char *attr_string)
+{
+    FILE *fp;
+    char *line = NULL;
+    size_t linesize = 0;
+    unsigned long lineno = 0;
+    struct import_key *keys;
+    CK_IBM_OBJECT_TEMPLATE *tmpls;
+    CK_OBJECT_HANDLE *handles;
+    CK_ULONG i, count = 0, created = 0;
+    CK_BBOOL skip;
+    CK_RV rc = CKR_OK;
+
+    fp = fopen(file, "r");
+    if (fp == NULL) {
+        fprintf(stderr, "Cannot open file %s: %s\n", file, strerror(errno));
+        return CKR_ARGUMENTS_BAD;
+    }
+
+    keys = calloc(IMPORT_BATCH_SIZE, sizeof(*keys));
+    tmpls = calloc(IMPORT_BATCH_SIZE, sizeof(*tmpls));
+    handles = calloc(IMPORT_BATCH_SIZE, sizeof(*handles));
+    if (keys == NULL || tmpls == NULL || handles == NULL) {
+        rc = CKR_HOST_MEMORY;
+        goto done;
+    }
+
+    while (getline(&line, &linesize, fp) >= 0) {
+        lineno++;
+        rc = parse_import_line(line, lineno, attr_string, &keys[count],
+                               &tmpls[count], &skip);
+        if (rc != CKR_OK)
+            goto done;
+        if (skip)
+            continue;
+
+        if (++count < IMPORT_BATCH_SIZE)
+            continue;
+
+        rc = create_import_keys(session, tmpls, keys, count, handles,
+                                &created);
+        for (i = 0; i < count; i++)
+            free_import_key(&keys[i]);
+        count = 0;
+        if (rc != CKR_OK)
+            goto done;
+    }
+
+    if (count > 0)
+        rc = create_import_keys(session, tmpls, keys, count, handles,
+                                &created);
+
+done:
+    if (keys != NULL) {
+        for (i = 0; i < count; i++)
+            free_import_key(&keys[i]);
+    }
+    free(keys);
+    free(tmpls);
+    free(handles);
+    if (line != NULL) {
+        memset(line, 0, linesize);
+        free(line);
+    }
+    fclose(fp);
+
+    if (rc == CKR_OK)
+        printf("%lu keys imported successfully!\n", created);
+    else
+        fprintf(stderr, "Key import failed after %lu keys (error code 0x%lX: %s)\n",
+                created, rc, p11_get_ckr(rc));
+
+    return rc;
+}
+
 static CK_RV execute_cmd(CK_SESSION_HANDLE session, CK_SLOT_ID slot,
                          p11sak_cmd cmd, p11sak_kt kt, CK_ULONG keylength,
                          CK_ULONG exponent, char *ECcurve, char *label,
-                         char *attr_string, int long_print, CK_BBOOL *forceAll)
+                         char *attr_string, int long_print, CK_BBOOL *forceAll,
+                         char *file)
 {
     CK_RV rc;
     switch (cmd) {
@@ -2806,6 +3332,9 @@ static CK_RV execute_cmd(CK_SESSION_HANDLE session, CK_SLOT_ID slot,
     case remove_key:
         rc = delete_key(session, kt, label, forceAll);
         break;
+    case import_key:
+        rc = import_ckeys(session, file, attr_string);
+        break;
     default:
         fprintf(stderr, "   Unknown COMMAND %c\n", cmd);
         print_cmd_help();
@@ -2944,6 +3473,7 @@ int main(int argc, char *argv[])
     size_t pinlen;
     CK_BBOOL pin_allocated = ckb_false;
     CK_BBOOL forceAll = ckb_false;
+    char *file = NULL;
 
     /* Check if just help requested */
     if (argc < 3) {
@@ -2962,7 +3492,7 @@ int main(int argc, char *argv[])
 
     /* Parse command args */
     rc = parse_cmd_args(cmd, argv, argc, &kt, &keylength, &ECcurve, &slot, &pin,
-            &exponent, &label, &attr_string, &long_print, &forceAll);
+            &exponent, &label, &attr_string, &long_print, &forceAll, &file);
     if (rc != CKR_OK) {
         goto done;
     }
@@ -3009,7 +3539,7 @@ int main(int argc, char *argv[])
 
     /* Execute command */
     rc = execute_cmd(session, slot, cmd, kt, keylength, exponent, ECcurve,
-            label, attr_string, long_print, &forceAll);
+            label, attr_string, long_print, &forceAll, file);
     if (rc == CKR_CANCEL) {
         fprintf(stderr, "Cancel execution: p11sak %s command (error code 0x%lX: %s)\n", cmd2str(cmd), rc,
                 p11_get_ckr(rc));
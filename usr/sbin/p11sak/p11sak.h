@@ -11,7 +11,7 @@
 #include <ec_curves.h>
 
 typedef enum {
-    no_cmd, gen_key, list_key, remove_key
+    no_cmd, gen_key, list_key, remove_key, import_key
 } p11sak_cmd;
 
 /*
@@ -37,6 +37,11 @@ typedef enum {
 #define  PRV_KEY_MAX_BOOL_ATTR_COUNT 12
 #define  PUB_KEY_MAX_BOOL_ATTR_COUNT 8
 
+#define  IMPORT_BATCH_SIZE 256
+#define  LIST_BATCH_SIZE 256
+#define  LIST_ATTR_COUNT (3 + KEY_MAX_BOOL_ATTR_COUNT + 1)
+#define  LIST_LABEL_SIZE 256
+
 #define P11SAK_DEFAULT_CONF_FILE OCK_CONFDIR "/p11sak_defined_attrs.conf"
 
 const CK_BYTE brainpoolP160r1[] = OCK_BRAINPOOL_P160R1;
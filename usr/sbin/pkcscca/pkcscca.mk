@@ -38,8 +38,10 @@ usr_sbin_pkcscca_pkcscca_SOURCES = usr/lib/common/asn1.c		\
 	usr/lib/common/profile_obj.c usr/lib/common/attributes.c	\
 	usr/lib/common/mech_rng.c usr/lib/common/pkcs_utils.c		\
 	usr/lib/common/dlist.c usr/sbin/pkcscca/pkcscca.c		\
+	usr/lib/common/worker_pool.c					\
+	usr/lib/common/handle_table.c usr/lib/common/objdb.c		\
 	usr/lib/common/utility_common.c usr/lib/common/ec_supported.c   \
-	usr/lib/api/policyhelper.c
+	usr/lib/api/policyhelper.c usr/lib/api/hashmap.c
 
 nodist_usr_sbin_pkcscca_pkcscca_SOURCES = usr/lib/api/mechtable.c
 
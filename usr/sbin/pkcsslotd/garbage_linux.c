@@ -321,6 +321,7 @@ BOOL CheckForGarbage(Slot_Mgr_Shr_t *MemPtr)
                     &(MemPtr->slot_global_sessions[SlotIndex]);
                 unsigned int *pProcSessions =
                     &(pProc->slot_session_count[SlotIndex]);
+                unsigned int GlobalSessions, NewGlobalSessions;
 
                 if (*pProcSessions > 0) {
 
@@ -332,21 +333,34 @@ BOOL CheckForGarbage(Slot_Mgr_Shr_t *MemPtr)
                            *pGlobalSessions);
 #endif                          /* DEV */
 
-                    if (*pProcSessions > *pGlobalSessions) {
+                    /*
+                     * The global count is updated atomically by the API
+                     * of the live processes, without holding the lock.
+                     */
+                    GlobalSessions = __atomic_load_n(pGlobalSessions,
+                                                     __ATOMIC_RELAXED);
+                    do {
+                        if (*pProcSessions > GlobalSessions) {
 #ifdef DEV
-                        WarnLog("Garbage Collection: Illegal values in table "
-                                "for defunct process");
-                        DbgLog(DL0, "Garbage collection: A process "
-                               "( Index: %d, pid: %d ) showed %u sessions "
-                               "open on slot %d, but the global count for this "
-                               "slot is only %u",
-                               ProcIndex, pProc->proc_id, *pProcSessions,
-                               SlotIndex, *pGlobalSessions);
+                            WarnLog("Garbage Collection: Illegal values in "
+                                    "table for defunct process");
+                            DbgLog(DL0, "Garbage collection: A process "
+                                   "( Index: %d, pid: %d ) showed %u sessions "
+                                   "open on slot %d, but the global count for "
+                                   "this slot is only %u",
+                                   ProcIndex, pProc->proc_id, *pProcSessions,
+                                   SlotIndex, GlobalSessions);
 #endif                          /* DEV */
-                        *pGlobalSessions = 0;
-                    } else {
-                        *pGlobalSessions -= *pProcSessions;
-                    }
+                            NewGlobalSessions = 0;
+                        } else {
+                            NewGlobalSessions = GlobalSessions -
+                                                *pProcSessions;
+                        }
+                    } while (!__atomic_compare_exchange_n(pGlobalSessions,
+                                                          &GlobalSessions,
+                                                          NewGlobalSessions,
+                                                          0, __ATOMIC_RELAXED,
+                                                          __ATOMIC_RELAXED));
 
                     *pProcSessions = 0;
 
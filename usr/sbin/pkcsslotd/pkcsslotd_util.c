@@ -105,6 +105,10 @@ void PopulateSlotInfo(Slot_Info_t_64 *slot_info, unsigned int *processed)
                    sizeof(sinfo[id].pk_slot.firmwareVersion));
 
             slot_info[id].version = sinfo[id].version;
+            slot_info[id].objstore = sinfo[id].objstore;
+            slot_info[id].objload = sinfo[id].objload;
+            slot_info[id].pbkdf2_it = sinfo[id].pbkdf2_it;
+            slot_info[id].login_cache_ttl = sinfo[id].login_cache_ttl;
 
             slot_count++;
         }
@@ -441,11 +441,90 @@ static int config_parse_slot(const char *config_file,
             confignode_getversion(c, &sinfo[slot_no].version) == 0)
             continue;
 
+        if (strcmp(c->key, "objstore") == 0 &&
+            (str = confignode_getstr(c)) != NULL) {
+            if (strcmp(str, "files") == 0) {
+                sinfo[slot_no].objstore = OBJSTORE_FILES;
+            } else if (strcmp(str, "mmap") == 0) {
+                sinfo[slot_no].objstore = OBJSTORE_MMAP;
+            } else {
+                ErrLog("Error parsing config file '%s': invalid objstore "
+                       "'%s' at line %d (expected 'files' or 'mmap')\n",
+                       config_file, str, c->line);
+                return 1;
+            }
+            continue;
+        }
+
+        if (strcmp(c->key, "objload") == 0 &&
+            (str = confignode_getstr(c)) != NULL) {
+            if (strcmp(str, "eager") == 0) {
+                sinfo[slot_no].objload = OBJLOAD_EAGER;
+            } else if (strcmp(str, "lazy") == 0) {
+                sinfo[slot_no].objload = OBJLOAD_LAZY;
+            } else {
+                ErrLog("Error parsing config file '%s': invalid objload "
+                       "'%s' at line %d (expected 'eager' or 'lazy')\n",
+                       config_file, str, c->line);
+                return 1;
+            }
+            continue;
+        }
+
+        if (strcmp(c->key, "pbkdf2_iterations") == 0 &&
+            confignode_hastype(c, CT_INTVAL)) {
+            if (confignode_to_intval(c)->value < PBKDF2_MIN_ITERATIONS ||
+                confignode_to_intval(c)->value > UINT32_MAX) {
+                ErrLog("Error parsing config file '%s': pbkdf2_iterations "
+                       "at line %d must be between %u and %u\n", config_file,
+                       c->line, PBKDF2_MIN_ITERATIONS, UINT32_MAX);
+                return 1;
+            }
+            sinfo[slot_no].pbkdf2_it = confignode_to_intval(c)->value;
+            continue;
+        }
+
+        if (strcmp(c->key, "login_cache_ttl") == 0 &&
+            confignode_hastype(c, CT_INTVAL)) {
+            if (confignode_to_intval(c)->value > UINT32_MAX) {
+                ErrLog("Error parsing config file '%s': login_cache_ttl "
+                       "at line %d is too large\n", config_file, c->line);
+                return 1;
+            }
+            sinfo[slot_no].login_cache_ttl = confignode_to_intval(c)->value;
+            continue;
+        }
+
         ErrLog("Error parsing config file '%s': unexpected token '%s' "
                "at line %d: \n", config_file, c->key, c->line);
         return 1;
     }
 
+    if ((sinfo[slot_no].pbkdf2_it != 0 ||
+         sinfo[slot_no].login_cache_ttl != 0) &&
+        sinfo[slot_no].version < (3 << 16 | 12)) {
+        ErrLog("Error parsing config file '%s': pbkdf2_iterations and "
+               "login_cache_ttl require tokversion 3.12 or later (slot %d)\n",
+               config_file, slot_no);
+        return 1;
+    }
+
+    if (sinfo[slot_no].objstore == OBJSTORE_MMAP &&
+        sinfo[slot_no].version < (3 << 16 | 12)) {
+        ErrLog("Error parsing config file '%s': objstore 'mmap' requires "
+               "tokversion 3.12 or later (slot %d)\n", config_file,
+               slot_no);
+        return 1;
+    }
+
+    if (sinfo[slot_no].objload == OBJLOAD_LAZY &&
+        sinfo[slot_no].version < (3 << 16 | 12)) {
+        ErrLog("Error parsing config file '%s': objload 'lazy' requires "
+               "tokversion 3.12 or later (slot %d)\n", config_file,
+               slot_no);
+        return 1;
+    }
+
     /* set some defaults if user hasn't set these. */
     if (!sinfo[slot_no].pk_slot.slotDescription[0]) {
         memset(&sinfo[slot_no].pk_slot.slotDescription[0], ' ',
@@ -10,7 +10,8 @@
 
 /*
  * pkcstok_migrate - A tool for migrating ICA, CCA, Soft, and EP11 token
- * repositories to 3.12 format.
+ * repositories to 3.12 format, and for converting the token objects of a
+ * 3.12 format repository between the 'files' and 'mmap' object stores.
  *
  */
 
@@ -42,6 +43,7 @@
 #include "local_types.h"
 #include "h_extern.h"
 #include "slotmgr.h" // for ock_snprintf
+#include "objdb.h"
 
 #define OCK_TOOL
 #include "pkcs_utils.h"
@@ -1927,6 +1929,8 @@ static CK_RV datastore_is_312(const char *data_store, const char *sopin,
     CK_BYTE masterkey_user[32];
     unsigned int num_objs = 0, num_old_objs = 0;
     TOKEN_DATA tokdata;
+    char fname[PATH_MAX];
+    struct stat statbuf;
 
     *new = CK_FALSE;
 
@@ -1972,6 +1976,20 @@ static CK_RV datastore_is_312(const char *data_store, const char *sopin,
         goto done;
     }
 
+    /* A single file object store only exists in 3.12 format */
+    if (ock_snprintf(fname, sizeof(fname), "%s/TOK_OBJ/%s", data_store,
+                     PK_LITE_OBJ_DB) != 0) {
+        TRACE_ERROR("Path overflow for object store of %s\n", data_store);
+        ret = CKR_FUNCTION_FAILED;
+        goto done;
+    }
+    if (stat(fname, &statbuf) == 0) {
+        TRACE_INFO("Found object store %s.\n", fname);
+        *new = CK_TRUE;
+        ret = CKR_OK;
+        goto done;
+    }
+
     ret = count_objects(data_store, &num_objs, &num_old_objs);
     if (ret != CKR_OK) {
         TRACE_ERROR("cannot count objects in %s.\n", data_store);
@@ -1994,6 +2012,203 @@ done:
     return ret;
 }
 
+/**
+ * Moves all token objects listed in TOK_OBJ/OBJ.IDX of the given data store
+ * into the single file object store TOK_OBJ/OBJ.DB. The object files are
+ * copied as they are, so no keys are needed.
+ */
+static CK_RV convert_objstore_to_mmap(const char *data_store)
+{
+    char iname[PATH_MAX], fname[PATH_MAX], dbname[PATH_MAX], tmp[PATH_MAX];
+    unsigned char *buf = NULL;
+    struct objdb db;
+    struct stat sb;
+    FILE *fp_idx = NULL, *fp = NULL;
+    CK_RV ret;
+
+    if (ock_snprintf(iname, sizeof(iname), "%s/TOK_OBJ/%s", data_store,
+                     PK_LITE_OBJ_IDX) != 0 ||
+        ock_snprintf(dbname, sizeof(dbname), "%s/TOK_OBJ/%s", data_store,
+                     PK_LITE_OBJ_DB) != 0) {
+        TRACE_ERROR("Path overflow for object store of %s\n", data_store);
+        return CKR_FUNCTION_FAILED;
+    }
+
+    ret = objdb_open(&db, dbname);
+    if (ret != CKR_OK) {
+        TRACE_ERROR("Cannot open object store %s\n", dbname);
+        return ret;
+    }
+    set_perm(db.fd);
+
+    fp_idx = fopen(iname, "r");
+    if (!fp_idx) {
+        TRACE_INFO("Cannot open %s, datastore probably empty.\n", iname);
+        ret = CKR_OK;
+        goto done;
+    }
+
+    while (fgets(tmp, sizeof(tmp), fp_idx)) {
+        tmp[strcspn(tmp, "\n")] = 0;
+        if (strlen(tmp) == 0)
+            continue;
+
+        fp = open_tokenobject(fname, sizeof(fname), data_store, "TOK_OBJ",
+                              tmp, "r");
+        if (!fp) {
+            TRACE_WARN("Cannot open token object %s, skipping it.\n", fname);
+            continue;
+        }
+        if (fstat(fileno(fp), &sb) != 0) {
+            TRACE_ERROR("fstat(%s) failed, errno=%s.\n", fname,
+                        strerror(errno));
+            ret = CKR_FUNCTION_FAILED;
+            goto done;
+        }
+        buf = malloc(sb.st_size > 0 ? sb.st_size : 1);
+        if (buf == NULL) {
+            ret = CKR_HOST_MEMORY;
+            goto done;
+        }
+        if (sb.st_size > 0 && fread(buf, sb.st_size, 1, fp) != 1) {
+            TRACE_ERROR("Cannot read token object %s.\n", fname);
+            ret = CKR_FUNCTION_FAILED;
+            goto done;
+        }
+
+        ret = objdb_put(&db, tmp, buf, sb.st_size);
+        if (ret != CKR_OK) {
+            TRACE_ERROR("Cannot store token object %s in %s.\n", tmp,
+                        dbname);
+            goto done;
+        }
+        TRACE_INFO("Moved token object %s into %s.\n", tmp, dbname);
+
+        free(buf);
+        buf = NULL;
+        fclose(fp);
+        fp = NULL;
+        unlink(fname);
+    }
+
+    fclose(fp_idx);
+    fp_idx = NULL;
+    unlink(iname);
+
+    ret = CKR_OK;
+
+done:
+    free(buf);
+    if (fp)
+        fclose(fp);
+    if (fp_idx)
+        fclose(fp_idx);
+    objdb_close(&db);
+
+    return ret;
+}
+
+struct objstore_to_files_data {
+    const char *data_store;
+    FILE *fp_idx;
+};
+
+static CK_RV objstore_to_files_cb(const char *name, CK_BYTE *data,
+                                  CK_ULONG len, void *private)
+{
+    struct objstore_to_files_data *d = private;
+    char fname[PATH_MAX];
+    FILE *fp;
+
+    fp = open_tokenobject(fname, sizeof(fname), d->data_store, "TOK_OBJ",
+                          name, "w");
+    if (!fp) {
+        TRACE_ERROR("Cannot create token object file %s.\n", fname);
+        return CKR_FUNCTION_FAILED;
+    }
+    set_perm(fileno(fp));
+
+    if (len > 0 && fwrite(data, len, 1, fp) != 1) {
+        TRACE_ERROR("Cannot write token object file %s.\n", fname);
+        fclose(fp);
+        return CKR_FUNCTION_FAILED;
+    }
+    fclose(fp);
+
+    fprintf(d->fp_idx, "%s\n", name);
+    TRACE_INFO("Wrote token object %s to %s.\n", name, fname);
+
+    return CKR_OK;
+}
+
+/**
+ * Writes each token object of the single file object store TOK_OBJ/OBJ.DB of
+ * the given data store into its own file, lists them in TOK_OBJ/OBJ.IDX, and
+ * removes OBJ.DB.
+ */
+static CK_RV convert_objstore_to_files(const char *data_store)
+{
+    char iname[PATH_MAX], dbname[PATH_MAX];
+    struct objstore_to_files_data d;
+    struct objdb db;
+    struct stat sb;
+    CK_RV ret;
+
+    if (ock_snprintf(iname, sizeof(iname), "%s/TOK_OBJ/%s", data_store,
+                     PK_LITE_OBJ_IDX) != 0 ||
+        ock_snprintf(dbname, sizeof(dbname), "%s/TOK_OBJ/%s", data_store,
+                     PK_LITE_OBJ_DB) != 0) {
+        TRACE_ERROR("Path overflow for object store of %s\n", data_store);
+        return CKR_FUNCTION_FAILED;
+    }
+
+    if (stat(dbname, &sb) != 0) {
+        TRACE_INFO("%s does not exist, nothing to convert.\n", dbname);
+        return CKR_OK;
+    }
+
+    ret = objdb_open(&db, dbname);
+    if (ret != CKR_OK) {
+        TRACE_ERROR("Cannot open object store %s\n", dbname);
+        return ret;
+    }
+
+    d.data_store = data_store;
+    d.fp_idx = fopen(iname, "a");
+    if (!d.fp_idx) {
+        TRACE_ERROR("fopen(%s) failed, errno=%s\n", iname, strerror(errno));
+        objdb_close(&db);
+        return CKR_FUNCTION_FAILED;
+    }
+    set_perm(fileno(d.fp_idx));
+
+    ret = objdb_for_each(&db, objstore_to_files_cb, &d);
+
+    fclose(d.fp_idx);
+    objdb_close(&db);
+
+    if (ret != CKR_OK)
+        return ret;
+
+    unlink(dbname);
+    return CKR_OK;
+}
+
+/**
+ * Converts the token objects of the given (3.12 format) data store to the
+ * given object store format.
+ */
+static CK_RV convert_objstore(const char *data_store, int objstore)
+{
+    TRACE_INFO("Converting token objects to the '%s' object store ...\n",
+               objstore == OBJSTORE_MMAP ? "mmap" : "files");
+
+    if (objstore == OBJSTORE_MMAP)
+        return convert_objstore_to_mmap(data_store);
+
+    return convert_objstore_to_files(data_store);
+}
+
 /**
  * Switch to new repository by deleting the old repository and renaming
  * the backup folder to the original data store name.
@@ -2032,19 +2247,24 @@ done:
 }
 
 /**
- * Inserts the new tokversion parm in the token's slot configuration, e.g.
+ * Inserts the new tokversion parm in the token's slot configuration, and the
+ * objstore parm if an object store format was specified, e.g.
  *
  *   slot 2
  *   {
  *     stdll = libpkcs11_cca.so
  *     tokversion = 3.12
+ *     objstore = mmap
  *   }
  */
-static CK_RV update_opencryptoki_conf(CK_SLOT_ID slot_id, char *location)
+static CK_RV update_opencryptoki_conf(CK_SLOT_ID slot_id, char *location,
+                                      int objstore)
 {
     char dst_file[PATH_MAX], src_file[PATH_MAX], fname[PATH_MAX+20];
     struct ConfigBaseNode *config = NULL, *c;
     struct ConfigVersionValNode *v;
+    struct ConfigStringValNode *sv;
+    char *objstore_str;
     struct ConfigIdxStructNode *slot;
     FILE *fp_w = NULL;
     CK_RV ret;
@@ -2104,6 +2324,46 @@ static CK_RV update_opencryptoki_conf(CK_SLOT_ID slot_id, char *location)
         confignode_append(slot->value, &v->base);
     }
 
+    if (objstore >= 0) {
+        objstore_str = objstore == OBJSTORE_MMAP ? "mmap" : "files";
+        c = confignode_find(slot->value, "objstore");
+        if (c != NULL && confignode_hastype(c, CT_STRINGVAL)) {
+            /* modify existing objstore */
+            free(confignode_to_stringval(c)->value);
+            confignode_to_stringval(c)->value = strdup(objstore_str);
+            if (confignode_to_stringval(c)->value == NULL) {
+                TRACE_ERROR("strdup failed\n");
+                ret = CKR_HOST_MEMORY;
+                goto done;
+            }
+        } else if (c != NULL && confignode_hastype(c, CT_BAREVAL)) {
+            free(confignode_to_bareval(c)->value);
+            confignode_to_bareval(c)->value = strdup(objstore_str);
+            if (confignode_to_bareval(c)->value == NULL) {
+                TRACE_ERROR("strdup failed\n");
+                ret = CKR_HOST_MEMORY;
+                goto done;
+            }
+        } else if (c != NULL) {
+            TRACE_ERROR("objstore is invalid in slot %lu in config file %s\n",
+                        slot_id, src_file);
+            ret = CKR_FUNCTION_FAILED;
+            goto done;
+        } else {
+            /* add new objstore */
+            sv = confignode_allocstringvaldumpable("objstore", objstore_str, 0,
+                                                   " added by pkcstok_migrate");
+            if (sv == NULL) {
+                TRACE_ERROR("failed to allocate config node for config file %s\n",
+                            src_file);
+                ret = CKR_HOST_MEMORY;
+                goto done;
+            }
+
+            confignode_append(slot->value, &sv->base);
+        }
+    }
+
     /* Open new conf file for write */
     snprintf(dst_file, PATH_MAX, "%s/%s", location, "opencryptoki.conf_new");
     fp_w = fopen(dst_file, "w");
@@ -2545,6 +2805,9 @@ static void usage(char *progname)
     printf(" -c, --confdir CONFDIR\t\tlocation of opencryptoki.conf (required)\n");
     printf(" -u, --userpin USERPIN\t\ttoken user pin (prompted if not specified)\n");
     printf(" -p, --sopin SOPIN\t\ttoken SO pin (prompted if not specified)\n");
+    printf(" -o, --objstore FORMAT\t\tconvert the token objects to the given\n");
+    printf("\t\t\t\tobject store format (optional):\n");
+    printf("\t\t\t\tfiles (one file per object), mmap (single file)\n");
     printf(" -v, --verbose LEVEL\t\tset verbose level (optional):\n");
     printf("\t\t\t\tnone (default), error, warn, info, devel, debug\n");
     return;
@@ -2565,6 +2828,7 @@ int main(int argc, char **argv)
     char data_store_new[PATH_MAX];
     CK_TOKEN_INFO_32 tokinfo;
     CK_BBOOL new;
+    int objstore = -1;
 
     static const struct option long_opts[] = {
         {"datastore", required_argument, NULL, 'd'},
@@ -2573,11 +2837,12 @@ int main(int argc, char **argv)
         {"userpin", required_argument, NULL, 'u'},
         {"sopin", required_argument, NULL, 'p'},
         {"verbose", required_argument, NULL, 'v'},
+        {"objstore", required_argument, NULL, 'o'},
         {"help", no_argument, NULL, 'h'},
         {0, 0, 0, 0}
     };
 
-    while ((opt = getopt_long(argc, argv, "d:c:s:u:p:v:h", long_opts, NULL)) != -1) {
+    while ((opt = getopt_long(argc, argv, "d:c:s:u:p:v:o:h", long_opts, NULL)) != -1) {
         switch (opt) {
         case 'd':
             data_store = strdup(optarg);
@@ -2626,6 +2891,17 @@ int main(int argc, char **argv)
                 exit(1);
             }
             break;
+        case 'o':
+            if (strcmp(optarg, "files") == 0) {
+                objstore = OBJSTORE_FILES;
+            } else if (strcmp(optarg, "mmap") == 0) {
+                objstore = OBJSTORE_MMAP;
+            } else {
+                warnx("Invalid object store format '%s' specified.", optarg);
+                usage(argv[0]);
+                exit(1);
+            }
+            break;
         case 'h':
             usage(argv[0]);
             exit(0);
@@ -2662,6 +2938,9 @@ int main(int argc, char **argv)
         printf("  user PIN specified\n");
     if (sopin)
         printf("  SO PIN specified\n");
+    if (objstore >= 0)
+        printf("  object store = %s\n",
+               objstore == OBJSTORE_MMAP ? "mmap" : "files");
     if (vlevel >= 0) {
         trace_level = vlevel;
         printf("  verbose level = %s\n", verbose);
@@ -2797,9 +3076,11 @@ int main(int argc, char **argv)
 
     /* Check if data store is already new */
     ret = datastore_is_312(data_store, sopin, userpin, &new);
-    if (ret == 0 && new) {
+    new = (ret == 0 && new);
+    if (new) {
         printf("Data store %s is already in new format.\n", data_store);
-        goto finalize;
+        if (objstore < 0)
+            goto finalize;
     }
 
     /* Backup repository if not already done */
@@ -2813,19 +3094,30 @@ int main(int argc, char **argv)
     data_store_old = data_store;
     snprintf(data_store_new, PATH_MAX, "%s_PKCSTOK_MIGRATE_TMP", data_store_old);
 
-    /* Create new temp token keys, which exist in parallel to the old ones
-     * until the migration is fully completed. */
-    ret = create_token_keys_312(data_store_new, sopin, userpin);
-    if (ret != CKR_OK) {
-        warnx("Failed to create new token keys.");
-        goto done;
+    if (!new) {
+        /* Create new temp token keys, which exist in parallel to the old
+         * ones until the migration is fully completed. */
+        ret = create_token_keys_312(data_store_new, sopin, userpin);
+        if (ret != CKR_OK) {
+            warnx("Failed to create new token keys.");
+            goto done;
+        }
+
+        /* Migrate repository */
+        ret = migrate_repository(data_store_new, sopin, userpin);
+        if (ret != CKR_OK) {
+            warnx("Failed to migrate repository.");
+            goto done;
+        }
     }
 
-    /* Migrate repository */
-    ret = migrate_repository(data_store_new, sopin, userpin);
-    if (ret != CKR_OK) {
-        warnx("Failed to migrate repository.");
-        goto done;
+    /* Convert the token objects to the requested object store */
+    if (objstore >= 0) {
+        ret = convert_objstore(data_store_new, objstore);
+        if (ret != CKR_OK) {
+            warnx("Failed to convert the token objects.");
+            goto done;
+        }
     }
 
     /* Switch to new repository */
@@ -2843,8 +3135,9 @@ finalize:
         goto done;
     }
 
-    /* Now insert new 'tokversion=3.12' parm in opencryptoki.conf */
-    ret = update_opencryptoki_conf(slot_id, conf_dir);
+    /* Now insert new 'tokversion=3.12' (and 'objstore') parm in
+     * opencryptoki.conf */
+    ret = update_opencryptoki_conf(slot_id, conf_dir, objstore);
     if (ret != CKR_OK) {
         warnx("Failed to update opencryptoki.conf, you must do this manually.");
         goto done;
@@ -23,6 +23,7 @@ usr_sbin_pkcstok_migrate_pkcstok_migrate_SOURCES =		\
 	usr/lib/common/sw_crypt.c				\
 	usr/lib/common/trace.c 					\
 	usr/lib/common/pkcs_utils.c				\
+	usr/lib/common/objdb.c					\
 	usr/sbin/pkcstok_migrate/pkcstok_migrate.c		\
 	usr/lib/config/configuration.c				\
 	usr/lib/config/cfgparse.y 				\